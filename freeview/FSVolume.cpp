@@ -38,6 +38,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
+#include <climits>
 #include <stdexcept>
 #ifdef HAVE_OPENMP
 #include <omp.h>
@@ -52,6 +53,7 @@
 #include "utils.h"
 
 #define NUM_OF_HISTO_BINS 10000
+#define LAZY_BRICK_SIZE   32
 
 FSVolume::FSVolume(FSVolume *ref, QObject *parent)
     : QObject(parent), m_MRI(NULL), m_MRITarget(NULL), m_MRIRef(NULL),
@@ -61,7 +63,8 @@ FSVolume::FSVolume(FSVolume *ref, QObject *parent)
       m_nInterpolationMethod(SAMPLE_NEAREST), m_bConform(false), m_bCrop(false),
       m_bCropToOriginal(false), m_histoCDF(NULL), m_nHistoFrame(0),
       m_bValidHistogram(false), m_bSharedMRI(false), m_lta(NULL),
-      m_bIgnoreHeader(false) {
+      m_bIgnoreHeader(false), m_bLazyResample(false), m_bLazyActive(false),
+      m_nBricksResident(0) {
   m_imageData = NULL;
   if (ref) {
     SetMRI(m_MRIRef, ref->m_MRI);
@@ -380,6 +383,8 @@ void FSVolume::ClearRegistrationMatrix() {
 }
 
 bool FSVolume::Create(FSVolume *src_vol, bool bCopyVoxelData, int data_type) {
+  // the new volume copies the source image, so it must be complete
+  src_vol->EnsureAllResampled();
   if (m_MRI) {
     ::MRIfree(&m_MRI);
   }
@@ -1384,14 +1389,26 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
   this->GetPixelSize(voxelSize);
   int dim[3];
 
+  // lazy mode only allocates the target header; the image is resampled
+  // brick by brick from m_MRI when it is displayed
+  bool bLazy = m_bLazyResample && !do_not_create_image &&
+               m_MRI->type != MRI_RGB &&
+               (m_nInterpolationMethod == SAMPLE_NEAREST ||
+                m_nInterpolationMethod == SAMPLE_TRILINEAR);
+  m_bLazyActive = false;
+
   MRI *   rasMRI = NULL;
   MATRIX *m      = MatrixZero(4, 4, NULL);
   if (m_matReg && m_MRIRef && m_volumeRef) {
     // if there is registration matrix, set target as the reference's target
     MRI *mri = m_volumeRef->m_MRITarget;
     try {
-      rasMRI = MRIallocSequence(mri->width, mri->height, mri->depth,
+      if (bLazy)
+        rasMRI = MRIallocHeader(mri->width, mri->height, mri->depth,
                                 m_MRI->type, m_MRI->nframes);
+      else
+        rasMRI = MRIallocSequence(mri->width, mri->height, mri->depth,
+                                  m_MRI->type, m_MRI->nframes);
     } catch (int ret) {
       return false;
     }
@@ -1409,8 +1426,12 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
     }
 
     try {
-      rasMRI =
-          MRIallocSequence(dim[0], dim[1], dim[2], m_MRI->type, m_MRI->nframes);
+      if (bLazy)
+        rasMRI =
+            MRIallocHeader(dim[0], dim[1], dim[2], m_MRI->type, m_MRI->nframes);
+      else
+        rasMRI = MRIallocSequence(dim[0], dim[1], dim[2], m_MRI->type,
+                                  m_MRI->nframes);
     } catch (int ret) {
       return false;
     }
@@ -1514,8 +1535,12 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
       *MATRIX_RELT(m, 4, 4) = 1;
 
       try {
-        rasMRI = MRIallocSequence(dim[0], dim[1], dim[2], m_MRI->type,
+        if (bLazy)
+          rasMRI = MRIallocHeader(dim[0], dim[1], dim[2], m_MRI->type,
                                   m_MRI->nframes);
+        else
+          rasMRI = MRIallocSequence(dim[0], dim[1], dim[2], m_MRI->type,
+                                    m_MRI->nframes);
       } catch (int ret) {
         return false;
       }
@@ -1539,8 +1564,8 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
       MatrixFree(&m2);
       MatrixFree(&m_inv);
     } else {
-      rasMRI =
-          CreateTargetMRI(m_MRI, m_volumeRef->m_MRITarget, true, m_bConform);
+      rasMRI = CreateTargetMRI(m_MRI, m_volumeRef->m_MRITarget, !bLazy,
+                               m_bConform);
       if (rasMRI == NULL) {
         std::cerr << "Can not allocate memory for volume transformation\n";
         MatrixFree(&m);
@@ -1570,7 +1595,8 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
       MATRIX *t2r = MRIgetVoxelToVoxelXform(rasMRI, m_MRIRef);
       MatrixMultiply(vox2vox, t2r, t2r);
 
-      MRIvol2Vol(m_MRI, rasMRI, t2r, m_nInterpolationMethod, 0);
+      if (!bLazy)
+        MRIvol2Vol(m_MRI, rasMRI, t2r, m_nInterpolationMethod, 0);
 
       // copy vox2vox
       MatrixInverse(t2r, vox2vox);
@@ -1590,7 +1616,8 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
 
     //    QElapsedTimer t; t.start();
     //    qDebug() << "begin vol2vol";
-    MRIvol2Vol(m_MRI, rasMRI, NULL, m_nInterpolationMethod, 0);
+    if (!bLazy)
+      MRIvol2Vol(m_MRI, rasMRI, NULL, m_nInterpolationMethod, 0);
     //    qDebug() << "vol2vol time: " << t.elapsed()/1000;
     MATRIX *vox2vox = MRIgetVoxelToVoxelXform(m_MRI, rasMRI);
     for (int i = 0; i < 16; i++) {
@@ -1607,8 +1634,24 @@ bool FSVolume::MapMRIToImage(bool do_not_create_image) {
     return false;
   }
 
-  // copy mri pixel data to vtkImage we will use for display
-  CopyMRIDataToImage(rasMRI, m_imageData);
+  if (bLazy) {
+    // nothing is resampled yet, voxels outside the native volume stay 0
+    int *imgdim = m_imageData->GetDimensions();
+    memset(m_imageData->GetScalarPointer(), 0,
+           (size_t)imgdim[0] * imgdim[1] * imgdim[2] *
+               m_imageData->GetNumberOfScalarComponents() *
+               m_imageData->GetScalarSize());
+    vtkMatrix4x4::Invert(m_VoxelToVoxelMatrix, m_TargetToNativeMatrix);
+    for (int i = 0; i < 3; i++)
+      m_nBricks[i] = (imgdim[i] + LAZY_BRICK_SIZE - 1) / LAZY_BRICK_SIZE;
+    m_brickResident.assign((size_t)m_nBricks[0] * m_nBricks[1] * m_nBricks[2],
+                           0);
+    m_nBricksResident = 0;
+    m_bLazyActive     = true;
+  } else {
+    // copy mri pixel data to vtkImage we will use for display
+    CopyMRIDataToImage(rasMRI, m_imageData);
+  }
 
   // Need to recalc our bounds at some point.
   m_bBoundsCacheDirty = true;
@@ -2088,6 +2131,121 @@ void FSVolume::CopyMRIDataToImage(MRI *mri, vtkImageData *image) {
   }
 }
 
+// store one resampled value the way MRIsetVoxVal would have stored it in
+// the intermediate target MRI
+static void SetLazyVoxel(void *ptr, int type, vtkIdType n, float val) {
+  switch (type) {
+  case MRI_UCHAR:
+    val                       = std::max(0.0f, std::min(255.0f, val));
+    ((unsigned char *)ptr)[n] = (unsigned char)nint(val);
+    break;
+  case MRI_SHORT:
+    val = std::max((float)SHRT_MIN, std::min((float)SHRT_MAX, val));
+    ((short *)ptr)[n] = (short)nint(val);
+    break;
+  case MRI_INT:
+    ((int *)ptr)[n] = nint(val);
+    break;
+  case MRI_LONG:
+    ((long *)ptr)[n] = (long)nint(val);
+    break;
+  case MRI_FLOAT:
+    ((float *)ptr)[n] = val;
+    break;
+  default:
+    break;
+  }
+}
+
+void FSVolume::ResampleBricks(const std::vector<int> &bricks) {
+  int *  dim     = m_imageData->GetDimensions();
+  int    nframes = m_MRI->nframes;
+  void * ptr     = m_imageData->GetScalarPointer();
+  double t2n[16];
+  memcpy(t2n, m_TargetToNativeMatrix, sizeof(t2n));
+
+  // same rounding as MRIvol2Vol so the lazy image matches the eager one
+  int (*nintfunc)(double) = &nint;
+  if (m_MRI->width == 1 || m_MRI->height == 1 || m_MRI->depth == 1)
+    nintfunc = &nint2;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (int n = 0; n < (int)bricks.size(); n++) {
+    std::vector<float> valvect(nframes);
+
+    int b  = bricks[n];
+    int x0 = (b % m_nBricks[0]) * LAZY_BRICK_SIZE;
+    int y0 = (b / m_nBricks[0] % m_nBricks[1]) * LAZY_BRICK_SIZE;
+    int z0 = (b / (m_nBricks[0] * m_nBricks[1])) * LAZY_BRICK_SIZE;
+    for (int z = z0; z < std::min(z0 + LAZY_BRICK_SIZE, dim[2]); z++) {
+      for (int y = y0; y < std::min(y0 + LAZY_BRICK_SIZE, dim[1]); y++) {
+        for (int x = x0; x < std::min(x0 + LAZY_BRICK_SIZE, dim[0]); x++) {
+          double fc = t2n[0] * x + t2n[1] * y + t2n[2] * z + t2n[3];
+          double fr = t2n[4] * x + t2n[5] * y + t2n[6] * z + t2n[7];
+          double fs = t2n[8] * x + t2n[9] * y + t2n[10] * z + t2n[11];
+          int    ic = nintfunc(fc), ir = nintfunc(fr), is = nintfunc(fs);
+          if (ic < 0 || ic >= m_MRI->width || ir < 0 || ir >= m_MRI->height ||
+              is < 0 || is >= m_MRI->depth)
+            continue;
+
+          if (m_nInterpolationMethod == SAMPLE_TRILINEAR)
+            MRIsampleSeqVolume(m_MRI, fc, fr, fs, &valvect[0], 0, nframes - 1);
+          else
+            for (int f = 0; f < nframes; f++)
+              valvect[f] = MRIgetVoxVal(m_MRI, ic, ir, is, f);
+
+          vtkIdType nTuple =
+              x + (vtkIdType)dim[0] * (y + (vtkIdType)dim[1] * z);
+          for (int f = 0; f < nframes; f++)
+            SetLazyVoxel(ptr, m_MRI->type, nTuple * nframes + f, valvect[f]);
+        }
+      }
+    }
+  }
+
+  for (size_t n = 0; n < bricks.size(); n++)
+    m_brickResident[bricks[n]] = 1;
+  m_nBricksResident += (int)bricks.size();
+  if (m_nBricksResident == (int)m_brickResident.size())
+    m_bLazyActive = false;
+  if (!bricks.empty())
+    m_imageData->Modified();
+}
+
+void FSVolume::EnsureSliceResampled(int nPlane, int nSlice) {
+  QMutexLocker locker(&m_lazyMutex);
+  if (!m_bLazyActive || nPlane < 0 || nPlane > 2)
+    return;
+
+  int *dim = m_imageData->GetDimensions();
+  if (nSlice < 0 || nSlice >= dim[nPlane])
+    return;
+
+  std::vector<int> bricks;
+  int              nb = nSlice / LAZY_BRICK_SIZE;
+  for (int b = 0; b < (int)m_brickResident.size(); b++) {
+    int bxyz[3] = {b % m_nBricks[0], b / m_nBricks[0] % m_nBricks[1],
+                   b / (m_nBricks[0] * m_nBricks[1])};
+    if (bxyz[nPlane] == nb && !m_brickResident[b])
+      bricks.push_back(b);
+  }
+  ResampleBricks(bricks);
+}
+
+void FSVolume::EnsureAllResampled() {
+  QMutexLocker locker(&m_lazyMutex);
+  if (!m_bLazyActive)
+    return;
+
+  std::vector<int> bricks;
+  for (int b = 0; b < (int)m_brickResident.size(); b++)
+    if (!m_brickResident[b])
+      bricks.push_back(b);
+  ResampleBricks(bricks);
+}
+
 vtkImageData *FSVolume::GetImageOutput() { return m_imageData; }
 
 void FSVolume::CopyMatricesFromMRI() {
@@ -25,6 +25,7 @@
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
 #include "vtkSmartPointer.h"
+#include <QMutex>
 #include <QObject>
 #include <vector>
 
@@ -175,6 +176,19 @@ public:
 
   void SetIgnoreHeader(bool b) { m_bIgnoreHeader = b; }
 
+  // lazy mode keeps the native MRI and resamples the target image in bricks
+  // as they are displayed instead of running MRIvol2Vol over the whole volume
+  void SetLazyResample(bool b) { m_bLazyResample = b; }
+
+  bool IsLazyResampled() {
+    QMutexLocker locker(&m_lazyMutex);
+    return m_bLazyActive;
+  }
+
+  void EnsureSliceResampled(int nPlane, int nSlice);
+
+  void EnsureAllResampled();
+
 Q_SIGNALS:
   void ProgressChanged(int n);
 
@@ -186,6 +200,7 @@ protected:
   void UpdateHistoCDF(int frame = 0, float threshold = -1,
                       bool bHighThreshold = false);
   void CopyMRIDataToImage(MRI *mri, vtkImageData *image);
+  void ResampleBricks(const std::vector<int> &bricks);
   void CopyMatricesFromMRI();
   bool CreateImage(MRI *mri);
   bool ResizeRotatedImage(MRI *mri, MRI *refTarget, vtkImageData *refImageData,
@@ -241,6 +256,14 @@ protected:
   bool   m_bCropToOriginal;
 
   bool m_bSharedMRI;
+
+  bool              m_bLazyResample;
+  bool              m_bLazyActive; // some bricks are not resampled yet
+  double            m_TargetToNativeMatrix[16]; // target voxel to native
+  int               m_nBricks[3];
+  int               m_nBricksResident;
+  std::vector<char> m_brickResident;
+  QMutex            m_lazyMutex; // worker threads may complete the image too
 };
 
 #endif
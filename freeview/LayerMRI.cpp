@@ -92,7 +92,8 @@ LayerMRI::LayerMRI(LayerMRI *ref, QObject *parent)
       m_bReorient(false), m_nSampleMethod(SAMPLE_NEAREST), m_bConform(false),
       m_bWriteResampled(true), m_currentSurfaceRegion(NULL),
       m_nGotoLabelSlice(-1), m_nGotoLabelOrientation(-1), m_layerMask(NULL),
-      m_correlationSurface(NULL), m_bIgnoreHeader(false) {
+      m_correlationSurface(NULL), m_bIgnoreHeader(false),
+      m_bLazyResample(false) {
   m_strTypeNames.push_back("Supplement");
   m_strTypeNames.push_back("MRI");
   m_sPrimaryType = "MRI";
@@ -171,6 +172,8 @@ LayerMRI::LayerMRI(LayerMRI *ref, QObject *parent)
           SLOT(OnLabelInformationReady()));
 
   connect(this, SIGNAL(Modified()), this, SLOT(UpdateLabelInformation()));
+  // a transformed reslice samples voxels off the displayed slices
+  connect(this, SIGNAL(Transformed()), this, SLOT(CompleteImageData()));
 
   QVariantMap map = MainWindow::GetMainWindow()->GetDefaultSettings();
   if (map["Smoothed"].toBool()) {
@@ -326,6 +329,7 @@ bool LayerMRI::LoadVolumeFromFile() {
   m_volumeSource->SetConform(m_bConform);
   m_volumeSource->SetInterpolationMethod(m_nSampleMethod);
   m_volumeSource->SetIgnoreHeader(m_bIgnoreHeader);
+  m_volumeSource->SetLazyResample(m_bLazyResample);
 
   if (!m_volumeSource->MRIRead(m_sFilename.toLatin1().data(),
                                m_sRegFilename.size() > 0
@@ -539,7 +543,7 @@ bool LayerMRI::SaveVolume() {
   }
 
   ::SetProgressCallback(ProgressCallback, 0, 60);
-  if (!m_volumeSource->UpdateMRIFromImage(m_imageData, !m_bReorient)) {
+  if (!m_volumeSource->UpdateMRIFromImage(GetImageData(), !m_bReorient)) {
     return false;
   }
 
@@ -932,8 +936,16 @@ void LayerMRI::UpdateColorMap() {
 
 void LayerMRI::UpdateLabelInformation() {
   if (GetProperty()->GetColorMap() == LayerPropertyMRI::LUT &&
-      !m_worker->isRunning())
+      !m_worker->isRunning()) {
+    // the worker scans every voxel, so complete the image before it starts
+    CompleteImageData();
     m_worker->start();
+  }
+}
+
+void LayerMRI::CompleteImageData() {
+  if (m_volumeSource)
+    m_volumeSource->EnsureAllResampled();
 }
 
 void LayerMRI::UpdateResliceInterpolation() {
@@ -978,6 +990,8 @@ void LayerMRI::UpdateContourActor(int nSegValue) {
   // if a build contour result is already expired, by comparing the returned id and current id. If they
   // are different, it means a new thread is rebuilding the contour
   m_nThreadID++;
+  // complete the image here so the thread never resamples it
+  CompleteImageData();
   ThreadBuildContour *thread = new ThreadBuildContour(this);
   connect(thread, SIGNAL(Finished(int)), this,
           SLOT(OnContourThreadFinished(int)));
@@ -1114,6 +1128,15 @@ void LayerMRI::OnSlicePositionChanged(int nPlane) {
 
   assert(GetProperty());
 
+  if (m_volumeSource->IsLazyResampled()) {
+    double *img_origin = m_imageData->GetOrigin();
+    double *voxel_size = m_imageData->GetSpacing();
+    m_volumeSource->EnsureSliceResampled(
+        nPlane, (int)((m_dSlicePosition[nPlane] - img_origin[nPlane]) /
+                          voxel_size[nPlane] +
+                      0.5));
+  }
+
   // display slice image
   vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
   matrix->Identity();
@@ -1276,9 +1299,10 @@ double LayerMRI::GetVoxelValue(double *pos) {
   } else {
     if (GetCorrelationSurface())
       return m_imageRawDisplay->GetScalarComponentAsDouble(n[0], n[1], n[2], 0);
-    else
-      return m_imageData->GetScalarComponentAsDouble(n[0], n[1], n[2],
-                                                     m_nActiveFrame);
+    // only the slab holding the voxel, so probing does not load everything
+    m_volumeSource->EnsureSliceResampled(0, n[0]);
+    return m_imageData->GetScalarComponentAsDouble(n[0], n[1], n[2],
+                                                   m_nActiveFrame);
   }
 }
 
@@ -2266,7 +2290,7 @@ bool LayerMRI::GetVoxelValueRange(const double *pt0, const double *pt1,
   }
 
   int   nActiveComp = GetActiveFrame();
-  char *ptr         = (char *)m_imageData->GetScalarPointer();
+  char *ptr         = (char *)GetImageData()->GetScalarPointer();
   int   nFrames     = m_imageData->GetNumberOfScalarComponents();
   range_out[0]      = MyVTKUtils::GetImageDataComponent(
       ptr, dim, nFrames, n0[0], n0[1], n0[2], nActiveComp, scalar_type);
@@ -2323,7 +2347,7 @@ bool LayerMRI::GetVoxelStatsRectangle(const double *pt0, const double *pt1,
   int    nActiveComp = GetActiveFrame();
   double dMean       = 0;
   int    nCount      = 0;
-  char * ptr         = (char *)m_imageData->GetScalarPointer();
+  char * ptr         = (char *)GetImageData()->GetScalarPointer();
   int    nFrames     = m_imageData->GetNumberOfScalarComponents();
   for (int i = n0[0]; i <= n1[0]; i++) {
     for (int j = n0[1]; j <= n1[1]; j++) {
@@ -2369,7 +2393,7 @@ bool LayerMRI::GetVoxelStats(QVector<int> &indices, double *mean_out,
   double dMean       = 0;
   int    nCount      = 0;
   int *  dim         = m_imageData->GetDimensions();
-  char * ptr         = (char *)m_imageData->GetScalarPointer();
+  char * ptr         = (char *)GetImageData()->GetScalarPointer();
   int    scalar_type = m_imageData->GetScalarType();
   int    nFrames     = m_imageData->GetNumberOfScalarComponents();
   for (int n = 0; n < indices.size(); n += 3) {
@@ -2429,7 +2453,7 @@ bool LayerMRI::GetVoxelsOnLine(const double *pt0, const double *pt1, int nPlane,
   double *orig        = m_imageData->GetOrigin();
   double *voxel_size  = m_imageData->GetSpacing();
   int *   dim         = m_imageData->GetDimensions();
-  char *  ptr         = (char *)m_imageData->GetScalarPointer();
+  char *  ptr         = (char *)GetImageData()->GetScalarPointer();
   int     scalar_type = m_imageData->GetScalarType();
   int     nFrames     = m_imageData->GetNumberOfScalarComponents();
 
@@ -2518,7 +2542,7 @@ std::vector<int> LayerMRI::GetVoxelIndicesBetweenPoints(int *n0, int *n1) {
 
 void LayerMRI::ResetWindowLevel() {
   double range[2];
-  m_imageData->GetScalarRange(range);
+  GetImageData()->GetScalarRange(range);
   GetProperty()->SetMinMaxGrayscaleWindow(range[0], range[1]);
   GetProperty()->SetMinMaxGenericThreshold(range[0], range[1]);
   GetProperty()->SetHeatScale(range[0], (range[0] + range[1]) / 2, range[1]);
@@ -2643,7 +2667,7 @@ void LayerMRI::GetCurrentLabelStats(int nPlane, float *label_out,
   }
 
   float fLabel      = 0;
-  char *ptr         = (char *)m_imageData->GetScalarPointer();
+  char *ptr         = (char *)GetImageData()->GetScalarPointer();
   int   scalar_type = m_imageData->GetScalarType();
   int   nFrames     = m_imageData->GetNumberOfScalarComponents();
   if (n[0] >= 0 && n[0] < dim[0] && n[1] >= 0 && n[1] < dim[1] && n[2] >= 0 &&
@@ -2744,7 +2768,7 @@ bool LayerMRI::FloodFillByContour2D(double *ras, Contour2D *c2d) {
   MyUtils::FloodFill(mask, x, y, nx, ny, nFillValue, 0);
 
   nDim            = m_imageData->GetDimensions();
-  ptr             = (char *)m_imageData->GetScalarPointer();
+  ptr             = (char *)GetImageData()->GetScalarPointer();
   scalar_type     = m_imageData->GetScalarType();
   int nActiveComp = this->GetActiveFrame();
   int cnt         = 0;
@@ -3167,7 +3191,7 @@ void LayerMRI::ReplaceVoxelValue(double orig_value, double new_value,
     } else
       range[nPlane][1] = range[nPlane][0] - 1;
   }
-  char *ptr         = (char *)m_imageData->GetScalarPointer();
+  char *ptr         = (char *)GetImageData()->GetScalarPointer();
   int   scalar_type = m_imageData->GetScalarType();
   int   n_frames    = m_imageData->GetNumberOfScalarComponents();
   for (size_t i = range[0][0]; i <= range[0][1]; i++) {
@@ -3214,9 +3238,9 @@ void LayerMRI::UpdateProjectionMap() {
     }
     vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
 #if VTK_MAJOR_VERSION > 5
-    cast->SetInputData(m_imageData);
+    cast->SetInputData(GetImageData());
 #else
-    cast->SetInput(m_imageData);
+    cast->SetInput(GetImageData());
 #endif
     cast->SetOutputScalarTypeToFloat();
     cast->Update();
@@ -3587,7 +3611,7 @@ void LayerMRI::UpdateSurfaceCorrelationData() {
     float *x;
     int    dim[3];
     m_imageRawDisplay->GetDimensions(dim);
-    float *inPixel = static_cast<float *>(m_imageData->GetScalarPointer());
+    float *inPixel = static_cast<float *>(GetImageData()->GetScalarPointer());
     float *outPixel =
         static_cast<float *>(m_imageRawDisplay->GetScalarPointer());
     for (qlonglong i = 0; i < dim[0]; i++) {
@@ -3760,7 +3784,7 @@ QVector<double> LayerMRI::GetVoxelList(int nVal) {
   int *           dim         = m_imageData->GetDimensions();
   int             scalar_type = m_imageData->GetScalarType();
   int             n_frames    = m_imageData->GetNumberOfScalarComponents();
-  char *          ptr         = (char *)m_imageData->GetScalarPointer();
+  char *          ptr         = (char *)GetImageData()->GetScalarPointer();
   double *        origin      = m_imageData->GetOrigin();
   double *        vs          = m_imageData->GetSpacing();
   for (int k = 0; k < dim[2]; k++) {
@@ -293,6 +293,8 @@ public:
 
   void SetIgnoreHeader(bool b) { m_bIgnoreHeader = b; }
 
+  void SetLazyResample(bool b) { m_bLazyResample = b; }
+
   QVector<double> GetVoxelList(int nVal);
 
   QVariantMap GetTimeSeriesInfo();
@@ -358,6 +360,8 @@ protected slots:
   void UpdateLabelInformation();
   void OnLabelInformationReady();
 
+  virtual void CompleteImageData();
+
   void UpdateVectorLineWidth(double val);
 
 protected:
@@ -397,6 +401,7 @@ protected:
   bool      m_bConform;
   bool      m_bWriteResampled;
   bool      m_bIgnoreHeader;
+  bool      m_bLazyResample;
 
   vtkImageActor *m_sliceActor2D[3];
   vtkImageActor *m_sliceActor3D[3];
@@ -975,6 +975,8 @@ void LayerVolumeBase::Redo() {
 }
 
 void LayerVolumeBase::SaveForUndo(int nPlane, bool bAllFrames) {
+  // edits must not be overwritten by parts filled in afterwards
+  CompleteImageData();
   double *origin     = m_imageData->GetOrigin();
   double *voxel_size = m_imageData->GetSpacing();
   int     nSlice     = 0;
@@ -81,7 +81,11 @@ public:
 
   virtual void SetActiveFrame(int nFrame) { m_nActiveFrame = nFrame; }
 
-  vtkImageData *GetImageData() { return m_imageData; }
+  // the full image, completing any part a subclass has deferred filling in
+  vtkImageData *GetImageData() {
+    CompleteImageData();
+    return m_imageData;
+  }
 
   vtkImageData *GetImageDataRef() { return m_imageDataRef; }
 
@@ -107,6 +111,9 @@ public slots:
   void PrepareShifting(int nPlane);
   void DoneShifting();
 
+protected slots:
+  virtual void CompleteImageData() {}
+
 protected:
   QVector<int> SetVoxelByIndex(
       int *n, int nPlane, bool bAdd = true,
@@ -2130,6 +2130,9 @@ void MainWindow::CommandLoadVolume(const QStringList &sa) {
         m_scripts.insert(0, QStringList() << "setactiveframe" << subArgu);
       } else if (subOption == "ignore_header") {
         sup_data["IgnoreHeader"] = true;
+      } else if (subOption == "lazy") {
+        sup_data["Lazy"] = (subArgu.isEmpty() || subArgu.toLower() == "true" ||
+                            subArgu.toLower() == "yes" || subArgu == "1");
       } else if (subOption == "binary_color") {
         QColor color = ParseColorInput(subArgu);
         if (color.isValid())
@@ -4580,6 +4583,9 @@ void MainWindow::LoadVolumeFile(const QString &filename,
   if (sup_data.value("IgnoreHeader").toBool())
     layer->SetIgnoreHeader(true);
 
+  if (sup_data.value("Lazy").toBool())
+    layer->SetLazyResample(true);
+
   m_threadIOWorker->LoadVolume(layer);
 }
 
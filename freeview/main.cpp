@@ -210,6 +210,11 @@ int main(int argc, char *argv[]) {
           "':ignore_header=flag' Ignore header information. Use the existing "
           "volume's header info. Flag can be '1' or '0' or 'true' or "
           "'false'.\n\n"
+          "':lazy=flag' Keep the volume in its native space and resample "
+          "only the displayed slices on demand instead of the whole volume at "
+          "load time. Useful for very large or many-frame volumes. Only "
+          "nearest and trilinear resampling are done lazily. Flag can be '1' "
+          "or '0' or 'true' or 'false'.\n\n"
           "':frame=number' Set active frame (0 based).\n\n"
           "':select_label=label_index' When colormap is set as look up table, "
           "select and show only the given labels. Multiple labels can be given "
@@ -0,0 +1,571 @@
+/**
+ * @brief pipeline-level benchmarks for the kernels that dominate recon-all
+ *
+ * Every benchmark runs on synthetic data that is generated from a fixed seed
+ * the first time it is needed, so the suite runs offline and two runs on the
+ * same build see bit-identical inputs. Each benchmark is parameterized by the
+ * number of OpenMP threads. Unless --benchmark_out is given, results are also
+ * written as JSON to fs_bench.json in the current directory so that runs can
+ * be compared with benchmark's compare.py.
+ */
+/*
+ * Copyright © 2021 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "cma.h"
+#include "diag.h"
+#include "error.h"
+#include "fmriutils.h"
+#include "fsglm.h"
+#include "gca.h"
+#include "gcamorph.h"
+#include "icosahedron.h"
+#include "mri.h"
+#include "mrishash.h"
+#include "mrisurf.h"
+#include "romp_support.h"
+#include "transform.h"
+#include "utils.h"
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wglobal-constructors"
+#endif
+
+namespace {
+
+constexpr auto bench_seed     = 1234;
+constexpr auto bench_vol_dim  = 128;
+constexpr auto bench_gca_dim  = 64;
+constexpr auto bench_surf_rad = 100.0F;
+constexpr auto bench_mht_npts = 200000;
+
+// ------------------------------------------------------------------
+//  synthetic inputs
+// ------------------------------------------------------------------
+
+auto scratch_dir() -> const std::filesystem::path & {
+  static auto dir = [] {
+    auto d = std::filesystem::temp_directory_path() /
+             ("fs_bench_" + std::to_string(getpid()));
+    std::filesystem::create_directories(d);
+    return d;
+  }();
+  return dir;
+}
+
+// Label of voxel (x,y,z) in a spherical "brain" phantom of dimension dim:
+// ventricle in the middle, then white matter, then a cortical shell.
+auto phantom_label(int x, int y, int z, int dim) -> int {
+  auto c  = 0.5 * (dim - 1);
+  auto dx = x - c, dy = y - c, dz = z - c;
+  auto rn = std::sqrt(dx * dx + dy * dy + dz * dz) / dim;
+  if (rn < 0.10) {
+    return Left_Lateral_Ventricle;
+  }
+  if (rn < 0.30) {
+    return Left_Cerebral_White_Matter;
+  }
+  if (rn < 0.40) {
+    return Left_Cerebral_Cortex;
+  }
+  return Unknown;
+}
+
+auto phantom_intensity(int label) -> float {
+  switch (label) {
+  case Left_Lateral_Ventricle:
+    return 30.0F;
+  case Left_Cerebral_White_Matter:
+    return 110.0F;
+  case Left_Cerebral_Cortex:
+    return 70.0F;
+  default:
+    return 5.0F;
+  }
+}
+
+auto make_label_volume(int dim) -> MRI * {
+  auto *mri = MRIalloc(dim, dim, dim, MRI_UCHAR);
+  for (int z = 0; z < dim; z++) {
+    for (int y = 0; y < dim; y++) {
+      for (int x = 0; x < dim; x++) {
+        MRIsetVoxVal(mri, x, y, z, 0, phantom_label(x, y, z, dim));
+      }
+    }
+  }
+  return mri;
+}
+
+// T1-like intensities with a smooth bias field and Gaussian noise
+auto make_intensity_volume(int dim, int type) -> MRI * {
+  std::mt19937                    rng(bench_seed);
+  std::normal_distribution<float> noise(0.0F, 4.0F);
+
+  auto *mri = MRIalloc(dim, dim, dim, type);
+  for (int z = 0; z < dim; z++) {
+    for (int y = 0; y < dim; y++) {
+      for (int x = 0; x < dim; x++) {
+        float bias = 1.0F + 0.1F * std::sin(2.0F * M_PI * x / dim) *
+                               std::cos(2.0F * M_PI * z / dim);
+        float val =
+            bias * phantom_intensity(phantom_label(x, y, z, dim)) + noise(rng);
+        MRIsetVoxVal(mri, x, y, z, 0, std::max(0.0F, std::min(255.0F, val)));
+      }
+    }
+  }
+  return mri;
+}
+
+auto bench_volume() -> MRI * {
+  static auto *mri = make_intensity_volume(bench_vol_dim, MRI_FLOAT);
+  return mri;
+}
+
+auto bench_volume_uchar() -> MRI * {
+  static auto *mri = make_intensity_volume(bench_vol_dim, MRI_UCHAR);
+  return mri;
+}
+
+auto bench_mgz_fname() -> const std::string & {
+  static auto fname = [] {
+    auto name = (scratch_dir() / "vol.mgz").string();
+    MRIwrite(bench_volume_uchar(), name.c_str());
+    return name;
+  }();
+  return fname;
+}
+
+auto bench_gca_inputs() -> MRI * {
+  static auto *mri = make_intensity_volume(bench_gca_dim, MRI_UCHAR);
+  return mri;
+}
+
+auto bench_transform() -> TRANSFORM * {
+  static auto *transform = [] {
+    auto *t = TransformAlloc(LINEAR_VOXEL_TO_VOXEL, nullptr);
+    TransformInvert(t, bench_gca_inputs());
+    return t;
+  }();
+  return transform;
+}
+
+// Trains a single-channel atlas on the phantom and writes it to disk once,
+// so GCAread and everything downstream sees a real on-disk atlas.
+auto bench_gca_fname() -> const std::string & {
+  static auto fname = [] {
+    auto *mri_inputs = bench_gca_inputs();
+    auto *mri_seg    = make_label_volume(bench_gca_dim);
+    auto *gca = GCAalloc(1, 2.0F, 4.0F, mri_inputs->width, mri_inputs->height,
+                         mri_inputs->depth, GCA_NO_FLAGS);
+    GCAreinit(mri_inputs, gca);
+    GCAtrain(gca, mri_inputs, mri_seg, bench_transform(), nullptr, 0);
+    GCAcompleteMeanTraining(gca);
+    GCAtrainCovariances(gca, mri_inputs, mri_seg, bench_transform());
+    GCAcompleteCovarianceTraining(gca);
+
+    auto name = (scratch_dir() / "atlas.gca").string();
+    GCAwrite(gca, name.c_str());
+    GCAfree(&gca);
+    MRIfree(&mri_seg);
+    return name;
+  }();
+  return fname;
+}
+
+auto bench_gca() -> GCA * {
+  static auto *gca = GCAread(bench_gca_fname().c_str());
+  return gca;
+}
+
+auto bench_gca_smooth() -> MRI * {
+  static auto *mri = [] {
+    auto *kernel = MRIgaussian1d(1.0F, 100);
+    auto *smooth = MRIconvolveGaussian(bench_gca_inputs(), nullptr, kernel);
+    MRIfree(&kernel);
+    return smooth;
+  }();
+  return mri;
+}
+
+// ic7-sized sphere of radius bench_surf_rad with a deterministic wobble so the
+// metric properties are not all identical
+auto bench_surface() -> MRIS * {
+  static auto *mris = [] {
+    auto *s = ic163842_make_surface(0, 0);
+    for (int vno = 0; vno < s->nvertices; vno++) {
+      auto *v = &s->vertices[vno];
+      auto  r = std::sqrt(v->x * v->x + v->y * v->y + v->z * v->z);
+      auto  w = 1.0F + 0.05F * std::sin(8.0F * v->x / r) *
+                          std::cos(6.0F * v->z / r);
+      MRISsetXYZ(s, vno, bench_surf_rad * w * v->x / r,
+                 bench_surf_rad * w * v->y / r, bench_surf_rad * w * v->z / r);
+    }
+    MRIScomputeMetricProperties(s);
+    return s;
+  }();
+  return mris;
+}
+
+auto bench_surface_overlay(int nframes) -> MRI * {
+  std::mt19937                    rng(bench_seed);
+  std::normal_distribution<float> noise(0.0F, 1.0F);
+
+  auto *mri =
+      MRIallocSequence(bench_surface()->nvertices, 1, 1, MRI_FLOAT, nframes);
+  for (int f = 0; f < nframes; f++) {
+    for (int vno = 0; vno < mri->width; vno++) {
+      MRIsetVoxVal(mri, vno, 0, 0, f, noise(rng));
+    }
+  }
+  return mri;
+}
+
+// ------------------------------------------------------------------
+//  thread parameterization
+// ------------------------------------------------------------------
+
+void thread_counts(benchmark::internal::Benchmark *b) {
+  b->ArgName("threads");
+  auto max_threads = omp_get_max_threads();
+  for (int n = 1; n < max_threads; n *= 2) {
+    b->Arg(n);
+  }
+  b->Arg(max_threads);
+  b->UseRealTime();
+  b->Unit(benchmark::kMillisecond);
+}
+
+// omp_set_num_threads() is a no-op without OpenMP, so the thread arguments
+// then simply repeat the serial measurement
+void set_threads(benchmark::State &state) {
+  omp_set_num_threads(static_cast<int>(state.range(0)));
+}
+
+// ------------------------------------------------------------------
+//  volume I/O and resampling
+// ------------------------------------------------------------------
+
+void BM_mghWrite(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto fname = (scratch_dir() / "write.mgz").string();
+  for (auto _ : state) { // NOLINT
+    MRIwrite(bench_volume_uchar(), fname.c_str());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          int64_t(bench_volume_uchar()->vox_total));
+}
+
+void BM_mghRead(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  const auto &fname = bench_mgz_fname();
+  for (auto _ : state) { // NOLINT
+    auto *mri = MRIread(fname.c_str());
+    benchmark::DoNotOptimize(mri);
+    MRIfree(&mri);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          int64_t(bench_volume_uchar()->vox_total));
+}
+
+void BM_MRIvol2Vol(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *src  = bench_volume();
+  auto *targ = MRIallocSequence(src->width, src->height, src->depth, MRI_FLOAT,
+                                src->nframes);
+  MRIcopyHeader(src, targ);
+
+  // small rotation about the volume center, as in a typical registration
+  auto *Vt2s  = MatrixIdentity(4, nullptr);
+  auto  theta = 5.0 * M_PI / 180.0;
+  auto  c     = 0.5 * (src->width - 1);
+  Vt2s->rptr[1][1] = cos(theta);
+  Vt2s->rptr[1][2] = -sin(theta);
+  Vt2s->rptr[2][1] = sin(theta);
+  Vt2s->rptr[2][2] = cos(theta);
+  Vt2s->rptr[1][4] = c - c * cos(theta) + c * sin(theta);
+  Vt2s->rptr[2][4] = c - c * sin(theta) - c * cos(theta);
+
+  for (auto _ : state) { // NOLINT
+    MRIvol2Vol(src, targ, Vt2s, SAMPLE_TRILINEAR, 0);
+  }
+  MatrixFree(&Vt2s);
+  MRIfree(&targ);
+}
+
+void BM_MRIconvolveGaussian(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *kernel = MRIgaussian1d(2.0F, 100);
+  auto *dst    = MRIclone(bench_volume(), nullptr);
+  for (auto _ : state) { // NOLINT
+    MRIconvolveGaussian(bench_volume(), dst, kernel);
+  }
+  MRIfree(&dst);
+  MRIfree(&kernel);
+}
+
+// ------------------------------------------------------------------
+//  atlas and morph
+// ------------------------------------------------------------------
+
+void BM_GCAread(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  const auto &fname = bench_gca_fname();
+  for (auto _ : state) { // NOLINT
+    auto *gca = GCAread(fname.c_str());
+    benchmark::DoNotOptimize(gca);
+    GCAfree(&gca);
+  }
+}
+
+void BM_GCAlabel(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *gca = bench_gca();
+  for (auto _ : state) { // NOLINT
+    auto *mri_labeled =
+        GCAlabel(bench_gca_inputs(), gca, nullptr, bench_transform());
+    benchmark::DoNotOptimize(mri_labeled);
+    MRIfree(&mri_labeled);
+  }
+}
+
+void BM_gcamComputeGradient(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *gca  = bench_gca();
+  auto *gcam = GCAMalloc(gca->prior_width, gca->prior_height, gca->prior_depth);
+  GCAMinit(gcam, bench_gca_inputs(), gca, bench_transform(), 0);
+
+  GCA_MORPH_PARMS parms;
+  memset(&parms, 0, sizeof(parms));
+  parms.l_log_likelihood = 1.0;
+  parms.l_smoothness     = 1.0;
+  parms.l_jacobian       = 1.0;
+  parms.l_label          = 1.0;
+  parms.label_dist       = 3.0;
+  parms.ratio_thresh     = 0.25;
+  parms.sigma            = 1.0;
+  parms.exp_k            = 20.0;
+  parms.navgs            = 0;
+
+  for (auto _ : state) { // NOLINT
+    gcamComputeGradient(gcam, bench_gca_inputs(), bench_gca_smooth(), &parms);
+  }
+  GCAMfree(&gcam);
+}
+
+// ------------------------------------------------------------------
+//  surfaces
+// ------------------------------------------------------------------
+
+void BM_MRIScomputeMetricProperties(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *mris = bench_surface();
+  for (auto _ : state) { // NOLINT
+    MRIScomputeMetricProperties(mris);
+  }
+  state.SetItemsProcessed(state.iterations() * mris->nvertices);
+}
+
+void BM_MHTfindClosestVertex(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *mris = bench_surface();
+  auto *mht  = MHTcreateVertexTable_Resolution(mris, CURRENT_VERTICES, 2.0F);
+
+  // query points scattered in a shell around the surface
+  std::mt19937                          rng(bench_seed);
+  std::uniform_real_distribution<float> unit(-1.0F, 1.0F);
+  std::uniform_real_distribution<float> radius(0.9F * bench_surf_rad,
+                                               1.1F * bench_surf_rad);
+  std::vector<float> pts(3 * bench_mht_npts);
+  for (int n = 0; n < bench_mht_npts; n++) {
+    float x, y, z, len;
+    do {
+      x   = unit(rng);
+      y   = unit(rng);
+      z   = unit(rng);
+      len = std::sqrt(x * x + y * y + z * z);
+    } while (len < 1e-3F || len > 1.0F);
+    auto r         = radius(rng);
+    pts[3 * n]     = r * x / len;
+    pts[3 * n + 1] = r * y / len;
+    pts[3 * n + 2] = r * z / len;
+  }
+
+  for (auto _ : state) { // NOLINT
+    long found = 0;
+    MHT_maybeParallel_begin();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for reduction(+ : found)
+#endif
+    for (int n = 0; n < bench_mht_npts; n++) {
+      float min_dist;
+      if (MHTfindClosestVertexNoXYZ(mht, mris, pts[3 * n], pts[3 * n + 1],
+                                    pts[3 * n + 2], &min_dist) >= 0) {
+        found++;
+      }
+    }
+    MHT_maybeParallel_end();
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * bench_mht_npts);
+  MHTfree(&mht);
+}
+
+void BM_MRISsmoothMRIFast(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  auto *mris = bench_surface();
+  auto *src  = bench_surface_overlay(4);
+  auto *targ = MRIcopy(src, nullptr);
+  for (auto _ : state) { // NOLINT
+    MRISsmoothMRIFast(mris, src, 10, nullptr, targ);
+  }
+  MRIfree(&targ);
+  MRIfree(&src);
+}
+
+// ------------------------------------------------------------------
+//  group analysis
+// ------------------------------------------------------------------
+
+// Voxel-wise GLM with a 4-regressor design (intercept, group, two
+// covariates) over a 40^3 x 30 subject stack, as run by mri_glmfit.
+void BM_GLMfit(benchmark::State &state) { // NOLINT
+  set_threads(state);
+  constexpr int dim = 40, nsubjects = 30, nregressors = 4;
+
+  std::mt19937                    rng(bench_seed);
+  std::normal_distribution<float> noise(0.0F, 1.0F);
+
+  auto *Xg = MatrixAlloc(nsubjects, nregressors, MATRIX_REAL);
+  for (int r = 1; r <= nsubjects; r++) {
+    Xg->rptr[r][1] = 1;
+    Xg->rptr[r][2] = (r <= nsubjects / 2) ? 1 : -1;
+    Xg->rptr[r][3] = noise(rng);
+    Xg->rptr[r][4] = noise(rng);
+  }
+
+  auto *y = MRIallocSequence(dim, dim, dim, MRI_FLOAT, nsubjects);
+  for (int f = 0; f < nsubjects; f++) {
+    for (int s = 0; s < dim; s++) {
+      for (int r = 0; r < dim; r++) {
+        for (int c = 0; c < dim; c++) {
+          MRIsetVoxVal(y, c, r, s, f,
+                       2.5 + 0.3 * Xg->rptr[f + 1][2] + noise(rng));
+        }
+      }
+    }
+  }
+
+  for (auto _ : state) { // NOLINT
+    state.PauseTiming();
+    auto *mriglm            = (MRIGLM *)calloc(sizeof(MRIGLM), 1);
+    mriglm->glm             = GLMalloc();
+    mriglm->y               = y;
+    mriglm->Xg              = MatrixCopy(Xg, nullptr);
+    mriglm->glm->ncontrasts = 2;
+    mriglm->glm->C[0]       = MatrixZero(1, nregressors, nullptr);
+    mriglm->glm->C[0]->rptr[1][2] = 1;
+    mriglm->glm->C[1]             = MatrixZero(2, nregressors, nullptr);
+    mriglm->glm->C[1]->rptr[1][3] = 1;
+    mriglm->glm->C[1]->rptr[2][4] = 1;
+    state.ResumeTiming();
+
+    MRIglmFitAndTest(mriglm);
+
+    state.PauseTiming();
+    MRIfree(&mriglm->beta);
+    MRIfree(&mriglm->eres);
+    MRIfree(&mriglm->rvar);
+    for (int n = 0; n < mriglm->glm->ncontrasts; n++) {
+      MRIfree(&mriglm->gamma[n]);
+      MRIfree(&mriglm->gammaVar[n]);
+      MRIfree(&mriglm->F[n]);
+      MRIfree(&mriglm->p[n]);
+      MRIfree(&mriglm->z[n]);
+    }
+    MatrixFree(&mriglm->Xg);
+    GLMfree(&mriglm->glm);
+    free(mriglm);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * dim * dim * dim);
+  MRIfree(&y);
+  MatrixFree(&Xg);
+}
+
+} // namespace
+
+// volume I/O and resampling
+BENCHMARK(BM_mghWrite)->Apply(thread_counts);            // NOLINT
+BENCHMARK(BM_mghRead)->Apply(thread_counts);             // NOLINT
+BENCHMARK(BM_MRIvol2Vol)->Apply(thread_counts);          // NOLINT
+BENCHMARK(BM_MRIconvolveGaussian)->Apply(thread_counts); // NOLINT
+
+// atlas and morph
+BENCHMARK(BM_GCAread)->Apply(thread_counts);             // NOLINT
+BENCHMARK(BM_GCAlabel)->Apply(thread_counts);            // NOLINT
+BENCHMARK(BM_gcamComputeGradient)->Apply(thread_counts); // NOLINT
+
+// surfaces
+BENCHMARK(BM_MRIScomputeMetricProperties)->Apply(thread_counts); // NOLINT
+BENCHMARK(BM_MHTfindClosestVertex)->Apply(thread_counts);        // NOLINT
+BENCHMARK(BM_MRISsmoothMRIFast)->Apply(thread_counts);           // NOLINT
+
+// group analysis
+BENCHMARK(BM_GLMfit)->Apply(thread_counts); // NOLINT
+
+auto main(int argc, char **argv) -> int {
+  // default to a JSON report next to the console output so that runs can be
+  // diffed; an explicit --benchmark_out on the command line wins
+  std::vector<char *> args(argv, argv + argc);
+  std::string         out_arg    = "--benchmark_out=fs_bench.json";
+  std::string         format_arg = "--benchmark_out_format=json";
+  bool                has_out    = false;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+      has_out = true;
+    }
+  }
+  if (!has_out) {
+    args.push_back(out_arg.data());
+    args.push_back(format_arg.data());
+  }
+  int nargs = static_cast<int>(args.size());
+
+  setRandomSeed(bench_seed);
+  DiagInit(nullptr, nullptr, nullptr);
+
+  ::benchmark::Initialize(&nargs, args.data());
+  if (::benchmark::ReportUnrecognizedArguments(nargs, args.data())) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+
+  std::error_code ec;
+  std::filesystem::remove_all(scratch_dir(), ec);
+  return 0;
+}
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,56 @@
+/*
+ *
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#ifndef CCLABEL_H
+#define CCLABEL_H
+
+/* Connected-component labeling shared by the volume and surface clustering
+   code. Elements in the mask are joined with a two-pass union-find; the
+   first pass runs in parallel over blocks of elements, block boundaries are
+   merged afterwards, and a final pass numbers the components and collects
+   their statistics.
+
+   Components are numbered 1..ncomponents in the order of their lowest
+   element index, so the labeling does not depend on the number of threads.
+   Every per-component array is indexed by component number and has
+   ncomponents+1 entries; entry 0 is unused. */
+typedef struct {
+  int     nelements;
+  int     ncomponents;
+  int *   id;         // component of each element, 0 if not in the mask
+  int *   size;       // number of elements
+  double *area;       // sum of the element areas, or size if none given
+  float * maxval;     // signed value of the element with the largest score
+  int *   maxelement; // element index of maxval
+  int *   first;      // lowest element index
+} CCLABELS;
+
+/* Voxel (c,r,s) is element c + width*(r + height*s). connectivity is 6, 18
+   or 26. mask is nonzero for voxels to label. val (optional) supplies the
+   values for maxval; the score of a value is val, fabs(val) or -val for
+   thsign 1, 0 and -1, ties going to the lower element index. area
+   (optional) is the per-element area or volume. */
+CCLABELS *CCLlabelVolume(const unsigned char *mask, int width, int height,
+                         int depth, int connectivity, const float *val,
+                         const float *area, int thsign);
+
+/* Same on a graph given in CSR form: the neighbors of element n are
+   adjncy[xadj[n]] .. adjncy[xadj[n+1]-1]. Edges are treated as undirected. */
+CCLABELS *CCLlabelGraph(const unsigned char *mask, int nelements,
+                        const int *xadj, const int *adjncy, const float *val,
+                        const float *area, int thsign);
+
+int CCLfree(CCLABELS **pccl);
+
+#endif
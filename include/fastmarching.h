@@ -27,6 +27,8 @@
 
 MRI *MRIextractDistanceMap(MRI *mri_src, MRI *mri_dst, int label,
                            float max_distance, int mode, MRI *mri_mask);
+MRI *MRIexactDistanceTransform(MRI *mri_src, MRI *mri_dst, int label,
+                               float max_distance, int mode);
 
 void MRISextractOutsideDistanceMap(MRIS *mris, MRI *mri_src, int label,
                                    int offset, float resolution,
@@ -64,7 +66,7 @@ typedef enum { eAlive = 0, eTrial = 1, eFar = 2, eForbidden = 3 } eState;
 template <int sign = +1> class FastMarching {
 
   // type definition for the min-heap
-  class HeapCompare : std::binary_function<stCoord, stCoord, bool> {
+  class HeapCompare {
   protected:
     MRI *mri;
 
@@ -0,0 +1,49 @@
+/*
+ *
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#ifndef FFT3D_H
+#define FFT3D_H
+
+/* Reentrant, multi-threaded 3D real-to-complex FFT of any size. Unlike
+   fftutils.cpp there is no global state besides a cache of plans, and
+   the sizes do not have to be powers of two; sizes whose only prime
+   factors are 2, 3 and 5 are the fastest (see FFT3DgoodSize()).
+
+   Transforms are in place on an FFT3Dalloc() buffer. Before the forward
+   transform voxel (x,y,z) is data[x + 2*nxc*(y + ny*z)] with
+   nxc = nx/2+1, i.e. each row is padded to 2*nxc floats. Afterwards the
+   buffer holds the nxc x ny x nz half spectrum as interleaved (re,im)
+   pairs, frequency (kx,ky,kz) at data[2*(kx + nxc*(ky + ny*kz))]. The
+   forward transform uses exp(-2*pi*i*...), the backward transform
+   exp(+2*pi*i*...) and divides by nx*ny*nz, so backward(forward(v)) = v.
+   The half spectrum passed to the backward transform must be that of a
+   real volume. */
+typedef struct FFT3D_PLAN FFT3D_PLAN;
+
+/* Returns the cached plan for this shape, building it on first use.
+   Plans stay valid until FFT3DclearPlans(). Thread safe. */
+const FFT3D_PLAN *FFT3Dplan(int nx, int ny, int nz);
+int               FFT3DclearPlans(void);
+
+/* smallest size >= n whose only prime factors are 2, 3 and 5 */
+int FFT3DgoodSize(int n);
+
+/* zeroed, 64-byte aligned buffer of 2*(nx/2+1)*ny*nz floats */
+float *FFT3Dalloc(int nx, int ny, int nz);
+int    FFT3Dfree(float **pdata);
+
+int FFT3Dforward(const FFT3D_PLAN *plan, float *data);
+int FFT3Dbackward(const FFT3D_PLAN *plan, float *data);
+
+#endif
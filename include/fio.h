@@ -49,6 +49,17 @@ int fwrite2(int v, FILE *fp);
 int fwrite3(int v, FILE *fp);
 int fwrite4(int v, FILE *fp);
 
+/* bulk versions: the whole array goes through a single fread (or a few
+   fwrite's of a staging buffer) and is byte-swapped in place, instead of one
+   stdio call per value. The readers return the number of values read, the
+   rest of the array being zeroed. */
+size_t freadFloatArray(float *buf, size_t n, FILE *fp);
+size_t freadIntArray(int *buf, size_t n, FILE *fp);
+size_t fread3Array(int *buf, size_t n, FILE *fp);
+size_t fwriteFloatArray(const float *buf, size_t n, FILE *fp);
+size_t fwriteIntArray(const int *buf, size_t n, FILE *fp);
+size_t fwrite3Array(const int *buf, size_t n, FILE *fp);
+
 /* znzlib support routines */
 int       znzread1(int *v, znzFile fp);
 int       znzread2(int *v, znzFile fp);
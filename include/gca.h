@@ -139,6 +139,8 @@ typedef struct {
   short            n_just_priors;
   int              ntraining;
   char             regularized;
+  float *          classifier; /* cached covars factorization, see
+                                  GCAbuildClassifierCache */
 } GC1D, GAUSSIAN_CLASSIFIER_1D;
 
 typedef struct {
@@ -168,6 +170,16 @@ typedef struct {
   int    total_training;
 } GCA_TISSUE_PARMS;
 
+// source voxel -> prior index map for one transform, see GCAsetVoxelMap
+typedef struct {
+  TRANSFORM *transform;
+  int        width;
+  int        height;
+  int        depth;
+  int *      prior_index; // (xp*prior_height + yp)*prior_depth + zp, or
+                          // -index-1 if the voxel maps outside the priors
+} GCA_VOXEL_MAP;
+
 typedef struct {
   float            node_spacing;  /* inter-node spacing */
   float            prior_spacing; /* inter-prior spacing */
@@ -207,6 +219,7 @@ typedef struct {
   MATRIX *      tal_i_to_r__;
   MATRIX *      tal_r_to_i__;
   MATRIX *      tmp__;
+  GCA_VOXEL_MAP *voxel_map__; // optional cache for GCAsourceVoxelToPrior
   int           total_training;
   int           max_label;
   COLOR_TABLE * ct;
@@ -315,6 +328,8 @@ int GCAsourceVoxelToNode(const GCA *gca, MRI *mri, TRANSFORM *transform, int xv,
                          int yv, int zv, int *pxn, int *pyn, int *pzn);
 int GCAsourceVoxelToPrior(const GCA *gca, MRI *mri, TRANSFORM *transform,
                           int xv, int yv, int zv, int *pxp, int *pyp, int *pzp);
+int GCAsetVoxelMap(GCA *gca, MRI *mri, TRANSFORM *transform);
+int GCAclearVoxelMap(GCA *gca);
 int GCAsourceVoxelToPriorReal(GCA *gca, MRI *mri, TRANSFORM *transform, int xv,
                               int yv, int zv, double *pxp, double *pyp,
                               double *pzp);
@@ -537,6 +552,7 @@ GCA *  GCAcreateFlashGCAfromFlashGCA(GCA *gca_parms, double *TR, double *fa,
                                      double *TE, int nflash);
 int    GCAfixSingularCovarianceMatrices(GCA *gca);
 int    GCAregularizeCovariance(GCA *gca, float regularize);
+int    GCAbuildClassifierCache(GCA *gca);
 int    GCAnormalizeMeans(GCA *gca, float target);
 double GCAcomputeConditionalLogDensity(const GC1D *gc, float *vals, int ninputs,
                                        int label);
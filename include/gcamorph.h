@@ -132,6 +132,29 @@ typedef struct {
                             label matching with distance xform */
 } GCA_MORPH_NODE, GMN;
 
+/*
+  Structure-of-arrays copy of the node fields the smoothness and jacobian
+  kernels and the line search read. Node (x,y,z) is element
+  GCAM_SOA_INDEX(soa, x, y, z), so neighbors along z are stride-1 and each
+  field is a flat 64-byte aligned array. Filled from the nodes by
+  GCAMsoaLoad(); the nodes remain the master copy, and a load stays valid
+  until the nodes move or the gradient changes.
+*/
+typedef struct {
+  int     width, height, depth;
+  size_t  nnodes;
+  double *x, *y, *z;
+  double *origx, *origy, *origz;
+  float * dx, *dy, *dz;    /* current gradient */
+  float * odx, *ody, *odz; /* previous gradient */
+  float * area, *area1, *area2;
+  float * orig_area, *orig_area1, *orig_area2;
+  char *  invalid;
+} GCA_MORPH_SOA;
+
+#define GCAM_SOA_INDEX(soa, xi, yi, zi)                                        \
+  ((((size_t)(xi) * (soa)->height) + (yi)) * (soa)->depth + (zi))
+
 typedef struct {
   int      width, height, depth;
   GCA *    gca; // using a separate GCA data (not saved)
@@ -150,6 +173,7 @@ typedef struct {
   MATRIX * m_affine; // affine transform to initialize with
   double   det;      // determinant of affine transform
   void *   vgcam_ms; // Not saved.
+  GCA_MORPH_SOA *soa; // Not saved. Hot node fields, see GCAMsoaLoad
 } GCA_MORPH, GCAM;
 
 typedef struct {
@@ -305,6 +329,11 @@ GCA_MORPH *GCAMreadAndInvertNonTal(const char *gcamfname);
 int        GCAMfree(GCA_MORPH **pgcam);
 int        GCAMfreeContents(GCA_MORPH *gcam);
 
+GCA_MORPH_SOA *GCAMsoaAlloc(int width, int height, int depth);
+int            GCAMsoaFree(GCA_MORPH_SOA **psoa);
+int            GCAMsoaLoad(const GCA_MORPH *gcam, GCA_MORPH_SOA *soa);
+GCA_MORPH_SOA *GCAMgetSoa(GCA_MORPH *gcam);
+
 MRI *GCAMmorphFromAtlas(MRI *mri_src, GCA_MORPH *gcam, MRI *mri_dst,
                         int sample_type);
 int  GCAMmorphPlistFromAtlas(int N, float *points_in, GCA_MORPH *gcam,
@@ -550,6 +579,12 @@ double gcamLabelEnergy(const GCA_MORPH *gcam, const MRI *mri,
 double gcamSmoothnessEnergy(const GCA_MORPH *gcam, const MRI *mri);
 
 double gcamComputeSSE(GCA_MORPH *gcam, MRI *mri, GCA_MORPH_PARMS *parms);
+//! SSE for several time steps as though the gradient were applied
+int gcamComputeSSE_asThoughGradientApplied(GCA_MORPH *gcam,
+                                           const GCA_MORPH_SOA *soa, MRI *mri,
+                                           GCA_MORPH_PARMS *parms, int ndt,
+                                           const double *dts, double *sse,
+                                           int *neg);
 
 int gcamSuppressNegativeGradients(GCA_MORPH *gcam, float scale);
 
@@ -569,6 +604,12 @@ int gcamJacobianTermAtNode(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
 int gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
                      double ratio_thresh);
 
+//! The smoothness and jacobian terms reading positions from a loaded soa
+int gcamSmoothnessTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+                          double l_smoothness);
+int gcamJacobianTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+                        double l_jacobian, double ratio_thresh);
+
 int gcamLabelTerm(GCA_MORPH *gcam, const MRI *mri, double l_label,
                   double label_dist, MRI *mri_twm);
 
@@ -18,6 +18,28 @@ typedef struct {
 // computes and returns the nearest geodesics for every vertex in the surface:
 Geodesics *computeGeodesics(MRIS *surf, float maxdist);
 
+// Compressed sparse row geodesics: the neighbors of vertex vno are
+// v[offset[vno]] .. v[offset[vno+1]-1], with matching dist[] entries.
+// When read with geodesicsCSRRead() the arrays point into a read-only
+// mapping of the file, so a precomputed neighborhood loads without copying.
+typedef struct {
+  int      nvertices;
+  int64_t  nnbrs;    // total number of neighbor entries
+  int64_t *offset;   // nvertices+1 row offsets into v and dist
+  int *    v;        // neighbor vertex numbers
+  float *  dist;     // geodesic distances to the neighbors
+  void *   map;      // file mapping backing the arrays, or NULL
+  size_t   mapsize;
+} GeodesicsCSR;
+
+// computes the nearest geodesics of every vertex in parallel:
+GeodesicsCSR *computeGeodesicsCSR(MRIS *surf, float maxdist);
+void          geodesicsCSRFree(GeodesicsCSR **pgeo);
+int           geodesicsCSRWrite(const GeodesicsCSR *geo, const char *fname);
+GeodesicsCSR *geodesicsCSRRead(const char *fname);
+GeodesicsCSR *geodesicsCSRFromGeodesics(Geodesics *geo, int nvertices);
+Geodesics *   geodesicsFromCSR(const GeodesicsCSR *geo);
+
 // save/load geodesics:
 void       geodesicsWrite(Geodesics *geo, int nvertices, char *fname);
 Geodesics *geodesicsRead(char *fname, int *nvertices);
@@ -31,6 +53,8 @@ typedef struct {
 
 MRI *      GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
                      MRI *volindex, MRI *out);
+MRI *      GeoSmoothCSR(MRI *src, double fwhm, MRIS *surf,
+                        const GeodesicsCSR *geod, MRI *volindex, MRI *out);
 int        GeoCount(Geodesics *geod, int nvertices);
 int        GeoDumpVertex(char *fname, Geodesics *geod, int vtxno);
 int        geodesicsWriteV2(Geodesics *geo, int nvertices, char *fname);
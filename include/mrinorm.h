@@ -118,6 +118,8 @@ MRI *MRI3dGentleNormalize(MRI *mri_src, MRI *mri_bias, float wm_target,
 MRI *MRIbuildVoronoiDiagram(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst);
 MRI *MRIsoapBubble(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter,
                    float min_change);
+MRI *MRIsoapBubbleMultigrid(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,
+                            float min_change);
 MRI *MRIsoapBubbleExpand(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter);
 int  MRI3dUseFileControlPoints(MRI *mri, const char *fname);
 int  MRI3dUseLabelControlPoints(MRI *mri, LABEL *area);
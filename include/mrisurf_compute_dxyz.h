@@ -91,3 +91,22 @@ void mrisComputeTangentialSpringTerm(MRIS *mris, double l_spring);
 void vertexComputeTangentialSpringTerm(MRIS *mris, int vno, float *dx,
                                        float *dy, float *dz,
                                        double l_spring = 1.0);
+
+// neighborhood terms that mrisComputeLocalTerms evaluates in a single sweep
+typedef enum {
+  MRIS_LOCAL_SPRING,                      // l_spring
+  MRIS_LOCAL_LAPLACIAN,                   // l_lap
+  MRIS_LOCAL_NORMAL_SPRING,               // l_nspring
+  MRIS_LOCAL_TANGENTIAL_SPRING,           // l_tspring
+  MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING, // l_nltspring, min_dist
+  MRIS_LOCAL_NONLINEAR_SPRING,            // l_nlspring, rmin, rmax
+  MRIS_LOCAL_DISTANCE,                    // l_nldist then l_dist
+  MRIS_LOCAL_SPHERE,                      // l_sphere, a, explode_flag
+  MRIS_LOCAL_EXPANSION,                   // l_expand
+  MRIS_LOCAL_CONVEXITY,                   // l_convex
+  MRIS_LOCAL_NTERMS
+} MRIS_LOCAL_TERM;
+
+// terms == NULL evaluates every term in the order above
+int mrisComputeLocalTerms(MRIS *mris, INTEGRATION_PARMS *parms,
+                          MRIS_LOCAL_TERM const *terms, int nterms);
@@ -49,6 +49,9 @@ void MRIS_check_vertexNeighbours(MRIS *mris);
 
 void MRIS_setNsizeCur(MRIS *mris, int vno, int nsize);
 
+// MRISfindNeighborsAtVertex for every vertex, in parallel
+void MRISfindNeighborsAtAllVertices(MRIS *mris, int nlinks);
+
 // Vertices and Faces interact via edges
 //
 int mrisCountValidLinks(MRIS *mris, int vno1, int vno2);
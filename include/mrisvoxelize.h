@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#ifndef MRISVOXELIZE_H
+#define MRISVOXELIZE_H
+
+#include "mri.h"
+#include "mrisurf.h"
+
+/* Voxelizes closed surfaces on the grid of mri_template. A voxel is inside
+   a surface if a ray from it along the column axis crosses the surface an
+   odd number of times. The crossings of every scanline are found exactly,
+   with ties on shared edges and vertices broken consistently, so there are
+   no leaks and no flood fill. The unsigned distance is the exact distance
+   from the voxel center to the nearest face, found with a bounding volume
+   hierarchy of the faces, but only in a narrow band of cap voxels around
+   the surface. Distances are in voxels; the surfaces are not modified.
+
+   All surfaces are done in one pass, in parallel over surfaces and slices,
+   and the output does not depend on the number of threads.
+
+   dist and interior are arrays of nsurfs volumes, either may be NULL.
+   dist[n] is the signed distance to surfs[n], positive inside and clipped
+   to +-cap. interior[n] is 1 inside surfs[n] and 0 outside. NULL entries
+   are allocated (MRI_FLOAT and MRI_UCHAR with the header of mri_template),
+   given entries must have that type and size. */
+int MRISvoxelizeSurfaces(MRI_SURFACE **surfs, int nsurfs, MRI *mri_template,
+                         float cap, MRI **dist, MRI **interior);
+
+#endif
@@ -94,6 +94,30 @@ MRI *vol2surf_linear(MRI *SrcVol, MATRIX *Qsrc, MATRIX *Fsrc, MATRIX *Wsrc,
                      int InterpMethod, int float2int, MRI *SrcHitVol,
                      int ProjDistFlag, int nskip);
 
+/* Sparse (vertex,depth) x voxel sampling operator used to project a
+   multi-frame volume onto a surface at several depths at once. Row
+   vtx*ndepths+d holds nweights voxel offsets (c + width*(r + height*s))
+   and weights into one frame of the source volume. */
+typedef struct {
+  int    nvertices;
+  int    ndepths;
+  int    nweights;             // 1 for nearest, 8 for trilinear
+  int    width, height, depth; // source geometry it was built for
+  float *depths;               // ProjFrac of each depth
+  int *  voxel;
+  float *weight;
+  int *  hit;     // nearest voxel of each row, -1 if out of the volume
+  char * outside; // rows that sample the source outside_val instead
+} VOL2SURF_OPERATOR;
+
+VOL2SURF_OPERATOR *vol2surf_operator_alloc(
+    MRI *SrcVol, MATRIX *Qsrc, MATRIX *Fsrc, MATRIX *Wsrc, MATRIX *Dsrc,
+    MRI_SURFACE *TrgSurf, float ProjFracMin, float ProjFracMax,
+    float ProjFracDelta, int InterpMethod, int float2int, int ProjDistFlag);
+int  vol2surf_operator_free(VOL2SURF_OPERATOR **pop);
+MRI *vol2surf_operator_apply(const VOL2SURF_OPERATOR *op, MRI *SrcVol,
+                             int GetProjMax, MRI *SrcHitVol, MRI *TrgVol);
+
 MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
                   int ReverseMapFlag, int DoJac, int UseHash);
 MRI *surf2surf_nnfr(MRI *SrcSurfVals, MRI_SURFACE *SrcSurfReg,
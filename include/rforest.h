@@ -53,6 +53,22 @@ typedef struct {
   NODE **leaves;
 } TREE;
 
+// contiguous copy of the trees of a forest, see RFflatten()
+typedef struct {
+  int    feature; // feature to split on, -1 at a leaf
+  int    child;   // left child (the right one follows it), or the leaf's row
+                  // in leaf_counts
+  double thresh;
+} RF_FLAT_NODE;
+
+typedef struct {
+  int           nnodes;
+  RF_FLAT_NODE *nodes;
+  int *         roots; // per tree root node, -1 if the tree isn't used
+  int           nleaves;
+  int *         leaf_counts; // nleaves x nclasses class counts
+} RF_FLAT;
+
 typedef struct {
   int      nfeatures;
   int      nclasses;
@@ -74,7 +90,8 @@ typedef struct {
   char **feature_names; // for diags
   double
       max_class_ratio; // don't let there be way more of one class than another
-  double *pvals;       // classification probabilities
+  double * pvals;      // classification probabilities
+  RF_FLAT *flat;       // built by RFflatten(), NULL until then
 } RANDOM_FOREST, RF;
 
 RANDOM_FOREST *RFalloc(int ntrees, int nfeatures, int nclasses, int max_depth,
@@ -88,6 +105,9 @@ int            RFwrite(RANDOM_FOREST *rf, char *fname);
 int            RFwriteInto(RANDOM_FOREST *rf, FILE *fp);
 int            RFclassify(RANDOM_FOREST *rf, double *feature, double *p_pval,
                           int true_class);
+int            RFflatten(RANDOM_FOREST *rf);
+int            RFclassifyBatch(RANDOM_FOREST *rf, double **features,
+                               int nsamples, int *classes, double *pvals);
 int RFcomputeOutOfBagCorrect(RANDOM_FOREST *rf, int *training_classes,
                              double **training_data, int ntraining);
 int RFtrainTree(RANDOM_FOREST *rf, int tno, int *training_classes,
@@ -57,6 +57,8 @@ typedef struct {
 SCS *  sclustMapSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax,
                              int thsign, float minarea, int *nClusters,
                              MATRIX *XFM, MRI *fwhmmap);
+int    sclustLabelSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax,
+                               int thsign, float minarea);
 int    sclustGrowSurfCluster(int ClustNo, int SeedVtx, MRI_SURFACE *Surf,
                              float thmin, float thmax, int thsign);
 float  sclustSurfaceArea(int ClusterNo, MRI_SURFACE *Surf, int *nvtxs);
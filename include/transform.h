@@ -178,6 +178,37 @@ int TransformSampleInverseFloat(const TRANSFORM *transform, float xv, float yv,
 int TransformSampleInverseVoxel(TRANSFORM *transform, int width, int height,
                                 int depth, int xv, int yv, int zv, int *px,
                                 int *py, int *pz);
+
+/* Reentrant evaluation of a TRANSFORM. TransformEvaluatorInit() does
+   once what the TransformSample*() functions do on every call (converting
+   an LTA to vox2vox) and copies the affines into the evaluator, so after
+   that an evaluator holds no pointers to scratch and can be used by any
+   number of threads at once, as long as the TRANSFORM is not changed.
+   It is a plain value, there is nothing to free. */
+typedef struct {
+  int         type;        // MORPH_3D_TYPE or LINEAR_VOX_TO_VOX
+  float       L[3][4];     // source voxel -> atlas voxel
+  float       L_inv[3][4]; // atlas voxel -> source voxel
+  const void *gcam;        // the GCA_MORPH of a MORPH_3D_TYPE
+  const MRI * mri_xind;    // its inverse, NULL if not inverted
+  const MRI * mri_yind;
+  const MRI * mri_zind;
+  int         spacing;
+} TRANSFORM_EVALUATOR;
+
+/* what TransformEvaluate() computes, same as the function named */
+#define TE_SAMPLE               0 // TransformSample()
+#define TE_SAMPLE_REAL          1 // TransformSampleReal()
+#define TE_SAMPLE_REAL2         2 // TransformSampleReal2()
+#define TE_SAMPLE_INVERSE       3 // TransformSampleInverse(), input truncated
+#define TE_SAMPLE_INVERSE_FLOAT 4 // TransformSampleInverseFloat()
+
+int TransformEvaluatorInit(TRANSFORM_EVALUATOR *te, const TRANSFORM *transform);
+int TransformEvaluate(const TRANSFORM_EVALUATOR *te, int which, float xv,
+                      float yv, float zv, float *px, float *py, float *pz);
+int TransformEvaluateArray(const TRANSFORM_EVALUATOR *te, int which,
+                           int npoints, const float *src, float *dst,
+                           int *errors);
 TRANSFORM *TransformAlloc(int type, MRI *mri);
 TRANSFORM *TransformCopy(const TRANSFORM *tsrc, TRANSFORM *tdst);
 TRANSFORM *TransformConcat(TRANSFORM **trxArray, unsigned numTrx);
@@ -60,6 +60,8 @@ int  clustDumpCluster(FILE *fp, VOLCLUSTER *vc, MRI *vol, int frame);
 int  clustAddMember(VOLCLUSTER *vc, int col, int row, int slc);
 
 VOLCLUSTER *clustGrow(int col0, int row0, int slc0, MRI *HitMap, int AllowDiag);
+VOLCLUSTER **clustGrowAll(MRI *HitMap, int AllowDiag, int *nClusters);
+int          clustUseOldGrow(void);
 int clustGrowOneVoxel(VOLCLUSTER *vc, int col0, int row0, int slc0, MRI *HitMap,
                       int AllowDiag);
 
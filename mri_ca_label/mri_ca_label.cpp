@@ -593,6 +593,9 @@ int main(int argc, char *argv[]) {
   } else {
     transform = TransformAlloc(LINEAR_VOX_TO_VOX, NULL);
   }
+  // every labeling pass below maps the inputs through the same transform
+  if (!getenv("FREESURFER_OLD_GCAsourceVoxelToPrior"))
+    GCAsetVoxelMap(gca, mri_inputs, transform);
 
   if (Ggca_x >= 0 && Gx < 0) {
     GCAsourceVoxelToNode(gca, mri_inputs, transform, Ggca_x, Ggca_y, Ggca_z,
@@ -777,6 +780,8 @@ int main(int argc, char *argv[]) {
         if (read_renorm_fname) {
           GCAfree(&gca);
           gca = GCAread(read_renorm_fname);
+          if (!getenv("FREESURFER_OLD_GCAsourceVoxelToPrior"))
+            GCAsetVoxelMap(gca, mri_inputs, transform);
         } else {
           // initial call (returning the label_* infos)
           GCAcomputeRenormalizationWithAlignment(
@@ -43,6 +43,9 @@ static void print_help();
 static void print_version();
 static void argnerr(char *option, int n);
 static void dump_options(FILE *fp);
+static MRI *ReadInput(int nthin);
+static int  CanStream();
+static MRI *StreamReduce(int nc, int nr, int ns, int *pnframes);
 // static int  singledash(char *flag);
 
 int main(int argc, char *argv[]);
@@ -106,6 +109,7 @@ MRI * PCAMask     = nullptr;
 char *PCAMaskFile = nullptr;
 int   DoSCM       = 0; // spat cor matrix
 int   DoCheck     = 1;
+int   DoStream    = 1; // fold inputs into running reductions when possible
 int   DoTAR1 = 0, TAR1DOFAdjust = 1;
 int   NReplications = 0;
 
@@ -238,71 +242,51 @@ int main(int argc, char **argv) {
     }
   }
 
-  printf("Allocing output\n");
-  fflush(stdout);
-  int datatype = MRI_FLOAT;
-  if (DoKeepDatatype) {
-    datatype = inputDatatype;
-  }
-  if (DoRMS) {
-    // RMS always has single frame output
-    mriout = MRIallocSequence(nc, nr, ns, datatype, 1);
+  if (DoStream && CanStream()) {
+    printf("Streaming %d inputs into running reduction\n", ninputs);
+    fflush(stdout);
+    mriout = StreamReduce(nc, nr, ns, &nframes);
   } else {
-    mriout = MRIallocSequence(nc, nr, ns, datatype, nframestot);
-  }
-  if (mriout == nullptr) {
-    exit(1);
-  }
-  printf("Done allocing\n");
-
-  fout = 0;
-  for (nthin = 0; nthin < ninputs; nthin++) {
-    if (DoRMS)
-      break; // MRIrms reads the input frames
-    if (Gdiag_no > 0 || debug) {
-      printf("Loading %dth input %s\n", nthin + 1,
-             fio_basename(inlist[nthin], nullptr));
-      fflush(stdout);
+    DoStream = 0;
+    printf("Allocing output\n");
+    fflush(stdout);
+    int datatype = MRI_FLOAT;
+    if (DoKeepDatatype) {
+      datatype = inputDatatype;
     }
-    mritmp = MRIread(inlist[nthin]);
-    if (mritmp == nullptr) {
-      printf("ERROR: loading %s\n", inlist[nthin]);
-      exit(1);
-    }
-    if (nthin == 0) {
-      MRIcopyHeader(mritmp, mriout);
-      // mriout->nframes = nframestot;
-    }
-    if (DoAbs) {
-      if (Gdiag_no > 0 || debug) {
-        printf("Removing sign from input\n");
-      }
-      MRIabs(mritmp, mritmp);
+    if (DoRMS) {
+      // RMS always has single frame output
+      mriout = MRIallocSequence(nc, nr, ns, datatype, 1);
+    } else {
+      mriout = MRIallocSequence(nc, nr, ns, datatype, nframestot);
     }
-    if (DoPos) {
-      if (Gdiag_no > 0 || debug) {
-        printf("Setting input negatives to 0.\n");
-      }
-      MRIpos(mritmp, mritmp);
+    if (mriout == nullptr) {
+      exit(1);
     }
-    if (DoNeg) {
-      if (Gdiag_no > 0 || debug) {
-        printf("Setting input positives to 0.\n");
+    printf("Done allocing\n");
+
+    fout = 0;
+    for (nthin = 0; nthin < ninputs; nthin++) {
+      if (DoRMS)
+        break; // MRIrms reads the input frames
+      mritmp = ReadInput(nthin);
+      if (nthin == 0) {
+        MRIcopyHeader(mritmp, mriout);
+        // mriout->nframes = nframestot;
       }
-      MRIneg(mritmp, mritmp);
-    }
-    for (f = 0; f < mritmp->nframes; f++) {
-      for (c = 0; c < nc; c++) {
-        for (r = 0; r < nr; r++) {
-          for (s = 0; s < ns; s++) {
-            v = MRIgetVoxVal(mritmp, c, r, s, f);
-            MRIsetVoxVal(mriout, c, r, s, fout, v);
+      for (f = 0; f < mritmp->nframes; f++) {
+        for (c = 0; c < nc; c++) {
+          for (r = 0; r < nr; r++) {
+            for (s = 0; s < ns; s++) {
+              v = MRIgetVoxVal(mritmp, c, r, s, f);
+              MRIsetVoxVal(mriout, c, r, s, fout, v);
+            }
           }
         }
+        fout++;
       }
-      fout++;
+      MRIfree(&mritmp);
     }
-    MRIfree(&mritmp);
   }
 
   if (DoCombine) {
@@ -411,15 +395,16 @@ int main(int argc, char **argv) {
     MRIfree(&mriout);
     mriout = mritmp;
   }
-  nframes = mriout->nframes;
+  if (!DoStream)
+    nframes = mriout->nframes;
   printf("nframes = %d\n", nframes);
 
   if (DoBonfCor) {
     DoAdd  = 1;
-    AddVal = -log10(mriout->nframes);
+    AddVal = -log10(nframes);
   }
 
-  if (DoMean) {
+  if (DoMean && !DoStream) {
     printf("Computing mean across frames\n");
     mritmp = MRIframeMean(mriout, nullptr);
     MRIfree(&mriout);
@@ -431,14 +416,14 @@ int main(int argc, char **argv) {
     MRIfree(&mriout);
     mriout = mritmp;
   }
-  if (DoMeanDivN) {
+  if (DoMeanDivN && !DoStream) {
     printf("Computing mean2 = sum/(nframes^2)\n");
     mritmp = MRIframeSum(mriout, nullptr);
     MRIfree(&mriout);
     mriout = mritmp;
     MRImultiplyConst(mriout, 1.0 / (nframes * nframes), mriout);
   }
-  if (DoSum) {
+  if (DoSum && !DoStream) {
     printf("Computing sum across frames\n");
     mritmp = MRIframeSum(mriout, nullptr);
     MRIfree(&mriout);
@@ -457,7 +442,7 @@ int main(int argc, char **argv) {
     mriout = mritmp;
   }
 
-  if (DoStd || DoVar) {
+  if ((DoStd || DoVar) && !DoStream) {
     printf("Computing std/var across frames\n");
     if (mriout->nframes < 2) {
       printf("ERROR: cannot compute std from one frame\n");
@@ -472,7 +457,7 @@ int main(int argc, char **argv) {
     mriout = mritmp;
   }
 
-  if (DoMax) {
+  if (DoMax && !DoStream) {
     printf("Computing max across all frames \n");
     mritmp = MRIvolMax(mriout, nullptr);
     MRIfree(&mriout);
@@ -527,7 +512,7 @@ int main(int argc, char **argv) {
     mriout = mritmp;
   }
 
-  if (DoMin) {
+  if (DoMin && !DoStream) {
     printf("Computing min across all frames \n");
     mritmp = MRIvolMin(mriout, nullptr);
     MRIfree(&mriout);
@@ -685,6 +670,8 @@ static int parse_commandline(int argc, char **argv) {
       DoCheck = 1;
     } else if (!strcasecmp(option, "--no-check")) {
       DoCheck = 0;
+    } else if (!strcasecmp(option, "--no-stream")) {
+      DoStream = 0;
     } else if (!strcasecmp(option, "--mean")) {
       DoMean = 1;
     } else if (!strcasecmp(option, "--median")) {
@@ -979,6 +966,8 @@ static void print_usage() {
   printf("   --rms : root mean square (eg. combine memprage)\n");
   printf("           (square, sum, div-by-nframes, square root)\n");
   printf("   --no-check : do not check inputs (faster)\n");
+  printf("   --no-stream : always load all inputs into one volume before\n");
+  printf("                 computing --mean, --sum, --std, --max, etc\n");
   printf("   --help      print out information on how to use this program\n");
   printf("   --version   print out version and exit\n");
   printf("\n");
@@ -1076,6 +1065,162 @@ static void check_options() {
 /* --------------------------------------------- */
 static void dump_options(FILE *fp) { return; }
 
+/* --------------------------------------------- */
+// Loads the nth input and applies --abs/--pos/--neg to it.
+static MRI *ReadInput(int nthin) {
+  MRI *mri;
+
+  if (Gdiag_no > 0 || debug) {
+    printf("Loading %dth input %s\n", nthin + 1,
+           fio_basename(inlist[nthin], nullptr));
+    fflush(stdout);
+  }
+  mri = MRIread(inlist[nthin]);
+  if (mri == nullptr) {
+    printf("ERROR: loading %s\n", inlist[nthin]);
+    exit(1);
+  }
+  if (DoAbs) {
+    if (Gdiag_no > 0 || debug) {
+      printf("Removing sign from input\n");
+    }
+    MRIabs(mri, mri);
+  }
+  if (DoPos) {
+    if (Gdiag_no > 0 || debug) {
+      printf("Setting input negatives to 0.\n");
+    }
+    MRIpos(mri, mri);
+  }
+  if (DoNeg) {
+    if (Gdiag_no > 0 || debug) {
+      printf("Setting input positives to 0.\n");
+    }
+    MRIneg(mri, mri);
+  }
+  return (mri);
+}
+
+/* --------------------------------------------- */
+// True when the output is a single frame-wise reduction (mean, sum,
+// mean-div-n, std, var, max or min) of the raw inputs, so the inputs can
+// be folded in one at a time instead of stacking all nframestot frames.
+// Anything that needs the whole stack (median, pca, matrix, pairs, ...)
+// or a non-float stack (--keep-datatype) falls back to the full stack.
+static int CanStream() {
+  int nreductions = DoMean + DoSum + DoMeanDivN + DoStd + DoVar + DoMax + DoMin;
+
+  if (nreductions != 1 || DoKeepDatatype || DoRMS)
+    return (0);
+  if (DoCombine || DoPrune || DoNormMean || DoNorm1 || DoASL || M != nullptr ||
+      DoPaired || DoMedian || DoFNorm || DoTAR1 || DoMaxIndex ||
+      DoConjunction || DoSort || DoVote || DoSCM || DoPCA)
+    return (0);
+  return (1);
+}
+
+/* --------------------------------------------- */
+// Folds each frame of each input into running per-voxel reductions
+// (sum, Welford mean/M2, min/max) so only the reduction is kept in
+// memory. While one input is being folded in, the next one is read and
+// decompressed by a second thread. The folding order within each voxel
+// is the frame order, as with the stacked volume, so sum, mean, max and
+// min match the non-streaming results exactly.
+static MRI *StreamReduce(int nc, int nr, int ns, int *pnframes) {
+  size_t const nvox = (size_t)nc * nr * ns;
+  double *     acc  = (double *)calloc(nvox, sizeof(double));
+  double *     m2   = nullptr;
+  MRI *        cur, *next, *result;
+  int          nthin, nframes = 0;
+
+  if (DoStd || DoVar)
+    m2 = (double *)calloc(nvox, sizeof(double));
+  if (acc == nullptr || ((DoStd || DoVar) && m2 == nullptr)) {
+    printf("ERROR: could not alloc reduction buffers\n");
+    exit(1);
+  }
+
+  cur    = ReadInput(0);
+  result = MRIallocSequence(nc, nr, ns, MRI_FLOAT, 1);
+  if (result == nullptr)
+    exit(1);
+  MRIcopyHeader(cur, result);
+
+  for (nthin = 0; nthin < ninputs; nthin++) {
+    next = nullptr;
+#ifdef HAVE_OPENMP
+#pragma omp parallel sections num_threads(2)
+#endif
+    {
+#ifdef HAVE_OPENMP
+#pragma omp section
+#endif
+      {
+        if (nthin + 1 < ninputs)
+          next = ReadInput(nthin + 1);
+      }
+#ifdef HAVE_OPENMP
+#pragma omp section
+#endif
+      {
+        for (int f = 0; f < cur->nframes; f++) {
+          int const n = nframes + f + 1; // frames seen, including this one
+          for (int s = 0; s < ns; s++) {
+            for (int r = 0; r < nr; r++) {
+              size_t k = ((size_t)s * nr + r) * nc;
+              for (int c = 0; c < nc; c++, k++) {
+                double const v = MRIgetVoxVal(cur, c, r, s, f);
+                if (DoMean || DoSum || DoMeanDivN)
+                  acc[k] += v;
+                else if (DoStd || DoVar) {
+                  double const delta = v - acc[k];
+                  acc[k] += delta / n;
+                  m2[k] += delta * (v - acc[k]);
+                } else if (n == 1)
+                  acc[k] = v;
+                else if (DoMax ? (acc[k] < v) : (acc[k] > v))
+                  acc[k] = v;
+              }
+            }
+          }
+        }
+      }
+    }
+    nframes += cur->nframes;
+    MRIfree(&cur);
+    cur = next;
+  }
+
+  if ((DoStd || DoVar) && nframes < 2) {
+    printf("ERROR: cannot compute std from one frame\n");
+    exit(1);
+  }
+
+  for (int s = 0; s < ns; s++) {
+    for (int r = 0; r < nr; r++) {
+      size_t k = ((size_t)s * nr + r) * nc;
+      for (int c = 0; c < nc; c++, k++) {
+        double v = acc[k];
+        if (DoMean)
+          v /= nframes;
+        else if (DoStd || DoVar) {
+          v = m2[k] / (nframes - 1);
+          if (DoStd)
+            v = sqrt(v);
+        }
+        MRIsetVoxVal(result, c, r, s, 0, v);
+      }
+    }
+  }
+  if (DoMeanDivN)
+    MRImultiplyConst(result, 1.0 / (nframes * nframes), result);
+
+  free(acc);
+  free(m2);
+  *pnframes = nframes;
+  return (result);
+}
+
 MATRIX *GroupedMeanMatrix(int ngroups, int ntotal) {
   int     nper, r, c;
   MATRIX *M;
@@ -3,3 +3,19 @@ source "$(dirname $0)/test_main.sh"
 
 test_command mri_concat std.rh.*.mgh --o rhout.mgh
 compare_vol rhout.mgh rhout.ref.mgh
+
+# the frame-wise reductions fold the inputs in one at a time; they must give
+# the stacked results, exactly for mean and max, and up to rounding for the
+# single-pass std and var
+if [ "$FSTEST_REGENERATE" != true ]; then
+  mri_diff=$(find_path $FSTEST_CWD mri_diff/mri_diff)
+  FSTEST_NO_DATA_RESET=1
+  for op in mean max std var; do
+    test_command "mri_concat std.rh.*.mgh --$op --o $op.stream.mgh | tee $op.log"
+    eval_cmd grep -q Streaming $op.log
+    test_command mri_concat std.rh.*.mgh --$op --no-stream --o $op.stack.mgh
+    thresh=0
+    if [ $op = std ] || [ $op = var ]; then thresh=1e-4; fi
+    eval_cmd $mri_diff $op.stream.mgh $op.stack.mgh --thresh $thresh --debug
+  done
+fi
@@ -22,9 +22,14 @@
  *
  */
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "MC.h"
 #include "MRIio_old.h"
 #include "mrisurf.h"
+#include "romp_support.h"
 #include "tags.h"
 #include "version.h"
 
@@ -369,14 +374,15 @@ void reallocateFaces(tesselation_parms *parms) {
   parms->face = tmp;
 }
 
+static void completeTesselation(tesselation_parms *parms, MRIS *mris);
+
 int saveTesselation2(tesselation_parms *parms) {
-  int               vno, m, n, fno;
+  int               vno, m, n;
   int               nVFMultiplier = 1;
   quad_face_type *  face2;
   quad_vertex_type *vertex2;
   MRIS *            mris;
-  FACE *            face;
-  float             x, y, z, xhi, xlo, yhi, ylo, zhi, zlo;
+  float             x, y, z;
   float             st, ps, xx1, yy0, zz1;
   float             j, i, imnr;
   double            xw, yw, zw;
@@ -432,6 +438,17 @@ int saveTesselation2(tesselation_parms *parms) {
       mris->vertices_topology[mris->faces[m].v[n]].num++;
   }
 
+  completeTesselation(parms, mris);
+  return (NO_ERROR);
+}
+
+/*builds the vertex face lists and the metric properties of a surface whose
+  vertex positions, faces and vertex face counts (num) are set*/
+static void completeTesselation(tesselation_parms *parms, MRIS *mris) {
+  int   vno, m, n, fno;
+  FACE *face;
+  float x, y, z, xhi, xlo, yhi, ylo, zhi, zlo;
+
   /*allocate indices & faces for each vertex*/
   for (vno = 0; vno < mris->nvertices; vno++) {
     // vertex = &mris->vertices[vno] ;
@@ -542,10 +559,9 @@ int saveTesselation2(tesselation_parms *parms) {
   }
 #endif
 
-  return (NO_ERROR);
 }
 
-void generateMCtesselation(tesselation_parms *parms) {
+static void generateMCtesselationOld(tesselation_parms *parms) {
   int  i, j, k, width, imgsize, *tab1, *tab2, ref, ind, nf, p;
   int  xmin, ymin, zmin, xmax, ymax, zmax;
   int  vt[12], *vk1, *vk2, *vj1, *vj2, *tmp;
@@ -793,6 +809,299 @@ void generateMCtesselation(tesselation_parms *parms) {
   fprintf(stderr, "done\n");
 }
 
+/* The marching cubes vertices lie on the voxel edges, and each one is
+   created by the last cube (in k, j, i order) sharing its edge: edge 7 for
+   the edges along k, edges 10 and 11 for the edges in the top plane of the
+   cube. A slab of cubes [k0,k1) therefore creates exactly the vertices and
+   faces that the serial scan creates for these slices, in the same order,
+   and concatenating the slabs gives the serial numbering. The only shared
+   vertices a slab does not create are those on the edges of its bottom
+   plane k0 (cube edges 0-3); they are stored as MC_EXTERNAL(edge) and
+   resolved with the sorted top plane edges of the slab below. An edge is
+   2*(i+width*j) for the edge along i and 2*(i+width*j)+1 for the edge
+   along j starting at voxel (i,j) of the plane. */
+#define MC_EXTERNAL(edge) (-2 - (edge))
+
+typedef struct mc_slab_ {
+  int                              k0, k1;
+  std::vector<float>               vertex; /* (i, j, imnr) triples */
+  std::vector<int>                 face;   /* local vertex or MC_EXTERNAL */
+  std::vector<std::pair<int, int>> top;    /* (edge, vertex) in plane k1 */
+} mc_slab;
+
+/*bits 0-3 of the cube index: voxels (i,j), (i+1,j), (i,j+1), (i+1,j+1)*/
+static int mcSliceCorners(MRI *mri, int i, int j, int k) {
+  int bits = 0;
+
+  if (k < 0 || k >= mri->depth)
+    return (0);
+  if (MRIvox(mri, i, j, k))
+    bits += 1;
+  if (((i + 1) < mri->width) && MRIvox(mri, i + 1, j, k))
+    bits += 2;
+  if (((j + 1) < mri->height) && MRIvox(mri, i, j + 1, k))
+    bits += 4;
+  if (((j + 1) < mri->height) && ((i + 1) < mri->width) &&
+      MRIvox(mri, i + 1, j + 1, k))
+    bits += 8;
+  return (bits);
+}
+
+static int mcAddVertex(mc_slab *slab, float i, float j, float imnr) {
+  slab->vertex.push_back(i);
+  slab->vertex.push_back(j);
+  slab->vertex.push_back(imnr);
+  return (int)(slab->vertex.size() / 3 - 1);
+}
+
+static void mcTesselateSlab(tesselation_parms *parms, MRI *mri,
+                            int (*table)[19], mc_slab *slab) {
+  int  i, j, k, width, imgsize, *tab1, *tab2, ref, ind, nf, p;
+  int  xmin, ymin, xmax, ymax;
+  int  vt[12], *vk1, *vk2, *vj1, *vj2, *tmp;
+  int  vind[12];
+  int  f_c[12] = {0, 1, 2 * mri->width, 3, 0, 1, 0, 1, 0, 1, 2 * mri->width, 3};
+
+  width   = mri->width;
+  imgsize = mri->width * mri->height;
+
+  xmin = parms->xmin;
+  ymin = parms->ymin;
+  xmax = parms->xmax;
+  ymax = parms->ymax;
+
+  tab1 = (int *)malloc(imgsize * sizeof(int));
+  tab2 = (int *)malloc(imgsize * sizeof(int));
+  vk1  = (int *)malloc(2 * imgsize * sizeof(int));
+  vk2  = (int *)malloc(2 * imgsize * sizeof(int));
+  vj1  = (int *)malloc(width * sizeof(int));
+  vj2  = (int *)malloc(width * sizeof(int));
+  if (!tab1 || !tab2 || !vk1 || !vk2 || !vj1 || !vj2)
+    ErrorExit(ERROR_NOMEMORY, "%s: could not allocate slab tables", Progname);
+  memset(vk1, -1, 2 * imgsize * sizeof(int));
+  memset(vk2, -1, 2 * imgsize * sizeof(int));
+  memset(vj1, -1, width * sizeof(int));
+  memset(vj2, -1, width * sizeof(int));
+
+  // the bottom plane of the cubes, which the serial scan carries over and
+  // starts from zero (zmin is one below the label, possibly slice -1)
+  memset(tab1, 0, imgsize * sizeof(int));
+  if (slab->k0 > parms->zmin)
+    for (j = ymin; j < ymax; j++)
+      for (i = xmin; i < xmax; i++)
+        tab1[i + width * j] = mcSliceCorners(mri, i, j, slab->k0);
+
+  for (k = slab->k0; k < slab->k1; k++) {
+    for (j = ymin; j < ymax; j++) {
+      for (i = xmin; i < xmax; i++) {
+        ind       = i + width * j;
+        ref       = mcSliceCorners(mri, i, j, k + 1);
+        tab2[ind] = ref;
+        ref       = 16 * ref + tab1[ind]; // this is the indice of the cube
+
+        for (nf = 0; table[ref][3 * nf] >= 0; nf++)
+          ;
+        if (nf == 0)
+          continue;
+
+        memset(vt, 0, 12 * sizeof(int));
+        memset(vind, 0, 12 * sizeof(int));
+        for (p = 0; p < 3 * nf; p++)
+          vt[table[ref][p]]++;
+
+        for (p = 0; p < 4; p++)
+          if (vt[p])
+            vind[p] = (k == slab->k0) ? MC_EXTERNAL(2 * ind + f_c[p])
+                                      : vk1[2 * ind + f_c[p]];
+        for (p = 4; p < 6; p++)
+          if (vt[p])
+            vind[p] = vj1[i + f_c[p]];
+        if (vt[6])
+          vind[6] = vj2[i];
+        if (vt[7]) {
+          vind[7]    = mcAddVertex(slab, i + 1, j + 1, k + 0.5);
+          vj2[i + 1] = vind[7];
+        }
+        if (vt[8])
+          vind[8] = vk2[2 * ind + f_c[8]];
+        if (vt[9])
+          vind[9] = vk2[2 * ind + f_c[9]];
+        if (vt[10]) {
+          vind[10]               = mcAddVertex(slab, i + 0.5, j + 1, k + 1);
+          vk2[2 * ind + f_c[10]] = vind[10];
+          if (k == slab->k1 - 1)
+            slab->top.push_back(std::make_pair(2 * ind + f_c[10], vind[10]));
+        }
+        if (vt[11]) {
+          vind[11]               = mcAddVertex(slab, i + 1, j + 0.5, k + 1);
+          vk2[2 * ind + f_c[11]] = vind[11];
+          if (k == slab->k1 - 1)
+            slab->top.push_back(std::make_pair(2 * ind + f_c[11], vind[11]));
+        }
+        for (p = 0; p < 3 * nf; p++)
+          slab->face.push_back(vind[table[ref][p]]);
+      }
+      tmp = vj1;
+      vj1 = vj2;
+      vj2 = tmp;
+      memset(vj2, -1, width * sizeof(int));
+    }
+    tmp  = tab1;
+    tab1 = tab2;
+    tab2 = tmp;
+
+    tmp = vk1;
+    vk1 = vk2;
+    vk2 = tmp;
+    memset(vk2, -1, 2 * imgsize * sizeof(int));
+  }
+  std::sort(slab->top.begin(), slab->top.end());
+
+  free(tab1);
+  free(tab2);
+  free(vj1);
+  free(vj2);
+  free(vk1);
+  free(vk2);
+}
+
+/* tesselates slabs of slices in parallel into growing per slab buffers and
+   writes the surface directly; the result is identical to the serial scan
+   of generateMCtesselationOld(), which has fixed initial table sizes */
+void generateMCtesselation(tesselation_parms *parms) {
+  static int use_old = -1;
+  int        s, nslabs, nthreads, nz, nvertices, nfaces, vno, n;
+  int(*table)[19];
+  MRI *                mri;
+  MRIS *               mris;
+  std::vector<mc_slab> slabs;
+  std::vector<int>     voff, foff;
+  double               xw, yw, zw;
+
+  if (use_old < 0)
+    use_old = (getenv("FREESURFER_OLD_generateMCtesselation") != nullptr);
+  if (use_old) {
+    generateMCtesselationOld(parms);
+    return;
+  }
+
+  switch (parms->connectivity) {
+  case 1:
+    table = MC6p;
+    break;
+  case 2:
+    table = MC18;
+    break;
+  case 3:
+    table = MC6;
+    break;
+  default:
+    table = MC26;
+    break;
+  }
+
+  fprintf(stderr, "\npreprocessing...");
+  mri = preprocessingStep(parms);
+  fprintf(stderr, "done\n");
+
+#ifdef HAVE_OPENMP
+  nthreads = omp_get_max_threads();
+#else
+  nthreads = 1;
+#endif
+  nz     = MAX(parms->zmax - parms->zmin, 0);
+  nslabs = MIN(nz, 4 * nthreads);
+  slabs.resize(nslabs);
+  for (s = 0; s < nslabs; s++) {
+    slabs[s].k0 = parms->zmin + (int)((long)nz * s / nslabs);
+    slabs[s].k1 = parms->zmin + (int)((long)nz * (s + 1) / nslabs);
+  }
+
+  fprintf(stderr, "starting generation of surface (%d slabs)...", nslabs);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (s = 0; s < nslabs; s++) {
+    ROMP_PFLB_begin
+    mcTesselateSlab(parms, mri, table, &slabs[s]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+  MRIfree(&mri);
+
+  voff.resize(nslabs + 1);
+  foff.resize(nslabs + 1);
+  voff[0] = foff[0] = 0;
+  for (s = 0; s < nslabs; s++) {
+    voff[s + 1] = voff[s] + (int)(slabs[s].vertex.size() / 3);
+    foff[s + 1] = foff[s] + (int)(slabs[s].face.size() / 3);
+  }
+  nvertices = voff[nslabs];
+  nfaces    = foff[nslabs];
+
+  fprintf(stderr, "\nconstructing final surface...");
+  mris = MRISoverAlloc(nvertices, nfaces, nvertices, nfaces);
+  MRIScopyVolGeomFromMRI(mris, parms->mri);
+  fprintf(stderr, "\n(surface with %d faces and %d vertices)...", nfaces,
+          nvertices);
+  mris->type = MRIS_TRIANGULAR_SURFACE;
+
+  for (s = 0; s < nslabs; s++) {
+    float const *xyz = slabs[s].vertex.data();
+    for (vno = voff[s]; vno < voff[s + 1]; vno++, xyz += 3) {
+      MRISsurfaceRASFromVoxelCached(mris, parms->mri, xyz[0], xyz[1], xyz[2],
+                                    &xw, &yw, &zw);
+      MRISsetXYZ(mris, vno, xw, yw, zw);
+      mris->vertices_topology[vno].num = 0;
+    }
+    std::vector<float>().swap(slabs[s].vertex);
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (s = 0; s < nslabs; s++) {
+    ROMP_PFLB_begin
+    int const *fv = slabs[s].face.data();
+    int        fno, v, c;
+
+    for (fno = foff[s]; fno < foff[s + 1]; fno++)
+      for (c = 0; c < VERTICES_PER_FACE; c++) {
+        v = *fv++;
+        if (v >= 0)
+          v += voff[s];
+        else {
+          std::pair<int, int> const *top, *end;
+          int const                  edge = MC_EXTERNAL(v);
+
+          if (s > 0) {
+            top = slabs[s - 1].top.data();
+            end = top + slabs[s - 1].top.size();
+            top = std::lower_bound(top, end, std::make_pair(edge, -1));
+          } else
+            top = end = nullptr;
+          if (top == end || top->first != edge)
+            ErrorExit(ERROR_BADPARM, "%s: no vertex on edge %d of slice %d",
+                      Progname, edge, slabs[s].k0);
+          v = voff[s - 1] + top->second;
+        }
+        mris->faces[fno].v[c] = v;
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+  slabs.clear();
+
+  for (n = 0; n < mris->nfaces; n++)
+    for (vno = 0; vno < VERTICES_PER_FACE; vno++)
+      mris->vertices_topology[mris->faces[n].v[vno]].num++;
+
+  completeTesselation(parms, mris);
+  fprintf(stderr, "done\n");
+}
+
 int main(int argc, char *argv[]) {
   tesselation_parms *parms;
   MRIS **            mris_table, *mris, *mris_corrected;
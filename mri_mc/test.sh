@@ -3,3 +3,22 @@ source "$(dirname $0)/test_main.sh"
 
 test_command mri_pretess -w mri/wm.mgz wm mri/norm.mgz wm_new.mgz
 compare_vol wm_new.mgz wm_ref.mgz
+
+# the slab-parallel tessellation must match the serial scan for any number of
+# threads and every connectivity, also for a label cut by the first and last
+# slices of the volume
+if [ "$FSTEST_REGENERATE" != true ]; then
+  mri_convert=$(find_path $FSTEST_CWD mri_convert/mri_convert)
+  mris_diff=$(find_path $FSTEST_CWD mris_diff/mris_diff)
+  test_command $mri_convert mri/wm.mgz wm_crop.mgz --crop 128 128 128 --cropsize 256 256 48
+  FSTEST_NO_DATA_RESET=1
+  for vol in mri/wm.mgz wm_crop.mgz; do
+    for conn in 1 2 3 4; do
+      test_command FREESURFER_OLD_generateMCtesselation=1 mri_mc $vol 110 old.surf $conn
+      for threads in 1 8; do
+        test_command OMP_NUM_THREADS=$threads mri_mc $vol 110 new.surf $conn
+        eval_cmd $mris_diff new.surf old.surf --debug
+      done
+    done
+  done
+fi
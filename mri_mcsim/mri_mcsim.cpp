@@ -50,14 +50,22 @@ labeldir/lh.superiortemporal.label When running mri_glmfit-sim, add --cache-dir
 Example 3: running simulations in parallel (two jobs, 5000 iterations
 each for a total of 10000)
 
+Within one job, --threads runs that many repetitions at once (by
+default they run one at a time). Each repetition draws its noise from
+its own random stream, derived from the seed and the repetition
+number, so the results do not depend on the number of threads. Jobs
+that use the same --seed and cover consecutive ranges of repetitions
+with --first-rep produce exactly the tables of a single job with all
+the repetitions.
+
 mri_mcsim --o /path/to/mult-comp-cor/fsaverage/lh/superiortemporal --base
 mc-z.j001
-  --save-iter  --surf fsaverage lh --nreps 5000
+  --save-iter  --surf fsaverage lh --nreps 5000 --seed 53 --first-rep 0
   --label labeldir/lh.superiortemporal.label
 
 mri_mcsim --o /path/to/mult-comp-cor/fsaverage/lh/superiortemporal --base
 mc-z.j002
-  --save-iter  --surf fsaverage lh --nreps 500
+  --save-iter  --surf fsaverage lh --nreps 5000 --seed 53 --first-rep 5000
   --label labeldir/lh.superiortemporal.label
 
 When those jobs are done, merge the results into a single table with
@@ -88,6 +96,7 @@ ENDHELP --------------------------------------------------------------
 #include "mrisutils.h"
 #include "pdf.h"
 #include "randomfields.h"
+#include "romp_support.h"
 #include "surfcluster.h"
 #include "timer.h"
 #include "version.h"
@@ -118,6 +127,8 @@ char *      MaskFile     = NULL;
 const char *LabelFile    = "cortex";
 int         nRepetitions = -1;
 int         SynthSeed    = -1;
+int         FirstRep     = 0;
+int         NThreads     = 1;
 
 int    nThreshList;
 double ThreshList[100];
@@ -137,32 +148,56 @@ MRI *       mask = NULL;
 MRIS *      surf;
 char        tmpstr[2000];
 const char *signstr = NULL;
-int         msecTime, nmask, nmaskout, nthRep;
+int         msecTime, nmask, nmaskout, nthRep, *maskoutvtxno;
+double      avgvtxarea;
 int *       nSmoothsList;
 double      fwhmmax    = 30;
 int         SaveWeight = 0;
 int         FixFSALH   = 1;
 
+/* Neighbor lists of the fast surface smoother, built once and shared by
+   all the threads. Same neighbors and summation order as
+   MRISsmoothMRIFastFrame(), whose cached pointers tie it to one map.
+   Vertex vno averages itself and adjncy[xadj[vno]+1..xadj[vno+1]-1]. */
+typedef struct {
+  int   nvertices;
+  char *rip; // out of the mask
+  int * xadj, *adjncy;
+} MCSIM_SMOOTHER;
+
+/* What one thread needs to run a repetition: its own random field spec
+   (and so its own random stream), maps, smoothing scratch and surface,
+   which sclustMapSurfClusters() uses for the cluster numbers. */
+typedef struct {
+  RFS *  rfs;
+  MRIS * surf;
+  MRI *  z, *zabs, *sig, *p;
+  float *tmp;
+} MCSIM_WORKER;
+
+static MCSIM_SMOOTHER *mcsimSmootherAlloc(MRIS *surf, MRI *mask);
+static void           mcsimSmootherFree(MCSIM_SMOOTHER **psm);
+static void   mcsimSmooth(const MCSIM_SMOOTHER *sm, MRI *z, int nSmoothSteps,
+                          float *tmp);
+static unsigned long mcsimRepSeed(int seed, int rep);
+static MCSIM_WORKER *mcsimWorkerAlloc(MRIS *surf, int copysurf);
+static void          mcsimWorkerFree(MCSIM_WORKER **pw);
+static int mcsimRunRep(MCSIM_WORKER *w, const MCSIM_SMOOTHER *sm, int rep);
+
 /*---------------------------------------------------------------*/
 int main(int argc, char *argv[]) {
-  int         nargs, n, err, k, *maskoutvtxno;
+  int         nargs, n, err, nthreads, ndone, stop, *repdone;
   char        tmpstr[2000], *SUBJECTS_DIR, fname[2000];
   const char *signstr = NULL; // Is this intended to mask the global?
   //char *OutDir = NULL;
-  RFS *  rfs;
-  int    nSmoothsPrev, nSmoothsDelta;
-  MRI *  z, *zabs = NULL, *sig = NULL, *p = NULL;
-  int    FreeMask = 0;
-  int    nthSign, nthFWHM, nthThresh;
-  double sigmax, zmax, threshadj, csize, csizeavg, cweightvtx, searchspace,
-      avgvtxarea;
-  int             csizen;
-  int             nClusters, cmax, rmax, smax;
-  SURFCLUSTERSUM *SurfClustList;
+  int             FreeMask = 0;
+  int             nthSign, nthFWHM, nthThresh;
+  double          searchspace;
   Timer           mytimer;
   LABEL *         clabel;
   FILE *          fp, *fpLog = nullptr;
-  float **        ppVal, **ppSig, **ppVal0, **ppSig0, **ppZ, **ppZ0;
+  MCSIM_SMOOTHER *smoother;
+  MCSIM_WORKER ** workers;
 
   nargs = handleVersionOption(argc, argv, "mri_mcsim");
   if (nargs && argc - nargs == 1)
@@ -349,7 +384,9 @@ int main(int argc, char *argv[]) {
         sprintf(csd->subject, "%s", subject);
         sprintf(csd->hemi, "%s", hemi);
         sprintf(csd->contrast, "%s", "NA");
-        csd->seed        = SynthSeed;
+        // seed of the first repetition's stream, which differs between
+        // jobs that split up the repetitions so their CSDs can be merged
+        csd->seed        = mcsimRepSeed(SynthSeed, FirstRep);
         csd->nreps       = nRepetitions;
         csd->thresh      = ThreshList[nthThresh];
         csd->threshsign  = SignList[nthSign];
@@ -368,16 +405,6 @@ int main(int argc, char *argv[]) {
     fprintf(fp, "%5.1f %4d\n", FWHMList[nthFWHM], nSmoothsList[nthFWHM]);
   fclose(fp);
 
-  // Alloc the z and sig maps
-  z   = MRIallocSequence(surf->nvertices, 1, 1, MRI_FLOAT, 1);
-  sig = MRIallocSequence(surf->nvertices, 1, 1, MRI_FLOAT, 1);
-
-  // Set up the random field specification
-  rfs            = RFspecInit(SynthSeed, nullptr);
-  rfs->name      = strcpyalloc("gaussian");
-  rfs->params[0] = 0;
-  rfs->params[1] = 1;
-
   printf("Thresholds (%d): ", nThreshList);
   for (n = 0; n < nThreshList; n++)
     printf("%5.2f ", ThreshList[n]);
@@ -391,137 +418,82 @@ int main(int argc, char *argv[]) {
     printf("%5.2f ", FWHMList[n]);
   printf("\n");
 
-  // Set up pointer to the val field
-  ppVal  = (float **)calloc(surf->nvertices, sizeof(float *));
-  ppVal0 = ppVal;
-  ppSig  = (float **)calloc(surf->nvertices, sizeof(float *));
-  ppSig0 = ppSig;
-  ppZ    = (float **)calloc(surf->nvertices, sizeof(float *));
-  ppZ0   = ppZ;
-  for (k = 0; k < surf->nvertices; k++) {
-    ppVal[k] = &(surf->vertices[k].val);
-    ppSig[k] = &(MRIFseq_vox(sig, k, 0, 0, 0));
-    ppZ[k]   = &(MRIFseq_vox(z, k, 0, 0, 0));
-  }
-
-  // Start the simulation loop
-  printf("\n\nStarting Simulation over %d Repetitions\n", nRepetitions);
+  // One worker per thread; the first one uses the loaded surface. Like
+  // before, the repetitions run one at a time unless --threads is given.
+  nthreads = NThreads;
+  if (nthreads > nRepetitions)
+    nthreads = nRepetitions;
+  smoother = mcsimSmootherAlloc(surf, mask);
+  workers  = (MCSIM_WORKER **)calloc(nthreads, sizeof(MCSIM_WORKER *));
+  for (n = 0; n < nthreads; n++)
+    workers[n] = mcsimWorkerAlloc(surf, n > 0);
+
+  // Start the simulation loop. Repetitions finish out of order, so the
+  // output only ever covers the ones done so far without a gap (ndone).
+  printf("\n\nStarting Simulation over %d Repetitions (%d threads)\n",
+         nRepetitions, nthreads);
   if (fpLog)
     fprintf(fpLog, "\n\nStarting Simulation over %d Repetitions\n",
             nRepetitions);
+  repdone = (int *)calloc(nRepetitions + 1, sizeof(int));
+  ndone   = 0;
+  stop    = 0;
   mytimer.reset();
-  for (nthRep = 0; nthRep < nRepetitions; nthRep++) {
-    msecTime = mytimer.milliseconds();
-    printf("%5d %7.2f ", nthRep, (msecTime / 1000.0) / 60);
-    fflush(stdout);
-    if (fpLog) {
-      fprintf(fpLog, "%5d %7.1f ", nthRep, (msecTime / 1000.0) / 60);
-      fflush(fpLog);
-    }
-    // Synthesize an unsmoothed z map
-    RFsynth(z, rfs, mask);
-    nSmoothsPrev = 0;
-
-    // Loop through FWHMs
-    for (nthFWHM = 0; nthFWHM < nFWHMList; nthFWHM++) {
-      printf("%d ", nthFWHM);
-      fflush(stdout);
-      if (fpLog) {
-        fprintf(fpLog, "%d ", nthFWHM);
-        fflush(fpLog);
-      }
-      nSmoothsDelta = nSmoothsList[nthFWHM] - nSmoothsPrev;
-      nSmoothsPrev  = nSmoothsList[nthFWHM];
-      // Incrementally smooth z
-      MRISsmoothMRIFastFrame(surf, z, 0, nSmoothsDelta, mask);
-      // Rescale
-      RFrescale(z, rfs, mask, z);
-      // Slightly tortured way to get the right p-values because
-      //   RFstat2P() computes one-sided, but I handle sidedness
-      //   during thresholding.
-      // First, use zabs to get a two-sided pval bet 0 and 0.5
-      zabs = MRIabs(z, zabs);
-      p    = RFstat2P(zabs, rfs, mask, 0, p);
-      // Next, mult pvals by 2 to get two-sided bet 0 and 1
-      MRIscalarMul(p, p, 2.0);
-      sig = MRIlog10(p, nullptr, sig, 1); // sig = -log10(p)
-
-      for (nthSign = 0; nthSign < nSignList; nthSign++) {
-        csd = csdList[nthFWHM][0][nthSign]; // just need csd->threshsign
-
-        // If test is not ABS then apply the sign
-        if (csd->threshsign != 0)
-          MRIsetSign(sig, z, 0);
-
-        // Get the max stats
-        sigmax =
-            MRIframeMax(sig, 0, mask, csd->threshsign, &cmax, &rmax, &smax);
-        zmax = MRIgetVoxVal(z, cmax, rmax, smax, 0);
-        if (csd->threshsign == 0) {
-          zmax   = fabs(zmax);
-          sigmax = fabs(sigmax);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1) \
+    num_threads(nthreads)
+#endif
+  for (n = 0; n < nRepetitions; n++) {
+    ROMP_PFLB_begin
+    int thno = 0, stopped;
+#ifdef HAVE_OPENMP
+    thno = omp_get_thread_num();
+#pragma omp atomic read
+#endif
+    stopped = stop;
+    if (!stopped) {
+      mcsimRunRep(workers[thno], smoother, n);
+#ifdef HAVE_OPENMP
+#pragma omp critical(mcsim_progress)
+#endif
+      {
+        int nprev = ndone;
+        repdone[n] = 1;
+        while (repdone[ndone])
+          ndone++;
+        msecTime = mytimer.milliseconds();
+        printf("%5d %7.2f\n", FirstRep + n, (msecTime / 1000.0) / 60);
+        fflush(stdout);
+        if (fpLog) {
+          fprintf(fpLog, "%5d %7.1f\n", FirstRep + n,
+                  (msecTime / 1000.0) / 60);
+          fflush(fpLog);
         }
-        // Mask
-        if (mask) {
-          // MRImask(sig,mask,sig,0.0,0.0); // a little slow
-          for (k = 0; k < nmaskout; k++)
-            MRIsetVoxVal(sig, maskoutvtxno[k], 0, 0, 0, 0.0);
+        if (ndone > nprev &&
+            (SaveEachIter || fio_FileExistsReadable(SaveFile))) {
+          nthRep = ndone;
+          SaveOutput();
         }
-
-        // Copy sig to vertexval
-        // MRIScopyMRI(surf, sig, 0, "val"); // MRIScopyMRI() is a little slow
-        ppVal = ppVal0;
-        ppSig = ppSig0;
-        for (k = 0; k < surf->nvertices; k++)
-          *(*ppVal++) = *(*ppSig++);
-
-        for (nthThresh = 0; nthThresh < nThreshList; nthThresh++) {
-          csd = csdList[nthFWHM][nthThresh][nthSign];
-
-          // Surface clustering
-          // Set the threshold
-          if (csd->threshsign == 0)
-            threshadj = csd->thresh;
-          else
-            threshadj = csd->thresh - log10(2.0); // one-sided test
-          // Compute clusters
-          SurfClustList =
-              sclustMapSurfClusters(surf, threshadj, -1, csd->threshsign, 0,
-                                    &nClusters, nullptr, nullptr);
-          // Actual area of cluster with max area
-          csize = sclustMaxClusterArea(SurfClustList, nClusters);
-          // Number of vertices of cluster with max number of vertices.
-          // Note: this may be a different cluster from above!
-          csizen     = sclustMaxClusterCount(SurfClustList, nClusters);
-          cweightvtx = sclustMaxClusterWeightVtx(SurfClustList, nClusters,
-                                                 csd->threshsign);
-          // Area of this cluster based on average vertex area. This just scales
-          // the number of vertices.
-          csizeavg = csizen * avgvtxarea;
-          if (UseAvgVtxArea)
-            csize = csizeavg;
-          // Store results
-          csd->nClusters[nthRep]           = nClusters;
-          csd->MaxClusterSize[nthRep]      = csize;
-          csd->MaxClusterSizeVtx[nthRep]   = csizen;
-          csd->MaxClusterWeightVtx[nthRep] = cweightvtx;
-          csd->MaxSig[nthRep]              = sigmax;
-          csd->MaxStat[nthRep]             = zmax;
-        } // Sign
-      }   // Thresh
-    }     // FWHM
-    printf("\n");
-    if (fpLog)
-      fprintf(fpLog, "\n");
-    if (SaveEachIter || fio_FileExistsReadable(SaveFile))
-      SaveOutput();
-    if (fio_FileExistsReadable(StopFile)) {
-      printf("Found stop file %s\n", StopFile);
-      goto finish;
+        if (!stop && fio_FileExistsReadable(StopFile)) {
+          printf("Found stop file %s\n", StopFile);
+#ifdef HAVE_OPENMP
+#pragma omp atomic write
+#endif
+          stop = 1;
+        }
+      }
     }
+    ROMP_PFLB_end
   } // Simulation Repetition
+  ROMP_PF_end
+  nthRep = ndone;
 
-finish:
+  for (n = 0; n < nthreads; n++)
+    mcsimWorkerFree(&workers[n]);
+  free(workers);
+  free(repdone);
+  mcsimSmootherFree(&smoother);
 
   SaveOutput();
 
@@ -651,6 +623,20 @@ static int parse_commandline(int argc, char **argv) {
         CMDargNErr(option, 1);
       sscanf(pargv[0], "%d", &SynthSeed);
       nargsused = 1;
+    } else if (!strcasecmp(option, "--first-rep")) {
+      if (nargc < 1)
+        CMDargNErr(option, 1);
+      sscanf(pargv[0], "%d", &FirstRep);
+      nargsused = 1;
+    } else if (!strcasecmp(option, "--threads") ||
+               !strcasecmp(option, "--nthreads")) {
+      if (nargc < 1)
+        CMDargNErr(option, 1);
+      sscanf(pargv[0], "%d", &NThreads);
+#ifdef HAVE_OPENMP
+      omp_set_num_threads(NThreads);
+#endif
+      nargsused = 1;
     } else if (!strcasecmp(option, "--mask")) {
       if (nargc < 1)
         CMDargNErr(option, 1);
@@ -735,6 +721,9 @@ static void print_usage() {
   printf("   \n");
   printf("   --avgvtxarea : report cluster area based on average vtx area\n");
   printf("   --seed randomseed : default is to choose based on ToD\n");
+  printf("   --first-rep n : number of the first repetition (default 0)\n");
+  printf("   --threads nthreads : run nthreads repetitions at once "
+         "(default 1)\n");
   printf("   --label labelfile : default is ?h.cortex.label \n");
   printf("   --mask maskfile : instead of label\n");
   printf("   --no-label : do not use a label to mask\n");
@@ -807,14 +796,25 @@ static void print_help() {
          "iterations\n");
   printf("each for a total of 10000)\n");
   printf("\n");
+  printf("Within one job, --threads runs that many repetitions at once (by\n");
+  printf("default they run one at a time). Each repetition draws its noise "
+         "from\n");
+  printf("its own random stream, derived from the seed and the repetition\n");
+  printf("number, so the results do not depend on the number of threads.\n");
+  printf("Jobs that use the same --seed and cover consecutive ranges of\n");
+  printf("repetitions with --first-rep produce exactly the tables of a\n");
+  printf("single job with all the repetitions.\n");
+  printf("\n");
   printf("mri_mcsim --o /path/to/mult-comp-cor/fsaverage/lh/superiortemporal "
          "--base mc-z.j001 \n");
-  printf("  --save-iter  --surf fsaverage lh --nreps 5000\n");
+  printf("  --save-iter  --surf fsaverage lh --nreps 5000 --seed 53 "
+         "--first-rep 0\n");
   printf("  --label labeldir/lh.superiortemporal.label\n");
   printf("\n");
   printf("mri_mcsim --o /path/to/mult-comp-cor/fsaverage/lh/superiortemporal "
          "--base mc-z.j002 \n");
-  printf("  --save-iter  --surf fsaverage lh --nreps 500\n");
+  printf("  --save-iter  --surf fsaverage lh --nreps 5000 --seed 53 "
+         "--first-rep 5000\n");
   printf("  --label labeldir/lh.superiortemporal.label\n");
   printf("\n");
   printf(
@@ -867,6 +867,14 @@ static void check_options() {
     printf("ERROR: need to specify number of simulation repitions\n");
     exit(1);
   }
+  if (FirstRep < 0) {
+    printf("ERROR: --first-rep must be >= 0\n");
+    exit(1);
+  }
+  if (NThreads < 1) {
+    printf("ERROR: --threads must be >= 1\n");
+    exit(1);
+  }
   if (nFWHMList == 0) {
     double fwhm;
     nFWHMList = 0;
@@ -909,6 +917,7 @@ static void dump_options(FILE *fp) {
   fprintf(fp, "OutTop  %s\n", OutTop);
   fprintf(fp, "CSDBase  %s\n", csdbase);
   fprintf(fp, "nreps    %d\n", nRepetitions);
+  fprintf(fp, "firstrep %d\n", FirstRep);
   fprintf(fp, "fwhmmax  %g\n", fwhmmax);
   fprintf(fp, "subject  %s\n", subject);
   fprintf(fp, "hemi     %s\n", hemi);
@@ -971,3 +980,240 @@ int SaveOutput() {
   }
   return (0);
 }
+
+/*---------------------------------------------------------------*/
+static MCSIM_SMOOTHER *mcsimSmootherAlloc(MRIS *surf, MRI *mask) {
+  MCSIM_SMOOTHER *sm;
+  int             vno, nthnbr, nbrvno, n;
+
+  sm            = (MCSIM_SMOOTHER *)calloc(1, sizeof(MCSIM_SMOOTHER));
+  sm->nvertices = surf->nvertices;
+  sm->rip       = (char *)calloc(surf->nvertices, sizeof(char));
+  sm->xadj      = (int *)calloc(surf->nvertices + 1, sizeof(int));
+  n             = 0;
+  for (vno = 0; vno < surf->nvertices; vno++)
+    n += 1 + surf->vertices_topology[vno].vnum;
+  sm->adjncy = (int *)calloc(n, sizeof(int));
+
+  n = 0;
+  for (vno = 0; vno < surf->nvertices; vno++) {
+    sm->xadj[vno] = n;
+    if (mask && MRIgetVoxVal(mask, vno, 0, 0, 0) < 0.5) {
+      sm->rip[vno] = 1;
+      continue;
+    }
+    sm->adjncy[n++] = vno;
+    for (nthnbr = 0; nthnbr < surf->vertices_topology[vno].vnum; nthnbr++) {
+      nbrvno = surf->vertices_topology[vno].v[nthnbr];
+      if (surf->vertices[nbrvno].ripflag)
+        continue;
+      if (mask && MRIgetVoxVal(mask, nbrvno, 0, 0, 0) < 0.5)
+        continue;
+      sm->adjncy[n++] = nbrvno;
+    }
+  }
+  sm->xadj[surf->nvertices] = n;
+  return (sm);
+}
+
+static void mcsimSmootherFree(MCSIM_SMOOTHER **psm) {
+  free((*psm)->rip);
+  free((*psm)->xadj);
+  free((*psm)->adjncy);
+  free(*psm);
+  *psm = nullptr;
+}
+
+/*---------------------------------------------------------------
+  mcsimSmooth() - nSmoothSteps nearest-neighbor averages of the
+  nvertices x 1 x 1 float map z, zeroing vertices outside the mask,
+  exactly as MRISsmoothMRIFastFrame() does. tmp holds nvertices.
+  ---------------------------------------------------------------*/
+static void mcsimSmooth(const MCSIM_SMOOTHER *sm, MRI *z, int nSmoothSteps,
+                        float *tmp) {
+  float *val = &MRIFseq_vox(z, 0, 0, 0, 0);
+  float  sumF;
+  int    vno, nthstep, k;
+
+  for (vno = 0; vno < sm->nvertices; vno++)
+    if (sm->rip[vno])
+      val[vno] = 0;
+
+  for (nthstep = 0; nthstep < nSmoothSteps; nthstep++) {
+    for (vno = 0; vno < sm->nvertices; vno++) {
+      if (sm->rip[vno])
+        continue;
+      sumF = val[sm->adjncy[sm->xadj[vno]]];
+      for (k = sm->xadj[vno] + 1; k < sm->xadj[vno + 1]; k++)
+        sumF += val[sm->adjncy[k]];
+      tmp[vno] = sumF / (sm->xadj[vno + 1] - sm->xadj[vno]);
+    }
+    for (vno = 0; vno < sm->nvertices; vno++)
+      if (!sm->rip[vno])
+        val[vno] = tmp[vno];
+  }
+}
+
+/*---------------------------------------------------------------
+  mcsimRepSeed() - seed of the random stream of repetition rep
+  (counting from the first repetition of all the jobs), so that a
+  repetition draws the same noise whichever thread or job runs it.
+  Mixes the two with the splitmix64 finalizer; the result is in the
+  1..2^31-2 range the ranlux generator takes.
+  ---------------------------------------------------------------*/
+static unsigned long mcsimRepSeed(int seed, int rep) {
+  unsigned long long x;
+
+  x = ((unsigned long long)(unsigned)seed << 32) + (unsigned)rep + 1;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return ((unsigned long)(x % 2147483646ULL) + 1);
+}
+
+/*---------------------------------------------------------------
+  mcsimWorkerAlloc() - if copysurf, the worker gets its own copy of
+  surf. MRISclone() does not carry the group average areas, which the
+  cluster areas use, so they are copied here.
+  ---------------------------------------------------------------*/
+static MCSIM_WORKER *mcsimWorkerAlloc(MRIS *surf, int copysurf) {
+  MCSIM_WORKER *w;
+  int           vno;
+
+  w = (MCSIM_WORKER *)calloc(1, sizeof(MCSIM_WORKER));
+  w->surf = surf;
+  if (copysurf) {
+    w->surf                           = MRISclone(surf);
+    w->surf->group_avg_surface_area   = surf->group_avg_surface_area;
+    w->surf->group_avg_vtxarea_loaded = surf->group_avg_vtxarea_loaded;
+    for (vno = 0; vno < surf->nvertices; vno++)
+      w->surf->vertices[vno].group_avg_area =
+          surf->vertices[vno].group_avg_area;
+  }
+  w->z   = MRIallocSequence(surf->nvertices, 1, 1, MRI_FLOAT, 1);
+  w->sig = MRIallocSequence(surf->nvertices, 1, 1, MRI_FLOAT, 1);
+  w->tmp = (float *)calloc(surf->nvertices, sizeof(float));
+
+  // Set up the random field specification; reseeded for each repetition
+  w->rfs            = RFspecInit(SynthSeed, nullptr);
+  w->rfs->name      = strcpyalloc("gaussian");
+  w->rfs->params[0] = 0;
+  w->rfs->params[1] = 1;
+  return (w);
+}
+
+static void mcsimWorkerFree(MCSIM_WORKER **pw) {
+  MCSIM_WORKER *w = *pw;
+
+  if (w->surf != surf)
+    MRISfree(&w->surf);
+  MRIfree(&w->z);
+  MRIfree(&w->sig);
+  if (w->zabs)
+    MRIfree(&w->zabs);
+  if (w->p)
+    MRIfree(&w->p);
+  free(w->tmp);
+  RFspecFree(&w->rfs);
+  free(w);
+  *pw = nullptr;
+}
+
+/*---------------------------------------------------------------
+  mcsimRunRep() - runs repetition rep (of this job) with the worker's
+  maps and surface and stores its max stats in slot rep of each CSD.
+  Different repetitions only touch their own CSD slots, so they can
+  run concurrently.
+  ---------------------------------------------------------------*/
+static int mcsimRunRep(MCSIM_WORKER *w, const MCSIM_SMOOTHER *sm, int rep) {
+  int             nthFWHM, nthSign, nthThresh, nSmoothsPrev, k;
+  int             nClusters, cmax, rmax, smax, csizen;
+  double          sigmax, zmax, threshadj, csize, csizeavg, cweightvtx;
+  CSD *           csd;
+  SURFCLUSTERSUM *SurfClustList;
+
+  // Synthesize an unsmoothed z map
+  RFspecSetSeed(w->rfs, mcsimRepSeed(SynthSeed, FirstRep + rep));
+  RFsynth(w->z, w->rfs, mask);
+  nSmoothsPrev = 0;
+
+  // Loop through FWHMs
+  for (nthFWHM = 0; nthFWHM < nFWHMList; nthFWHM++) {
+    // Incrementally smooth z
+    mcsimSmooth(sm, w->z, nSmoothsList[nthFWHM] - nSmoothsPrev, w->tmp);
+    nSmoothsPrev = nSmoothsList[nthFWHM];
+    // Rescale
+    RFrescale(w->z, w->rfs, mask, w->z);
+    // Slightly tortured way to get the right p-values because
+    //   RFstat2P() computes one-sided, but I handle sidedness
+    //   during thresholding.
+    // First, use zabs to get a two-sided pval bet 0 and 0.5
+    w->zabs = MRIabs(w->z, w->zabs);
+    w->p    = RFstat2P(w->zabs, w->rfs, mask, 0, w->p);
+    // Next, mult pvals by 2 to get two-sided bet 0 and 1
+    MRIscalarMul(w->p, w->p, 2.0);
+    w->sig = MRIlog10(w->p, nullptr, w->sig, 1); // sig = -log10(p)
+
+    for (nthSign = 0; nthSign < nSignList; nthSign++) {
+      csd = csdList[nthFWHM][0][nthSign]; // just need csd->threshsign
+
+      // If test is not ABS then apply the sign
+      if (csd->threshsign != 0)
+        MRIsetSign(w->sig, w->z, 0);
+
+      // Get the max stats
+      sigmax =
+          MRIframeMax(w->sig, 0, mask, csd->threshsign, &cmax, &rmax, &smax);
+      zmax = MRIgetVoxVal(w->z, cmax, rmax, smax, 0);
+      if (csd->threshsign == 0) {
+        zmax   = fabs(zmax);
+        sigmax = fabs(sigmax);
+      }
+      // Mask
+      if (mask) {
+        for (k = 0; k < nmaskout; k++)
+          MRIFseq_vox(w->sig, maskoutvtxno[k], 0, 0, 0) = 0;
+      }
+
+      // Copy sig to vertexval
+      for (k = 0; k < w->surf->nvertices; k++)
+        w->surf->vertices[k].val = MRIFseq_vox(w->sig, k, 0, 0, 0);
+
+      for (nthThresh = 0; nthThresh < nThreshList; nthThresh++) {
+        csd = csdList[nthFWHM][nthThresh][nthSign];
+
+        // Surface clustering
+        // Set the threshold
+        if (csd->threshsign == 0)
+          threshadj = csd->thresh;
+        else
+          threshadj = csd->thresh - log10(2.0); // one-sided test
+        // Compute clusters
+        SurfClustList =
+            sclustMapSurfClusters(w->surf, threshadj, -1, csd->threshsign, 0,
+                                  &nClusters, nullptr, nullptr);
+        // Actual area of cluster with max area
+        csize = sclustMaxClusterArea(SurfClustList, nClusters);
+        // Number of vertices of cluster with max number of vertices.
+        // Note: this may be a different cluster from above!
+        csizen     = sclustMaxClusterCount(SurfClustList, nClusters);
+        cweightvtx = sclustMaxClusterWeightVtx(SurfClustList, nClusters,
+                                               csd->threshsign);
+        free(SurfClustList);
+        // Area of this cluster based on average vertex area. This just scales
+        // the number of vertices.
+        csizeavg = csizen * avgvtxarea;
+        if (UseAvgVtxArea)
+          csize = csizeavg;
+        // Store results
+        csd->nClusters[rep]           = nClusters;
+        csd->MaxClusterSize[rep]      = csize;
+        csd->MaxClusterSizeVtx[rep]   = csizen;
+        csd->MaxClusterWeightVtx[rep] = cweightvtx;
+        csd->MaxSig[rep]              = sigmax;
+        csd->MaxStat[rep]             = zmax;
+      } // Thresh
+    }   // Sign
+  }     // FWHM
+  return (0);
+}
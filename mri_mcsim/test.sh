@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+source "$(dirname $0)/test_main.sh"
+
+# uses the bert subject of the mris_surface_stats testdata
+mcsim="mri_mcsim --surf bert lh --fwhm 5 --thresh 2 3 --seed 53"
+
+# every repetition draws from its own stream, so the tables must not depend
+# on the number of threads, and two jobs splitting the repetitions with
+# --first-rep must produce the rows of the single job
+test_command $mcsim --nreps 8 --o serial --base mc-z
+FSTEST_NO_DATA_RESET=1
+test_command $mcsim --nreps 8 --o threaded --base mc-z --threads 3
+test_command $mcsim --nreps 5 --o shards --base mc-z.j001 --first-rep 0
+test_command $mcsim --nreps 3 --o shards --base mc-z.j002 --first-rep 5 --threads 2
+for csd in $(cd serial && find . -name mc-z.csd); do
+  eval_cmd diff -I^# threaded/$csd serial/$csd
+  dir=$(dirname $csd)
+  test_command "grep -hv '^#' serial/$csd | cut -c8- > rows.serial"
+  test_command "grep -hv '^#' shards/$dir/mc-z.j001.csd shards/$dir/mc-z.j002.csd | cut -c8- > rows.shards"
+  eval_cmd diff rows.shards rows.serial
+done
@@ -527,7 +527,12 @@ int main(int argc, char *argv[]) {
     mri_dst = MRIscalarMul(mri_src, nullptr, scale);
     MRIremoveWMOutliers(mri_dst, mri_ctrl, mri_ctrl, intensity_below / 2);
     mri_bias = MRIbuildBiasImage(mri_dst, mri_ctrl, nullptr, 0.0);
-    MRIsoapBubble(mri_bias, mri_ctrl, mri_bias, 50, 1);
+    // the converged interpolation differs from the 50 iterations used
+    // before, so -L output changes; the old call is kept behind the switch
+    if (getenv("FREESURFER_OLD_MRIsoapBubble"))
+      MRIsoapBubble(mri_bias, mri_ctrl, mri_bias, 50, 1);
+    else
+      MRIsoapBubbleMultigrid(mri_bias, mri_ctrl, mri_bias, 1);
     MRIapplyBiasCorrectionSameGeometry(mri_dst, mri_bias, mri_dst,
                                        DEFAULT_DESIRED_WHITE_MATTER_VALUE);
     //    MRIwrite(mri_dst, out_fname) ;
@@ -487,12 +487,37 @@ double compute_conditional_density(MATRIX *m_inv_cov, VECTOR *v_means,
   return (p);
 }
 
+#define RF_LABEL_BATCH 4096
+
+// classify a batch of gathered feature vectors with the flattened forest and
+// write the labels and wmsa probabilities back to the voxels they came from
+static void apply_random_forest_batch(RANDOM_FOREST *rf, double **features,
+                                      int *coords, int nbatch, int *classes,
+                                      double *pvals, MRI *mri_labeled,
+                                      MRI *mri_pvals) {
+  int n, x, y, z;
+
+  if (nbatch <= 0)
+    return;
+  RFclassifyBatch(rf, features, nbatch, classes, pvals);
+  for (n = 0; n < nbatch; n++) {
+    x = coords[3 * n];
+    y = coords[3 * n + 1];
+    z = coords[3 * n + 2];
+    if (classes[n] > 0)
+      DiagBreak();
+    if (classes[n] > 0 && pvals[n] > wmsa_thresh)
+      MRIsetVoxVal(mri_labeled, x, y, z, 0, classes[n]);
+    MRIsetVoxVal(mri_pvals, x, y, z, 2, pvals[n]);
+  }
+}
+
 static MRI *label_with_random_forest(RANDOM_FOREST *rf, TRANSFORM *transform,
                                      GCA *gca, float wm_thresh, MRI *mri_in,
                                      MRI *mri_labeled, int wmsa_whalf,
                                      MRI *mri_aseg, MRI **pmri_pvals) {
-  int     x, y, z, wsize, label;
-  double *feature, xatlas, yatlas, zatlas, pval;
+  int     x, y, z, wsize, i, nbatch, *coords, *classes;
+  double *feature, xatlas, yatlas, zatlas, pval, **features, *pvals;
   MRI *   mri_wmsa_possible, *mri_pvals;
 
   wsize = nint(pow((rf->nfeatures - 3) / mri_in->nframes, 1.0 / 3));
@@ -513,10 +538,22 @@ static MRI *label_with_random_forest(RANDOM_FOREST *rf, TRANSFORM *transform,
   for (; wmsa_whalf > 0; wmsa_whalf--)
     MRIdilate(mri_wmsa_possible, mri_wmsa_possible);
 
-  feature = (double *)calloc(rf->nfeatures, sizeof(double));
-  if (feature == NULL)
-    ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d-len feature vector",
-              rf->nfeatures);
+  // feature vectors are gathered serially (the transform and gca lookups are
+  // not reentrant) and classified RF_LABEL_BATCH voxels at a time
+  nbatch   = 0;
+  features = (double **)calloc(RF_LABEL_BATCH, sizeof(double *));
+  coords   = (int *)calloc(3 * RF_LABEL_BATCH, sizeof(int));
+  classes  = (int *)calloc(RF_LABEL_BATCH, sizeof(int));
+  pvals    = (double *)calloc(RF_LABEL_BATCH, sizeof(double));
+  if (features == NULL || coords == NULL || classes == NULL || pvals == NULL)
+    ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d-len feature batch",
+              Progname, RF_LABEL_BATCH);
+  for (i = 0; i < RF_LABEL_BATCH; i++) {
+    features[i] = (double *)calloc(rf->nfeatures, sizeof(double));
+    if (features[i] == NULL)
+      ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d-len feature vector",
+                Progname, rf->nfeatures);
+  }
 
   if (Gx >= 0) // diagnostics
   {
@@ -576,6 +613,7 @@ static MRI *label_with_random_forest(RANDOM_FOREST *rf, TRANSFORM *transform,
                    cortex_prior(gca, mri_in, transform, x, y, z));
           continue;
         }
+        feature = features[nbatch];
         TransformSourceVoxelToAtlas(transform, mri_in, x, y, z, &xatlas,
                                     &yatlas, &zatlas);
         extract_feature(mri_in, wsize, x, y, z, feature, xatlas, yatlas,
@@ -599,16 +637,20 @@ static MRI *label_with_random_forest(RANDOM_FOREST *rf, TRANSFORM *transform,
           printf("\n");
           Gdiag |= DIAG_VERBOSE;
           DiagBreak();
-        }
-        label = RFclassify(rf, feature, &pval, -1);
-        if (label > 0)
-          DiagBreak();
-        if (label > 0 && pval > wmsa_thresh)
-          MRIsetVoxVal(mri_labeled, x, y, z, 0, label);
-        MRIsetVoxVal(mri_pvals, x, y, z, 2, pval);
-        if (x == Gx && y == Gy && z == Gz)
+          RFclassify(rf, feature, &pval, -1); // verbose trace of the voxel
           Gdiag &= ~DIAG_VERBOSE;
+        }
+        coords[3 * nbatch]     = x;
+        coords[3 * nbatch + 1] = y;
+        coords[3 * nbatch + 2] = z;
+        if (++nbatch < RF_LABEL_BATCH)
+          continue;
+        apply_random_forest_batch(rf, features, coords, nbatch, classes, pvals,
+                                  mri_labeled, mri_pvals);
+        nbatch = 0;
       }
+  apply_random_forest_batch(rf, features, coords, nbatch, classes, pvals,
+                            mri_labeled, mri_pvals);
 
   if (Gx >= 0) {
     printf("writing pvals.mgz...\n");
@@ -618,7 +660,12 @@ static MRI *label_with_random_forest(RANDOM_FOREST *rf, TRANSFORM *transform,
     *pmri_pvals = mri_pvals;
   else
     MRIfree(&mri_pvals);
-  free(feature);
+  for (i = 0; i < RF_LABEL_BATCH; i++)
+    free(features[i]);
+  free(features);
+  free(coords);
+  free(classes);
+  free(pvals);
   MRIfree(&mri_wmsa_possible);
   return (mri_labeled);
 }
@@ -504,38 +504,58 @@ int main(int argc, char **argv) {
     MatrixFree(&Qsrc);
     MatrixFree(&QFWDsrc);
   } else {
-    nproj = 0;
-    for (ProjFrac = ProjFracMin; ProjFrac <= ProjFracMax;
-         ProjFrac += ProjFracDelta) {
-      printf("%2d %g %g %g\n", nproj + 1, ProjFrac, ProjFracMin, ProjFracMax);
-      if (UseOld) {
-        printf("using old\n");
-        SurfValsP = vol2surf_linear(SrcVol, Qsrc, Fsrc, Wsrc, Dsrc, Surf,
-                                    ProjFrac, interpmethod, float2int,
-                                    SrcHitVol, ProjDistFlag, 1);
-      } else {
-        printf("using new\n");
-        SurfValsP = MRIvol2surfVSM(SrcVol, Dsrc, Surf, vsm, interpmethod,
-                                   SrcHitVol, ProjFrac, ProjDistFlag, 1, NULL);
-      }
-      fflush(stdout);
-      if (SurfValsP == NULL) {
+    // Precompute the vertex x depth sampling once and apply it to all
+    // frames; sinc and the vsm path still go one depth at a time.
+    VOL2SURF_OPERATOR *v2s_op = NULL;
+    if (UseOld && !getenv("FREESURFER_OLD_vol2surf_linear"))
+      v2s_op = vol2surf_operator_alloc(SrcVol, Qsrc, Fsrc, Wsrc, Dsrc, Surf,
+                                       ProjFracMin, ProjFracMax, ProjFracDelta,
+                                       interpmethod, float2int, ProjDistFlag);
+    if (v2s_op) {
+      printf("Projecting %d depths x %d frames\n", v2s_op->ndepths,
+             SrcVol->nframes);
+      SurfVals = vol2surf_operator_apply(v2s_op, SrcVol, GetProjMax, SrcHitVol,
+                                         NULL);
+      vol2surf_operator_free(&v2s_op);
+      if (SurfVals == NULL) {
         printf("ERROR: mapping volume to source\n");
         exit(1);
       }
-      if (nproj == 0)
-        SurfVals = MRIcopy(SurfValsP, NULL);
-      else {
-        if (!GetProjMax)
-          MRIadd(SurfVals, SurfValsP, SurfVals);
-        else
-          MRImax(SurfVals, SurfValsP, SurfVals);
+    } else {
+      nproj = 0;
+      for (ProjFrac = ProjFracMin; ProjFrac <= ProjFracMax;
+           ProjFrac += ProjFracDelta) {
+        printf("%2d %g %g %g\n", nproj + 1, ProjFrac, ProjFracMin, ProjFracMax);
+        if (UseOld) {
+          printf("using old\n");
+          SurfValsP = vol2surf_linear(SrcVol, Qsrc, Fsrc, Wsrc, Dsrc, Surf,
+                                      ProjFrac, interpmethod, float2int,
+                                      SrcHitVol, ProjDistFlag, 1);
+        } else {
+          printf("using new\n");
+          SurfValsP =
+              MRIvol2surfVSM(SrcVol, Dsrc, Surf, vsm, interpmethod, SrcHitVol,
+                             ProjFrac, ProjDistFlag, 1, NULL);
+        }
+        fflush(stdout);
+        if (SurfValsP == NULL) {
+          printf("ERROR: mapping volume to source\n");
+          exit(1);
+        }
+        if (nproj == 0)
+          SurfVals = MRIcopy(SurfValsP, NULL);
+        else {
+          if (!GetProjMax)
+            MRIadd(SurfVals, SurfValsP, SurfVals);
+          else
+            MRImax(SurfVals, SurfValsP, SurfVals);
+        }
+        MRIfree(&SurfValsP);
+        nproj++;
       }
-      MRIfree(&SurfValsP);
-      nproj++;
+      if (!GetProjMax)
+        MRImultiplyConst(SurfVals, 1.0 / nproj, SurfVals);
     }
-    if (!GetProjMax)
-      MRImultiplyConst(SurfVals, 1.0 / nproj, SurfVals);
   }
 
   printf("Done mapping volume to surface\n");
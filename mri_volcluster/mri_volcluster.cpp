@@ -371,37 +371,50 @@ int main(int argc, char **argv) {
 
   printf("INFO: Found %d voxels in threhold range\n", nhits);
 
-  /* Allocate an array of clusters equal to the number of hits -- this
-     is the maximum number of clusters possible */
-  ClusterList = clustAllocClusterList(nhits);
-  if (ClusterList == nullptr) {
-    fprintf(stderr, "ERROR: could not alloc %d clusters\n", nhits);
-    exit(1);
-  }
+  if (!clustUseOldGrow()) {
+    /* Grow all the clusters at once */
+    ClusterList = clustGrowAll(HitMap, allowdiag, &nclusters);
+    if (ClusterList == nullptr) {
+      fprintf(stderr, "ERROR: could not alloc %d clusters\n", nclusters);
+      exit(1);
+    }
+    for (n = 0; n < nclusters; n++) {
+      clustMaxMember(ClusterList[n], vol, frame, threshsign);
+      clustComputeTal(ClusterList[n], CRS2MNI); /*"true" Tal coords */
+    }
+  } else {
+    /* Allocate an array of clusters equal to the number of hits -- this
+       is the maximum number of clusters possible */
+    ClusterList = clustAllocClusterList(nhits);
+    if (ClusterList == nullptr) {
+      fprintf(stderr, "ERROR: could not alloc %d clusters\n", nhits);
+      exit(1);
+    }
 
-  nclusters = 0;
-  for (nthhit = 0; nthhit < nhits; nthhit++) {
+    nclusters = 0;
+    for (nthhit = 0; nthhit < nhits; nthhit++) {
 
-    /* Determine whether this hit is still valid. It may
-       not be if it was assigned to the cluster of a
-       previous hit */
-    col = hitcol[nthhit];
-    row = hitrow[nthhit];
-    slc = hitslc[nthhit];
-    if (MRIgetVoxVal(HitMap, col, row, slc, 0))
-      continue;
+      /* Determine whether this hit is still valid. It may
+         not be if it was assigned to the cluster of a
+         previous hit */
+      col = hitcol[nthhit];
+      row = hitrow[nthhit];
+      slc = hitslc[nthhit];
+      if (MRIgetVoxVal(HitMap, col, row, slc, 0))
+        continue;
 
-    /* Grow cluster using this hit as a seed */
-    ClusterList[nclusters] = clustGrow(col, row, slc, HitMap, allowdiag);
+      /* Grow cluster using this hit as a seed */
+      ClusterList[nclusters] = clustGrow(col, row, slc, HitMap, allowdiag);
 
-    /* Determine the member with the maximum value */
-    clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
+      /* Determine the member with the maximum value */
+      clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
 
-    // clustComputeXYZ(ClusterList[nclusters],CRS2FSA); /* for FSA coords */
-    clustComputeTal(ClusterList[nclusters], CRS2MNI); /*"true" Tal coords */
+      // clustComputeXYZ(ClusterList[nclusters],CRS2FSA); /* for FSA coords */
+      clustComputeTal(ClusterList[nclusters], CRS2MNI); /*"true" Tal coords */
 
-    /* increment the number of clusters */
-    nclusters++;
+      /* increment the number of clusters */
+      nclusters++;
+    }
   }
 
   printf("INFO: Found %d clusters that meet threshold criteria\n", nclusters);
@@ -82,11 +82,13 @@ typedef struct {
   double    distthresh;
   MRI *     con, *conS, *conL;
   int       DoMat, DoTest;
+  int       DoTiled;
   MATRIX *  M;
   WBCSYNTH *wbcsynth;
 } WBC;
 
 MRI *WholeBrainCon(WBC *wbc);
+MRI *WholeBrainConTiled(WBC *wbc);
 int  WBCfinish(WBC *wbc);
 int  WBCprep(WBC *wbc);
 int  WBCnframes(WBC *wbc);
@@ -128,6 +130,7 @@ typedef struct {
   int    DoMat;
   char * matfile;
   int    DoTest, ForceFail, SaveTest;
+  int    DoTiled;
 } CMDARGS;
 
 CMDARGS *cmdargs;
@@ -143,6 +146,7 @@ int main(int argc, char *argv[]) {
   cmdargs->DoMat      = 0;
   cmdargs->nrholist   = 0;
   cmdargs->ForceFail  = 0;
+  cmdargs->DoTiled    = 1;
 
   nargs = handleVersionOption(argc, argv, "mri_wbc");
   if (nargs && argc - nargs == 1)
@@ -182,6 +186,7 @@ int main(int argc, char *argv[]) {
     wbc->rholist[n] = cmdargs->rholist[n];
   wbc->nrholist = cmdargs->nrholist;
   wbc->DoTest   = cmdargs->DoTest;
+  wbc->DoTiled  = cmdargs->DoTiled;
 
   if (wbc->DoTest == 0) {
     if (cmdargs->fvol) {
@@ -258,7 +263,10 @@ int main(int argc, char *argv[]) {
     exit(1);
 
   WBCprep(wbc);
-  WholeBrainCon(wbc);
+  if (wbc->DoTiled)
+    WholeBrainConTiled(wbc);
+  else
+    WholeBrainCon(wbc);
   WBCfinish(wbc);
 
   if (wbc->DoMat) {
@@ -513,6 +521,12 @@ static int parse_commandline(int argc, char **argv) {
       cmdargs->DoTest   = 1;
       cmdargs->SaveTest = 1;
       nargsused         = 0;
+    } else if (!strcasecmp(option, "--tiled")) {
+      cmdargs->DoTiled = 1;
+      nargsused        = 0;
+    } else if (!strcasecmp(option, "--no-tiled")) {
+      cmdargs->DoTiled = 0;
+      nargsused        = 0;
     } else if (!strcasecmp(option, "--threads") ||
                !strcasecmp(option, "--nthreads")) {
       if (nargc < 1)
@@ -567,6 +581,10 @@ static void print_usage(void) {
   printf("   --dist distthresh\n");
   printf("\n");
   printf("   --threads nthreads\n");
+  printf("   --tiled : compute the correlations with the tiled kernel "
+         "(default)\n");
+  printf("   --no-tiled : use the pair-by-pair loop instead of the tiled "
+         "kernel\n");
   printf("   --debug     turn on debugging\n");
   printf("   --checkopts don't run anything, just check options and exit\n");
   printf("   --help      print out information on how to use this program\n");
@@ -938,6 +956,290 @@ MRI *WholeBrainCon(WBC *wbc) {
   return (wbc->con);
 }
 
+/*******************************************************************************/
+/*
+  WholeBrainConTiled() - computes the same quantities as WholeBrainCon()
+  but treats the correlations as the upper triangle of F'*F, where F is
+  the nframes-by-ntot matrix of normalized time courses, and evaluates
+  it in WBC_TILE x WBC_TILE blocks (a blocked SYRK).
+
+  The normalized time courses are packed once into panels of WBC_TILE
+  items. Within a panel the data are frame-major, so a tile streams two
+  contiguous panels and the inner loop runs across items, which the
+  compiler can vectorize. The per-frame summation order is the same as
+  in WholeBrainCon(), so rho is bit-for-bit identical. Thresholding into
+  the rho counts (and the short/long split with --dist) is done on each
+  tile while it is still in cache.
+
+  Threads take whole tile rows. rhomean is only accumulated into the row
+  item (as in WholeBrainCon()), so it is written by a single thread and is
+  reproducible. The counts are kept as per-thread integers, so summing
+  them over threads is exact.
+*/
+#define WBC_TILE 32
+#define WBC_MR   4 // rows in the register block of the tile kernel
+#define WBC_NR   8 // cols in the register block of the tile kernel
+
+static void WBCtileKernel(const double *Pa, const double *Pb, int nframes,
+                          double *C) {
+  int ii, jj, t, m, n;
+
+  for (ii = 0; ii < WBC_TILE; ii += WBC_MR) {
+    for (jj = 0; jj < WBC_TILE; jj += WBC_NR) {
+      double        acc[WBC_MR][WBC_NR] = {{0}};
+      const double *pa                  = Pa + ii;
+      const double *pb                  = Pb + jj;
+      for (t = 0; t < nframes; t++) {
+        for (m = 0; m < WBC_MR; m++) {
+          double a = pa[m];
+          for (n = 0; n < WBC_NR; n++)
+            acc[m][n] += a * pb[n];
+        }
+        pa += WBC_TILE;
+        pb += WBC_TILE;
+      }
+      for (m = 0; m < WBC_MR; m++)
+        for (n = 0; n < WBC_NR; n++)
+          C[(ii + m) * WBC_TILE + jj + n] = acc[m][n];
+    }
+  }
+}
+
+MRI *WholeBrainConTiled(WBC *wbc) {
+  int     nthreads, ntiles, nframes, ntot, nrho, k, t, n;
+  double *P, *xyz, *xyz2 = NULL;
+  int *   ctype;
+  int **  cnt, **cntS = NULL, **cntL = NULL;
+  double *rhomean;
+  long    nrowsdone = 0;
+  Timer   timer;
+
+  ntot    = wbc->ntot;
+  nframes = wbc->fnorm->nframes;
+  nrho    = wbc->nrholist;
+  ntiles  = (ntot + WBC_TILE - 1) / WBC_TILE;
+
+  nthreads = 1;
+#ifdef HAVE_OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  printf("ntot = %d, nthreads = %d, ntiles = %d (tile size %d)\n", ntot,
+         nthreads, ntiles, WBC_TILE);
+
+  // Pack the normalized time courses into frame-major panels. Items past
+  // ntot in the last panel stay zero and are never thresholded.
+  P = (double *)calloc(sizeof(double), (size_t)ntiles * nframes * WBC_TILE);
+  if (P == NULL) {
+    printf("ERROR: WholeBrainConTiled(): could not alloc %d panels\n", ntiles);
+    exit(1);
+  }
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (k = 0; k < ntot; k++) {
+    ROMP_PFLB_begin
+    double *panel = P + (size_t)(k / WBC_TILE) * nframes * WBC_TILE;
+    int     tt;
+    for (tt = 0; tt < nframes; tt++)
+      panel[(size_t)tt * WBC_TILE + k % WBC_TILE] =
+          MRIgetVoxVal(wbc->fnorm, k, 0, 0, tt);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // Coordinates for the short/long split
+  ctype = (int *)calloc(sizeof(int), ntot);
+  xyz   = (double *)calloc(sizeof(double), 3 * (size_t)ntot);
+  if (wbc->xyz2)
+    xyz2 = (double *)calloc(sizeof(double), 3 * (size_t)ntot);
+  if (wbc->DoDist) {
+    for (k = 0; k < ntot; k++) {
+      ctype[k] = MRIgetVoxVal(wbc->coordtype, k, 0, 0, 0);
+      for (n = 0; n < 3; n++) {
+        xyz[3 * k + n] = MRIgetVoxVal(wbc->xyz, k, 0, 0, n);
+        if (xyz2)
+          xyz2[3 * k + n] = MRIgetVoxVal(wbc->xyz2, k, 0, 0, n);
+      }
+    }
+  }
+
+  // This is for testing. In most apps, M will be huge
+  if (wbc->DoMat)
+    wbc->M = MatrixAlloc(ntot, ntot, MATRIX_REAL);
+
+  rhomean = (double *)calloc(sizeof(double), ntot);
+  cnt     = (int **)calloc(sizeof(int *), nthreads);
+  if (wbc->DoDist) {
+    cntS = (int **)calloc(sizeof(int *), nthreads);
+    cntL = (int **)calloc(sizeof(int *), nthreads);
+  }
+  for (n = 0; n < nthreads; n++) {
+    cnt[n] = (int *)calloc(sizeof(int), (size_t)nrho * ntot);
+    if (wbc->DoDist) {
+      cntS[n] = (int *)calloc(sizeof(int), (size_t)nrho * ntot);
+      cntL[n] = (int *)calloc(sizeof(int), (size_t)nrho * ntot);
+    }
+  }
+
+  printf("rho thresholds (%d): ", nrho);
+  for (n = 0; n < nrho; n++)
+    printf("%lf ", wbc->rholist[n]);
+  printf("\n");
+
+  printf("Starting tiled WBC loop\n");
+  fflush(stdout);
+  timer.reset();
+
+  // Tile row a has ntiles-a tiles, so hand out rows dynamically
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (int a = 0; a < ntiles; a++) {
+    ROMP_PFLB_begin
+    double C[WBC_TILE * WBC_TILE];
+    int    b, ii, jj, k1, k2, jjstart, q, nthrho, thno = 0;
+    int *  cnt1, *cntD;
+    double rho, dx, dy, dz, dist;
+    long   ndone;
+
+#ifdef HAVE_OPENMP
+    thno = omp_get_thread_num();
+#endif
+    cnt1 = cnt[thno];
+
+    for (b = a; b < ntiles; b++) {
+      WBCtileKernel(P + (size_t)a * nframes * WBC_TILE,
+                    P + (size_t)b * nframes * WBC_TILE, nframes, C);
+
+      for (ii = 0; ii < WBC_TILE; ii++) {
+        k1 = a * WBC_TILE + ii;
+        if (k1 >= ntot)
+          break;
+        jjstart = (a == b) ? ii + 1 : 0;
+        for (jj = jjstart; jj < WBC_TILE; jj++) {
+          k2 = b * WBC_TILE + jj;
+          if (k2 >= ntot)
+            break;
+          rho = C[ii * WBC_TILE + jj];
+          if (wbc->M != NULL) {
+            wbc->M->rptr[k1 + 1][k2 + 1] = rho;
+            wbc->M->rptr[k2 + 1][k1 + 1] = rho;
+          }
+          rhomean[k1] += rho;
+
+          for (nthrho = 0; nthrho < nrho; nthrho++) {
+            if (fabs(rho) < wbc->rholist[nthrho])
+              continue;
+            cnt1[nthrho * ntot + k1]++;
+            cnt1[nthrho * ntot + k2]++;
+          }
+
+          if (!wbc->DoDist)
+            continue;
+
+          // See WholeBrainCon() for why the second surface is consulted
+          q = 2; // long dist
+          if (ctype[k1] == ctype[k2]) {
+            dx   = xyz[3 * k1] - xyz[3 * k2];
+            dy   = xyz[3 * k1 + 1] - xyz[3 * k2 + 1];
+            dz   = xyz[3 * k1 + 2] - xyz[3 * k2 + 2];
+            dist = sqrt(dx * dx + dy * dy + dz * dz);
+            if (dist < wbc->distthresh)
+              q = 1; // short dist
+            if (q == 1 && ((wbc->lh2 && ctype[k1] == 1) ||
+                           (wbc->rh2 && ctype[k1] == 2))) {
+              dx   = xyz2[3 * k1] - xyz2[3 * k2];
+              dy   = xyz2[3 * k1 + 1] - xyz2[3 * k2 + 1];
+              dz   = xyz2[3 * k1 + 2] - xyz2[3 * k2 + 2];
+              dist = sqrt(dx * dx + dy * dy + dz * dz);
+              if (dist >= wbc->distthresh)
+                q = 2;
+            }
+          }
+          cntD = (q == 1) ? cntS[thno] : cntL[thno];
+          for (nthrho = 0; nthrho < nrho; nthrho++) {
+            if (fabs(rho) < wbc->rholist[nthrho])
+              continue;
+            cntD[nthrho * ntot + k1]++;
+            cntD[nthrho * ntot + k2]++;
+          }
+        } // jj
+      }   // ii
+    }     // b
+
+#ifdef HAVE_OPENMP
+#pragma omp atomic capture
+#endif
+    ndone = ++nrowsdone;
+    if (ndone % 100 == 0) {
+      printf("%4.1f%% rows, t=%5.1f min\n", 100.0 * ndone / ntiles,
+             timer.minutes());
+      fflush(stdout);
+    }
+    ROMP_PFLB_end
+  } // a
+  ROMP_PF_end
+
+  // Sum up the threads
+  for (k = 0; k < ntot; k++) {
+    MRIsetVoxVal(wbc->rhomean, k, 0, 0, 0,
+                 MRIgetVoxVal(wbc->rhomean, k, 0, 0, 0) + rhomean[k]);
+    for (n = 0; n < nrho; n++) {
+      long c = 0, cS = 0, cL = 0;
+      for (t = 0; t < nthreads; t++) {
+        c += cnt[t][n * ntot + k];
+        if (wbc->DoDist) {
+          cS += cntS[t][n * ntot + k];
+          cL += cntL[t][n * ntot + k];
+        }
+      }
+      MRIsetVoxVal(wbc->con, k, 0, 0, n,
+                   MRIgetVoxVal(wbc->con, k, 0, 0, n) + c);
+      if (wbc->DoDist) {
+        MRIsetVoxVal(wbc->conS, k, 0, 0, n,
+                     MRIgetVoxVal(wbc->conS, k, 0, 0, n) + cS);
+        MRIsetVoxVal(wbc->conL, k, 0, 0, n,
+                     MRIgetVoxVal(wbc->conL, k, 0, 0, n) + cL);
+      }
+    }
+  }
+
+  // Divide number of connections by total possible
+  printf("Scaling by ntot-1 %d\n", ntot - 1);
+  MRImultiplyConst(wbc->rhomean, 1.0 / (ntot - 1), wbc->rhomean);
+  MRImultiplyConst(wbc->con, 1.0 / (ntot - 1), wbc->con);
+  if (wbc->DoDist) {
+    MRImultiplyConst(wbc->conS, 1.0 / (ntot - 1), wbc->conS);
+    MRImultiplyConst(wbc->conL, 1.0 / (ntot - 1), wbc->conL);
+  }
+
+  // Clean up
+  for (n = 0; n < nthreads; n++) {
+    free(cnt[n]);
+    if (wbc->DoDist) {
+      free(cntS[n]);
+      free(cntL[n]);
+    }
+  }
+  free(cnt);
+  if (wbc->DoDist) {
+    free(cntS);
+    free(cntL);
+  }
+  free(rhomean);
+  free(ctype);
+  free(xyz);
+  if (xyz2)
+    free(xyz2);
+  free(P);
+
+  printf(" t = %6.4f, ntot = %d\n", timer.seconds(), ntot);
+  fflush(stdout);
+  return (wbc->con);
+}
+
 int WBCprep(WBC *wbc) {
   int     nthvox, c, r, s, t, k, vtxno;
   MATRIX *V, *crs, *xyz = NULL;
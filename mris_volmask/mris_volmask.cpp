@@ -42,6 +42,7 @@
 #include "macros.h"
 #include "mri.h"
 #include "mrisurf.h"
+#include "mrisvoxelize.h"
 #include "timer.h"
 #include "version.h"
 
@@ -218,6 +219,30 @@ int main(int ac, char *av[]) {
   MRI *maskLeftHemi  = nullptr;
   MRI *maskRightHemi = nullptr;
 
+  // Distances to all surfaces in one pass, threaded over surfaces and
+  // slices. The hemi loop below falls back to the per-surface distance
+  // when FREESURFER_OLD_ComputeSurfaceDistanceFunction is set.
+  MRI *dist[4] = {nullptr, nullptr, nullptr, nullptr}; // lw, lp, rw, rp
+  if (getenv("FREESURFER_OLD_ComputeSurfaceDistanceFunction") == nullptr) {
+    MRIS *surfs[4], *all[4] = {surfLeftWhite, surfLeftPial, surfRightWhite,
+                               surfRightPial};
+    MRI * d[4];
+    int   index[4], nsurfs = 0, n;
+
+    for (n = 0; n < 4; n++)
+      if (n < 2 ? params.DoLH : params.DoRH) {
+        index[nsurfs]   = n;
+        d[nsurfs]       = nullptr;
+        surfs[nsurfs++] = all[n];
+      }
+    std::cout << "computing distance to " << nsurfs << " surfaces\n";
+    if (MRISvoxelizeSurfaces(surfs, nsurfs, mriTemplate, params.capValue, d,
+                             nullptr) != NO_ERROR)
+      ErrorExit(ERROR_BADPARM, "%s: could not voxelize surfaces", Progname);
+    for (n = 0; n < nsurfs; n++)
+      dist[index[n]] = d[n];
+  }
+
 #ifdef _OPENMP
   if (params.bParallel) {
     printf("Running hemis in parallel\n");
@@ -242,16 +267,19 @@ int main(int ac, char *av[]) {
       // proces white surface - convert to voxel-space
       //
       // allocate distance
-      MRI *dLeftWhite = MRIalloc(mriTemplate->width, mriTemplate->height,
-                                 mriTemplate->depth, MRI_FLOAT);
-      MRIcopyHeader(mriTemplate, dLeftWhite);
-
-      // Computes the signed distance to given surface. Sign indicates
-      // whether it is on the inside or outside. params.capValue -
-      // saturation/clip value for distance.
-      std::cout << "computing distance to left white surface \n";
-      ComputeSurfaceDistanceFunction(surfLeftWhite, dLeftWhite,
-                                     params.capValue);
+      MRI *dLeftWhite = dist[0];
+      if (dLeftWhite == nullptr) {
+        dLeftWhite = MRIalloc(mriTemplate->width, mriTemplate->height,
+                              mriTemplate->depth, MRI_FLOAT);
+        MRIcopyHeader(mriTemplate, dLeftWhite);
+
+        // Computes the signed distance to given surface. Sign indicates
+        // whether it is on the inside or outside. params.capValue -
+        // saturation/clip value for distance.
+        std::cout << "computing distance to left white surface \n";
+        ComputeSurfaceDistanceFunction(surfLeftWhite, dLeftWhite,
+                                       params.capValue);
+      }
       // if the option is there, output distance
       if (params.bSaveDistance)
         MRIwrite(
@@ -261,11 +289,15 @@ int main(int ac, char *av[]) {
 
       //-----------------------
       // process pial surface
-      MRI *dLeftPial = MRIalloc(mriTemplate->width, mriTemplate->height,
-                                mriTemplate->depth, MRI_FLOAT);
-      MRIcopyHeader(mriTemplate, dLeftPial);
-      std::cout << "computing distance to left pial surface \n";
-      ComputeSurfaceDistanceFunction(surfLeftPial, dLeftPial, params.capValue);
+      MRI *dLeftPial = dist[1];
+      if (dLeftPial == nullptr) {
+        dLeftPial = MRIalloc(mriTemplate->width, mriTemplate->height,
+                             mriTemplate->depth, MRI_FLOAT);
+        MRIcopyHeader(mriTemplate, dLeftPial);
+        std::cout << "computing distance to left pial surface \n";
+        ComputeSurfaceDistanceFunction(surfLeftPial, dLeftPial,
+                                       params.capValue);
+      }
       if (params.bSaveDistance)
         MRIwrite(
             dLeftPial,
@@ -289,12 +321,15 @@ int main(int ac, char *av[]) {
 
       //-------------------
       // process white
-      MRI *dRightWhite = MRIalloc(mriTemplate->width, mriTemplate->height,
-                                  mriTemplate->depth, MRI_FLOAT);
-      MRIcopyHeader(mriTemplate, dRightWhite);
-      std::cout << "computing distance to right white surface \n";
-      ComputeSurfaceDistanceFunction(surfRightWhite, dRightWhite,
-                                     params.capValue);
+      MRI *dRightWhite = dist[2];
+      if (dRightWhite == nullptr) {
+        dRightWhite = MRIalloc(mriTemplate->width, mriTemplate->height,
+                               mriTemplate->depth, MRI_FLOAT);
+        MRIcopyHeader(mriTemplate, dRightWhite);
+        std::cout << "computing distance to right white surface \n";
+        ComputeSurfaceDistanceFunction(surfRightWhite, dRightWhite,
+                                       params.capValue);
+      }
       if (params.bSaveDistance)
         MRIwrite(
             dRightWhite,
@@ -303,12 +338,15 @@ int main(int ac, char *av[]) {
 
       //--------------------
       // process pial
-      MRI *dRightPial = MRIalloc(mriTemplate->width, mriTemplate->height,
-                                 mriTemplate->depth, MRI_FLOAT);
-      MRIcopyHeader(mriTemplate, dRightPial);
-      std::cout << "computing distance to right pial surface \n";
-      ComputeSurfaceDistanceFunction(surfRightPial, dRightPial,
-                                     params.capValue);
+      MRI *dRightPial = dist[3];
+      if (dRightPial == nullptr) {
+        dRightPial = MRIalloc(mriTemplate->width, mriTemplate->height,
+                              mriTemplate->depth, MRI_FLOAT);
+        MRIcopyHeader(mriTemplate, dRightPial);
+        std::cout << "computing distance to right pial surface \n";
+        ComputeSurfaceDistanceFunction(surfRightPial, dRightPial,
+                                       params.capValue);
+      }
       if (params.bSaveDistance)
         MRIwrite(
             dRightPial,
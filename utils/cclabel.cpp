@@ -0,0 +1,319 @@
+/**
+ * @brief union-find connected-component labeling of volumes and graphs
+ *
+ */
+/*
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+
+#include "cclabel.h"
+#include "diag.h"
+#include "error.h"
+#include "romp_support.h"
+
+#define CCL_BLOCK_SLICES   4     // slices per first-pass block of a volume
+#define CCL_BLOCK_ELEMENTS 16384 // elements per first-pass block of a graph
+
+/* parent[n] is -1 for elements outside the mask. Roots are always the
+   lowest element of their tree, which is what makes the final numbering
+   independent of how the first pass was split into blocks. */
+static int cclFind(int *parent, int n) {
+  while (parent[n] != n) {
+    parent[n] = parent[parent[n]]; // path halving
+    n         = parent[n];
+  }
+  return (n);
+}
+
+static void cclUnion(int *parent, int a, int b) {
+  a = cclFind(parent, a);
+  b = cclFind(parent, b);
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+/* read-only find so that the roots can be resolved in parallel */
+static int cclRoot(const int *parent, int n) {
+  while (parent[n] != n)
+    n = parent[n];
+  return (n);
+}
+
+/*--------------------------------------------------------------------
+  cclFinish() - resolves the roots, numbers the components in order
+  of their lowest element and accumulates the per-component stats in
+  a single serial pass. Takes ownership of parent.
+  --------------------------------------------------------------------*/
+static CCLABELS *cclFinish(int *parent, int nelements, const float *val,
+                           const float *area, int thsign) {
+  CCLABELS *ccl;
+  int       n, r, c, nc;
+  float     score, *maxscore;
+
+  ccl            = (CCLABELS *)calloc(1, sizeof(CCLABELS));
+  ccl->nelements = nelements;
+  ccl->id        = (int *)calloc(nelements, sizeof(int));
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (n = 0; n < nelements; n++) {
+    ROMP_PFLB_begin
+    ccl->id[n] = (parent[n] < 0) ? -1 : cclRoot(parent, n);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // roots come before the rest of their component, so parent[] of a
+  // root can be reused for its component number
+  nc = 0;
+  for (n = 0; n < nelements; n++) {
+    r = ccl->id[n];
+    if (r < 0) {
+      ccl->id[n] = 0;
+      continue;
+    }
+    if (r == n)
+      parent[n] = ++nc;
+    ccl->id[n] = parent[r];
+  }
+  free(parent);
+
+  ccl->ncomponents = nc;
+  ccl->size        = (int *)calloc(nc + 1, sizeof(int));
+  ccl->area        = (double *)calloc(nc + 1, sizeof(double));
+  ccl->maxval      = (float *)calloc(nc + 1, sizeof(float));
+  ccl->maxelement  = (int *)calloc(nc + 1, sizeof(int));
+  ccl->first       = (int *)calloc(nc + 1, sizeof(int));
+  maxscore         = (float *)calloc(nc + 1, sizeof(float));
+
+  for (n = 0; n < nelements; n++) {
+    c = ccl->id[n];
+    if (c == 0)
+      continue;
+    ccl->size[c]++;
+    ccl->area[c] += area ? area[n] : 1.0;
+    score = 0;
+    if (val) {
+      score = val[n];
+      if (thsign == 0)
+        score = fabs(score);
+      if (thsign == -1)
+        score = -score;
+    }
+    if (ccl->size[c] == 1) {
+      ccl->first[c]      = n;
+      ccl->maxelement[c] = n;
+      ccl->maxval[c]     = val ? val[n] : 0;
+      maxscore[c]        = score;
+    } else if (score > maxscore[c]) {
+      ccl->maxelement[c] = n;
+      ccl->maxval[c]     = val[n];
+      maxscore[c]        = score;
+    }
+  }
+  free(maxscore);
+
+  return (ccl);
+}
+
+/*--------------------------------------------------------------------
+  CCLlabelVolume() - labels the 6/18/26-connected components of the
+  nonzero voxels of mask. The first pass unions each voxel with its
+  already-scanned neighbors inside a slab of CCL_BLOCK_SLICES slices,
+  slabs in parallel. The slab boundaries are then merged serially.
+  --------------------------------------------------------------------*/
+CCLABELS *CCLlabelVolume(const unsigned char *mask, int width, int height,
+                         int depth, int connectivity, const float *val,
+                         const float *area, int thsign) {
+  int  nelements, nblocks, maxsum, noff, b, dc, dr, ds;
+  int  offc[13], offr[13], offs[13];
+  int *parent;
+
+  switch (connectivity) {
+  case 6:
+    maxsum = 1;
+    break;
+  case 18:
+    maxsum = 2;
+    break;
+  case 26:
+    maxsum = 3;
+    break;
+  default:
+    ErrorReturn(nullptr,
+                (ERROR_BADPARM,
+                 "CCLlabelVolume: connectivity %d must be 6, 18 or 26",
+                 connectivity));
+  }
+
+  // neighbors that come before a voxel in raster order
+  noff = 0;
+  for (ds = -1; ds <= 0; ds++) {
+    for (dr = -1; dr <= 1; dr++) {
+      for (dc = -1; dc <= 1; dc++) {
+        if (ds == 0 && (dr > 0 || (dr == 0 && dc >= 0)))
+          continue;
+        if (abs(dc) + abs(dr) + abs(ds) > maxsum)
+          continue;
+        offc[noff] = dc;
+        offr[noff] = dr;
+        offs[noff] = ds;
+        noff++;
+      }
+    }
+  }
+
+  nelements = width * height * depth;
+  parent    = (int *)malloc(nelements * sizeof(int));
+  if (parent == nullptr)
+    ErrorReturn(nullptr, (ERROR_NOMEMORY,
+                          "CCLlabelVolume: could not alloc %d", nelements));
+  nblocks = (depth + CCL_BLOCK_SLICES - 1) / CCL_BLOCK_SLICES;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (b = 0; b < nblocks; b++) {
+    ROMP_PFLB_begin
+    int s0 = b * CCL_BLOCK_SLICES;
+    int s1 = s0 + CCL_BLOCK_SLICES;
+    if (s1 > depth)
+      s1 = depth;
+    for (int s = s0; s < s1; s++) {
+      for (int r = 0; r < height; r++) {
+        for (int c = 0; c < width; c++) {
+          int n = c + width * (r + height * s);
+          if (!mask[n]) {
+            parent[n] = -1;
+            continue;
+          }
+          parent[n] = n;
+          for (int k = 0; k < noff; k++) {
+            int s2 = s + offs[k], r2 = r + offr[k], c2 = c + offc[k];
+            if (s2 < s0 || r2 < 0 || r2 >= height || c2 < 0 || c2 >= width)
+              continue;
+            int n2 = c2 + width * (r2 + height * s2);
+            if (parent[n2] >= 0)
+              cclUnion(parent, n, n2);
+          }
+        }
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // join each slab to the last slice of the one before it
+  for (b = 1; b < nblocks; b++) {
+    int s = b * CCL_BLOCK_SLICES;
+    for (int r = 0; r < height; r++) {
+      for (int c = 0; c < width; c++) {
+        int n = c + width * (r + height * s);
+        if (parent[n] < 0)
+          continue;
+        for (int k = 0; k < noff; k++) {
+          if (offs[k] == 0)
+            continue;
+          int r2 = r + offr[k], c2 = c + offc[k];
+          if (r2 < 0 || r2 >= height || c2 < 0 || c2 >= width)
+            continue;
+          int n2 = c2 + width * (r2 + height * (s - 1));
+          if (parent[n2] >= 0)
+            cclUnion(parent, n, n2);
+        }
+      }
+    }
+  }
+
+  return (cclFinish(parent, nelements, val, area, thsign));
+}
+
+/*--------------------------------------------------------------------
+  CCLlabelGraph() - same as CCLlabelVolume() for a graph in CSR form.
+  Edges inside a block of CCL_BLOCK_ELEMENTS elements are joined in
+  parallel, edges between blocks serially afterwards.
+  --------------------------------------------------------------------*/
+CCLABELS *CCLlabelGraph(const unsigned char *mask, int nelements,
+                        const int *xadj, const int *adjncy, const float *val,
+                        const float *area, int thsign) {
+  int  nblocks, b, n, k, m;
+  int *parent;
+
+  parent = (int *)malloc((nelements > 0 ? nelements : 1) * sizeof(int));
+  if (parent == nullptr)
+    ErrorReturn(nullptr, (ERROR_NOMEMORY,
+                          "CCLlabelGraph: could not alloc %d", nelements));
+  nblocks = (nelements + CCL_BLOCK_ELEMENTS - 1) / CCL_BLOCK_ELEMENTS;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (b = 0; b < nblocks; b++) {
+    ROMP_PFLB_begin
+    int n0 = b * CCL_BLOCK_ELEMENTS;
+    int n1 = n0 + CCL_BLOCK_ELEMENTS;
+    if (n1 > nelements)
+      n1 = nelements;
+    for (int n = n0; n < n1; n++)
+      parent[n] = mask[n] ? n : -1;
+    for (int n = n0; n < n1; n++) {
+      if (parent[n] < 0)
+        continue;
+      for (int k = xadj[n]; k < xadj[n + 1]; k++) {
+        int m = adjncy[k];
+        if (m >= n0 && m < n1 && parent[m] >= 0)
+          cclUnion(parent, n, m);
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (n = 0; n < nelements; n++) {
+    if (parent[n] < 0)
+      continue;
+    b = n / CCL_BLOCK_ELEMENTS;
+    for (k = xadj[n]; k < xadj[n + 1]; k++) {
+      m = adjncy[k];
+      if (m / CCL_BLOCK_ELEMENTS != b && parent[m] >= 0)
+        cclUnion(parent, n, m);
+    }
+  }
+
+  return (cclFinish(parent, nelements, val, area, thsign));
+}
+
+/*--------------------------------------------------------------------*/
+int CCLfree(CCLABELS **pccl) {
+  CCLABELS *ccl = *pccl;
+
+  if (ccl == nullptr)
+    return (0);
+  free(ccl->id);
+  free(ccl->size);
+  free(ccl->area);
+  free(ccl->maxval);
+  free(ccl->maxelement);
+  free(ccl->first);
+  free(ccl);
+  *pccl = nullptr;
+  return (0);
+}
@@ -20,6 +20,7 @@
 /* connectcomp.c */
 
 #include "connectcomp.h"
+#include "cclabel.h"
 #include "mri.h"
 #include <cstdio>
 #include <cstdlib>
@@ -332,9 +333,74 @@ void GrassFire18(MRI *orivol, MRI *Label, int label, POINTI *Pt, int *curSize,
   return;
 }
 
+/* Labels the components once with the union-find labeler in cclabel.cpp
+   instead of one grass fire per component. Ties in size go to the component
+   the grass-fire scan (y, then x, then z) reaches first, as before. Setting
+   FREESURFER_OLD_GetLargestCC keeps the grass-fire version. */
+static int GetLargestCCUseOld() {
+  static int use_old = -1;
+  if (use_old < 0)
+    use_old = (getenv("FREESURFER_OLD_GetLargestCC") != NULL);
+  return use_old;
+}
+
+static void GetLargestCCLabeled(MRI *orivol, int connectivity) {
+  int            i, j, k, c, n, id, key, maxLabel;
+  int            XN, YN, ZN, *firstkey;
+  unsigned char *mask;
+  CCLABELS *     ccl;
+
+  XN = orivol->width;
+  YN = orivol->height;
+  ZN = orivol->depth;
+
+  mask = (unsigned char *)calloc((size_t)XN * YN * ZN, 1);
+  for (k = 0; k < ZN; k++)
+    for (i = 0; i < YN; i++)
+      for (j = 0; j < XN; j++)
+        mask[j + XN * (i + YN * k)] = (MRIgetVoxVal(orivol, j, i, k, 0) > 0);
+  ccl = CCLlabelVolume(mask, XN, YN, ZN, connectivity, NULL, NULL, 1);
+  free(mask);
+  if (ccl == NULL)
+    return;
+
+  firstkey = (int *)malloc((ccl->ncomponents + 1) * sizeof(int));
+  for (c = 0; c <= ccl->ncomponents; c++)
+    firstkey[c] = XN * YN * ZN;
+  for (k = 0; k < ZN; k++)
+    for (i = 0; i < YN; i++)
+      for (j = 0; j < XN; j++) {
+        id  = ccl->id[j + XN * (i + YN * k)];
+        key = (i * XN + j) * ZN + k;
+        if (id && key < firstkey[id])
+          firstkey[id] = key;
+      }
+
+  maxLabel = 0;
+  for (c = 1; c <= ccl->ncomponents; c++)
+    if (maxLabel == 0 || ccl->size[c] > ccl->size[maxLabel] ||
+        (ccl->size[c] == ccl->size[maxLabel] &&
+         firstkey[c] < firstkey[maxLabel]))
+      maxLabel = c;
+
+  for (k = 0, n = 0; k < ZN; k++)
+    for (i = 0; i < YN; i++)
+      for (j = 0; j < XN; j++, n++)
+        if (ccl->id[n] == 0 || ccl->id[n] != maxLabel)
+          MRIsetVoxVal(orivol, j, i, k, 0, 0);
+
+  free(firstkey);
+  CCLfree(&ccl);
+}
+
 void GetLargestCC6(MRI *orivol) {
   /* This function keeps the largest CC, and reset all other CC to bgvalue (0)
    */
+  if (!GetLargestCCUseOld()) {
+    GetLargestCCLabeled(orivol, 6);
+    return;
+  }
+
   MRI *  Label;
   int    i, j, k;
   int    maxSize, maxLabel, curSize, curLabel;
@@ -390,6 +456,11 @@ void GetLargestCC6(MRI *orivol) {
 void GetLargestCC18(MRI *orivol) {
   /* This function keeps the largest CC, and reset all other CC to bgvalue (0)
    */
+  if (!GetLargestCCUseOld()) {
+    GetLargestCCLabeled(orivol, 18);
+    return;
+  }
+
   MRI *  Label;
   int    i, j, k;
   int    maxSize, maxLabel, curSize, curLabel;
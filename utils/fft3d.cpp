@@ -0,0 +1,497 @@
+/**
+ * @brief reentrant, multi-threaded mixed-radix 3D real FFT
+ *
+ */
+/*
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "diag.h"
+#include "error.h"
+#include "fft3d.h"
+#include "romp_support.h"
+
+#define FFT3D_MAX_FACTORS 32
+#define FFT3D_ALIGNMENT   64
+#define FFT3D_LINES       8 // lines gathered per task along y and z
+
+/* One complex transform length. w[2*j],w[2*j+1] is exp(-2*pi*i*j/n). The
+   lines themselves are transformed in double precision in per-thread
+   scratch, so a plan is read-only once built and can be shared. */
+typedef struct {
+  int     n;
+  int     nfactors;
+  int     factors[FFT3D_MAX_FACTORS];
+  int     maxradix;
+  double *w;
+} FFT1D_PLAN;
+
+/* doubles of scratch fft1d() needs besides the line itself */
+#define FFT1D_SCRATCH(p) (2 * (p)->n + 4 * (p)->maxradix)
+
+struct FFT3D_PLAN {
+  int         nx, ny, nz, nxc;
+  FFT1D_PLAN  px, py, pz;
+  FFT3D_PLAN *next; // plan cache
+};
+
+static FFT3D_PLAN *fft3dPlans = nullptr;
+
+static int fft1dInit(FFT1D_PLAN *p, int n) {
+  int    f, m, j;
+  double a;
+
+  p->n        = n;
+  p->nfactors = 0;
+  p->maxradix = 4;
+  m           = n;
+  // radix 4 first, then the primes in increasing order
+  while (m % 4 == 0) {
+    p->factors[p->nfactors++] = 4;
+    m /= 4;
+  }
+  for (f = 2; m > 1; f++) {
+    if (f * f > m)
+      f = m;
+    while (m % f == 0) {
+      p->factors[p->nfactors++] = f;
+      m /= f;
+    }
+    if (f > p->maxradix && n % f == 0)
+      p->maxradix = f;
+  }
+
+  p->w = (double *)malloc(2 * n * sizeof(double));
+  if (p->w == nullptr)
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY, "fft1dInit: could not alloc %d", n));
+  for (j = 0; j < n; j++) {
+    a               = -2.0 * M_PI * j / n;
+    p->w[2 * j]     = cos(a);
+    p->w[2 * j + 1] = sin(a);
+  }
+  return (NO_ERROR);
+}
+
+/*--------------------------------------------------------------------
+  fft1d() - complex transform of the n interleaved (re,im) pairs in x,
+  using y (FFT1D_SCRATCH doubles) as scratch. Self-sorting (Stockham)
+  mixed-radix decimation in frequency: each stage splits the current
+  length len into r interleaved sequences of length len/r, so no bit
+  reversal is needed. sign is -1 forward and +1 backward, unnormalized.
+  --------------------------------------------------------------------*/
+static void fft1d(const FFT1D_PLAN *p, double *x, double *y, int sign) {
+  int           n = p->n, len = n, s = 1, f, r, m, j, q, t, u, tw, idx;
+  double *      a = x, *b = y, *tmp, wr, wi, sr, si;
+  double *      yr = y + 2 * n, *yi = yr + p->maxradix;
+  double *      ar = yi + p->maxradix, *ai = ar + p->maxradix;
+  const double *w   = p->w;
+  double const  si3 = sign * sqrt(3.0) / 2;
+
+  for (f = 0; f < p->nfactors; f++) {
+    r = p->factors[f];
+    m = len / r;
+    for (j = 0; j < m; j++) {
+      tw = j * (n / len); // twiddle step of W_len^j
+      for (q = 0; q < s; q++) {
+        double *in  = a + 2 * (q + s * j);
+        double *out = b + 2 * (q + s * r * j);
+
+        if (r == 2) {
+          yr[0] = in[0] + in[2 * s * m];
+          yi[0] = in[1] + in[2 * s * m + 1];
+          yr[1] = in[0] - in[2 * s * m];
+          yi[1] = in[1] - in[2 * s * m + 1];
+        } else if (r == 4) {
+          double *i1 = in + 2 * s * m, *i2 = i1 + 2 * s * m,
+                 *i3 = i2 + 2 * s * m;
+          double t0r = in[0] + i2[0], t0i = in[1] + i2[1];
+          double t1r = in[0] - i2[0], t1i = in[1] - i2[1];
+          double t2r = i1[0] + i3[0], t2i = i1[1] + i3[1];
+          // (i1 - i3) times W_4 = -i forward, +i backward
+          double t3r = -sign * (i1[1] - i3[1]), t3i = sign * (i1[0] - i3[0]);
+          yr[0] = t0r + t2r;
+          yi[0] = t0i + t2i;
+          yr[1] = t1r + t3r;
+          yi[1] = t1i + t3i;
+          yr[2] = t0r - t2r;
+          yi[2] = t0i - t2i;
+          yr[3] = t1r - t3r;
+          yi[3] = t1i - t3i;
+        } else if (r == 3) {
+          double *i1 = in + 2 * s * m, *i2 = i1 + 2 * s * m;
+          double  tr = i1[0] + i2[0], ti = i1[1] + i2[1];
+          double  dr = i1[0] - i2[0], di = i1[1] - i2[1];
+          yr[0] = in[0] + tr;
+          yi[0] = in[1] + ti;
+          yr[1] = in[0] - 0.5 * tr - si3 * di;
+          yi[1] = in[1] - 0.5 * ti + si3 * dr;
+          yr[2] = in[0] - 0.5 * tr + si3 * di;
+          yi[2] = in[1] - 0.5 * ti - si3 * dr;
+        } else {
+          for (t = 0; t < r; t++) {
+            ar[t] = in[2 * s * m * t];
+            ai[t] = in[2 * s * m * t + 1];
+          }
+          for (u = 0; u < r; u++) {
+            sr = ar[0];
+            si = ai[0];
+            for (t = 1; t < r; t++) {
+              idx = ((t * u) % r) * (n / r);
+              wr  = w[2 * idx];
+              wi  = -sign * w[2 * idx + 1];
+              sr += ar[t] * wr - ai[t] * wi;
+              si += ar[t] * wi + ai[t] * wr;
+            }
+            yr[u] = sr;
+            yi[u] = si;
+          }
+        }
+
+        out[0] = yr[0];
+        out[1] = yi[0];
+        for (u = 1; u < r; u++) {
+          idx                = tw * u;
+          wr                 = w[2 * idx];
+          wi                 = -sign * w[2 * idx + 1];
+          out[2 * s * u]     = yr[u] * wr - yi[u] * wi;
+          out[2 * s * u + 1] = yr[u] * wi + yi[u] * wr;
+        }
+      }
+    }
+    tmp = a;
+    a   = b;
+    b   = tmp;
+    s *= r;
+    len = m;
+  }
+  if (a != x)
+    memcpy(x, a, 2 * n * sizeof(double));
+}
+
+/*--------------------------------------------------------------------
+  fft3dScratchAlloc() - one block of n doubles for each OpenMP thread,
+  allocated up front since the parallel loops cannot return an error.
+  Returns NULL if any of them cannot be allocated.
+  --------------------------------------------------------------------*/
+static double **fft3dScratchAlloc(size_t n, int *pnthreads) {
+  double **scratch;
+  int      t;
+
+#ifdef HAVE_OPENMP
+  *pnthreads = omp_get_max_threads();
+#else
+  *pnthreads = 1;
+#endif
+  scratch = (double **)calloc(*pnthreads, sizeof(double *));
+  if (scratch == nullptr)
+    ErrorReturn(nullptr, (ERROR_NOMEMORY,
+                          "fft3dScratchAlloc: could not alloc %d threads",
+                          *pnthreads));
+  for (t = 0; t < *pnthreads; t++) {
+    scratch[t] = (double *)malloc(n * sizeof(double));
+    if (scratch[t] == nullptr) {
+      while (t-- > 0)
+        free(scratch[t]);
+      free(scratch);
+      ErrorReturn(nullptr, (ERROR_NOMEMORY,
+                            "fft3dScratchAlloc: could not alloc %lu doubles",
+                            (unsigned long)n));
+    }
+  }
+  return (scratch);
+}
+
+static void fft3dScratchFree(double **scratch, int nthreads) {
+  for (int t = 0; t < nthreads; t++)
+    free(scratch[t]);
+  free(scratch);
+}
+
+/*--------------------------------------------------------------------
+  fft3dRows() - real transforms along x. Two real rows a and b are
+  transformed together as the complex row a + i*b and separated using
+  A[k] = (Z[k] + conj(Z[n-k]))/2 and B[k] = (Z[k] - conj(Z[n-k]))/2i.
+  The backward direction rebuilds Z from the two half spectra and
+  applies scale to the result.
+  --------------------------------------------------------------------*/
+static int fft3dRows(const FFT3D_PLAN *plan, float *data, int sign,
+                     double scale) {
+  int nx = plan->nx, nxc = plan->nxc, nrows = plan->ny * plan->nz;
+  int npairs = (nrows + 1) / 2;
+  int ntasks = (npairs + FFT3D_LINES - 1) / FFT3D_LINES, task, nthreads;
+  double **scratch =
+      fft3dScratchAlloc(2 * nx + FFT1D_SCRATCH(&plan->px), &nthreads);
+
+  if (scratch == nullptr)
+    return (ERROR_NOMEMORY);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (task = 0; task < ntasks; task++) {
+    ROMP_PFLB_begin
+#ifdef HAVE_OPENMP
+    double *z = scratch[omp_get_thread_num()];
+#else
+    double *z = scratch[0];
+#endif
+    double *y = z + 2 * nx;
+    int     p1 = (task + 1) * FFT3D_LINES;
+    if (p1 > npairs)
+      p1 = npairs;
+    for (int p = task * FFT3D_LINES; p < p1; p++) {
+      float *a = data + (size_t)2 * nxc * (2 * p);
+      float *b = (2 * p + 1 < nrows) ? a + 2 * nxc : nullptr;
+      if (sign < 0) {
+        for (int j = 0; j < nx; j++) {
+          z[2 * j]     = a[j];
+          z[2 * j + 1] = b ? b[j] : 0;
+        }
+        fft1d(&plan->px, z, y, -1);
+        for (int k = 0; k < nxc; k++) {
+          int    kc = (nx - k) % nx;
+          double zr = z[2 * k], zi = z[2 * k + 1];
+          double cr = z[2 * kc], ci = -z[2 * kc + 1];
+          a[2 * k]     = 0.5 * (zr + cr);
+          a[2 * k + 1] = 0.5 * (zi + ci);
+          if (b) {
+            b[2 * k]     = 0.5 * (zi - ci);
+            b[2 * k + 1] = -0.5 * (zr - cr);
+          }
+        }
+      } else {
+        for (int k = 0; k < nx; k++) {
+          int    kc = (k < nxc) ? k : nx - k;
+          double c  = (k < nxc) ? 1 : -1; // conjugate the mirrored half
+          double ar = a[2 * kc], ai = c * a[2 * kc + 1];
+          double br = b ? b[2 * kc] : 0, bi = b ? c * b[2 * kc + 1] : 0;
+          z[2 * k]     = ar - bi;
+          z[2 * k + 1] = ai + br;
+        }
+        fft1d(&plan->px, z, y, 1);
+        for (int j = 0; j < nx; j++) {
+          a[j] = scale * z[2 * j];
+          if (b)
+            b[j] = scale * z[2 * j + 1];
+        }
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  fft3dScratchFree(scratch, nthreads);
+  return (NO_ERROR);
+}
+
+/*--------------------------------------------------------------------
+  fft3dColumns() - complex transforms along y (axis 1) or z (axis 2).
+  Each task gathers FFT3D_LINES neighboring kx lines so that the
+  strided reads use whole cache lines.
+  --------------------------------------------------------------------*/
+static int fft3dColumns(const FFT3D_PLAN *plan, float *data, int axis,
+                        int sign) {
+  const FFT1D_PLAN *p = (axis == 1) ? &plan->py : &plan->pz;
+  int    n = p->n, nxc = plan->nxc, nother, nblocks, ntasks, task, nthreads;
+  size_t stride, ostride;
+  double **scratch;
+
+  if (n == 1)
+    return (NO_ERROR);
+  if (axis == 1) { // lines along y for each z
+    nother  = plan->nz;
+    stride  = nxc;
+    ostride = (size_t)nxc * plan->ny;
+  } else { // lines along z for each y
+    nother  = plan->ny;
+    stride  = (size_t)nxc * plan->ny;
+    ostride = nxc;
+  }
+  nblocks = (nxc + FFT3D_LINES - 1) / FFT3D_LINES;
+  ntasks  = nother * nblocks;
+  scratch = fft3dScratchAlloc(FFT3D_LINES * 2 * n + FFT1D_SCRATCH(p),
+                              &nthreads);
+  if (scratch == nullptr)
+    return (ERROR_NOMEMORY);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (task = 0; task < ntasks; task++) {
+    ROMP_PFLB_begin
+#ifdef HAVE_OPENMP
+    double *buf = scratch[omp_get_thread_num()];
+#else
+    double *buf = scratch[0];
+#endif
+    double *y   = buf + FFT3D_LINES * 2 * n;
+    int     k0  = (task % nblocks) * FFT3D_LINES;
+    int     nk  = nxc - k0 < FFT3D_LINES ? nxc - k0 : FFT3D_LINES;
+    float * base = data + 2 * ((task / nblocks) * ostride + k0);
+    for (int i = 0; i < n; i++) {
+      float *v = base + 2 * i * stride;
+      for (int k = 0; k < nk; k++) {
+        buf[2 * (k * n + i)]     = v[2 * k];
+        buf[2 * (k * n + i) + 1] = v[2 * k + 1];
+      }
+    }
+    for (int k = 0; k < nk; k++)
+      fft1d(p, buf + 2 * k * n, y, sign);
+    for (int i = 0; i < n; i++) {
+      float *v = base + 2 * i * stride;
+      for (int k = 0; k < nk; k++) {
+        v[2 * k]     = buf[2 * (k * n + i)];
+        v[2 * k + 1] = buf[2 * (k * n + i) + 1];
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  fft3dScratchFree(scratch, nthreads);
+  return (NO_ERROR);
+}
+
+/*--------------------------------------------------------------------*/
+const FFT3D_PLAN *FFT3Dplan(int nx, int ny, int nz) {
+  FFT3D_PLAN *plan;
+  int         cached = 0;
+
+  if (nx < 1 || ny < 1 || nz < 1)
+    ErrorReturn(nullptr, (ERROR_BADPARM, "FFT3Dplan: bad size %dx%dx%d", nx,
+                          ny, nz));
+
+  plan = nullptr;
+#ifdef HAVE_OPENMP
+#pragma omp critical(fft3d_plans)
+#endif
+  {
+    for (plan = fft3dPlans; plan; plan = plan->next)
+      if (plan->nx == nx && plan->ny == ny && plan->nz == nz)
+        break;
+    if (plan == nullptr)
+      plan = (FFT3D_PLAN *)calloc(1, sizeof(FFT3D_PLAN));
+    else
+      cached = 1;
+    if (plan == nullptr)
+      ErrorPrintf(ERROR_NOMEMORY, "FFT3Dplan: could not alloc plan");
+    else if (!cached) {
+      plan->nx  = nx;
+      plan->ny  = ny;
+      plan->nz  = nz;
+      plan->nxc = nx / 2 + 1;
+      if (fft1dInit(&plan->px, nx) != NO_ERROR ||
+          fft1dInit(&plan->py, ny) != NO_ERROR ||
+          fft1dInit(&plan->pz, nz) != NO_ERROR) {
+        free(plan->px.w);
+        free(plan->py.w);
+        free(plan->pz.w);
+        free(plan);
+        plan = nullptr;
+      } else {
+        plan->next = fft3dPlans;
+        fft3dPlans = plan;
+      }
+    }
+  }
+  return (plan);
+}
+
+/* must not be called while a transform is running */
+int FFT3DclearPlans(void) {
+  FFT3D_PLAN *plan;
+
+#ifdef HAVE_OPENMP
+#pragma omp critical(fft3d_plans)
+#endif
+  {
+    while ((plan = fft3dPlans) != nullptr) {
+      fft3dPlans = plan->next;
+      free(plan->px.w);
+      free(plan->py.w);
+      free(plan->pz.w);
+      free(plan);
+    }
+  }
+  return (NO_ERROR);
+}
+
+/*--------------------------------------------------------------------*/
+int FFT3DgoodSize(int n) {
+  int m;
+
+  if (n < 1)
+    return (1);
+  for (;; n++) {
+    m = n;
+    while (m % 2 == 0)
+      m /= 2;
+    while (m % 3 == 0)
+      m /= 3;
+    while (m % 5 == 0)
+      m /= 5;
+    if (m == 1)
+      return (n);
+  }
+}
+
+/*--------------------------------------------------------------------*/
+float *FFT3Dalloc(int nx, int ny, int nz) {
+  void * ptr;
+  size_t size = (size_t)2 * (nx / 2 + 1) * ny * nz * sizeof(float);
+
+  if (posix_memalign(&ptr, FFT3D_ALIGNMENT, size))
+    ErrorReturn(nullptr, (ERROR_NOMEMORY, "FFT3Dalloc: could not alloc %lu",
+                          (unsigned long)size));
+  memset(ptr, 0, size);
+  return ((float *)ptr);
+}
+
+int FFT3Dfree(float **pdata) {
+  free(*pdata);
+  *pdata = nullptr;
+  return (NO_ERROR);
+}
+
+/*--------------------------------------------------------------------*/
+int FFT3Dforward(const FFT3D_PLAN *plan, float *data) {
+  int err;
+
+  if (plan == nullptr || data == nullptr)
+    ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "FFT3Dforward: no plan/data"));
+  if ((err = fft3dRows(plan, data, -1, 1)) != NO_ERROR ||
+      (err = fft3dColumns(plan, data, 1, -1)) != NO_ERROR ||
+      (err = fft3dColumns(plan, data, 2, -1)) != NO_ERROR)
+    return (err);
+  return (NO_ERROR);
+}
+
+int FFT3Dbackward(const FFT3D_PLAN *plan, float *data) {
+  int err;
+
+  if (plan == nullptr || data == nullptr)
+    ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "FFT3Dbackward: no plan/data"));
+  if ((err = fft3dColumns(plan, data, 2, 1)) != NO_ERROR ||
+      (err = fft3dColumns(plan, data, 1, 1)) != NO_ERROR ||
+      (err = fft3dRows(plan, data, 1,
+                       1.0 / ((double)plan->nx * plan->ny * plan->nz))) !=
+          NO_ERROR)
+    return (err);
+  return (NO_ERROR);
+}
@@ -25,6 +25,7 @@
 #include "proto.h"
 #include "utils.h" // strcpyalloc
 #include <cerrno>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -299,6 +300,93 @@ int fwriteDouble(double d, FILE *fp) {
   return (fwrite(&d, sizeof(double), 1, fp));
 }
 
+/*----------------------------------------
+  Bulk big-endian readers and writers. The swap is a plain loop over 32 bit
+  words, which the compiler turns into vector byte shuffles.
+  ----------------------------------------*/
+static void fioSwap4(void *buf, size_t n) {
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  uint32_t *const u = (uint32_t *)buf;
+  for (size_t i = 0; i < n; i++) {
+    u[i] = __builtin_bswap32(u[i]);
+  }
+#endif
+}
+
+static size_t fioReadArray4(void *buf, size_t n, FILE *fp, const char *who) {
+  size_t nread = fread(buf, 4, n, fp);
+  if (nread != n) {
+    ErrorPrintf(ERROR_BADFILE, "%s: read %zu of %zu values", who, nread, n);
+    memset((char *)buf + 4 * nread, 0, 4 * (n - nread));
+  }
+  fioSwap4(buf, nread);
+  return (nread);
+}
+
+size_t freadFloatArray(float *buf, size_t n, FILE *fp) {
+  return (fioReadArray4(buf, n, fp, "freadFloatArray"));
+}
+
+size_t freadIntArray(int *buf, size_t n, FILE *fp) {
+  return (fioReadArray4(buf, n, fp, "freadIntArray"));
+}
+
+size_t fread3Array(int *buf, size_t n, FILE *fp) {
+  /* decode from the end so the 3 byte values can be read into buf itself */
+  unsigned char *const b     = (unsigned char *)buf;
+  size_t const         nread = fread(b, 3, n, fp);
+
+  for (size_t i = nread; i-- > 0;) {
+    buf[i] = (b[3 * i] << 16) | (b[3 * i + 1] << 8) | b[3 * i + 2];
+  }
+  if (nread != n) {
+    ErrorPrintf(ERROR_BADFILE, "fread3Array: read %zu of %zu values", nread,
+                n);
+    memset(buf + nread, 0, sizeof(int) * (n - nread));
+  }
+  return (nread);
+}
+
+#define FIO_STAGING_WORDS 16384
+
+static size_t fioWriteArray4(const void *buf, size_t n, FILE *fp) {
+  uint32_t staging[FIO_STAGING_WORDS];
+  size_t   nwritten = 0;
+
+  for (size_t i = 0; i < n; i += FIO_STAGING_WORDS) {
+    size_t const m = (n - i < FIO_STAGING_WORDS) ? n - i : FIO_STAGING_WORDS;
+    memcpy(staging, (const uint32_t *)buf + i, 4 * m);
+    fioSwap4(staging, m);
+    nwritten += fwrite(staging, 4, m, fp);
+  }
+  return (nwritten);
+}
+
+size_t fwriteFloatArray(const float *buf, size_t n, FILE *fp) {
+  return (fioWriteArray4(buf, n, fp));
+}
+
+size_t fwriteIntArray(const int *buf, size_t n, FILE *fp) {
+  return (fioWriteArray4(buf, n, fp));
+}
+
+size_t fwrite3Array(const int *buf, size_t n, FILE *fp) {
+  unsigned char staging[3 * FIO_STAGING_WORDS];
+  size_t        nwritten = 0;
+
+  for (size_t i = 0; i < n; i += FIO_STAGING_WORDS) {
+    size_t const m = (n - i < FIO_STAGING_WORDS) ? n - i : FIO_STAGING_WORDS;
+    for (size_t j = 0; j < m; j++) {
+      unsigned int const v = (unsigned int)buf[i + j];
+      staging[3 * j]       = (v >> 16) & 0xff;
+      staging[3 * j + 1]   = (v >> 8) & 0xff;
+      staging[3 * j + 2]   = v & 0xff;
+    }
+    nwritten += fwrite(staging, 3, m, fp);
+  }
+  return (nwritten);
+}
+
 /*------ znzlib support ------------*/
 /* Note: an mgz file has a variable number of fields that get written at the
   end of the file. The reader keeps reading until it gets an EOF at which
@@ -142,6 +142,7 @@ static VECTOR *load_sample_mean_vector(GCA_SAMPLE *gcas, VECTOR *v_means,
 static MATRIX *load_sample_covariance_matrix(GCA_SAMPLE *gcas, MATRIX *m_cov,
                                              int ninputs);
 static double  sample_covariance_determinant(GCA_SAMPLE *gcas, int ninputs);
+static double  gcaLogCovarianceDeterminant(const GC1D *gc, int ninputs);
 static GC1D *  gcanGetGC(GCA_NODE *gcan, int label);
 static GC1D *  findGCInWindow(GCA *gca, int x, int y, int z, int label,
                               int wsize);
@@ -319,6 +320,7 @@ void GCAcopyDCToGCA(GCA *gca, GCA *gca_dst) {
 }
 
 void GCAcleanup(GCA *gca) {
+  GCAclearVoxelMap(gca);
   if (gca->mri_node__) {
     MRIfree(&gca->mri_node__);
     gca->mri_node__ = 0;
@@ -363,6 +365,8 @@ void GCAcleanup(GCA *gca) {
 
 // set up mri's used in GCA
 void GCAsetup(GCA *gca) {
+  // the prior geometry may change, so a voxel map would be stale
+  GCAclearVoxelMap(gca);
   // set up node part /////////////////////
   if (gca->mri_node__) {
     MRIfree(&gca->mri_node__);
@@ -1064,9 +1068,9 @@ int GCApriorToVoxel(GCA *gca, MRI *mri, int xp, int yp, int zp, int *pxv,
 ///////////////////////////////////////////////////////////////////////
 // transform from source -> template space -> prior
 //////////////////////////////////////////////////////////////////////
-int GCAsourceVoxelToPrior(const GCA *gca, MRI *mri, TRANSFORM *transform,
-                          int xv, int yv, int zv, int *pxp, int *pyp,
-                          int *pzp) {
+static int gcaSourceVoxelToPrior(const GCA *gca, MRI *mri,
+                                 TRANSFORM *transform, int xv, int yv, int zv,
+                                 int *pxp, int *pyp, int *pzp) {
   float  xt = 0, yt = 0, zt = 0;
   double xrt, yrt, zrt;
   int    retval = NO_ERROR;
@@ -1139,6 +1143,98 @@ int GCAsourceVoxelToPrior(const GCA *gca, MRI *mri, TRANSFORM *transform,
   return (retval);
 }
 
+int GCAsourceVoxelToPrior(const GCA *gca, MRI *mri, TRANSFORM *transform,
+                          int xv, int yv, int zv, int *pxp, int *pyp,
+                          int *pzp) {
+  const GCA_VOXEL_MAP *map = gca->voxel_map__;
+  int                  index, retval = NO_ERROR;
+
+  if (map == NULL || map->transform != transform || xv < 0 || yv < 0 ||
+      zv < 0 || xv >= map->width || yv >= map->height || zv >= map->depth)
+    return (gcaSourceVoxelToPrior(gca, mri, transform, xv, yv, zv, pxp, pyp,
+                                  pzp));
+
+  index = map->prior_index[((size_t)xv * map->height + yv) * map->depth + zv];
+  if (index < 0) {
+    index  = -index - 1;
+    retval = ERROR_BADPARM;
+  }
+  *pzp = index % gca->prior_depth;
+  index /= gca->prior_depth;
+  *pyp = index % gca->prior_height;
+  *pxp = index / gca->prior_height;
+  return (retval);
+}
+
+/*
+  Labeling applies the same transform to every voxel of the inputs in each
+  of its passes (GCAlabel, GCAlabelProbabilities, the Gibbs passes,
+  renormalization), and for a GCA_MORPH each mapping samples three
+  volumes. GCAsetVoxelMap evaluates the source voxel -> prior mapping of
+  every voxel of mri once and attaches it to the gca, where
+  GCAsourceVoxelToPrior (and so GCAsourceVoxelToNode, getGCAP, getGCAN)
+  looks it up for as long as it is called with the same transform. The
+  node follows from the prior by GCApriorToNode, so only the prior index is
+  stored. The caller must call GCAclearVoxelMap (or GCAsetVoxelMap again)
+  if it changes the transform in place.
+*/
+int GCAsetVoxelMap(GCA *gca, MRI *mri, TRANSFORM *transform) {
+  GCA_VOXEL_MAP *map;
+  int            x;
+
+  GCAclearVoxelMap(gca);
+  map = (GCA_VOXEL_MAP *)calloc(1, sizeof(GCA_VOXEL_MAP));
+  if (map == NULL)
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY, "GCAsetVoxelMap: could not allocate map"));
+  map->transform   = transform;
+  map->width       = mri->width;
+  map->height      = mri->height;
+  map->depth       = mri->depth;
+  map->prior_index = (int *)calloc((size_t)mri->width * mri->height *
+                                       mri->depth,
+                                   sizeof(int));
+  if (map->prior_index == NULL) {
+    free(map);
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY, "GCAsetVoxelMap: could not allocate %dx%dx%d "
+                                 "map",
+                 mri->width, mri->height, mri->depth));
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (x = 0; x < map->width; x++) {
+    ROMP_PFLB_begin
+    int  y, z, xp, yp, zp, index;
+    int *prior_index = map->prior_index + (size_t)x * map->height * map->depth;
+
+    for (y = 0; y < map->height; y++)
+      for (z = 0; z < map->depth; z++) {
+        int err = gcaSourceVoxelToPrior(gca, mri, transform, x, y, z, &xp, &yp,
+                                        &zp);
+        index   = (xp * gca->prior_height + yp) * gca->prior_depth + zp;
+        *prior_index++ = (err == NO_ERROR) ? index : -index - 1;
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  gca->voxel_map__ = map;
+  return (NO_ERROR);
+}
+
+int GCAclearVoxelMap(GCA *gca) {
+  if (gca->voxel_map__) {
+    free(gca->voxel_map__->prior_index);
+    free(gca->voxel_map__);
+    gca->voxel_map__ = NULL;
+  }
+  return (NO_ERROR);
+}
+
 int GCAsourceFloatVoxelToPrior(GCA *gca, MRI *mri, TRANSFORM *transform,
                                float xv, float yv, float zv, int *pxp, int *pyp,
                                int *pzp) {
@@ -2583,6 +2679,7 @@ GCA *GCAread(const char *fname) {
   }
 
   GCAsetup(gca);
+  GCAbuildClassifierCache(gca);
 
   znzclose(file);
 
@@ -3110,11 +3207,14 @@ MRI *GCAlabel(MRI *mri_inputs, GCA *gca, MRI *mri_dst, TRANSFORM *transform) {
   height = mri_inputs->height;
   depth  = mri_inputs->depth;
   num_pv = 0;
-  // if 0
-  // ifdef HAVE_OPENMP
-  // pragma omp parallel for if_ROMP(experimental) reduction(+: num_pv)
-  // endif
+  // each x slab is labeled independently, and the voxel -> prior mapping
+  // comes from the gca's voxel map when the caller has set one
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : num_pv)
+#endif
   for (x = 0; x < width; x++) {
+    ROMP_PFLB_begin
     int y, z, n, label, xn, yn, zn;
     // int max_n;
     float      vals[MAX_GCA_INPUTS], max_p, p;
@@ -3248,7 +3348,9 @@ MRI *GCAlabel(MRI *mri_inputs, GCA *gca, MRI *mri_dst, TRANSFORM *transform) {
         }
       } // z loop
     }   // y loop
-  }     // x loop
+    ROMP_PFLB_end
+  } // x loop
+  ROMP_PF_end
 
   return (mri_dst);
 }
@@ -3272,10 +3374,12 @@ MRI *GCAlabelProbabilities(MRI *mri_inputs, GCA *gca, MRI *mri_dst,
      voxel (and hence the classifier) to which it maps. Then update the
      classifiers statistics based on this voxel's intensity and label.
   */
-  //#ifdef HAVE_OPENMP
-  //#pragma omp parallel for if_ROMP(experimental)
-  //#endif
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (x = 0; x < width; x++) {
+    ROMP_PFLB_begin
     int y, z, xn, yn, zn, n;
     // int label;
     GCA_NODE * gcan;
@@ -3321,7 +3425,9 @@ MRI *GCAlabelProbabilities(MRI *mri_inputs, GCA *gca, MRI *mri_dst,
         }
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   return (mri_dst);
 }
@@ -11916,7 +12022,12 @@ GC1D *GCAfindClosestValidGC(GCA *gca, int x0, int y0, int z0, int label,
   int            x, y, z, n, wsize;
   double         dist, min_dist, det;
   GCA_NODE *     gcan;
-  static MATRIX *m_cov_inv = NULL;
+  static MATRIX *m_cov_inv_t[_MAX_FS_THREADS];
+#ifdef HAVE_OPENMP
+  MATRIX *&m_cov_inv = m_cov_inv_t[omp_get_thread_num()];
+#else
+  MATRIX *&m_cov_inv = m_cov_inv_t[0];
+#endif
 
   min_dist = gca->node_width + gca->node_height + gca->node_depth;
   wsize    = 1;
@@ -12111,9 +12222,13 @@ double GCAcomputeConditionalDensity(GC1D *gc, float *vals, int ninputs,
   /* compute 1-d Mahalanobis distance */
   {
     dist = GCAmahDist(gc, vals, ninputs);
-    p    = (1.0 / (pow(2 * M_PI, ninputs / 2.0) *
-                sqrt(covariance_determinant(gc, ninputs)))) *
-        exp(-0.5 * dist);
+    if (ninputs == 1)
+      p = (1.0 / (pow(2 * M_PI, ninputs / 2.0) *
+                  sqrt(covariance_determinant(gc, ninputs)))) *
+          exp(-0.5 * dist);
+    else
+      p = exp(-0.5 * (ninputs * log(2 * M_PI) +
+                      gcaLogCovarianceDeterminant(gc, ninputs) + dist));
   }
   return (p);
 }
@@ -12165,8 +12280,12 @@ double GCAcomputeConditionalLogDensity(const GC1D *gc, float *vals, int ninputs,
 
   /* compute 1-d Mahalanobis distance */
   {
-    det   = covariance_determinant(gc, ninputs);
-    log_p = -log(sqrt(det)) - .5 * GCAmahDist(gc, vals, ninputs);
+    if (ninputs == 1) {
+      det   = covariance_determinant(gc, ninputs);
+      log_p = -log(sqrt(det)) - .5 * GCAmahDist(gc, vals, ninputs);
+    } else
+      log_p = -.5 * gcaLogCovarianceDeterminant(gc, ninputs) -
+              .5 * GCAmahDist(gc, vals, ninputs);
   }
   return (log_p);
 }
@@ -12507,6 +12626,9 @@ int free_gcs(GC1D *gcs, int nlabels, int ninputs) {
     if (gcs[i].covars) {
       free(gcs[i].covars);
     }
+    if (gcs[i].classifier) {
+      free(gcs[i].classifier);
+    }
     if (gcs[i].nlabels) /* gibbs stuff allocated */
     {
       for (j = 0; j < GIBBS_NEIGHBORHOOD; j++) {
@@ -12712,10 +12834,18 @@ static void load_vals_xyzInt(const MRI *mri_inputs, int x, int y, int z,
 }
 #endif
 
-double GCAmahDist(const GC1D *gc, const float *vals, const int ninputs) {
-  static VECTOR *v_means = NULL, *v_vals = NULL;
-  static MATRIX *m_cov = NULL, *m_cov_inv;
-  int            i;
+static double gcaMahDistNR(const GC1D *gc, const float *vals,
+                           const int ninputs) {
+  static VECTOR *v_means_t[_MAX_FS_THREADS], *v_vals_t[_MAX_FS_THREADS];
+  static MATRIX *m_cov_t[_MAX_FS_THREADS], *m_cov_inv_t[_MAX_FS_THREADS];
+#ifdef HAVE_OPENMP
+  int tid = omp_get_thread_num();
+#else
+  int tid = 0;
+#endif
+  VECTOR *&v_means = v_means_t[tid], *&v_vals = v_vals_t[tid];
+  MATRIX *&m_cov = m_cov_t[tid], *&m_cov_inv = m_cov_inv_t[tid];
+  int      i;
   double         dsq;
 
   if (ninputs == 1) {
@@ -12761,6 +12891,189 @@ double GCAmahDist(const GC1D *gc, const float *vals, const int ninputs) {
 
   return (dsq);
 }
+/*
+  Gaussian classifier cache. For ninputs > 1 the density of a GC used to be
+  evaluated by loading its packed covariance into NR matrices, inverting it
+  and taking its determinant, every time. GCAbuildClassifierCache stores with
+  each GC the inverse of the Cholesky factor of its covariance (the packed
+  lower triangle, row by row) and its log determinant, after a copy of the
+  covariance they were computed from:
+
+    classifier = [ covars (ncovars) | inverse factor (ncovars) | log det ]
+
+  If the covariance has been changed since the cache was built the factor is
+  recomputed on the stack, so a stale entry costs time but is never wrong.
+  Covariances that are not positive definite, and more than
+  GCA_CLASSIFIER_MAX_INPUTS inputs, use the NR matrix code as before.
+  Setting FREESURFER_OLD_GCAmahDist forces the NR code everywhere.
+*/
+#define GCA_CLASSIFIER_MAX_INPUTS 8
+#define GCA_NCOVARS(ninputs) (((ninputs) * ((ninputs) + 1)) / 2)
+
+static int gcaUseOldClassifier(void) {
+  static int use_old = -1;
+
+  if (use_old < 0)
+    use_old = (getenv("FREESURFER_OLD_GCAmahDist") != NULL);
+  return (use_old);
+}
+
+/* inverse Cholesky factor and log determinant of a packed covariance.
+   Returns 0 if the covariance is not positive definite. */
+static int gcaCholeskyInverse(const float *covars, int ninputs, float *linv,
+                              double *plog_det) {
+  double L[GCA_CLASSIFIER_MAX_INPUTS][GCA_CLASSIFIER_MAX_INPUTS],
+      Li[GCA_CLASSIFIER_MAX_INPUTS][GCA_CLASSIFIER_MAX_INPUTS], sum,
+      log_det = 0;
+  int i, j, k;
+
+  for (i = 0; i < ninputs; i++)
+    for (j = 0; j <= i; j++) {
+      // covars packs the upper triangle row by row, C(j, i) with j <= i
+      sum = covars[j * ninputs - (j * (j - 1)) / 2 + (i - j)];
+      for (k = 0; k < j; k++)
+        sum -= L[i][k] * L[j][k];
+      if (i == j) {
+        if (!(sum > 0) || !std::isfinite(sum))
+          return (0);
+        L[i][i] = sqrt(sum);
+        log_det += 2 * log(L[i][i]);
+      } else
+        L[i][j] = sum / L[j][j];
+    }
+  for (i = 0; i < ninputs; i++) {
+    Li[i][i] = 1.0 / L[i][i];
+    for (j = 0; j < i; j++) {
+      for (sum = 0, k = j; k < i; k++)
+        sum += L[i][k] * Li[k][j];
+      Li[i][j] = -sum / L[i][i];
+    }
+  }
+  for (k = i = 0; i < ninputs; i++)
+    for (j = 0; j <= i; j++, k++)
+      linv[k] = Li[i][j];
+  *plog_det = log_det;
+  return (1);
+}
+
+/* |Linv (vals - means)|^2, unrolled for the common channel counts */
+template <int N>
+static inline double gcaCholeskyMahDistN(const float *linv, const float *means,
+                                         const float *vals) {
+  double d[N], y, dsq = 0;
+  int    i, j, k;
+
+  for (i = 0; i < N; i++)
+    d[i] = vals[i] - means[i];
+  for (k = i = 0; i < N; i++) {
+    for (y = 0, j = 0; j <= i; j++, k++)
+      y += linv[k] * d[j];
+    dsq += y * y;
+  }
+  return (dsq);
+}
+
+static double gcaCholeskyMahDist(const float *linv, const float *means,
+                                 const float *vals, int ninputs) {
+  switch (ninputs) {
+  case 2:
+    return (gcaCholeskyMahDistN<2>(linv, means, vals));
+  case 3:
+    return (gcaCholeskyMahDistN<3>(linv, means, vals));
+  case 4:
+    return (gcaCholeskyMahDistN<4>(linv, means, vals));
+  default:
+    break;
+  }
+  double y, dsq = 0;
+  int    i, j, k;
+  for (k = i = 0; i < ninputs; i++) {
+    for (y = 0, j = 0; j <= i; j++, k++)
+      y += linv[k] * (vals[j] - means[j]);
+    dsq += y * y;
+  }
+  return (dsq);
+}
+
+/* the inverse Cholesky factor of the covariance of gc (from its cache if that
+   is current, otherwise computed into linv) and its log determinant, or NULL
+   if the NR matrix code has to be used */
+static const float *gcaClassifier(const GC1D *gc, int ninputs, float *linv,
+                                  double *plog_det) {
+  int ncovars = GCA_NCOVARS(ninputs);
+
+  if (ninputs > GCA_CLASSIFIER_MAX_INPUTS || gcaUseOldClassifier())
+    return (NULL);
+  if (gc->classifier &&
+      !memcmp(gc->classifier, gc->covars, ncovars * sizeof(float))) {
+    *plog_det = gc->classifier[2 * ncovars];
+    return (gc->classifier + ncovars);
+  }
+  if (!gcaCholeskyInverse(gc->covars, ninputs, linv, plog_det))
+    return (NULL);
+  return (linv);
+}
+
+int GCAbuildClassifierCache(GCA *gca) {
+  int x, ncovars = GCA_NCOVARS(gca->ninputs);
+
+  if (gca->ninputs <= 1 || gca->ninputs > GCA_CLASSIFIER_MAX_INPUTS ||
+      gcaUseOldClassifier())
+    return (NO_ERROR);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (x = 0; x < gca->node_width; x++) {
+    ROMP_PFLB_begin
+    int       y, z, n;
+    GCA_NODE *gcan;
+    GC1D *    gc;
+    double    log_det;
+
+    for (y = 0; y < gca->node_height; y++)
+      for (z = 0; z < gca->node_depth; z++) {
+        gcan = &gca->nodes[x][y][z];
+        for (n = 0; n < gcan->nlabels; n++) {
+          gc = &gcan->gcs[n];
+          if (gc->classifier == NULL)
+            gc->classifier = (float *)calloc(2 * ncovars + 1, sizeof(float));
+          if (gc->classifier == NULL)
+            ErrorExit(ERROR_NOMEMORY,
+                      "GCAbuildClassifierCache: could not allocate cache");
+          if (gcaCholeskyInverse(gc->covars, gca->ninputs,
+                                 gc->classifier + ncovars, &log_det)) {
+            memcpy(gc->classifier, gc->covars, ncovars * sizeof(float));
+            gc->classifier[2 * ncovars] = log_det;
+          } else {
+            free(gc->classifier);
+            gc->classifier = NULL;
+          }
+        }
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+  return (NO_ERROR);
+}
+
+double GCAmahDist(const GC1D *gc, const float *vals, const int ninputs) {
+  float        linv[GCA_NCOVARS(GCA_CLASSIFIER_MAX_INPUTS)];
+  const float *classifier;
+  double       log_det;
+
+  if (ninputs == 1) {
+    float v;
+    v = vals[0] - gc->means[0];
+    return (v * v / gc->covars[0]);
+  }
+  classifier = gcaClassifier(gc, ninputs, linv, &log_det);
+  if (classifier)
+    return (gcaCholeskyMahDist(classifier, gc->means, vals, ninputs));
+  return (gcaMahDistNR(gc, vals, ninputs));
+}
+
 double GCAmahDistIdentityCovariance(GC1D *gc, float *vals, int ninputs) {
   static VECTOR *v_means = NULL, *v_vals = NULL;
   int            i;
@@ -12894,14 +13207,29 @@ MATRIX *load_inverse_covariance_matrix(GC1D *gc, MATRIX *m_inv_cov,
   return (m_inv_cov);
 }
 
+/* log of the covariance determinant of gc */
+static double gcaLogCovarianceDeterminant(const GC1D *gc, int ninputs) {
+  float  linv[GCA_NCOVARS(GCA_CLASSIFIER_MAX_INPUTS)];
+  double log_det;
+
+  if (ninputs == 1)
+    return (log(gc->covars[0]));
+  if (gcaClassifier(gc, ninputs, linv, &log_det))
+    return (log_det);
+  return (log(covariance_determinant(gc, ninputs)));
+}
+
 double covariance_determinant(const GC1D *gc, const int ninputs) {
   double         det;
   int            tid;
   static MATRIX *m_cov[_MAX_FS_THREADS];
+  float          linv[GCA_NCOVARS(GCA_CLASSIFIER_MAX_INPUTS)];
 
   if (ninputs == 1) {
     return (gc->covars[0]);
   }
+  if (gcaClassifier(gc, ninputs, linv, &det))
+    return (exp(det));
 #ifdef HAVE_OPENMP
   tid = omp_get_thread_num();
 #else
@@ -12940,7 +13268,14 @@ static double gcaComputeSampleConditionalLogDensity(GCA_SAMPLE *gcas,
                                                     float *vals, int ninputs,
                                                     int label) {
   double log_p, det;
-
+  float  linv[GCA_NCOVARS(GCA_CLASSIFIER_MAX_INPUTS)];
+
+  // samples aren't cached, but one factorization gives both terms
+  if (ninputs > 1 && ninputs <= GCA_CLASSIFIER_MAX_INPUTS &&
+      !gcaUseOldClassifier() &&
+      gcaCholeskyInverse(gcas->covars, ninputs, linv, &det))
+    return (-.5 * det -
+            .5 * gcaCholeskyMahDist(linv, gcas->means, vals, ninputs));
   {
     det   = sample_covariance_determinant(gcas, ninputs);
     log_p = -log(sqrt(det)) - .5 * GCAsampleMahDist(gcas, vals, ninputs);
@@ -13016,6 +13351,7 @@ double GCAsampleMahDist(GCA_SAMPLE *gcas, float *vals, int ninputs) {
   static MATRIX *m_cov = NULL, *m_cov_inv;
   int            i;
   double         dsq;
+  float          linv[GCA_NCOVARS(GCA_CLASSIFIER_MAX_INPUTS)];
 
   if (ninputs == 1) {
     float v;
@@ -13023,6 +13359,9 @@ double GCAsampleMahDist(GCA_SAMPLE *gcas, float *vals, int ninputs) {
     dsq = v * v / gcas->covars[0];
     return (dsq);
   }
+  if (ninputs <= GCA_CLASSIFIER_MAX_INPUTS && !gcaUseOldClassifier() &&
+      gcaCholeskyInverse(gcas->covars, ninputs, linv, &dsq))
+    return (gcaCholeskyMahDist(linv, gcas->means, vals, ninputs));
 
   if (v_vals && ninputs != v_vals->rows) {
     VectorFree(&v_vals);
@@ -13833,6 +14172,7 @@ int GCAregularizeCovarianceMatrices(GCA *gca, double lambda) {
     }
   }
 
+  GCAbuildClassifierCache(gca);
   return (NO_ERROR);
 }
 int GCAsetFlashParameters(GCA *gca, double *TRs, double *FAs, double *TEs) {
@@ -14221,6 +14561,7 @@ int GCAregularizeCovariance(GCA *gca, float regularize) {
       }
     }
   }
+  GCAbuildClassifierCache(gca);
   return (NO_ERROR);
 }
 
@@ -23130,6 +23471,7 @@ int GC1Dfree(GC1D **pgc, int ninputs) {
   int   r;
   free(gc->means);
   free(gc->covars);
+  free(gc->classifier);
   free(gc->nlabels);
   for (r = 0; r < GIBBS_NEIGHBORS; r++) {
     free(gc->labels[r]);
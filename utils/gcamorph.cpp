@@ -1296,8 +1296,9 @@ GCA_MORPH *GCAMread(const char *fname) {
 }
 
 GCA_MORPH *GCAMalloc(const int width, const int height, const int depth) {
-  GCA_MORPH *gcam;
-  int        x, y, z;
+  GCA_MORPH *     gcam;
+  GCA_MORPH_NODE *buf;
+  int             x, y, z;
 
   gcam = (GCA_MORPH *)calloc(1, sizeof(GCA_MORPH));
   if (!gcam)
@@ -1314,6 +1315,14 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth) {
     ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate nodes");
   }
 
+  // the nodes are one contiguous block in x/y/z order so that the [x][y][z]
+  // lattice and a flat GCAM_SOA_INDEX() walk see the same stride-1 layout
+  buf = (GCA_MORPH_NODE *)calloc((size_t)width * height * depth,
+                                 sizeof(GCA_MORPH_NODE));
+  if (!buf)
+    ErrorExit(ERROR_NOMEMORY, "GCAMalloc(%d, %d, %d): could not allocate nodes",
+              width, height, depth);
+
   for (x = 0; x < gcam->width; x++) {
     gcam->nodes[x] =
         (GCA_MORPH_NODE **)calloc(gcam->height, sizeof(GCA_MORPH_NODE *));
@@ -1321,30 +1330,8 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth) {
       ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate %dth **", x);
     }
 
-#define ELECTRIC_FENCE 0
-#if ELECTRIC_FENCE
-    {
-      GCA_MORPH_NODE *buf;
-
-      buf = (GCA_MORPH_NODE *)calloc(gcam->depth * gcam->height,
-                                     sizeof(GCA_MORPH_NODE));
-      if (buf == NULL)
-        ErrorExit(ERROR_NO_MEMORY,
-                  "GCAMalloc(%d, %d, %d): could not allocate "
-                  "%d bytes for %dth bslice\n",
-                  height, width, depth,
-                  (gcam->depth * gcam->height * sizeof(GCA_MORPH_NODE)), x);
-      for (y = 0; y < gcam->height; y++) {
-        gcam->nodes[x][y] = buf + (y * gcam->depth);
-      }
-    }
-#else
     for (y = 0; y < gcam->height; y++) {
-      gcam->nodes[x][y] =
-          (GCA_MORPH_NODE *)calloc(gcam->depth, sizeof(GCA_MORPH_NODE));
-      if (!gcam->nodes[x][y])
-        ErrorExit(ERROR_NOMEMORY, "GCAMalloc: could not allocate %d,%dth *", x,
-                  y);
+      gcam->nodes[x][y] = buf + ((size_t)x * height + y) * depth;
       for (z = 0; z < gcam->depth; z++) {
         gcam->nodes[x][y][z].origx = x;
         gcam->nodes[x][y][z].origy = y;
@@ -1354,7 +1341,6 @@ GCA_MORPH *GCAMalloc(const int width, const int height, const int depth) {
         gcam->nodes[x][y][z].z     = z;
       }
     }
-#endif
   }
   initVolGeom(&gcam->image);
   initVolGeom(&gcam->atlas);
@@ -1689,14 +1675,176 @@ int GCAMfreeContents(GCA_MORPH *gcam) {
           free_gcs(gcamn->gc, 1, gcam->ninputs);
         }
       }
-      free(gcam->nodes[x][y]);
     }
+  }
+  // all the nodes live in the block GCAMalloc hung off nodes[0][0]
+  if (gcam->width > 0 && gcam->height > 0) {
+    free(gcam->nodes[0][0]);
+  }
+  for (x = 0; x < gcam->width; x++) {
     free(gcam->nodes[x]);
   }
   free(gcam->nodes);
+  GCAMsoaFree(&gcam->soa);
+  return (NO_ERROR);
+}
+
+/*!
+  \fn GCA_MORPH_SOA *GCAMsoaAlloc(int width, int height, int depth)
+  \brief Allocates a structure-of-arrays copy of the hot node fields for a
+  width x height x depth lattice. Each field is one 64-byte aligned array.
+*/
+GCA_MORPH_SOA *GCAMsoaAlloc(int width, int height, int depth) {
+  GCA_MORPH_SOA *soa;
+  size_t         n;
+
+  soa = (GCA_MORPH_SOA *)calloc(1, sizeof(GCA_MORPH_SOA));
+  if (!soa) {
+    ErrorExit(ERROR_NOMEMORY, "GCAMsoaAlloc: could not allocate struct");
+  }
+  soa->width  = width;
+  soa->height = height;
+  soa->depth  = depth;
+  soa->nnodes = n = (size_t)width * height * depth;
+
+#define GCAM_SOA_ALLOC(field)                                                  \
+  if (posix_memalign((void **)&soa->field, 64,                                 \
+                     MAX(n, 1) * sizeof(*soa->field)))                         \
+    ErrorExit(ERROR_NOMEMORY, "GCAMsoaAlloc(%d, %d, %d): could not allocate "  \
+              #field, width, height, depth);
+  GCAM_SOA_ALLOC(x)
+  GCAM_SOA_ALLOC(y)
+  GCAM_SOA_ALLOC(z)
+  GCAM_SOA_ALLOC(origx)
+  GCAM_SOA_ALLOC(origy)
+  GCAM_SOA_ALLOC(origz)
+  GCAM_SOA_ALLOC(dx)
+  GCAM_SOA_ALLOC(dy)
+  GCAM_SOA_ALLOC(dz)
+  GCAM_SOA_ALLOC(odx)
+  GCAM_SOA_ALLOC(ody)
+  GCAM_SOA_ALLOC(odz)
+  GCAM_SOA_ALLOC(area)
+  GCAM_SOA_ALLOC(area1)
+  GCAM_SOA_ALLOC(area2)
+  GCAM_SOA_ALLOC(orig_area)
+  GCAM_SOA_ALLOC(orig_area1)
+  GCAM_SOA_ALLOC(orig_area2)
+  GCAM_SOA_ALLOC(invalid)
+#undef GCAM_SOA_ALLOC
+  return (soa);
+}
+
+int GCAMsoaFree(GCA_MORPH_SOA **psoa) {
+  GCA_MORPH_SOA *soa;
+
+  soa   = *psoa;
+  *psoa = NULL;
+  if (!soa) {
+    return (NO_ERROR);
+  }
+  free(soa->x);
+  free(soa->y);
+  free(soa->z);
+  free(soa->origx);
+  free(soa->origy);
+  free(soa->origz);
+  free(soa->dx);
+  free(soa->dy);
+  free(soa->dz);
+  free(soa->odx);
+  free(soa->ody);
+  free(soa->odz);
+  free(soa->area);
+  free(soa->area1);
+  free(soa->area2);
+  free(soa->orig_area);
+  free(soa->orig_area1);
+  free(soa->orig_area2);
+  free(soa->invalid);
+  free(soa);
+  return (NO_ERROR);
+}
+
+/*!
+  \fn int GCAMsoaLoad(const GCA_MORPH *gcam, GCA_MORPH_SOA *soa)
+  \brief Gathers the current positions, original positions, gradients,
+  areas, original areas and validity of every node into soa, which must
+  have been allocated for the same lattice size.
+*/
+int GCAMsoaLoad(const GCA_MORPH *gcam, GCA_MORPH_SOA *soa) {
+  int x;
+
+  if (soa->width != gcam->width || soa->height != gcam->height ||
+      soa->depth != gcam->depth)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM,
+                 "GCAMsoaLoad: soa %dx%dx%d does not match gcam %dx%dx%d",
+                 soa->width, soa->height, soa->depth, gcam->width,
+                 gcam->height, gcam->depth));
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(static, 1)
+#endif
+  for (x = 0; x < gcam->width; x++) {
+    ROMP_PFLB_begin
+
+    int y, z;
+    for (y = 0; y < gcam->height; y++) {
+      const GCA_MORPH_NODE *row = gcam->nodes[x][y];
+      size_t                i   = GCAM_SOA_INDEX(soa, x, y, 0);
+      for (z = 0; z < gcam->depth; z++, i++) {
+        soa->x[i]       = row[z].x;
+        soa->y[i]       = row[z].y;
+        soa->z[i]       = row[z].z;
+        soa->origx[i]   = row[z].origx;
+        soa->origy[i]   = row[z].origy;
+        soa->origz[i]   = row[z].origz;
+        soa->dx[i]      = row[z].dx;
+        soa->dy[i]      = row[z].dy;
+        soa->dz[i]      = row[z].dz;
+        soa->odx[i]     = row[z].odx;
+        soa->ody[i]     = row[z].ody;
+        soa->odz[i]     = row[z].odz;
+        soa->area[i]    = row[z].area;
+        soa->area1[i]   = row[z].area1;
+        soa->area2[i]   = row[z].area2;
+        soa->invalid[i] = row[z].invalid;
+
+        soa->orig_area[i]  = row[z].orig_area;
+        soa->orig_area1[i] = row[z].orig_area1;
+        soa->orig_area2[i] = row[z].orig_area2;
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
   return (NO_ERROR);
 }
 
+/*!
+  \fn GCA_MORPH_SOA *GCAMgetSoa(GCA_MORPH *gcam)
+  \brief Returns gcam->soa loaded with the current node values, allocating
+  it (once per lattice size) if needed. The copy is not kept in sync with
+  the nodes: callers load it once where the nodes are known to be still
+  (before the smoothness and jacobian terms of a gradient, at the start of
+  a line search) and reuse it until they move.
+*/
+GCA_MORPH_SOA *GCAMgetSoa(GCA_MORPH *gcam) {
+  if (gcam->soa &&
+      (gcam->soa->width != gcam->width || gcam->soa->height != gcam->height ||
+       gcam->soa->depth != gcam->depth)) {
+    GCAMsoaFree(&gcam->soa);
+  }
+  if (!gcam->soa) {
+    gcam->soa = GCAMsoaAlloc(gcam->width, gcam->height, gcam->depth);
+  }
+  GCAMsoaLoad(gcam, gcam->soa);
+  return (gcam->soa);
+}
+
 // different_neighbor_labels is very hot.
 //
 // It is always called with whalf of 1
@@ -2545,15 +2693,163 @@ double gcamDistanceEnergy(GCA_MORPH *gcam, MRI *mri) {
 const float jac_scale = 10;
 int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
                              double ratio_thresh) {
-  int             i = 0, j = 0, k = 0, num /*, xi, yi, zi, xk, yk, zk = 0*/;
-  int             n_omp_threads = 1;
-  double          dx = 0.0, dy = 0.0, dz = 0.0, norm = 0.0;
-  double          orig_area = 0.0, ratio = 0.0, max_norm;
-  double          mn[_MAX_FS_THREADS]; /* _MAX_FS_THREADS is in utils.h */
-  GCA_MORPH_NODE *gcamn = NULL;
-  extern int      gcamJacobianTerm_nCalls;
-  extern double   gcamJacobianTerm_tsec;
-  Timer           timer;
+  if (DZERO(l_jacobian)) {
+    return (NO_ERROR);
+  }
+  return (gcamJacobianTermSoa(gcam, GCAMgetSoa(gcam), l_jacobian,
+                              ratio_thresh));
+}
+
+/*
+  gcamJacobianTermAtNode() reading the positions and areas from soa. The
+  vectors and cross products are float, as in the VECTORs it uses, so the
+  two agree exactly.
+*/
+static void gcamJacobianTermAtSoaNode(const GCA_MORPH *gcam,
+                                      const GCA_MORPH_SOA *soa,
+                                      double l_jacobian, int i, int j, int k,
+                                      double *pdx, double *pdy, double *pdz) {
+  // the node each parallelepiped is anchored at and its i, j, k neighbors,
+  // as offsets from (i,j,k); the last four are left-handed
+  static const int corners[AREA_NEIGHBORS][4][3] = {
+      {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+      {{-1, 0, 0}, {0, 0, 0}, {-1, 1, 0}, {-1, 0, 1}},
+      {{0, -1, 0}, {1, -1, 0}, {0, 0, 0}, {0, -1, 1}},
+      {{0, 0, -1}, {1, 0, -1}, {0, 1, -1}, {0, 0, 0}},
+      {{0, 0, 0}, {-1, 0, 0}, {0, -1, 0}, {0, 0, -1}},
+      {{1, 0, 0}, {0, 0, 0}, {1, -1, 0}, {1, 0, -1}},
+      {{0, 1, 0}, {-1, 1, 0}, {0, 0, 0}, {0, 1, -1}},
+      {{0, 0, 1}, {-1, 0, 1}, {0, -1, 1}, {0, 0, 0}}};
+  float  grad[3] = {0, 0, 0}, vi[3], vj[3], vk[3], tmp[3], delta, ratio;
+  double exponent, orig_area, area;
+  int    n, c, invert;
+
+  for (n = 0; n < AREA_NEIGHBORS; n++) {
+    size_t idx[4];
+
+    for (c = 0; c < 4; c++) {
+      int xn = i + corners[n][c][0], yn = j + corners[n][c][1],
+          zn = k + corners[n][c][2];
+      if (xn < 0 || xn >= gcam->width || yn < 0 || yn >= gcam->height ||
+          zn < 0 || zn >= gcam->depth) {
+        break;
+      }
+      idx[c] = GCAM_SOA_INDEX(soa, xn, yn, zn);
+    }
+    if (c < 4) {
+      continue;
+    }
+
+    invert = n < 4 ? 1 : -1;
+    if (invert > 0) {
+      orig_area = soa->orig_area1[idx[0]];
+      area      = soa->area1[idx[0]];
+    } else {
+      orig_area = soa->orig_area2[idx[0]];
+      area      = soa->area2[idx[0]];
+    }
+    if (FZERO(orig_area)) {
+      continue;
+    }
+    if (soa->invalid[idx[0]] == GCAM_POSITION_INVALID ||
+        soa->invalid[idx[1]] == GCAM_POSITION_INVALID ||
+        soa->invalid[idx[2]] == GCAM_POSITION_INVALID ||
+        soa->invalid[idx[3]] == GCAM_POSITION_INVALID) {
+      continue;
+    }
+
+    vi[0] = soa->x[idx[1]] - soa->x[idx[0]];
+    vi[1] = soa->y[idx[1]] - soa->y[idx[0]];
+    vi[2] = soa->z[idx[1]] - soa->z[idx[0]];
+    vj[0] = soa->x[idx[2]] - soa->x[idx[0]];
+    vj[1] = soa->y[idx[2]] - soa->y[idx[0]];
+    vj[2] = soa->z[idx[2]] - soa->z[idx[0]];
+    vk[0] = soa->x[idx[3]] - soa->x[idx[0]];
+    vk[1] = soa->y[idx[3]] - soa->y[idx[0]];
+    vk[2] = soa->z[idx[3]] - soa->z[idx[0]];
+
+    ratio    = area / orig_area;
+    exponent = gcam->exp_k * ratio;
+    if (exponent > MAX_EXP) {
+      exponent = MAX_EXP;
+    }
+
+    /* don't use -k, since we are moving in the negative gradient direction */
+    delta = (invert * gcam->exp_k / orig_area) * (1.0 / (1.0 + exp(exponent)));
+
+    switch (n) {
+    default:
+    case 4:
+    case 0: { /* central node: -(v_i x v_j + v_j x v_k + v_k x v_i) */
+      float jxk[3], kxi[3], ixj[3];
+
+      jxk[0] = vj[1] * vk[2] - vj[2] * vk[1];
+      jxk[1] = vj[2] * vk[0] - vj[0] * vk[2];
+      jxk[2] = vj[0] * vk[1] - vj[1] * vk[0];
+      kxi[0] = vk[1] * vi[2] - vk[2] * vi[1];
+      kxi[1] = vk[2] * vi[0] - vk[0] * vi[2];
+      kxi[2] = vk[0] * vi[1] - vk[1] * vi[0];
+      ixj[0] = vi[1] * vj[2] - vi[2] * vj[1];
+      ixj[1] = vi[2] * vj[0] - vi[0] * vj[2];
+      ixj[2] = vi[0] * vj[1] - vi[1] * vj[0];
+      for (c = 0; c < 3; c++) {
+        tmp[c] = ixj[c] + jxk[c];
+        tmp[c] = kxi[c] + tmp[c];
+        tmp[c] = tmp[c] * -delta;
+      }
+      break;
+    }
+    case 5: /*  i+1 */
+    case 1: /*  i-1 */
+      tmp[0] = (vj[1] * vk[2] - vj[2] * vk[1]) * delta;
+      tmp[1] = (vj[2] * vk[0] - vj[0] * vk[2]) * delta;
+      tmp[2] = (vj[0] * vk[1] - vj[1] * vk[0]) * delta;
+      break;
+    case 6: /* j+1 */
+    case 2: /* j-1 */
+      tmp[0] = (vk[1] * vi[2] - vk[2] * vi[1]) * delta;
+      tmp[1] = (vk[2] * vi[0] - vk[0] * vi[2]) * delta;
+      tmp[2] = (vk[0] * vi[1] - vk[1] * vi[0]) * delta;
+      break;
+    case 7: /* k+1 */
+    case 3: /* k-1 */
+      tmp[0] = (vi[1] * vj[2] - vi[2] * vj[1]) * delta;
+      tmp[1] = (vi[2] * vj[0] - vi[0] * vj[2]) * delta;
+      tmp[2] = (vi[0] * vj[1] - vi[1] * vj[0]) * delta;
+      break;
+    }
+    for (c = 0; c < 3; c++) {
+      grad[c] = tmp[c] + grad[c];
+    }
+  }
+
+  *pdx = l_jacobian * grad[0];
+  *pdy = l_jacobian * grad[1];
+  *pdz = l_jacobian * grad[2];
+  if (i == Gx && j == Gy && k == Gz) {
+    size_t const n0 = GCAM_SOA_INDEX(soa, i, j, k);
+    printf("l_jaco: node(%d,%d,%d): area=%2.4f, orig_area=%2.4f, "
+           "grad=(%2.3f,%2.3f,%2.3f)\n",
+           i, j, k, soa->area[n0], soa->orig_area[n0], *pdx, *pdy, *pdz);
+  }
+}
+
+/*!
+  \fn int gcamJacobianTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+        double l_jacobian, double ratio_thresh)
+  \brief gcamJacobianTerm() reading the positions, areas and validity from
+  soa, which must hold the current positions and metric properties. The
+  gradient accumulated so far (used to limit the jacobian step) is read
+  from and added to the nodes.
+*/
+int gcamJacobianTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+                        double l_jacobian, double ratio_thresh) {
+  int           i, num, n_omp_threads;
+  double        max_norm;
+  double        mn[_MAX_FS_THREADS]; /* _MAX_FS_THREADS is in utils.h */
+  extern int    gcamJacobianTerm_nCalls;
+  extern double gcamJacobianTerm_tsec;
+  Timer         timer;
 
   if (DZERO(l_jacobian)) {
     return (NO_ERROR);
@@ -2562,28 +2858,21 @@ int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
   num = 0;
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-#pragma omp parallel for if_ROMP(assume_reproducible) reduction (+:num) firstprivate (j,k,gcamn,ratio,orig_area,ratio_thresh) shared(gcam) schedule(static,1)
+#pragma omp parallel for if_ROMP(assume_reproducible) reduction(+ : num)       \
+    schedule(static, 1)
 #endif
-      for (i = 0; i < gcam->width; i++) {
+  for (i = 0; i < gcam->width; i++) {
     ROMP_PFLB_begin
 
-        for (j = 0; j < gcam->height; j++) {
-      for (k = 0; k < gcam->depth; k++) {
-        gcamn = &gcam->nodes[i][j][k];
-
-        if (gcamn->invalid == GCAM_POSITION_INVALID) {
-          continue;
-        }
-
-        orig_area = gcamn->orig_area;
-        if (FZERO(orig_area)) {
-          continue;
-        }
-
-        ratio = gcamn->area / orig_area;
-        if (ratio < ratio_thresh) {
-          num++;
-        }
+    size_t n   = GCAM_SOA_INDEX(soa, i, 0, 0);
+    size_t end = GCAM_SOA_INDEX(soa, i + 1, 0, 0);
+    for (; n < end; n++) {
+      if (soa->invalid[n] == GCAM_POSITION_INVALID ||
+          FZERO(soa->orig_area[n])) {
+        continue;
+      }
+      if (soa->area[n] / soa->orig_area[n] < ratio_thresh) {
+        num++;
       }
     }
 
@@ -2591,19 +2880,15 @@ int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
   }
   ROMP_PF_end
 
-      if (DIAG_VERBOSE_ON) {
+  if (DIAG_VERBOSE_ON) {
     printf("  %d nodes compressed more than %2.2f\n", num, ratio_thresh);
   }
 
-  max_norm = 0.0;
-
 #ifdef HAVE_OPENMP
   n_omp_threads = omp_get_max_threads();
 #else
   n_omp_threads = 1;
 #endif
-
-  int tid = 0;
   for (i = 0; i < _MAX_FS_THREADS; i++) {
     mn[i] = 0.0;
   }
@@ -2617,27 +2902,20 @@ int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
     }
   }
 
+  // the largest gradient so far, which is not in soa
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-#pragma omp parallel for if_ROMP(assume_reproducible)                          \
-    firstprivate(j, k, gcamn, dx, dy, dz, norm, tid, mn) shared(gcam)          \
-        schedule(static, 1)
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(static, 1)
 #endif
-      for (i = 0; i < gcam->width; i++) {
+  for (i = 0; i < gcam->width; i++) {
     ROMP_PFLB_begin
 
-        for (j = 0; j < gcam->height; j++) {
-      for (k = 0; k < gcam->depth; k++) {
-        gcamn = &gcam->nodes[i][j][k];
-        dx    = gcamn->dx;
-        dy    = gcamn->dy;
-        dz    = gcamn->dz;
-        norm  = sqrt(dx * dx + dy * dy + dz * dz);
-#ifdef HAVE_OPENMP
-        tid = omp_get_thread_num();
-#else
-        tid = 0;
-#endif
+    int tid = omp_get_thread_num();
+    for (int j = 0; j < gcam->height; j++) {
+      for (int k = 0; k < gcam->depth; k++) {
+        const GCA_MORPH_NODE *gcamn = &gcam->nodes[i][j][k];
+        double                dx = gcamn->dx, dy = gcamn->dy, dz = gcamn->dz;
+        double                norm = sqrt(dx * dx + dy * dy + dz * dz);
         if (norm > mn[tid]) {
           mn[tid] = norm;
         }
@@ -2648,32 +2926,33 @@ int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
   }
   ROMP_PF_end
 
-      for (i = 0; i < n_omp_threads; i++) if (mn[i] > max_norm) {
-    max_norm = mn[i];
+  max_norm = 0.0;
+  for (i = 0; i < n_omp_threads; i++) {
+    if (mn[i] > max_norm) {
+      max_norm = mn[i];
+    }
   }
 
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-#pragma omp parallel for if_ROMP(assume_reproducible)                          \
-    firstprivate(j, k, gcamn, dx, dy, dz, norm)                                \
-        shared(gcam, mri, l_jacobian, Gx, Gy, Gz, max_norm)                    \
-            schedule(static, 1)
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(static, 1)
 #endif
-      for (i = 0; i < gcam->width; i++) {
+  for (i = 0; i < gcam->width; i++) {
     ROMP_PFLB_begin
 
-        for (j = 0; j < gcam->height; j++) {
-      for (k = 0; k < gcam->depth; k++) {
-        gcamn = &gcam->nodes[i][j][k];
+    double dx, dy, dz, norm;
+    for (int j = 0; j < gcam->height; j++) {
+      for (int k = 0; k < gcam->depth; k++) {
         if (i == Gx && j == Gy && k == Gz) {
           DiagBreak();
         }
-
-        if (gcamn->invalid == GCAM_POSITION_INVALID) {
+        if (soa->invalid[GCAM_SOA_INDEX(soa, i, j, k)] ==
+            GCAM_POSITION_INVALID) {
           continue;
         }
 
-        gcamJacobianTermAtNode(gcam, mri, l_jacobian, i, j, k, &dx, &dy, &dz);
+        gcamJacobianTermAtSoaNode(gcam, soa, l_jacobian, i, j, k, &dx, &dy,
+                                  &dz);
         norm = sqrt(dx * dx + dy * dy + dz * dz);
         if (norm > max_norm * jac_scale && max_norm > 0 && norm > 1)
         /* don't let it get too big, otherwise it's the
@@ -2688,16 +2967,28 @@ int         gcamJacobianTerm(GCA_MORPH *gcam, const MRI *mri, double l_jacobian,
         gcam->nodes[i][j][k].dz += dz;
       }
     }
+
     ROMP_PFLB_end
   }
   ROMP_PF_end
 
-      gcamJacobianTerm_nCalls++;
+  gcamJacobianTerm_nCalls++;
   gcamJacobianTerm_tsec += (timer.milliseconds() / 1000.0);
 
   return (NO_ERROR);
 }
 
+// gcam->soa loaded once for both the smoothness and jacobian terms of a
+// gradient, or NULL when neither is on (the nodes only move between them
+// through their gradients)
+static const GCA_MORPH_SOA *gcamTermSoa(GCA_MORPH *gcam,
+                                        const GCA_MORPH_PARMS *parms) {
+  if (DZERO(parms->l_smoothness) && DZERO(parms->l_jacobian)) {
+    return (NULL);
+  }
+  return (GCAMgetSoa(gcam));
+}
+
 int gcamAreaTerm(GCA_MORPH *gcam, double l_area) {
   int             i, j, k;
   double          dx, dy, dz;
@@ -5716,12 +6007,13 @@ int gcamComputeGradient(GCA_MORPH *gcam, MRI *mri, MRI *mri_smooth,
   gcamElasticTerm(gcam, parms);
   gcamAreaSmoothnessTerm(gcam, mri_smooth, parms->l_area_smoothness);
   gcamAreaTerm(gcam, parms->l_area);
-  gcamSmoothnessTerm(gcam, mri, parms->l_smoothness);
+  const GCA_MORPH_SOA *soa = gcamTermSoa(gcam, parms);
+  gcamSmoothnessTermSoa(gcam, soa, parms->l_smoothness);
   gcamLSmoothnessTerm(gcam, mri, parms->l_lsmoothness);
   gcamSpringTerm(gcam, parms->l_spring, parms->ratio_thresh);
   //  gcamInvalidSpringTerm(gcam, 1.0)  ;
   //
-  gcamJacobianTerm(gcam, mri, parms->l_jacobian, parms->ratio_thresh);
+  gcamJacobianTermSoa(gcam, soa, parms->l_jacobian, parms->ratio_thresh);
   // The following appears to be a null operation, based on current #ifdefs
   gcamLimitGradientMagnitude(gcam, parms, mri);
 
@@ -5936,18 +6228,32 @@ int gcamLimitGradientMagnitude(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
 /*!
   \fn int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri, const double l_smoothness)
   \brief Compute derivative of mesh smoothness cost. Derivatives are approximate.
-  Consumes a lot of time in mri_ca_register. Can be sped up by about a factor of 6.
+  Consumes a lot of time in mri_ca_register. Loads gcam->soa and runs
+  gcamSmoothnessTermSoa(); callers that also compute the jacobian term
+  should load it once and call the Soa kernels directly.
  */
 int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri,
                        const double l_smoothness) {
-  double vx = 0.0, vy = 0.0, vz = 0.0, vnx = 0.0, vny = 0.0, vnz = 0.0;
-  double dx = 0.0, dy = 0.0, dz = 0.0;
-  int    x = 0, y = 0, z = 0, xk = 0, yk = 0, zk = 0, xn = 0, yn = 0, zn = 0;
-  int    width, height, depth, num = 0;
-  GCA_MORPH_NODE *gcamn = NULL, *gcamn_nbr = NULL;
-  extern int      gcamSmoothnessTerm_nCalls;
-  extern double   gcamSmoothnessTerm_tsec;
-  Timer           timer;
+  if (DZERO(l_smoothness)) {
+    return (NO_ERROR);
+  }
+  return (gcamSmoothnessTermSoa(gcam, GCAMgetSoa(gcam), l_smoothness));
+}
+
+/*!
+  \fn int gcamSmoothnessTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+        double l_smoothness)
+  \brief gcamSmoothnessTerm() reading the displacements from soa, which
+  must hold the current positions. The 26 neighbors of a node are at fixed
+  offsets in flat arrays, so the inner walk is stride-1 along z. The
+  gradient is still accumulated into the nodes.
+ */
+int gcamSmoothnessTermSoa(GCA_MORPH *gcam, const GCA_MORPH_SOA *soa,
+                          double l_smoothness) {
+  int           x, width, height, depth;
+  extern int    gcamSmoothnessTerm_nCalls;
+  extern double gcamSmoothnessTerm_tsec;
+  Timer         timer;
 
   if (DZERO(l_smoothness)) {
     return (NO_ERROR);
@@ -5960,28 +6266,28 @@ int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri,
   depth  = gcam->depth;
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-#pragma omp parallel for if_ROMP(assume_reproducible)                          \
-    firstprivate(y, z, gcamn, vx, vy, vz, dx, dy, dz, num, xk, xn, yk, yn, zk, \
-                 zn, gcamn_nbr, vnx, vny, vnz) shared(gcam, Gx, Gy, Gz)        \
-        schedule(static, 1)
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(static, 1)
 #endif
-      for (x = 0; x < gcam->width; x++) {
+  for (x = 0; x < width; x++) {
     ROMP_PFLB_begin
 
-        for (y = 0; y < gcam->height; y++) {
-      for (z = 0; z < gcam->depth; z++) {
+    int    y, z, xk, yk, zk, xn, yn, zn, num;
+    double vx, vy, vz, dx, dy, dz;
+
+    for (y = 0; y < height; y++) {
+      for (z = 0; z < depth; z++) {
+        const size_t i = GCAM_SOA_INDEX(soa, x, y, z);
+
         if (x == Gx && y == Gy && z == Gz) {
           DiagBreak();
         }
-        gcamn = &gcam->nodes[x][y][z];
-
-        if (gcamn->invalid == GCAM_POSITION_INVALID) {
+        if (soa->invalid[i] == GCAM_POSITION_INVALID) {
           continue;
         }
 
-        vx = gcamn->x - gcamn->origx;
-        vy = gcamn->y - gcamn->origy;
-        vz = gcamn->z - gcamn->origz;
+        vx = soa->x[i] - soa->origx[i];
+        vy = soa->y[i] - soa->origy[i];
+        vz = soa->z[i] - soa->origz[i];
         dx = dy = dz = 0.0f;
         if (x == Gx && y == Gy && z == Gz)
           printf("l_smoo: node(%d,%d,%d): V=(%2.2f,%2.2f,%2.2f)\n", x, y, z, vx,
@@ -5989,50 +6295,28 @@ int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri,
         num = 0;
 
         for (xk = -1; xk <= 1; xk++) {
-          xn = x + xk;
-          xn = MAX(0, xn);
-          xn = MIN(width - 1, xn);
-
+          xn = MIN(width - 1, MAX(0, x + xk));
           for (yk = -1; yk <= 1; yk++) {
-            yn = y + yk;
-            yn = MAX(0, yn);
-            yn = MIN(height - 1, yn);
-
+            yn = MIN(height - 1, MAX(0, y + yk));
             for (zk = -1; zk <= 1; zk++) {
+              size_t nbr;
+
               if (!zk && !yk && !xk) {
                 continue;
               }
-
-              zn = z + zk;
-              zn = MAX(0, zn);
-              zn = MIN(depth - 1, zn);
-
-              gcamn_nbr = &gcam->nodes[xn][yn][zn];
-
-              if (gcamn_nbr->invalid == GCAM_POSITION_INVALID) {
+              zn  = MIN(depth - 1, MAX(0, z + zk));
+              nbr = GCAM_SOA_INDEX(soa, xn, yn, zn);
+              if (soa->invalid[nbr] == GCAM_POSITION_INVALID) {
                 continue;
               }
 
-              vnx = gcamn_nbr->x - gcamn_nbr->origx;
-              vny = gcamn_nbr->y - gcamn_nbr->origy;
-              vnz = gcamn_nbr->z - gcamn_nbr->origz;
-
-              dx += (vnx - vx);
-              dy += (vny - vy);
-              dz += (vnz - vz);
-
-              if ((x == Gx && y == Gy && z == Gz) && (Gdiag & DIAG_SHOW) &&
-                  DIAG_VERBOSE_ON) {
-                printf("\tnode(%d,%d,%d): V=(%2.2f,%2.2f,%2.2f), "
-                       "DX=(%2.2f,%2.2f,%2.2f)\n",
-                       xn, yn, zn, vnx, vny, vnz, vnx - vx, vny - vy, vnz - vz);
-              }
-
+              dx += ((soa->x[nbr] - soa->origx[nbr]) - vx);
+              dy += ((soa->y[nbr] - soa->origy[nbr]) - vy);
+              dz += ((soa->z[nbr] - soa->origz[nbr]) - vz);
               num++;
             }
           }
         }
-        /*        num = 1 ;*/
         if (num) {
           dx = dx * l_smoothness / num;
           dy = dy * l_smoothness / num;
@@ -6044,9 +6328,9 @@ int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri,
                  dx, dy, dz);
         }
 
-        gcamn->dx += dx;
-        gcamn->dy += dy;
-        gcamn->dz += dz;
+        gcam->nodes[x][y][z].dx += dx;
+        gcam->nodes[x][y][z].dy += dy;
+        gcam->nodes[x][y][z].dz += dz;
       }
     }
 
@@ -6054,7 +6338,7 @@ int gcamSmoothnessTerm(GCA_MORPH *gcam, const MRI *mri,
   }
   ROMP_PF_end
 
-      gcamSmoothnessTerm_tsec += (timer.milliseconds() / 1000.0);
+  gcamSmoothnessTerm_tsec += (timer.milliseconds() / 1000.0);
 
   return (NO_ERROR);
 }
@@ -7921,11 +8205,446 @@ int GCAMsetLabelStatus(GCA_MORPH *gcam, int label, int status) {
 #define GCAM_FOTS_OUTPUT 0
 #define GCAM_FOTS_TIMERS 0
 
+#define GCAM_MAX_LINE_SEARCH_STEPS 32
+
+/*!
+  \fn int gcamCanComputeSSE_asThoughGradientApplied(
+        const GCA_MORPH_PARMS *parms)
+  \brief Returns 1 if every energy term enabled in parms is supported by
+  gcamComputeSSE_asThoughGradientApplied(), 0 otherwise. These are the
+  terms mri_ca_register uses by default (likelihood, jacobian, smoothness
+  and label).
+*/
+static int
+gcamCanComputeSSE_asThoughGradientApplied(const GCA_MORPH_PARMS *parms) {
+  if (!DZERO(parms->l_multiscale) || !DZERO(parms->l_dtrans) ||
+      !DZERO(parms->l_binary) || !DZERO(parms->l_area_intensity) ||
+      !DZERO(parms->l_map) || !DZERO(parms->l_expansion) ||
+      !DZERO(parms->l_distance) || !DZERO(parms->l_area) ||
+      !DZERO(parms->l_area_smoothness) || !DZERO(parms->l_lsmoothness) ||
+      !DZERO(parms->l_spring) || !DZERO(parms->l_elastic)) {
+    return (0);
+  }
+  return (1);
+}
+
+// where gcamApplyGradient() would move node i of soa with the given dt
+static inline void gcamTrialPosition(const GCA_MORPH_SOA *soa, size_t i,
+                                     float dt, float momentum, double *p) {
+  float dx, dy, dz;
+
+  if (soa->invalid[i] == GCAM_POSITION_INVALID) {
+    p[0] = soa->x[i];
+    p[1] = soa->y[i];
+    p[2] = soa->z[i];
+    return;
+  }
+  dx   = soa->dx[i] * dt + soa->odx[i] * momentum;
+  dy   = soa->dy[i] * dt + soa->ody[i] * momentum;
+  dz   = soa->dz[i] * dt + soa->odz[i] * momentum;
+  p[0] = soa->x[i] + dx;
+  p[1] = soa->y[i] + dy;
+  p[2] = soa->z[i] + dz;
+}
+
+// (v_j (x) v_k) (.) v_i as computed by GCAMN_SUB and VectorTripleProduct in
+// gcamComputeMetricProperties() (float arithmetic to match it)
+static inline float gcamTrialTripleProduct(const double *vi, const double *vj,
+                                           const double *vk) {
+  float x1, y1, z1, x2, y2, z2, x3, y3, z3, total;
+
+  x1    = vj[0];
+  y1    = vj[1];
+  z1    = vj[2];
+  x2    = vk[0];
+  y2    = vk[1];
+  z2    = vk[2];
+  x3    = vi[0];
+  y3    = vi[1];
+  z3    = vi[2];
+  total = x3 * (y1 * z2 - z1 * y2);
+  total += y3 * (z1 * x2 - x1 * z2);
+  total += z3 * (x1 * y2 - y1 * x2);
+  return (total);
+}
+
+/*!
+  \fn int gcamComputeSSE_asThoughGradientApplied(GCA_MORPH *gcam,
+        const GCA_MORPH_SOA *soa, MRI *mri, GCA_MORPH_PARMS *parms, int ndt,
+        const double *dts, double *sse, int *neg)
+  \brief Computes gcamComputeSSE() for each of the ndt time steps in dts
+  as though gcamApplyGradient() had been called with parms->dt = dts[k],
+  without writing to the nodes. All the steps are evaluated in a single
+  parallel sweep over the lattice, so gcamFindOptimalTimeStep() no longer
+  has to apply and undo the gradient (two full writes of the morph) for
+  every sample. sse[k] receives the energy and neg[k] the number of nodes
+  gcamComputeMetricProperties() would flag as negative.
+
+  Only the likelihood, jacobian, smoothness and label terms are
+  supported; returns ERROR_UNSUPPORTED (without printing) for any other
+  term so that the caller can fall back to apply/compute/undo. The
+  metric properties of the current positions must be up to date (the
+  area fields are used for nodes whose parallelepipeds can't be formed).
+  Results agree with the mutating path to rounding. The positions,
+  gradients and areas are read from soa, loaded by GCAMgetSoa() since the
+  nodes or the gradient last changed, so the per-step neighbor walks are
+  stride-1 and a line search gathers the nodes once for all its batches.
+*/
+int gcamComputeSSE_asThoughGradientApplied(GCA_MORPH *gcam,
+                                           const GCA_MORPH_SOA *soa, MRI *mri,
+                                           GCA_MORPH_PARMS *parms, int ndt,
+                                           const double *dts, double *sse,
+                                           int *neg) {
+  int            x, k, nthreads, width, height, depth;
+  double *       ll_partial, *jac_partial, *smooth_partial, label_sse, l_ll;
+  double         thick;
+  int *          neg_partial;
+  float          momentum;
+
+  if (!gcamCanComputeSSE_asThoughGradientApplied(parms)) {
+    return (ERROR_UNSUPPORTED);
+  }
+  if (ndt <= 0 || ndt > GCAM_MAX_LINE_SEARCH_STEPS)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM,
+                 "gcamComputeSSE_asThoughGradientApplied: %d steps (max %d)",
+                 ndt, GCAM_MAX_LINE_SEARCH_STEPS));
+
+  nthreads = omp_get_max_threads();
+  width    = gcam->width;
+  height   = gcam->height;
+  depth    = gcam->depth;
+  momentum = parms->momentum;
+  thick    = mri ? mri->thick : 1.0;
+  l_ll     = MAX(parms->l_log_likelihood, parms->l_likelihood);
+
+  ll_partial     = (double *)calloc(nthreads * ndt, sizeof(double));
+  jac_partial    = (double *)calloc(nthreads * ndt, sizeof(double));
+  smooth_partial = (double *)calloc(nthreads * ndt, sizeof(double));
+  neg_partial    = (int *)calloc(nthreads * ndt, sizeof(int));
+  if (!ll_partial || !jac_partial || !smooth_partial || !neg_partial)
+    ErrorExit(ERROR_NOMEMORY,
+              "gcamComputeSSE_asThoughGradientApplied: could not allocate "
+              "partial sums for %d threads",
+              nthreads);
+
+  // the label term only depends on label_dist, not on the node positions
+  label_sse = 0.0;
+  if (!DZERO(parms->l_label)) {
+    label_sse = parms->l_label * gcamLabelEnergy(gcam, mri, parms->label_dist);
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(static, 1)
+#endif
+  for (x = 0; x < width; x++) {
+    ROMP_PFLB_begin
+
+    int     tid  = omp_get_thread_num();
+    double *ll   = ll_partial + tid * ndt;
+    double *jac  = jac_partial + tid * ndt;
+    double *smoo = smooth_partial + tid * ndt;
+    int *   nneg = neg_partial + tid * ndt;
+    float   vals[MAX_GCA_INPUTS];
+    int     y, z, kk;
+
+    // strides of the x and y neighbors in soa (z neighbors are +-1)
+    const size_t sx = GCAM_SOA_INDEX(soa, 1, 0, 0);
+    const size_t sy = GCAM_SOA_INDEX(soa, 0, 1, 0);
+
+    for (y = 0; y < height; y++) {
+      struct different_neighbor_labels_context dnl_context;
+      init_different_neighbor_labels_context(&dnl_context, gcam, x, y);
+      for (z = 0; z < depth; z++) {
+        const GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        const size_t          i     = GCAM_SOA_INDEX(soa, x, y, z);
+        int                   use_ll, right, left;
+
+        if (soa->invalid[i] == GCAM_POSITION_INVALID) {
+          continue;
+        }
+
+        use_ll = !DZERO(l_ll) &&
+                 !(gcamn->status &
+                   (GCAM_IGNORE_LIKELIHOOD | GCAM_NEVER_USE_LIKELIHOOD)) &&
+                 !(IS_UNKNOWN(gcamn->label) &&
+                   different_neighbor_labels(&dnl_context, gcamn->label, gcam,
+                                             x, y, z) == 0);
+
+        // which parallelepipeds gcamComputeMetricProperties() would form
+        right = (x < width - 1) && (y < height - 1) && (z < depth - 1) &&
+                soa->invalid[i + sx] != GCAM_POSITION_INVALID &&
+                soa->invalid[i + sy] != GCAM_POSITION_INVALID &&
+                soa->invalid[i + 1] != GCAM_POSITION_INVALID;
+        left = (x > 0) && (y > 0) && (z > 0) &&
+               soa->invalid[i - sx] != GCAM_POSITION_INVALID &&
+               soa->invalid[i - sy] != GCAM_POSITION_INVALID &&
+               soa->invalid[i - 1] != GCAM_POSITION_INVALID;
+
+        for (kk = 0; kk < ndt; kk++) {
+          float  dt = dts[kk];
+          double p[3], pi[3], pj[3], pk[3], vi[3], vj[3], vk[3];
+          float  area1, area2;
+          int    n, is_neg = 0;
+
+          gcamTrialPosition(soa, i, dt, momentum, p);
+
+          if (use_ll) {
+            double error;
+
+            load_vals(mri, p[0], p[1], p[2], vals, gcam->ninputs);
+            if (gcamn->gc) {
+              error = GCAmahDist(gcamn->gc, vals, gcam->ninputs) +
+                      log(covariance_determinant(gcamn->gc, gcam->ninputs));
+            } else {
+              for (n = 0, error = 0.0; n < gcam->ninputs; n++) {
+                error += (vals[n] * vals[n] / MIN_VAR);
+              }
+            }
+            ll[kk] += error;
+          }
+
+          if (!DZERO(parms->l_smoothness)) {
+            double vx, vy, vz, node_sse = 0.0;
+            int    xk, yk, zk, xn, yn, zn, num = 0;
+
+            vx = p[0] - soa->origx[i];
+            vy = p[1] - soa->origy[i];
+            vz = p[2] - soa->origz[i];
+            for (xk = -1; xk <= 1; xk++) {
+              xn = MIN(width - 1, MAX(0, x + xk));
+              for (yk = -1; yk <= 1; yk++) {
+                yn = MIN(height - 1, MAX(0, y + yk));
+                for (zk = -1; zk <= 1; zk++) {
+                  size_t nbr;
+                  double dx, dy, dz;
+
+                  if (!xk && !yk && !zk) {
+                    continue;
+                  }
+                  zn  = MIN(depth - 1, MAX(0, z + zk));
+                  nbr = GCAM_SOA_INDEX(soa, xn, yn, zn);
+                  if (soa->invalid[nbr] == GCAM_POSITION_INVALID) {
+                    continue;
+                  }
+                  gcamTrialPosition(soa, nbr, dt, momentum, pi);
+                  dx = (pi[0] - soa->origx[nbr]) - vx;
+                  dy = (pi[1] - soa->origy[nbr]) - vy;
+                  dz = (pi[2] - soa->origz[nbr]) - vz;
+                  node_sse += dx * dx + dy * dy + dz * dz;
+                  num++;
+                }
+              }
+            }
+            if (num > 0) {
+              smoo[kk] += node_sse / num;
+            }
+          }
+
+          // jacobian term and negative node count
+          area1 = (x < width - 1 && y < height - 1 && z < depth - 1)
+                      ? soa->area1[i]
+                      : 0;
+          area2 = (x > 0 && y > 0 && z > 0) ? soa->area2[i] : 0;
+          if (right) {
+            gcamTrialPosition(soa, i + sx, dt, momentum, pi);
+            gcamTrialPosition(soa, i + sy, dt, momentum, pj);
+            gcamTrialPosition(soa, i + 1, dt, momentum, pk);
+            for (n = 0; n < 3; n++) {
+              vi[n] = pi[n] - p[n];
+              vj[n] = pj[n] - p[n];
+              vk[n] = pk[n] - p[n];
+            }
+            area1 = gcamTrialTripleProduct(vi, vj, vk);
+            if (area1 <= 0) {
+              is_neg = 1;
+            }
+          }
+          if (left) {
+            gcamTrialPosition(soa, i - sx, dt, momentum, pi);
+            gcamTrialPosition(soa, i - sy, dt, momentum, pj);
+            gcamTrialPosition(soa, i - 1, dt, momentum, pk);
+            // v_i is inverted so that the coordinate system is right-handed
+            for (n = 0; n < 3; n++) {
+              vi[n] = p[n] - pi[n];
+              vj[n] = pj[n] - p[n];
+              vk[n] = pk[n] - p[n];
+            }
+            area2 = gcamTrialTripleProduct(vi, vj, vk);
+            if (area2 <= 0) {
+              is_neg = 1;
+            }
+          }
+          if (soa->invalid[i] == GCAM_VALID && is_neg &&
+              soa->orig_area[i] > 0 && (right || left)) {
+            nneg[kk]++;
+          }
+
+          if (!DZERO(parms->l_jacobian) && !soa->invalid[i]) {
+            double delta, exponent;
+
+            if (!FZERO(soa->orig_area1[i])) {
+              exponent = -gcam->exp_k * (area1 / soa->orig_area1[i]);
+              delta    = (exponent > MAX_EXP) ? 0.0 : log(1 + exp(exponent));
+              jac[kk] += delta * thick;
+            }
+            if (!FZERO(soa->orig_area2[i])) {
+              exponent = -gcam->exp_k * (area2 / soa->orig_area2[i]);
+              delta = (exponent > MAX_EXP) ? MAX_EXP : log(1 + exp(exponent));
+              jac[kk] += delta * thick;
+            }
+          }
+        }
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (k = 0; k < ndt; k++) {
+    double ll_sse = 0.0, jac_sse = 0.0, smooth_sse = 0.0;
+    int    t;
+
+    neg[k] = 0;
+    for (t = 0; t < nthreads; t++) {
+      ll_sse += ll_partial[t * ndt + k];
+      jac_sse += jac_partial[t * ndt + k];
+      smooth_sse += smooth_partial[t * ndt + k];
+      neg[k] += neg_partial[t * ndt + k];
+    }
+    sse[k] = l_ll * ll_sse + parms->l_jacobian * jac_sse +
+             parms->l_smoothness * smooth_sse + label_sse;
+  }
+
+  free(ll_partial);
+  free(jac_partial);
+  free(smooth_partial);
+  free(neg_partial);
+  return (NO_ERROR);
+}
+
+#define GCAM_LINE_SEARCH_CACHE 64
+
+// samples of the RMS along the current gradient, filled a batch at a time by
+// gcamComputeSSE_asThoughGradientApplied()
+typedef struct {
+  int                  fused;   // evaluate without mutating the nodes
+  int                  mutated; // some sample was evaluated by apply/undo
+  const GCA_MORPH_SOA *soa;     // nodes gathered for the batches, or NULL
+  int                  n;
+  double               dt[GCAM_LINE_SEARCH_CACHE];
+  double               rms[GCAM_LINE_SEARCH_CACHE];
+  int                  neg[GCAM_LINE_SEARCH_CACHE];
+} GCAM_LINE_SEARCH;
+
+static void gcamLineSearchInit(GCAM_LINE_SEARCH *ls,
+                               const GCA_MORPH_PARMS *parms) {
+  ls->n       = 0;
+  ls->mutated = 0;
+  ls->soa     = NULL;
+  ls->fused   = gcamCanComputeSSE_asThoughGradientApplied(parms) &&
+              gcam_write_grad <= 1 &&
+              !getenv("FREESURFER_OLD_gcamFindOptimalTimeStep");
+}
+
+static int gcamLineSearchFind(const GCAM_LINE_SEARCH *ls, double dt) {
+  int i;
+
+  for (i = 0; i < ls->n; i++)
+    if (ls->dt[i] == dt) {
+      return (i);
+    }
+  return (-1);
+}
+
+// evaluate all the not yet sampled dts in one sweep over the lattice
+static void gcamLineSearchPrefetch(GCAM_LINE_SEARCH *ls, GCA_MORPH *gcam,
+                                   MRI *mri, GCA_MORPH_PARMS *parms, int ndt,
+                                   const double *dts) {
+  double batch[GCAM_MAX_LINE_SEARCH_STEPS], sse[GCAM_MAX_LINE_SEARCH_STEPS];
+  int    neg[GCAM_MAX_LINE_SEARCH_STEPS], i, nbatch;
+  float  nvoxels;
+
+  if (!ls->fused) {
+    return;
+  }
+  for (nbatch = i = 0; i < ndt && nbatch < GCAM_MAX_LINE_SEARCH_STEPS; i++)
+    if (gcamLineSearchFind(ls, dts[i]) < 0) {
+      batch[nbatch++] = dts[i];
+    }
+  if (nbatch == 0) {
+    return;
+  }
+  // the nodes and gradient stay put between batches, so gather them once
+  if (!ls->soa) {
+    ls->soa = GCAMgetSoa(gcam);
+  }
+  if (gcamComputeSSE_asThoughGradientApplied(gcam, ls->soa, mri, parms, nbatch,
+                                             batch, sse, neg) != NO_ERROR) {
+    ls->fused = 0;
+    return;
+  }
+  if (ls->n + nbatch > GCAM_LINE_SEARCH_CACHE) {
+    ls->n = 0;
+  }
+  nvoxels = gcam->width * gcam->height * gcam->depth;
+  for (i = 0; i < nbatch; i++) {
+    ls->dt[ls->n]  = batch[i];
+    ls->rms[ls->n] = sqrt(sse[i] / nvoxels);
+    ls->neg[ls->n] = neg[i];
+    ls->n++;
+  }
+}
+
+/*
+  RMS (and # of negative nodes) after a step of dt along the gradient. On a
+  miss the whole x4 ladder from dt up to max_dt is prefetched, as that is
+  what the coarse search in gcamFindOptimalTimeStep() will ask for next.
+*/
+static double gcamLineSearchRMS(GCAM_LINE_SEARCH *ls, GCA_MORPH *gcam,
+                                MRI *mri, GCA_MORPH_PARMS *parms, double dt,
+                                double max_dt, int *pneg) {
+  double dts[GCAM_MAX_LINE_SEARCH_STEPS], rms, ladder_dt;
+  int    i, ndt;
+
+  if (ls->fused) {
+    i = gcamLineSearchFind(ls, dt);
+    if (i < 0) {
+      ndt = 0;
+      for (ladder_dt = dt; ndt < GCAM_MAX_LINE_SEARCH_STEPS; ladder_dt *= 4) {
+        dts[ndt++] = ladder_dt;
+        if (ladder_dt * 4 > max_dt) {
+          break;
+        }
+      }
+      gcamLineSearchPrefetch(ls, gcam, mri, parms, ndt, dts);
+      i = gcamLineSearchFind(ls, dt);
+    }
+    if (i >= 0) {
+      *pneg = ls->neg[i];
+      return (ls->rms[i]);
+    }
+  }
+
+  ls->mutated = 1;
+  ls->soa     = NULL; // undoing rounds the positions and drops the momentum
+  parms->dt   = dt;
+  gcamApplyGradient(gcam, parms);
+  rms = GCAMcomputeRMS(gcam, mri, parms);
+  gcamUndoGradient(gcam);
+  *pneg = gcam->neg;
+  return (rms);
+}
+
 /*!
   \fn double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms, MRI *mri)
   \brief Steps along the gradient to find the optimum (min RMS). This is in
   one of mri_ca_register's lowest loops and so time sensitive. Takes about 16000ms.
-  Could probably be sped up (see notes).
+  Could probably be sped up (see notes). When the enabled energy terms allow
+  it the samples are evaluated by gcamComputeSSE_asThoughGradientApplied(),
+  a batch of step sizes per sweep, and the nodes are never moved; set
+  FREESURFER_OLD_gcamFindOptimalTimeStep to apply/compute/undo each sample.
 #FOTS#
 */
 double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
@@ -7941,11 +8660,12 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
       c, max_dt, start_dt;
   // double start_rms, pct_change;
   VECTOR *vY;
-  int     N, i, Gxs, Gys, Gzs, suppressed = 0, prev_neg;
+  int     N, i, Gxs, Gys, Gzs, suppressed = 0, prev_neg, neg;
   // int  bad;
-  long   diag;
-  int    GotBetter;
-  double old_min_rms, old_min_dt;
+  long             diag;
+  int              GotBetter;
+  double           old_min_rms, old_min_dt;
+  GCAM_LINE_SEARCH ls;
   //extern int nFOTS_Calls;
 
 #if GCAM_FOTS_OUTPUT
@@ -7979,6 +8699,7 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
   // start_rms =
   min_rms = GCAMcomputeRMS(gcam, mri, parms); // about 850ms
   min_dt  = 0;
+  gcamLineSearchInit(&ls, parms);
 
   /* first find right order of magnitude for time step */
   orig_dt = parms->dt;
@@ -8003,22 +8724,21 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
     // bad = 0;
     prev_neg = 0;
     for (parms->dt = start_dt; parms->dt <= max_dt; parms->dt *= 4) {
-      gcamApplyGradient(gcam, parms);
-      rms = GCAMcomputeRMS(gcam, mri, parms);
-      gcamUndoGradient(gcam);
-      if ((gcam->neg > 0) && 0) {
+      rms = gcamLineSearchRMS(&ls, gcam, mri, parms, parms->dt, max_dt, &neg);
+      if ((neg > 0) && 0) {
         // pct_change = 100.0 * (start_rms - min_rms) / start_rms;
         //    if (pct_change < parms->tol)
         {
           if (getenv("SHOW_NEG")) {
             printf("!!!!!!!!!!reducing gradient magnitude around %d negative "
                    "nodes\n",
-                   gcam->neg);
+                   neg);
           }
           gcamSuppressNegativeGradients(gcam, 0.5);
-          if (suppressed++ < 1000 &&
-              ((gcam->neg < prev_neg) || (prev_neg <= 0))) {
-            prev_neg = gcam->neg;
+          ls.n   = 0; // the gradient changed
+          ls.soa = NULL;
+          if (suppressed++ < 1000 && ((neg < prev_neg) || (prev_neg <= 0))) {
+            prev_neg = neg;
             parms->dt /= 4; // try again at this scale
             continue;
           }
@@ -8027,7 +8747,7 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
         prev_neg = suppressed = 0;
       }
 
-      if (gcam->neg > 0 && gcam_write_grad > 1) // diagnostic
+      if (neg > 0 && gcam_write_grad > 1) // diagnostic
       {
         int             x, y, z, k;
         GCA_MORPH_NODE *gcamn;
@@ -8046,16 +8766,16 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
         }
       }
 
-      if (gcam->neg > 0 && getenv("SHOW_NEG")) {
-        printf("%d negative nodes at dt=%2.6f\n", gcam->neg, parms->dt);
+      if (neg > 0 && getenv("SHOW_NEG")) {
+        printf("%d negative nodes at dt=%2.6f\n", neg, parms->dt);
       }
 
-      if (gcam->neg > 0 && DEQUAL(parms->dt, start_dt)) {
+      if (neg > 0 && DEQUAL(parms->dt, start_dt)) {
         start_dt *= 0.1;
         parms->dt /= 4;
         continue;
       }
-      if (gcam->neg && parms->noneg == True) {
+      if (neg && parms->noneg == True) {
         break;
       }
       if (rms < min_rms) {
@@ -8084,45 +8804,22 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
   dt_in[0]   = min_dt;
   rms_out[0] = min_rms;
 
-  // Sample RMS at four locations (-0.4, -0.2, 0.2, 0.4). Takes about 3800ms for all four
-  parms->dt = dt_in[1] = dt_in[0] - dt_in[0] * .2;
-  gcamApplyGradient(gcam, parms);
-  rms = rms_out[1] = GCAMcomputeRMS(gcam, mri, parms);
-  gcamUndoGradient(gcam);
-  if (rms < min_rms && (gcam->neg == 0 || parms->noneg <= 0)) {
-    min_rms   = rms;
-    min_dt    = parms->dt;
-    GotBetter = 1;
-  }
-
-  parms->dt = dt_in[2] = dt_in[0] - dt_in[0] * .4;
-  gcamApplyGradient(gcam, parms);
-  rms = rms_out[2] = GCAMcomputeRMS(gcam, mri, parms);
-  if (rms < min_rms && (gcam->neg == 0 || parms->noneg <= 0)) {
-    min_rms   = rms;
-    min_dt    = parms->dt;
-    GotBetter = 1;
-  }
-  gcamUndoGradient(gcam);
-
-  parms->dt = dt_in[3] = dt_in[0] + dt_in[0] * .2;
-  gcamApplyGradient(gcam, parms);
-  rms = rms_out[3] = GCAMcomputeRMS(gcam, mri, parms);
-  gcamUndoGradient(gcam);
-  if (rms < min_rms && (gcam->neg == 0 || parms->noneg <= 0)) {
-    min_rms   = rms;
-    min_dt    = parms->dt;
-    GotBetter = 1;
-  }
-
-  parms->dt = dt_in[4] = dt_in[0] + dt_in[0] * .4;
-  gcamApplyGradient(gcam, parms);
-  rms = rms_out[4] = GCAMcomputeRMS(gcam, mri, parms);
-  gcamUndoGradient(gcam);
-  if (rms < min_rms && (gcam->neg == 0 || parms->noneg <= 0)) {
-    min_rms   = rms;
-    min_dt    = parms->dt;
-    GotBetter = 1;
+  // Sample RMS at four locations (-0.4, -0.2, 0.2, 0.4). Takes about 3800ms
+  // for all four when they are applied one at a time
+  dt_in[1] = dt_in[0] - dt_in[0] * .2;
+  dt_in[2] = dt_in[0] - dt_in[0] * .4;
+  dt_in[3] = dt_in[0] + dt_in[0] * .2;
+  dt_in[4] = dt_in[0] + dt_in[0] * .4;
+  gcamLineSearchPrefetch(&ls, gcam, mri, parms, 4, &dt_in[1]);
+  for (i = 1; i <= 4; i++) {
+    parms->dt = dt_in[i];
+    rms = rms_out[i] =
+        gcamLineSearchRMS(&ls, gcam, mri, parms, parms->dt, parms->dt, &neg);
+    if (rms < min_rms && (neg == 0 || parms->noneg <= 0)) {
+      min_rms   = rms;
+      min_dt    = parms->dt;
+      GotBetter = 1;
+    }
   }
 
   /* now compute location of minimum of best quadratic fit */
@@ -8160,10 +8857,9 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
     MatrixFree(&m_xTy);
     if (finitep(a) && !FZERO(a)) {
       parms->dt = -b / a;
-      gcamApplyGradient(gcam, parms);
-      rms = GCAMcomputeRMS(gcam, mri, parms);
-      gcamUndoGradient(gcam);
-      if (rms < min_rms && (gcam->neg == 0 || parms->noneg <= 0)) {
+      rms =
+          gcamLineSearchRMS(&ls, gcam, mri, parms, parms->dt, parms->dt, &neg);
+      if (rms < min_rms && (neg == 0 || parms->noneg <= 0)) {
         min_rms   = rms;
         min_dt    = parms->dt;
         GotBetter = 1;
@@ -8182,7 +8878,10 @@ double gcamFindOptimalTimeStep(GCA_MORPH *gcam, GCA_MORPH_PARMS *parms,
     fflush(stdout);
   }
 
-  gcamComputeMetricProperties(gcam);
+  // the nodes were only moved if some sample was applied and undone
+  if (ls.mutated) {
+    gcamComputeMetricProperties(gcam);
+  }
   parms->dt = orig_dt;
   Gx        = Gxs;
   Gy        = Gys;
@@ -12122,8 +12821,9 @@ int GCAMreinitWithLTA(GCA_MORPH *gcam, LTA *lta, MRI *mri,
       gcamClearGradient(gcam);
       last_rms = GCAMcomputeRMS(gcam, mri, parms);
       gcamComputeTargetGradient(gcam);
-      gcamSmoothnessTerm(gcam, mri, parms->l_smoothness);
-      gcamJacobianTerm(gcam, mri, parms->l_jacobian, parms->ratio_thresh);
+      const GCA_MORPH_SOA *soa = gcamTermSoa(gcam, parms);
+      gcamSmoothnessTermSoa(gcam, soa, parms->l_smoothness);
+      gcamJacobianTermSoa(gcam, soa, parms->l_jacobian, parms->ratio_thresh);
       gcamLimitGradientMagnitude(gcam, parms, mri);
 
       gcamSmoothGradient(gcam, navgs);
@@ -13163,8 +13863,9 @@ int GCAMdeformVentricles(GCA_MORPH *gcam, MRI *mri, GCA_MORPH_PARMS *parms) {
       gcamComputeMetricProperties(gcam);
       last_rms = GCAMcomputeRMS(gcam, mri, parms);
       gcamComputePeriventricularWMDeformation(gcam, mri);
-      gcamSmoothnessTerm(gcam, mri, parms->l_smoothness);
-      gcamJacobianTerm(gcam, mri, parms->l_jacobian, parms->ratio_thresh);
+      const GCA_MORPH_SOA *soa = gcamTermSoa(gcam, parms);
+      gcamSmoothnessTermSoa(gcam, soa, parms->l_smoothness);
+      gcamJacobianTermSoa(gcam, soa, parms->l_jacobian, parms->ratio_thresh);
       gcamLimitGradientMagnitude(gcam, parms, mri);
       gcamSmoothGradient(gcam, navgs);
       parms->dt = orig_dt;
@@ -16945,10 +17646,11 @@ int GCAMregisterVentricles(GCA_MORPH *gcam, MRI *mri, GCA_MORPH_PARMS *parms) {
         GCAMcomputeVentricleExpansionGradient(gcam, mri, mri_vent,
                                               parms->navgs);
         gcamLogLikelihoodTerm(gcam, mri, mri_smooth, parms->l_log_likelihood);
-        gcamSmoothnessTerm(gcam, mri, parms->l_smoothness);
+        const GCA_MORPH_SOA *soa = gcamTermSoa(gcam, parms);
+        gcamSmoothnessTermSoa(gcam, soa, parms->l_smoothness);
         gcamLSmoothnessTerm(gcam, mri, parms->l_lsmoothness);
         gcamSpringTerm(gcam, parms->l_spring, parms->ratio_thresh);
-        gcamJacobianTerm(gcam, mri, parms->l_jacobian, parms->ratio_thresh);
+        gcamJacobianTermSoa(gcam, soa, parms->l_jacobian, parms->ratio_thresh);
         // The following appears to be a null operation, based on current #ifdefs
         gcamLimitGradientMagnitude(gcam, parms, mri);
         gcamSmoothGradient(gcam, parms->navgs);
@@ -3,11 +3,15 @@
 //
 
 #include <algorithm>
+#include <fcntl.h>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <stack>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 #include "geodesics.h"
@@ -39,224 +43,357 @@ struct Triangle {
   float angle[3];
   int   vert[3];
   int   neighbor[3];
-  bool  inChain;
 };
 
-static int    getIndex(int *arr, int vid);
+static int    getIndex(const int *arr, int vid);
 static float  distanceBetween(int v1, int v2, MRIS *surf);
 static int    findNeighbor(int faceidx, int v1, int v2, MRIS *surf);
 static Vertex extendedPoint(Vertex A, Vertex B, float dA, float dB, float dAB);
-static std::pair<int, int> makeKey(int a, int b);
-static void                progressBar(float progress);
+static void   progressBar(float progress);
+
+// per-source results of the line-of-sight pass: the neighbors of one vertex
+// sorted by vertex number, so another thread can look them up read-only
+typedef std::vector<std::pair<int, float>> GeoList;
+
+// per-thread scratch for computeGeodesicsCSR(); marks are stamped with the
+// source vertex so they never need to be cleared between sources
+struct GeoScratch {
+  std::vector<char>      inChain;
+  std::vector<int>       chain;
+  std::stack<StackItem>  stack;
+  std::vector<int>       nearmark;
+  std::vector<int>       losmark;
+  std::vector<float>     losdist;
+  std::vector<int>       touched;
+  std::vector<int>       nearest;
+
+  GeoScratch(int nvertices, int nfaces)
+      : inChain(nfaces, 0), nearmark(nvertices, -1), losmark(nvertices, -1),
+        losdist(nvertices, -1.0f) {}
+};
 
-Geodesics *computeGeodesics(MRIS *surf, float maxdist) {
+static bool geoListFind(GeoList const &list, int vno, float *dist) {
+  auto it = std::lower_bound(
+      list.begin(), list.end(), vno,
+      [](std::pair<int, float> const &e, int v) { return e.first < v; });
+  if (it == list.end() || it->first != vno)
+    return false;
+  *dist = it->second;
+  return true;
+}
+
+// symmetric line-of-sight distance between a and b: the shorter of the
+// estimates made from either end, so the result does not depend on the
+// order in which the sources were processed
+static bool geoPathLookup(std::vector<GeoList> const &los, int a, int b,
+                          float *dist) {
+  float dab, dba;
+  bool  fab = geoListFind(los[a], b, &dab);
+  bool  fba = geoListFind(los[b], a, &dba);
+  if (!fab && !fba)
+    return false;
+  if (fab && fba)
+    *dist = std::min(dab, dba);
+  else
+    *dist = fab ? dab : dba;
+  return true;
+}
+
+// ------ STEP 1 ------
+// compute each geodesic from vertexID using the LOS algorithm. this will not
+// account for every path; step 2 fills in the rest.
+static void geodesicsLineOfSight(MRIS *surf, float maxdist, int vertexID,
+                                 std::vector<Triangle> const &triangles,
+                                 GeoScratch &s, GeoList &los,
+                                 std::vector<int> &nearestverts) {
+  int idxlookup[] = {0, 2, 1, 0}; // fast lookup table to find remaining index
+                                  // can be removed... there's an easier way
+  Triangle const *triangle;
+  StackItem       stackitem;
+  Vertex          A, B, C, D;
+  int             iA, iB, iC, iD;
+  int             current_idx;
+  float           min_angle, max_angle, current_angle, distance;
+
+  s.touched.clear();
+  auto addNearest = [&](int vno) {
+    if (s.nearmark[vno] != vertexID) {
+      s.nearmark[vno] = vertexID;
+      nearestverts.push_back(vno);
+    }
+  };
+  auto addPath = [&](int vno, float d) {
+    if (s.losmark[vno] != vertexID) {
+      s.losmark[vno] = vertexID;
+      s.losdist[vno] = d;
+      s.touched.push_back(vno);
+    } else if (d < s.losdist[vno])
+      s.losdist[vno] = d;
+  };
+
+  VERTEX_TOPOLOGY const *const basevertex = &surf->vertices_topology[vertexID];
+  // begin chain with each face that neighbors the current base vertex:
+  for (int i = 0; i < basevertex->num; i++) {
+    // clear triangle chain:
+    for (unsigned int c = 0; c < s.chain.size(); c++)
+      s.inChain[s.chain[c]] = false;
+    s.chain.clear();
+    // set up initial triangle in plane:
+    current_idx = basevertex->f[i];
+    triangle    = &triangles[current_idx];
+    // formally add to chain:
+    s.chain.push_back(current_idx);
+    s.inChain[current_idx] = true;
+    // get vertex indices in relation to their
+    // placement in the face's vertex array:
+    iC = getIndex(triangle->vert, vertexID);
+    iA = (iC + 1) % 3;
+    iB = (iC + 2) % 3;
+    // compute min and max fov angles:
+    min_angle = 0.0;
+    max_angle = triangle->angle[iC];
+    // compute vertex A along x axis:
+    A.x  = triangle->length[iB];
+    A.y  = 0.0;
+    A.id = triangle->vert[iA];
+    // compute vertex B in positive y (no need for this to be pre-computed):
+    B.x  = triangle->length[iA] * cos(max_angle);
+    B.y  = triangle->length[iA] * sin(max_angle);
+    B.id = triangle->vert[iB];
+    // reset vertex C (base vertex which represents the origin):
+    C.x  = 0.0;
+    C.y  = 0.0;
+    C.id = triangle->vert[iC];
+    // formally consider the distances from C to A and B as geodesics:
+    addNearest(A.id);
+    addPath(A.id, triangle->length[iB]);
+    addNearest(B.id);
+    addPath(B.id, triangle->length[iA]);
+    // chain initialiaztion complete. get next triangle
+    // and begin building chain:
+    current_idx = triangle->neighbor[iC];
+    // ------ build triangle chain ------
+    while (true) {
+      // check if the current triangle is valid or if it
+      // already exists in the chain:
+      if ((current_idx < 0) || (s.inChain[current_idx])) {
+        // move on to next base triangle if the stack is empty:
+        if (s.stack.empty())
+          break;
+        // if not, just revert to the last stack item:
+        else {
+          stackitem   = s.stack.top();
+          A           = stackitem.a;
+          B           = stackitem.b;
+          C           = stackitem.c;
+          min_angle   = stackitem.mina;
+          max_angle   = stackitem.maxa;
+          current_idx = stackitem.idx;
+          triangle    = &triangles[current_idx];
+          // trim the chain back to the current triangle:
+          while ((s.chain.size() > 0) && (s.chain.back() != current_idx)) {
+            s.inChain[s.chain.back()] = false;
+            s.chain.pop_back();
+          }
+          s.stack.pop();
+        }
+      }
+      // triangle is valid, so add it to the chain:
+      else {
+        triangle = &triangles[current_idx];
+        s.chain.push_back(current_idx);
+        s.inChain[current_idx] = true;
+        // find appropriate vertex indices for new triangle:
+        iA = getIndex(triangle->vert, A.id); // this can be optimized
+        iB = getIndex(triangle->vert, B.id);
+        iD = idxlookup[iA + iB];
+        // calculate the planar position of the extended vertex D:
+        D    = extendedPoint(A, B, triangle->length[iB], triangle->length[iA],
+                          triangle->length[iD]);
+        D.id = triangle->vert[iD];
+        // calculate the angle that the vector D makes with x-axis:
+        current_angle = atan2(D.y, D.x);
+        // now calculate the distance to the origin:
+        distance = sqrt(D.x * D.x + D.y * D.y);
+        if (distance > maxdist) {
+          current_idx = -1; // this forces the next triangle invalid
+          continue;
+        }
+        addNearest(D.id);
+        // check if angle is visible within the fov:
+        if ((current_angle < min_angle)) {
+          C = A;
+          A = D;
+        } else if ((current_angle > max_angle)) {
+          C = B;
+          B = D;
+        } else if (((current_angle <= max_angle) &&
+                    (current_angle >= min_angle))) {
+          // keep the geodesic if shorter than the previous distance:
+          addPath(D.id, distance);
+          // push triangle to the stack:
+          stackitem.a    = A;
+          stackitem.b    = D;
+          stackitem.c    = B;
+          stackitem.idx  = current_idx;
+          stackitem.mina = min_angle;
+          stackitem.maxa = current_angle;
+          s.stack.push(stackitem);
+          C         = A;
+          A         = D;
+          min_angle = current_angle;
+        }
+        // this is used to find bugs within the surface (so far I've only
+        // seen problems in the fsaverage surface)
+        else {
+          current_idx = -1;
+          continue;
+        }
+      }
+      // get the next triangle and repeat:
+      iC          = getIndex(triangle->vert, C.id);
+      current_idx = triangle->neighbor[iC];
+    }
+  }
+
+  los.resize(s.touched.size());
+  for (unsigned int n = 0; n < s.touched.size(); n++)
+    los[n] = std::make_pair(s.touched[n], s.losdist[s.touched[n]]);
+  std::sort(los.begin(), los.end());
+}
+
+// ------ STEP 2 ------
+// compute the shortest paths between vertex k and the vertices within the
+// given limit. only the frozen step 1 table is shared between threads; the
+// distances found here for k are kept in the scratch losdist/losmark arrays.
+static void geodesicsShortestPaths(MRIS *surf, float maxdist, int k,
+                                   std::vector<GeoList> const &los,
+                                   std::vector<int> const &nearestverts,
+                                   GeoScratch &s, GeoList &out) {
+  std::vector<int> &nearest = s.nearest;
+  std::vector<float> &ld    = s.losdist;
+  float               distance, d;
+  int                 vi, vj;
+
+  // set up nearest vertices reference and the known distances from k:
+  auto addNearest = [&](int vno) {
+    s.nearmark[vno] = k;
+    nearest.push_back(vno);
+    ld[vno] = geoPathLookup(los, k, vno, &d) ? d : -1.0f;
+  };
+  nearest.clear();
+  for (unsigned int n = 0; n < nearestverts.size(); n++)
+    addNearest(nearestverts[n]);
+
+  for (unsigned int i = 0; i < nearest.size(); i++) {
+    vi = nearest[i];
+    if ((vi == k) || (ld[vi] >= 0.0))
+      continue;
+
+    for (unsigned int j = 0; j < nearest.size(); j++) {
+      vj = nearest[j];
+      if ((vi == vj) || (vj == k))
+        continue;
+      // retrieve distance from k to j:
+      if (ld[vj] < 0.0)
+        continue;
+      // retrieve distance from j to i:
+      if (!geoPathLookup(los, vj, vi, &d))
+        continue;
+      distance = ld[vj] + d;
+      if (ld[vi] < 0.0) {
+        if (distance < maxdist)
+          ld[vi] = distance;
+      } else if (distance < ld[vi])
+        ld[vi] = distance;
+    }
+    // search for vertices that are within distance limits
+    // but weren't discovered by the triangle chain
+    if (ld[vi] >= 0.0) {
+      VERTEX_TOPOLOGY const *const vt = &surf->vertices_topology[vi];
+      for (int side = 0; side < vt->vnum; side++) {
+        if (s.nearmark[vt->v[side]] != k) {
+          distance = ld[vi] + 0.5;
+          if (distance < maxdist)
+            addNearest(vt->v[side]);
+        }
+      }
+    }
+  }
+
+  out.clear();
+  for (unsigned int n = 0; n < nearest.size(); n++) {
+    if (nearest[n] != k && ld[nearest[n]] >= 0.0)
+      out.push_back(std::make_pair(nearest[n], ld[nearest[n]]));
+  }
+}
+
+GeodesicsCSR *computeGeodesicsCSR(MRIS *surf, float maxdist) {
   int   msec;
   Timer mytimer;
-  printf("computeGeodesics(): maxdist = %g, nvertices = %d\n", maxdist,
+  printf("computeGeodesicsCSR(): maxdist = %g, nvertices = %d\n", maxdist,
          surf->nvertices);
   fflush(stdout);
 
   // pre-compute and set-up required values to build triangle chain:
-  FACE *                face;
-  Triangle *            triangle;
   std::vector<Triangle> triangles(surf->nfaces);
-  int                   idx1, idx2;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (int nf = 0; nf < surf->nfaces; nf++) {
-    face     = &surf->faces[nf];
-    triangle = &triangles[nf];
+    ROMP_PFLB_begin
+    FACE *    face     = &surf->faces[nf];
+    Triangle *triangle = &triangles[nf];
     for (int ns = 0; ns < 3; ns++) {
-      idx1 = (ns + 1) % 3;
-      idx2 = (ns + 2) % 3;
+      int idx1 = (ns + 1) % 3;
+      int idx2 = (ns + 2) % 3;
       triangle->length[ns] =
           distanceBetween(face->v[idx1], face->v[idx2], surf);
       triangle->neighbor[ns] =
           findNeighbor(nf, face->v[idx1], face->v[idx2], surf);
-      triangle->vert[ns]  = face->v[ns];
-      triangle->angle[ns] = face->angle[ns];
+      triangle->vert[ns] = face->v[ns];
+    }
+    // the corner angles follow from the same edge lengths the chain is
+    // unfolded with; face->angle is not kept up to date by
+    // MRIScomputeMetricProperties(), and zero angles never end the chain
+    for (int ns = 0; ns < 3; ns++) {
+      float const a = triangle->length[ns];
+      float const b = triangle->length[(ns + 1) % 3];
+      float const c = triangle->length[(ns + 2) % 3];
+      float const cosa = (b * b + c * c - a * a) / (2 * b * c);
+      triangle->angle[ns] = acos(std::max(-1.0f, std::min(1.0f, cosa)));
     }
-    triangle->inChain = false;
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   msec = mytimer.milliseconds();
   printf("precompute t = %g min\n", msec / (1000.0 * 60));
   fflush(stdout);
 
+  int const                nthreads = omp_get_max_threads();
+  std::vector<GeoScratch>  scratch(nthreads,
+                                  GeoScratch(surf->nvertices, surf->nfaces));
+  std::vector<GeoList>          los(surf->nvertices);
+  std::vector<std::vector<int>> nearestverts(surf->nvertices);
+
   std::cout << "computing geodesics within distance of " << maxdist << " mm\n";
   fflush(stdout);
-  std::vector<std::vector<int>> nearestverts(surf->nvertices);
-  int idxlookup[] = {0, 2, 1, 0}; // fast lookup table to find remaining index
-                                  // can be removed... there's an easier way
-  std::map<std::pair<int, int>, float> pathmap;
-  // private vars:
-  std::vector<int>                               chain;
-  std::stack<StackItem>                          stack;
-  std::vector<bool>                              isnearest(surf->nvertices);
-  std::map<std::pair<int, int>, float>::iterator edge;
-  StackItem                                      stackitem;
-  Vertex                                         A, B, C, D;
-  int                                            iA, iB, iC, iD;
-  int                                            current_idx;
-  float min_angle, max_angle, current_angle, distance;
-
-  // ------ STEP 1 ------
-  // compute each geodesic using the LOS algorithm. each geodesics is added
-  // to the pathmap, but this will not account for every path.
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 64)
+#endif
   for (int vertexID = 0; vertexID < surf->nvertices; vertexID++) {
-    VERTEX_TOPOLOGY const *const basevertex =
-        &surf->vertices_topology[vertexID];
-    // begin chain with each face that neighbors the current base vertex:
-    for (int i = 0; i < basevertex->num; i++) {
-      // clear triangle chain and surrounding vertices index:
-      for (unsigned int c = 0; c < chain.size(); c++)
-        triangles[chain[c]].inChain = false;
-      chain.clear();
-      for (unsigned int c = 0; c < isnearest.size(); c++)
-        isnearest[c] = false;
-      // set up initial triangle in plane:
-      current_idx = basevertex->f[i];
-      triangle    = &triangles[current_idx];
-      // formally add to chain:
-      chain.push_back(current_idx);
-      triangle->inChain = true;
-      // get vertex indices in relation to their
-      // placement in the face's vertex array:
-      iC = getIndex(triangle->vert, vertexID);
-      iA = (iC + 1) % 3;
-      iB = (iC + 2) % 3;
-      // compute min and max fov angles:
-      min_angle = 0.0;
-      max_angle = triangle->angle[iC];
-      // compute vertex A along x axis:
-      A.x  = triangle->length[iB];
-      A.y  = 0.0;
-      A.id = triangle->vert[iA];
-      // compute vertex B in positive y (no need for this to be pre-computed):
-      B.x  = triangle->length[iA] * cos(max_angle);
-      B.y  = triangle->length[iA] * sin(max_angle);
-      B.id = triangle->vert[iB];
-      // reset vertex C (base vertex which represents the origin):
-      C.x  = 0.0;
-      C.y  = 0.0;
-      C.id = triangle->vert[iC];
-      // formally consider the distance from C to A as a geodesic:
-      nearestverts[vertexID].push_back(A.id);
-      isnearest[A.id] = true;
-      edge            = pathmap.find(makeKey(vertexID, A.id));
-      if (edge != pathmap.end())
-        edge->second = triangle->length[iB];
-      else
-        pathmap.insert(
-            make_pair(makeKey(vertexID, A.id), triangle->length[iB]));
-      // formally consider the distance from C to B as a geodesic:
-      nearestverts[vertexID].push_back(B.id);
-      isnearest[B.id] = true;
-      edge            = pathmap.find(makeKey(vertexID, B.id));
-      if (edge != pathmap.end())
-        edge->second = triangle->length[iA];
-      else
-        pathmap.insert(
-            make_pair(makeKey(vertexID, B.id), triangle->length[iA]));
-      // chain initialiaztion complete. get next triangle
-      // and begin building chain:
-      current_idx = triangle->neighbor[iC];
-      // ------ build triangle chain ------
-      while (true) {
-        // check if the current triangle is valid or if it
-        // already exists in the chain:
-        if ((current_idx < 0) || (triangles[current_idx].inChain)) {
-          // move on to next base triangle if the stack is empty:
-          if (stack.empty())
-            break;
-          // if not, just revert to the last stack item:
-          else {
-            stackitem   = stack.top();
-            A           = stackitem.a;
-            B           = stackitem.b;
-            C           = stackitem.c;
-            min_angle   = stackitem.mina;
-            max_angle   = stackitem.maxa;
-            current_idx = stackitem.idx;
-            triangle    = &triangles[current_idx];
-            // trim the chain back to the current triangle:
-            while ((chain.back() != current_idx) && (chain.size() > 0)) {
-              triangles[chain.back()].inChain = false;
-              chain.pop_back();
-            }
-            stack.pop();
-          }
-        }
-        // triangle is valid, so add it to the chain:
-        else {
-          triangle = &triangles[current_idx];
-          chain.push_back(current_idx);
-          triangle->inChain = true;
-          // find appropriate vertex indices for new triangle:
-          iA = getIndex(triangle->vert, A.id); // this can be optimized
-          iB = getIndex(triangle->vert, B.id);
-          iD = idxlookup[iA + iB];
-          // calculate the planar position of the extended vertex D:
-          D    = extendedPoint(A, B, triangle->length[iB], triangle->length[iA],
-                            triangle->length[iD]);
-          D.id = triangle->vert[iD];
-          // calculate the angle that the vector D makes with x-axis:
-          current_angle = atan2(D.y, D.x);
-          // now calculate the distance to the origin:
-          distance = sqrt(D.x * D.x + D.y * D.y);
-          if (distance > maxdist) {
-            current_idx = -1; // this forces the next triangle invalid
-            continue;
-          }
-          // potentially use the geodesics matrix here...
-          if (!isnearest[D.id]) {
-            nearestverts[vertexID].push_back(D.id);
-            isnearest[D.id] = true;
-          }
-          // check if angle is visible within the fov:
-          if ((current_angle < min_angle)) {
-            C = A;
-            A = D;
-          } else if ((current_angle > max_angle)) {
-            C = B;
-            B = D;
-          } else if (((current_angle <= max_angle) &&
-                      (current_angle >= min_angle))) {
-            // add geodesic to path map if shorter than the previous distance:
-            edge = pathmap.find(makeKey(vertexID, D.id));
-            if (edge != pathmap.end()) {
-              if ((distance < edge->second) || (edge->second < 0.0))
-                edge->second = distance;
-            } else {
-              pathmap.insert(make_pair(makeKey(vertexID, D.id), distance));
-            }
-            // push triangle to the stack:
-            stackitem.a    = A;
-            stackitem.b    = D;
-            stackitem.c    = B;
-            stackitem.idx  = current_idx;
-            stackitem.mina = min_angle;
-            stackitem.maxa = current_angle;
-            stack.push(stackitem);
-            C         = A;
-            A         = D;
-            min_angle = current_angle;
-          }
-          // this is used to find bugs within the surface (so far I've only
-          // seen problems in the fsaverage surface)
-          else {
-            // std::cout << "nan\n";
-            // fflush(stdout);
-            current_idx = -1;
-            continue;
-          }
-        }
-        // get the next triangle and repeat:
-        iC          = getIndex(triangle->vert, C.id);
-        current_idx = triangle->neighbor[iC];
-      }
-    }
-    if (vertexID % 1000 == 0)
+    ROMP_PFLB_begin
+    int const tid = omp_get_thread_num();
+    geodesicsLineOfSight(surf, maxdist, vertexID, triangles, scratch[tid],
+                         los[vertexID], nearestverts[vertexID]);
+    if (tid == 0 && vertexID % 1000 == 0)
       progressBar((float)vertexID / surf->nvertices);
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
   progressBar(1.0);
   std::cout << std::endl;
   msec = mytimer.milliseconds();
@@ -265,90 +402,235 @@ Geodesics *computeGeodesics(MRIS *surf, float maxdist) {
 
   std::cout << "computing shortest paths and non-geodesics\n";
   fflush(stdout);
-  Geodesics *geo = (Geodesics *)calloc(surf->nvertices, sizeof(Geodesics));
-  // ------ STEP 2 ------
-  // compute the shortest paths between each vertex (within given limit)
-  int vi, vj;
+  for (int t = 0; t < nthreads; t++)
+    std::fill(scratch[t].nearmark.begin(), scratch[t].nearmark.end(), -1);
+  std::vector<GeoList> paths(surf->nvertices);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 64)
+#endif
   for (int k = 0; k < surf->nvertices; k++) {
-    // set up nearest vertices reference:
-    for (unsigned int d = 0; d < nearestverts[k].size(); d++) {
-      isnearest[nearestverts[k][d]] == true;
-    }
-    for (unsigned int i = 0; i < nearestverts[k].size(); i++) {
-      vi   = nearestverts[k][i];
-      edge = pathmap.find(makeKey(k, vi));
-      if ((vi == k) || (edge != pathmap.end()))
-        continue;
-
-      for (unsigned int j = 0; j < nearestverts[k].size(); j++) {
-        vj = nearestverts[k][j];
-        if ((vi == vj) || (vj == k))
-          continue;
-        // retrieve distance from k to i:
-        edge = pathmap.find(makeKey(k, vj));
-        if (edge == pathmap.end())
-          continue;
-        distance = edge->second;
-        // retrieve distance from j to k:
-        edge = pathmap.find(makeKey(vj, vi));
-        if (edge == pathmap.end())
-          continue;
-        distance += edge->second;
-        // retrieve distance from i to j:
-        edge = pathmap.find(makeKey(k, vi));
-        if ((edge == pathmap.end()) && (distance < maxdist))
-          pathmap.insert(make_pair(makeKey(k, vi), distance));
-        else if (distance < edge->second)
-          edge->second = distance;
-      }
-      // search for vertices that are within distance limits
-      // but weren't discovered by the triangle chain
-      edge = pathmap.find(makeKey(k, vi));
-      if (edge != pathmap.end()) {
-        for (int side = 0; side < surf->vertices_topology[vi].vnum; side++) {
-          if (!isnearest[surf->vertices_topology[vi].v[side]]) {
-            distance = edge->second + 0.5;
-            if (distance < maxdist) {
-              isnearest[surf->vertices_topology[vi].v[side]] = true;
-              nearestverts[k].push_back(surf->vertices_topology[vi].v[side]);
-            }
-          }
-        }
-      }
-    }
-    geo[k].vnum = 0;
-    // geo[k].v = (int*) calloc(nearestverts[k].size(), sizeof(int));
-    // geo[k].dist = (float*) calloc(nearestverts[k].size(), sizeof(float));
-    for (unsigned int d = 0; d < nearestverts[k].size(); d++) {
-      edge = pathmap.find(makeKey(k, nearestverts[k][d]));
-      if (edge != pathmap.end()) {
-        geo[k].v[geo[k].vnum]    = nearestverts[k][d];
-        geo[k].dist[geo[k].vnum] = edge->second;
-        geo[k].vnum += 1;
-        if (geo[k].vnum > MAX_GEODESICS) {
-          std::cerr
-              << "error: too many neighbors, try a smaller max distance\n";
-          fflush(stdout);
-          exit(1);
-        }
-      }
-      isnearest[nearestverts[k][d]] == false;
-    }
-
-    if (k % 100 == 0) {
+    ROMP_PFLB_begin
+    int const tid = omp_get_thread_num();
+    geodesicsShortestPaths(surf, maxdist, k, los, nearestverts[k],
+                           scratch[tid], paths[k]);
+    if (tid == 0 && k % 100 == 0)
       progressBar((float)k / surf->nvertices);
-    }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
   progressBar(1.0);
   std::cout << std::endl;
 
+  // pack the per-vertex lists into the CSR table
+  GeodesicsCSR *geo = (GeodesicsCSR *)calloc(1, sizeof(GeodesicsCSR));
+  geo->nvertices    = surf->nvertices;
+  geo->offset = (int64_t *)calloc(surf->nvertices + 1, sizeof(int64_t));
+  for (int k = 0; k < surf->nvertices; k++)
+    geo->offset[k + 1] = geo->offset[k] + paths[k].size();
+  geo->nnbrs = geo->offset[surf->nvertices];
+  geo->v     = (int *)calloc(std::max<int64_t>(geo->nnbrs, 1), sizeof(int));
+  geo->dist  = (float *)calloc(std::max<int64_t>(geo->nnbrs, 1), sizeof(float));
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (int k = 0; k < surf->nvertices; k++) {
+    ROMP_PFLB_begin
+    int64_t const base = geo->offset[k];
+    for (unsigned int n = 0; n < paths[k].size(); n++) {
+      geo->v[base + n]    = paths[k][n].first;
+      geo->dist[base + n] = paths[k][n].second;
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
   msec = mytimer.milliseconds();
-  printf("t = %g min\n", msec / (1000.0 * 60));
+  printf("t = %g min, %ld geodesics\n", msec / (1000.0 * 60),
+         (long)geo->nnbrs);
   fflush(stdout);
 
   return geo;
 }
 
+Geodesics *computeGeodesics(MRIS *surf, float maxdist) {
+  GeodesicsCSR *csr = computeGeodesicsCSR(surf, maxdist);
+  Geodesics *   geo = geodesicsFromCSR(csr);
+  geodesicsCSRFree(&csr);
+  if (geo == NULL) {
+    std::cerr << "error: too many neighbors, try a smaller max distance\n";
+    exit(1);
+  }
+  return geo;
+}
+
+Geodesics *geodesicsFromCSR(const GeodesicsCSR *csr) {
+  for (int vtxno = 0; vtxno < csr->nvertices; vtxno++) {
+    if (csr->offset[vtxno + 1] - csr->offset[vtxno] > MAX_GEODESICS) {
+      printf("ERROR: geodesicsFromCSR: vertex %d has more than %d neighbors\n",
+             vtxno, MAX_GEODESICS);
+      return (NULL);
+    }
+  }
+  Geodesics *geo = (Geodesics *)calloc(csr->nvertices, sizeof(Geodesics));
+  for (int vtxno = 0; vtxno < csr->nvertices; vtxno++) {
+    int64_t const base = csr->offset[vtxno];
+    geo[vtxno].vnum    = csr->offset[vtxno + 1] - base;
+    memcpy(geo[vtxno].v, &csr->v[base], geo[vtxno].vnum * sizeof(int));
+    memcpy(geo[vtxno].dist, &csr->dist[base], geo[vtxno].vnum * sizeof(float));
+  }
+  return (geo);
+}
+
+GeodesicsCSR *geodesicsCSRFromGeodesics(Geodesics *geo, int nvertices) {
+  GeodesicsCSR *csr = (GeodesicsCSR *)calloc(1, sizeof(GeodesicsCSR));
+  csr->nvertices    = nvertices;
+  csr->offset       = (int64_t *)calloc(nvertices + 1, sizeof(int64_t));
+  for (int vtxno = 0; vtxno < nvertices; vtxno++)
+    csr->offset[vtxno + 1] = csr->offset[vtxno] + geo[vtxno].vnum;
+  csr->nnbrs = csr->offset[nvertices];
+  csr->v     = (int *)calloc(std::max<int64_t>(csr->nnbrs, 1), sizeof(int));
+  csr->dist  = (float *)calloc(std::max<int64_t>(csr->nnbrs, 1), sizeof(float));
+  for (int vtxno = 0; vtxno < nvertices; vtxno++) {
+    int64_t const base = csr->offset[vtxno];
+    memcpy(&csr->v[base], geo[vtxno].v, geo[vtxno].vnum * sizeof(int));
+    memcpy(&csr->dist[base], geo[vtxno].dist, geo[vtxno].vnum * sizeof(float));
+  }
+  return (csr);
+}
+
+void geodesicsCSRFree(GeodesicsCSR **pgeo) {
+  GeodesicsCSR *geo = *pgeo;
+  if (geo == NULL)
+    return;
+  if (geo->map)
+    munmap(geo->map, geo->mapsize);
+  else {
+    free(geo->offset);
+    free(geo->v);
+    free(geo->dist);
+  }
+  free(geo);
+  *pgeo = NULL;
+}
+
+// On-disk layout of geodesicsCSRWrite(): this header followed by the
+// offset[], v[] and dist[] arrays in native byte order. The header keeps the
+// 64-bit offsets 8-byte aligned so the file can be mapped and used in place.
+#define GEODESICS_CSR_MAGIC "FSGeodesicsCSR1"
+typedef struct {
+  char    magic[16];
+  int32_t byteorder; // 1 when written on a machine of the same endianness
+  int32_t nvertices;
+  int64_t nnbrs;
+  int64_t reserved[2];
+} GeodesicsCSRHeader;
+
+int geodesicsCSRWrite(const GeodesicsCSR *geo, const char *fname) {
+  GeodesicsCSRHeader hdr;
+  FILE *             fp;
+  size_t             nwritten;
+
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, GEODESICS_CSR_MAGIC, sizeof(hdr.magic));
+  hdr.byteorder = 1;
+  hdr.nvertices = geo->nvertices;
+  hdr.nnbrs     = geo->nnbrs;
+
+  fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    printf("ERROR: geodesicsCSRWrite: could not open %s\n", fname);
+    return (1);
+  }
+  nwritten = fwrite(&hdr, sizeof(hdr), 1, fp);
+  nwritten += fwrite(geo->offset, sizeof(int64_t), geo->nvertices + 1, fp);
+  nwritten += fwrite(geo->v, sizeof(int), geo->nnbrs, fp);
+  nwritten += fwrite(geo->dist, sizeof(float), geo->nnbrs, fp);
+  if (fclose(fp) != 0 ||
+      nwritten != 1 + (size_t)(geo->nvertices + 1) + 2 * (size_t)geo->nnbrs) {
+    printf("ERROR: geodesicsCSRWrite: could not write %s\n", fname);
+    return (1);
+  }
+  return (0);
+}
+
+GeodesicsCSR *geodesicsCSRRead(const char *fname) {
+  GeodesicsCSRHeader hdr;
+  struct stat        st;
+  int                fd;
+  void *             map;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    printf("ERROR: geodesicsCSRRead: could not open %s\n", fname);
+    return (NULL);
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(hdr) ||
+      read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+    close(fd);
+    printf("ERROR: %s not a geodesics file\n", fname);
+    return (NULL);
+  }
+  if (strncmp(hdr.magic, GEODESICS_CSR_MAGIC, sizeof(hdr.magic))) {
+    close(fd);
+    printf("ERROR: %s not a geodesics file\n", fname);
+    return (NULL);
+  }
+  if (hdr.byteorder != 1) {
+    close(fd);
+    printf("ERROR: %s wrong endian\n", fname);
+    return (NULL);
+  }
+  // bound the counts by the file size first so the sum cannot wrap
+  size_t const size =
+      hdr.nvertices < 0 || hdr.nnbrs < 0 || hdr.nnbrs > st.st_size
+          ? 0
+          : sizeof(hdr) + (hdr.nvertices + 1) * sizeof(int64_t) +
+                hdr.nnbrs * (sizeof(int) + sizeof(float));
+  if (size == 0 || (size_t)st.st_size != size) {
+    close(fd);
+    printf("ERROR: %s is truncated or corrupt\n", fname);
+    return (NULL);
+  }
+
+  map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("ERROR: geodesicsCSRRead: could not map %s\n", fname);
+    return (NULL);
+  }
+
+  // the rows must tile [0, nnbrs) and name vertices of this surface, or
+  // users of the mapping would index past it
+  char *         p      = (char *)map + sizeof(hdr);
+  int64_t const *offset = (int64_t *)p;
+  int const *    v      = (int *)(p + (hdr.nvertices + 1) * sizeof(int64_t));
+  int            bad    = offset[0] != 0 || offset[hdr.nvertices] != hdr.nnbrs;
+  for (int vtxno = 0; !bad && vtxno < hdr.nvertices; vtxno++)
+    bad = offset[vtxno + 1] < offset[vtxno];
+  for (int64_t n = 0; !bad && n < hdr.nnbrs; n++)
+    bad = v[n] < 0 || v[n] >= hdr.nvertices;
+  if (bad) {
+    munmap(map, size);
+    printf("ERROR: %s is truncated or corrupt\n", fname);
+    return (NULL);
+  }
+
+  GeodesicsCSR *geo = (GeodesicsCSR *)calloc(1, sizeof(GeodesicsCSR));
+  geo->nvertices    = hdr.nvertices;
+  geo->nnbrs        = hdr.nnbrs;
+  geo->offset       = (int64_t *)offset;
+  geo->v            = (int *)v;
+  p += (hdr.nvertices + 1) * sizeof(int64_t) + hdr.nnbrs * sizeof(int);
+  geo->dist    = (float *)p;
+  geo->map     = map;
+  geo->mapsize = size;
+  printf("    geodesicsCSRRead(): %s nvertices = %d, nnbrs = %ld\n", fname,
+         geo->nvertices, (long)geo->nnbrs);
+  return (geo);
+}
+
 void geodesicsWrite(Geodesics *geo, int nvertices, char *fname) {
   int   vtxno;
   FILE *fp;
@@ -469,7 +751,7 @@ int geodesicsUniquify(Geodesics *geod) {
   return (nunique);
 }
 
-static int getIndex(int *arr, int vid) {
+static int getIndex(const int *arr, int vid) {
   int idx = std::distance(arr, std::find(arr, arr + 3, vid));
   // this can be removed:
   if (idx > 2) {
@@ -513,13 +795,6 @@ static Vertex extendedPoint(Vertex A, Vertex B, float dA, float dB, float dAB) {
   return D;
 }
 
-static std::pair<int, int> makeKey(int a, int b) {
-  if (a < b)
-    return std::pair<int, int>(a, b);
-  else
-    return std::pair<int, int>(b, a);
-}
-
 static void progressBar(float progress) {
   if (!isatty(fileno(stdout)))
     return;
@@ -536,8 +811,12 @@ static void progressBar(float progress) {
   std::cout.flush();
 }
 
-MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
-               MRI *volindex, MRI *out) {
+// Smooths src with a gaussian of the given fwhm over the geodesic neighbors
+// returned by getNbrs(vtxno, &vnum, &v, &dist), shared by GeoSmooth() and
+// GeoSmoothCSR().
+template <typename GetNbrs>
+static MRI *geoSmoothWkr(MRI *src, double fwhm, MRIS *surf, GetNbrs getNbrs,
+                         MRI *volindex, MRI *out) {
   int    vtxno;
   double gvar, gstd, gf;
 
@@ -566,19 +845,28 @@ MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
 #pragma omp parallel for if_ROMP(experimental)
 #endif
       for (vtxno = 0; vtxno < surf->nvertices; vtxno++) {
-    ROMP_PFLB_begin int nthnbr, nbrvtxno, frame;
+    ROMP_PFLB_begin int nthnbr, nbrvtxno, frame, vnum, nunique;
     double              ksum, *sum, d, vkern;
-    Geodesics *         vtxgeod;
+    int const *         v;
+    float const *       dist;
+    VTXVOLINDEX *       vvi = NULL, *uvvi = NULL;
     if (vtxno % 10000 == 0)
       printf("vtxno %d\n", vtxno);
     if (surf->vertices[vtxno].ripflag)
       continue;
+    getNbrs(vtxno, &vnum, &v, &dist);
 
     // Remove replicate neighbors that have the same volume vertex no
-    if (volindex)
-      vtxgeod = VtxVolPruneGeod(geod, vtxno, volindex);
-    else
-      vtxgeod = &geod[vtxno];
+    if (volindex && vnum > 0) {
+      vvi = (VTXVOLINDEX *)calloc(sizeof(VTXVOLINDEX), vnum);
+      for (nthnbr = 0; nthnbr < vnum; nthnbr++) {
+        vvi[nthnbr].vtxno    = v[nthnbr];
+        vvi[nthnbr].dist     = dist[nthnbr];
+        vvi[nthnbr].volindex = MRIgetVoxVal(volindex, v[nthnbr], 0, 0, 0);
+      }
+      uvvi = VtxVolIndexUnique(vvi, vnum, &nunique);
+      vnum = nunique;
+    }
 
     // Set up init using self
     // vkern = surf->vertices[vtxno].area/gf; // scale by the area
@@ -588,11 +876,11 @@ MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
     for (frame = 0; frame < src->nframes; frame++)
       sum[frame] = (vkern * MRIgetVoxVal(src, vtxno, 0, 0, frame));
 
-    for (nthnbr = 0; nthnbr < vtxgeod->vnum; nthnbr++) {
-      nbrvtxno = vtxgeod->v[nthnbr];
+    for (nthnbr = 0; nthnbr < vnum; nthnbr++) {
+      nbrvtxno = uvvi ? uvvi[nthnbr].vtxno : v[nthnbr];
       if (surf->vertices[nbrvtxno].ripflag)
         continue;
-      d = vtxgeod->dist[nthnbr];
+      d = uvvi ? uvvi[nthnbr].dist : dist[nthnbr];
       // vkern = surf->vertices[nbrvtxno].area*exp(-(d*d)/(2*gvar))/gf; // scale
       // by the area
       vkern = exp(-(d * d) / (2 * gvar)) / gf;
@@ -604,10 +892,10 @@ MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
     for (frame = 0; frame < src->nframes; frame++)
       MRIsetVoxVal(out, vtxno, 0, 0, frame, (sum[frame] / ksum));
     surf->vertices[vtxno].valbak  = ksum;
-    surf->vertices[vtxno].val2bak = vtxgeod->vnum;
+    surf->vertices[vtxno].val2bak = vnum;
     free(sum);
-    if (volindex)
-      free(vtxgeod);
+    free(vvi);
+    free(uvvi);
     ROMP_PFLB_end
   } // vtxno
   ROMP_PF_end
@@ -615,6 +903,40 @@ MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
       return (out);
 }
 
+MRI *GeoSmooth(MRI *src, double fwhm, MRIS *surf, Geodesics *geod,
+               MRI *volindex, MRI *out) {
+  auto getNbrs = [geod](int vtxno, int *vnum, int const **v,
+                        float const **dist) {
+    *vnum = geod[vtxno].vnum;
+    *v    = geod[vtxno].v;
+    *dist = geod[vtxno].dist;
+  };
+  return (geoSmoothWkr(src, fwhm, surf, getNbrs, volindex, out));
+}
+
+/*!
+\fn MRI *GeoSmoothCSR(MRI *src, double fwhm, MRIS *surf,
+                      const GeodesicsCSR *geod, MRI *volindex, MRI *out)
+\brief Same as GeoSmooth() but reads the neighborhoods from a CSR table,
+e.g. one mapped by geodesicsCSRRead().
+*/
+MRI *GeoSmoothCSR(MRI *src, double fwhm, MRIS *surf, const GeodesicsCSR *geod,
+                  MRI *volindex, MRI *out) {
+  if (geod->nvertices != surf->nvertices) {
+    printf("ERROR: GeoSmoothCSR: geodesics have %d vertices, surface %d\n",
+           geod->nvertices, surf->nvertices);
+    return (NULL);
+  }
+  auto getNbrs = [geod](int vtxno, int *vnum, int const **v,
+                        float const **dist) {
+    int64_t const base = geod->offset[vtxno];
+    *vnum              = geod->offset[vtxno + 1] - base;
+    *v                 = &geod->v[base];
+    *dist              = &geod->dist[base];
+  };
+  return (geoSmoothWkr(src, fwhm, surf, getNbrs, volindex, out));
+}
+
 int GeoCount(Geodesics *geod, int nvertices) {
   int c = 0, cmax = 0, vtxno;
 
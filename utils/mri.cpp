@@ -15448,6 +15448,23 @@ MRI *MRIdistanceTransform(MRI *mri_src, MRI *mri_dist, int label,
   const int height = mri_src->height;
   const int depth  = mri_src->depth;
 
+  bool const exact =
+      mri_mask == NULL && !getenv("FREESURFER_OLD_MRIdistanceTransform") &&
+      (mri_dist == NULL ||
+       (mri_dist->width == width && mri_dist->height == height &&
+        mri_dist->depth == depth && mri_dist->type == MRI_FLOAT));
+  if (exact) {
+    // exact Euclidean distances in mm, which also honors anisotropic voxels;
+    // max_dist stays in voxels (of xsize) as before
+    float limit = max_dist;
+    if (limit <= 0)
+      limit = 2 * MAX(MAX(width, height), depth);
+    mri_dist = MRIexactDistanceTransform(mri_src, mri_dist, label,
+                                         limit * mri_src->xsize, mode);
+    mri_dist->outside_val = max_dist;
+    return mri_dist;
+  }
+
   if (mri_dist == NULL) {
     mri_dist = MRIalloc(width, height, depth, MRI_FLOAT);
     MRIcopyHeader(mri_src, mri_dist);
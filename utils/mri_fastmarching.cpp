@@ -20,7 +20,215 @@
  *
  */
 
+#include <cfloat>
+#include <vector>
+
 #include "fastmarching.h"
+#include "romp_support.h"
+
+// squared distance of voxels that have no feature voxel at all
+static const float EDT_INF = 1e30f;
+
+/*
+  1D squared distance transform of the n samples f[0..n-1], spaced h mm
+  apart, into d: the lower envelope of the parabolas rooted at the finite
+  samples (Felzenszwalb & Huttenlocher, Theory of Computing 8, 2012).
+  v and z are scratch of at least n and n+1 entries.
+*/
+static void edt1d(const float *f, float *d, int n, double h, int *v,
+                  double *z) {
+  int    k = -1;
+  double s = 0;
+  for (int q = 0; q < n; q++) {
+    if (f[q] >= EDT_INF)
+      continue;
+    double const fq = f[q] + (q * h) * (q * h);
+    while (k >= 0) {
+      double const p = v[k] * h;
+      s              = (fq - (f[v[k]] + p * p)) / (2 * h * (q - v[k]));
+      if (s > z[k])
+        break;
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = (k == 0) ? -DBL_MAX : s;
+  }
+
+  if (k < 0) {
+    for (int q = 0; q < n; q++)
+      d[q] = EDT_INF;
+    return;
+  }
+
+  z[k + 1] = DBL_MAX;
+  int j    = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[j + 1] < q * h)
+      j++;
+    double const dq = (q - v[j]) * h;
+    d[q]            = dq * dq + f[v[j]];
+  }
+}
+
+/*
+  In place separable squared Euclidean distance transform of g, which holds
+  0 at the feature voxels and EDT_INF elsewhere. Each axis is one pass of
+  independent 1D transforms, run in parallel over the lines of that axis.
+*/
+static void edt3d(std::vector<float> &g, int width, int height, int depth,
+                  double xsize, double ysize, double zsize) {
+  int const    dims[3]    = {width, height, depth};
+  double const spacing[3] = {xsize, ysize, zsize};
+  long const   strides[3] = {1, (long)width, (long)width * height};
+  long const   nvox       = (long)width * height * depth;
+
+  // per-thread line buffers, sized for the longest axis
+  int const nmax = MAX(MAX(width, height), depth);
+  struct LineScratch {
+    std::vector<float>  f, d;
+    std::vector<int>    v;
+    std::vector<double> z;
+  };
+  std::vector<LineScratch> scratch(omp_get_max_threads());
+  for (auto &sc : scratch) {
+    sc.f.resize(nmax);
+    sc.d.resize(nmax);
+    sc.v.resize(nmax);
+    sc.z.resize(nmax + 1);
+  }
+
+  for (int axis = 0; axis < 3; axis++) {
+    int const  n      = dims[axis];
+    long const stride = strides[axis];
+    long const nlines = nvox / n;
+    if (n == 1)
+      continue; // a single sample is its own transform
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+    for (long line = 0; line < nlines; line++) {
+      ROMP_PFLB_begin
+      LineScratch &sc = scratch[omp_get_thread_num()];
+      // the lines of an axis start at every voxel whose coordinate
+      // along that axis is 0
+      long const base = (line / stride) * stride * n + (line % stride);
+      for (int i = 0; i < n; i++)
+        sc.f[i] = g[base + i * stride];
+      edt1d(sc.f.data(), sc.d.data(), n, spacing[axis], sc.v.data(),
+            sc.z.data());
+      for (int i = 0; i < n; i++)
+        g[base + i * stride] = sc.d[i];
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+  }
+}
+
+/*
+  Exact replacement for the FastMarching<> pair in MRIextractDistanceMap().
+  It uses the same conventions: voxels next to the boundary are +-0.5 voxel
+  (half the smallest voxel dimension), the label is negative inside, and
+  values are clamped to +-max_distance. Distances are in units of the given
+  voxel sizes.
+*/
+static void mriExactDistanceMap(MRI *mri_src, MRI *mri_dst, int label,
+                                float max_distance, bool outside, bool inside,
+                                bool absolute, double xsize, double ysize,
+                                double zsize) {
+  int const  width  = mri_src->width;
+  int const  height = mri_src->height;
+  int const  depth  = mri_src->depth;
+  long const nvox   = (long)width * height * depth;
+
+  std::vector<unsigned char> inlabel(nvox);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (int z = 0; z < depth; z++) {
+    ROMP_PFLB_begin
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++)
+        inlabel[((long)z * height + y) * width + x] =
+            (int)round(MRIgetVoxVal(mri_src, x, y, z, 0)) == label;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // outside voxels measure to the nearest label voxel and inside voxels to
+  // the nearest non-label voxel
+  std::vector<float> dout, din;
+  if (outside) {
+    dout.resize(nvox);
+    for (long i = 0; i < nvox; i++)
+      dout[i] = inlabel[i] ? 0 : EDT_INF;
+    edt3d(dout, width, height, depth, xsize, ysize, zsize);
+  }
+  if (inside) {
+    din.resize(nvox);
+    for (long i = 0; i < nvox; i++)
+      din[i] = inlabel[i] ? EDT_INF : 0;
+    edt3d(din, width, height, depth, xsize, ysize, zsize);
+  }
+
+  double const half = 0.5 * MIN(MIN(xsize, ysize), zsize);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (int z = 0; z < depth; z++) {
+    ROMP_PFLB_begin
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++) {
+        long const i   = ((long)z * height + y) * width + x;
+        float      val = 0;
+        if (inlabel[i] && inside)
+          val = -MIN(sqrt(din[i]) - half, max_distance);
+        else if (!inlabel[i] && outside)
+          val = MIN(sqrt(dout[i]) - half, max_distance);
+        MRIFvox(mri_dst, x, y, z) = absolute ? fabs(val) : val;
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/*!
+  \fn MRI *MRIexactDistanceTransform(MRI *mri_src, MRI *mri_dst, int label,
+                                     float max_distance, int mode)
+  \brief Exact Euclidean distance in mm from the boundary of label, honoring
+  anisotropic voxel sizes. mode is one of the DTRANS_MODE_* values;
+  distances are clamped to max_distance mm (no limit if <= 0).
+*/
+MRI *MRIexactDistanceTransform(MRI *mri_src, MRI *mri_dst, int label,
+                               float max_distance, int mode) {
+  if (mri_dst == nullptr) {
+    mri_dst =
+        MRIalloc(mri_src->width, mri_src->height, mri_src->depth, MRI_FLOAT);
+    MRIcopyHeader(mri_src, mri_dst);
+  } else if (mri_dst->width != mri_src->width ||
+             mri_dst->height != mri_src->height ||
+             mri_dst->depth != mri_src->depth || mri_dst->type != MRI_FLOAT) {
+    ErrorReturn(NULL, (ERROR_BADPARM,
+                       "MRIexactDistanceTransform: mri_dst must be a float "
+                       "volume the size of mri_src"));
+  }
+
+  if (max_distance <= 0)
+    max_distance = 2 * MAX(MAX(mri_src->width * mri_src->xsize,
+                               mri_src->height * mri_src->ysize),
+                           mri_src->depth * mri_src->zsize);
+
+  bool const outside = mode != DTRANS_MODE_INSIDE;
+  bool const inside  = mode != DTRANS_MODE_OUTSIDE;
+  mriExactDistanceMap(mri_src, mri_dst, label, max_distance, outside, inside,
+                      mode == DTRANS_MODE_UNSIGNED, mri_src->xsize,
+                      mri_src->ysize, mri_src->zsize);
+  return mri_dst;
+}
 
 MRI *MRIextractDistanceMap(MRI *mri_src, MRI *mri_dst, int label,
                            float max_distance, int mode, MRI *mri_mask) {
@@ -74,6 +282,14 @@ MRI *MRIextractDistanceMap(MRI *mri_src, MRI *mri_dst, int label,
               "ERROR : incompatible structure with mri_dst:\n"
               "mri_dst->type=%d != MRI_FLOAT\n",
               mri_dst->type);
+  } else if (mri_mask == nullptr &&
+             !getenv("FREESURFER_OLD_MRIextractDistanceMap")) {
+    // without a mask the distances are plain Euclidean, so the exact
+    // separable transform gives them directly (in voxels, like below)
+    mriExactDistanceMap(mri_src, mri_dst, label, max_distance,
+                        mode == 1 || mode == 3 || mode == 4,
+                        mode == 2 || mode == 3 || mode == 4, mode == 4, 1, 1,
+                        1);
   } else {
     // set values to zero
     for (int z = 0; z < mri_dst->depth; z++)
@@ -28,6 +28,7 @@
 #include "cma.h"
 #include "diag.h"
 #include "error.h"
+#include "fft3d.h"
 #include "fftutils.h"
 #include "filter.h"
 #include "macros.h"
@@ -2530,8 +2531,173 @@ MRI *MRIstdNonzero(MRI *mri_src, MRI *mri_dst, MRI *mri_mean, int wsize) {
   return (mri_dst);
 }
 
+/* Gaussians at least this wide (FWHM in mm along the coarsest axis) are
+   applied with the FFT, which costs O(N log N) instead of O(N*klen).
+   Setting FREESURFER_OLD_MRIgaussianSmooth keeps the direct convolution
+   in MRIconvolveGaussian() and MRIgaussianSmoothNI(). */
+#define MRI_FFT_SMOOTH_MIN_FWHM 8.0
+
+static int mriUseFFTsmooth(double fwhm) {
+  return (fwhm >= MRI_FFT_SMOOTH_MIN_FWHM &&
+          getenv("FREESURFER_OLD_MRIgaussianSmooth") == NULL);
+}
+
+/*---------------------------------------------------------------------
+  mriConvolveSeparableFFT() - applies the separable kernel with taps
+  kernel[a][0..klen[a]-1] along axis a (width, height, depth) to every
+  frame of the float volume src, with the same alignment as
+  MRIconvolve1d(): out[x] = sum_i kernel[i] * in[x + i - klen/2]. Beyond
+  the edges the volume is extended by replicating the edge voxels if
+  replicate is set, otherwise with zeros. Each axis is zero padded to a
+  size with small prime factors that is large enough to keep the
+  circular convolution from wrapping around. Can be done in-place.
+  Returns NULL if the padded volume or the FFT scratch cannot be
+  allocated.
+  -------------------------------------------------------------------*/
+static MRI *mriConvolveSeparableFFT(MRI *src, MRI *dst, double *kernel[3],
+                                    int klen[3], int replicate) {
+  int               dims[3], P[3], *map[3], a, i, p, f, z, lo, hi, nxc;
+  double *          Hre[3], *Him[3];
+  float *           data;
+  const FFT3D_PLAN *plan;
+
+  dims[0] = src->width;
+  dims[1] = src->height;
+  dims[2] = src->depth;
+  for (a = 0; a < 3; a++) {
+    lo = hi = 0;
+    if (dims[a] > 1 && klen[a] > 1) {
+      lo = klen[a] / 2;
+      hi = klen[a] - 1 - lo;
+    }
+    if (replicate)
+      P[a] = FFT3DgoodSize(dims[a] + lo + hi);
+    else
+      P[a] = FFT3DgoodSize(dims[a] + MAX(lo, hi));
+
+    // source index of each padded position, -1 for zero
+    map[a] = (int *)calloc(P[a], sizeof(int));
+    for (p = 0; p < P[a]; p++) {
+      if (p < dims[a])
+        map[a][p] = p;
+      else if (replicate && p < dims[a] + hi)
+        map[a][p] = dims[a] - 1;
+      else if (replicate && p >= P[a] - lo)
+        map[a][p] = 0;
+      else
+        map[a][p] = -1;
+    }
+
+    // H[f] = sum_i kernel[i] exp(+2*pi*i*f*(i-klen/2)/P) for the
+    // correlation above; a delta if the axis is not smoothed
+    Hre[a] = (double *)calloc(P[a], sizeof(double));
+    Him[a] = (double *)calloc(P[a], sizeof(double));
+    for (f = 0; f < P[a]; f++) {
+      if (dims[a] == 1 || klen[a] < 1) {
+        Hre[a][f] = 1;
+        continue;
+      }
+      for (i = 0; i < klen[a]; i++) {
+        double ang = 2.0 * M_PI * f * (i - klen[a] / 2) / P[a];
+        Hre[a][f] += kernel[a][i] * cos(ang);
+        Him[a][f] += kernel[a][i] * sin(ang);
+      }
+    }
+  }
+
+  nxc  = P[0] / 2 + 1;
+  plan = FFT3Dplan(P[0], P[1], P[2]);
+  data = plan ? FFT3Dalloc(P[0], P[1], P[2]) : nullptr;
+  if (data) {
+    for (f = 0; f < src->nframes; f++) {
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+      for (z = 0; z < P[2]; z++) {
+        ROMP_PFLB_begin
+        int s = map[2][z];
+        for (int y = 0; y < P[1]; y++) {
+          int    r   = map[1][y];
+          float *row = data + (size_t)2 * nxc * (y + P[1] * z);
+          for (int x = 0; x < P[0]; x++) {
+            int c  = map[0][x];
+            row[x] = (c < 0 || r < 0 || s < 0)
+                         ? 0
+                         : MRIFseq_vox(src, c, r, s, f);
+          }
+        }
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+
+      if (FFT3Dforward(plan, data) != NO_ERROR)
+        break;
+
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+      for (z = 0; z < P[2]; z++) {
+        ROMP_PFLB_begin
+        for (int y = 0; y < P[1]; y++) {
+          double yzr = Hre[1][y] * Hre[2][z] - Him[1][y] * Him[2][z];
+          double yzi = Hre[1][y] * Him[2][z] + Him[1][y] * Hre[2][z];
+          float *row = data + (size_t)2 * nxc * (y + P[1] * z);
+          for (int x = 0; x < nxc; x++) {
+            double gr = yzr * Hre[0][x] - yzi * Him[0][x];
+            double gi = yzr * Him[0][x] + yzi * Hre[0][x];
+            double vr = row[2 * x], vi = row[2 * x + 1];
+            row[2 * x]     = vr * gr - vi * gi;
+            row[2 * x + 1] = vr * gi + vi * gr;
+          }
+        }
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+
+      if (FFT3Dbackward(plan, data) != NO_ERROR)
+        break;
+
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+      for (z = 0; z < dims[2]; z++) {
+        ROMP_PFLB_begin
+        for (int y = 0; y < dims[1]; y++) {
+          float *row = data + (size_t)2 * nxc * (y + P[1] * z);
+          for (int x = 0; x < dims[0]; x++)
+            MRIFseq_vox(dst, x, y, z, f) = row[x];
+        }
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+    }
+    FFT3Dfree(&data);
+    // the transforms only fail allocating their scratch; the callers then
+    // convolve directly, which an in-place frame already smoothed would spoil
+    if (f < src->nframes) {
+      if (f > 0 && dst == src)
+        ErrorExit(ERROR_NOMEMORY,
+                  "mriConvolveSeparableFFT: out of memory at frame %d", f);
+      dst = nullptr;
+    }
+  } else
+    dst = nullptr;
+
+  for (a = 0; a < 3; a++) {
+    free(map[a]);
+    free(Hre[a]);
+    free(Him[a]);
+  }
+  return (dst);
+}
+
 /*-----------------------------------------------------
-MRIconvolveGaussian() - see also MRIgaussianSmooth();
+MRIconvolveGaussian() - see also MRIgaussianSmooth(). Float volumes
+are convolved with the FFT when the kernel is wide (see
+MRI_FFT_SMOOTH_MIN_FWHM), with the same edge handling.
 ------------------------------------------------------*/
 MRI *MRIconvolveGaussian(MRI *mri_src, MRI *mri_dst, MRI *mri_gaussian) {
   // int width, height, depth;
@@ -2566,6 +2732,28 @@ MRI *MRIconvolveGaussian(MRI *mri_src, MRI *mri_dst, MRI *mri_gaussian) {
     exit(EXIT_FAILURE);
   }
 
+  if (mri_src->type == MRI_FLOAT && klen > 1) {
+    double sum = 0, var = 0, vsize, *taps[3];
+    int    klens[3] = {klen, klen, klen};
+
+    // the kernel is in voxels, so measure its width along the coarsest axis
+    taps[0] = (double *)calloc(klen, sizeof(double));
+    for (int i = 0; i < klen; i++) {
+      taps[0][i] = kernel[i];
+      sum += kernel[i];
+      var += kernel[i] * (i - klen / 2) * (i - klen / 2);
+    }
+    taps[1] = taps[2] = taps[0];
+    vsize = MAX(MAX(mri_src->xsize, mri_src->ysize), mri_src->zsize);
+    if (sum > 0 && mriUseFFTsmooth(sqrt(8 * log(2.0) * var / sum) * vsize) &&
+        mriConvolveSeparableFFT(mri_src, mri_dst, taps, klens, 1)) {
+      free(taps[0]);
+      MRIcopyHeader(mri_src, mri_dst);
+      return (mri_dst);
+    }
+    free(taps[0]);
+  }
+
   if (mri_dst == mri_src) {
     mri_tmp = mri_dst = MRIclone(mri_src, nullptr);
   } else {
@@ -6533,12 +6721,61 @@ MRI *MRI_fft_highpass(MRI *src, MRI *dst, int percent) {
   MRIfree(&src_fft);
   return (dst);
 }
+/*---------------------------------------------------------------------
+  mriGaussianSmoothNIfft() - FFT version of the smoothing and rescaling
+  done by MRIgaussianSmoothNI() on the float volume targ, in place. Each
+  axis uses the GaussianMatrix() kernel, zero outside the volume, divided
+  by the same row sum MRIgaussianSmoothNI() uses for its scale. Taps
+  below 1e-9 of the peak are dropped. Returns 0 if the padded volume
+  cannot be allocated.
+  -------------------------------------------------------------------*/
+static int mriGaussianSmoothNIfft(MRI *targ, double cstd, double rstd,
+                                  double sstd) {
+  double  std[3], *taps[3], var, S, scale;
+  int     dims[3], klen[3], a, i, h, len;
+  MRI *   out;
+
+  std[0]  = cstd / targ->xsize;
+  std[1]  = rstd / targ->ysize;
+  std[2]  = sstd / targ->zsize;
+  dims[0] = targ->width;
+  dims[1] = targ->height;
+  dims[2] = targ->depth;
+  for (a = 0; a < 3; a++) {
+    len     = dims[a];
+    taps[a] = nullptr;
+    klen[a] = 0;
+    if (std[a] <= 0 || len == 1)
+      continue;
+    var = std[a] * std[a];
+    S   = 0;
+    for (i = 0; i < len; i++)
+      S += exp(-(i - len / 2) * (i - len / 2) / (2 * var));
+    scale = 0;
+    for (i = 0; i < len; i++)
+      scale += exp(-(i - (len / 2 - 1)) * (i - (len / 2 - 1)) / (2 * var)) / S;
+    h = (int)ceil(sqrt(2 * var * log(1e9)));
+    if (h > len - 1)
+      h = len - 1;
+    klen[a] = 2 * h + 1;
+    taps[a] = (double *)calloc(klen[a], sizeof(double));
+    for (i = -h; i <= h; i++)
+      taps[a][i + h] = exp(-i * i / (2 * var)) / (S * scale);
+  }
+
+  out = mriConvolveSeparableFFT(targ, targ, taps, klen, 0);
+  for (a = 0; a < 3; a++)
+    free(taps[a]);
+  return (out != nullptr);
+}
+
 /*---------------------------------------------------------------------
   MRIgaussianSmoothNI() - performs non-isotropic gaussian spatial
   smoothing.  The standard deviation of the gaussian is std.  The mean
   is preserved (ie, sets the kernel integral to 1).  Can be done
   in-place. Handles multiple frames. See also MRIconvolveGaussian()
-  and MRImaskedGaussianSmooth().
+  and MRImaskedGaussianSmooth(). Wide kernels (see
+  MRI_FFT_SMOOTH_MIN_FWHM) are applied with the FFT when targ is float.
   -------------------------------------------------------------------*/
 MRI *MRIgaussianSmoothNI(MRI *src, double cstd, double rstd, double sstd,
                          MRI *targ) {
@@ -6582,6 +6819,11 @@ MRI *MRIgaussianSmoothNI(MRI *src, double cstd, double rstd, double sstd,
            omp_get_num_procs(), omp_get_max_threads());
 #endif
 
+  if (targ->type == MRI_FLOAT &&
+      mriUseFFTsmooth(sqrt(8 * log(2.0)) * MAX(MAX(cstd, rstd), sstd)) &&
+      mriGaussianSmoothNIfft(targ, cstd, rstd, sstd))
+    return (targ);
+
   /* -----------------Smooth the columns -----------------------------*/
   if (cstd > 0) {
     G = GaussianMatrix(src->width, cstd / src->xsize, 1, nullptr);
@@ -29,6 +29,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
 #include "box.h"
 #include "ctrpoints.h"
 #include "diag.h"
@@ -42,6 +47,7 @@
 #include "numerics.h"
 #include "proto.h"
 #include "region.h"
+#include "romp_support.h"
 #include "talairachex.h"
 
 /*-----------------------------------------------------
@@ -2492,6 +2498,523 @@ static MRI *mriSoapBubbleFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,
   return (mri_dst);
 }
 
+/*-----------------------------------------------------
+  Multigrid-preconditioned solver for the soap bubble problem.
+
+  The fixed point of the soap bubble iterations is the discrete harmonic
+  function of the 27-neighbor averaging stencil (with the same clamped
+  boundary handling), constrained to the source values at the control
+  points. Instead of relaxing towards it with hundreds of Jacobi sweeps this
+  solves A u = 0 on the free voxels with conjugate gradients preconditioned
+  by one V-cycle on a hierarchy of 2x2x2 coarsened grids. The V-cycle uses
+  8-color Gauss-Seidel smoothing (no two voxels of one color are neighbors,
+  so each color is updated in parallel across z slabs), trilinear
+  prolongation and its transpose as restriction, and treats a coarse voxel
+  as fixed if any of its children is.
+
+  The coarse levels rediscretize the stencil rather than forming the
+  Galerkin product P'AP (a 125-point stencil per coarse voxel), so the
+  V-cycle is only close to a symmetric positive definite preconditioner,
+  not guaranteed to be one. The conjugate gradients watch for that: if the
+  preconditioned residual stops being a descent direction or the
+  iterations don't converge, they restart from the current estimate with
+  the diagonal of A as preconditioner, which is positive definite whenever
+  A is, and run until converged.
+  ------------------------------------------------------*/
+#define SOAP_MG_MIN_SIZE      2
+#define SOAP_MG_MAX_LEVELS    10
+#define SOAP_MG_MAX_ITERATIONS 100
+#define SOAP_MG_JACOBI_ITERATIONS 10000
+#define SOAP_MG_SMOOTH_STEPS  2
+#define SOAP_MG_COARSE_STEPS  50
+
+typedef struct {
+  int                        width, height, depth;
+  float *                    u, *f, *r; // solution, right-hand side, residual
+  std::vector<float>         storage;
+  std::vector<unsigned char> fixed; // Dirichlet voxels
+} SOAP_MG_LEVEL;
+
+#define SOAP_MG_INDEX(l, x, y, z)                                              \
+  (((size_t)(z) * (l)->height + (y)) * (l)->width + (x))
+
+/* number of stencil offsets along one axis that stay at index i when
+   clamped to [0, n-1] */
+static inline int soapMGselfCount(int i, int n) {
+  return (1 + (i == 0) + (i == n - 1));
+}
+
+/* A u at a free voxel, with A u = sum over the 27 offsets k of
+   u(v) - u(clamp(v+k)), i.e. 27 times the soap bubble update */
+static inline float soapMGapply(const SOAP_MG_LEVEL *l, const float *u, int x,
+                                int y, int z) {
+  size_t       index = SOAP_MG_INDEX(l, x, y, z), sx = l->width;
+  size_t       sxy   = (size_t)l->width * l->height;
+  const float *p;
+  float        sum = 0;
+  int          xk, yk, zk, xi, yi, zi;
+
+  if (x > 0 && y > 0 && z > 0 && x < l->width - 1 && y < l->height - 1 &&
+      z < l->depth - 1) {
+    for (zk = -1; zk <= 1; zk++)
+      for (yk = -1; yk <= 1; yk++) {
+        p = u + index + zk * sxy + yk * sx;
+        sum += p[-1] + p[0] + p[1];
+      }
+    return (27 * u[index] - sum);
+  }
+  for (zk = -1; zk <= 1; zk++) {
+    zi = MIN(MAX(z + zk, 0), l->depth - 1);
+    for (yk = -1; yk <= 1; yk++) {
+      yi = MIN(MAX(y + yk, 0), l->height - 1);
+      p  = u + SOAP_MG_INDEX(l, 0, yi, zi);
+      for (xk = -1; xk <= 1; xk++) {
+        xi = MIN(MAX(x + xk, 0), l->width - 1);
+        sum += p[xi];
+      }
+    }
+  }
+  return (27 * u[index] - sum);
+}
+
+/* the diagonal of A: offsets that clamp back onto the voxel don't count */
+static inline float soapMGdiag(const SOAP_MG_LEVEL *l, int x, int y, int z) {
+  return (27 - soapMGselfCount(x, l->width) * soapMGselfCount(y, l->height) *
+                   soapMGselfCount(z, l->depth));
+}
+
+/* Gauss-Seidel sweeps on A u = f, visiting the 8 colors forwards or
+   backwards (a backward sweep is the adjoint of a forward one) */
+static void soapMGsmooth(SOAP_MG_LEVEL *l, int nsteps, int backward) {
+  int step, c;
+
+  for (step = 0; step < nsteps; step++)
+    for (c = 0; c < 8; c++) {
+      int color = backward ? 7 - c : c, z;
+
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+      for (z = (color >> 2) & 1; z < l->depth; z += 2) {
+        ROMP_PFLB_begin
+        int   x, y;
+        float diag;
+
+        for (y = (color >> 1) & 1; y < l->height; y += 2)
+          for (x = color & 1; x < l->width; x += 2) {
+            size_t index = SOAP_MG_INDEX(l, x, y, z);
+            if (l->fixed[index])
+              continue;
+            diag = soapMGdiag(l, x, y, z);
+            if (diag > 0)
+              l->u[index] +=
+                  (l->f[index] - soapMGapply(l, l->u, x, y, z)) / diag;
+          }
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+    }
+}
+
+/* l->r = f - A u on the free voxels, 0 on the fixed ones */
+static void soapMGresidual(SOAP_MG_LEVEL *l) {
+  int z;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (z = 0; z < l->depth; z++) {
+    ROMP_PFLB_begin
+    int x, y;
+
+    for (y = 0; y < l->height; y++)
+      for (x = 0; x < l->width; x++) {
+        size_t index = SOAP_MG_INDEX(l, x, y, z);
+        l->r[index] =
+            l->fixed[index] ? 0 : l->f[index] - soapMGapply(l, l->u, x, y, z);
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/* out = A in on the free voxels, 0 on the fixed ones */
+static void soapMGmultiply(SOAP_MG_LEVEL *l, const float *in, float *out) {
+  int z;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (z = 0; z < l->depth; z++) {
+    ROMP_PFLB_begin
+    int x, y;
+
+    for (y = 0; y < l->height; y++)
+      for (x = 0; x < l->width; x++) {
+        size_t index = SOAP_MG_INDEX(l, x, y, z);
+        out[index]   = l->fixed[index] ? 0 : soapMGapply(l, in, x, y, z);
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/* weight of coarse cell c in the trilinear interpolation at fine index i */
+static inline float soapMGweight(int i, int c, int ncoarse) {
+  int   nbr = MIN(MAX(i / 2 + ((i & 1) ? 1 : -1), 0), ncoarse - 1);
+  float w   = 0;
+
+  if (i / 2 == c)
+    w += 0.75f;
+  if (nbr == c)
+    w += 0.25f;
+  return (w);
+}
+
+/* coarse right-hand side: the fine residual restricted with the transpose of
+   the prolongation. Each coarse cell collects a total weight of 8, and the
+   same stencil on a grid of twice the spacing is 4 times as strong, hence
+   the scaling by 4/8. */
+static void soapMGrestrict(SOAP_MG_LEVEL *fine, SOAP_MG_LEVEL *coarse) {
+  int z;
+
+  soapMGresidual(fine);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (z = 0; z < coarse->depth; z++) {
+    ROMP_PFLB_begin
+    int   x, y, xf, yf, zf;
+    float sum, wz, wyz;
+
+    for (y = 0; y < coarse->height; y++)
+      for (x = 0; x < coarse->width; x++) {
+        size_t index     = SOAP_MG_INDEX(coarse, x, y, z);
+        coarse->u[index] = 0;
+        coarse->f[index] = 0;
+        if (coarse->fixed[index])
+          continue;
+        sum = 0;
+        for (zf = MAX(2 * z - 1, 0); zf <= MIN(2 * z + 2, fine->depth - 1);
+             zf++) {
+          wz = soapMGweight(zf, z, coarse->depth);
+          for (yf = MAX(2 * y - 1, 0); yf <= MIN(2 * y + 2, fine->height - 1);
+               yf++) {
+            wyz = wz * soapMGweight(yf, y, coarse->height);
+            for (xf = MAX(2 * x - 1, 0); xf <= MIN(2 * x + 2, fine->width - 1);
+                 xf++)
+              sum += wyz * soapMGweight(xf, x, coarse->width) *
+                     fine->r[SOAP_MG_INDEX(fine, xf, yf, zf)];
+          }
+        }
+        coarse->f[index] = 0.5f * sum;
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/* add the trilinearly interpolated coarse correction to the free fine
+   voxels */
+static void soapMGprolong(SOAP_MG_LEVEL *coarse, SOAP_MG_LEVEL *fine) {
+  int z;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (z = 0; z < fine->depth; z++) {
+    ROMP_PFLB_begin
+    int   x, y, xc[2], yc[2], zc[2], i, j, k;
+    float w[2] = {0.75f, 0.25f}, corr;
+
+    zc[0] = z / 2;
+    zc[1] = MIN(MAX(zc[0] + ((z & 1) ? 1 : -1), 0), coarse->depth - 1);
+    for (y = 0; y < fine->height; y++) {
+      yc[0] = y / 2;
+      yc[1] = MIN(MAX(yc[0] + ((y & 1) ? 1 : -1), 0), coarse->height - 1);
+      for (x = 0; x < fine->width; x++) {
+        size_t index = SOAP_MG_INDEX(fine, x, y, z);
+        if (fine->fixed[index])
+          continue;
+        xc[0] = x / 2;
+        xc[1] = MIN(MAX(xc[0] + ((x & 1) ? 1 : -1), 0), coarse->width - 1);
+        for (corr = 0, k = 0; k < 2; k++)
+          for (j = 0; j < 2; j++)
+            for (i = 0; i < 2; i++)
+              corr += w[i] * w[j] * w[k] *
+                      coarse->u[SOAP_MG_INDEX(coarse, xc[i], yc[j], zc[k])];
+        fine->u[index] += corr;
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/* one symmetric V-cycle on A u = f starting from u = 0 */
+static void soapMGvcycle(std::vector<SOAP_MG_LEVEL> &levels, size_t n) {
+  SOAP_MG_LEVEL *l = &levels[n];
+
+  if (n == 0)
+    std::fill(l->u, l->u + l->fixed.size(), 0.0f);
+  if (n == levels.size() - 1) {
+    soapMGsmooth(l, SOAP_MG_COARSE_STEPS, 0);
+    soapMGsmooth(l, SOAP_MG_COARSE_STEPS, 1);
+    return;
+  }
+  soapMGsmooth(l, SOAP_MG_SMOOTH_STEPS, 0);
+  soapMGrestrict(l, &levels[n + 1]);
+  soapMGvcycle(levels, n + 1);
+  soapMGprolong(&levels[n + 1], l);
+  soapMGsmooth(l, SOAP_MG_SMOOTH_STEPS, 1);
+}
+
+/* z = D^-1 r on the free voxels, the fallback preconditioner */
+static void soapMGjacobi(SOAP_MG_LEVEL *l, const float *r, float *z) {
+  int zv;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (zv = 0; zv < l->depth; zv++) {
+    ROMP_PFLB_begin
+    int   x, y;
+    float diag;
+
+    for (y = 0; y < l->height; y++)
+      for (x = 0; x < l->width; x++) {
+        size_t index = SOAP_MG_INDEX(l, x, y, zv);
+        diag         = soapMGdiag(l, x, y, zv);
+        z[index]     = l->fixed[index] || diag <= 0 ? 0 : r[index] / diag;
+      }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/* sum over z slabs of the dot product of a and b (and the largest
+   |a| / diag if pmax is given), added up in a fixed order so the result
+   doesn't depend on the number of threads */
+static double soapMGdot(SOAP_MG_LEVEL *l, const float *a, const float *b,
+                        float *pmax) {
+  std::vector<double> slab_dot(l->depth, 0.0);
+  std::vector<float>  slab_max(l->depth, 0.0f);
+  double              dot = 0;
+  int                 z;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (z = 0; z < l->depth; z++) {
+    ROMP_PFLB_begin
+    int    x, y;
+    double sum = 0;
+
+    for (y = 0; y < l->height; y++)
+      for (x = 0; x < l->width; x++) {
+        size_t index = SOAP_MG_INDEX(l, x, y, z);
+        if (l->fixed[index])
+          continue;
+        sum += (double)a[index] * b[index];
+        if (pmax && fabs(a[index]) > slab_max[z] * soapMGdiag(l, x, y, z))
+          slab_max[z] = fabs(a[index]) / soapMGdiag(l, x, y, z);
+      }
+    slab_dot[z] = sum;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+  if (pmax)
+    *pmax = 0;
+  for (z = 0; z < l->depth; z++) {
+    dot += slab_dot[z];
+    if (pmax)
+      *pmax = MAX(*pmax, slab_max[z]);
+  }
+  return (dot);
+}
+
+/*!
+  \fn MRI *MRIsoapBubbleMultigrid(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,
+                                  float min_change)
+  \brief Converged soap bubble interpolation of every frame of mri_src
+  between the CONTROL_MARKED voxels of mri_ctrl, i.e. what MRIsoapBubble
+  would produce with an unlimited number of iterations.
+  \param mri_src - initial values (e.g. a Voronoi diagram of the controls)
+  \param mri_ctrl - UCHAR control volume, CONTROL_MARKED voxels are fixed
+  \param mri_dst - output (may be mri_src or NULL)
+  \param min_change - stop when no voxel would change by more than this in
+  a soap bubble iteration. If <= 0, 1e-4 of the value range is used.
+*/
+MRI *MRIsoapBubbleMultigrid(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,
+                            float min_change) {
+  std::vector<SOAP_MG_LEVEL> levels;
+  std::vector<float>         x, p, q;
+  SOAP_MG_LEVEL *            fine;
+  int                        xv, yv, zv, f, iter, niter, nfixed, jacobi;
+  float                      min_val, max_val, max_change = 0;
+  double                     rz = 1, rz_old, pq, alpha;
+  size_t                     n, nvox;
+
+  if (mri_ctrl->type != MRI_UCHAR)
+    ErrorReturn(NULL, (ERROR_UNSUPPORTED,
+                       "MRIsoapBubbleMultigrid: ctrl must be UCHAR"));
+  if (mri_ctrl->width != mri_src->width ||
+      mri_ctrl->height != mri_src->height || mri_ctrl->depth != mri_src->depth)
+    ErrorReturn(NULL, (ERROR_BADPARM,
+                       "MRIsoapBubbleMultigrid: ctrl and src dimensions "
+                       "differ"));
+  if (mri_dst != mri_src)
+    mri_dst = MRIcopy(mri_src, mri_dst);
+  if (min_change <= 0) {
+    MRIvalRange(mri_src, &min_val, &max_val);
+    min_change = 1e-4 * MAX(max_val - min_val, 1e-6);
+  }
+
+  /* the grid hierarchy, coarsened until too small to be useful or until
+     every coarse voxel is fixed */
+  levels.resize(1);
+  fine         = &levels[0];
+  fine->width  = mri_src->width;
+  fine->height = mri_src->height;
+  fine->depth  = mri_src->depth;
+  nvox         = (size_t)fine->width * fine->height * fine->depth;
+  fine->fixed.resize(nvox);
+  for (nfixed = 0, zv = 0; zv < fine->depth; zv++)
+    for (yv = 0; yv < fine->height; yv++)
+      for (xv = 0; xv < fine->width; xv++) {
+        n              = SOAP_MG_INDEX(fine, xv, yv, zv);
+        fine->fixed[n] = (MRIvox(mri_ctrl, xv, yv, zv) == CONTROL_MARKED);
+        nfixed += fine->fixed[n];
+      }
+  if (nfixed == 0) {
+    ErrorPrintf(ERROR_BADPARM,
+                "MRIsoapBubbleMultigrid: no control points, nothing to do");
+    return (mri_dst);
+  }
+  while (levels.size() < SOAP_MG_MAX_LEVELS) {
+    SOAP_MG_LEVEL  next;
+    SOAP_MG_LEVEL *last = &levels.back();
+    int            xf, yf, zf, nfree = 0;
+
+    if (MIN(MIN(last->width, last->height), last->depth) < 2 * SOAP_MG_MIN_SIZE)
+      break;
+    next.width  = (last->width + 1) / 2;
+    next.height = (last->height + 1) / 2;
+    next.depth  = (last->depth + 1) / 2;
+    next.fixed.assign((size_t)next.width * next.height * next.depth, 0);
+    for (zf = 0; zf < last->depth; zf++)
+      for (yf = 0; yf < last->height; yf++)
+        for (xf = 0; xf < last->width; xf++)
+          if (last->fixed[SOAP_MG_INDEX(last, xf, yf, zf)])
+            next.fixed[SOAP_MG_INDEX(&next, xf / 2, yf / 2, zf / 2)] = 1;
+    for (n = 0; n < next.fixed.size(); n++)
+      nfree += (next.fixed[n] == 0);
+    if (nfree == 0)
+      break;
+    levels.push_back(std::move(next));
+  }
+  /* u, f and r of every level share one allocation. On the finest level f is
+     the conjugate gradient residual and u the preconditioned one. */
+  for (n = 0; n < levels.size(); n++) {
+    SOAP_MG_LEVEL *l = &levels[n];
+    size_t         size = l->fixed.size();
+
+    l->storage.assign(3 * size, 0.0f);
+    l->u = l->storage.data();
+    l->f = l->u + size;
+    l->r = l->f + size;
+  }
+  fine = &levels[0];
+  x.resize(nvox);
+  p.resize(nvox);
+  q.resize(nvox);
+
+  for (f = 0; f < mri_dst->nframes; f++) {
+    float *r = fine->f, *z = fine->u;
+
+    for (zv = 0; zv < fine->depth; zv++)
+      for (yv = 0; yv < fine->height; yv++)
+        for (xv = 0; xv < fine->width; xv++)
+          x[SOAP_MG_INDEX(fine, xv, yv, zv)] =
+              MRIgetVoxVal(mri_dst, xv, yv, zv, f);
+
+    // preconditioned conjugate gradients on A x = 0 with x fixed at
+    // controls, restarted with the Jacobi preconditioner if the V-cycle
+    // doesn't behave as a positive definite one
+    soapMGmultiply(fine, x.data(), r);
+    for (n = 0; n < nvox; n++)
+      r[n] = -r[n];
+    soapMGdot(fine, r, r, &max_change);
+    for (jacobi = niter = 0; jacobi < 2; jacobi++) {
+      int const max_iter =
+          jacobi ? SOAP_MG_JACOBI_ITERATIONS : SOAP_MG_MAX_ITERATIONS;
+
+      for (iter = 0; iter < max_iter; iter++, niter++) {
+        if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON)
+          printf("soap bubble multigrid frame %d, iteration %d: max change "
+                 "%f\n",
+                 f, niter, max_change);
+        if (max_change < min_change)
+          break;
+        if (jacobi)
+          soapMGjacobi(fine, r, z);
+        else
+          soapMGvcycle(levels, 0); // z = B r
+        rz_old = rz;
+        rz     = soapMGdot(fine, r, z, NULL);
+        for (n = 0; n < nvox; n++)
+          p[n] = iter == 0 ? z[n] : z[n] + (float)(rz / rz_old) * p[n];
+        soapMGmultiply(fine, p.data(), q.data());
+        pq = soapMGdot(fine, p.data(), q.data(), NULL);
+        if (!(rz > 0 && pq > 0 && std::isfinite(rz / pq)))
+          break; // not a descent direction, x and r are left as they were
+        alpha = rz / pq;
+        for (n = 0; n < nvox; n++)
+          if (!fine->fixed[n]) {
+            x[n] += alpha * p[n];
+            r[n] -= alpha * q[n];
+          }
+        soapMGdot(fine, r, r, &max_change);
+      }
+      if (max_change < min_change)
+        break;
+      if (!jacobi && (Gdiag & DIAG_SHOW))
+        printf("soap bubble multigrid frame %d: V-cycle preconditioner "
+               "failed after %d iterations, continuing with Jacobi\n",
+               f, iter);
+      // restart from the true residual, free of the recurrence's drift
+      soapMGmultiply(fine, x.data(), r);
+      for (n = 0; n < nvox; n++)
+        r[n] = -r[n];
+      soapMGdot(fine, r, r, &max_change);
+    }
+    if (max_change >= min_change)
+      ErrorPrintf(ERROR_BADPARM,
+                  "MRIsoapBubbleMultigrid: frame %d did not converge, max "
+                  "change %f",
+                  f, max_change);
+    if (Gdiag & DIAG_SHOW)
+      printf("soap bubble multigrid frame %d: %d iterations, %d levels, max "
+             "change %f\n",
+             f, niter, (int)levels.size(), max_change);
+
+    for (zv = 0; zv < fine->depth; zv++)
+      for (yv = 0; yv < fine->height; yv++)
+        for (xv = 0; xv < fine->width; xv++)
+          MRIsetVoxVal(mri_dst, xv, yv, zv, f,
+                       x[SOAP_MG_INDEX(fine, xv, yv, zv)]);
+  }
+
+  return (mri_dst);
+}
+
 /*-----------------------------------------------------
   Parameters:
 
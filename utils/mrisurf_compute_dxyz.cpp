@@ -335,70 +335,88 @@ int mrisComputeRepulsiveRatioTerm(MRI_SURFACE *mris, double l_repulse,
 #define RMIN 1
 #define RMAX 5
 
-int mrisComputeNonlinearSpringTerm(MRI_SURFACE *mris, double l_nlspring,
-                                   INTEGRATION_PARMS *parms) {
-  int    vno, n;
-  double area_scale, sse_spring, E, F, f, rmin, rmax;
-  float  dx, dy, dz, nc, r, lsq, mean_vdist;
-
-  if (FZERO(parms->l_nlspring)) {
-    return (NO_ERROR);
+/* per-vertex part of the nonlinear spring term, lsq is the square of the
+   mean vertex spacing and F, E the constants derived from rmin and rmax */
+static void vertexComputeNonlinearSpringTerm(MRIS *mris, int vno, float *pdx,
+                                             float *pdy, float *pdz,
+                                             double l_nlspring, float lsq,
+                                             double F, double E,
+                                             double rmin) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  int                          n;
+  double                       f;
+  float                        dx, dy, dz, nc, r;
+
+  if (v->ripflag) {
+    return;
   }
 
-#if METRIC_SCALE
-  if (mris->patch) {
-    area_scale = 1.0;
-  } else {
-    area_scale = mris->orig_area / mris->total_area;
+  for (n = 0; n < vt->vnum; n++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[n]];
+    dx                     = vn->x - v->x;
+    dy                     = vn->y - v->y;
+    dz                     = vn->z - v->z;
+    //      lsq = dx*dx + dy*dy + dz*dz ;
+    nc = dx * v->nx + dy * v->ny + dz * v->nz;
+    dx = nc * v->nx;
+    dy = nc * v->ny;
+    dz = nc * v->nz; // sn
+    r  = lsq / fabs(2.0 * nc);
+    if (r < rmin) {
+      DiagBreak();
+    }
+    f = nc * (1 + tanh(F * (1.0 / r - E))) / 2.0;
+    if (vno == Gdiag_no)
+      printf("l_nlspring: f = %2.3f (r = %2.2f), dx = (%2.2f, %2.2f, %2.2f)\n",
+             f, r, v->nx * f * l_nlspring, v->ny * f * l_nlspring,
+             v->nz * f * l_nlspring);
+    *pdx += v->nx * f * l_nlspring;
+    *pdy += v->ny * f * l_nlspring;
+    *pdz += v->nz * f * l_nlspring;
   }
-#else
-  area_scale = 1.0;
-#endif
+}
 
-  mean_vdist = MRIScomputeVertexSpacingStats(mris, NULL, NULL, NULL, NULL, NULL,
-                                             CURRENT_VERTICES);
-  lsq        = mean_vdist * mean_vdist;
+/* constants of the nonlinear spring term, see mrisComputeNonlinearSpringTerm */
+static int mrisNonlinearSpringConstants(MRIS *mris, INTEGRATION_PARMS *parms,
+                                        float *plsq, double *pF, double *pE) {
+  float mean_vdist;
 
-  rmax = parms->rmax;
-  rmin = parms->rmin;
-  if (FZERO(rmin) || FZERO(rmax))
+  if (FZERO(parms->rmin) || FZERO(parms->rmax))
     ErrorReturn(
         ERROR_BADPARM,
         (ERROR_BADPARM, "mrisComputeNonlinearSpringTerm: rmin or rmax = 0!"));
 
-  F = 6.0 / (1.0 / rmin - 1.0 / rmax);
-  E = (1.0 / rmin + 1.0 / rmax) / 2;
-  for (sse_spring = 0.0, vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX *const                v  = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
+  mean_vdist = MRIScomputeVertexSpacingStats(mris, NULL, NULL, NULL, NULL, NULL,
+                                             CURRENT_VERTICES);
+  *plsq      = mean_vdist * mean_vdist;
+  *pF        = 6.0 / (1.0 / parms->rmin - 1.0 / parms->rmax);
+  *pE        = (1.0 / parms->rmin + 1.0 / parms->rmax) / 2;
+  return (NO_ERROR);
+}
 
-    for (n = 0; n < vt->vnum; n++) {
-      VERTEX const *const vn = &mris->vertices[vt->v[n]];
-      dx                     = vn->x - v->x;
-      dy                     = vn->y - v->y;
-      dz                     = vn->z - v->z;
-      //      lsq = dx*dx + dy*dy + dz*dz ;
-      nc = dx * v->nx + dy * v->ny + dz * v->nz;
-      dx = nc * v->nx;
-      dy = nc * v->ny;
-      dz = nc * v->nz; // sn
-      r  = lsq / fabs(2.0 * nc);
-      if (r < rmin) {
-        DiagBreak();
-      }
-      f = nc * (1 + tanh(F * (1.0 / r - E))) / 2.0;
-      if (vno == Gdiag_no)
-        printf(
-            "l_nlspring: f = %2.3f (r = %2.2f), dx = (%2.2f, %2.2f, %2.2f)\n",
-            f, r, v->nx * f * l_nlspring, v->ny * f * l_nlspring,
-            v->nz * f * l_nlspring);
-      v->dx += v->nx * f * l_nlspring;
-      v->dy += v->ny * f * l_nlspring;
-      v->dz += v->nz * f * l_nlspring;
-    }
+int mrisComputeNonlinearSpringTerm(MRI_SURFACE *mris, double l_nlspring,
+                                   INTEGRATION_PARMS *parms) {
+  int    vno;
+  double E, F;
+  float  lsq;
+
+  if (FZERO(parms->l_nlspring)) {
+    return (NO_ERROR);
+  }
+
+  if (mrisNonlinearSpringConstants(mris, parms, &lsq, &F, &E) != NO_ERROR)
+    return (ERROR_BADPARM);
+
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX *const v  = &mris->vertices[vno];
+    float         dx = 0, dy = 0, dz = 0;
+
+    vertexComputeNonlinearSpringTerm(mris, vno, &dx, &dy, &dz, l_nlspring, lsq,
+                                     F, E, parms->rmin);
+    v->dx += dx;
+    v->dy += dy;
+    v->dz += dz;
   }
   return (NO_ERROR);
 }
@@ -1036,70 +1054,90 @@ int mrisComputeWhichSurfaceRepulsionTerm(MRI_SURFACE *mris, double l_repulse,
 
   name x y z
   ------------------------------------------------------*/
-int mrisComputeSpringTerm(MRI_SURFACE *mris, double l_spring) {
-  int   vno, n, m;
-  float sx, sy, sz, x, y, z, dist_scale;
-
-  if (FZERO(l_spring)) {
-    return (NO_ERROR);
-  }
-
+/* scale of the spring terms, see METRIC_SCALE */
+static float mrisSpringDistScale(MRIS *mris) {
 #if METRIC_SCALE
   if (mris->patch) {
-    dist_scale = 1.0;
+    return (1.0);
   } else {
-    dist_scale = sqrt(mris->orig_area / mris->total_area);
+    return (sqrt(mris->orig_area / mris->total_area));
   }
 #else
-  dist_scale = 1.0;
+  return (1.0);
 #endif
-  for (vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX *const                v  = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
+}
 
-    if (v->border && !v->neg) {
-      continue;
-    }
+static void vertexComputeSpringTerm(MRIS *mris, int vno, float *dx, float *dy,
+                                    float *dz, double l_spring,
+                                    float dist_scale) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  int                          n, m;
+  float                        sx, sy, sz, x, y, z;
 
-    x = v->x;
-    y = v->y;
-    z = v->z;
+  if (v->ripflag) {
+    return;
+  }
+  if (vno == Gdiag_no) {
+    DiagBreak();
+  }
 
-    sx = sy = sz = 0.0;
-    n            = 0;
-    for (m = 0; m < vt->vnum; m++) {
-      VERTEX const *const vn = &mris->vertices[vt->v[m]];
-      if (!vn->ripflag) {
-        sx += vn->x - x;
-        sy += vn->y - y;
-        sz += vn->z - z;
-        n++;
-      }
+  if (v->border && !v->neg) {
+    return;
+  }
+
+  x = v->x;
+  y = v->y;
+  z = v->z;
+
+  sx = sy = sz = 0.0;
+  n            = 0;
+  for (m = 0; m < vt->vnum; m++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[m]];
+    if (!vn->ripflag) {
+      sx += vn->x - x;
+      sy += vn->y - y;
+      sz += vn->z - z;
+      n++;
     }
+  }
 #if 0
     n = 4 ;  /* avg # of nearest neighbors */
 #endif
-    if (n > 0) {
-      sx = dist_scale * sx / n;
-      sy = dist_scale * sy / n;
-      sz = dist_scale * sz / n;
-    }
+  if (n > 0) {
+    sx = dist_scale * sx / n;
+    sy = dist_scale * sy / n;
+    sz = dist_scale * sz / n;
+  }
 
-    sx *= l_spring;
-    sy *= l_spring;
-    sz *= l_spring;
-    v->dx += sx;
-    v->dy += sy;
-    v->dz += sz;
-    if (vno == Gdiag_no)
-      fprintf(stdout, "v %d spring term:         (%2.3f, %2.3f, %2.3f)\n", vno,
-              sx, sy, sz);
+  sx *= l_spring;
+  sy *= l_spring;
+  sz *= l_spring;
+  *dx = sx;
+  *dy = sy;
+  *dz = sz;
+  if (vno == Gdiag_no)
+    fprintf(stdout, "v %d spring term:         (%2.3f, %2.3f, %2.3f)\n", vno,
+            sx, sy, sz);
+}
+
+int mrisComputeSpringTerm(MRI_SURFACE *mris, double l_spring) {
+  int   vno;
+  float dist_scale;
+
+  if (FZERO(l_spring)) {
+    return (NO_ERROR);
+  }
+
+  dist_scale = mrisSpringDistScale(mris);
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX *const v  = &mris->vertices[vno];
+    float         dx = 0, dy = 0, dz = 0;
+
+    vertexComputeSpringTerm(mris, vno, &dx, &dy, &dz, l_spring, dist_scale);
+    v->dx += dx;
+    v->dy += dy;
+    v->dz += dz;
   }
 
   return (NO_ERROR);
@@ -1116,66 +1154,79 @@ int mrisComputeSpringTerm(MRI_SURFACE *mris, double l_spring) {
   has the original (i.e. after
   global rotational alignment) spherical coordinates in the TMP2_VERTICES
   ------------------------------------------------------*/
-int mrisComputeLaplacianTerm(MRI_SURFACE *mris, double l_lap) {
-  int   vno, n, m;
+static void vertexComputeLaplacianTerm(MRIS *mris, int vno, float *pdx,
+                                       float *pdy, float *pdz, double l_lap) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  int                          n, m;
   float x, y, z, vx, vy, vz, vnx, vny, vnz, dx, dy, dz;
 
-  if (FZERO(l_lap)) {
-    return (NO_ERROR);
+  if (v->ripflag) {
+    return;
+  }
+  if (vno == Gdiag_no) {
+    DiagBreak();
   }
 
-  for (vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX *const                v  = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
+  if (v->border && !v->neg) {
+    return;
+  }
 
-    if (v->border && !v->neg) {
-      continue;
+  x = v->x;
+  y = v->y;
+  z = v->z;
+
+  n  = 0;
+  vx = v->x - v->t2x;
+  vy = v->y - v->t2y;
+  vz = v->z - v->t2z;
+  dx = dy = dz = 0.0f;
+  for (m = 0; m < vt->vnum; m++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[m]];
+    if (!vn->ripflag) {
+      vnx = vn->x - vn->t2x;
+      vny = vn->y - vn->t2y;
+      vnz = vn->z - vn->t2z;
+      dx += (vnx - vx);
+      dy += (vny - vy);
+      dz += (vnz - vz);
+      if ((x == Gx && y == Gy && z == Gz) && (Gdiag & DIAG_SHOW) &&
+          DIAG_VERBOSE_ON)
+        printf("\tvertex %d: V=(%2.2f,%2.2f,%2.2f), "
+               "DX=(%2.2f,%2.2f,%2.2f)\n",
+               vno, vnx, vny, vnz, vnx - vx, vny - vy, vnz - vz);
+      n++;
     }
+  }
+  if (n > 0) {
+    dx = dx * l_lap / n;
+    dy = dy * l_lap / n;
+    dz = dz * l_lap / n;
+  }
 
-    x = v->x;
-    y = v->y;
-    z = v->z;
+  *pdx = dx;
+  *pdy = dy;
+  *pdz = dz;
+  if (vno == Gdiag_no) {
+    printf("l_lap: v %d: DX=(%2.2f,%2.2f,%2.2f)\n", vno, dx, dy, dz);
+  }
+}
 
-    n  = 0;
-    vx = v->x - v->t2x;
-    vy = v->y - v->t2y;
-    vz = v->z - v->t2z;
-    dx = dy = dz = 0.0f;
-    for (m = 0; m < vt->vnum; m++) {
-      VERTEX const *const vn = &mris->vertices[vt->v[m]];
-      if (!vn->ripflag) {
-        vnx = vn->x - vn->t2x;
-        vny = vn->y - vn->t2y;
-        vnz = vn->z - vn->t2z;
-        dx += (vnx - vx);
-        dy += (vny - vy);
-        dz += (vnz - vz);
-        if ((x == Gx && y == Gy && z == Gz) && (Gdiag & DIAG_SHOW) &&
-            DIAG_VERBOSE_ON)
-          printf("\tvertex %d: V=(%2.2f,%2.2f,%2.2f), "
-                 "DX=(%2.2f,%2.2f,%2.2f)\n",
-                 vno, vnx, vny, vnz, vnx - vx, vny - vy, vnz - vz);
-        n++;
-      }
-    }
-    if (n > 0) {
-      dx = dx * l_lap / n;
-      dy = dy * l_lap / n;
-      dz = dz * l_lap / n;
-    }
+int mrisComputeLaplacianTerm(MRI_SURFACE *mris, double l_lap) {
+  int vno;
 
+  if (FZERO(l_lap)) {
+    return (NO_ERROR);
+  }
+
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX *const v  = &mris->vertices[vno];
+    float         dx = 0, dy = 0, dz = 0;
+
+    vertexComputeLaplacianTerm(mris, vno, &dx, &dy, &dz, l_lap);
     v->dx += dx;
     v->dy += dy;
     v->dz += dz;
-    if (vno == Gdiag_no) {
-      printf("l_lap: v %d: DX=(%2.2f,%2.2f,%2.2f)\n", vno, dx, dy, dz);
-    }
   }
 
   return (NO_ERROR);
@@ -1294,6 +1345,59 @@ int mrisComputeNormalizedSpringTerm(MRIS *mris, double const l_spring) {
       return (NO_ERROR);
 }
 
+/* per-vertex part of the convexity term, added into the gradient itself */
+static void vertexComputeConvexityTerm(MRIS *mris, int vno, double l_convex) {
+  VERTEX_TOPOLOGY const *const vertext = &mris->vertices_topology[vno];
+  VERTEX *const                vertex  = &mris->vertices[vno];
+  int                          n, m;
+  float                        sx, sy, sz, nx, ny, nz, nc, x, y, z;
+
+  if (vertex->ripflag) {
+    return;
+  }
+  if (vno == Gdiag_no) {
+    DiagBreak();
+  }
+
+  nx = vertex->nx;
+  ny = vertex->ny;
+  nz = vertex->nz;
+  x  = vertex->x;
+  y  = vertex->y;
+  z  = vertex->z;
+
+  sx = sy = sz = 0.0;
+  n            = 0;
+  for (m = 0; m < vertext->vnum; m++) {
+    VERTEX const *const vn = &mris->vertices[vertext->v[m]];
+    if (!vn->ripflag) {
+      sx += vn->x - x;
+      sy += vn->y - y;
+      sz += vn->z - z;
+      n++;
+    }
+  }
+  if (n > 0) {
+    sx = sx / n;
+    sy = sy / n;
+    sz = sz / n;
+  }
+  nc = sx * nx + sy * ny + sz * nz; /* projection onto normal */
+  if (nc < 0) {
+    nc = 0;
+  }
+  sx = nc * nx; /* move in normal direction */
+  sy = nc * ny;
+  sz = nc * nz;
+
+  vertex->dx += l_convex * sx;
+  vertex->dy += l_convex * sy;
+  vertex->dz += l_convex * sz;
+  if (vno == Gdiag_no)
+    fprintf(stdout, "v %d convexity term: (%2.3f, %2.3f, %2.3f)\n", vno,
+            l_convex * sx, l_convex * sy, l_convex * sz);
+}
+
 /*-----------------------------------------------------
   Parameters:
 
@@ -1315,65 +1419,14 @@ int mrisComputeConvexityTerm(MRI_SURFACE *mris, double l_convex) {
 #ifdef HAVE_OPENMP
 #pragma omp parallel for if_ROMP(experimental)
 #endif
-      for (vno = 0; vno < mris->nvertices; vno++) {
+  for (vno = 0; vno < mris->nvertices; vno++) {
     ROMP_PFLB_begin
-
-        int n,
-        m;
-    float sx, sy, sz, nx, ny, nz, nc, x, y, z;
-
-    VERTEX_TOPOLOGY const *const vertext = &mris->vertices_topology[vno];
-    VERTEX *const                vertex  = &mris->vertices[vno];
-    if (vertex->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-
-    nx = vertex->nx;
-    ny = vertex->ny;
-    nz = vertex->nz;
-    x  = vertex->x;
-    y  = vertex->y;
-    z  = vertex->z;
-
-    sx = sy = sz = 0.0;
-    n            = 0;
-    for (m = 0; m < vertext->vnum; m++) {
-      VERTEX const *const vn = &mris->vertices[vertext->v[m]];
-      if (!vn->ripflag) {
-        sx += vn->x - x;
-        sy += vn->y - y;
-        sz += vn->z - z;
-        n++;
-      }
-    }
-    if (n > 0) {
-      sx = sx / n;
-      sy = sy / n;
-      sz = sz / n;
-    }
-    nc = sx * nx + sy * ny + sz * nz; /* projection onto normal */
-    if (nc < 0) {
-      nc = 0;
-    }
-    sx = nc * nx; /* move in normal direction */
-    sy = nc * ny;
-    sz = nc * nz;
-
-    vertex->dx += l_convex * sx;
-    vertex->dy += l_convex * sy;
-    vertex->dz += l_convex * sz;
-    if (vno == Gdiag_no)
-      fprintf(stdout, "v %d convexity term: (%2.3f, %2.3f, %2.3f)\n", vno,
-              l_convex * sx, l_convex * sy, l_convex * sz);
-
+    vertexComputeConvexityTerm(mris, vno, l_convex);
     ROMP_PFLB_end
   }
   ROMP_PF_end
 
-      return (NO_ERROR);
+  return (NO_ERROR);
 }
 
 /**
@@ -1504,65 +1557,528 @@ void mrisComputeTangentialSpringTerm(MRIS *mris, double l_spring) {
   }
 }
 
+static void vertexComputeNonlinearTangentialSpringTerm(MRIS *mris, int vno,
+                                                      float *pdx, float *pdy,
+                                                      float *pdz,
+                                                      double l_spring,
+                                                      double min_dist) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  int                          m, n;
+  float                        sx, sy, sz, x, y, z, dx, dy, dz;
+  double                       d, scale;
+
+  if (v->ripflag) {
+    return;
+  }
+  if (vno == Gdiag_no) {
+    DiagBreak();
+  }
+
+  x = v->x;
+  y = v->y;
+  z = v->z;
+
+  sx = sy = sz = 0.0;
+  for (dx = dy = dz = 0.0, n = m = 0; m < vt->vnum; m++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[m]];
+    if (!vn->ripflag) {
+      sx = x - vn->x;
+      sy = y - vn->y;
+      sz = z - vn->z; // move away from nbr
+      d  = sqrt(sx * sx + sy * sy + sz * sz);
+      if (d < min_dist) {
+        scale = (min_dist - d) / min_dist;
+        d     = scale * (v->e1x * sx + v->e1y * sy + v->e1z * sz);
+        dx += v->e1x * d;
+        dy += v->e1y * d;
+        dz += v->e1z * d;
+        d = scale * (v->e2x * sx + v->e2y * sy + v->e2z * sz);
+        dx += v->e2x * d;
+        dy += v->e2y * d;
+        dz += v->e2z * d;
+        if (vno == Gdiag_no) {
+          DiagBreak();
+        }
+        n++;
+      }
+    }
+  }
+  dx *= l_spring;
+  dy *= l_spring;
+  dz *= l_spring;
+  if (vno == Gdiag_no && n > 0)
+    printf("v %d nonlinear spring tangent term: (%2.3f, %2.3f, %2.3f)\n", vno,
+           dx, dy, dz);
+  *pdx = dx;
+  *pdy = dy;
+  *pdz = dz;
+}
+
 int mrisComputeNonlinearTangentialSpringTerm(MRI_SURFACE *mris, double l_spring,
                                              double min_dist) {
-  int    vno, m, n;
-  float  sx, sy, sz, x, y, z, dx, dy, dz;
-  double d, scale;
+  int vno;
 
   if (FZERO(l_spring)) {
     return (NO_ERROR);
   }
 
   for (vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX *const                v  = &mris->vertices[vno];
-    if (v->ripflag) {
+    VERTEX *const v  = &mris->vertices[vno];
+    float         dx = 0, dy = 0, dz = 0;
+
+    vertexComputeNonlinearTangentialSpringTerm(mris, vno, &dx, &dy, &dz,
+                                               l_spring, min_dist);
+    v->dx += dx;
+    v->dy += dy;
+    v->dz += dz;
+  }
+
+  return (NO_ERROR);
+}
+
+/* per-vertex part of the distance term, scale being the metric scale and
+   norm 1/avg_nbrs */
+static void vertexComputeDistanceTerm(MRIS *mris, int vno, float *pdx,
+                                      float *pdy, float *pdz, float l_dist,
+                                      float scale, float norm) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  float                        sx, sy, sz, yx, yy, yz, d0, dt, delta, len, nc;
+  int                          n;
+
+  if (v->ripflag || vt->vtotal <= 0)
+    return;
+
+  for (sx = sy = sz = 0.0, n = 0; n < vt->vtotal; n++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[n]];
+    if (vn->ripflag)
+      continue;
+
+    float const dist_orig_n = !v->dist_orig ? 0.0 : v->dist_orig[n];
+
+    d0    = dist_orig_n / scale;
+    dt    = v->dist[n];
+    delta = dt - d0;
+    yx    = vn->x - v->x;
+    yy    = vn->y - v->y;
+    yz    = vn->z - v->z;
+    if (DZERO(yx * yx + yy * yy + yz * yz))
+      continue;
+
+    len = sqrt(yx * yx + yy * yy + yz * yz);
+    len = FZERO(len) ? 1.0f : 1.0f / len;
+    yx *= len;
+    yy *= len;
+    yz *= len;
+    sx += yx * delta;
+    sy += yy * delta;
+    sz += yz * delta;
+  }
+  sx *= norm;
+  sy *= norm;
+  sz *= norm;
+
+  /* take out normal component */
+  nc = v->nx * sx + v->ny * sy + v->nz * sz;
+  sx += v->nx * -nc;
+  sy += v->ny * -nc;
+  sz += v->nz * -nc;
+
+  *pdx = l_dist * sx;
+  *pdy = l_dist * sy;
+  *pdz = l_dist * sz;
+  if (vno == Gdiag_no)
+    fprintf(stdout, "v %d, distance term: (%2.3f, %2.3f, %2.3f)\n", vno, *pdx,
+            *pdy, *pdz);
+}
+
+/* per-vertex part of the nonlinear distance term, which scales the current
+   rather than the original distances */
+static void vertexComputeNonlinearDistanceTerm(MRIS *mris, int vno, float *pdx,
+                                               float *pdy, float *pdz,
+                                               float l_dist, float scale,
+                                               float norm) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX const *const          v  = &mris->vertices[vno];
+  float sx, sy, sz, yx, yy, yz, d0, dt, delta, len, nc, ratio;
+  int   n;
+
+  if (v->ripflag || vt->vtotal <= 0)
+    return;
+
+  for (sx = sy = sz = 0.0, n = 0; n < vt->vtotal; n++) {
+    VERTEX const *const vn = &mris->vertices[vt->v[n]];
+    if (vn->ripflag)
+      continue;
+
+    d0    = v->dist_orig[n];
+    dt    = scale * v->dist[n];
+    delta = dt - d0;
+    yx    = vn->x - v->x;
+    yy    = vn->y - v->y;
+    yz    = vn->z - v->z;
+    if (DZERO(yx * yx + yy * yy + yz * yz))
+      continue;
+
+    len = sqrt(yx * yx + yy * yy + yz * yz);
+    len = FZERO(len) ? 1.0f : 1.0f / len;
+    yx *= len;
+    yy *= len;
+    yz *= len;
+    if (!FZERO(d0)) {
+      ratio = dt / d0;
+      delta *= 1 / (1 + exp(-1 * ratio));
+    }
+    sx += yx * delta;
+    sy += yy * delta;
+    sz += yz * delta;
+  }
+  sx *= norm;
+  sy *= norm;
+  sz *= norm;
+
+  nc = v->nx * sx + v->ny * sy + v->nz * sz;
+  sx += v->nx * -nc;
+  sy += v->ny * -nc;
+  sz += v->nz * -nc;
+
+  *pdx = l_dist * sx;
+  *pdy = l_dist * sy;
+  *pdz = l_dist * sz;
+}
+
+/* the radius the sphere term pulls toward: the one given, or just past the
+   vertex farthest from the center if that is negative */
+static float mrisSphereTermRadius(MRIS *mris, float radius, float x0, float y0,
+                                  float z0) {
+  int   vno;
+  float x, y, z, r;
+
+  if (radius >= 0)
+    return (radius);
+
+  radius = 0;
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *const v = &mris->vertices[vno];
+    if (v->ripflag)
       continue;
+
+    x = v->x - x0;
+    y = v->y - y0;
+    z = v->z - z0;
+    r = sqrt(x * x + y * y + z * z);
+    if (r > radius)
+      radius = r;
+  }
+  return (radius + 1);
+}
+
+/* per-vertex part of the sphere term. Like the expansion and convexity
+   terms it adds into the gradient itself, since the weight is applied in
+   double precision */
+static void vertexComputeSphereTerm(MRIS *mris, int vno, double l_sphere,
+                                    float x0, float y0, float z0, float radius,
+                                    int explode_flag) {
+  VERTEX *const v = &mris->vertices[vno];
+  float         x, y, z, r;
+
+  if (v->ripflag)
+    return;
+  if (vno == Gdiag_no)
+    DiagBreak();
+
+  x = v->x - x0;
+  y = v->y - y0;
+  z = v->z - z0;
+  r = sqrt(x * x + y * y + z * z);
+  if (FZERO(r))
+    return;
+
+  x /= r;
+  y /= r;
+  z /= r; /* normal direction */
+  r = (radius - r) / radius;
+  if (explode_flag)
+    r = 1;
+
+  v->dx += r * l_sphere * x;
+  v->dy += r * l_sphere * y;
+  v->dz += r * l_sphere * z;
+  if (vno == Gdiag_no)
+    fprintf(stdout,
+            "v %d sphere   "
+            " term: (%2.3f, %2.3f, %2.3f), r=%2.2f\n",
+            vno, v->dx, v->dy, v->dz, r);
+}
+
+static void vertexComputeExpansionTerm(MRIS *mris, int vno, double l_expand) {
+  VERTEX *const v = &mris->vertices[vno];
+
+  if (v->ripflag)
+    return;
+
+  v->dx += l_expand * v->nx;
+  v->dy += l_expand * v->ny;
+  v->dz += l_expand * v->nz;
+  if (vno == Gdiag_no)
+    printf("v %d expansion term: (%2.3f, %2.3f, %2.3f)\n", vno,
+           l_expand * v->nx, l_expand * v->ny, l_expand * v->nz);
+}
+
+/*-----------------------------------------------------
+  Description
+  Evaluate the per-vertex terms above in one sweep over the vertices
+  instead of one sweep per term. The weights of the listed terms are
+  looked up in parms, the terms with a zero weight are dropped once, the
+  global quantities the rest need (metric scales, the sphere center and
+  radius, the nonlinear spring constants) are computed once, and then
+  each vertex adds the active terms, in the order given, into its
+  gradient. terms == NULL takes every MRIS_LOCAL_TERM in enum order.
+
+  A vertex only reads its neighbors and only writes its own gradient, so
+  the sweep runs in parallel and gives the same result for any number
+  of threads. Each vertex also adds the terms in the same order as the
+  separate functions did, so the gradient is bit for bit the same
+  except for the nonlinear spring term, whose neighbor sum is
+  accumulated in a different order. Setting
+  FREESURFER_OLD_mrisComputeLocalTerms calls the separate
+  mrisCompute*Term functions instead.
+
+  Terms that scatter into several vertices (angle/area, which are per
+  face), sample volumes or templates through shared state
+  (correlation, thickness, intensity), or query a hash table (the
+  repulsive terms) are not fused and stay separate calls, as do the
+  quadratic curvature and normalized spring terms, which need a
+  reduction over the whole surface first.
+  ------------------------------------------------------*/
+int mrisComputeLocalTerms(MRIS *mris, INTEGRATION_PARMS *parms,
+                          MRIS_LOCAL_TERM const *terms, int nterms) {
+  static MRIS_LOCAL_TERM const all_terms[MRIS_LOCAL_NTERMS] = {
+      MRIS_LOCAL_SPRING,
+      MRIS_LOCAL_LAPLACIAN,
+      MRIS_LOCAL_NORMAL_SPRING,
+      MRIS_LOCAL_TANGENTIAL_SPRING,
+      MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING,
+      MRIS_LOCAL_NONLINEAR_SPRING,
+      MRIS_LOCAL_DISTANCE,
+      MRIS_LOCAL_SPHERE,
+      MRIS_LOCAL_EXPANSION,
+      MRIS_LOCAL_CONVEXITY};
+  bool const use_old =
+      (getenv("FREESURFER_OLD_mrisComputeLocalTerms") != NULL);
+  MRIS_LOCAL_TERM active[MRIS_LOCAL_NTERMS];
+  double          weights[MRIS_LOCAL_NTERMS], E = 0, F = 0;
+  float           dist_scale = 1, lsq = 0, x0 = 0, y0 = 0, z0 = 0, radius = 0;
+  float           scale = 1, nlscale = 1, norm = 1;
+  int             i, nactive, vno;
+
+  if (terms == NULL) {
+    terms  = all_terms;
+    nterms = MRIS_LOCAL_NTERMS;
+  }
+
+  for (nactive = i = 0; i < nterms; i++) {
+    double weight = 0;
+
+    switch (terms[i]) {
+    case MRIS_LOCAL_SPRING:
+      weight = parms->l_spring;
+      break;
+    case MRIS_LOCAL_LAPLACIAN:
+      weight = parms->l_lap;
+      break;
+    case MRIS_LOCAL_NORMAL_SPRING:
+      weight = parms->l_nspring;
+      break;
+    case MRIS_LOCAL_TANGENTIAL_SPRING:
+      weight = parms->l_tspring;
+      break;
+    case MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING:
+      weight = parms->l_nltspring;
+      break;
+    case MRIS_LOCAL_NONLINEAR_SPRING:
+      weight = parms->l_nlspring;
+      break;
+    case MRIS_LOCAL_DISTANCE:
+      // active if either distance term is, the nonlinear one comes first
+      weight = DZERO(parms->l_dist) && FZERO(parms->l_nldist) ? 0 : 1;
+      break;
+    case MRIS_LOCAL_SPHERE:
+      weight = parms->l_sphere;
+      break;
+    case MRIS_LOCAL_EXPANSION:
+      weight = parms->l_expand;
+      break;
+    case MRIS_LOCAL_CONVEXITY:
+      weight = parms->l_convex;
+      break;
+    default:
+      ErrorExit(ERROR_BADPARM, "mrisComputeLocalTerms: unknown term %d",
+                terms[i]);
     }
-    if (vno == Gdiag_no) {
-      DiagBreak();
+    if (FZERO(weight) || nactive >= MRIS_LOCAL_NTERMS)
+      continue;
+
+    // the distance term copes with distances that were never computed, so
+    // leave that case, which only comes first in a list, to it
+    if (use_old || (terms[i] == MRIS_LOCAL_DISTANCE &&
+                    (mris->dist_alloced_flags & 3) != 3)) {
+      switch (terms[i]) {
+      case MRIS_LOCAL_SPRING:
+        mrisComputeSpringTerm(mris, weight);
+        break;
+      case MRIS_LOCAL_LAPLACIAN:
+        mrisComputeLaplacianTerm(mris, weight);
+        break;
+      case MRIS_LOCAL_NORMAL_SPRING:
+        mrisComputeNormalSpringTerm(mris, weight);
+        break;
+      case MRIS_LOCAL_TANGENTIAL_SPRING:
+        mrisComputeTangentialSpringTerm(mris, weight);
+        break;
+      case MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING:
+        mrisComputeNonlinearTangentialSpringTerm(mris, weight,
+                                                 parms->min_dist);
+        break;
+      case MRIS_LOCAL_NONLINEAR_SPRING:
+        mrisComputeNonlinearSpringTerm(mris, weight, parms);
+        break;
+      case MRIS_LOCAL_DISTANCE:
+        mrisComputeDistanceTerm(mris, parms);
+        break;
+      case MRIS_LOCAL_SPHERE:
+        mrisComputeSphereTerm(mris, weight, parms->a, parms->explode_flag);
+        break;
+      case MRIS_LOCAL_EXPANSION:
+        mrisComputeExpansionTerm(mris, weight);
+        break;
+      case MRIS_LOCAL_CONVEXITY:
+        mrisComputeConvexityTerm(mris, weight);
+        break;
+      default:
+        break;
+      }
+      continue;
     }
 
-    x = v->x;
-    y = v->y;
-    z = v->z;
+    switch (terms[i]) {
+    case MRIS_LOCAL_SPRING:
+      dist_scale = mrisSpringDistScale(mris);
+      break;
+    case MRIS_LOCAL_NONLINEAR_SPRING:
+      if (mrisNonlinearSpringConstants(mris, parms, &lsq, &F, &E) != NO_ERROR)
+        continue;
+      break;
+    case MRIS_LOCAL_DISTANCE:
+      // the metric scales of mrisComputeDistanceTerm and
+      // mrisComputeNonlinearDistanceTerm, which differ for MRIS_SPHERE
+      norm = 1.0f / mris->avg_nbrs;
+#if METRIC_SCALE
+      if (mris->patch) {
+        scale = nlscale = 1.0f;
+      } else {
+        nlscale = mris->neg_area < mris->total_area
+                      ? sqrt(mris->orig_area /
+                             (mris->total_area - mris->neg_area))
+                      : sqrt(mris->orig_area / mris->total_area);
+        scale = nlscale;
+        if (mris->status == MRIS_PARAMETERIZED_SPHERE ||
+            mris->status == MRIS_SPHERE)
+          scale = sqrt(mris->orig_area / mris->total_area);
+        if (mris->status == MRIS_PARAMETERIZED_SPHERE)
+          nlscale = sqrt(mris->orig_area / mris->total_area);
+      }
+#endif
+      break;
+    case MRIS_LOCAL_SPHERE:
+      x0     = (mris->xlo + mris->xhi) / 2.0f;
+      y0     = (mris->ylo + mris->yhi) / 2.0f;
+      z0     = (mris->zlo + mris->zhi) / 2.0f;
+      radius = mrisSphereTermRadius(mris, parms->a, x0, y0, z0);
+      break;
+    default:
+      break;
+    }
+    active[nactive]    = terms[i];
+    weights[nactive++] = weight;
+  }
+  if (nactive == 0)
+    return (NO_ERROR);
 
-    sx = sy = sz = 0.0;
-    for (dx = dy = dz = 0.0, n = m = 0; m < vt->vnum; m++) {
-      VERTEX const *const vn = &mris->vertices[vt->v[m]];
-      if (!vn->ripflag) {
-        sx = x - vn->x;
-        sy = y - vn->y;
-        sz = z - vn->z; // move away from nbr
-        d  = sqrt(sx * sx + sy * sy + sz * sz);
-        if (d < min_dist) {
-          scale = (min_dist - d) / min_dist;
-          d     = scale * (v->e1x * sx + v->e1y * sy + v->e1z * sz);
-          dx += v->e1x * d;
-          dy += v->e1y * d;
-          dz += v->e1z * d;
-          d = scale * (v->e2x * sx + v->e2y * sy + v->e2z * sz);
-          dx += v->e2x * d;
-          dy += v->e2y * d;
-          dz += v->e2z * d;
-          if (vno == Gdiag_no) {
-            DiagBreak();
-          }
-          n++;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
+    VERTEX *const v = &mris->vertices[vno];
+    int           n;
+
+    if (v->ripflag)
+      continue;
+
+    for (n = 0; n < nactive; n++) {
+      float dx = 0, dy = 0, dz = 0;
+
+      switch (active[n]) {
+      case MRIS_LOCAL_SPRING:
+        vertexComputeSpringTerm(mris, vno, &dx, &dy, &dz, weights[n],
+                                dist_scale);
+        break;
+      case MRIS_LOCAL_LAPLACIAN:
+        vertexComputeLaplacianTerm(mris, vno, &dx, &dy, &dz, weights[n]);
+        break;
+      case MRIS_LOCAL_NORMAL_SPRING:
+        vertexComputeNormalSpringTerm(mris, vno, &dx, &dy, &dz, weights[n]);
+        break;
+      case MRIS_LOCAL_TANGENTIAL_SPRING:
+        vertexComputeTangentialSpringTerm(mris, vno, &dx, &dy, &dz,
+                                          weights[n]);
+        break;
+      case MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING:
+        vertexComputeNonlinearTangentialSpringTerm(mris, vno, &dx, &dy, &dz,
+                                                   weights[n], parms->min_dist);
+        break;
+      case MRIS_LOCAL_NONLINEAR_SPRING:
+        vertexComputeNonlinearSpringTerm(mris, vno, &dx, &dy, &dz, weights[n],
+                                         lsq, F, E, parms->rmin);
+        break;
+      case MRIS_LOCAL_DISTANCE:
+        // two separate additions, as the two separate passes made
+        if (!FZERO(parms->l_nldist)) {
+          vertexComputeNonlinearDistanceTerm(mris, vno, &dx, &dy, &dz,
+                                             parms->l_nldist, nlscale, norm);
+          v->dx += dx;
+          v->dy += dy;
+          v->dz += dz;
+          dx = dy = dz = 0;
         }
+        if (!DZERO(parms->l_dist))
+          vertexComputeDistanceTerm(mris, vno, &dx, &dy, &dz, parms->l_dist,
+                                    scale, norm);
+        break;
+      // these three add into the gradient themselves
+      case MRIS_LOCAL_SPHERE:
+        vertexComputeSphereTerm(mris, vno, weights[n], x0, y0, z0, radius,
+                                parms->explode_flag);
+        break;
+      case MRIS_LOCAL_EXPANSION:
+        vertexComputeExpansionTerm(mris, vno, weights[n]);
+        break;
+      case MRIS_LOCAL_CONVEXITY:
+        vertexComputeConvexityTerm(mris, vno, weights[n]);
+        break;
+      default:
+        break;
       }
+      v->dx += dx;
+      v->dy += dy;
+      v->dz += dz;
     }
-    dx *= l_spring;
-    dy *= l_spring;
-    dz *= l_spring;
-    if (vno == Gdiag_no && n > 0)
-      printf("v %d nonlinear spring tangent term: (%2.3f, %2.3f, %2.3f)\n", vno,
-             dx, dy, dz);
-    v->dx += dx;
-    v->dy += dy;
-    v->dz += dz;
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   return (NO_ERROR);
 }
@@ -3773,9 +4289,8 @@ int mrisComputeShrinkwrapTerm(MRI_SURFACE *mris, MRI *mri_brain,
   ------------------------------------------------------*/
 int mrisComputeSphereTerm(MRI_SURFACE *mris, double l_sphere, float radius,
                           int explode_flag) {
-  int     vno;
-  VERTEX *v;
-  float   r, x, y, z, x0, y0, z0;
+  int   vno;
+  float x0, y0, z0;
 
   if (FZERO(l_sphere)) {
     return (0.0f);
@@ -3835,67 +4350,10 @@ int mrisComputeSphereTerm(MRI_SURFACE *mris, double l_sphere, float radius,
   }
 #endif
 
-  if (radius < 0) {
-    radius = 0;
-    for (vno = 0; vno < mris->nvertices; vno++) {
-      v = &mris->vertices[vno];
-      if (v->ripflag) {
-        continue;
-      }
-      if (vno == Gdiag_no) {
-        DiagBreak();
-      }
-
-      x = v->x - x0;
-      y = v->y - y0;
-      z = v->z - z0;
-      r = sqrt(x * x + y * y + z * z);
-      if (r > radius) {
-        radius = r;
-      }
-    }
-    radius++;
-  }
-
-  for (vno = 0; vno < mris->nvertices; vno++) {
-    v = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-
-    x = v->x - x0;
-    y = v->y - y0;
-    z = v->z - z0;
-    r = sqrt(x * x + y * y + z * z);
-    if (FZERO(r)) {
-      continue;
-    }
-    x /= r;
-    y /= r;
-    z /= r; /* normal direction */
-    //    x = v->nx ; y = v->ny ; z = v->nz ;
-    r = (radius - r) / radius;
-    if (explode_flag)
-      r = 1;
-
-    if (vno == Gdiag_no &&
-        (r * l_sphere * x * v->nx + r * l_sphere * y * v->ny +
-             r * l_sphere * z * v->nz <
-         0)) {
-      DiagBreak();
-    }
-    v->dx += r * l_sphere * x;
-    v->dy += r * l_sphere * y;
-    v->dz += r * l_sphere * z;
-    if (vno == Gdiag_no)
-      fprintf(stdout,
-              "v %d sphere   "
-              " term: (%2.3f, %2.3f, %2.3f), r=%2.2f\n",
-              vno, v->dx, v->dy, v->dz, r);
-  }
+  radius = mrisSphereTermRadius(mris, radius, x0, y0, z0);
+  for (vno = 0; vno < mris->nvertices; vno++)
+    vertexComputeSphereTerm(mris, vno, l_sphere, x0, y0, z0, radius,
+                            explode_flag);
 
   return (NO_ERROR);
 }
@@ -3909,29 +4367,14 @@ int mrisComputeSphereTerm(MRI_SURFACE *mris, double l_sphere, float radius,
   Apply a uniform outward expansion force.
   ------------------------------------------------------*/
 int mrisComputeExpansionTerm(MRI_SURFACE *mris, double l_expand) {
-  int     vno;
-  VERTEX *v;
+  int vno;
 
   if (FZERO(l_expand)) {
     return (0.0f);
   }
 
-  for (vno = 0; vno < mris->nvertices; vno++) {
-    v = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-
-    v->dx += l_expand * v->nx;
-    v->dy += l_expand * v->ny;
-    v->dz += l_expand * v->nz;
-    if (vno == Gdiag_no)
-      printf("v %d expansion term: (%2.3f, %2.3f, %2.3f)\n", vno,
-             l_expand * v->nx, l_expand * v->ny, l_expand * v->nz);
-  }
+  for (vno = 0; vno < mris->nvertices; vno++)
+    vertexComputeExpansionTerm(mris, vno, l_expand);
 
   return (NO_ERROR);
 }
@@ -441,7 +441,6 @@ static double MUTATION_PCT_INIT = (MUTATION_PCT * 1.0);
   0.1 /* replace this many with \
 mutated versions of best */
 #define MAX_UNCHANGED 3
-static int max_unchanged = MAX_UNCHANGED;
 
 #define AREA_THRESHOLD 35.0f
 
@@ -474,6 +473,12 @@ static void insertIntoDefectFacesCache(DefectFacesCache *p, int fno) {
   p->fnos[p->size++] = fno;
 }
 
+/* a private random number stream (splitmix64), so that a patch can be
+   mutated the same way whenever and on whichever thread it is done */
+typedef struct {
+  uint64_t state;
+} DEFECT_RNG;
+
 static int mrisDumpDefectiveEdge(MRI_SURFACE *mris, int vno1, int vno2);
 static SEGMENTATION *SEGMENTATIONalloc(int max_segments, int max_edges);
 static void          SEGMENTATIONfree(SEGMENTATION **segmentation);
@@ -490,7 +495,8 @@ static SEGMENTATION *segmentIntersectingEdges(MRIS *mris, DEFECT *defect,
 static void saveSegmentation(MRIS *mris, MRIS *mris_corrected, DEFECT *defect,
                              int *vertex_trans, ES *es, int nes, char *fname);
 // generate an ordering based on the segmented overlapping edges
-static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i);
+static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i,
+                             DEFECT_RNG *rng);
 static void savePatch(MRI *mri, MRIS *mris, MRIS *mris_corrected, DVS *dvs,
                       DP *dp, char *fname, TOPOLOGY_PARMS *parms);
 // compute statistics of the surface
@@ -584,7 +590,8 @@ static void updateVertexStatistics(MRIS *mris, MRIS *mris_corrected, DVS *dvs,
                                    RP *rp, DP *dp, int *vertex_trans,
                                    float fitness);
 static int  deleteWorstVertices(MRIS *mris, RP *rp, DEFECT *defect,
-                                int *vertex_trans, float fraction, int count);
+                                int *vertex_trans, float fraction, int count,
+                                float *pthreshold);
 static double mrisDefectPatchFitness(
     ComputeDefectContext *computeDefectContext, MRI_SURFACE *mris,
     MRI_SURFACE *mris_corrected, MRI *mri, DEFECT_PATCH *dp, int *vertex_trans,
@@ -595,18 +602,57 @@ static double mrisDefectPatchFitness(
 static void vertexPseudoNormal(MRIS *mris1, int vn1, MRIS *mris2, int vn2,
                                float norm[3]);
 
-static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
-                                 double pmutation);
+static void   defectRNGseed(DEFECT_RNG *rng, uint64_t seed, int stream);
+static double defectRandomNumber(DEFECT_RNG *rng, double low, double hi);
+static int    mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
+                                    double pmutation, DEFECT_RNG *rng);
 static int mrisCrossoverDefectPatches(DEFECT_PATCH *dp1, DEFECT_PATCH *dp2,
-                                      DEFECT_PATCH *dp_dst, EDGE_TABLE *etable);
+                                      DEFECT_PATCH *dp_dst, EDGE_TABLE *etable,
+                                      DEFECT_RNG *rng);
 static int defectPatchRank(DEFECT_PATCH *dps, int index, int npatches);
 static int mrisCopyDefectPatch(DEFECT_PATCH *dp_src, DEFECT_PATCH *dp_dst);
-static int mrisComputeOptimalRetessellation(
+
+/* genetic search of a defect, from the search itself, which only needs the
+   defect's own part of the corrected surface, to the retessellation of the
+   patch it selected */
+typedef struct {
+  DEFECT_RNG  rng;       /* stream of the defect */
+  DEFECT_RNG *prng;      /* &rng, or NULL to use the global generator */
+  int         nthreads;  /* # of threads the patches may be scored on */
+  float       threshold; /* for deleteWorstVertices */
+  int         selected;  /* a patch is waiting to be retessellated */
+
+  /* what the search hands over */
+  char *       ripflags; /* of the defect vertices before the search */
+  EDGE_TABLE   etable;
+  DEFECT_PATCH dp; /* the selected patch */
+  RP           rp;
+  MRI *mri_defect, *mri_defect_white, *mri_defect_gray, *mri_defect_sign;
+  double best_fitness;
+  int    nmutations, ntotalmutations, ncross_overs, ntotalcross_overs;
+  int    nfinalvertices, nbestpatch, number_of_patches;
+  long   nmut, ncross;
+} DEFECT_SEARCH;
+
+static void defectSearchInit(DEFECT_SEARCH *ds, int nthreads);
+static int  mrisComputeOptimalRetessellation(
     MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
     int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
     HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
     HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
-    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms);
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds);
+static int mrisSearchOptimalRetessellation(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
+    int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
+    HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
+    HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds);
+static int mrisRetessellateSelectedPatch(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
+    int *vertex_trans, HISTOGRAM *h_k1, HISTOGRAM *h_k2, MRI *mri_k1_k2,
+    HISTOGRAM *h_white, HISTOGRAM *h_gray, HISTOGRAM *h_border,
+    HISTOGRAM *h_grad, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds);
 static int mrisComputeRandomRetessellation(
     MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
     int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
@@ -620,6 +666,60 @@ static int mrisComputeGrayWhiteBorderDistributions(
     MRI_SURFACE *mris, MRI *mri, DEFECT *defect, HISTOGRAM *h_white,
     HISTOGRAM *h_gray, HISTOGRAM *h_border, HISTOGRAM *h_grad);
 
+/* candidate edges of a defect, built before its retessellation */
+typedef struct {
+  EDGE *et;       /* all possible edges, sorted by length */
+  int   nedges;
+  int   npairs;     /* # of vertex pairs considered */
+  int   nvertices;  /* # of defect and border vertices */
+  int   ndiscarded; /* # of edges intersecting existing ones */
+  ES *  es;       /* edges present in the original tessellation */
+  int   nes;
+  int * ordering; /* initial ordering */
+} DEFECT_EDGES;
+
+/* state of a defect prepared ahead of its retessellation */
+typedef struct {
+  HISTOGRAM *   h_white, *h_gray, *h_border, *h_grad;
+  DEFECT_EDGES  de;
+  DEFECT_SEARCH ds;
+  int           ahead; /* searched before the preceding defects are done */
+  float         xmin, xmax, ymin, ymax, zmin, zmax; /* orig coords */
+} DEFECT_BATCH_SLOT;
+
+#define MAX_DEFECT_BATCH 64
+
+static int mrisBuildDefectEdgeTable(MRI_SURFACE *mris,
+                                    MRI_SURFACE *mris_corrected, DEFECT *defect,
+                                    int *vertex_trans, MRI *mri,
+                                    DEFECT_EDGES *de);
+static void mrisFreeDefectEdgeTable(DEFECT_EDGES *de);
+static int  mrisRetessellateDefectEdges(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT *defect,
+    int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray, HISTOGRAM *h_border,
+    HISTOGRAM *h_grad, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_EDGES *de, DEFECT_SEARCH *ds);
+static void mrisAllocDefectBatch(DEFECT_BATCH_SLOT *slots, int nslots);
+static void mrisFreeDefectBatch(DEFECT_BATCH_SLOT *slots, int nslots);
+static int  mrisPrepareDefectBatch(MRI_SURFACE *mris,
+                                   MRI_SURFACE *mris_corrected, DEFECT_LIST *dl,
+                                   int first, int *vertex_trans, MRI *mri,
+                                   HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+                                   MRI *mri_k1_k2, MRI *mri_gray_white,
+                                   TOPOLOGY_PARMS *parms, int *vstamp,
+                                   DEFECT_BATCH_SLOT *slots, int max_slots);
+static void mrisSearchDefectBatch(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT_LIST *dl, int first,
+    int nslots, int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_BATCH_SLOT *slots);
+static int  mrisTessellatePreparedDefect(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT *defect,
+    int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_BATCH_SLOT *slot);
+
 static int isVertexInsideFace(MRIS *mris, int vno, int fno) {
   int     i;
   VERTEX *V0, *V1, *V2, *V, *Vn;
@@ -1408,7 +1508,7 @@ double mrisComputeDefectLogLikelihood(
     HISTOGRAM *h_grad, MRI *mri_gray_white, HISTOGRAM *h_dot,
     TOPOLOGY_PARMS *parms) {
   static int first_time = 1;
-  double     ll         = 0.0;
+  double     ll         = 0.0, unmri;
 
   dp->tp.face_ll   = 0.0f;
   dp->tp.vertex_ll = 0.0f;
@@ -1435,10 +1535,13 @@ double mrisComputeDefectLogLikelihood(
             fprintf(WHICH_OUTPUT,"\n") ;*/
   }
 
-  if (!FZERO(l_unmri) &&
+  /* patches of the same defect may be scored concurrently: leave the
+     global weight alone */
+  unmri = l_unmri;
+  if (!FZERO(unmri) &&
       (dp->mri_defect->width <= 5 || dp->mri_defect->height <= 5 ||
        dp->mri_defect->depth <= 5)) {
-    l_unmri = 0;
+    unmri = 0;
   }
 
   if (!FZERO(l_mri)) {
@@ -1446,9 +1549,9 @@ double mrisComputeDefectLogLikelihood(
                                                     h_gray, h_grad,
                                                     mri_gray_white);
   }
-  if (!FZERO(l_unmri)) {
-    ll += l_unmri * mrisComputeDefectMRILogUnlikelihood(computeDefectContext,
-                                                        mris, dp, h_border);
+  if (!FZERO(unmri)) {
+    ll += unmri * mrisComputeDefectMRILogUnlikelihood(computeDefectContext,
+                                                      mris, dp, h_border);
   }
   if (!FZERO(l_qcurv)) {
     /*compute the second fundamental form */
@@ -1461,7 +1564,9 @@ double mrisComputeDefectLogLikelihood(
         l_curv * mrisComputeDefectNormalDotLogLikelihood(mris, &dp->tp, h_dot);
   }
 
-  l_unmri = parms->l_unmri;
+  if (l_unmri != parms->l_unmri) {
+    l_unmri = parms->l_unmri;
+  }
   if (mrisCheckDefectFaces(mris, dp) < 0)
     ll -= 10000000;
 
@@ -4877,7 +4982,8 @@ static void saveSegmentation(MRIS *mris, MRIS *mris_corrected, DEFECT *defect,
   MRISwriteAnnotation(mris, name);
 }
 
-static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i) {
+static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i,
+                             DEFECT_RNG *rng) {
   int  n, m, val, r;
   int *ordering, *counter, nedges;
   int *seg_order, nseg;
@@ -4888,7 +4994,7 @@ static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i) {
   }
 
   if (segmentation == NULL) {
-    mrisMutateDefectPatch(dp, dp->etable, MUTATION_PCT_INIT);
+    mrisMutateDefectPatch(dp, dp->etable, MUTATION_PCT_INIT, rng);
     return;
   }
 
@@ -4927,7 +5033,7 @@ static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i) {
       fflush(stdout); // nicknote: prevents segfault on Linux PowerPC
       // when -O2 optimization is used w/gcc 3.3.3
 
-      r = nint(randomNumber(0.0, (double)nseg - 1));
+      r = nint(defectRandomNumber(rng, 0.0, (double)nseg - 1));
 
       val          = seg_order[n];
       seg_order[n] = seg_order[r];
@@ -4958,7 +5064,7 @@ static void generateOrdering(DP *dp, SEGMENTATION *segmentation, int i) {
   free(seg_order);
 
   if (r != i + 1) {
-    mrisMutateDefectPatch(dp, dp->etable, MUTATION_PCT_INIT);
+    mrisMutateDefectPatch(dp, dp->etable, MUTATION_PCT_INIT, NULL);
   }
 }
 
@@ -5314,13 +5420,17 @@ static void updateVertexStatistics(MRIS *mris, MRIS *mris_corrected, DVS *dvs,
   }
 }
 
+/* pthreshold is the threshold of the defect, or NULL to carry one over
+   from defect to defect as the old search did */
 static int deleteWorstVertices(MRIS *mris, RP *rp, DEFECT *defect,
-                               int *vertex_trans, float fraction, int count) {
+                               int *vertex_trans, float fraction, int count,
+                               float *pthreshold) {
   int          i, nvoxels, niters, init, changed;
   float        max;
   int          max_i;
-  static float threshold = 4.0f;
-  nvoxels                = 0;
+  static float old_threshold = 4.0f;
+  float *const threshold     = pthreshold ? pthreshold : &old_threshold;
+  nvoxels                    = 0;
 
   if (count <= 0) {
     fprintf(WHICH_OUTPUT, "error: count (%d) <= 0 \n", count);
@@ -5347,7 +5457,7 @@ static int deleteWorstVertices(MRIS *mris, RP *rp, DEFECT *defect,
   }
 
   if (fraction > 0.1) {
-    threshold /= 2.0f;
+    *threshold /= 2.0f;
   }
 
   // kill at most 20% of the vertices
@@ -5377,7 +5487,7 @@ static int deleteWorstVertices(MRIS *mris, RP *rp, DEFECT *defect,
       }
     }
 
-    if (max_i < threshold && (2 * niters < init)) {
+    if (max_i < *threshold && (2 * niters < init)) {
       break;
     }
 
@@ -7508,8 +7618,10 @@ static double mrisDefectPatchFitness(
   VERTEX *v;
   DEFECT *defect = dp->defect;
 
-  defect->vertex_trans = vertex_trans;
-  dp->verbose_mode     = parms->verbose;
+  if (defect->vertex_trans != vertex_trans) {
+    defect->vertex_trans = vertex_trans;
+  }
+  dp->verbose_mode = parms->verbose;
 
   /* set the arrays to NULL in dp->tp */
   TPinit(&dp->tp);
@@ -7577,6 +7689,549 @@ static double mrisDefectPatchFitness(
   return (dp->fitness);
 }
 
+/* fitness memo of the patches of one defect. The retessellation of a patch,
+   and therefore its fitness, only depends on its edge ordering and on the
+   status of the defect vertices, so a chromosome that was already scored
+   (crossover of identical parents, mutation that swapped back...) is not
+   retessellated again. Entries are keyed by two independent 64-bit hashes of
+   that state and keep what mrisDefectPatchFitness leaves behind: the scalar
+   part of the tessellated patch and the displacement of the vertices used,
+   which is needed to update the vertex statistics.
+*/
+typedef struct {
+  int      valid;
+  uint64_t key1, key2;
+  double   fitness;
+  TP       tp;      /* counts and likelihoods only */
+  float *  curvbak; /* displacement of the defect vertices */
+  char *   used;    /* defect vertices used in the retessellation */
+} DEFECT_FITNESS_ENTRY;
+
+typedef struct {
+  int                   nentries;
+  int                   nvertices;
+  long                  nlookups, nhits;
+  DEFECT_FITNESS_ENTRY *entries;
+} DEFECT_FITNESS_CACHE;
+
+#define DEFECT_FITNESS_CACHE_BYTES (32L * 1024L * 1024L)
+#define MAX_DEFECT_FITNESS_ENTRIES 2048
+
+static void defectFitnessCacheInit(DEFECT_FITNESS_CACHE *cache,
+                                   DEFECT *defect) {
+  memset(cache, 0, sizeof(*cache));
+  if (getenv("FREESURFER_OLD_mrisDefectPatchFitness")) {
+    return;
+  }
+
+  cache->nvertices = defect->nvertices;
+  cache->nentries  = (int)MIN(
+      (long)MAX_DEFECT_FITNESS_ENTRIES,
+      DEFECT_FITNESS_CACHE_BYTES /
+          ((long)defect->nvertices * (sizeof(float) + sizeof(char)) + 1));
+  if (cache->nentries < 1) {
+    cache->nentries = 1;
+  }
+  cache->entries = (DEFECT_FITNESS_ENTRY *)calloc(
+      cache->nentries, sizeof(DEFECT_FITNESS_ENTRY));
+  if (!cache->entries) {
+    cache->nentries = 0;
+  }
+}
+
+static void defectFitnessCacheFree(DEFECT_FITNESS_CACHE *cache) {
+  int i;
+
+  if (cache->nlookups && DIAG_VERBOSE_ON)
+    fprintf(WHICH_OUTPUT, "%ld of %ld patch fitnesses found in cache\n",
+            cache->nhits, cache->nlookups);
+  for (i = 0; i < cache->nentries; i++) {
+    if (cache->entries[i].curvbak) {
+      free(cache->entries[i].curvbak);
+    }
+    if (cache->entries[i].used) {
+      free(cache->entries[i].used);
+    }
+  }
+  if (cache->entries) {
+    free(cache->entries);
+  }
+  memset(cache, 0, sizeof(*cache));
+}
+
+static void defectFitnessKey(DP const *dp, uint64_t *pkey1, uint64_t *pkey2) {
+  DEFECT const *defect = dp->defect;
+  uint64_t      key1 = 0xcbf29ce484222325ULL, key2 = 0x9e3779b97f4a7c15ULL, x;
+  int           i;
+
+  for (i = 0; i < dp->nedges + defect->nvertices + 1; i++) {
+    if (i < dp->nedges) {
+      x = (uint64_t)(unsigned int)dp->ordering[i];
+    } else if (i < dp->nedges + defect->nvertices) {
+      x = (uint64_t)(unsigned char)defect->status[i - dp->nedges];
+    } else {
+      x = (uint64_t)(unsigned int)dp->retessellation_mode;
+    }
+    /* FNV-1a on one side, a multiply-xorshift mix on the other */
+    key1 = (key1 ^ x) * 0x100000001b3ULL;
+    key2 = (key2 + x + (uint64_t)i) * 0xff51afd7ed558ccdULL;
+    key2 ^= key2 >> 29;
+  }
+  *pkey1 = key1;
+  *pkey2 = key2;
+}
+
+/* entry of the cache a key goes into, with its arrays allocated */
+static DEFECT_FITNESS_ENTRY *defectFitnessCacheSlot(DEFECT_FITNESS_CACHE *cache,
+                                                    uint64_t key1) {
+  DEFECT_FITNESS_ENTRY *entry;
+
+  entry = &cache->entries[key1 % (uint64_t)cache->nentries];
+  if (!entry->curvbak) {
+    entry->curvbak = (float *)malloc(cache->nvertices * sizeof(float));
+    entry->used    = (char *)malloc(cache->nvertices * sizeof(char));
+    if (!entry->curvbak || !entry->used)
+      ErrorExit(ERROR_NOMEMORY, "%s: could not allocate fitness cache entry",
+                __FUNCTION__);
+  }
+  return (entry);
+}
+
+/* same as mrisDefectPatchFitness, but looks the patch up in the cache
+   first. On a hit, the vertex statistics are updated as if the patch had
+   been retessellated again.
+*/
+static double mrisDefectPatchFitnessCached(
+    DEFECT_FITNESS_CACHE *cache, ComputeDefectContext *computeDefectContext,
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT_PATCH *dp,
+    int *vertex_trans, DEFECT_VERTEX_STATE *dvs, RP *rp, HISTOGRAM *h_k1,
+    HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
+    HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
+  DEFECT *              defect = dp->defect;
+  DEFECT_FITNESS_ENTRY *entry;
+  VERTEX *              v;
+  uint64_t              key1, key2;
+  float                 new_fitness;
+  int                   i;
+
+  if (!cache->nentries || defect->nvertices != cache->nvertices) {
+    return (mrisDefectPatchFitness(
+        computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans, dvs,
+        rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
+        mri_gray_white, h_dot, parms));
+  }
+
+  defectFitnessKey(dp, &key1, &key2);
+  entry = &cache->entries[key1 % (uint64_t)cache->nentries];
+  cache->nlookups++;
+
+  if (entry->valid && entry->key1 == key1 && entry->key2 == key2) {
+    cache->nhits++;
+    defect->vertex_trans = vertex_trans;
+    dp->verbose_mode     = parms->verbose;
+    dp->tp               = entry->tp;
+    dp->fitness          = entry->fitness;
+
+    /* same update as updateVertexStatistics */
+    for (i = 0; i < defect->nvertices; i++) {
+      if (defect->status[i] == DISCARD_VERTEX) {
+        continue;
+      }
+      v          = &mris_corrected->vertices[vertex_trans[defect->vertices[i]]];
+      v->curvbak = entry->curvbak[i];
+      if (entry->used[i]) {
+        new_fitness = v->curvbak + (float)rp->nused[i] * rp->vertex_fitness[i];
+        rp->vertex_fitness[i] = new_fitness / ((float)rp->nused[i] + 1.0f);
+        rp->nused[i]++;
+      }
+    }
+    return (dp->fitness);
+  }
+
+  entry = defectFitnessCacheSlot(cache, key1);
+
+  /* a vertex is used by the patch iff its statistics get updated */
+  for (i = 0; i < defect->nvertices; i++) {
+    entry->used[i] = 0;
+  }
+  std::vector<int> nused(rp->nused, rp->nused + defect->nvertices);
+
+  mrisDefectPatchFitness(computeDefectContext, mris, mris_corrected, mri, dp,
+                         vertex_trans, dvs, rp, h_k1, h_k2, mri_k1_k2, h_white,
+                         h_gray, h_border, h_grad, mri_gray_white, h_dot,
+                         parms);
+
+  for (i = 0; i < defect->nvertices; i++) {
+    if (defect->status[i] == DISCARD_VERTEX) {
+      continue;
+    }
+    v = &mris_corrected->vertices[vertex_trans[defect->vertices[i]]];
+    entry->curvbak[i] = v->curvbak;
+    entry->used[i]    = (rp->nused[i] != nused[i]);
+  }
+  entry->valid   = 1;
+  entry->key1    = key1;
+  entry->key2    = key2;
+  entry->fitness = dp->fitness;
+  entry->tp      = dp->tp;
+
+  return (dp->fitness);
+}
+
+/* the patches of a population are scored concurrently, each thread
+   retessellating them on its own copy of the corrected surface, and the
+   results go into the fitness cache, where the serial search finds them.
+   Small defects are not worth copying the surface for. */
+#define MIN_PARALLEL_DEFECT_VERTICES 100
+
+typedef struct {
+  MRI_SURFACE *         mris; /* the corrected surface or a copy of it */
+  EDGE_TABLE            etable;
+  MRI *                 mri_defect_sign;
+  ComputeDefectContext  context, *computeDefectContext;
+  RP                    rp;    /* only nused and vertex_fitness */
+  int                   owned; /* 0 for the corrected surface itself */
+} DEFECT_FITNESS_SCRATCH;
+
+typedef struct {
+  int                     nscratch;
+  DEFECT_FITNESS_SCRATCH *scratch;
+} DEFECT_FITNESS_POOL;
+
+/* patch to score, or its mutation drawn from rng if not NULL */
+typedef struct {
+  DEFECT_PATCH *dp;
+  DEFECT_RNG *  rng;
+} DEFECT_FITNESS_JOB;
+
+/* copy of the corrected surface with room for the same retessellations */
+static MRI_SURFACE *mrisCopyDefectScratchSurface(MRI_SURFACE const *src) {
+  MRI_SURFACE *dst;
+  int          vno, fno, n, k;
+
+  dst = MRISoverAlloc(src->max_vertices, src->max_faces, src->nvertices,
+                      src->nfaces);
+
+  dst->type                 = src->type;
+  dst->status               = src->status;
+  dst->origxyz_status       = src->origxyz_status;
+  dst->hemisphere           = src->hemisphere;
+  dst->useRealRAS           = src->useRealRAS;
+  dst->nsize                = src->nsize;
+  dst->max_nsize            = src->max_nsize;
+  dst->vtotalsMightBeTooBig = src->vtotalsMightBeTooBig;
+  dst->nsizeMaxClock        = src->nsizeMaxClock;
+  dst->radius               = src->radius;
+  dst->total_area           = src->total_area;
+  dst->avg_vertex_area      = src->avg_vertex_area;
+  mrisSetAvgInterVertexDist(dst, src->avg_vertex_dist);
+  dst->std_vertex_dist = src->std_vertex_dist;
+  copyVolGeom(&src->vg, &dst->vg);
+
+  for (vno = 0; vno < src->nvertices; vno++) {
+    VERTEX_TOPOLOGY const *const vsrct = &src->vertices_topology[vno];
+    VERTEX_TOPOLOGY *const       vdstt = &dst->vertices_topology[vno];
+    VERTEX *const                vdst  = &dst->vertices[vno];
+
+    /* the distances are not used by the retessellation */
+    *vdst                    = src->vertices[vno];
+    vdst->dist               = NULL;
+    vdst->dist_orig          = NULL;
+    vdst->dist_capacity      = 0;
+    vdst->dist_orig_capacity = 0;
+    vdst->vp                 = NULL;
+
+    vdstt->num = vsrct->num;
+    if (vdstt->num) {
+      vdstt->f = (int *)calloc(vdstt->num, sizeof(int));
+      vdstt->n = (uchar *)calloc(vdstt->num, sizeof(uchar));
+      if (!vdstt->f || !vdstt->n)
+        ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d faces",
+                  __FUNCTION__, vdstt->num);
+      for (n = 0; n < vdstt->num; n++) {
+        vdstt->f[n] = vsrct->f[n];
+        vdstt->n[n] = vsrct->n[n];
+      }
+    }
+
+    modVnum(dst, vno, vsrct->vnum, true);
+    vdstt->v2num         = vsrct->v2num;
+    vdstt->v3num         = vsrct->v3num;
+    vdstt->nsizeMax      = vsrct->nsizeMax;
+    vdstt->nsizeMaxClock = vsrct->nsizeMaxClock;
+    MRIS_setNsizeCur(dst, vno, vsrct->nsizeCur);
+
+    n = mrisVertexVSize(src, vno);
+    if (n) {
+      vdstt->v = (int *)calloc(n, sizeof(int));
+      if (!vdstt->v)
+        ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d nbrs",
+                  __FUNCTION__, n);
+      memcpy(vdstt->v, vsrct->v, n * sizeof(int));
+    }
+  }
+
+  for (fno = 0; fno < src->nfaces; fno++) {
+    FACE const *const fsrc = &src->faces[fno];
+    FACE *const       fdst = &dst->faces[fno];
+
+    memmove(fdst, fsrc, sizeof(FACE));
+    if (fsrc->norm) {
+      fdst->norm = DMatrixCopy(fsrc->norm, NULL);
+    }
+    for (k = 0; k < 3; k++) {
+      if (fsrc->gradNorm[k]) {
+        fdst->gradNorm[k] = DMatrixCopy(fsrc->gradNorm[k], NULL);
+      }
+    }
+  }
+  memcpy(dst->faceNormCacheEntries, src->faceNormCacheEntries,
+         src->nfaces * sizeof(FaceNormCacheEntry));
+  memcpy(dst->faceNormDeferredEntries, src->faceNormDeferredEntries,
+         src->nfaces * sizeof(FaceNormDeferredEntry));
+
+  return (dst);
+}
+
+/* the first scratch is the corrected surface itself, the other ones are
+   copies of it taken before the search starts */
+static void defectFitnessPoolInit(DEFECT_FITNESS_POOL *pool,
+                                  MRI_SURFACE *mris_corrected,
+                                  EDGE_TABLE *etable, MRI *mri_defect_sign,
+                                  ComputeDefectContext *computeDefectContext,
+                                  DEFECT *defect, int max_patches,
+                                  int nthreads) {
+  int i;
+
+  pool->nscratch = 1;
+  if (nthreads > 1 &&
+      defect->nvertices >= MIN_PARALLEL_DEFECT_VERTICES &&
+      !getenv("FREESURFER_OLD_mrisComputeOptimalRetessellation") &&
+      !getenv("FREESURFER_OLD_mrisDefectPatchFitness")) {
+    /* a batch is at most a generation and the mutations of its children */
+    pool->nscratch = MIN(nthreads, 2 * max_patches);
+  }
+  pool->scratch = (DEFECT_FITNESS_SCRATCH *)calloc(
+      pool->nscratch, sizeof(DEFECT_FITNESS_SCRATCH));
+  if (!pool->scratch)
+    ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d scratches",
+              __FUNCTION__, pool->nscratch);
+
+  for (i = 0; i < pool->nscratch; i++) {
+    DEFECT_FITNESS_SCRATCH *const scratch = &pool->scratch[i];
+
+    scratch->rp.nused = (int *)calloc(defect->nvertices, sizeof(int));
+    scratch->rp.vertex_fitness =
+        (float *)calloc(defect->nvertices, sizeof(float));
+    if (!scratch->rp.nused || !scratch->rp.vertex_fitness)
+      ErrorExit(ERROR_NOMEMORY, "%s: could not allocate vertex statistics",
+                __FUNCTION__);
+    if (!i) {
+      scratch->mris                 = mris_corrected;
+      scratch->etable               = *etable;
+      scratch->mri_defect_sign      = mri_defect_sign;
+      scratch->computeDefectContext = computeDefectContext;
+      continue;
+    }
+    scratch->owned  = 1;
+    scratch->etable = *etable;
+    scratch->etable.edges =
+        (EDGE *)malloc(etable->nedges * sizeof(EDGE));
+    if (!scratch->etable.edges)
+      ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d edges",
+                __FUNCTION__, etable->nedges);
+    memmove(scratch->etable.edges, etable->edges,
+            etable->nedges * sizeof(EDGE));
+    if (mri_defect_sign) {
+      scratch->mri_defect_sign = MRIcopy(mri_defect_sign, NULL);
+    }
+    constructComputeDefectContext(&scratch->context);
+    scratch->computeDefectContext = &scratch->context;
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (i = 1; i < pool->nscratch; i++) {
+    ROMP_PFLB_begin
+
+    pool->scratch[i].mris = mrisCopyDefectScratchSurface(mris_corrected);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+static void defectFitnessPoolFree(DEFECT_FITNESS_POOL *pool) {
+  int i;
+
+  for (i = 0; i < pool->nscratch; i++) {
+    DEFECT_FITNESS_SCRATCH *const scratch = &pool->scratch[i];
+
+    if (scratch->owned) {
+      destructComputeDefectContext(&scratch->context);
+      MRISfree(&scratch->mris);
+      free(scratch->etable.edges);
+      if (scratch->mri_defect_sign) {
+        MRIfree(&scratch->mri_defect_sign);
+      }
+    }
+    free(scratch->rp.nused);
+    free(scratch->rp.vertex_fitness);
+  }
+  free(pool->scratch);
+  memset(pool, 0, sizeof(*pool));
+}
+
+/* score the patches of jobs that are not in the cache yet, concurrently,
+   and put them in the cache. Scoring a patch only depends on its ordering
+   and on the status of the defect vertices, so the cache then holds what
+   mrisDefectPatchFitnessCached would have computed. */
+static void mrisPrefetchDefectPatchFitness(
+    DEFECT_FITNESS_POOL *pool, DEFECT_FITNESS_CACHE *cache,
+    DEFECT_FITNESS_JOB *jobs, int njobs, MRI_SURFACE *mris, MRI *mri,
+    int *vertex_trans, DEFECT_VERTEX_STATE *dvs, HISTOGRAM *h_k1,
+    HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
+    HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
+  static int            warm = 0;
+  DEFECT *              defect;
+  DEFECT_FITNESS_ENTRY *entry;
+  int                   i, j, k, p, nvertices, npending, first;
+
+  if (pool->nscratch < 2 || !cache->nentries || njobs < 1) {
+    return;
+  }
+  defect    = jobs[0].dp->defect;
+  nvertices = defect->nvertices;
+  if (nvertices != cache->nvertices) {
+    return;
+  }
+
+  /* draw the patches, and drop the ones already in the cache or that
+     would land in the same cache entry as another one */
+  std::vector<std::vector<int>> orderings(njobs);
+  std::vector<uint64_t>         key1(njobs), key2(njobs);
+  std::vector<int>              pending;
+  for (j = 0; j < njobs; j++) {
+    DEFECT_PATCH dp = *jobs[j].dp;
+
+    orderings[j].assign(dp.ordering, dp.ordering + dp.nedges);
+    dp.ordering = orderings[j].data();
+    if (jobs[j].rng) {
+      DEFECT_RNG rng = *jobs[j].rng;
+      mrisMutateDefectPatch(&dp, dp.etable, MUTATION_PCT, &rng);
+    }
+    defectFitnessKey(&dp, &key1[j], &key2[j]);
+
+    entry = &cache->entries[key1[j] % (uint64_t)cache->nentries];
+    if (entry->valid && entry->key1 == key1[j] && entry->key2 == key2[j]) {
+      continue;
+    }
+    for (k = 0; k < (int)pending.size(); k++)
+      if (key1[pending[k]] % (uint64_t)cache->nentries ==
+          key1[j] % (uint64_t)cache->nentries) {
+        break;
+      }
+    if (k == (int)pending.size()) {
+      pending.push_back(j);
+    }
+  }
+  npending = (int)pending.size();
+  if (!npending) {
+    return;
+  }
+
+  /* vertices may have been eliminated since the copies were taken */
+  for (k = 1; k < pool->nscratch; k++)
+    for (i = 0; i < nvertices; i++) {
+      int const vno = vertex_trans[defect->vertices[i]];
+      if (vno >= 0) {
+        pool->scratch[k].mris->vertices[vno].ripflag =
+            pool->scratch[0].mris->vertices[vno].ripflag;
+      }
+    }
+
+#if MATRIX_ALLOCATION
+  {
+    /* initialize the transform's static state before going parallel */
+    double xv, yv, zv;
+    mriSurfaceRASToVoxel(0, 0, 0, &xv, &yv, &zv);
+  }
+#endif
+
+  std::vector<double> fitness(npending);
+  std::vector<TP>     tp(npending);
+  std::vector<float>  curvbak((size_t)npending * nvertices);
+  std::vector<char>   used((size_t)npending * nvertices);
+
+  auto score = [&](int p, DEFECT_FITNESS_SCRATCH *scratch) {
+    DEFECT_PATCH dp = *jobs[pending[p]].dp;
+    int          n;
+
+    dp.ordering        = orderings[pending[p]].data();
+    dp.etable          = &scratch->etable;
+    dp.mri_defect_sign = scratch->mri_defect_sign;
+    memset(scratch->rp.nused, 0, nvertices * sizeof(int));
+    memset(scratch->rp.vertex_fitness, 0, nvertices * sizeof(float));
+
+    mrisDefectPatchFitness(scratch->computeDefectContext, mris, scratch->mris,
+                           mri, &dp, vertex_trans, dvs, &scratch->rp, h_k1,
+                           h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
+                           mri_gray_white, h_dot, parms);
+
+    fitness[p] = dp.fitness;
+    tp[p]      = dp.tp;
+    for (n = 0; n < nvertices; n++) {
+      float *const pcurvbak = &curvbak[(size_t)p * nvertices + n];
+      *pcurvbak = 0;
+      if (defect->status[n] != DISCARD_VERTEX) {
+        *pcurvbak =
+            scratch->mris->vertices[vertex_trans[defect->vertices[n]]].curvbak;
+      }
+      used[(size_t)p * nvertices + n] = (scratch->rp.nused[n] != 0);
+    }
+  };
+
+  /* the first patch ever scored sets up the static state of the
+     likelihood computations */
+  first = 0;
+  if (!warm) {
+    score(first++, &pool->scratch[0]);
+    warm = 1;
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1) \
+    num_threads(pool->nscratch)
+#endif
+  for (p = first; p < npending; p++) {
+    ROMP_PFLB_begin
+
+    score(p, &pool->scratch[omp_get_thread_num()]);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (p = 0; p < npending; p++) {
+    j     = pending[p];
+    entry = defectFitnessCacheSlot(cache, key1[j]);
+    memcpy(entry->curvbak, &curvbak[(size_t)p * nvertices],
+           nvertices * sizeof(float));
+    memcpy(entry->used, &used[(size_t)p * nvertices],
+           nvertices * sizeof(char));
+    entry->valid   = 1;
+    entry->key1    = key1[j];
+    entry->key2    = key2[j];
+    entry->fitness = fitness[p];
+    entry->tp      = tp[p];
+  }
+}
+
 #define MAX_DEFECT_VERTICES 900000
 static long ncross  = 0;
 static long nmut    = 0;
@@ -8529,6 +9184,32 @@ MRI_SURFACE *MRIScorrectTopology(MRI_SURFACE *mris, MRI *mri, MRI *mri_wm,
                                  mri_gray_white, h_dot);
 
   mrisMarkAllDefects(mris, dl, 0);
+
+  /* when the defects are simply retessellated one after the other, their
+     statistics and edge tables are prepared concurrently in batches of
+     defects that don't share any vertex (see mrisPrepareDefectBatch), and
+     the genetic searches of the small defects of a batch are run
+     concurrently on copies of mris_corrected (see mrisSearchDefectBatch).
+     The retessellations themselves stay serial and in defect order. */
+  DEFECT_BATCH_SLOT *batch = NULL;
+  int *              batch_vstamp = NULL;
+  int                batch_first = 0, batch_size = 0;
+  if (omp_get_max_threads() > 1 && parms->correct_defect < 0 &&
+      (parms->search_mode == GREEDY_SEARCH ||
+       ((parms->search_mode == GENETIC_SEARCH ||
+         parms->search_mode == RANDOM_SEARCH) &&
+        !parms->optimal_mapping)) &&
+      !getenv("USE_GA_TOPOLOGY_CORRECTION") &&
+      !getenv("USE_RANDOM_TOPOLOGY_CORRECTION") &&
+      !getenv("FREESURFER_OLD_mrisTessellateDefect")) {
+    batch = (DEFECT_BATCH_SLOT *)calloc(MAX_DEFECT_BATCH, sizeof(*batch));
+    batch_vstamp = (int *)calloc(mris->nvertices, sizeof(int));
+    if (!batch || !batch_vstamp)
+      ErrorExit(ERROR_NOMEMORY, "%s: could not allocate defect batch",
+                __FUNCTION__);
+    mrisAllocDefectBatch(batch, MAX_DEFECT_BATCH);
+  }
+
   for (i = 0; i < dl->ndefects; i++) {
     if (parms->correct_defect >= 0 && i != parms->correct_defect) {
       continue;
@@ -8538,10 +9219,23 @@ MRI_SURFACE *MRIScorrectTopology(MRI_SURFACE *mris, MRI *mri, MRI *mri_wm,
     if (i == Gdiag_no) {
       DiagBreak();
     }
-    mrisMarkAllDefects(mris, dl, 1);
-    mrisComputeGrayWhiteBorderDistributions(mris, mri, defect, h_white, h_gray,
-                                            h_border, h_grad);
-    mrisMarkAllDefects(mris, dl, 0);
+    if (batch) {
+      if (i >= batch_first + batch_size) {
+        batch_first = i;
+        batch_size  = mrisPrepareDefectBatch(
+            mris, mris_corrected, dl, i, vertex_trans, mri, h_k1, h_k2,
+            mri_k1_k2, mri_gray_white, parms, batch_vstamp, batch,
+            MAX_DEFECT_BATCH);
+        mrisSearchDefectBatch(mris, mris_corrected, dl, batch_first,
+                              batch_size, vertex_trans, mri, h_k1, h_k2,
+                              mri_k1_k2, mri_gray_white, h_dot, parms, batch);
+      }
+    } else {
+      mrisMarkAllDefects(mris, dl, 1);
+      mrisComputeGrayWhiteBorderDistributions(mris, mri, defect, h_white,
+                                              h_gray, h_border, h_grad);
+      mrisMarkAllDefects(mris, dl, 0);
+    }
 
 #define TESTING_OPTIMAL 1
 
@@ -8768,6 +9462,11 @@ MRI_SURFACE *MRIScorrectTopology(MRI_SURFACE *mris, MRI *mri, MRI *mri_wm,
 #if TESTING_OPTIMAL
       mrisFreeDefectVertexState(dvs);
 #endif
+    } else if (batch) {
+      // main part of the routine: retessellation of the defect
+      mrisTessellatePreparedDefect(mris, mris_corrected, defect, vertex_trans,
+                                   mri, h_k1, h_k2, mri_k1_k2, mri_gray_white,
+                                   h_dot, parms, &batch[i - batch_first]);
     } else {
       // main part of the routine: retessellation of the defect
       mrisTessellateDefect(mris, mris_corrected, defect, vertex_trans, mri,
@@ -8809,6 +9508,11 @@ MRI_SURFACE *MRIScorrectTopology(MRI_SURFACE *mris, MRI *mri, MRI *mri_wm,
     if (parms->correct_defect >= 0 && i == parms->correct_defect)
       ErrorExit(ERROR_BADPARM, "TERMINATING PROGRAM AFTER CORRECTED DEFECT\n");
   }
+  if (batch) {
+    mrisFreeDefectBatch(batch, MAX_DEFECT_BATCH);
+    free(batch);
+    free(batch_vstamp);
+  }
 #if ADD_EXTRA_VERTICES
   if (retessellation_error >= 0) {
     fprintf(WHICH_OUTPUT,
@@ -11228,39 +11932,25 @@ static int compare_edge_length(const void *pe0, const void *pe1) {
   return (-1);
 }
 
-static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
+/* build the table of all possible edges among the vertices in the defect
+   and on its border, sorted by length, along with the list of the edges
+   present in the original tessellation. Only the defect, its border and
+   their images in mris_corrected are read, so defects that don't share
+   vertices can be prepared concurrently.
+*/
+static int mrisBuildDefectEdgeTable(MRI_SURFACE *mris,
                                     MRI_SURFACE *mris_corrected, DEFECT *defect,
                                     int *vertex_trans, MRI *mri,
-                                    HISTOGRAM *h_k1, HISTOGRAM *h_k2,
-                                    MRI *mri_k1_k2, HISTOGRAM *h_white,
-                                    HISTOGRAM *h_gray, HISTOGRAM *h_border,
-                                    HISTOGRAM *h_grad, MRI *mri_gray_white,
-                                    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
+                                    DEFECT_EDGES *de) {
   int     i, j, vlist[MAX_DEFECT_VERTICES], n, nvertices, nedges, ndiscarded;
   VERTEX *v, *v2;
-  EDGE *  et;
-  /*  double  cx, cy, cz, max_len ;*/
-  static int dno = 0;
   double x, y, z, xv, yv, zv, val0, val, total, dx, dy, dz, d, wval, gval, Ix,
       Iy, Iz;
   float norm1[3], norm2[3], nx, ny, nz;
-  int   nes; /* number of edges present in original tessellation */
-  ES *  es;  /* list of edges present in original tessellation */
-  /*generate an initial ordering*/
-  int *ordering = NULL;
-
-  ROMP_SCOPE_begin
 
-      /* first build table of all possible edges among vertices in the defect
-     and on its border.
-  */
-      if (parms->search_mode != GREEDY_SEARCH)
-          computeDefectStatistics(mri, mris, defect, h_white, h_gray,
-                                  mri_gray_white, h_k1, h_k2, mri_k1_k2, 0);
+  memset(de, 0, sizeof(*de));
 
-  /* first build table of all possible edges among vertices in the defect
-     and on its border.*/
-  for (nes = nvertices = i = 0; i < defect->nvertices; i++) {
+  for (nvertices = i = 0; i < defect->nvertices; i++) {
     if (nvertices >= MAX_DEFECT_VERTICES)
       ErrorExit(ERROR_NOMEMORY,
                 "mrisTessellateDefect: too many vertices in defect (%d)",
@@ -11273,12 +11963,7 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
   for (i = 0; i < defect->nborder; i++) {
     vlist[nvertices++] = defect->border[i];
   }
-  //  if (nvertices > 250)  //FLO
-  if (DIAG_VERBOSE_ON)
-    fprintf(WHICH_OUTPUT,
-            "retessellating defect %d with %d vertices (convex hull=%d).\n",
-            defect->defect_number, nvertices, defect->nchull);
-  dno++;
+  de->nvertices = nvertices;
   if (nvertices == 0) /* should never happen */
   {
     return (NO_ERROR);
@@ -11286,24 +11971,15 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
 
   nedges = (nvertices * (nvertices - 1)) / 2; /* won't be more than this */
 
-  et = (EDGE *)calloc(nedges, sizeof(EDGE));
-  if (!et)
+  de->et = (EDGE *)calloc(nedges, sizeof(EDGE));
+  if (!de->et)
     ErrorExit(ERROR_NOMEMORY,
               "Excessive topologic defect encountered: "
               "could not allocate %d edges for retessellation",
               nedges);
 
-  ROMP_SCOPE_end
-
-      n = 0;
-  ROMP_PF_begin
-#ifdef HAVE_OPENMP
-#pragma omp parallel for if_ROMP(serial)
-#endif
-      for (i = 0; i < nvertices; i++) {
-    ROMP_PFLB_begin
-
-        v = &mris->vertices[vlist[i]];
+  for (n = i = 0; i < nvertices; i++) {
+    v = &mris->vertices[vlist[i]];
     if (vlist[i] == Gdiag_no) {
       DiagBreak();
     }
@@ -11353,10 +12029,10 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
       Iz /= total;
 
       /* assign value for edge table : values in mris_corrected */
-      et[n].vno1 = vertex_trans[vlist[i]];
-      et[n].vno2 = vertex_trans[vlist[j]];
-      if ((et[n].vno1 == 141823 && et[n].vno2 == 141908) ||
-          (et[n].vno2 == 141823 && et[n].vno1 == 141908)) {
+      de->et[n].vno1 = vertex_trans[vlist[i]];
+      de->et[n].vno2 = vertex_trans[vlist[j]];
+      if ((de->et[n].vno1 == 141823 && de->et[n].vno2 == 141908) ||
+          (de->et[n].vno2 == 141823 && de->et[n].vno1 == 141908)) {
         DiagBreak();
       }
       if ((vlist[i] == Gdiag_no && vlist[j] == Gx) ||
@@ -11457,13 +12133,13 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
         total += fabs(val - wval);
       }
 
-      et[n].len = total / (4.0 + 18.0);
-      if (et[n].vno1 == 120811 && et[n].vno2 == 120951) {
+      de->et[n].len = total / (4.0 + 18.0);
+      if (de->et[n].vno1 == 120811 && de->et[n].vno2 == 120951) {
         VERTEX *v1, *v2;
-        v1 = &mris_corrected->vertices[et[n].vno1];
-        v2 = &mris_corrected->vertices[et[n].vno2];
-        fprintf(stdout, "v %d (%d) --> %d (%d), len = %2.3f\n", et[n].vno1,
-                vlist[i], et[n].vno2, vlist[j], et[n].len);
+        v1 = &mris_corrected->vertices[de->et[n].vno1];
+        v2 = &mris_corrected->vertices[de->et[n].vno2];
+        fprintf(stdout, "v %d (%d) --> %d (%d), len = %2.3f\n", de->et[n].vno1,
+                vlist[i], de->et[n].vno2, vlist[j], de->et[n].len);
         fprintf(stdout,
                 "INFLATED:  (%2.1f, %2.1f, %2.1f) --> "
                 "(%2.1f, %2.1f, %2.1f), len = %2.2f\n",
@@ -11491,8 +12167,8 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
                      SQR(v1->origz - v2->origz)));
         DiagBreak();
       }
-      if (edgeExists(mris_corrected, et[n].vno1, et[n].vno2)) {
-        et[n].used = USED_IN_TESSELLATION;
+      if (edgeExists(mris_corrected, de->et[n].vno1, de->et[n].vno2)) {
+        de->et[n].used = USED_IN_TESSELLATION;
         if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON)
           fprintf(stdout, "excluding existing edge %d <--> %d\n", vlist[i],
                   vlist[j]);
@@ -11500,39 +12176,36 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
 
       if (!edgeExists(mris, vlist[i], vlist[j])) {
         /* prioritize edges in original tessellation */
-        et[n].len += 100; /*ASCENDING ORDER*/
+        de->et[n].len += 100; /*ASCENDING ORDER*/
       } else {
-        if (et[n].used == USED_IN_TESSELLATION) {
+        if (de->et[n].used == USED_IN_TESSELLATION) {
           continue;
         }
-        et[n].used = USED_IN_ORIGINAL_TESSELLATION; /* to list
+        de->et[n].used = USED_IN_ORIGINAL_TESSELLATION; /* to list
                                                        the original edges */
-        nes++;
+        de->nes++;
       }
     }
-
-    ROMP_PFLB_end
   }
-  ROMP_PF_end
+  de->npairs = n;
 
-      ROMP_SCOPE_begin
-      /* find and discard all edges that intersect one that is already in the
+  /* find and discard all edges that intersect one that is already in the
      tessellation.
   */
-      for (ndiscarded = i = 0; i < nedges; i++) {
-    if (et[i].used != USED_IN_TESSELLATION) {
+  for (ndiscarded = i = 0; i < nedges; i++) {
+    if (de->et[i].used != USED_IN_TESSELLATION) {
       continue;
     }
 
     for (j = i + 1; j < nedges; j++) {
-      if (et[j].used == USED_IN_TESSELLATION) {
+      if (de->et[j].used == USED_IN_TESSELLATION) {
         continue;
       }
 
-      if (edgesIntersect(mris_corrected, &et[i], &et[j])) {
+      if (edgesIntersect(mris_corrected, &de->et[i], &de->et[j])) {
         ndiscarded++;
         if (j < nedges - 1) {
-          memmove(&et[j], &et[j + 1], (nedges - j - 1) * sizeof(EDGE));
+          memmove(&de->et[j], &de->et[j + 1], (nedges - j - 1) * sizeof(EDGE));
         }
 
         nedges--;
@@ -11540,94 +12213,457 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
       }
     }
   }
-  ROMP_SCOPE_end
 
-      if (DIAG_VERBOSE_ON)
-          fprintf(WHICH_OUTPUT, "%d of %d overlapping edges discarded\n",
-                  ndiscarded, nedges);
+  de->ndiscarded = ndiscarded;
 
   /* sort the edge list by edge length */
-  qsort(et, nedges, sizeof(EDGE), compare_edge_length);
+  qsort(de->et, nedges, sizeof(EDGE), compare_edge_length);
+  de->nedges = nedges;
 
-  if (!n) /* should never happen */
+  if (!de->npairs) /* should never happen */
   {
     return (NO_ERROR);
   }
 
-  ROMP_SCOPE_begin
-
-      ordering = (int *)calloc(nedges, sizeof(int));
+  de->ordering = (int *)calloc(nedges, sizeof(int));
   for (j = 0; j < nedges; j++) {
-    ordering[j] = j; // nedges-j-1;
+    de->ordering[j] = j; // nedges-j-1;
   }
 
   /* list the edges used in the original tessellation */
-  es = (ES *)malloc(nes * sizeof(ES));
-  for (nes = i = 0; i < nedges; i++)
-    if (et[i].used == USED_IN_ORIGINAL_TESSELLATION) {
+  de->es = (ES *)malloc(de->nes * sizeof(ES));
+  for (de->nes = i = 0; i < nedges; i++)
+    if (de->et[i].used == USED_IN_ORIGINAL_TESSELLATION) {
       // et[i].used=0; //reset state
-      es[nes].vno1 = et[i].vno1;
-      es[nes].vno2 = et[i].vno2;
+      de->es[de->nes].vno1 = de->et[i].vno1;
+      de->es[de->nes].vno2 = de->et[i].vno2;
 
-      es[nes].segment = -1;
-      es[nes++].n     = i;
+      de->es[de->nes].segment = -1;
+      de->es[de->nes++].n     = i;
     }
 
-  // main part of the routine: the retessellation (using a specific method) !
-  if (getenv("USE_GA_TOPOLOGY_CORRECTION") != NULL) {
-    parms->search_mode = GENETIC_SEARCH;
+  return (NO_ERROR);
+}
+
+static void mrisFreeDefectEdgeTable(DEFECT_EDGES *de) {
+  if (de->es) {
+    free(de->es);
   }
-  if (getenv("USE_RANDOM_TOPOLOGY_CORRECTION") != NULL) {
-    parms->search_mode = RANDOM_SEARCH;
+  if (de->ordering) {
+    free(de->ordering);
   }
+  if (de->et) {
+    free(de->et);
+  }
+  memset(de, 0, sizeof(*de));
+}
 
-  ROMP_SCOPE_end
+// main part of the routine: the retessellation (using a specific method) !
+static int mrisRetessellateDefectEdges(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT *defect,
+    int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray, HISTOGRAM *h_border,
+    HISTOGRAM *h_grad, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_EDGES *de, DEFECT_SEARCH *ds) {
+  /* reported here rather than while building the table, which may run
+     concurrently for several defects */
+  //  if (nvertices > 250)  //FLO
+  if (DIAG_VERBOSE_ON) {
+    fprintf(WHICH_OUTPUT,
+            "retessellating defect %d with %d vertices (convex hull=%d).\n",
+            defect->defect_number, de->nvertices, defect->nchull);
+    if (de->nvertices)
+      fprintf(WHICH_OUTPUT, "%d of %d overlapping edges discarded\n",
+              de->ndiscarded, de->nedges);
+  }
+  if (!de->npairs) /* should never happen */
+  {
+    return (NO_ERROR);
+  }
 
-      switch (parms->search_mode) {
+  switch (parms->search_mode) {
   case GENETIC_SEARCH:
-    ROMP_SCOPE_begin mrisComputeOptimalRetessellation(
-        mris, mris_corrected, mri, defect, vertex_trans, et, nedges, es, nes,
-        h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-        mri_gray_white, h_dot, parms);
-    ROMP_SCOPE_end break;
+    mrisComputeOptimalRetessellation(
+        mris, mris_corrected, mri, defect, vertex_trans, de->et, de->nedges,
+        de->es, de->nes, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+        h_grad, mri_gray_white, h_dot, parms, ds);
+    break;
   case RANDOM_SEARCH:
-    ROMP_SCOPE_begin mrisComputeRandomRetessellation(
-        mris, mris_corrected, mri, defect, vertex_trans, et, nedges, es, nes,
-        h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-        mri_gray_white, h_dot, parms);
-    ROMP_SCOPE_end break;
+    mrisComputeRandomRetessellation(
+        mris, mris_corrected, mri, defect, vertex_trans, de->et, de->nedges,
+        de->es, de->nes, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+        h_grad, mri_gray_white, h_dot, parms);
+    break;
   default:
-    ROMP_SCOPE_begin parms->search_mode = GREEDY_SEARCH;
-    mrisRetessellateDefect(mris, mris_corrected, defect, vertex_trans, et,
-                           nedges, ordering, NULL);
-    ROMP_SCOPE_end break;
-  }
-
-  free(es);
-  if (ordering) {
-    free(ordering);
+    parms->search_mode = GREEDY_SEARCH;
+    mrisRetessellateDefect(mris, mris_corrected, defect, vertex_trans, de->et,
+                           de->nedges, de->ordering, NULL);
+    break;
   }
-  free(et);
 
   return (NO_ERROR);
 }
 
-#define NUM_TO_ADD_FROM_ONE_PARENT 1
+static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
+                                    MRI_SURFACE *mris_corrected, DEFECT *defect,
+                                    int *vertex_trans, MRI *mri,
+                                    HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+                                    MRI *mri_k1_k2, HISTOGRAM *h_white,
+                                    HISTOGRAM *h_gray, HISTOGRAM *h_border,
+                                    HISTOGRAM *h_grad, MRI *mri_gray_white,
+                                    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
+  DEFECT_EDGES de;
 
-static int mrisCrossoverDefectPatches(DEFECT_PATCH *dp1, DEFECT_PATCH *dp2,
-                                      DEFECT_PATCH *dp_dst,
-                                      EDGE_TABLE *  etable) {
-  int           i1, i2, *added, i, isrc, j, nadded;
-  double        p;
-  DEFECT_PATCH *dp_src;
+  if (parms->search_mode != GREEDY_SEARCH)
+    computeDefectStatistics(mri, mris, defect, h_white, h_gray, mri_gray_white,
+                            h_k1, h_k2, mri_k1_k2, 0);
 
-  added = (int *)calloc(dp1->nedges, sizeof(int));
-  p     = randomNumber(0.0, 1.0);
-  if (p < 0.5) /* add from first defect */
-  {
-    dp_src = dp1;
-  } else {
-    dp_src = dp2;
+  mrisBuildDefectEdgeTable(mris, mris_corrected, defect, vertex_trans, mri,
+                           &de);
+
+  if (de.npairs) {
+    if (getenv("USE_GA_TOPOLOGY_CORRECTION") != NULL) {
+      parms->search_mode = GENETIC_SEARCH;
+    }
+    if (getenv("USE_RANDOM_TOPOLOGY_CORRECTION") != NULL) {
+      parms->search_mode = RANDOM_SEARCH;
+    }
+  }
+
+  mrisRetessellateDefectEdges(mris, mris_corrected, defect, vertex_trans, mri,
+                              h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+                              h_grad, mri_gray_white, h_dot, parms, &de, NULL);
+
+  mrisFreeDefectEdgeTable(&de);
+
+  return (NO_ERROR);
+}
+
+static void mrisAllocDefectBatch(DEFECT_BATCH_SLOT *slots, int nslots) {
+  int i;
+
+  for (i = 0; i < nslots; i++) {
+    slots[i].h_white  = HISTOalloc(256);
+    slots[i].h_gray   = HISTOalloc(256);
+    slots[i].h_border = HISTOalloc(256);
+    slots[i].h_grad   = HISTOalloc(256);
+    memset(&slots[i].de, 0, sizeof(slots[i].de));
+  }
+}
+
+static void mrisFreeDefectBatch(DEFECT_BATCH_SLOT *slots, int nslots) {
+  int i;
+
+  for (i = 0; i < nslots; i++) {
+    HISTOfree(&slots[i].h_white);
+    HISTOfree(&slots[i].h_gray);
+    HISTOfree(&slots[i].h_border);
+    HISTOfree(&slots[i].h_grad);
+    mrisFreeDefectEdgeTable(&slots[i].de);
+  }
+}
+
+/* stamp the vertices read while preparing the defect (the defect itself,
+   its border and its convex hull), or return 0 without stamping anything if
+   one of them is already used by another defect of the same batch.
+*/
+static int mrisClaimDefectVertices(DEFECT *defect, int *vstamp, int stamp) {
+  int i;
+
+  for (i = 0; i < defect->nvertices; i++)
+    if (vstamp[defect->vertices[i]] == stamp) {
+      return (0);
+    }
+  for (i = 0; i < defect->nborder; i++)
+    if (vstamp[defect->border[i]] == stamp) {
+      return (0);
+    }
+  for (i = 0; i < defect->nchull; i++)
+    if (vstamp[defect->chull[i]] == stamp) {
+      return (0);
+    }
+
+  for (i = 0; i < defect->nvertices; i++) {
+    vstamp[defect->vertices[i]] = stamp;
+  }
+  for (i = 0; i < defect->nborder; i++) {
+    vstamp[defect->border[i]] = stamp;
+  }
+  for (i = 0; i < defect->nchull; i++) {
+    vstamp[defect->chull[i]] = stamp;
+  }
+  return (1);
+}
+
+/* bounding box of the vertices of the defect, its border and its convex
+   hull in mris_corrected */
+static void mrisDefectBatchBox(MRI_SURFACE *mris_corrected, DEFECT *defect,
+                               int *vertex_trans, DEFECT_BATCH_SLOT *slot) {
+  int i, n, vno;
+
+  slot->xmin = slot->ymin = slot->zmin = 1e10f;
+  slot->xmax = slot->ymax = slot->zmax = -1e10f;
+  for (i = 0; i < defect->nvertices + defect->nborder + defect->nchull; i++) {
+    if (i < defect->nvertices) {
+      n = defect->vertices[i];
+    } else if (i < defect->nvertices + defect->nborder) {
+      n = defect->border[i - defect->nvertices];
+    } else {
+      n = defect->chull[i - defect->nvertices - defect->nborder];
+    }
+    vno = vertex_trans[n];
+    if (vno < 0) {
+      continue;
+    }
+    VERTEX const *const v = &mris_corrected->vertices[vno];
+    slot->xmin            = MIN(slot->xmin, v->origx);
+    slot->xmax            = MAX(slot->xmax, v->origx);
+    slot->ymin            = MIN(slot->ymin, v->origy);
+    slot->ymax            = MAX(slot->ymax, v->origy);
+    slot->zmin            = MIN(slot->zmin, v->origz);
+    slot->zmax            = MAX(slot->zmax, v->origz);
+  }
+}
+
+/* the unlikelihood of a patch looks at the faces of mris_corrected within
+   2 voxels of the volume of its candidate edges, which itself extends 1 mm
+   past them (see mriDefectVolume). Two defects are searched independently
+   only if they are further apart than that, with 1 mm to spare for the
+   smoothing of the retessellated vertices.
+*/
+static float mrisDefectBatchMargin(TOPOLOGY_PARMS *parms) {
+  float const scale = parms->volume_resolution == -1
+                          ? VOLUME_SCALE
+                          : parms->volume_resolution;
+
+  return (1.0f + ((int)(2.0f * scale) + 2.5f) / scale + 1.0f);
+}
+
+static int mrisDefectBatchBoxesApart(DEFECT_BATCH_SLOT const *a,
+                                     DEFECT_BATCH_SLOT const *b, float margin) {
+  return (a->xmin - margin > b->xmax || b->xmin - margin > a->xmax ||
+          a->ymin - margin > b->ymax || b->ymin - margin > a->ymax ||
+          a->zmin - margin > b->zmax || b->zmin - margin > a->zmax);
+}
+
+/* whether the genetic searches of the small defects of a batch are run
+   concurrently (see mrisSearchDefectBatch). They are not when the search
+   writes files or reports its progress, or with the old search, which
+   draws from the global generator. */
+static int mrisSearchesDefectBatch(TOPOLOGY_PARMS *parms) {
+  return (parms->search_mode == GENETIC_SEARCH && parms->max_patches > 0 &&
+          !parms->save_fname && parms->verbose <= VERBOSE_MODE_DEFAULT &&
+          !(Gdiag & 0x1000000) && !getenv("FS_DEBUG_PATCH") &&
+          !getenv("FREESURFER_OLD_mrisComputeOptimalRetessellation"));
+}
+
+/* prepare the longest run of consecutive defects, starting at first, whose
+   vertices don't overlap. The retessellation of a defect only modifies its
+   own vertices in mris_corrected, so the edge tables of such a run are the
+   same whether they are built before or after the retessellation of the
+   preceding defects of the run, and can be built concurrently. A small
+   defect is also kept out of the run if it is not far enough from the
+   preceding ones for its genetic search to be run ahead of their
+   retessellation. The retessellations themselves are done one at a time
+   and in order by the caller. Returns the number of defects prepared.
+*/
+static int mrisPrepareDefectBatch(MRI_SURFACE *mris,
+                                  MRI_SURFACE *mris_corrected, DEFECT_LIST *dl,
+                                  int first, int *vertex_trans, MRI *mri,
+                                  HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+                                  MRI *mri_k1_k2, MRI *mri_gray_white,
+                                  TOPOLOGY_PARMS *parms, int *vstamp,
+                                  DEFECT_BATCH_SLOT *slots, int max_slots) {
+  int const   search = mrisSearchesDefectBatch(parms);
+  float const margin = mrisDefectBatchMargin(parms);
+  int         nslots, i;
+
+  for (nslots = 0; nslots < max_slots && first + nslots < dl->ndefects;
+       nslots++) {
+    DEFECT *const            defect = &dl->defects[first + nslots];
+    DEFECT_BATCH_SLOT *const slot   = &slots[nslots];
+
+    slot->ahead =
+        search && defect->nvertices < MIN_PARALLEL_DEFECT_VERTICES;
+    if (search) {
+      mrisDefectBatchBox(mris_corrected, defect, vertex_trans, slot);
+    }
+    if (slot->ahead) {
+      for (i = 0; i < nslots; i++)
+        if (!mrisDefectBatchBoxesApart(&slots[i], slot, margin)) {
+          break;
+        }
+      if (i < nslots) {
+        break;
+      }
+    }
+    if (!mrisClaimDefectVertices(defect, vstamp, first + 1)) {
+      break;
+    }
+  }
+
+  /* the distributions use the vertex marks: compute them one at a time */
+  for (i = 0; i < nslots; i++) {
+    mrisMarkAllDefects(mris, dl, 1);
+    mrisComputeGrayWhiteBorderDistributions(
+        mris, mri, &dl->defects[first + i], slots[i].h_white, slots[i].h_gray,
+        slots[i].h_border, slots[i].h_grad);
+    mrisMarkAllDefects(mris, dl, 0);
+  }
+
+#if MATRIX_ALLOCATION
+  {
+    /* initialize the transform's static state before going parallel */
+    double xv, yv, zv;
+    mriSurfaceRASToVoxel(0, 0, 0, &xv, &yv, &zv);
+  }
+#endif
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (i = 0; i < nslots; i++) {
+    ROMP_PFLB_begin
+
+    DEFECT *const            defect = &dl->defects[first + i];
+    DEFECT_BATCH_SLOT *const slot   = &slots[i];
+
+    if (parms->search_mode != GREEDY_SEARCH)
+      computeDefectStatistics(mri, mris, defect, slot->h_white, slot->h_gray,
+                              mri_gray_white, h_k1, h_k2, mri_k1_k2, 0);
+    mrisBuildDefectEdgeTable(mris, mris_corrected, defect, vertex_trans, mri,
+                             &slot->de);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  /* seed the searches in defect order, as they would be one at a time */
+  if (parms->search_mode == GENETIC_SEARCH)
+    for (i = 0; i < nslots; i++)
+      if (slots[i].de.npairs) {
+        defectSearchInit(&slots[i].ds, omp_get_max_threads());
+      }
+
+  return (nslots);
+}
+
+/* run the genetic searches of the defects of the batch that are too small
+   to have their patches scored concurrently, each thread searching on its
+   own copy of the corrected surface. These defects are far enough from the
+   preceding ones of the batch for their search not to see the preceding
+   retessellations (see mrisPrepareDefectBatch) and each of them draws from
+   its own stream, so they select the same patches as when they are searched
+   one at a time. The selected patches are retessellated in defect order by
+   mrisTessellatePreparedDefect.
+*/
+static void mrisSearchDefectBatch(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT_LIST *dl, int first,
+    int nslots, int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_BATCH_SLOT *slots) {
+  static int       warm = 0;
+  std::vector<int> ahead;
+  int              i, k, nscratch;
+
+  for (i = 0; i < nslots; i++)
+    if (slots[i].ahead && slots[i].de.npairs) {
+      ahead.push_back(i);
+    }
+
+  auto search = [&](int i, MRI_SURFACE *scratch) {
+    DEFECT_BATCH_SLOT *const slot = &slots[i];
+
+    slot->ds.nthreads = 1;
+    mrisSearchOptimalRetessellation(
+        mris, scratch, mri, &dl->defects[first + i], vertex_trans, slot->de.et,
+        slot->de.nedges, slot->de.es, slot->de.nes, h_k1, h_k2, mri_k1_k2,
+        slot->h_white, slot->h_gray, slot->h_border, slot->h_grad,
+        mri_gray_white, h_dot, parms, &slot->ds);
+  };
+
+  /* the first search sets up the static state of the search and of the
+     likelihood computations */
+  if (!warm && !ahead.empty()) {
+    search(ahead[0], mris_corrected);
+    ahead.erase(ahead.begin());
+    warm = 1;
+  }
+  if (ahead.empty()) {
+    return;
+  }
+
+  nscratch = MIN(omp_get_max_threads(), (int)ahead.size());
+  std::vector<MRI_SURFACE *> scratch(nscratch, mris_corrected);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (k = 1; k < nscratch; k++) {
+    ROMP_PFLB_begin
+
+    scratch[k] = mrisCopyDefectScratchSurface(mris_corrected);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1) \
+    num_threads(nscratch)
+#endif
+  for (k = 0; k < (int)ahead.size(); k++) {
+    ROMP_PFLB_begin
+
+    search(ahead[k], scratch[omp_get_thread_num()]);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (k = 1; k < nscratch; k++) {
+    MRISfree(&scratch[k]);
+  }
+}
+
+static int mrisTessellatePreparedDefect(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, DEFECT *defect,
+    int *vertex_trans, MRI *mri, HISTOGRAM *h_k1, HISTOGRAM *h_k2,
+    MRI *mri_k1_k2, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_BATCH_SLOT *slot) {
+  fprintf(stderr, "CORRECTING DEFECT %d (vertices=%d, convex hull=%d, v0=%d)\n",
+          defect->defect_number, defect->nvertices, defect->nchull,
+          defect->vertices[0]);
+
+  mrisRetessellateDefectEdges(mris, mris_corrected, defect, vertex_trans, mri,
+                              h_k1, h_k2, mri_k1_k2, slot->h_white,
+                              slot->h_gray, slot->h_border, slot->h_grad,
+                              mri_gray_white, h_dot, parms, &slot->de,
+                              &slot->ds);
+  mrisFreeDefectEdgeTable(&slot->de);
+
+  return (NO_ERROR);
+}
+
+#define NUM_TO_ADD_FROM_ONE_PARENT 1
+
+static int mrisCrossoverDefectPatches(DEFECT_PATCH *dp1, DEFECT_PATCH *dp2,
+                                      DEFECT_PATCH *dp_dst,
+                                      EDGE_TABLE *etable, DEFECT_RNG *rng) {
+  int           i1, i2, *added, i, isrc, j, nadded;
+  double        p;
+  DEFECT_PATCH *dp_src;
+
+  added = (int *)calloc(dp1->nedges, sizeof(int));
+  p     = defectRandomNumber(rng, 0.0, 1.0);
+  if (p < 0.5) /* add from first defect */
+  {
+    dp_src = dp1;
+  } else {
+    dp_src = dp2;
   }
 
   for (nadded = isrc = i1 = i2 = i = 0; i < dp_dst->nedges; i++) {
@@ -11710,9 +12746,27 @@ static int mrisCrossoverDefectPatches(DEFECT_PATCH *dp1, DEFECT_PATCH *dp2,
 
   return (NO_ERROR);
 }
+static void defectRNGseed(DEFECT_RNG *rng, uint64_t seed, int stream) {
+  rng->state = seed + 0x9e3779b97f4a7c15ULL * (uint64_t)(stream + 1);
+}
+
+/* same as randomNumber, which it falls back on if there is no stream */
+static double defectRandomNumber(DEFECT_RNG *rng, double low, double hi) {
+  uint64_t z;
+
+  if (!rng) {
+    return (randomNumber(low, hi));
+  }
+  z = (rng->state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return (low + (hi - low) * (double)(z >> 11) / 9007199254740992.0);
+}
+
 #define NTRY 0
 static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
-                                 double pmutation) {
+                                 double pmutation, DEFECT_RNG *rng) {
   int    i, j, eti, etj, tmp, *dp_indices, ntry;
   double p;
   EDGE * e;
@@ -11724,7 +12778,7 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
   }
 
   for (i = 0; i < dp->nedges; i++) {
-    p   = randomNumber(0.0, 1.0);
+    p   = defectRandomNumber(rng, 0.0, 1.0);
     eti = dp->ordering[i];
 
     if (p < pmutation) {
@@ -11734,7 +12788,7 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
                                                                 two */
         {
           ntry = 0;
-          j    = (int)randomNumber(0.0, dp->nedges - .1);
+          j    = (int)defectRandomNumber(rng, 0.0, dp->nedges - .1);
           while (ntry < NTRY) {
             e = &etable->edges[dp->ordering[j]]; /*potential new edge */
             if (e->used != USED_IN_ORIGINAL_TESSELLATION) {
@@ -11742,7 +12796,7 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
             } else {
               break;
             }
-            j = (int)randomNumber(0.0, dp->nedges - .1);
+            j = (int)defectRandomNumber(rng, 0.0, dp->nedges - .1);
           }
           tmp             = dp->ordering[i];
           dp->ordering[i] = dp->ordering[j];
@@ -11750,7 +12804,8 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
         } else /* swap two edges that intersect */
         {
           ntry = 0;
-          j    = (int)randomNumber(0.0, etable->noverlap[eti] - 0.0001);
+          j    = (int)defectRandomNumber(rng, 0.0,
+                                         etable->noverlap[eti] - 0.0001);
           etj  = etable->overlapping_edges[eti][j]; /* index of jth
                                                       overlapping edge */
           j    = dp_indices[etj];                   /* find where it is in this
@@ -11762,7 +12817,8 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
             } else {
               break;
             }
-            j   = (int)randomNumber(0.0, etable->noverlap[eti] - 0.0001);
+            j   = (int)defectRandomNumber(rng, 0.0,
+                                          etable->noverlap[eti] - 0.0001);
             etj = etable->overlapping_edges[eti][j]; /* index of
                                                         jth overlapping
                                                         edge */
@@ -11778,7 +12834,7 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
       } else {
         /* swap any two */
         ntry = 0;
-        j    = (int)randomNumber(0.0, dp->nedges - .1);
+        j    = (int)defectRandomNumber(rng, 0.0, dp->nedges - .1);
         while (ntry < NTRY) {
           e = &etable->edges[dp->ordering[j]]; /*potential new edge */
           if (e->used != USED_IN_ORIGINAL_TESSELLATION) {
@@ -11786,7 +12842,7 @@ static int mrisMutateDefectPatch(DEFECT_PATCH *dp, EDGE_TABLE *etable,
           } else {
             break;
           }
-          j = (int)randomNumber(0.0, dp->nedges - .1);
+          j = (int)defectRandomNumber(rng, 0.0, dp->nedges - .1);
         }
         tmp             = dp->ordering[i];
         dp->ordering[i] = dp->ordering[j];
@@ -12043,33 +13099,67 @@ static float fitness_values[11000];
 static float best_values[11000];
 #endif
 
-static int mrisComputeOptimalRetessellation_wkr(
-    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
-    int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
-    HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
-    HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
-    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms);
+/* seed the stream of a defect from the global generator. Each defect draws
+   one number, in defect order, whether it is searched on its own or along
+   with the other defects of its batch. */
+static void defectSearchInit(DEFECT_SEARCH *ds, int nthreads) {
+  memset(ds, 0, sizeof(*ds));
+  ds->nthreads  = nthreads;
+  ds->threshold = 4.0f;
+  if (!getenv("FREESURFER_OLD_mrisComputeOptimalRetessellation")) {
+    defectRNGseed(&ds->rng, (uint64_t)randomNumber(0.0, 4294967295.0), 0);
+    ds->prng = &ds->rng;
+  }
+}
 
+/* ds is the search of the defect when it was started ahead of time (see
+   mrisSearchDefectBatch), or NULL */
 static int mrisComputeOptimalRetessellation(
     MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
     int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
     HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
     HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
-    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
-  int              result;
-  ROMP_SCOPE_begin result = mrisComputeOptimalRetessellation_wkr(
-      mris, mris_corrected, mri, defect, vertex_trans, et, nedges, es, nes,
-      h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad, mri_gray_white,
-      h_dot, parms);
-  ROMP_SCOPE_end return result;
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds) {
+  DEFECT_SEARCH ds_defect;
+  int           result = NO_ERROR;
+
+  if (!ds) {
+    defectSearchInit(&ds_defect, omp_get_max_threads());
+    ds = &ds_defect;
+  }
+
+  ROMP_SCOPE_begin
+
+  if (!ds->selected) {
+    result = mrisSearchOptimalRetessellation(
+        mris, mris_corrected, mri, defect, vertex_trans, et, nedges, es, nes,
+        h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
+        mri_gray_white, h_dot, parms, ds);
+  }
+  if (ds->selected) {
+    result = mrisRetessellateSelectedPatch(
+        mris, mris_corrected, mri, defect, vertex_trans, h_k1, h_k2,
+        mri_k1_k2, h_white, h_gray, h_border, h_grad, mri_gray_white, h_dot,
+        parms, ds);
+  }
+
+  ROMP_SCOPE_end
+
+  return result;
 }
 
-static NOINLINE int mrisComputeOptimalRetessellation_wkr(
+/* the genetic search for the best retessellation of the defect. It only
+   changes the defect and its border in mris_corrected, and leaves them as
+   it found them but for the vertices it eliminated. Unless all it has to do
+   is to retessellate the defect as it is, it leaves the selected patch in
+   ds for mrisRetessellateSelectedPatch.
+*/
+static NOINLINE int mrisSearchOptimalRetessellation(
     MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
     int *vertex_trans, EDGE *et, int nedges, ES *es, int nes, HISTOGRAM *h_k1,
     HISTOGRAM *h_k2, MRI *mri_k1_k2, HISTOGRAM *h_white, HISTOGRAM *h_gray,
     HISTOGRAM *h_border, HISTOGRAM *h_grad, MRI *mri_gray_white,
-    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms) {
+    HISTOGRAM *h_dot, TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds) {
   DEFECT_VERTEX_STATE *dvs;
   DEFECT_PATCH         dps1[MAX_PATCHES], dps2[MAX_PATCHES], *dps, *dp,
       *dps_next_generation;
@@ -12092,8 +13182,13 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
   RP            rp;
   int           number_of_patches, nbestpatch;
   int           ncross_overs, ntotalcross_overs, ntotalmutations, nmutations;
-  int           nintersections;
   static int    first_time = 1;
+  int           old_search, njobs, parents[MAX_PATCHES][2];
+  int           max_unchanged, count = 1;
+  uint64_t      seed;
+  DEFECT_RNG *const rng = ds->prng;
+  DEFECT_RNG    rngs[MAX_PATCHES];
+  DEFECT_FITNESS_JOB jobs[2 * MAX_PATCHES];
 
   nbestpatch = number_of_patches = 0;
   ncross_overs = nmutations = 0;
@@ -12143,6 +13238,9 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
   }
 
   if (!max_patches) {
+#ifdef HAVE_OPENMP
+#pragma omp atomic
+#endif
     dno++; /* for debugging */
     // mrisRetessellateDefect(mris, mris_corrected,
     // defect, vertex_trans, et, nedges, NULL, NULL) ;
@@ -12153,6 +13251,9 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
     return (NO_ERROR);
   }
 
+#ifdef HAVE_OPENMP
+#pragma omp atomic
+#endif
   dno++; /* for debugging */
 
   if (nedges > 200000) {
@@ -12282,6 +13383,13 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
       dvs = mrisRecordVertexState(mris_corrected, defect, vertex_trans);
   dps     = dps1;
 
+  /* the search eliminates vertices by ripping them: keep what they were */
+  ds->ripflags = (char *)malloc(defect->nvertices * sizeof(char));
+  for (i = 0; i < defect->nvertices; i++) {
+    k               = vertex_trans[defect->vertices[i]];
+    ds->ripflags[i] = k < 0 ? 0 : mris_corrected->vertices[k].ripflag;
+  }
+
   ngenerations      = 0;
   last_euthanasia   = -1;
   number_of_patches = 0;
@@ -12300,10 +13408,21 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
   ROMP_SCOPE_end
 
       ComputeDefectContext computeDefectContext;
+  DEFECT_FITNESS_CACHE   fitness_cache;
+  DEFECT_FITNESS_POOL    fitness_pool;
 
   ROMP_SCOPE_begin
 
       constructComputeDefectContext(&computeDefectContext);
+  defectFitnessCacheInit(&fitness_cache, defect);
+  defectFitnessPoolInit(&fitness_pool, mris_corrected, &etable,
+                        mri_defect_sign, &computeDefectContext, defect,
+                        max_patches, ds->nthreads);
+
+  /* the mutations of the children draw from streams of their own, so that
+     they can be scored before knowing which of them are needed */
+  old_search =
+      getenv("FREESURFER_OLD_mrisComputeOptimalRetessellation") != NULL;
 
   /* generate initial population of patches */
   if (parms->initial_selection) {
@@ -12376,12 +13495,22 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
       dp->mri = mri;
 
       /* generate ordering from edge segmentation */
-      generateOrdering(dp, segmentation, i);
+      generateOrdering(dp, segmentation, i, rng);
+      jobs[i].dp  = dp;
+      jobs[i].rng = NULL;
+    }
+    mrisPrefetchDefectPatchFitness(
+        &fitness_pool, &fitness_cache, jobs, max_patches, mris, mri,
+        vertex_trans, dvs, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+        h_grad, mri_gray_white, h_dot, parms);
 
-      fitness = mrisDefectPatchFitness(
-          &computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans,
-          dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-          mri_gray_white, h_dot, parms);
+    for (i = 0; i < max_patches; i++) {
+      dp = &dps1[i];
+
+      fitness = mrisDefectPatchFitnessCached(
+          &fitness_cache, &computeDefectContext, mris, mris_corrected, mri,
+          dp, vertex_trans, dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray,
+          h_border, h_grad, mri_gray_white, h_dot, parms);
 
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
@@ -12544,13 +13673,23 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
 
       if (i) /* first one is in same order as original edge table */
       {
-        mrisMutateDefectPatch(dp, &etable, MUTATION_PCT_INIT);
+        mrisMutateDefectPatch(dp, &etable, MUTATION_PCT_INIT, rng);
       }
+      jobs[i].dp  = dp;
+      jobs[i].rng = NULL;
+    }
+    mrisPrefetchDefectPatchFitness(
+        &fitness_pool, &fitness_cache, jobs, max_patches, mris, mri,
+        vertex_trans, dvs, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+        h_grad, mri_gray_white, h_dot, parms);
 
-      fitness = mrisDefectPatchFitness(
-          &computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans,
-          dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-          mri_gray_white, h_dot, parms);
+    for (i = 0; i < max_patches; i++) {
+      dp = &dps1[i];
+
+      fitness = mrisDefectPatchFitnessCached(
+          &fitness_cache, &computeDefectContext, mris, mris_corrected, mri,
+          dp, vertex_trans, dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray,
+          h_border, h_grad, mri_gray_white, h_dot, parms);
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
       if (number_of_patches)
@@ -12751,15 +13890,25 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
 
         /* now replace the worst ones with mutated copies of the best */
         for (i = 0; i < nreplacements; i++) {
+      dp = &dps_next_generation[next_gen_index + i];
+      mrisCopyDefectPatch(&dps[ranks[i]], dp);
+      mrisMutateDefectPatch(dp, &etable, MUTATION_PCT, rng);
+      jobs[i].dp  = dp;
+      jobs[i].rng = NULL;
+    }
+    mrisPrefetchDefectPatchFitness(
+        &fitness_pool, &fitness_cache, jobs, nreplacements, mris, mri,
+        vertex_trans, dvs, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+        h_grad, mri_gray_white, h_dot, parms);
+
+    for (i = 0; i < nreplacements; i++) {
       ntotalmutations++;
 
       dp = &dps_next_generation[next_gen_index++];
-      mrisCopyDefectPatch(&dps[ranks[i]], dp);
-      mrisMutateDefectPatch(dp, &etable, MUTATION_PCT);
-      fitness = mrisDefectPatchFitness(
-          &computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans,
-          dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-          mri_gray_white, h_dot, parms);
+      fitness = mrisDefectPatchFitnessCached(
+          &fitness_cache, &computeDefectContext, mris, mris_corrected, mri,
+          dp, vertex_trans, dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray,
+          h_border, h_grad, mri_gray_white, h_dot, parms);
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
       if (number_of_patches)
@@ -12813,7 +13962,7 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
             savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
           }
         }
-        nmut++;
+        ds->nmut++;
         if (++nbest == debug_patch_n) {
           dps = dps_next_generation;
           goto debug_use_this_patch;
@@ -12894,7 +14043,7 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
     for (; l < ncrossovers; l++) /* fill out rest of list */
     {
       double p;
-      p = randomNumber(0.0, 1.0);
+      p = defectRandomNumber(rng, 0.0, 1.0);
       for (fitness = 0.0, j = 0; j < nselected; j++) {
         i        = ranks[j];
         dp       = &dps[i];
@@ -12907,26 +14056,61 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
       selected[l] = i;
     }
 
+    /* draw all the children and their mutations first, and score them
+       at once */
+    if (!old_search) {
+      seed  = (uint64_t)defectRandomNumber(rng, 0.0, 4294967295.0);
+      njobs = 0;
+      for (i = 0; i < ncrossovers; i++) {
+        parents[i][0] = selected[i];
+        do /* select second parent at random */
+        {
+          parents[i][1] =
+              selected[(int)defectRandomNumber(rng, 0, ncrossovers - .001)];
+        } while (parents[i][1] == parents[i][0]);
+
+        dp = &dps_next_generation[next_gen_index + i];
+        mrisCrossoverDefectPatches(&dps[parents[i][0]], &dps[parents[i][1]],
+                                   dp, &etable, rng);
+        defectRNGseed(&rngs[i], seed, i);
+        jobs[njobs].dp    = dp;
+        jobs[njobs++].rng = NULL;
+        jobs[njobs].dp    = dp;
+        jobs[njobs++].rng = &rngs[i];
+      }
+      mrisPrefetchDefectPatchFitness(
+          &fitness_pool, &fitness_cache, jobs, njobs, mris, mri,
+          vertex_trans, dvs, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border,
+          h_grad, mri_gray_white, h_dot, parms);
+    }
+
     ROMP_SCOPE_end ROMP_SCOPE_begin
 
         for (i = 0; i < ncrossovers; i++) {
       int p1, p2;
       ntotalcross_overs++;
 
-      p1 = selected[i];
-      do /* select second parent at random */
-      {
-        p2 = selected[(int)randomNumber(0, ncrossovers - .001)];
-      } while (p2 == p1);
+      if (old_search) {
+        p1 = selected[i];
+        do /* select second parent at random */
+        {
+          p2 = selected[(int)defectRandomNumber(rng, 0, ncrossovers - .001)];
+        } while (p2 == p1);
+      } else {
+        p1 = parents[i][0];
+        p2 = parents[i][1];
+      }
 
       ROMP_SCOPE_begin
 
           dp = &dps_next_generation[next_gen_index++];
-      mrisCrossoverDefectPatches(&dps[p1], &dps[p2], dp, &etable);
-      fitness = mrisDefectPatchFitness(
-          &computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans,
-          dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-          mri_gray_white, h_dot, parms);
+      if (old_search) {
+        mrisCrossoverDefectPatches(&dps[p1], &dps[p2], dp, &etable, rng);
+      }
+      fitness = mrisDefectPatchFitnessCached(
+          &fitness_cache, &computeDefectContext, mris, mris_corrected, mri,
+          dp, vertex_trans, dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray,
+          h_border, h_grad, mri_gray_white, h_dot, parms);
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
       if (number_of_patches)
@@ -12991,7 +14175,7 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
 
         ROMP_SCOPE_end
 
-            ncross++;
+            ds->ncross++;
         if (++nbest == debug_patch_n) {
           dps = dps_next_generation;
           goto debug_use_this_patch;
@@ -13001,11 +14185,12 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
       {
         ROMP_SCOPE_begin
 
-            mrisMutateDefectPatch(dp, &etable, MUTATION_PCT);
-        fitness = mrisDefectPatchFitness(
-            &computeDefectContext, mris, mris_corrected, mri, dp, vertex_trans,
-            dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad,
-            mri_gray_white, h_dot, parms);
+            mrisMutateDefectPatch(dp, &etable, MUTATION_PCT,
+                                  old_search ? NULL : &rngs[i]);
+        fitness = mrisDefectPatchFitnessCached(
+            &fitness_cache, &computeDefectContext, mris, mris_corrected, mri,
+            dp, vertex_trans, dvs, &rp, h_k1, h_k2, mri_k1_k2, h_white, h_gray,
+            h_border, h_grad, mri_gray_white, h_dot, parms);
 #if SAVE_FIT_VALS
         fitness_values[number_of_patches] = fitness;
         if (number_of_patches)
@@ -13069,8 +14254,8 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
             dps = dps_next_generation;
             goto debug_use_this_patch;
           }
-          nmut++;
-          ncross++;
+          ds->nmut++;
+          ds->ncross++;
         }
 
         ROMP_SCOPE_end
@@ -13129,8 +14314,7 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
 #define NEXT 5
 
     if (parms->vertex_eliminate) {
-      static int count = 1;
-      int        ndeleted;
+      int ndeleted;
       if (nunchanged >= max_unchanged) {
         // will eventually break out
         if (last_euthanasia < 0) {
@@ -13150,7 +14334,8 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
           fprintf(WHICH_OUTPUT, "Deleting worst vertices : ");
         }
         ndeleted = deleteWorstVertices(mris_corrected, &rp, defect,
-                                       vertex_trans, 0.2, count);
+                                       vertex_trans, 0.2, count,
+                                       old_search ? NULL : &ds->threshold);
         nremovedvertices += ndeleted;
         if (parms->verbose == VERBOSE_MODE_LOW) {
           fprintf(WHICH_OUTPUT, "%d vertices have been deleted\n", ndeleted);
@@ -13161,7 +14346,8 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
         count++;
       } else if (ngenerations >= 10 && (ngenerations % 3 == 0)) {
         ndeleted = deleteWorstVertices(mris_corrected, &rp, defect,
-                                       vertex_trans, 0.1, count);
+                                       vertex_trans, 0.1, count,
+                                       old_search ? NULL : &ds->threshold);
         nremovedvertices += ndeleted;
         if (parms->verbose == VERBOSE_MODE_LOW) {
           if (ndeleted == 1) {
@@ -13221,11 +14407,102 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
     MRISwriteCurvature(mris, fname);
   }
 
-  nkilled += nfinalvertices;
+  /* hand the selected patch over to mrisRetessellateSelectedPatch */
+  ds->selected          = 1;
+  ds->dp                = *dp;
+  ds->rp                = rp;
+  ds->etable            = etable;
+  ds->mri_defect        = mri_defect;
+  ds->mri_defect_white  = mri_defect_white;
+  ds->mri_defect_gray   = mri_defect_gray;
+  ds->mri_defect_sign   = mri_defect_sign;
+  ds->best_fitness      = best_fitness;
+  ds->nmutations        = nmutations;
+  ds->ntotalmutations   = ntotalmutations;
+  ds->ncross_overs      = ncross_overs;
+  ds->ntotalcross_overs = ntotalcross_overs;
+  ds->nfinalvertices    = nfinalvertices;
+  ds->nbestpatch        = nbestpatch;
+  ds->number_of_patches = number_of_patches;
+
+  ROMP_SCOPE_end ROMP_SCOPE_begin
+
+      /* free everything but what was handed over */
+      destructComputeDefectContext(&computeDefectContext);
+  defectFitnessCacheFree(&fitness_cache);
+  defectFitnessPoolFree(&fitness_pool);
+  mrisFreeDefectVertexState(dvs);
+
+  for (i = 0; i < max_patches; i++) {
+    if (dps1[i].ordering != dp->ordering) {
+      free(dps1[i].ordering);
+    }
+    if (dps2[i].ordering != dp->ordering) {
+      free(dps2[i].ordering);
+    }
+  }
+
+#if SAVE_FIT_VALS
+  {
+    FILE *f;
+    int   n;
+    f = fopen("./optimal1.plt", "w+");
+    for (n = 0; n < number_of_patches; n++) {
+      fprintf(f, "%d %2.2f\n", n, fitness_values[n]);
+    }
+    fclose(f);
+    f = fopen("./optimal2.plt", "w+");
+    for (n = 0; n < number_of_patches; n++) {
+      fprintf(f, "%d %2.2f\n", n, best_values[n]);
+    }
+    fclose(f);
+  }
+#endif
+
+  ROMP_SCOPE_end
+
+      return (NO_ERROR);
+}
+
+/* retessellate the defect with the patch selected by its search. The search
+   may have run on a copy of the corrected surface, before the preceding
+   defects were retessellated: the state of the defect vertices is taken
+   again from mris_corrected.
+*/
+static int mrisRetessellateSelectedPatch(
+    MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, DEFECT *defect,
+    int *vertex_trans, HISTOGRAM *h_k1, HISTOGRAM *h_k2, MRI *mri_k1_k2,
+    HISTOGRAM *h_white, HISTOGRAM *h_gray, HISTOGRAM *h_border,
+    HISTOGRAM *h_grad, MRI *mri_gray_white, HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms, DEFECT_SEARCH *ds) {
+  DEFECT_VERTEX_STATE *dvs;
+  DEFECT_PATCH *const  dp     = &ds->dp;
+  int const            nedges = dp->nedges;
+  int                  i, k, nintersections;
+  double               fitness;
+  ComputeDefectContext computeDefectContext;
+
+  ROMP_SCOPE_begin
+
+  dp->etable = &ds->etable;
+
+  /* the vertices eliminated by the search are ripped below */
+  for (i = 0; i < defect->nvertices; i++) {
+    k = vertex_trans[defect->vertices[i]];
+    if (k >= 0) {
+      mris_corrected->vertices[k].ripflag = ds->ripflags[i];
+    }
+  }
+  dvs = mrisRecordVertexState(mris_corrected, defect, vertex_trans);
+  constructComputeDefectContext(&computeDefectContext);
+
+  nkilled += ds->nfinalvertices;
+  nmut += ds->nmut;
+  ncross += ds->ncross;
 
   /* use the best ordering to retessellate the defected patch */
-  memmove(dp->ordering, rp.best_ordering, nedges * sizeof(int));
-  memmove(defect->status, rp.status, defect->nvertices * sizeof(char));
+  memmove(dp->ordering, ds->rp.best_ordering, nedges * sizeof(int));
+  memmove(defect->status, ds->rp.status, defect->nvertices * sizeof(char));
 
   /* set back to unrip the correct vertices*/
   for (i = 0; i < defect->nvertices; i++) {
@@ -13246,15 +14523,15 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
 
       fitness =
           mrisDefectPatchFitness(&computeDefectContext, mris, mris_corrected,
-                                 mri, dp, vertex_trans, dvs, &rp, h_k1, h_k2,
-                                 mri_k1_k2, h_white, h_gray, h_border, h_grad,
-                                 mri_gray_white, h_dot, parms);
+                                 mri, dp, vertex_trans, dvs, &ds->rp, h_k1,
+                                 h_k2, mri_k1_k2, h_white, h_gray, h_border,
+                                 h_grad, mri_gray_white, h_dot, parms);
 
   defect->fitness = fitness; /* saving the fitness of the patch */
 
-  if (fitness != best_fitness)
+  if (fitness != ds->best_fitness)
     fprintf(WHICH_OUTPUT, "Warning - incorrect dp selected!!!!(%f >= %f ) \n",
-            fitness, best_fitness);
+            fitness, ds->best_fitness);
 
   if (parms->verbose == VERBOSE_MODE_LOW) {
     printDefectStatistics(dp);
@@ -13295,14 +14572,14 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
             "PATCH #:%03d:  FITNESS:   %2.2f\n              "
             "MUTATIONS: %d (out of %d)\n              "
             "CROSSOVERS: %d (out of %d)\n",
-            defect->defect_number, fitness, nmutations, ntotalmutations,
-            ncross_overs, ntotalcross_overs);
+            defect->defect_number, fitness, ds->nmutations,
+            ds->ntotalmutations, ds->ncross_overs, ds->ntotalcross_overs);
     fprintf(WHICH_OUTPUT,
             "              ELIMINATED VERTICES:  %d (out of %d)\n",
-            nfinalvertices, defect->nvertices);
+            ds->nfinalvertices, defect->nvertices);
     fprintf(WHICH_OUTPUT,
             "              BEST PATCH #: %d (out of %d generated patches)\n",
-            nbestpatch, number_of_patches);
+            ds->nbestpatch, ds->number_of_patches);
     if (parms->check_surface_intersection)
       fprintf(WHICH_OUTPUT,
               "              NUMBER OF INTERSECTING FACES: %d (out of %d) \n",
@@ -13346,57 +14623,38 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(
       destructComputeDefectContext(&computeDefectContext);
   mrisFreeDefectVertexState(dvs);
 
-  for (i = 0; i < max_patches; i++) {
-    free(dps1[i].ordering);
-    free(dps2[i].ordering);
-  }
-
-  if (etable.use_overlap) {
+  if (ds->etable.use_overlap) {
     for (i = 0; i < nedges; i++) {
-      if (etable.overlapping_edges[i]) {
-        free(etable.overlapping_edges[i]);
+      if (ds->etable.overlapping_edges[i]) {
+        free(ds->etable.overlapping_edges[i]);
       }
     }
-    free(etable.overlapping_edges);
-    free(etable.noverlap);
-    free(etable.flags);
+    free(ds->etable.overlapping_edges);
+    free(ds->etable.noverlap);
+    free(ds->etable.flags);
   }
-  free(etable.edges);
+  free(ds->etable.edges);
+  free(dp->ordering);
 
-  free(rp.best_ordering);
-  free(rp.status);
-  free(rp.nused);
-  free(rp.vertex_fitness);
+  free(ds->rp.best_ordering);
+  free(ds->rp.status);
+  free(ds->rp.nused);
+  free(ds->rp.vertex_fitness);
+  free(ds->ripflags);
 
-  if (mri_defect) {
-    MRIfree(&mri_defect);
+  if (ds->mri_defect) {
+    MRIfree(&ds->mri_defect);
   }
-  if (mri_defect_white) {
-    MRIfree(&mri_defect_white);
-  }
-  if (mri_defect_gray) {
-    MRIfree(&mri_defect_gray);
+  if (ds->mri_defect_white) {
+    MRIfree(&ds->mri_defect_white);
   }
-  if (mri_defect_sign) {
-    MRIfree(&mri_defect_sign);
+  if (ds->mri_defect_gray) {
+    MRIfree(&ds->mri_defect_gray);
   }
-
-#if SAVE_FIT_VALS
-  {
-    FILE *f;
-    int   n;
-    f = fopen("./optimal1.plt", "w+");
-    for (n = 0; n < number_of_patches; n++) {
-      fprintf(f, "%d %2.2f\n", n, fitness_values[n]);
-    }
-    fclose(f);
-    f = fopen("./optimal2.plt", "w+");
-    for (n = 0; n < number_of_patches; n++) {
-      fprintf(f, "%d %2.2f\n", n, best_values[n]);
-    }
-    fclose(f);
+  if (ds->mri_defect_sign) {
+    MRIfree(&ds->mri_defect_sign);
   }
-#endif
+  ds->selected = 0;
 
   ROMP_SCOPE_end
 
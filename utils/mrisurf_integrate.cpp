@@ -577,17 +577,18 @@ int MRISintegrate(MRI_SURFACE *mris, INTEGRATION_PARMS *parms, int n_averages) {
 
     mrisComputeLaplacianTerm(mris, parms->l_lap);
     MRISaverageGradients(mris, n_averages);
-    mrisComputeSpringTerm(mris, parms->l_spring);
+    {
+      static MRIS_LOCAL_TERM const terms[] = {
+          MRIS_LOCAL_SPRING, MRIS_LOCAL_TANGENTIAL_SPRING,
+          MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING, MRIS_LOCAL_NONLINEAR_SPRING};
+      mrisComputeLocalTerms(mris, parms, terms,
+                            sizeof(terms) / sizeof(terms[0]));
+    }
     mrisComputeThicknessMinimizationTerm(mris, parms->l_thick_min, parms);
     mrisComputeThicknessParallelTerm(mris, parms->l_thick_parallel, parms);
     mrisComputeThicknessNormalTerm(mris, parms->l_thick_normal, parms);
     mrisComputeThicknessSpringTerm(mris, parms->l_thick_spring, parms);
     mrisComputeAshburnerTriangleTerm(mris, parms->l_ashburner_triangle, parms);
-
-    mrisComputeTangentialSpringTerm(mris, parms->l_tspring);
-    mrisComputeNonlinearTangentialSpringTerm(mris, parms->l_nltspring,
-                                             parms->min_dist);
-    mrisComputeNonlinearSpringTerm(mris, parms->l_nlspring, parms);
     mrisComputeQuadraticCurvatureTerm(mris, parms->l_curv);
     if (Gdiag & DIAG_WRITE && parms->write_iterations > 0 && DIAG_VERBOSE_ON) {
       MRI *mri;
@@ -2867,20 +2868,26 @@ int MRISinflateBrain(MRI_SURFACE *mris, INTEGRATION_PARMS *parms) {
       }
 
       MRISclearGradient(mris);
-      mrisComputeDistanceTerm(mris, parms);
-      mrisComputeSphereTerm(mris, parms->l_sphere, parms->a,
-                            parms->explode_flag);
-      mrisComputeExpansionTerm(mris, parms->l_expand);
+      {
+        static MRIS_LOCAL_TERM const terms[] = {
+            MRIS_LOCAL_DISTANCE, MRIS_LOCAL_SPHERE, MRIS_LOCAL_EXPANSION};
+        mrisComputeLocalTerms(mris, parms, terms,
+                              sizeof(terms) / sizeof(terms[0]));
+      }
 
       MRISaverageGradients(mris, n_averages);
-      mrisComputeNormalSpringTerm(mris, parms->l_nspring);
-      mrisComputeNonlinearSpringTerm(mris, parms->l_nlspring, parms);
-      mrisComputeTangentialSpringTerm(mris, parms->l_tspring);
-      mrisComputeNonlinearTangentialSpringTerm(mris, parms->l_nltspring,
-                                               parms->min_dist);
+      {
+        static MRIS_LOCAL_TERM const terms[] = {
+            MRIS_LOCAL_NORMAL_SPRING,
+            MRIS_LOCAL_NONLINEAR_SPRING,
+            MRIS_LOCAL_TANGENTIAL_SPRING,
+            MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING,
+            MRIS_LOCAL_SPRING,
+            MRIS_LOCAL_LAPLACIAN};
+        mrisComputeLocalTerms(mris, parms, terms,
+                              sizeof(terms) / sizeof(terms[0]));
+      }
       mrisComputeQuadraticCurvatureTerm(mris, parms->l_curv);
-      mrisComputeSpringTerm(mris, parms->l_spring);
-      mrisComputeLaplacianTerm(mris, parms->l_lap);
       mrisComputeNormalizedSpringTerm(mris, parms->l_spring_norm);
 
       double delta_t;
@@ -3055,19 +3062,22 @@ int MRISinflateToSphere(MRI_SURFACE *mris, INTEGRATION_PARMS *parms) {
             MHTcreateVertexTable_Resolution(mris, CURRENT_VERTICES, 3.0f);
       }
       MRISclearGradient(mris);
-      mrisComputeDistanceTerm(mris, parms);
-      mrisComputeSphereTerm(mris, parms->l_sphere, parms->a,
-                            parms->explode_flag);
-      mrisComputeExpansionTerm(mris, parms->l_expand);
+      {
+        static MRIS_LOCAL_TERM const terms[] = {
+            MRIS_LOCAL_DISTANCE, MRIS_LOCAL_SPHERE, MRIS_LOCAL_EXPANSION};
+        mrisComputeLocalTerms(mris, parms, terms,
+                              sizeof(terms) / sizeof(terms[0]));
+      }
       mrisComputeRepulsiveRatioTerm(mris, parms->l_repulse_ratio,
                                     mht_v_current);
-      mrisComputeConvexityTerm(mris, parms->l_convex);
-
-      mrisComputeLaplacianTerm(mris, parms->l_lap);
-      mrisComputeNonlinearSpringTerm(mris, parms->l_nlspring, parms);
-      mrisComputeTangentialSpringTerm(mris, parms->l_tspring);
-      mrisComputeNonlinearTangentialSpringTerm(mris, parms->l_nltspring,
-                                               parms->min_dist);
+      {
+        static MRIS_LOCAL_TERM const terms[] = {
+            MRIS_LOCAL_CONVEXITY, MRIS_LOCAL_LAPLACIAN,
+            MRIS_LOCAL_NONLINEAR_SPRING, MRIS_LOCAL_TANGENTIAL_SPRING,
+            MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING};
+        mrisComputeLocalTerms(mris, parms, terms,
+                              sizeof(terms) / sizeof(terms[0]));
+      }
       MRISaverageGradients(mris, n_averages);
       mrisComputeSpringTerm(mris, parms->l_spring);
       mrisComputeNormalizedSpringTerm(mris, parms->l_spring_norm);
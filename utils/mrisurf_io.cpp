@@ -22,6 +22,12 @@
 
 #include "mrisurf_base.h"
 
+#include <vector>
+
+/* (vno, annotation) pairs read per fread, which bounds what a corrupt
+   count in an annotation file can make us allocate */
+#define ANNOT_PAIRS_PER_READ 65536
+
 #define QUAD_FILE_MAGIC_NUMBER     (-1 & 0x00ffffff)
 #define TRIANGLE_FILE_MAGIC_NUMBER (-2 & 0x00ffffff)
 #define NEW_QUAD_FILE_MAGIC_NUMBER (-3 & 0x00ffffff)
@@ -260,7 +266,6 @@ save in VTK as well.
 */
 int MRISwriteCurvature(MRI_SURFACE *mris, const char *sname) {
   int         k, mritype;
-  float       curv;
   char        fname[STRLEN], path[STRLEN], name[STRLEN];
   const char *hemi;
   const char *cp;
@@ -378,10 +383,11 @@ int MRISwriteCurvature(MRI_SURFACE *mris, const char *sname) {
   fwriteInt(mris->nvertices, fp);
   fwriteInt(mris->nfaces, fp);
   fwriteInt(1, fp); /* 1 value per vertex */
+  std::vector<float> curvs(mris->nvertices);
   for (k = 0; k < mris->nvertices; k++) {
-    curv = mris->vertices[k].curv;
-    fwriteFloat(curv, fp);
+    curvs[k] = mris->vertices[k].curv;
   }
+  fwriteFloatArray(curvs.data(), curvs.size(), fp);
   fclose(fp);
   return (NO_ERROR);
 }
@@ -1487,12 +1493,19 @@ int MRISreadAnnotation(MRI_SURFACE *mris, const char *sname) {
 
   /* If we got an array, fill in our annotation values. */
   MRISclearAnnotations(mris);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
     if (vno == Gdiag_no) {
       DiagBreak();
     }
     mris->vertices[vno].annotation = array[vno];
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   /* Try to read in a color table. If we read one, it will be
      allocated, otherwise it will stay NULL. */
@@ -1522,9 +1535,10 @@ int MRISreadAnnotation(MRI_SURFACE *mris, const char *sname) {
  ------------------------------------------------------*/
 int MRISreadAnnotationIntoArray(const char *fname, int in_array_size,
                                 int **out_array) {
-  int   i, j, vno, num;
-  FILE *fp;
-  int * array = NULL;
+  int    i, j, k, vno, num, npairs;
+  size_t nread;
+  FILE * fp;
+  int *  array = NULL;
 
   if (fname == NULL || out_array == NULL)
     ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "Parameter was NULL."));
@@ -1550,33 +1564,46 @@ int MRISreadAnnotationIntoArray(const char *fname, int in_array_size,
   /* First int is the number of elements. */
   num = freadInt(fp);
 
-  /* For each one, read in a vno and an int for the annotation
-     value. Check the vno. */
-  for (j = 0; j < num; j++) {
-    vno = freadInt(fp);
-    i   = freadInt(fp);
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
+  /* The (vno, annotation) pairs are read in chunks, which stop at the
+     end of a truncated file whatever the count says. */
+  std::vector<int> pairs(2 * (size_t)std::min(std::max(num, 0),
+                                              ANNOT_PAIRS_PER_READ));
+  for (j = 0; j < num; j += npairs) {
+    npairs = std::min(num - j, ANNOT_PAIRS_PER_READ);
+    nread  = freadIntArray(pairs.data(), 2 * (size_t)npairs, fp);
+    if (nread < 2 * (size_t)npairs) {
+      npairs = nread / 2;
+      num    = j + npairs; /* stop after this chunk */
+    }
+
+    /* For each one, get the vno and the int for the annotation
+       value. Check the vno. */
+    for (k = 0; k < npairs; k++) {
+      vno = pairs[2 * (size_t)k];
+      i   = pairs[2 * (size_t)k + 1];
+      if (vno == Gdiag_no) {
+        DiagBreak();
+      }
 
-    /* Check the index we read to make sure it's less than the size
-       we're expecting. */
-    if (vno >= in_array_size || vno < 0) {
-      fprintf(stderr,
-              "MRISreadAnnotationIntoArray: vertex index out of range: "
-              "%d i=%8.8X, in_array_size=%d\n",
-              vno, i, in_array_size);
-      fprintf(stderr, "    annot file: %s\n", fname);
-
-      static int vertexIndexOutOfRangeCounter = 0;
-      if (++vertexIndexOutOfRangeCounter > 200000) {
-        // this check prevents creating 100GB error files
-        ErrorExit(ERROR_BADFILE,
-                  "ERROR: Too many out-of-range vertex indices in "
-                  "MRISreadAnnotationIntoArray!\n");
+      /* Check the index we read to make sure it's less than the size
+         we're expecting. */
+      if (vno >= in_array_size || vno < 0) {
+        fprintf(stderr,
+                "MRISreadAnnotationIntoArray: vertex index out of range: "
+                "%d i=%8.8X, in_array_size=%d\n",
+                vno, i, in_array_size);
+        fprintf(stderr, "    annot file: %s\n", fname);
+
+        static int vertexIndexOutOfRangeCounter = 0;
+        if (++vertexIndexOutOfRangeCounter > 200000) {
+          // this check prevents creating 100GB error files
+          ErrorExit(ERROR_BADFILE,
+                    "ERROR: Too many out-of-range vertex indices in "
+                    "MRISreadAnnotationIntoArray!\n");
+        }
+      } else {
+        array[vno] = i;
       }
-    } else {
-      array[vno] = i;
     }
   }
 
@@ -1728,7 +1755,7 @@ int MRISisCTABPresentInAnnotation(const char *fname, int *present) {
   Description
   ------------------------------------------------------*/
 int MRISwriteAnnotation(MRI_SURFACE *mris, const char *sname) {
-  int         i, vno, need_hemi;
+  int         vno, need_hemi;
   FILE *      fp;
   const char *cp;
   char        fname[STRLEN], path[STRLEN], fname_no_path[STRLEN];
@@ -1798,14 +1825,15 @@ int MRISwriteAnnotation(MRI_SURFACE *mris, const char *sname) {
     ErrorReturn(ERROR_NOFILE,
                 (ERROR_NOFILE, "could not write annot file %s", fname));
   fwriteInt(mris->nvertices, fp);
+  std::vector<int> pairs(2 * (size_t)mris->nvertices);
   for (vno = 0; vno < mris->nvertices; vno++) {
     if (vno == Gdiag_no) {
       DiagBreak();
     }
-    i = mris->vertices[vno].annotation;
-    fwriteInt(vno, fp);
-    i = fwriteInt(i, fp);
+    pairs[2 * (size_t)vno]     = vno;
+    pairs[2 * (size_t)vno + 1] = mris->vertices[vno].annotation;
   }
+  fwriteIntArray(pairs.data(), pairs.size(), fp);
 
   if (mris->ct) /* also write annotation in */
   {
@@ -5456,15 +5484,23 @@ int MRISwriteTriangularSurface(MRI_SURFACE *mris, const char *fname) {
   fwriteInt(mris->nvertices, fp);
   fwriteInt(mris->nfaces, fp); /* # of triangles */
 
-  for (int k = 0; k < mris->nvertices; k++) {
-    fwriteFloat(mris->vertices[k].x, fp);
-    fwriteFloat(mris->vertices[k].y, fp);
-    fwriteFloat(mris->vertices[k].z, fp);
+  {
+    std::vector<float> xyz(3 * (size_t)mris->nvertices);
+    for (int k = 0; k < mris->nvertices; k++) {
+      xyz[3 * (size_t)k]     = mris->vertices[k].x;
+      xyz[3 * (size_t)k + 1] = mris->vertices[k].y;
+      xyz[3 * (size_t)k + 2] = mris->vertices[k].z;
+    }
+    fwriteFloatArray(xyz.data(), xyz.size(), fp);
   }
-  for (int k = 0; k < mris->nfaces; k++) {
-    for (int n = 0; n < VERTICES_PER_FACE; n++) {
-      fwriteInt(mris->faces[k].v[n], fp);
+  {
+    std::vector<int> fv(VERTICES_PER_FACE * (size_t)mris->nfaces);
+    for (int k = 0; k < mris->nfaces; k++) {
+      for (int n = 0; n < VERTICES_PER_FACE; n++) {
+        fv[VERTICES_PER_FACE * (size_t)k + n] = mris->faces[k].v[n];
+      }
     }
+    fwriteIntArray(fv.data(), fv.size(), fp);
   }
   /* write whether vertex data was using
      the real RAS rather than conformed RAS */
@@ -5493,6 +5529,31 @@ int MRISwriteTriangularSurface(MRI_SURFACE *mris, const char *fname) {
   return (NO_ERROR);
 }
 
+/* exits on the first coordinate of a triangle file vertex block that is
+   out of range, in file order */
+static void mrisCheckTriangleFileXYZ(const float *xyz, int nvertices,
+                                     bool progress) {
+  int vno;
+
+  for (vno = 0; vno < nvertices; vno++) {
+    if (progress && vno % 100 == 0)
+      exec_progress_callback(vno, nvertices, 0, 1);
+    if (vno == Gdiag_no) {
+      DiagBreak();
+    }
+    float const *p = &xyz[3 * (size_t)vno];
+    if (fabs(p[0]) > 10000 || !std::isfinite(p[0]))
+      ErrorExit(ERROR_BADFILE, "%s: vertex %d x coordinate %f!", Progname, vno,
+                p[0]);
+    if (fabs(p[1]) > 10000 || !std::isfinite(p[1]))
+      ErrorExit(ERROR_BADFILE, "%s: vertex %d y coordinate %f!", Progname, vno,
+                p[1]);
+    if (fabs(p[2]) > 10000 || !std::isfinite(p[2]))
+      ErrorExit(ERROR_BADFILE, "%s: vertex %d z coordinate %f!", Progname, vno,
+                p[2]);
+  }
+}
+
 /*-----------------------------------------------------
   Parameters:
 
@@ -5502,7 +5563,6 @@ int MRISwriteTriangularSurface(MRI_SURFACE *mris, const char *fname) {
   ------------------------------------------------------*/
 static SMALL_SURFACE *
 mrisReadTriangleFileVertexPositionsOnly(const char *fname) {
-  SMALL_VERTEX * v;
   int            nvertices, nfaces, magic, vno;
   char           line[STRLEN];
   FILE *         fp;
@@ -5536,24 +5596,22 @@ mrisReadTriangleFileVertexPositionsOnly(const char *fname) {
     ErrorReturn(NULL, (ERROR_NOMEMORY,
                        "MRISreadVerticesOnly: could not allocate surface"));
   }
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
+  mrisCheckTriangleFileXYZ(xyz.data(), nvertices, false);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (vno = 0; vno < nvertices; vno++) {
-    v = &mriss->vertices[vno];
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-    v->x = freadFloat(fp);
-    v->y = freadFloat(fp);
-    v->z = freadFloat(fp);
-    if (fabs(v->x) > 10000 || !std::isfinite(v->x))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d x coordinate %f!", Progname, vno,
-                v->x);
-    if (fabs(v->y) > 10000 || !std::isfinite(v->y))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d y coordinate %f!", Progname, vno,
-                v->y);
-    if (fabs(v->z) > 10000 || !std::isfinite(v->z))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d z coordinate %f!", Progname, vno,
-                v->z);
-  }
+    ROMP_PFLB_begin
+    SMALL_VERTEX *const vs = &mriss->vertices[vno];
+    vs->x                  = xyz[3 * (size_t)vno];
+    vs->y                  = xyz[3 * (size_t)vno + 1];
+    vs->z                  = xyz[3 * (size_t)vno + 2];
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
   fclose(fp);
   return (mriss);
 }
@@ -5599,12 +5657,19 @@ static int mrisReadTriangleFilePositions(MRI_SURFACE *mris, const char *fname) {
   // MRISsetXYZ will invalidate all of these,
   // so make sure they are recomputed before being used again!
 
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (vno = 0; vno < nvertices; vno++) {
-    float x = freadFloat(fp);
-    float y = freadFloat(fp);
-    float z = freadFloat(fp);
-    MRISsetXYZ(mris, vno, x, y, z);
+    ROMP_PFLB_begin
+    float const *p = &xyz[3 * (size_t)vno];
+    MRISsetXYZ(mris, vno, p[0], p[1], p[2]);
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
   fclose(fp);
   return (NO_ERROR);
@@ -5654,44 +5719,57 @@ static MRI_SURFACE *mrisReadTriangleFile(const char *fname,
                              nvertices, nfaces);
   mris->type = MRIS_TRIANGULAR_SURFACE;
 
+  // the vertex and face blocks are each read with a single fread and
+  // byte-swapped in place, rather than with one stdio call per value
+  std::vector<float> xyz(3 * (size_t)nvertices);
+  freadFloatArray(xyz.data(), xyz.size(), fp);
+
+  // the staging arrays are checked in file order, so the first bad value
+  // is the one reported, and then copied into the surface in parallel
+  mrisCheckTriangleFileXYZ(xyz.data(), nvertices, true);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
   for (vno = 0; vno < nvertices; vno++) {
-    if (vno % 100 == 0)
-      exec_progress_callback(vno, nvertices, 0, 1);
-    VERTEX_TOPOLOGY *const vt = &mris->vertices_topology[vno];
-    VERTEX *const          v  = &mris->vertices[vno];
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-
-    float x = freadFloat(fp);
-    float y = freadFloat(fp);
-    float z = freadFloat(fp);
-
-    MRISsetXYZ(mris, vno, x, y, z);
-
-    vt->num = 0; /* will figure it out */
-    if (fabs(v->x) > 10000 || !std::isfinite(v->x))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d x coordinate %f!", Progname, vno,
-                v->x);
-    if (fabs(v->y) > 10000 || !std::isfinite(v->y))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d y coordinate %f!", Progname, vno,
-                v->y);
-    if (fabs(v->z) > 10000 || !std::isfinite(v->z))
-      ErrorExit(ERROR_BADFILE, "%s: vertex %d z coordinate %f!", Progname, vno,
-                v->z);
+    ROMP_PFLB_begin
+    float const *p = &xyz[3 * (size_t)vno];
+    MRISsetXYZ(mris, vno, p[0], p[1], p[2]);
+    mris->vertices_topology[vno].num = 0; /* will figure it out */
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
+
+  std::vector<int> fv(VERTICES_PER_FACE * (size_t)mris->nfaces);
+  freadIntArray(fv.data(), fv.size(), fp);
 
   for (fno = 0; fno < mris->nfaces; fno++) {
-    f = &mris->faces[fno];
     for (n = 0; n < VERTICES_PER_FACE; n++) {
-      f->v[n] = freadInt(fp);
-      if (f->v[n] >= mris->nvertices || f->v[n] < 0)
+      int const v = fv[VERTICES_PER_FACE * (size_t)fno + n];
+      if (v >= mris->nvertices || v < 0)
         ErrorExit(ERROR_BADFILE, "f[%d]->v[%d] = %d - out of range!\n", fno, n,
-                  f->v[n]);
+                  v);
     }
+  }
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    ROMP_PFLB_begin
+    FACE *const face = &mris->faces[fno];
+    for (int m = 0; m < VERTICES_PER_FACE; m++) {
+      face->v[m] = fv[VERTICES_PER_FACE * (size_t)fno + m];
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
 
+  /* the face counts are a scatter, which stays serial */
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    f = &mris->faces[fno];
     for (n = 0; n < VERTICES_PER_FACE; n++) {
-      mris->vertices_topology[mris->faces[fno].v[n]].num++;
+      mris->vertices_topology[f->v[n]].num++;
     }
   }
   // new addition
@@ -5941,10 +6019,13 @@ int MRISreadNewCurvatureFile(MRI_SURFACE *mris, const char *sname) {
          fname, vals_per_vertex));
   }
 
+  std::vector<float> curvs(vnum);
+  freadFloatArray(curvs.data(), curvs.size(), fp);
+
   curvmin = 10000.0f;
   curvmax = -10000.0f; /* for compiler warnings */
   for (k = 0; k < vnum; k++) {
-    curv = freadFloat(fp);
+    curv = curvs[k];
     if (k == 0) {
       curvmin = curvmax = curv;
     }
@@ -5954,8 +6035,17 @@ int MRISreadNewCurvatureFile(MRI_SURFACE *mris, const char *sname) {
     if (curv < curvmin) {
       curvmin = curv;
     }
-    mris->vertices[k].curv = curv;
   }
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (k = 0; k < vnum; k++) {
+    ROMP_PFLB_begin
+    mris->vertices[k].curv = curvs[k];
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
   mris->max_curv = curvmax;
   mris->min_curv = curvmin;
   if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
@@ -6007,7 +6097,7 @@ float *MRISreadNewCurvatureVector(MRI_SURFACE *mris, const char *sname) {
 
 int MRISreadNewCurvatureIntoArray(const char *sname, int in_array_size,
                                   float **out_array) {
-  int    k, vnum, fnum;
+  int    vnum, fnum;
   float *cvec;
   FILE * fp;
   int    vals_per_vertex;
@@ -6060,9 +6150,7 @@ int MRISreadNewCurvatureIntoArray(const char *sname, int in_array_size,
               sname);
 
   /* Read in values. */
-  for (k = 0; k < vnum; k++) {
-    cvec[k] = freadFloat(fp);
-  }
+  freadFloatArray(cvec, vnum, fp);
   fclose(fp);
 
   /* Return what we read. */
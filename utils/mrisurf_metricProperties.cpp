@@ -4326,11 +4326,7 @@ static void MRISsetNeighborhoodSizeAndDistWkr(MRIS *mris, int nsize,
 
     // rebuild all the neighbor caches
     //
-    int vno;
-    for (vno = 0; vno < mris->nvertices; vno++) {
-      int vlist[MAX_NEIGHBORS], hops[MAX_NEIGHBORS];
-      MRISfindNeighborsAtVertex(mris, vno, nsize, MAX_NEIGHBORS, vlist, hops);
-    }
+    MRISfindNeighborsAtAllVertices(mris, nsize);
     MRISresetNeighborhoodSize(mris, nsize);
 
     mris->max_nsize = nsize;
@@ -10338,34 +10334,19 @@ int MRIScomputeSecondFundamentalForm(MRIS *mris) {
   return (MRIScomputeSecondFundamentalFormThresholded(mris, -1));
 }
 
-int MRIScomputeSecondFundamentalFormThresholded(MRIS *mris, double pct_thresh) {
-  double min_k1, min_k2, max_k1, max_k2, k1_scale, k2_scale, total, thresh,
-      orig_rsq_thresh;
-  int     bin, zbin1, zbin2, nthresh = 0;
+/*-----------------------------------------------------------
+  mrisComputeSecondFundamentalFormOld() - the original serial fit,
+  kept for FREESURFER_OLD_MRIScomputeSecondFundamentalForm. Allocates
+  the NR normal equations for every vertex.
+  -----------------------------------------------------------*/
+static int mrisComputeSecondFundamentalFormOld(MRIS *mris,
+                                               double orig_rsq_thresh) {
   int     vno, i, n, vmax, nbad = 0, niter;
   MATRIX *m_U, *m_Ut, *m_tmp1, *m_tmp2, *m_inverse, *m_eigen, *m_Q;
   VECTOR *v_c, *v_z, *v_n, *v_e1, *v_e2, *v_yi;
   float   k1, k2, evalues[3], a11, a12, a21, a22, cond_no, kmax, kmin, rsq, k;
-  double  ui, vi, total_area = 0.0, max_error, vmean, vsigma, rsq_thresh;
+  double  ui, vi, total_area = 0.0, max_error, rsq_thresh;
   FILE *  fp = NULL;
-  HISTOGRAM *h_k1, *h_k2;
-
-  if (mris->status == MRIS_PLANE) {
-    return (NO_ERROR);
-  }
-
-  if (pct_thresh >= 0) {
-    vmean = MRIScomputeTotalVertexSpacingStats(mris, &vsigma, NULL, NULL, NULL,
-                                               NULL);
-    rsq_thresh = MIN(vmean * .25, 1.0);
-    rsq_thresh *= rsq_thresh;
-  } else {
-    rsq_thresh = 0.0;
-  }
-
-  orig_rsq_thresh = rsq_thresh;
-
-  mrisComputeTangentPlanes(mris);
 
   v_c     = VectorAlloc(3, MATRIX_REAL);
   v_n     = VectorAlloc(3, MATRIX_REAL);
@@ -10601,6 +10582,372 @@ int MRIScomputeSecondFundamentalFormThresholded(MRIS *mris, double pct_thresh) {
   VectorFree(&v_yi);
   MatrixFree(&m_Q);
 
+  return (NO_ERROR);
+}
+
+/* per-vertex outcome of the quadric fit */
+#define QUADRIC_FIT_OK         0
+#define QUADRIC_FIT_DEGENERATE 1 // zero normal equations, k1 = k2 = 0
+#define QUADRIC_FIT_SKIPPED    2 // ripped, isolated or ill-conditioned
+
+/* relative singular value below which MatrixSVDInverse() (TOO_SMALL in
+   matrix.cpp) takes the reciprocal to be zero */
+#define QUADRIC_SVD_TOO_SMALL 1e-4
+
+/* eigenvalues of the symmetric 3x3 matrix [a0 a1 a2; a1 a3 a4; a2 a4 a5]
+   in closed form (trigonometric solution of the characteristic cubic) */
+static void symmetric3x3EigenValues(const double a[6], double w[3]) {
+  double const p1 = a[1] * a[1] + a[2] * a[2] + a[4] * a[4];
+  double const q  = (a[0] + a[3] + a[5]) / 3;
+
+  if (p1 == 0) {
+    w[0] = a[0];
+    w[1] = a[3];
+    w[2] = a[5];
+    return;
+  }
+  double const b0 = a[0] - q, b3 = a[3] - q, b5 = a[5] - q;
+  double const p  = sqrt((b0 * b0 + b3 * b3 + b5 * b5 + 2 * p1) / 6);
+  double const det =
+      b0 * (b3 * b5 - a[4] * a[4]) - a[1] * (a[1] * b5 - a[4] * a[2]) +
+      a[2] * (a[1] * a[4] - b3 * a[2]);
+  double r = det / (2 * p * p * p);
+  if (r < -1)
+    r = -1;
+  else if (r > 1)
+    r = 1;
+  double const phi = acos(r) / 3;
+  w[0]             = q + 2 * p * cos(phi);
+  w[2]             = q + 2 * p * cos(phi + 2 * M_PI / 3);
+  w[1]             = 3 * q - w[0] - w[2];
+}
+
+/* eigenvalues w and eigenvectors (the columns of q) of the same symmetric
+   3x3 matrix by cyclic Jacobi rotations, for the fits whose eigenvectors
+   are needed */
+static void symmetric3x3EigenSystem(const double a[6], double w[3],
+                                    double q[3][3]) {
+  double m[3][3] = {{a[0], a[1], a[2]}, {a[1], a[3], a[4]}, {a[2], a[4], a[5]}};
+  int    i, j, k, sweep;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      q[i][j] = (i == j);
+  for (sweep = 0; sweep < 50; sweep++) {
+    double const off =
+        m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+    double const diag =
+        m[0][0] * m[0][0] + m[1][1] * m[1][1] + m[2][2] * m[2][2];
+    if (off <= 1e-30 * diag)
+      break;
+    for (i = 0; i < 2; i++)
+      for (j = i + 1; j < 3; j++) {
+        if (m[i][j] == 0)
+          continue;
+        double const theta = (m[j][j] - m[i][i]) / (2 * m[i][j]);
+        double const t     = (theta >= 0 ? 1 : -1) /
+                         (fabs(theta) + sqrt(theta * theta + 1));
+        double const c = 1 / sqrt(t * t + 1), s = t * c;
+        for (k = 0; k < 3; k++) { // columns i and j
+          double const mki = m[k][i], mkj = m[k][j];
+          m[k][i]          = c * mki - s * mkj;
+          m[k][j]          = s * mki + c * mkj;
+        }
+        for (k = 0; k < 3; k++) { // rows i and j
+          double const mik = m[i][k], mjk = m[j][k];
+          m[i][k]          = c * mik - s * mjk;
+          m[j][k]          = s * mik + c * mjk;
+        }
+        for (k = 0; k < 3; k++) {
+          double const qki = q[k][i], qkj = q[k][j];
+          q[k][i]          = c * qki - s * qkj;
+          q[k][j]          = s * qki + c * qkj;
+        }
+      }
+  }
+  for (i = 0; i < 3; i++)
+    w[i] = m[i][i];
+}
+
+/*-----------------------------------------------------------
+  vertexFitQuadric() - fits z = a u^2 + 2 b u v + c v^2 to the
+  neighborhood of vno in its tangent frame and sets k1, k2, K, H and
+  the principal directions e1/e2. Same fit as the NR version, but the
+  3x3 normal equations and the 2x2 eigenproblem are solved in closed
+  form, with the small singular values dropped as MatrixSVDInverse()
+  does. rows is scratch for 4*vtotal floats, so nothing is allocated.
+  -----------------------------------------------------------*/
+static int vertexFitQuadric(MRIS *mris, int vno, double rsq_thresh,
+                            float *rows) {
+  VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+  VERTEX *const                v  = &mris->vertices[vno];
+  int                          i, n, niter;
+  float                        k1, k2, kmin, kmax, rsq, k;
+  double ui, vi, a[6], b[3], w[3], wmin, wmax, det, c0, c1, c2, t, ct, st;
+
+  if (v->ripflag || vt->vtotal <= 0)
+    return (QUADRIC_FIT_SKIPPED);
+  if (vno == Gdiag_no)
+    DiagBreak();
+
+  // like the NR version, all vtotal rows enter the normal equations, so
+  // a row written by a rejected neighbor after the last accepted one
+  // still counts
+  memset(rows, 0, 4 * vt->vtotal * sizeof(float));
+  niter = 0;
+  do {
+    kmin = 10000.0f;
+    kmax = -kmin;
+    for (n = i = 0; i < vt->vtotal; i++) {
+      VERTEX const *const vn = &mris->vertices[vt->v[i]];
+      if (vn->ripflag)
+        continue;
+      float const dx = vn->x - v->x, dy = vn->y - v->y, dz = vn->z - v->z;
+      float *const row = rows + 4 * n;
+
+      ui     = dx * v->e1x + dy * v->e1y + dz * v->e1z;
+      vi     = dx * v->e2x + dy * v->e2y + dz * v->e2z;
+      row[0] = ui * ui;
+      row[1] = 2 * ui * vi;
+      row[2] = vi * vi;
+      row[3] = dx * v->nx + dy * v->ny + dz * v->nz; // height above TpS
+      rsq    = ui * ui + vi * vi;
+      if (!FZERO(rsq) && rsq > rsq_thresh) {
+        k = row[3] / rsq;
+        if (k > kmax)
+          kmax = k;
+        if (k < kmin)
+          kmin = k;
+        n++;
+      }
+    }
+    rsq_thresh *= 0.25;
+    if (niter++ > 100)
+      break;
+  } while (n < 4);
+
+  a[0] = a[1] = a[2] = a[3] = a[4] = a[5] = 0;
+  b[0] = b[1] = b[2] = 0;
+  for (i = 0; i < vt->vtotal; i++) {
+    float const *const row = rows + 4 * i;
+    a[0] += row[0] * row[0];
+    a[1] += row[0] * row[1];
+    a[2] += row[0] * row[2];
+    a[3] += row[1] * row[1];
+    a[4] += row[1] * row[2];
+    a[5] += row[2] * row[2];
+    b[0] += row[0] * row[3];
+    b[1] += row[1] * row[3];
+    b[2] += row[2] * row[3];
+  }
+
+  // what MatrixSVDInverse() refuses to invert: a flat, identity frame
+  for (i = 0; i < 6; i++)
+    if (fabs(a[i]) > 1e-11)
+      break;
+  if (i == 6) {
+    v->k1 = v->k2 = v->K = v->H = 0;
+    return (QUADRIC_FIT_DEGENERATE);
+  }
+
+  // the normal matrix is positive semidefinite, so its singular values
+  // are its eigenvalues; same condition number as MatrixConditionNumber()
+  symmetric3x3EigenValues(a, w);
+  wmin = wmax = fabs(w[0]);
+  for (i = 1; i < 3; i++) {
+    wmin = MIN(wmin, fabs(w[i]));
+    wmax = MAX(wmax, fabs(w[i]));
+  }
+  if (FZERO(wmin) || wmax / wmin >= ILL_CONDITIONED) {
+    v->k1 = k1 = kmax;
+    v->k2 = k2 = kmin;
+    v->K       = k1 * k2;
+    v->H       = (k1 + k2) / 2;
+    return (QUADRIC_FIT_SKIPPED);
+  }
+
+  if (wmin >= QUADRIC_SVD_TOO_SMALL * wmax) {
+    // MatrixSVDInverse() keeps every singular value, so its pseudo-inverse
+    // is the inverse: use the adjugate of the symmetric matrix
+    double const m00 = a[3] * a[5] - a[4] * a[4];
+    double const m01 = a[2] * a[4] - a[1] * a[5];
+    double const m02 = a[1] * a[4] - a[2] * a[3];
+    double const m11 = a[0] * a[5] - a[2] * a[2];
+    double const m12 = a[1] * a[2] - a[0] * a[4];
+    double const m22 = a[0] * a[3] - a[1] * a[1];
+    det = a[0] * m00 + a[1] * m01 + a[2] * m02;
+    c0  = (m00 * b[0] + m01 * b[1] + m02 * b[2]) / det;
+    c1  = (m01 * b[0] + m11 * b[1] + m12 * b[2]) / det;
+    c2  = (m02 * b[0] + m12 * b[1] + m22 * b[2]) / det;
+  } else {
+    // between 1/QUADRIC_SVD_TOO_SMALL and ILL_CONDITIONED MatrixSVDInverse()
+    // zeroes the small singular values, so solve in the eigenbasis and drop
+    // the same directions
+    double q[3][3], qb;
+    symmetric3x3EigenSystem(a, w, q);
+    c0 = c1 = c2 = 0;
+    for (i = 0; i < 3; i++) {
+      if (fabs(w[i]) < QUADRIC_SVD_TOO_SMALL * wmax)
+        continue;
+      qb = (q[0][i] * b[0] + q[1][i] * b[1] + q[2][i] * b[2]) / w[i];
+      c0 += q[0][i] * qb;
+      c1 += q[1][i] * qb;
+      c2 += q[2][i] * qb;
+    }
+  }
+
+  // Hessian [2c0 2c1; 2c1 2c2]: eigenvalues mean +- radius, the first
+  // eigenvector at half the angle of (c0-c2, 2c1). k1 is the one of
+  // larger magnitude, as MatrixEigenSystem() sorts them.
+  double const mean   = c0 + c2;
+  double const radius = hypot(c0 - c2, 2 * c1);
+  t                   = 0.5 * atan2(2 * c1, c0 - c2);
+  ct                  = cos(t);
+  st                  = sin(t);
+  if (fabs(mean - radius) > fabs(mean + radius)) {
+    k1 = mean - radius;
+    k2 = mean + radius;
+    t  = ct; // the first direction becomes the orthogonal (-st,ct)
+    ct = -st;
+    st = t;
+  } else {
+    k1 = mean + radius;
+    k2 = mean - radius;
+  }
+  v->k1 = k1;
+  v->k2 = k2;
+  v->K  = k1 * k2;
+  v->H  = (k1 + k2) / 2;
+
+  // rotate the tangent frame onto the principal directions
+  float const e1x = v->e1x, e1y = v->e1y, e1z = v->e1z;
+  float const e2x = v->e2x, e2y = v->e2y, e2z = v->e2z;
+  v->e1x          = e1x * ct + e2x * st;
+  v->e1y          = e1y * ct + e2y * st;
+  v->e1z          = e1z * ct + e2z * st;
+  v->e2x          = -e1x * st + e2x * ct;
+  v->e2y          = -e1y * st + e2y * ct;
+  v->e2z          = -e1z * st + e2z * ct;
+
+  return (QUADRIC_FIT_OK);
+}
+
+/*-----------------------------------------------------------
+  mrisComputeQuadricCurvatures() - k1, k2, K, H and the principal
+  directions of every vertex in one parallel pass, with per-thread
+  scratch rows. The surface-wide stats are gathered afterwards in
+  vertex order, so they do not depend on the number of threads.
+  -----------------------------------------------------------*/
+static int mrisComputeQuadricCurvatures(MRIS *mris, double rsq_thresh) {
+  int            vno, t, nthreads, maxvtotal = 1, nbad = 0;
+  unsigned char *status;
+  float **       scratch;
+  double         total_area = 0.0;
+  FILE *         fp         = NULL;
+
+  for (vno = 0; vno < mris->nvertices; vno++)
+    maxvtotal = MAX(maxvtotal, mris->vertices_topology[vno].vtotal);
+#ifdef HAVE_OPENMP
+  nthreads = omp_get_max_threads();
+#else
+  nthreads = 1;
+#endif
+  scratch = (float **)calloc(nthreads, sizeof(float *));
+  for (t = 0; t < nthreads; t++)
+    scratch[t] = (float *)malloc(4 * maxvtotal * sizeof(float));
+  status = (unsigned char *)malloc(MAX(mris->nvertices, 1));
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(guided)
+#endif
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
+#ifdef HAVE_OPENMP
+    int const tid = omp_get_thread_num();
+#else
+    int const tid = 0;
+#endif
+    status[vno] = vertexFitQuadric(mris, vno, rsq_thresh, scratch[tid]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  mris->Kmin = mris->Hmin = 10000.0f;
+  mris->Kmax = mris->Hmax = -10000.0f;
+  mris->Ktotal            = 0.0f;
+  if (Gdiag & DIAG_WRITE && DIAG_VERBOSE_ON)
+    fp = fopen("curv.dat", "w");
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *const vertex = &mris->vertices[vno];
+
+    if (status[vno] == QUADRIC_FIT_SKIPPED)
+      continue;
+    if (status[vno] == QUADRIC_FIT_DEGENERATE)
+      nbad++;
+    if (fp)
+      fprintf(fp, "%d %f %f %f %f\n", vno, vertex->k1, vertex->k2, vertex->K,
+              vertex->H);
+    if (vno == Gdiag_no && (Gdiag & DIAG_SHOW))
+      fprintf(stdout, "v %d: k1=%2.3f, k2=%2.3f, K=%2.3f, H=%2.3f\n", vno,
+              vertex->k1, vertex->k2, vertex->K, vertex->H);
+    if (vertex->K < mris->Kmin)
+      mris->Kmin = vertex->K;
+    if (vertex->H < mris->Hmin)
+      mris->Hmin = vertex->H;
+    if (vertex->K > mris->Kmax)
+      mris->Kmax = vertex->K;
+    if (vertex->H > mris->Hmax)
+      mris->Hmax = vertex->H;
+    mris->Ktotal +=
+        (double)vertex->k1 * (double)vertex->k2 * (double)vertex->area;
+    total_area += (double)vertex->area;
+  }
+  if (fp)
+    fclose(fp);
+
+  if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON)
+    fprintf(stdout, "total area = %2.3f\n", total_area);
+  if (Gdiag & DIAG_SHOW && (nbad > 0))
+    fprintf(stdout, "%d ill-conditioned points\n", nbad);
+
+  for (t = 0; t < nthreads; t++)
+    free(scratch[t]);
+  free(scratch);
+  free(status);
+  return (NO_ERROR);
+}
+
+int MRIScomputeSecondFundamentalFormThresholded(MRIS *mris, double pct_thresh) {
+  double min_k1, min_k2, max_k1, max_k2, k1_scale, k2_scale, total, thresh,
+      orig_rsq_thresh;
+  int        bin, zbin1, zbin2, nthresh = 0;
+  int        vno;
+  double     vmean, vsigma, rsq_thresh;
+  HISTOGRAM *h_k1, *h_k2;
+
+  if (mris->status == MRIS_PLANE) {
+    return (NO_ERROR);
+  }
+
+  if (pct_thresh >= 0) {
+    vmean = MRIScomputeTotalVertexSpacingStats(mris, &vsigma, NULL, NULL, NULL,
+                                               NULL);
+    rsq_thresh = MIN(vmean * .25, 1.0);
+    rsq_thresh *= rsq_thresh;
+  } else {
+    rsq_thresh = 0.0;
+  }
+
+  orig_rsq_thresh = rsq_thresh;
+
+  mrisComputeTangentPlanes(mris);
+
+  if (getenv("FREESURFER_OLD_MRIScomputeSecondFundamentalForm"))
+    mrisComputeSecondFundamentalFormOld(mris, orig_rsq_thresh);
+  else
+    mrisComputeQuadricCurvatures(mris, orig_rsq_thresh);
+
   if (pct_thresh < 0) {
     return (NO_ERROR);
   }
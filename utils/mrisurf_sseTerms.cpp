@@ -13,6 +13,7 @@
  *
  */
 #include "mrisurf_sseTerms.h"
+#include "mrisurf_compute_dxyz.h"
 #include "mrisurf_project.h"
 
 #include "mrisurf_MRIS_MP.h"
@@ -2777,6 +2778,224 @@ double vlst_loglikelihood2D(MRIS *mris, MRI *mri, int vno, double displacement,
 // are not reordered In older code the ashburner_triangle is computed but not
 // used , here it is not computed at all
 
+// The spring, laplacian, tangential spring, nonlinear spring, distance and
+// sphere energies are all sums over the vertices of something computed from
+// a vertex and its neighbours, so the active ones, as set in parms, are
+// evaluated together in one sweep instead of one sweep each. sse is indexed
+// by MRIS_LOCAL_TERM, and the inactive terms are left 0.
+//
+// Partial sums are kept per fixed-size chunk of LOCAL_ENERGY_CHUNK vertices
+// and the chunks are added up serially, so the result does not depend on the
+// number of threads. This is a different summation order than the separate
+// functions use (a serial sum for the spring terms, an OpenMP reduction for
+// the distance and sphere terms), so the energies differ from theirs in the
+// last few bits. Setting FREESURFER_OLD_mrisComputeLocalEnergies reverts to
+// the separate per-term functions.
+//
+#define LOCAL_ENERGY_CHUNK 1024
+
+static void mrisComputeLocalEnergies(MRIS *mris, INTEGRATION_PARMS *parms,
+                                     double sse[MRIS_LOCAL_NTERMS]) {
+  bool const use_old =
+      (getenv("FREESURFER_OLD_mrisComputeLocalEnergies") != NULL);
+
+  bool const do_spring   = !DZERO(parms->l_spring);
+  bool const do_lap      = !DZERO(parms->l_lap);
+  bool const do_tspring  = !DZERO(parms->l_tspring);
+  bool       do_nlspring = !DZERO(parms->l_nlspring);
+  bool       do_dist     = !DZERO(parms->l_dist);
+  bool       do_sphere   = !DZERO(parms->l_sphere);
+
+  for (int i = 0; i < MRIS_LOCAL_NTERMS; i++)
+    sse[i] = 0.0;
+
+  if (do_nlspring && (use_old || FZERO(parms->rmin) || FZERO(parms->rmax))) {
+    // let the original report the bad rmin/rmax
+    sse[MRIS_LOCAL_NONLINEAR_SPRING] =
+        mrisComputeNonlinearSpringEnergy(mris, parms);
+    do_nlspring = false;
+  }
+  if (do_dist && (use_old || (mris->dist_alloced_flags & 3) != 3)) {
+    // the original copes with distances that were never computed
+    sse[MRIS_LOCAL_DISTANCE] = mrisComputeDistanceError(mris, parms);
+    do_dist                  = false;
+  }
+  if (use_old) {
+    if (do_spring)
+      sse[MRIS_LOCAL_SPRING] = mrisComputeSpringEnergy(mris);
+    if (do_lap)
+      sse[MRIS_LOCAL_LAPLACIAN] = mrisComputeLaplacianEnergy(mris);
+    if (do_tspring)
+      sse[MRIS_LOCAL_TANGENTIAL_SPRING] =
+          mrisComputeTangentialSpringEnergy(mris);
+    if (do_sphere)
+      sse[MRIS_LOCAL_SPHERE] =
+          mrisComputeSphereError(mris, parms->l_sphere, parms->a);
+    return;
+  }
+  if (!(do_spring || do_lap || do_tspring || do_nlspring || do_dist ||
+        do_sphere))
+    return;
+
+  SseTerms_MRIS const sseTerms(mris, -1);
+  double const        area_scale = sseTerms.area_scale;
+
+  float  lsq = 0;
+  double E = 0, F = 0;
+  if (do_nlspring) {
+    float const mean_vdist = MRIScomputeVertexSpacingStats(
+        mris, nullptr, nullptr, nullptr, nullptr, nullptr, CURRENT_VERTICES);
+    lsq = mean_vdist * mean_vdist;
+    F   = 6.0 / (1.0 / parms->rmin - 1.0 / parms->rmax);
+    E   = (1.0 / parms->rmin + 1.0 / parms->rmax) / 2;
+  }
+
+  double dist_scale = 1.0;
+#if METRIC_SCALE
+  if (mris->patch)
+    dist_scale = 1.0;
+  else if (mris->status == MRIS_PARAMETERIZED_SPHERE)
+    dist_scale = sqrt(mris->orig_area / mris->total_area);
+  else
+    dist_scale = mris->neg_area < mris->total_area
+                     ? sqrt(mris->orig_area /
+                            (mris->total_area - mris->neg_area))
+                     : sqrt(mris->orig_area / mris->total_area);
+#endif
+
+  double const x0 = (mris->xlo + mris->xhi) / 2.0f;
+  double const y0 = (mris->ylo + mris->yhi) / 2.0f;
+  double const z0 = (mris->zlo + mris->zhi) / 2.0f;
+
+  int const nchunks =
+      (mris->nvertices + LOCAL_ENERGY_CHUNK - 1) / LOCAL_ENERGY_CHUNK;
+  double *partial = (double *)calloc(MRIS_LOCAL_NTERMS * nchunks,
+                                     sizeof(double));
+  int *   zeros   = (int *)calloc(nchunks, sizeof(int));
+  if (!partial || !zeros)
+    ErrorExit(ERROR_NOMEMORY, "mrisComputeLocalEnergies: could not allocate "
+                              "%d partial sums", MRIS_LOCAL_NTERMS * nchunks);
+
+  int chunk;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (chunk = 0; chunk < nchunks; chunk++) {
+    ROMP_PFLB_begin
+
+    int const vlo = chunk * LOCAL_ENERGY_CHUNK;
+    int const vhi = MIN(vlo + LOCAL_ENERGY_CHUNK, mris->nvertices);
+    double *  chunk_sse = &partial[MRIS_LOCAL_NTERMS * chunk];
+
+    for (int vno = vlo; vno < vhi; vno++) {
+      VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+      VERTEX const *const          v  = &mris->vertices[vno];
+      if (v->ripflag)
+        continue;
+
+      double spring_sse = 0, lap_sse = 0, tspring_sse = 0, ftotal = 0;
+      double const vx = v->x - v->t2x, vy = v->y - v->t2y, vz = v->z - v->t2z;
+
+      for (int n = 0; n < vt->vnum; n++) {
+        VERTEX const *const vn = &mris->vertices[vt->v[n]];
+
+        if (do_spring)
+          spring_sse += square(v->dist[n]);
+
+        if (do_lap) {
+          double const dx = (vn->x - vn->t2x) - vx;
+          double const dy = (vn->y - vn->t2y) - vy;
+          double const dz = (vn->z - vn->t2z) - vz;
+          lap_sse += square(dx) + square(dy) + square(dz);
+        }
+
+        if (do_tspring || do_nlspring) {
+          float dx = vn->x - v->x;
+          float dy = vn->y - v->y;
+          float dz = vn->z - v->z;
+
+          float const nc = dx * v->nx + dy * v->ny + dz * v->nz;
+          if (do_nlspring) {
+            float const  r = lsq / fabs(2.0 * nc);
+            double const f = (1 + tanh(F * (1.0 / r - E)));
+            ftotal += f * f;
+          }
+          if (do_tspring) {
+            dx -= nc * v->nx;
+            dy -= nc * v->ny;
+            dz -= nc * v->nz;
+            float const dist_sq = square(dx) + square(dy) + square(dz);
+            tspring_sse += dist_sq;
+          }
+        }
+      }
+
+      chunk_sse[MRIS_LOCAL_SPRING] += area_scale * spring_sse;
+      chunk_sse[MRIS_LOCAL_LAPLACIAN] += area_scale * lap_sse;
+      chunk_sse[MRIS_LOCAL_TANGENTIAL_SPRING] += area_scale * tspring_sse;
+      if (do_nlspring) {
+        if (vno == Gdiag_no)
+          printf("E_nlspring: f = %2.3f\n", ftotal / vt->vnum);
+        chunk_sse[MRIS_LOCAL_NONLINEAR_SPRING] +=
+            area_scale * ftotal / vt->vnum;
+      }
+
+      if (do_dist) {
+        double v_sse = 0.0;
+
+        for (int n = 0; n < vt->vtotal; n++) {
+          if (mris->vertices[vt->v[n]].ripflag)
+            continue;
+
+          float const dist_orig_n = !v->dist_orig ? 0.0 : v->dist_orig[n];
+          if (dist_orig_n >= UNFOUND_DIST)
+            continue;
+          if (DZERO(dist_orig_n))
+            zeros[chunk]++;
+
+          double const delta = dist_scale * v->dist[n] - dist_orig_n;
+          if (parms->vsmoothness)
+            v_sse += (1.0 - parms->vsmoothness[vno]) * (delta * delta);
+          else
+            v_sse += delta * delta;
+        }
+        if (parms->dist_error)
+          parms->dist_error[vno] = v_sse;
+        chunk_sse[MRIS_LOCAL_DISTANCE] += v_sse;
+      }
+
+      if (do_sphere) {
+        double const x = (double)v->x - x0;
+        double const y = (double)v->y - y0;
+        double const z = (double)v->z - z0;
+        double const del = parms->a - sqrt(x * x + y * y + z * z);
+        chunk_sse[MRIS_LOCAL_SPHERE] += del * del;
+      }
+    }
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  int nzeros = 0;
+  for (chunk = 0; chunk < nchunks; chunk++) {
+    for (int i = 0; i < MRIS_LOCAL_NTERMS; i++)
+      sse[i] += partial[MRIS_LOCAL_NTERMS * chunk + i];
+    nzeros += zeros[chunk];
+  }
+  free(partial);
+  free(zeros);
+
+  // too many zero original distances, let the original report them
+  if (do_dist &&
+      nzeros > ((mris->status == MRIS_PARAMETERIZED_SPHERE ||
+                 mris->status == MRIS_SPHERE)
+                    ? mris->nvertices * mris->avg_nbrs * 0.01
+                    : mris->nvertices * mris->avg_nbrs * 0.001))
+    sse[MRIS_LOCAL_DISTANCE] = mrisComputeDistanceError(mris, parms);
+}
+
 // The ELTS terms have a working overloading of mrisCompute### that can take a
 // SurfaceFromMRIS_MP::XYZPositionConsequences::Surface as their first parameter
 //      They are implemented below in template <class _Surface> struct
@@ -2818,15 +3037,15 @@ double vlst_loglikelihood2D(MRIS *mris, MRI *mri, int vno, double displacement,
   ELTM(sse_nl_dist, parms->l_nldist, !DZERO(parms->l_nldist),                  \
        mrisComputeNonlinearDistanceSSE(mris))                                  \
   ELTM(sse_dist, parms->l_dist, !DZERO(parms->l_dist),                         \
-       mrisComputeDistanceError(mris, parms))                                  \
+       local_sse[MRIS_LOCAL_DISTANCE])                                         \
   ELTM(sse_spring, parms->l_spring, !DZERO(parms->l_spring),                   \
-       mrisComputeSpringEnergy(mris))                                          \
+       local_sse[MRIS_LOCAL_SPRING])                                           \
   ELTM(sse_lap, parms->l_lap, !DZERO(parms->l_lap),                            \
-       mrisComputeLaplacianEnergy(mris))                                       \
+       local_sse[MRIS_LOCAL_LAPLACIAN])                                        \
   ELTM(sse_tspring, parms->l_tspring, !DZERO(parms->l_tspring),                \
-       mrisComputeTangentialSpringEnergy(mris))                                \
+       local_sse[MRIS_LOCAL_TANGENTIAL_SPRING])                                \
   ELTM(sse_nlspring, parms->l_nlspring, !DZERO(parms->l_nlspring),             \
-       mrisComputeNonlinearSpringEnergy(mris, parms))                          \
+       local_sse[MRIS_LOCAL_NONLINEAR_SPRING])                                 \
   ELTM(sse_curv, l_curv_scaled, !DZERO(parms->l_curv),                         \
        mrisComputeQuadraticCurvatureSSE(mris, parms->l_curv))                  \
   ELTM(sse_corr, l_corr, !DZERO(l_corr),                                       \
@@ -2846,7 +3065,7 @@ double vlst_loglikelihood2D(MRIS *mris, MRI *mri, int vno, double displacement,
   ELTM(sse_grad, parms->l_grad, !DZERO(parms->l_grad),                         \
        mrisComputeIntensityGradientError(mris, parms))                         \
   ELTM(sse_sphere, parms->l_sphere, !DZERO(parms->l_sphere),                   \
-       mrisComputeSphereError(mris, parms->l_sphere, parms->a))                \
+       local_sse[MRIS_LOCAL_SPHERE])                                           \
   ELTM(                                                                        \
       sse_shrinkwrap, parms->l_shrinkwrap, !DZERO(parms->l_shrinkwrap),        \
       mrisComputeShrinkwrapError(mris, parms->mri_brain, parms->l_shrinkwrap)) \
@@ -3018,6 +3237,9 @@ double MRIScomputeSSE_template(Surface surface, Some_MRIS *mris,
         MHTcreateFaceTable_Resolution(mris, CURRENT_VERTICES, vmean);
   }
 
+  double local_sse[MRIS_LOCAL_NTERMS];
+  mrisComputeLocalEnergies(mris, parms, local_sse);
+
 #define ELTS(NAME, MULTIPLIER, COND, EXPR)                                     \
   double const NAME = (COND) ? (EXPR) : 0.0;
 #define ELTM(NAME, MULTIPLIER, COND, EXPR)                                     \
@@ -1273,10 +1273,23 @@ void MRIS_check_vertexNeighbours(MRIS *mris) {
   }
 }
 
-static int MRISfindNeighborsAtVertex_newWkr(MRIS *mris, int vno, int nlinks,
-                                            size_t listCapacity, int *vlist,
-                                            int *hops, bool noCache,
-                                            bool debug = false) {
+// What MRISfindNeighborsAtVertex_newWkr needs to update a vertex's cached
+// rings, when the update is done later rather than when the rings are found
+//
+typedef struct NeighborRingsFound {
+  int nsize;
+  int ringLinks;
+  int vnums[MRIS_MAX_NEIGHBORHOOD_LINKS + 1];
+} NeighborRingsFound;
+
+static void updateNeighborRingsCache(MRIS *mris, int vno, int nsize,
+                                     int ringLinks, int const *vnums,
+                                     int const *vlist);
+
+static int MRISfindNeighborsAtVertex_newWkr(
+    MRIS *mris, int vno, int nlinks, size_t listCapacity, int *vlist,
+    int *hops, bool noCache, bool debug = false,
+    NeighborRingsFound *deferCacheUpdate = nullptr) {
   /*
   Fills in v, vnum, v2num, v3num, etc. in the vertex.
   However nlinks may be much higher than these.
@@ -1438,43 +1451,12 @@ static int MRISfindNeighborsAtVertex_newWkr(MRIS *mris, int vno, int nlinks,
 
   // Update the cache
   //
-  if (!noCache) {
-
-    int const newPossibleNsizeMax = MIN(3, ringLinks - 1);
-    if (nsize < newPossibleNsizeMax) {
-
-      int oldSize = vnums[nsize];
-      int newSize = vnums[newPossibleNsizeMax];
-      resizeVertexV(mris, vno, newSize, oldSize);
-
-      int i;
-      for (i = oldSize; i < newSize; i++)
-        vt->v[i] = vlist[i];
-
-      int cachedRing;
-      for (cachedRing = nsize + 1; cachedRing <= newPossibleNsizeMax;
-           cachedRing++) {
-        switch (cachedRing) {
-        case 1:
-          modVnum(mris, vno, vnums[cachedRing], true);
-          break; // happens when encounters ripped vertexs
-        case 2:
-          vt->v2num = vnums[cachedRing];
-          break;
-        case 3:
-          vt->v3num = vnums[cachedRing];
-          break;
-        default:
-          cheapAssert(false);
-        }
-        vt->nsizeMax      = newPossibleNsizeMax;
-        vt->nsizeMaxClock = mris->nsizeMaxClock;
-      }
-
-      // cheapAssert(vt->nsizeCur >= 0); Always true for unsigned
-      cheapAssert(vt->nsizeCur <= vt->nsizeMax);
-      vt->vtotal = vnums[vt->nsizeCur];
-    }
+  if (deferCacheUpdate) {
+    deferCacheUpdate->nsize     = nsize;
+    deferCacheUpdate->ringLinks = ringLinks;
+    memcpy(deferCacheUpdate->vnums, vnums, ringLinks * sizeof(int));
+  } else if (!noCache) {
+    updateNeighborRingsCache(mris, vno, nsize, ringLinks, vnums, vlist);
   }
 
   // Clear the temp for reuse later
@@ -1490,6 +1472,48 @@ static int MRISfindNeighborsAtVertex_newWkr(MRIS *mris, int vno, int nlinks,
   return neighborCount;
 }
 
+static void updateNeighborRingsCache(MRIS *mris, int vno, int nsize,
+                                     int ringLinks, int const *vnums,
+                                     int const *vlist) {
+  VERTEX_TOPOLOGY *const vt = &mris->vertices_topology[vno];
+
+  int const newPossibleNsizeMax = MIN(3, ringLinks - 1);
+  if (nsize < newPossibleNsizeMax) {
+
+    int oldSize = vnums[nsize];
+    int newSize = vnums[newPossibleNsizeMax];
+    resizeVertexV(mris, vno, newSize, oldSize);
+
+    int i;
+    for (i = oldSize; i < newSize; i++)
+      vt->v[i] = vlist[i];
+
+    int cachedRing;
+    for (cachedRing = nsize + 1; cachedRing <= newPossibleNsizeMax;
+         cachedRing++) {
+      switch (cachedRing) {
+      case 1:
+        modVnum(mris, vno, vnums[cachedRing], true);
+        break; // happens when encounters ripped vertexs
+      case 2:
+        vt->v2num = vnums[cachedRing];
+        break;
+      case 3:
+        vt->v3num = vnums[cachedRing];
+        break;
+      default:
+        cheapAssert(false);
+      }
+      vt->nsizeMax      = newPossibleNsizeMax;
+      vt->nsizeMaxClock = mris->nsizeMaxClock;
+    }
+
+    // cheapAssert(vt->nsizeCur >= 0); Always true for unsigned
+    cheapAssert(vt->nsizeCur <= vt->nsizeMax);
+    vt->vtotal = vnums[vt->nsizeCur];
+  }
+}
+
 static int MRISfindNeighborsAtVertex_new(MRIS *mris, int vno, int nlinks,
                                          size_t listCapacity, int *vlist,
                                          int *hops, bool noCache) {
@@ -1508,6 +1532,83 @@ static int MRISfindNeighborsAtVertex_new(MRIS *mris, int vno, int nlinks,
   return neighborCount;
 }
 
+// Does MRISfindNeighborsAtVertex for every vertex, in parallel.
+//
+// Finding a vertex's rings reads the first ring of its neighbours, while
+// caching them reallocates its own v list, so the vertices are done a block at
+// a time: the rings for the whole block are found, then they are all cached.
+// Each vertex's rings only depend on the first rings and its own cache, so the
+// result is the same as the serial loop.  Ripped vertices can change vnum,
+// which other vertices read, so those surfaces are still done serially.
+//
+#define FIND_NEIGHBORS_BLOCK 512
+
+void MRISfindNeighborsAtAllVertices(MRIS *mris, int nlinks) {
+  int vno;
+
+  bool serial = getenv("MRISfindNeighborsAtVertex_old") ||
+                getenv("FREESURFER_OLD_MRISfindNeighborsAtAllVertices");
+  for (vno = 0; !serial && vno < mris->nvertices; vno++)
+    serial = mris->vertices[vno].ripflag;
+
+  if (serial) {
+    for (vno = 0; vno < mris->nvertices; vno++) {
+      int vlist[MAX_NEIGHBORS], hops[MAX_NEIGHBORS];
+      MRISfindNeighborsAtVertex(mris, vno, nlinks, MAX_NEIGHBORS, vlist, hops);
+    }
+    return;
+  }
+
+  std::vector<int>                vlists(FIND_NEIGHBORS_BLOCK * MAX_NEIGHBORS);
+  std::vector<int>                hops(FIND_NEIGHBORS_BLOCK * MAX_NEIGHBORS);
+  std::vector<NeighborRingsFound> found(FIND_NEIGHBORS_BLOCK);
+  std::vector<int>                counts(FIND_NEIGHBORS_BLOCK);
+
+  int blockBegin;
+  for (blockBegin = 0; blockBegin < mris->nvertices;
+       blockBegin += FIND_NEIGHBORS_BLOCK) {
+    int const blockEnd =
+        MIN(mris->nvertices, blockBegin + FIND_NEIGHBORS_BLOCK);
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+    for (vno = blockBegin; vno < blockEnd; vno++) {
+      ROMP_PFLB_begin
+      int const i = vno - blockBegin;
+      counts[i]   = MRISfindNeighborsAtVertex_newWkr(
+          mris, vno, nlinks, MAX_NEIGHBORS, &vlists[i * MAX_NEIGHBORS],
+          &hops[i * MAX_NEIGHBORS], false, false, &found[i]);
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    // report any overflow the way the serial code does
+    for (vno = blockBegin; vno < blockEnd; vno++) {
+      if (counts[vno - blockBegin] > MAX_NEIGHBORS) {
+        int vlist[MAX_NEIGHBORS], vhops[MAX_NEIGHBORS];
+        MRISfindNeighborsAtVertex_new(mris, vno, nlinks, MAX_NEIGHBORS, vlist,
+                                      vhops, false);
+      }
+    }
+
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+    for (vno = blockBegin; vno < blockEnd; vno++) {
+      ROMP_PFLB_begin
+      int const                 i = vno - blockBegin;
+      NeighborRingsFound const *f = &found[i];
+      updateNeighborRingsCache(mris, vno, f->nsize, f->ringLinks, f->vnums,
+                               &vlists[i * MAX_NEIGHBORS]);
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+  }
+}
+
 static int MRISfindNeighborsAtVertex_old(MRIS *mris, int vno, int nlinks,
                                          size_t listCapacity, int *vlist,
                                          int *hops) {
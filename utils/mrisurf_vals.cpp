@@ -3282,512 +3282,867 @@ int MRISsampleDistances(MRI_SURFACE *mris, int *nbrs, int max_nbhd) {
   return result;
 }
 
-static int MRISsampleDistances_new(MRI_SURFACE *mris, int *nbrs, int max_nbhd,
-                                   FILE *trace) {
-  if (trace)
-    fprintf(trace, "MRISsampleDistances initial mris.nsize:%d\n", mris->nsize);
+// The vertices are done a block at a time.  Finding the rings around each
+// vertex of a block only reads the topology and the positions, so it is done
+// in parallel, with per-thread marks and distances standing in for
+// v->marked and v->d.  Sampling from the rings draws from the shared random
+// number generator, so it is then done serially in vertex order, which keeps
+// the results identical to doing it all in one serial loop.
+//
+#define SAMPLE_DISTANCES_BLOCK 2048
+
+typedef struct SampleDistancesScratch {
+  int *  marked; // [nvertices] the ring a vertex was found in, 0 if not yet
+  float *d;      // [nvertices] the distance from the center along the rings
+  int *  vall;   // [MAX_NBHD_VERTICES] the found vertices, ring by ring
+  int *  vnb;    // [MAX_NBHD_VERTICES] the vertex each was found from
+} SampleDistancesScratch;
+
+typedef struct SampleDistancesRings {
+  // The rings to be sampled from, in the order their vertices were found,
+  // with the vertices' distances from the center.  Ring n is
+  // [ringBegin[n], ringBegin[n+1]) and is empty if nbrs[n] <= 0.
+  std::vector<int>   ringBegin;
+  std::vector<int>   vnos;
+  std::vector<float> d;
+
+  // All the found vertices, only kept for Gdiag_no
+  std::vector<int>   vall;
+  std::vector<float> vallD;
+} SampleDistancesRings;
+
+static void mrisSampleDistancesFindRings(MRIS *mris, int vno, int const *nbrs,
+                                         int max_nbhd, float dist_scale,
+                                         int diag_vno1, int diag_vno2,
+                                         SampleDistancesScratch *scratch,
+                                         SampleDistancesRings *  rings) {
+  VERTEX const *const v      = &mris->vertices[vno];
+  int *const          marked = scratch->marked;
+  float *const        d      = scratch->d;
+  int *const          vall   = scratch->vall;
+  int *const          vnb    = scratch->vnb;
+
+  rings->ringBegin.assign(max_nbhd + 2, 0);
+  rings->vnos.clear();
+  rings->d.clear();
+  rings->vall.clear();
+  rings->vallD.clear();
+
+  /*
+   find all the neighbors at each extent (i.e. 1-neighbors, then
+   2-neighbors, etc..., marking their corrected edge-length distances
+   as you go.
+  */
+
+  // Start with the vertex itself
+  //
+  vall[0]      = vno;
+  int old_vnum = 0; // the start of the known set
+  int vall_num = 1; // the end of the known set
+  marked[vno]  = 1; // mark it as in the set
 
-  mrisCheckVertexFaceTopology(mris);
+  // Add each next ring of neighbors until max_nbhd is reached
+  //
+  int nbhd_size;
+  for (nbhd_size = 1; nbhd_size <= max_nbhd; nbhd_size++) {
 
-  int diag_vno1 = -1, diag_vno2 = -1;
-  {
-    const char *cp;
-    if ((cp = getenv("VDIAG1")) != nullptr)
-      diag_vno1 = atoi(cp);
-    if ((cp = getenv("VDIAG2")) != nullptr)
-      diag_vno2 = atoi(cp);
-    if (diag_vno1 >= 0) {
-      printf("\nlooking for vertex pair %d, %d\n", diag_vno1, diag_vno2);
+    /* expand neighborhood outward by a ring of vertices */
+    int vnum  = vall_num; // where we are adding onto the set
+    int found = 0;        // how many got added
+
+    int n;
+    for (n = old_vnum; n < vall_num; n++) {
+      VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
+      VERTEX const *const          vn  = &mris->vertices[vall[n]];
+
+      if (vn->ripflag) {
+        continue;
+      }
+
+      /* search through vn's neighbors to find an unmarked vertex */
+      int n2;
+      for (n2 = 0; n2 < vnt->vnum; n2++) {
+        int const           vno2 = vnt->v[n2];
+        VERTEX const *const vn2  = &mris->vertices[vno2];
+        if (vn2->ripflag || marked[vno2]) {
+          continue;
+        }
+
+        /* found one, mark it and put it in the vall list */
+
+        if (vnum >= MAX_NBHD_VERTICES)
+          ErrorExit(ERROR_OUT_OF_BOUNDS,
+                    "MRISsampleDistances: too many neighbors");
+
+        found++;
+        marked[vno2] = nbhd_size;
+        vnb[vnum]    = vall[n];
+        vall[vnum]   = vno2;
+        vnum++;
+      }
+    } /* done with all neighbors at previous distance */
+
+    /* found all neighbors at this extent - calculate distances */
+
+    // describe the added ring
+    old_vnum = vall_num; /* old_vnum is index of 1st nbr at this distance*/
+    vall_num += found;   /* vall_num is total # of nbrs */
+    cheapAssert(vall_num == vnum);
+
+    // process the added ring
+    for (n = old_vnum; n < vall_num; n++) {
+      VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
+      VERTEX const *const          vn  = &mris->vertices[vall[n]];
+      if (vn->ripflag) {
+        continue;
+      }
+
+      float min_dist = UNFOUND_DIST;
+      int   n2;
+      for (n2 = 0; n2 < vnt->vnum; n2++) {
+        int const           vno2 = vnt->v[n2];
+        VERTEX const *const vn2  = &mris->vertices[vno2];
+        if (vn2->ripflag) {
+          continue;
+        }
+        if (!marked[vno2] || marked[vno2] == nbhd_size) {
+          continue;
+        }
+
+        // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
+        // CHANGING.
+        //
+        float xd   = vn2->x - vn->x;
+        float yd   = vn2->y - vn->y;
+        float zd   = vn2->z - vn->z;
+        float dist = sqrt(xd * xd + yd * yd + zd * zd);
+        if (nbhd_size > 1) {
+          dist /= dist_scale;
+        }
+        dist += d[vno2];
+        if (min_dist > dist) {
+          min_dist = dist;
+        }
+      }
+
+      d[vall[n]] = min_dist;
+      if (nbhd_size <= 2) {
+        // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
+        // CHANGING.
+        //
+        float xd   = vn->x - v->x;
+        float yd   = vn->y - v->y;
+        float zd   = vn->z - v->z;
+        float dist = sqrt(xd * xd + yd * yd + zd * zd);
+        d[vall[n]] = dist;
+      }
+
+      if (d[vall[n]] >= UNFOUND_DIST / 2) {
+        printf("***** WARNING - surface distance not found at "
+               "vno %d, vall[%d] = %d (vnb[%d] = %d ******",
+               vno, n, vall[n], n, vnb[n]);
+        DiagBreak();
+        exit(1);
+      }
+
+      if ((vall[n] == diag_vno1 && vno == diag_vno2) ||
+          (vall[n] == diag_vno2 && vno == diag_vno1))
+        printf("vn %d is %2.3f mm from v %d at ring %d\n", vall[n],
+               d[vall[n]], vno, nbhd_size);
+    }
+
+    /*
+     now check each to see if a neighbor at the same 'distance'
+     is actually closer than neighbors which are 'nearer' (i.e. maybe
+     the path through a 3-neighbor is shorter than that through any
+     of the 2-neighbors.
+    */
+    for (n = old_vnum; n < vall_num; n++) {
+      VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
+      VERTEX const *const          vn  = &mris->vertices[vall[n]];
+      if (vn->ripflag) {
+        continue;
+      }
+
+      float min_dist = d[vall[n]];
+
+      int n2;
+      for (n2 = 0; n2 < vnt->vnum; n2++) {
+        int const           vno2 = vnt->v[n2];
+        VERTEX const *const vn2  = &mris->vertices[vno2];
+        if (!marked[vno2] || marked[vno2] != nbhd_size || vn2->ripflag) {
+          continue;
+        }
+
+        // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
+        // CHANGING.
+        //
+        float xd   = vn2->x - vn->x;
+        float yd   = vn2->y - vn->y;
+        float zd   = vn2->z - vn->z;
+        float dist = sqrt(xd * xd + yd * yd + zd * zd);
+        if (nbhd_size > 1) {
+          dist /= dist_scale;
+        }
+        if (d[vno2] + dist < min_dist) {
+          min_dist = d[vno2] + dist;
+        }
+      }
+      d[vall[n]] = min_dist;
+      if ((min_dist > 5 * nbhd_size) || min_dist > 60) {
+        DiagBreak();
+      }
+    }
+
+    /* if this set of neighbors are to be stored, keep them for sampling */
+    rings->ringBegin[nbhd_size] = rings->vnos.size();
+    if (nbrs[nbhd_size] > 0) {
+      for (n = old_vnum; n < vall_num; n++) {
+        rings->vnos.push_back(vall[n]);
+        rings->d.push_back(d[vall[n]]);
+      }
     }
   }
+  rings->ringBegin[max_nbhd + 1] = rings->vnos.size();
 
-  /* adjustment for Manhattan distance */
-  float const dist_scale = IS_QUADRANGULAR(mris) ? (1.0 + sqrt(2.0)) / 2.0f
-                                                 : TRIANGLE_DISTANCE_CORRECTION;
+  if ((Gdiag_no == vno) && DIAG_VERBOSE_ON) {
+    int n;
+    for (n = 0; n < vall_num; n++) {
+      rings->vall.push_back(vall[n]);
+      rings->vallD.push_back(d[vall[n]]);
+    }
+  }
 
-  // TBD
-  //
-  float c[100];
-  int   nc[100];
-  if (max_nbhd >= 100) {
-    ErrorExit(ERROR_OUT_OF_BOUNDS,
-              "MRISsampleDistances: temporaries are too small");
+  /* now unmark them all */
+  int n;
+  for (n = 0; n < vall_num; n++) {
+    marked[vall[n]] = 0;
+    d[vall[n]]      = 0.0;
   }
-  memset(c, 0, 100 * sizeof(float));
-  memset(nc, 0, 100 * sizeof(int));
+}
 
-  // Temps needed below
-  //
-  VECTOR *v1 = VectorAlloc(3, MATRIX_REAL);
-  VECTOR *v2 = VectorAlloc(3, MATRIX_REAL);
+static void mrisSampleDistancesChooseFromRings(
+    MRIS *mris, int vno, int const *nbrs, int max_nbhd, int max_possible,
+    SampleDistancesRings const *rings, int *vnbrs, VECTOR *v1, VECTOR *v2,
+    bool *adjusted_mris_nsize, FILE *trace) {
+  VERTEX_TOPOLOGY *const vt = &mris->vertices_topology[vno];
+  VERTEX *const          v  = &mris->vertices[vno];
 
-  // Holds the extended set that will be sampled from
+  /* small neighborhood is always fixed, don't overwrite them */
+
+  // Expand each vertex to its nsizeMax.
+  // This is assumed later.
   //
-  int *const vnbrs = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
-  int *const vall  = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
-  int *const vnb   = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
-  if (!vnbrs || !vall || !vnb)
-    ErrorExit(ERROR_NOMEMORY,
-              "MRISsampleDistances: could not allocated v buffer");
+  cheapAssert(vt->nsizeMax > 0);
+  MRIS_setNsizeCur(mris, vno, vt->nsizeMax);
 
-  // Estimate the needs and show some stats
+  if (!*adjusted_mris_nsize) {
+    *adjusted_mris_nsize = true;
+    mris->nsize          = vt->nsizeCur;
+  } else {
+    if (mris->nsize != vt->nsizeCur) {
+      ErrorExit(
+          ERROR_OUT_OF_BOUNDS,
+          "MRISsampleDistances: different vertexs had different nsizeMax");
+    }
+  }
+
+  // Expand v, dist, and dist_orig to accomodate the predicted extras
+  // Zero the expansion to prevent weird variations
   //
-  int max_possible = 0; // The requested number upto and beyond them
+  int const vCapacity = vt->vtotal + max_possible;
+  if (trace && vno == 0)
+    fprintf(trace, "vCapacity:%d\n", vCapacity);
+
   {
-    int vtotal = 0; // The requested number beyond the already known neighbors
+    vt->v = (int *)realloc(vt->v, vCapacity * sizeof(int));
+    MRISgrowDist(mris, vno, vCapacity);
+    MRISgrowDistOrig(mris, vno, vCapacity);
+    int i;
+    for (i = vt->vtotal; i < vCapacity; i++)
+      vt->v[i] = v->dist[i] = v->dist_orig[i] = 0;
+  }
+
+  int nbhd_size;
+  for (nbhd_size = 1; nbhd_size <= max_nbhd; nbhd_size++) {
+
+    /* if this set of neighbors are to be stored, sample from them */
+    if (nbrs[nbhd_size] <= 0) {
+      continue;
+    }
+
+    int const    ringBegin = rings->ringBegin[nbhd_size];
+    int const    found     = rings->ringBegin[nbhd_size + 1] - ringBegin;
+    float const *ringD     = &rings->d[ringBegin];
+    int          n;
+    for (n = 0; n < found; n++) {
+      vnbrs[n] = rings->vnos[ringBegin + n];
+    }
+
+    /* make sure the points are not too close together */
+    float min_angle = 0.9 * 2.0 * M_PI / (float)nbrs[nbhd_size];
+
+    if (trace && vno == 0)
+      fprintf(trace, "nbhd_size:%d found:%d\n", nbhd_size, found);
+
+    if (found <= nbrs[nbhd_size]) /* just copy them all in */
     {
-      int n;
-      for (n = 1; n <= max_nbhd; n++) {
-        max_possible += nbrs[n];
-        if (n > mris->nsize) {
-          vtotal += nbrs[n];
+      // THIS IS WEIRD BECAUSE IT IS PUTTING REPEATS OF THE 1..v->nsize rings
+      // ONTO THE END OF THE LIST
+      //
+      for (n = 0; n < found; n++, vt->vtotal++) {
+        cheapAssert(vt->vtotal < vCapacity);
+        vt->v[vt->vtotal]        = vnbrs[n];
+        v->dist_orig[vt->vtotal] = ringD[n];
+        if (v->dist_orig[vt->vtotal] > 60) {
+          DiagBreak();
+        }
+        if (trace && vno == 0)
+          fprintf(trace, "copy dist_orig[%d]:%f\n", vt->vtotal,
+                  v->dist_orig[vt->vtotal]);
+      }
+    } else /* randomly sample from them */
+    {
+      int vstart = vt->vtotal;
+      for (n = 0; n < nbrs[nbhd_size]; n++, vt->vtotal++) {
+        int niter = 0;
+        int done;
+        int i;
+        do {
+          do {
+            i = nint(randomNumber(0.0, (double)found - 1));
+          } while (vnbrs[i] < 0);
+          /*
+           now check to make sure that the angle between this
+           point and the others already selected is not too
+           small to make sure the points are not bunched.
+          */
+          VERTEX const *const vn = &mris->vertices[vnbrs[i]];
+          VECTOR_LOAD(v1, vn->x - v->x, vn->y - v->y, vn->z - v->z);
+          done = 1;
+          int j;
+          for (j = vstart; done && j < vt->vtotal; j++) {
+            VERTEX const *const vn2 = &mris->vertices[vt->v[j]];
+            VECTOR_LOAD(v2, vn2->x - v->x, vn2->y - v->y, vn2->z - v->z);
+            float angle = Vector3Angle(v1, v2);
+            if (angle < min_angle) {
+              done = 0;
+            }
+          }
+          if (++niter > found) /* couldn't find enough at this difference */
+          {
+            min_angle *= 0.75f; /* be more liberal */
+            niter = 0;
+          }
+        } while (!done && !FZERO(min_angle));
+
+        cheapAssert(vt->vtotal < vCapacity);
+        vt->v[vt->vtotal]        = vnbrs[i];
+        v->dist_orig[vt->vtotal] = ringD[i];
+        if (v->dist_orig[vt->vtotal] > 60) {
+          DiagBreak();
         }
+        if (FZERO(ringD[i])) {
+          DiagBreak();
+        }
+        vnbrs[i] = -1;
+        if (trace && vno == 0)
+          fprintf(trace, "rand dist_orig[%d]:%f\n", vt->vtotal,
+                  v->dist_orig[vt->vtotal]);
       }
     }
+  }
 
-    if (Gdiag & DIAG_HEARTBEAT)
-      fprintf(stdout,
-              "\nsampling %d dists/vertex (%2.1f at each dist) = %2.1fMB\n",
-              vtotal, (float)vtotal / ((float)max_nbhd - (float)mris->nsize),
-              (float)vtotal * MRISvalidVertices(mris) * sizeof(float) * 3.0f /
-                  (1024.0f * 1024.0f));
+  if ((Gdiag_no == vno) && DIAG_VERBOSE_ON) {
+    FILE *fp;
+    char  fname[STRLEN];
+    int   n;
+
+    sprintf(fname, "v%d", vno);
+    fp = fopen(fname, "w");
+    fprintf(fp, "%d\n", (int)rings->vall.size());
+    for (n = 0; n < (int)rings->vall.size(); n++) {
+      fprintf(fp, "%d\n", rings->vall[n]);
+    }
+    fclose(fp);
+
+    sprintf(fname, "vn%d", vno);
+    fp = fopen(fname, "w");
+    fprintf(fp, "%d\n", vt->vtotal);
+    for (n = 0; n < vt->vtotal; n++) {
+      fprintf(fp, "%d\n", vt->v[n]);
+    }
+    fclose(fp);
+
+    for (n = 0; n < mris->nvertices; n++) {
+      mris->vertices[n].curv = 0;
+    }
+    for (n = 0; n < (int)rings->vall.size(); n++) {
+      mris->vertices[rings->vall[n]].curv = rings->vallD[n];
+    }
+
+    sprintf(fname, "%s.dist",
+            mris->hemisphere == LEFT_HEMISPHERE ? "lh" : "rh");
+    MRISwriteCurvature(mris, fname);
+  }
+}
+
+/*
+  Optional on-disk cache of the MRISsampleDistances results.  When the
+  FREESURFER_MRIS_NBHD_CACHE environment variable names a directory, the
+  neighbor lists (the nsizeMax rings plus the sampled vertices) and their
+  dist_orig are saved there in CSR form, and reloaded by later runs instead
+  of being recomputed.
+
+  The key hashes the topology, the vertex positions, the sampling parameters
+  and the state of the random number generator, so a hit gives exactly what
+  the computation would have.  The number of random numbers the computation
+  drew is saved too, and that many are drawn on a hit so that later users of
+  the generator see the same sequence.
+*/
+#define NBHD_CACHE_MAGIC "FSNBHDC1"
+
+static int mrisSampleDistancesInnerCount(VERTEX_TOPOLOGY const *vt) {
+  switch (vt->nsizeMax) {
+  case 3:
+    return vt->v3num;
+  case 2:
+    return vt->v2num;
+  default:
+    return vt->vnum;
   }
+}
 
-  // int i, n, vno, vnum, old_vnum, total_nbrs, max_possible, max_v, vtotal;
-  // int found, n2, vnbrs_num, vall_num, nbhd_size, done, checks = 0;
-  // float xd, yd, zd, min_dist, dist;
-  // float min_angle, angle;
-  // char *cp;
+static unsigned long mrisSampleDistancesKey(MRIS const *mris, int const *nbrs,
+                                            int max_nbhd) {
+  unsigned long hash     = fnv_init();
+  int const     header[] = {mris->nvertices, mris->nfaces, mris->type,
+                            max_nbhd};
+  hash = fnv_add(hash, (unsigned char const *)header, sizeof(header));
+  hash = fnv_add(hash, (unsigned char const *)nbrs,
+                 (max_nbhd + 1) * sizeof(int));
 
-  bool adjusted_mris_nsize = false;
+  long const rng[] = {getRandomSeed(), getRandomCalls()};
+  hash = fnv_add(hash, (unsigned char const *)rng, sizeof(rng));
+
+  int fno;
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    FACE const *const f = &mris->faces[fno];
+    int const         fv[] = {f->v[0], f->v[1], f->v[2]};
+    hash = fnv_add(hash, (unsigned char const *)fv, sizeof(fv));
+  }
 
-  int total_nbrs = 0;
   int vno;
   for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+    VERTEX const *const          v  = &mris->vertices[vno];
+    int const   inner = v->ripflag ? 0 : mrisSampleDistancesInnerCount(vt);
+    int const   vertexHeader[] = {v->ripflag, vt->nsizeMax, vt->vnum, inner};
+    float const xyz[]          = {v->x, v->y, v->z};
+    hash = fnv_add(hash, (unsigned char const *)vertexHeader,
+                   sizeof(vertexHeader));
+    hash = fnv_add(hash, (unsigned char const *)xyz, sizeof(xyz));
+    hash = fnv_add(hash, (unsigned char const *)vt->v, inner * sizeof(int));
+  }
+  return hash;
+}
+
+static void mrisSampleDistancesCacheName(char *fname, const char *dir,
+                                         unsigned long key) {
+  int req = snprintf(fname, STRLEN, "%s/mris_nbhd_%016lx.bin", dir, key);
+  if (req >= STRLEN) {
+    std::cerr << __FUNCTION__ << ": Truncation on line " << __LINE__
+              << std::endl;
+  }
+}
+
+static bool mrisSampleDistancesCacheRead(MRIS *mris, const char *dir,
+                                         unsigned long key, int max_possible) {
+  char fname[STRLEN];
+  mrisSampleDistancesCacheName(fname, dir, key);
+
+  FILE *fp = fopen(fname, "rb");
+  if (!fp)
+    return false;
+
+  char          magic[8];
+  unsigned long fileKey;
+  int           nvertices;
+  long          ndraws;
+  bool ok = fread(magic, sizeof(magic), 1, fp) == 1 &&
+            !memcmp(magic, NBHD_CACHE_MAGIC, sizeof(magic)) &&
+            fread(&fileKey, sizeof(fileKey), 1, fp) == 1 && fileKey == key &&
+            fread(&nvertices, sizeof(nvertices), 1, fp) == 1 &&
+            nvertices == mris->nvertices &&
+            fread(&ndraws, sizeof(ndraws), 1, fp) == 1 && ndraws >= 0;
+
+  std::vector<int> offsets(mris->nvertices + 1);
+  ok = ok && fread(offsets.data(), sizeof(int), offsets.size(), fp) ==
+                 offsets.size();
+
+  // Check the lists fit where MRISsampleDistances would have put them
+  // before changing anything
+  //
+  int vno;
+  for (vno = 0; ok && vno < mris->nvertices; vno++) {
+    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+    int const n = offsets[vno + 1] - offsets[vno];
+    if (mris->vertices[vno].ripflag)
+      ok = (n == 0);
+    else
+      ok = (n >= mrisSampleDistancesInnerCount(vt)) &&
+           (n <= mrisSampleDistancesInnerCount(vt) + max_possible);
+  }
+  ok = ok && offsets[0] == 0;
+
+  std::vector<int>   vnos;
+  std::vector<float> dist_orig;
+  if (ok) {
+    vnos.resize(offsets[mris->nvertices]);
+    dist_orig.resize(offsets[mris->nvertices]);
+    ok = fread(vnos.data(), sizeof(int), vnos.size(), fp) == vnos.size() &&
+         fread(dist_orig.data(), sizeof(float), dist_orig.size(), fp) ==
+             dist_orig.size();
+  }
+  fclose(fp);
+  for (size_t i = 0; ok && i < vnos.size(); i++)
+    ok = (vnos[i] >= 0 && vnos[i] < mris->nvertices);
 
-    if ((Gdiag & DIAG_HEARTBEAT) && (!(vno % (mris->nvertices / 10))))
-      fprintf(stdout, "%%%1.0f done\n",
-              100.0f * (float)vno / (float)mris->nvertices);
+  if (!ok) {
+    fprintf(stderr, "MRISsampleDistances: ignoring bad cache file %s\n", fname);
+    return false;
+  }
 
+  bool adjusted_mris_nsize = false;
+  for (vno = 0; vno < mris->nvertices; vno++) {
     VERTEX_TOPOLOGY *const vt = &mris->vertices_topology[vno];
     VERTEX *const          v  = &mris->vertices[vno];
-
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
     if (v->ripflag) {
       continue;
     }
 
-    /* small neighborhood is always fixed, don't overwrite them */
-
-    // Expand each vertex to its nsizeMax.
-    // This is assumed later.
-    //
-    cheapAssert(vt->nsizeMax > 0);
     MRIS_setNsizeCur(mris, vno, vt->nsizeMax);
-
     if (!adjusted_mris_nsize) {
       adjusted_mris_nsize = true;
       mris->nsize         = vt->nsizeCur;
-    } else {
-      if (mris->nsize != vt->nsizeCur) {
-        ErrorExit(
-            ERROR_OUT_OF_BOUNDS,
-            "MRISsampleDistances: different vertexs had different nsizeMax");
-      }
+    } else if (mris->nsize != vt->nsizeCur) {
+      ErrorExit(
+          ERROR_OUT_OF_BOUNDS,
+          "MRISsampleDistances: different vertexs had different nsizeMax");
     }
 
-    // Expand v, dist, and dist_orig to accomodate the predicted extras
-    // Zero the expansion to prevent weird variations
-    //
     int const vCapacity = vt->vtotal + max_possible;
-    if (trace && vno == 0)
-      fprintf(trace, "vCapacity:%d\n", vCapacity);
-
-    {
-      vt->v = (int *)realloc(vt->v, vCapacity * sizeof(int));
-      MRISgrowDist(mris, vno, vCapacity);
-      MRISgrowDistOrig(mris, vno, vCapacity);
-      int i;
-      for (i = vt->vtotal; i < vCapacity; i++)
-        vt->v[i] = v->dist[i] = v->dist_orig[i] = 0;
-    }
+    vt->v = (int *)realloc(vt->v, vCapacity * sizeof(int));
+    MRISgrowDist(mris, vno, vCapacity);
+    MRISgrowDistOrig(mris, vno, vCapacity);
+    int i;
+    for (i = vt->vtotal; i < vCapacity; i++)
+      vt->v[i] = v->dist[i] = v->dist_orig[i] = 0;
 
-    /*
-     find all the neighbors at each extent (i.e. 1-neighbors, then
-     2-neighbors, etc..., marking their corrected edge-length distances
-     as you go.
-    */
+    int const begin = offsets[vno], n = offsets[vno + 1] - begin;
+    memmove(vt->v, &vnos[begin], n * sizeof(int));
+    memmove(v->dist_orig, &dist_orig[begin], n * sizeof(float));
+    vt->vtotal = n;
+  }
 
-    // Start with the vertex itself
-    //
-    vall[0]      = vno;
-    int old_vnum = 0; // the start of the known set
-    int vall_num = 1; // the end of the known set
-    v->marked    = 1; // mark it as in the set
+  long i;
+  for (i = 0; i < ndraws; i++) {
+    randomNumber(0.0, 1.0);
+  }
 
-    // Add each next ring of neighbors until max_nbhd is reached
-    //
-    int nbhd_size;
-    for (nbhd_size = 1; nbhd_size <= max_nbhd; nbhd_size++) {
+  if (Gdiag & DIAG_SHOW)
+    fprintf(stdout, "MRISsampleDistances: read %s\n", fname);
+  return true;
+}
 
-      /* expand neighborhood outward by a ring of vertices */
-      int vnbrs_num = 0;        /* will count neighbors in this ring */
-      int vnum      = vall_num; // where we are adding onto the set
-      int found     = 0;        // how many got added
+static void mrisSampleDistancesCacheWrite(MRIS const *mris, const char *dir,
+                                          unsigned long key, long ndraws) {
+  char fname[STRLEN], tmpname[STRLEN + 32];
+  mrisSampleDistancesCacheName(fname, dir, key);
+  snprintf(tmpname, sizeof(tmpname), "%s.%d", fname, (int)getpid());
 
-      int n;
-      for (n = old_vnum; n < vall_num; n++) {
-        VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
-        VERTEX const *const          vn  = &mris->vertices[vall[n]];
+  std::vector<int> offsets(mris->nvertices + 1);
+  offsets[0] = 0;
+  int vno;
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    int const n =
+        mris->vertices[vno].ripflag ? 0 : mris->vertices_topology[vno].vtotal;
+    offsets[vno + 1] = offsets[vno] + n;
+  }
 
-        if (vn->ripflag) {
-          continue;
-        }
+  FILE *fp = fopen(tmpname, "wb");
+  if (!fp) {
+    ErrorPrintf(ERROR_NOFILE, "MRISsampleDistances: could not write %s",
+                tmpname);
+    return;
+  }
 
-        /* search through vn's neighbors to find an unmarked vertex */
-        int n2;
-        for (n2 = 0; n2 < vnt->vnum; n2++) {
-          VERTEX *const vn2 = &mris->vertices[vnt->v[n2]];
-          if (vn2->ripflag || vn2->marked) {
-            continue;
-          }
+  int const nvertices = mris->nvertices;
+  bool      ok        = fwrite(NBHD_CACHE_MAGIC, 8, 1, fp) == 1 &&
+              fwrite(&key, sizeof(key), 1, fp) == 1 &&
+              fwrite(&nvertices, sizeof(nvertices), 1, fp) == 1 &&
+              fwrite(&ndraws, sizeof(ndraws), 1, fp) == 1 &&
+              fwrite(offsets.data(), sizeof(int), offsets.size(), fp) ==
+                  offsets.size();
+  for (vno = 0; ok && vno < mris->nvertices; vno++) {
+    size_t const n = offsets[vno + 1] - offsets[vno];
+    ok = fwrite(mris->vertices_topology[vno].v, sizeof(int), n, fp) == n;
+  }
+  for (vno = 0; ok && vno < mris->nvertices; vno++) {
+    size_t const n = offsets[vno + 1] - offsets[vno];
+    ok = fwrite(mris->vertices[vno].dist_orig, sizeof(float), n, fp) == n;
+  }
+  ok = (fclose(fp) == 0) && ok;
 
-          /* found one, mark it and put it in the vall list */
+  // rename so that concurrent runs never see a partly written file
+  if (!ok || rename(tmpname, fname) != 0) {
+    ErrorPrintf(ERROR_NOFILE, "MRISsampleDistances: could not write %s",
+                fname);
+    unlink(tmpname);
+  }
+}
 
-          if (vnum >= MAX_NBHD_VERTICES)
-            ErrorExit(ERROR_OUT_OF_BOUNDS,
-                      "MRISsampleDistances: too many neighbors");
+static int MRISsampleDistances_new(MRI_SURFACE *mris, int *nbrs, int max_nbhd,
+                                   FILE *trace) {
+  if (trace)
+    fprintf(trace, "MRISsampleDistances initial mris.nsize:%d\n", mris->nsize);
 
-          found++;
-          vn2->marked = nbhd_size;
-          vnb[vnum]   = vall[n];
-          vall[vnum]  = vnt->v[n2];
-          vnum++;
+  mrisCheckVertexFaceTopology(mris);
 
-          if (nbrs[nbhd_size] > 0) /* want to store this distance */
-          {
-            cheapAssert(vnbrs_num < vnum);
-            vnbrs[vnbrs_num++] = vnt->v[n2];
-          }
-        }
-      } /* done with all neighbors at previous distance */
+  int diag_vno1 = -1, diag_vno2 = -1;
+  {
+    const char *cp;
+    if ((cp = getenv("VDIAG1")) != nullptr)
+      diag_vno1 = atoi(cp);
+    if ((cp = getenv("VDIAG2")) != nullptr)
+      diag_vno2 = atoi(cp);
+    if (diag_vno1 >= 0) {
+      printf("\nlooking for vertex pair %d, %d\n", diag_vno1, diag_vno2);
+    }
+  }
 
-      /* found all neighbors at this extent - calculate distances */
+  /* adjustment for Manhattan distance */
+  float const dist_scale = IS_QUADRANGULAR(mris) ? (1.0 + sqrt(2.0)) / 2.0f
+                                                 : TRIANGLE_DISTANCE_CORRECTION;
 
-      // describe the added ring
-      old_vnum = vall_num; /* old_vnum is index of 1st nbr at this distance*/
-      vall_num += found;   /* vall_num is total # of nbrs */
-      cheapAssert(vall_num == vnum);
+  if (max_nbhd >= 100) {
+    ErrorExit(ERROR_OUT_OF_BOUNDS,
+              "MRISsampleDistances: temporaries are too small");
+  }
 
-      // process the added ring
-      for (n = old_vnum; n < vall_num; n++) {
-        VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
-        VERTEX *const                vn  = &mris->vertices[vall[n]];
-        if (vn->ripflag) {
-          continue;
+  // Estimate the needs and show some stats
+  //
+  int max_possible = 0; // The requested number upto and beyond them
+  {
+    int vtotal = 0; // The requested number beyond the already known neighbors
+    {
+      int n;
+      for (n = 1; n <= max_nbhd; n++) {
+        max_possible += nbrs[n];
+        if (n > mris->nsize) {
+          vtotal += nbrs[n];
         }
+      }
+    }
 
-        float min_dist = UNFOUND_DIST;
-        int   n2;
-        for (n2 = 0; n2 < vnt->vnum; n2++) {
-          VERTEX const *const vn2 = &mris->vertices[vnt->v[n2]];
-          if (vn2->ripflag) {
-            continue;
-          }
-          if (!vn2->marked || vn2->marked == nbhd_size) {
-            continue;
-          }
+    if (Gdiag & DIAG_HEARTBEAT)
+      fprintf(stdout,
+              "\nsampling %d dists/vertex (%2.1f at each dist) = %2.1fMB\n",
+              vtotal, (float)vtotal / ((float)max_nbhd - (float)mris->nsize),
+              (float)vtotal * MRISvalidVertices(mris) * sizeof(float) * 3.0f /
+                  (1024.0f * 1024.0f));
+  }
 
-          // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
-          // CHANGING.
-          //
-          float xd   = vn2->x - vn->x;
-          float yd   = vn2->y - vn->y;
-          float zd   = vn2->z - vn->z;
-          float dist = sqrt(xd * xd + yd * yd + zd * zd);
-#if !MULTI_DIST_SCALING
-          if (nbhd_size > 1) {
-            dist /= dist_scale;
-          }
-          dist += vn2->d;
-#else
-          dist = (dist + vn2->d * distance_scale[vn2->marked]) /
-                 distance_scale[vn2->marked + 1];
+  // The cache is not used when tracing or when the seed has not been set,
+  // since then the random numbers differ from run to run anyway
+  //
+  const char *const cacheDir =
+      (trace || !getRandomSeed()) ? nullptr
+                                  : getenv("FREESURFER_MRIS_NBHD_CACHE");
+  unsigned long const cacheKey =
+      cacheDir ? mrisSampleDistancesKey(mris, nbrs, max_nbhd) : 0;
+  long const randomCallsBefore = getRandomCalls();
+
+  int vno;
+  if (!cacheDir ||
+      !mrisSampleDistancesCacheRead(mris, cacheDir, cacheKey, max_possible)) {
+
+    // Temps needed below
+    //
+    VECTOR *v1 = VectorAlloc(3, MATRIX_REAL);
+    VECTOR *v2 = VectorAlloc(3, MATRIX_REAL);
+
+    int *const vnbrs = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
+    if (!vnbrs)
+      ErrorExit(ERROR_NOMEMORY,
+                "MRISsampleDistances: could not allocated v buffer");
+
+    int const                           nthreads = omp_get_max_threads();
+    std::vector<SampleDistancesScratch> scratch(nthreads);
+    int                                 t;
+    for (t = 0; t < nthreads; t++) {
+      scratch[t].marked = (int *)calloc(mris->nvertices, sizeof(int));
+      scratch[t].d      = (float *)calloc(mris->nvertices, sizeof(float));
+      scratch[t].vall   = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
+      scratch[t].vnb    = (int *)calloc(MAX_NBHD_VERTICES, sizeof(int));
+      if (!scratch[t].marked || !scratch[t].d || !scratch[t].vall ||
+          !scratch[t].vnb)
+        ErrorExit(ERROR_NOMEMORY,
+                  "MRISsampleDistances: could not allocated v buffer");
+    }
+    std::vector<SampleDistancesRings> rings(SAMPLE_DISTANCES_BLOCK);
+
+    bool adjusted_mris_nsize = false;
+
+    int blockBegin;
+    for (blockBegin = 0; blockBegin < mris->nvertices;
+         blockBegin += SAMPLE_DISTANCES_BLOCK) {
+      int const blockEnd =
+          MIN(mris->nvertices, blockBegin + SAMPLE_DISTANCES_BLOCK);
+
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 16)
 #endif
-          if (min_dist > dist) {
-            min_dist = dist;
-          }
-        }
+      for (vno = blockBegin; vno < blockEnd; vno++) {
+        ROMP_PFLB_begin
+        if (mris->vertices[vno].ripflag)
+          ROMP_PF_continue;
+        mrisSampleDistancesFindRings(mris, vno, nbrs, max_nbhd, dist_scale,
+                                     diag_vno1, diag_vno2,
+                                     &scratch[omp_get_thread_num()],
+                                     &rings[vno - blockBegin]);
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
 
-        vn->d = min_dist;
-        if (nbhd_size <= 2) {
-          // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
-          // CHANGING.
-          //
-          float xd   = vn->x - v->x;
-          float yd   = vn->y - v->y;
-          float zd   = vn->z - v->z;
-          float dist = sqrt(xd * xd + yd * yd + zd * zd);
-          vn->d      = dist;
-        }
+      for (vno = blockBegin; vno < blockEnd; vno++) {
+
+        if ((Gdiag & DIAG_HEARTBEAT) && (!(vno % (mris->nvertices / 10))))
+          fprintf(stdout, "%%%1.0f done\n",
+                  100.0f * (float)vno / (float)mris->nvertices);
 
-        if (vn->d >= UNFOUND_DIST / 2) {
-          printf("***** WARNING - surface distance not found at "
-                 "vno %d, vall[%d] = %d (vnb[%d] = %d ******",
-                 vno, n, vall[n], n, vnb[n]);
+        if (vno == Gdiag_no) {
           DiagBreak();
-          exit(1);
         }
-
-        if ((vall[n] == diag_vno1 && vno == diag_vno2) ||
-            (vall[n] == diag_vno2 && vno == diag_vno1))
-          printf("vn %d is %2.3f mm from v %d at ring %d\n", vall[n], vn->d,
-                 vno, nbhd_size);
-      }
-
-      /*
-       now check each to see if a neighbor at the same 'distance'
-       is actually closer than neighbors which are 'nearer' (i.e. maybe
-       the path through a 3-neighbor is shorter than that through any
-       of the 2-neighbors.
-      */
-      for (n = old_vnum; n < vall_num; n++) {
-        VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vall[n]];
-        VERTEX *const                vn  = &mris->vertices[vall[n]];
-        if (vn->ripflag) {
+        if (mris->vertices[vno].ripflag) {
           continue;
         }
 
-        float min_dist = vn->d;
+        mrisSampleDistancesChooseFromRings(
+            mris, vno, nbrs, max_nbhd, max_possible, &rings[vno - blockBegin],
+            vnbrs, v1, v2, &adjusted_mris_nsize, trace);
+      }
+    }
 
-        int n2;
-        for (n2 = 0; n2 < vnt->vnum; n2++) {
-          VERTEX const *const vn2 = &mris->vertices[vnt->v[n2]];
-          if (!vn2->marked || vn2->marked != nbhd_size || vn2->ripflag) {
-            continue;
-          }
+    for (t = 0; t < nthreads; t++) {
+      free(scratch[t].marked);
+      free(scratch[t].d);
+      free(scratch[t].vall);
+      free(scratch[t].vnb);
+    }
+    free(vnbrs);
+    VectorFree(&v1);
+    VectorFree(&v2);
 
-          // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
-          // CHANGING.
-          //
-          float xd   = vn2->x - vn->x;
-          float yd   = vn2->y - vn->y;
-          float zd   = vn2->z - vn->z;
-          float dist = sqrt(xd * xd + yd * yd + zd * zd);
-#if !MULTI_DIST_SCALING
-          if (nbhd_size > 1) {
-            dist /= dist_scale;
-          }
-          if (vn2->d + dist < min_dist) {
-            min_dist = vn2->d + dist;
-          }
-#else
-          dist = (dist + vn2->d * distance_scale[vn2->marked]) /
-                 distance_scale[vn2->marked + 1];
-          if (dist < min_dist) {
-            min_dist = dist;
-          }
+    /* now fill in immediate neighborhood(Euclidean) distances */
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
 #endif
-        }
-        vn->d = min_dist;
-        if ((min_dist > 5 * nbhd_size) || min_dist > 60) {
-          DiagBreak();
-        }
-        {
-          // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
-          // CHANGING.
-          //
-          float xd   = vn->x - v->x;
-          float yd   = vn->y - v->y;
-          float zd   = vn->z - v->z;
-          float dist = sqrt(xd * xd + yd * yd + zd * zd);
-          c[nbhd_size] += vn->d / dist;
-          nc[nbhd_size]++;
-        }
-      }
+    for (vno = 0; vno < mris->nvertices; vno++) {
+      ROMP_PFLB_begin
+      VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+      VERTEX const *const          v  = &mris->vertices[vno];
 
-      /* if this set of neighbors are to be stored, sample from them */
-      if (nbrs[nbhd_size] <= 0) {
-        continue;
+      if (v->ripflag) {
+        ROMP_PF_continue;
       }
 
-      /* make sure the points are not too close together */
-      float min_angle = 0.9 * 2.0 * M_PI / (float)nbrs[nbhd_size];
+      // The above code made nsizeCur == nsizeMax, but vtotal may be beyond
+      // these so must determine the nsizeMax v#num
+      //
+      int const immediateCount = mrisSampleDistancesInnerCount(vt);
 
-      /*
-       at this point, the vall list contains all the
-       neighbors currently found
-       at ALL distances, while the vnbrs list contains ONLY the
-       nbhd_size-neighbors.
-      */
-      if (trace && vno == 0)
-        fprintf(trace, "nbhd_size:%d found:%d\n", nbhd_size, found);
+      int n;
+      for (n = 0; n < immediateCount; n++) {
+        VERTEX const *const vn = &mris->vertices[vt->v[n]];
+        if (vn->ripflag) {
+          continue;
+        }
 
-      if (found <= nbrs[nbhd_size]) /* just copy them all in */
-      {
-        // THIS IS WEIRD BECAUSE IT IS PUTTING REPEATS OF THE 1..v->nsize rings
-        // ONTO THE END OF THE LIST
+        // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS
+        // CHANGING.
         //
-        for (n = 0; n < found; n++, vt->vtotal++) {
-          cheapAssert(vt->vtotal < vCapacity);
-          vt->v[vt->vtotal]        = vnbrs[n];
-          v->dist_orig[vt->vtotal] = mris->vertices[vnbrs[n]].d;
-          if (v->dist_orig[vt->vtotal] > 60) {
-            DiagBreak();
-          }
-          if (trace && vno == 0)
-            fprintf(trace, "copy dist_orig[%d]:%f\n", vt->vtotal,
-                    v->dist_orig[vt->vtotal]);
-        }
-      } else /* randomly sample from them */
-      {
-        int vstart = vt->vtotal;
-        for (n = 0; n < nbrs[nbhd_size]; n++, vt->vtotal++) {
-          int niter = 0;
-          int done;
-          int i;
-          do {
-            do {
-              i = nint(randomNumber(0.0, (double)found - 1));
-            } while (vnbrs[i] < 0);
-            /*
-             now check to make sure that the angle between this
-             point and the others already selected is not too
-             small to make sure the points are not bunched.
-            */
-            VERTEX const *const vn = &mris->vertices[vnbrs[i]];
-            VECTOR_LOAD(v1, vn->x - v->x, vn->y - v->y, vn->z - v->z);
-            done = 1;
-            int j;
-            for (j = vstart; done && j < vt->vtotal; j++) {
-              VERTEX const *const vn2 = &mris->vertices[vt->v[j]];
-              VECTOR_LOAD(v2, vn2->x - v->x, vn2->y - v->y, vn2->z - v->z);
-              float angle = Vector3Angle(v1, v2);
-              if (angle < min_angle) {
-                done = 0;
-              }
-            }
-            if (++niter > found) /* couldn't find enough at this difference */
-            {
-              min_angle *= 0.75f; /* be more liberal */
-              niter = 0;
-            }
-          } while (!done && !FZERO(min_angle));
+        float xd = v->x - vn->x;
+        float yd = v->y - vn->y;
+        float zd = v->z - vn->z;
 
-          VERTEX const *const vn = &mris->vertices[vnbrs[i]];
-          cheapAssert(vt->vtotal < vCapacity);
-          vt->v[vt->vtotal]        = vnbrs[i];
-          v->dist_orig[vt->vtotal] = vn->d;
-          if (v->dist_orig[vt->vtotal] > 60) {
-            DiagBreak();
-          }
-          if (FZERO(vn->d)) {
-            DiagBreak();
-          }
-          vnbrs[i] = -1;
-          if (trace && vno == 0)
-            fprintf(trace, "rand dist_orig[%d]:%f\n", vt->vtotal,
-                    v->dist_orig[vt->vtotal]);
-        }
+        // WEIRD - WHY IS DIST NOT CHANGED?
+        //
+        v->dist_orig[n] = sqrt(xd * xd + yd * yd + zd * zd);
       }
+      ROMP_PFLB_end
     }
+    ROMP_PF_end
 
-    if ((Gdiag_no == vno) && DIAG_VERBOSE_ON) {
-      FILE *fp;
-      char  fname[STRLEN];
-      int   n;
+    if (trace) {
+      VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[0];
+      int const                    immediateCount =
+          mris->vertices[0].ripflag ? 0 : mrisSampleDistancesInnerCount(vt);
+      int n;
+      for (n = 0; n < immediateCount; n++)
+        fprintf(trace, "eucliod dist_orig[%d]:%f\n", n,
+                mris->vertices[0].dist_orig[n]);
+    }
 
-      sprintf(fname, "v%d", vno);
-      fp = fopen(fname, "w");
-      fprintf(fp, "%d\n", vall_num);
-      for (n = 0; n < vall_num; n++) {
-        fprintf(fp, "%d\n", vall[n]);
+    // make sure distances are symmetric
+    for (vno = 0; vno < mris->nvertices; vno++) {
+      VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
+      VERTEX const *const          v  = &mris->vertices[vno];
+      if (v->ripflag) {
+        continue;
       }
-      fclose(fp);
-
-      sprintf(fname, "vn%d", vno);
-      fp = fopen(fname, "w");
-      fprintf(fp, "%d\n", vt->vtotal);
-      for (n = 0; n < vt->vtotal; n++) {
-        fprintf(fp, "%d\n", vt->v[n]);
+      if (vno == Gdiag_no) {
+        DiagBreak();
       }
-      fclose(fp);
-
-      for (n = 0; n < mris->nvertices; n++) {
-        VERTEX *const vn = &mris->vertices[n];
-#if 0
-        if (vn->ripflag)
-        {
-          continue ;
+      int n;
+      for (n = 0; n < vt->vtotal; n++) {
+        VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vt->v[n]];
+        VERTEX *const                vn  = &mris->vertices[vt->v[n]];
+        if (vn->ripflag) {
+          continue;
+        }
+        int i;
+        for (i = 0; i < vnt->vtotal; i++) {
+          if (vnt->v[i] == vno) // distance in both lists - make it the average
+          {
+            double dist      = (vn->dist_orig[i] + v->dist_orig[n]) / 2;
+            vn->dist_orig[i] = dist;
+            v->dist_orig[n]  = dist;
+            break;
+          }
         }
-#endif
-        vn->curv = vn->d;
       }
-
-      sprintf(fname, "%s.dist",
-              mris->hemisphere == LEFT_HEMISPHERE ? "lh" : "rh");
-      MRISwriteCurvature(mris, fname);
-    }
-
-    /*
-     done building arrays - allocate distance vectors and
-     sample from the found neighbors list.
-    */
-    /* now unmark them all */
-    int n;
-    for (n = 0; n < vall_num; n++) {
-      mris->vertices[vall[n]].marked = 0;
-      mris->vertices[vall[n]].d      = 0.0;
     }
 
-    total_nbrs += vt->vtotal;
+    if (cacheDir)
+      mrisSampleDistancesCacheWrite(mris, cacheDir, cacheKey,
+                                    getRandomCalls() - randomCallsBefore);
   }
 
-  /* now fill in immediate neighborhood(Euclidean) distances */
+  // The serial code used v->marked and v->d as its temporaries, and left them
+  // zero for every vertex it visited
+  //
+  int total_nbrs = 0;
   for (vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX const *const          v  = &mris->vertices[vno];
-
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
+    VERTEX *const v = &mris->vertices[vno];
     if (v->ripflag) {
       continue;
     }
-
-    // The above code made nsizeCur == nsizeMax, but vtotal may be beyond these
-    // so must determine the nsizeMax v#num
-    //
-    int immediateCount = 0;
-    if (vt->nsizeMax == 3) {
-      immediateCount = vt->v3num;
-    } else if (vt->nsizeMax == 2) {
-      immediateCount = vt->v2num;
-    } else {
-      immediateCount = vt->vnum;
-    }
-
-    int n;
-    for (n = 0; n < immediateCount; n++) {
-      VERTEX const *const vn = &mris->vertices[vt->v[n]];
-      if (vn->ripflag) {
-        continue;
-      }
-
-      // BUG - THESE SHOULD BE double!  NOT CHANGED TO AVOID RESULTS CHANGING.
-      //
-      float xd = v->x - vn->x;
-      float yd = v->y - vn->y;
-      float zd = v->z - vn->z;
-
-      // WEIRD - WHY IS DIST NOT CHANGED?
-      //
-      v->dist_orig[n] = sqrt(xd * xd + yd * yd + zd * zd);
-      if (trace && vno == 0)
-        fprintf(trace, "eucliod dist_orig[%d]:%f\n", n, v->dist_orig[n]);
-    }
+    v->marked = 0;
+    v->d      = 0.0;
+    total_nbrs += mris->vertices_topology[vno].vtotal;
   }
 
   mris->vtotalsMightBeTooBig =
@@ -3795,36 +4150,6 @@ static int MRISsampleDistances_new(MRI_SURFACE *mris, int *nbrs, int max_nbhd,
 
   mrisCheckVertexFaceTopology(mris);
 
-  // make sure distances are symmetric
-  for (vno = 0; vno < mris->nvertices; vno++) {
-    VERTEX_TOPOLOGY const *const vt = &mris->vertices_topology[vno];
-    VERTEX const *const          v  = &mris->vertices[vno];
-    if (v->ripflag) {
-      continue;
-    }
-    if (vno == Gdiag_no) {
-      DiagBreak();
-    }
-    int n;
-    for (n = 0; n < vt->vtotal; n++) {
-      VERTEX_TOPOLOGY const *const vnt = &mris->vertices_topology[vt->v[n]];
-      VERTEX *const                vn  = &mris->vertices[vt->v[n]];
-      if (vn->ripflag) {
-        continue;
-      }
-      int i;
-      for (i = 0; i < vnt->vtotal; i++) {
-        if (vnt->v[i] == vno) // distance in both lists - make it the average
-        {
-          double dist      = (vn->dist_orig[i] + v->dist_orig[n]) / 2;
-          vn->dist_orig[i] = dist;
-          v->dist_orig[n]  = dist;
-          break;
-        }
-      }
-    }
-  }
-
   /* check reasonableness of distances */
   size_t zeroesCount    = 0;
   size_t nonZeroesCount = 0;
@@ -3877,29 +4202,6 @@ static int MRISsampleDistances_new(MRI_SURFACE *mris, int *nbrs, int max_nbhd,
     fprintf(stdout, "avg_nbrs = %2.1f\n", mris->avg_nbrs);
   }
 
-#if MULTI_DIST_SCALING
-  if (Gdiag & DIAG_SHOW) {
-    int n;
-    for (n = 0; n <= max_nbhd; n++) {
-      if (nc[n]) {
-        c[n] /= (float)nc[n];
-      }
-      fprintf(stdout, "c[%d] = %2.5f (%d samples)\n", n, c[n], nc[n]);
-    }
-    fprintf(stdout, "c[] = { ");
-    for (n = 0; n <= max_nbhd; n++) {
-      fprintf(stdout, "%2.5f", c[n]);
-      if (n < max_nbhd) {
-        fprintf(stdout, ", ");
-      }
-    }
-  }
-#endif
-  free(vnbrs);
-  free(vall);
-  free(vnb);
-  VectorFree(&v1);
-  VectorFree(&v2);
   if (Gdiag & DIAG_HEARTBEAT) {
     fprintf(stdout, " done.\n");
   }
@@ -0,0 +1,631 @@
+/**
+ * @brief scanline voxelization and narrow-band signed distance of surfaces
+ *
+ */
+/*
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "diag.h"
+#include "error.h"
+#include "mrisvoxelize.h"
+#include "romp_support.h"
+
+#define SDF_LEAF_FACES 4  // faces per leaf of the face hierarchy
+#define SDF_MAX_DEPTH  64 // traversal stack, far more than a median split needs
+
+typedef struct {
+  float lo[3], hi[3];
+  int   first;  // left child (the right one is first+1), or first leaf face
+  int   nfaces; // 0 for internal nodes
+} SDF_NODE;
+
+typedef struct {
+  int       nfaces;
+  float *   xyz;         // vertex voxel coordinates
+  int *     fv;          // 3 vertices per face
+  float *   flo, *fhi;   // bounds of each face
+  int *     order;       // faces in leaf order
+  float *   tri;         // vertex coordinates of the faces in leaf order
+  SDF_NODE *nodes;
+  int *     slice_first; // CSR of the faces whose bounds +- cap reach slice k
+  int *     slice_faces;
+} SDF_SURFACE;
+
+/* Same as Math::DistancePointToFace() in utilsmath.h, so the distances do
+   not change from the per-face bounding box sweep of mris_volmask. */
+static double sdfPointToFace(const float *v0, const float *v1, const float *v2,
+                             const double pt[3]) {
+  double kDiff[3], kEdge0[3], kEdge1[3];
+  int    n;
+
+  for (n = 0; n < 3; n++) {
+    kDiff[n]  = v0[n] - pt[n];
+    kEdge0[n] = v1[n] - v0[n];
+    kEdge1[n] = v2[n] - v0[n];
+  }
+  double fA00 = kEdge0[0] * kEdge0[0] + kEdge0[1] * kEdge0[1] +
+                kEdge0[2] * kEdge0[2];
+  double fA01 = kEdge0[0] * kEdge1[0] + kEdge0[1] * kEdge1[1] +
+                kEdge0[2] * kEdge1[2];
+  double fA11 = kEdge1[0] * kEdge1[0] + kEdge1[1] * kEdge1[1] +
+                kEdge1[2] * kEdge1[2];
+  double fB0 =
+      kDiff[0] * kEdge0[0] + kDiff[1] * kEdge0[1] + kDiff[2] * kEdge0[2];
+  double fB1 =
+      kDiff[0] * kEdge1[0] + kDiff[1] * kEdge1[1] + kDiff[2] * kEdge1[2];
+  double fC   = kDiff[0] * kDiff[0] + kDiff[1] * kDiff[1] + kDiff[2] * kDiff[2];
+  double fDet = fabs(fA00 * fA11 - fA01 * fA01);
+  double fS   = fA01 * fB1 - fA11 * fB0;
+  double fT   = fA01 * fB0 - fA00 * fB1;
+  double fSqrDistance, fTmp0, fTmp1, fNumer, fDenom;
+
+  if (fS + fT <= fDet) {
+    if (fS < 0.0) {
+      if (fT < 0.0) { // region 4
+        if (fB0 < 0.0) {
+          if (-fB0 >= fA00)
+            fSqrDistance = fA00 + 2.0 * fB0 + fC;
+          else {
+            fS           = -fB0 / fA00;
+            fSqrDistance = fB0 * fS + fC;
+          }
+        } else if (fB1 >= 0.0)
+          fSqrDistance = fC;
+        else if (-fB1 >= fA11)
+          fSqrDistance = fA11 + 2.0 * fB1 + fC;
+        else {
+          fT           = -fB1 / fA11;
+          fSqrDistance = fB1 * fT + fC;
+        }
+      } else { // region 3
+        if (fB1 >= 0.0)
+          fSqrDistance = fC;
+        else if (-fB1 >= fA11)
+          fSqrDistance = fA11 + 2.0 * fB1 + fC;
+        else {
+          fT           = -fB1 / fA11;
+          fSqrDistance = fB1 * fT + fC;
+        }
+      }
+    } else if (fT < 0.0) { // region 5
+      if (fB0 >= 0.0)
+        fSqrDistance = fC;
+      else if (-fB0 >= fA00)
+        fSqrDistance = fA00 + 2.0 * fB0 + fC;
+      else {
+        fS           = -fB0 / fA00;
+        fSqrDistance = fB0 * fS + fC;
+      }
+    } else { // region 0, minimum at interior point
+      double fInvDet = 1.0 / fDet;
+      fS *= fInvDet;
+      fT *= fInvDet;
+      fSqrDistance = fS * (fA00 * fS + fA01 * fT + 2.0 * fB0) +
+                     fT * (fA01 * fS + fA11 * fT + 2.0 * fB1) + fC;
+    }
+  } else if (fS < 0.0) { // region 2
+    fTmp0 = fA01 + fB0;
+    fTmp1 = fA11 + fB1;
+    if (fTmp1 > fTmp0) {
+      fNumer = fTmp1 - fTmp0;
+      fDenom = fA00 - 2.0 * fA01 + fA11;
+      if (fNumer >= fDenom)
+        fSqrDistance = fA00 + 2.0 * fB0 + fC;
+      else {
+        fS           = fNumer / fDenom;
+        fT           = 1.0 - fS;
+        fSqrDistance = fS * (fA00 * fS + fA01 * fT + 2.0 * fB0) +
+                       fT * (fA01 * fS + fA11 * fT + 2.0 * fB1) + fC;
+      }
+    } else if (fTmp1 <= 0.0)
+      fSqrDistance = fA11 + 2.0 * fB1 + fC;
+    else if (fB1 >= 0.0)
+      fSqrDistance = fC;
+    else {
+      fT           = -fB1 / fA11;
+      fSqrDistance = fB1 * fT + fC;
+    }
+  } else if (fT < 0.0) { // region 6
+    fTmp0 = fA01 + fB1;
+    fTmp1 = fA00 + fB0;
+    if (fTmp1 > fTmp0) {
+      fNumer = fTmp1 - fTmp0;
+      fDenom = fA00 - 2.0 * fA01 + fA11;
+      if (fNumer >= fDenom)
+        fSqrDistance = fA11 + 2.0 * fB1 + fC;
+      else {
+        fT           = fNumer / fDenom;
+        fS           = 1.0 - fT;
+        fSqrDistance = fS * (fA00 * fS + fA01 * fT + 2.0 * fB0) +
+                       fT * (fA01 * fS + fA11 * fT + 2.0 * fB1) + fC;
+      }
+    } else if (fTmp1 <= 0.0)
+      fSqrDistance = fA00 + 2.0 * fB0 + fC;
+    else if (fB0 >= 0.0)
+      fSqrDistance = fC;
+    else {
+      fS           = -fB0 / fA00;
+      fSqrDistance = fB0 * fS + fC;
+    }
+  } else { // region 1
+    fNumer = fA11 + fB1 - fA01 - fB0;
+    if (fNumer <= 0.0)
+      fSqrDistance = fA11 + 2.0 * fB1 + fC;
+    else {
+      fDenom = fA00 - 2.0 * fA01 + fA11;
+      if (fNumer >= fDenom)
+        fSqrDistance = fA00 + 2.0 * fB0 + fC;
+      else {
+        fS           = fNumer / fDenom;
+        fT           = 1.0 - fS;
+        fSqrDistance = fS * (fA00 * fS + fA01 * fT + 2.0 * fB0) +
+                       fT * (fA01 * fS + fA11 * fT + 2.0 * fB1) + fC;
+      }
+    }
+  }
+
+  // account for numerical round-off error
+  if (fSqrDistance < 0.0)
+    fSqrDistance = 0.0;
+  return (sqrt(fSqrDistance));
+}
+
+/* median split on the face centers along the longest axis; the ties are
+   broken by face number so the tree does not depend on the sort */
+static int sdfBuild(SDF_SURFACE *sdf, int node, int begin, int end,
+                    int *nnodes) {
+  SDF_NODE *n = &sdf->nodes[node];
+  float     clo[3], chi[3], c;
+  int       f, k, axis, mid;
+
+  for (k = 0; k < 3; k++) {
+    n->lo[k] = clo[k] = 1e30;
+    n->hi[k] = chi[k] = -1e30;
+  }
+  for (f = begin; f < end; f++) {
+    int fno = sdf->order[f];
+    for (k = 0; k < 3; k++) {
+      n->lo[k] = MIN(n->lo[k], sdf->flo[3 * fno + k]);
+      n->hi[k] = MAX(n->hi[k], sdf->fhi[3 * fno + k]);
+      c        = sdf->flo[3 * fno + k] + sdf->fhi[3 * fno + k];
+      clo[k]   = MIN(clo[k], c);
+      chi[k]   = MAX(chi[k], c);
+    }
+  }
+  if (end - begin <= SDF_LEAF_FACES) {
+    n->first  = begin;
+    n->nfaces = end - begin;
+    return (NO_ERROR);
+  }
+
+  axis = 0;
+  for (k = 1; k < 3; k++)
+    if (chi[k] - clo[k] > chi[axis] - clo[axis])
+      axis = k;
+  mid = (begin + end) / 2;
+  const float *flo = sdf->flo, *fhi = sdf->fhi;
+  std::nth_element(sdf->order + begin, sdf->order + mid, sdf->order + end,
+                   [flo, fhi, axis](int a, int b) {
+                     float ca = flo[3 * a + axis] + fhi[3 * a + axis];
+                     float cb = flo[3 * b + axis] + fhi[3 * b + axis];
+                     return (ca < cb || (ca == cb && a < b));
+                   });
+
+  n->first  = *nnodes;
+  n->nfaces = 0;
+  *nnodes += 2;
+  sdfBuild(sdf, n->first, begin, mid, nnodes);
+  sdfBuild(sdf, sdf->nodes[node].first + 1, mid, end, nnodes);
+  return (NO_ERROR);
+}
+
+/* squared distance from pt to the bounds of a node */
+static double sdfNodeDist2(const SDF_NODE *n, const double pt[3]) {
+  double d, d2 = 0;
+  int    k;
+
+  for (k = 0; k < 3; k++) {
+    if (pt[k] < n->lo[k])
+      d = n->lo[k] - pt[k];
+    else if (pt[k] > n->hi[k])
+      d = pt[k] - n->hi[k];
+    else
+      continue;
+    d2 += d * d;
+  }
+  return (d2);
+}
+
+/* distance to the nearest face if it is below dmax, dmax otherwise */
+static double sdfDistance(const SDF_SURFACE *sdf, const double pt[3],
+                          double dmax) {
+  int             stack[SDF_MAX_DEPTH], nstack = 0, f, c;
+  double          dist2[SDF_MAX_DEPTH], best = dmax, d, dl, dr;
+  const SDF_NODE *n;
+
+  if (sdf->nfaces == 0)
+    return (best);
+  stack[0] = 0;
+  dist2[0] = sdfNodeDist2(sdf->nodes, pt);
+  nstack   = 1;
+  while (nstack > 0) {
+    nstack--;
+    if (dist2[nstack] >= best * best)
+      continue;
+    n = &sdf->nodes[stack[nstack]];
+    if (n->nfaces > 0) {
+      for (f = n->first; f < n->first + n->nfaces; f++) {
+        const float *t = &sdf->tri[9 * f];
+        d              = sdfPointToFace(t, t + 3, t + 6, pt);
+        if (d < best)
+          best = d;
+      }
+      continue;
+    }
+    // push the nearer child last so that it is visited first
+    c  = n->first;
+    dl = sdfNodeDist2(&sdf->nodes[c], pt);
+    dr = sdfNodeDist2(&sdf->nodes[c + 1], pt);
+    if (dl <= dr) {
+      stack[nstack]   = c + 1;
+      dist2[nstack++] = dr;
+      stack[nstack]   = c;
+      dist2[nstack++] = dl;
+    } else {
+      stack[nstack]   = c;
+      dist2[nstack++] = dl;
+      stack[nstack]   = c + 1;
+      dist2[nstack++] = dr;
+    }
+  }
+  return (best);
+}
+
+/* Orientation of (py,pz) against the edge va->vb projected onto the (y,z)
+   plane. The edge is evaluated with its vertices in index order so that
+   the two faces sharing it get exactly opposite values, and zeros are
+   broken as if the point were moved by (eps,eps^2). Together this makes
+   every scanline cross a closed surface an even number of times. */
+static double sdfEdge(const float *xyz, int va, int vb, double py, double pz,
+                      int *sign) {
+  const float *a, *b;
+  double       dy, dz, e;
+  int          flip = 0, s;
+
+  if (va > vb) {
+    std::swap(va, vb);
+    flip = 1;
+  }
+  a  = &xyz[3 * va];
+  b  = &xyz[3 * vb];
+  dy = (double)b[1] - a[1];
+  dz = (double)b[2] - a[2];
+  e  = dy * (pz - a[2]) - dz * (py - a[1]);
+  s  = (e > 0) - (e < 0);
+  if (s == 0)
+    s = (dz != 0) ? ((dz < 0) ? 1 : -1) : ((dy > 0) - (dy < 0));
+  *sign = flip ? -s : s;
+  return (flip ? -e : e);
+}
+
+/* column at which the scanline (row,slice) = (py,pz) crosses face fno,
+   returns 0 if it misses the face */
+static int sdfCrossing(const SDF_SURFACE *sdf, int fno, double py, double pz,
+                       double *px) {
+  const int *fv = &sdf->fv[3 * fno];
+  double     e0, e1, e2, sum;
+  int        s0, s1, s2;
+
+  e0 = sdfEdge(sdf->xyz, fv[1], fv[2], py, pz, &s0);
+  e1 = sdfEdge(sdf->xyz, fv[2], fv[0], py, pz, &s1);
+  e2 = sdfEdge(sdf->xyz, fv[0], fv[1], py, pz, &s2);
+  if (s0 == 0 || s0 != s1 || s0 != s2)
+    return (0);
+
+  sum = e0 + e1 + e2;
+  if (sum != 0)
+    *px = (e0 * sdf->xyz[3 * fv[0]] + e1 * sdf->xyz[3 * fv[1]] +
+           e2 * sdf->xyz[3 * fv[2]]) /
+          sum;
+  else
+    *px = ((double)sdf->xyz[3 * fv[0]] + sdf->xyz[3 * fv[1]] +
+           sdf->xyz[3 * fv[2]]) /
+          3;
+  return (1);
+}
+
+static int sdfInit(SDF_SURFACE *sdf, MRI_SURFACE *mris, MRI *mri, float cap) {
+  MRIS_SurfRAS2VoxelMap *map;
+  MATRIX *               m;
+  int                    vno, fno, k, r, n, z0, z1, depth = mri->depth;
+  float                  val;
+
+  memset(sdf, 0, sizeof(*sdf));
+  sdf->nfaces = mris->nfaces;
+  sdf->xyz    = (float *)calloc(3 * mris->nvertices + 1, sizeof(float));
+  sdf->fv     = (int *)calloc(3 * mris->nfaces + 1, sizeof(int));
+  sdf->flo    = (float *)calloc(3 * mris->nfaces + 1, sizeof(float));
+  sdf->fhi    = (float *)calloc(3 * mris->nfaces + 1, sizeof(float));
+  sdf->order  = (int *)calloc(mris->nfaces + 1, sizeof(int));
+  sdf->tri    = (float *)calloc(9 * mris->nfaces + 1, sizeof(float));
+  sdf->nodes  = (SDF_NODE *)calloc(2 * mris->nfaces + 1, sizeof(SDF_NODE));
+  sdf->slice_first = (int *)calloc(depth + 1, sizeof(int));
+  if (!sdf->xyz || !sdf->fv || !sdf->flo || !sdf->fhi || !sdf->order ||
+      !sdf->tri || !sdf->nodes || !sdf->slice_first)
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY, "MRISvoxelizeSurfaces: could not allocate "
+                                 "tables for %d faces",
+                 mris->nfaces));
+
+  // surface RAS to voxel, accumulated as MatrixMultiply() does
+  map = MRIS_makeRAS2VoxelMap(mri, mris);
+  m   = map->sras2vox;
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *const v = &mris->vertices[vno];
+    for (r = 1; r <= 3; r++) {
+      val = 0;
+      val += m->rptr[r][1] * v->x;
+      val += m->rptr[r][2] * v->y;
+      val += m->rptr[r][3] * v->z;
+      val += m->rptr[r][4];
+      sdf->xyz[3 * vno + r - 1] = val;
+    }
+  }
+  MRIS_freeRAS2VoxelMap(&map);
+
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    for (n = 0; n < 3; n++)
+      sdf->fv[3 * fno + n] = mris->faces[fno].v[n];
+    for (k = 0; k < 3; k++) {
+      sdf->flo[3 * fno + k] = sdf->fhi[3 * fno + k] =
+          sdf->xyz[3 * sdf->fv[3 * fno] + k];
+      for (n = 1; n < 3; n++) {
+        val                   = sdf->xyz[3 * sdf->fv[3 * fno + n] + k];
+        sdf->flo[3 * fno + k] = MIN(sdf->flo[3 * fno + k], val);
+        sdf->fhi[3 * fno + k] = MAX(sdf->fhi[3 * fno + k], val);
+      }
+    }
+    sdf->order[fno] = fno;
+  }
+
+  // faces by slice, widened by the band
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    z0 = MAX(0, (int)ceil(sdf->flo[3 * fno + 2] - cap));
+    z1 = MIN(depth - 1, (int)floor(sdf->fhi[3 * fno + 2] + cap));
+    for (k = z0; k <= z1; k++)
+      sdf->slice_first[k + 1]++;
+  }
+  for (k = 0; k < depth; k++)
+    sdf->slice_first[k + 1] += sdf->slice_first[k];
+  sdf->slice_faces = (int *)calloc(sdf->slice_first[depth] + 1, sizeof(int));
+  if (!sdf->slice_faces)
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY,
+                 "MRISvoxelizeSurfaces: could not allocate slice tables"));
+  for (fno = 0; fno < mris->nfaces; fno++) {
+    z0 = MAX(0, (int)ceil(sdf->flo[3 * fno + 2] - cap));
+    z1 = MIN(depth - 1, (int)floor(sdf->fhi[3 * fno + 2] + cap));
+    for (k = z0; k <= z1; k++)
+      sdf->slice_faces[sdf->slice_first[k]++] = fno;
+  }
+  for (k = depth; k > 0; k--)
+    sdf->slice_first[k] = sdf->slice_first[k - 1];
+  sdf->slice_first[0] = 0;
+  return (NO_ERROR);
+}
+
+static void sdfFree(SDF_SURFACE *sdf) {
+  free(sdf->xyz);
+  free(sdf->fv);
+  free(sdf->flo);
+  free(sdf->fhi);
+  free(sdf->order);
+  free(sdf->tri);
+  free(sdf->nodes);
+  free(sdf->slice_first);
+  free(sdf->slice_faces);
+}
+
+/*--------------------------------------------------------------------
+  sdfSlice() - inside test and distance for one slice of one surface.
+  The faces of the slice are binned by the rows they span; each row
+  collects its crossings, sorts them and counts the crossings left of
+  every column. The band marks the voxels within cap of a face bound,
+  only those query the face hierarchy.
+  --------------------------------------------------------------------*/
+static int sdfSlice(const SDF_SURFACE *sdf, MRI *mri, int slice, float cap,
+                    MRI *dist, MRI *interior) {
+  int const      width = mri->width, height = mri->height;
+  const int *    faces = &sdf->slice_faces[sdf->slice_first[slice]];
+  int const      nfaces = sdf->slice_first[slice + 1] - sdf->slice_first[slice];
+  int *          row_first, *row_faces, f, fno, row, col, r0, r1, c0, c1, n;
+  int            ncross, maxcross = 64, inside;
+  double *       cross, x, pt[3], d, dz, rad;
+  unsigned char *band = nullptr;
+
+  row_first = (int *)calloc(height + 1, sizeof(int));
+  cross     = (double *)malloc(maxcross * sizeof(double));
+  if (dist)
+    band = (unsigned char *)calloc(width * height, 1);
+  if (!row_first || !cross || (dist && !band))
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY,
+                 "MRISvoxelizeSurfaces: could not allocate slice %d", slice));
+
+  for (f = 0; f < nfaces; f++) {
+    fno = faces[f];
+    if (sdf->flo[3 * fno + 2] > slice || sdf->fhi[3 * fno + 2] < slice)
+      continue;
+    r0 = MAX(0, (int)ceil(sdf->flo[3 * fno + 1]));
+    r1 = MIN(height - 1, (int)floor(sdf->fhi[3 * fno + 1]));
+    for (row = r0; row <= r1; row++)
+      row_first[row + 1]++;
+  }
+  for (row = 0; row < height; row++)
+    row_first[row + 1] += row_first[row];
+  row_faces = (int *)malloc((row_first[height] + 1) * sizeof(int));
+  if (!row_faces)
+    ErrorReturn(ERROR_NOMEMORY,
+                (ERROR_NOMEMORY,
+                 "MRISvoxelizeSurfaces: could not allocate slice %d", slice));
+  for (f = 0; f < nfaces; f++) {
+    fno = faces[f];
+    if (band) {
+      // the face bounds widened by what is left of cap in this slice
+      dz = MAX(0, MAX(sdf->flo[3 * fno + 2] - slice,
+                      slice - sdf->fhi[3 * fno + 2]));
+      rad = sqrt(MAX(0, (double)cap * cap - dz * dz));
+      r0  = MAX(0, (int)ceil(sdf->flo[3 * fno + 1] - rad));
+      r1  = MIN(height - 1, (int)floor(sdf->fhi[3 * fno + 1] + rad));
+      c0  = MAX(0, (int)ceil(sdf->flo[3 * fno] - rad));
+      c1  = MIN(width - 1, (int)floor(sdf->fhi[3 * fno] + rad));
+      if (c0 <= c1)
+        for (row = r0; row <= r1; row++)
+          memset(&band[c0 + width * row], 1, c1 - c0 + 1);
+    }
+    if (sdf->flo[3 * fno + 2] > slice || sdf->fhi[3 * fno + 2] < slice)
+      continue;
+    r0 = MAX(0, (int)ceil(sdf->flo[3 * fno + 1]));
+    r1 = MIN(height - 1, (int)floor(sdf->fhi[3 * fno + 1]));
+    for (row = r0; row <= r1; row++)
+      row_faces[row_first[row]++] = fno;
+  }
+  for (row = height; row > 0; row--)
+    row_first[row] = row_first[row - 1];
+  row_first[0] = 0;
+
+  pt[2] = slice;
+  for (row = 0; row < height; row++) {
+    ncross = 0;
+    for (f = row_first[row]; f < row_first[row + 1]; f++) {
+      if (!sdfCrossing(sdf, row_faces[f], row, slice, &x))
+        continue;
+      if (ncross == maxcross) {
+        maxcross *= 2;
+        cross = (double *)realloc(cross, maxcross * sizeof(double));
+        if (!cross)
+          ErrorExit(ERROR_NOMEMORY,
+                    "MRISvoxelizeSurfaces: could not allocate crossings");
+      }
+      // insertion sort, there are only a few crossings per row
+      for (n = ncross++; n > 0 && cross[n - 1] > x; n--)
+        cross[n] = cross[n - 1];
+      cross[n] = x;
+    }
+
+    pt[1] = row;
+    n     = 0;
+    for (col = 0; col < width; col++) {
+      while (n < ncross && cross[n] < col)
+        n++;
+      inside = (n & 1);
+      if (interior)
+        MRIvox(interior, col, row, slice) = inside;
+      if (dist) {
+        d = cap;
+        if (band[col + width * row]) {
+          pt[0] = col;
+          d     = sdfDistance(sdf, pt, cap);
+        }
+        MRIFvox(dist, col, row, slice) = inside ? d : -d;
+      }
+    }
+  }
+
+  free(row_first);
+  free(row_faces);
+  free(cross);
+  free(band);
+  return (NO_ERROR);
+}
+
+static int sdfSameSize(const MRI *mri1, const MRI *mri2) {
+  return (mri1->width == mri2->width && mri1->height == mri2->height &&
+          mri1->depth == mri2->depth);
+}
+
+int MRISvoxelizeSurfaces(MRI_SURFACE **surfs, int nsurfs, MRI *mri_template,
+                         float cap, MRI **dist, MRI **interior) {
+  SDF_SURFACE *sdf;
+  int          n, t, ntasks, nnodes, f, k;
+
+  for (n = 0; n < nsurfs; n++) {
+    if (dist && !dist[n]) {
+      dist[n] = MRIalloc(mri_template->width, mri_template->height,
+                         mri_template->depth, MRI_FLOAT);
+      MRIcopyHeader(mri_template, dist[n]);
+    }
+    if (interior && !interior[n]) {
+      interior[n] = MRIalloc(mri_template->width, mri_template->height,
+                             mri_template->depth, MRI_UCHAR);
+      MRIcopyHeader(mri_template, interior[n]);
+    }
+    if ((dist && (dist[n]->type != MRI_FLOAT ||
+                  !sdfSameSize(dist[n], mri_template))) ||
+        (interior && (interior[n]->type != MRI_UCHAR ||
+                      !sdfSameSize(interior[n], mri_template))))
+      ErrorReturn(ERROR_BADPARM,
+                  (ERROR_BADPARM,
+                   "MRISvoxelizeSurfaces: output %d does not match the "
+                   "template",
+                   n));
+  }
+  if (!dist)
+    cap = 0;
+
+  sdf = (SDF_SURFACE *)calloc(nsurfs, sizeof(SDF_SURFACE));
+  for (n = 0; n < nsurfs; n++)
+    if (sdfInit(&sdf[n], surfs[n], mri_template, cap) != NO_ERROR)
+      return (Gerror);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) private(nnodes, f, k)
+#endif
+  for (n = 0; n < nsurfs; n++) {
+    ROMP_PFLB_begin
+    nnodes = 1;
+    if (sdf[n].nfaces > 0)
+      sdfBuild(&sdf[n], 0, 0, sdf[n].nfaces, &nnodes);
+    for (f = 0; f < sdf[n].nfaces; f++)
+      for (k = 0; k < 9; k++)
+        sdf[n].tri[9 * f + k] =
+            sdf[n].xyz[3 * sdf[n].fv[3 * sdf[n].order[f] + k / 3] + k % 3];
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  ntasks = nsurfs * mri_template->depth;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (t = 0; t < ntasks; t++) {
+    ROMP_PFLB_begin
+    int const s = t / mri_template->depth, slice = t % mri_template->depth;
+    sdfSlice(&sdf[s], mri_template, slice, cap, dist ? dist[s] : nullptr,
+             interior ? interior[s] : nullptr);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (n = 0; n < nsurfs; n++)
+    sdfFree(&sdf[n]);
+  free(sdf);
+  return (NO_ERROR);
+}
@@ -846,6 +846,337 @@ MRI *vol2surf_linear(MRI *SrcVol, MATRIX *Qsrc, MATRIX *Fsrc, MATRIX *Wsrc,
   return (TrgVol);
 }
 
+/*------------------------------------------------------------
+  vol2surf_operator_alloc() - builds the sparse operator that
+  vol2surf_linear() applies implicitly, but for all the projection
+  depths ProjFracMin:ProjFracDelta:ProjFracMax at once (the same
+  float loop mri_vol2surf uses for --projfrac-avg/--projfrac-max).
+  Each (vertex,depth) sample becomes a row of nweights voxel offsets
+  and weights into one frame of SrcVol, so the projection and the
+  vox2ras multiply are done once instead of once per depth, and
+  vol2surf_operator_apply() can then run over all the frames.
+  Only SAMPLE_NEAREST and SAMPLE_TRILINEAR are linear in the voxel
+  values; returns NULL for the other methods.
+  ------------------------------------------------------------*/
+VOL2SURF_OPERATOR *vol2surf_operator_alloc(
+    MRI *SrcVol, MATRIX *Qsrc, MATRIX *Fsrc, MATRIX *Wsrc, MATRIX *Dsrc,
+    MRI_SURFACE *TrgSurf, float ProjFracMin, float ProjFracMax,
+    float ProjFracDelta, int InterpMethod, int float2int, int ProjDistFlag) {
+  VOL2SURF_OPERATOR *op;
+  MATRIX *           QFWDsrc;
+  float              ProjFrac, M[3][4];
+  int                FreeQsrc = 0, ndepths, nrows, i, j, vtx;
+
+  if (InterpMethod != SAMPLE_NEAREST && InterpMethod != SAMPLE_TRILINEAR)
+    return (NULL);
+  if (float2int != FLT2INT_ROUND && float2int != FLT2INT_FLOOR &&
+      float2int != FLT2INT_TKREG) {
+    fprintf(stderr,
+            "vol2surf_operator_alloc(): unrecoginized float2int code %d\n",
+            float2int);
+    return (NULL);
+  }
+  if (ProjFracDelta <= 0 && ProjFracMax > ProjFracMin) {
+    fprintf(stderr, "vol2surf_operator_alloc(): ProjFracDelta = %g\n",
+            ProjFracDelta);
+    return (NULL);
+  }
+
+  ndepths = 0;
+  for (ProjFrac = ProjFracMin; ProjFrac <= ProjFracMax;
+       ProjFrac += ProjFracDelta) {
+    ndepths++;
+    if (ProjFracDelta <= 0)
+      break;
+  }
+  if (ndepths == 0)
+    return (NULL);
+
+  if (Qsrc == NULL) {
+    Qsrc     = MRIxfmCRS2XYZtkreg(SrcVol);
+    Qsrc     = MatrixInverse(Qsrc, Qsrc);
+    FreeQsrc = 1;
+  }
+  QFWDsrc = ComputeQFWD(Qsrc, Fsrc, Wsrc, Dsrc, NULL);
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 4; j++)
+      M[i][j] = QFWDsrc->rptr[i + 1][j + 1];
+  MatrixFree(&QFWDsrc);
+  if (FreeQsrc)
+    MatrixFree(&Qsrc);
+
+  op            = (VOL2SURF_OPERATOR *)calloc(1, sizeof(VOL2SURF_OPERATOR));
+  op->nvertices = TrgSurf->nvertices;
+  op->ndepths   = ndepths;
+  op->nweights  = (InterpMethod == SAMPLE_TRILINEAR) ? 8 : 1;
+  op->width     = SrcVol->width;
+  op->height    = SrcVol->height;
+  op->depth     = SrcVol->depth;
+  op->depths    = (float *)calloc(ndepths, sizeof(float));
+  nrows         = op->nvertices * ndepths;
+  op->voxel     = (int *)calloc((size_t)nrows * op->nweights, sizeof(int));
+  op->weight    = (float *)calloc((size_t)nrows * op->nweights, sizeof(float));
+  op->hit       = (int *)calloc(nrows, sizeof(int));
+  op->outside   = (char *)calloc(nrows, sizeof(char));
+  if (!op->depths || !op->voxel || !op->weight || !op->hit || !op->outside) {
+    vol2surf_operator_free(&op);
+    ErrorReturn(NULL, (ERROR_NOMEMORY,
+                       "vol2surf_operator_alloc: could not allocate %d rows",
+                       nrows));
+  }
+
+  ndepths = 0;
+  for (ProjFrac = ProjFracMin; ProjFrac <= ProjFracMax;
+       ProjFrac += ProjFracDelta) {
+    op->depths[ndepths++] = ProjFrac;
+    if (ProjFracDelta <= 0)
+      break;
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (vtx = 0; vtx < op->nvertices; vtx++) {
+    ROMP_PFLB_begin
+    int const     width = op->width, height = op->height, depth = op->depth;
+    VERTEX const *v     = &TrgSurf->vertices[vtx];
+
+    for (int d = 0; d < op->ndepths; d++) {
+      int const row     = vtx * op->ndepths + d;
+      int *     voxel   = &op->voxel[(size_t)row * op->nweights];
+      float *   weight  = &op->weight[(size_t)row * op->nweights];
+      float     Tx, Ty, Tz, fcol, frow, fslc;
+      int       icol, irow, islc;
+
+      op->hit[row] = -1;
+
+      float const frac = op->depths[d];
+      if (frac != 0.0) {
+        if (ProjDistFlag)
+          ProjNormDist(&Tx, &Ty, &Tz, TrgSurf, vtx, frac);
+        else
+          ProjNormFracThick(&Tx, &Ty, &Tz, TrgSurf, vtx, frac);
+      } else {
+        Tx = v->x;
+        Ty = v->y;
+        Tz = v->z;
+      }
+
+      fcol = M[0][0] * Tx + M[0][1] * Ty + M[0][2] * Tz + M[0][3];
+      frow = M[1][0] * Tx + M[1][1] * Ty + M[1][2] * Tz + M[1][3];
+      fslc = M[2][0] * Tx + M[2][1] * Ty + M[2][2] * Tz + M[2][3];
+
+      switch (float2int) {
+      case FLT2INT_FLOOR:
+        icol = (int)floor(fcol);
+        irow = (int)floor(frow);
+        islc = (int)floor(fslc);
+        break;
+      case FLT2INT_TKREG:
+        icol = (int)floor(fcol);
+        irow = (int)ceil(frow);
+        islc = (int)floor(fslc);
+        break;
+      default:
+        icol = nint(fcol);
+        irow = nint(frow);
+        islc = nint(fslc);
+        break;
+      }
+
+      /* out of bounds rows keep zero weights, as vol2surf_linear()
+         leaves those vertices at zero */
+      if (irow < 0 || irow >= height || icol < 0 || icol >= width ||
+          islc < 0 || islc >= depth)
+        continue;
+
+      op->hit[row] = icol + width * (irow + height * islc);
+
+      if (op->nweights == 1) {
+        voxel[0]  = op->hit[row];
+        weight[0] = 1;
+        continue;
+      }
+
+      /* MRIsampleSeqVolume() returns outside_val when the nearest voxel
+         is out of the volume, which the floor and tkreg rounding let
+         through within half a voxel of the far edges */
+      if (MRIindexNotInVolume(SrcVol, fcol, frow, fslc) == 1) {
+        op->outside[row] = 1;
+        continue;
+      }
+
+      /* same clamping and weights as MRIsampleSeqVolume() */
+      double x = fcol, y = frow, z = fslc;
+      x        = MIN(MAX(x, 0.0), width - 1.0);
+      y        = MIN(MAX(y, 0.0), height - 1.0);
+      z        = MIN(MAX(z, 0.0), depth - 1.0);
+
+      int const    xm = (int)x, xp = MIN(width - 1, xm + 1);
+      int const    ym = (int)y, yp = MIN(height - 1, ym + 1);
+      int const    zm = (int)z, zp = MIN(depth - 1, zm + 1);
+      double const xmd = x - xm, ymd = y - ym, zmd = z - zm;
+      double const xpd = 1.0 - xmd, ypd = 1.0 - ymd, zpd = 1.0 - zmd;
+
+      for (int k = 0; k < 8; k++) {
+        int const    xi = (k & 4) ? xp : xm;
+        int const    yi = (k & 2) ? yp : ym;
+        int const    zi = (k & 1) ? zp : zm;
+        double const w  = ((k & 4) ? xmd : xpd) * ((k & 2) ? ymd : ypd) *
+                         ((k & 1) ? zmd : zpd);
+        voxel[k]  = xi + width * (yi + height * zi);
+        weight[k] = w;
+      }
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  return (op);
+}
+
+int vol2surf_operator_free(VOL2SURF_OPERATOR **pop) {
+  VOL2SURF_OPERATOR *op = *pop;
+
+  if (op == NULL)
+    return (NO_ERROR);
+  free(op->depths);
+  free(op->voxel);
+  free(op->weight);
+  free(op->hit);
+  free(op->outside);
+  free(op);
+  *pop = NULL;
+  return (NO_ERROR);
+}
+
+/* value of voxel offset off in a contiguous frame of the given type */
+static inline double vol2surfFrameVal(int type, const void *frame, int off) {
+  switch (type) {
+  case MRI_UCHAR:
+    return ((const BUFTYPE *)frame)[off];
+  case MRI_SHORT:
+    return ((const short *)frame)[off];
+  case MRI_INT:
+    return ((const int *)frame)[off];
+  case MRI_LONG:
+    return ((const long32 *)frame)[off];
+  default:
+    return ((const float *)frame)[off];
+  }
+}
+
+/*------------------------------------------------------------
+  vol2surf_operator_apply() - applies an operator built by
+  vol2surf_operator_alloc() to every frame of SrcVol. The output
+  is the average over the depths, or the maximum if GetProjMax
+  is set, matching mri_vol2surf's --projfrac-avg/--projfrac-max.
+  The work is split into (frame, block of vertices) tasks that
+  each write their own part of the output, so the result does
+  not depend on the number of threads. SrcHitVol, if non-NULL,
+  gets the hit counts of the last depth, which is what repeated
+  calls to vol2surf_linear() leave behind.
+  ------------------------------------------------------------*/
+#define VOL2SURF_BLOCK 4096
+
+MRI *vol2surf_operator_apply(const VOL2SURF_OPERATOR *op, MRI *SrcVol,
+                             int GetProjMax, MRI *SrcHitVol, MRI *TrgVol) {
+  int task, ntasks, nblocks;
+
+  if (SrcVol->width != op->width || SrcVol->height != op->height ||
+      SrcVol->depth != op->depth)
+    ErrorReturn(NULL, (ERROR_BADPARM,
+                       "vol2surf_operator_apply: volume is %dx%dx%d, operator "
+                       "was built for %dx%dx%d",
+                       SrcVol->width, SrcVol->height, SrcVol->depth, op->width,
+                       op->height, op->depth));
+
+  if (TrgVol == NULL) {
+    TrgVol =
+        MRIallocSequence(op->nvertices, 1, 1, MRI_FLOAT, SrcVol->nframes);
+    if (TrgVol == NULL)
+      return (NULL);
+    MRIcopyHeader(SrcVol, TrgVol);
+  } else if (TrgVol->width != op->nvertices ||
+             TrgVol->nframes != SrcVol->nframes || TrgVol->type != MRI_FLOAT)
+    ErrorReturn(NULL, (ERROR_BADPARM,
+                       "vol2surf_operator_apply: output dimension mismatch"));
+  TrgVol->xsize = 1;
+  TrgVol->ysize = 1;
+  TrgVol->zsize = 1;
+
+  nblocks = (op->nvertices + VOL2SURF_BLOCK - 1) / VOL2SURF_BLOCK;
+  ntasks  = nblocks * SrcVol->nframes;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (task = 0; task < ntasks; task++) {
+    ROMP_PFLB_begin
+    int const frame = task / nblocks;
+    int const vlo   = (task % nblocks) * VOL2SURF_BLOCK;
+    int const vhi   = MIN(vlo + VOL2SURF_BLOCK, op->nvertices);
+    int const nw    = op->nweights;
+    void *    base  = NULL;
+
+    if (SrcVol->ischunked)
+      base = (char *)SrcVol->chunk +
+             (size_t)frame * SrcVol->vox_per_vol * SrcVol->bytes_per_vox;
+
+    for (int vtx = vlo; vtx < vhi; vtx++) {
+      double result = 0;
+
+      for (int d = 0; d < op->ndepths; d++) {
+        size_t const row = (size_t)vtx * op->ndepths + d;
+        double       val = 0;
+
+        if (op->hit[row] >= 0 && op->outside[row])
+          val = SrcVol->outside_val;
+        else if (op->hit[row] >= 0) {
+          int const *  voxel  = &op->voxel[row * nw];
+          float const *weight = &op->weight[row * nw];
+          for (int k = 0; k < nw; k++) {
+            int const off = voxel[k];
+            if (base)
+              val += weight[k] * vol2surfFrameVal(SrcVol->type, base, off);
+            else
+              val += weight[k] *
+                     MRIgetVoxVal(SrcVol, off % op->width,
+                                  (off / op->width) % op->height,
+                                  off / (op->width * op->height), frame);
+          }
+        }
+        if (!GetProjMax)
+          result += val;
+        else if (d == 0 || val > result)
+          result = val;
+      }
+      if (!GetProjMax)
+        result /= op->ndepths;
+      MRIFseq_vox(TrgVol, vtx, 0, 0, frame) = result;
+      if (Gdiag_no == vtx && frame == 0)
+        printf("vol2surf_operator_apply: vtx %d val = %f\n", vtx, result);
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  if (SrcHitVol != NULL) {
+    MRIconst(SrcHitVol->width, SrcHitVol->height, SrcHitVol->depth, 1, 0,
+             SrcHitVol);
+    for (int vtx = 0; vtx < op->nvertices; vtx++) {
+      int const off = op->hit[(size_t)vtx * op->ndepths + op->ndepths - 1];
+      if (off >= 0)
+        MRIFseq_vox(SrcHitVol, off % op->width, (off / op->width) % op->height,
+                    off / (op->width * op->height), 0)++;
+    }
+  }
+
+  return (TrgVol);
+}
+
 /*!
 \fn MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
                   int ReverseMapFlag, int DoJac, int UseHash)
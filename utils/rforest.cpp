@@ -23,6 +23,10 @@
 #include <cstring>
 #include <math.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "romp_support.h"
 
 #include "const.h"
@@ -37,6 +41,7 @@ static double entropy(int *class_counts, int nclasses, int *Nc);
 static double rfFeatureInfoGain(RANDOM_FOREST *rf, TREE *tree, NODE *parent,
                                 NODE *left, NODE *right, int fno,
                                 int *ptotal_count);
+static void   rfFreeFlat(RANDOM_FOREST *rf);
 
 RANDOM_FOREST *RFalloc(int ntrees, int nfeatures, int nclasses, int max_depth,
                        char **class_names, int nsteps) {
@@ -106,15 +111,35 @@ RANDOM_FOREST *RFalloc(int ntrees, int nfeatures, int nclasses, int max_depth,
   return (rf);
 }
 
-static double compute_info_gain(RF *rf, TREE *tree, NODE *parent, NODE *left,
-                                NODE *right, double **training_data, int fno,
-                                double thresh) {
+// the information gained by splitting parent into the given class counts
+static double info_gain_from_counts(RF *rf, TREE *tree, NODE *parent,
+                                    int *left_counts, int *right_counts) {
   double entropy_before, entropy_after, wl, wr;
-  int    i, tno, c;
-  NODE * node;
+  int    c;
 
   entropy_before =
       entropy(parent->class_counts, rf->nclasses, tree->root.class_counts);
+  for (wr = wl = 0.0, c = 0; c < rf->nclasses; c++) {
+    if (tree->root.class_counts[c] == 0)
+      continue;
+    wl += (double)left_counts[c] / tree->root.class_counts[c];
+    wr += (double)right_counts[c] / tree->root.class_counts[c];
+  }
+  wl = wl / (wl + wr);
+  wr = 1 - wl;
+
+  entropy_after =
+      wl * entropy(left_counts, rf->nclasses, tree->root.class_counts) +
+      wr * entropy(right_counts, rf->nclasses, tree->root.class_counts);
+  return (entropy_before - entropy_after);
+}
+
+static double compute_info_gain(RF *rf, TREE *tree, NODE *parent, NODE *left,
+                                NODE *right, double **training_data, int fno,
+                                double thresh) {
+  int   i, tno;
+  NODE *node;
+
   memset(left->class_counts, 0, rf->nclasses * sizeof(left->class_counts[0]));
   memset(right->class_counts, 0, rf->nclasses * sizeof(right->class_counts[0]));
   left->total_counts = right->total_counts = 0;
@@ -129,38 +154,77 @@ static double compute_info_gain(RF *rf, TREE *tree, NODE *parent, NODE *left,
     node->training_set[node->total_counts] = i;
     node->total_counts++;
   }
-  for (wr = wl = 0.0, c = 0; c < rf->nclasses; c++) {
-    if (tree->root.class_counts[c] == 0)
-      continue;
-    wl += (double)left->class_counts[c] / tree->root.class_counts[c];
-    wr += (double)right->class_counts[c] / tree->root.class_counts[c];
+  return (info_gain_from_counts(rf, tree, parent, left->class_counts,
+                                right->class_counts));
+}
+
+/*
+  The parent's samples presorted on one feature, so that the split at any
+  threshold can be evaluated by moving a cursor instead of repartitioning
+  the training set. Thresholds visited in order cost amortized O(1) each.
+*/
+class ThresholdSweep {
+public:
+  ThresholdSweep(RF *rf, TREE *tree, NODE *parent, double **training_data,
+                 int fno)
+      : rf(rf), tree(tree), parent(parent), left(rf->nclasses, 0),
+        right(rf->nclasses, 0), pos(0) {
+    samples.reserve(parent->total_counts);
+    for (int tno = 0; tno < parent->total_counts; tno++) {
+      int const    i   = parent->training_set[tno];
+      double const val = training_data[i][fno];
+      // NaNs never compare less than a threshold, so they always go right
+      if (std::isnan(val))
+        right[rf->training_classes[i]]++;
+      else
+        samples.push_back(std::make_pair(val, rf->training_classes[i]));
+    }
+    std::sort(samples.begin(), samples.end());
+    for (auto const &sample : samples)
+      right[sample.second]++;
   }
-  wl = wl / (wl + wr);
-  wr = 1 - wl;
 
-  entropy_after =
-      wl * entropy(left->class_counts, rf->nclasses, tree->root.class_counts) +
-      wr * entropy(right->class_counts, rf->nclasses, tree->root.class_counts);
-  return (entropy_before - entropy_after);
-}
+  double infoGain(double thresh) {
+    while (pos < samples.size() && samples[pos].first < thresh) {
+      left[samples[pos].second]++;
+      right[samples[pos].second]--;
+      pos++;
+    }
+    while (pos > 0 && !(samples[pos - 1].first < thresh)) {
+      pos--;
+      left[samples[pos].second]--;
+      right[samples[pos].second]++;
+    }
+    return (info_gain_from_counts(rf, tree, parent, left.data(),
+                                  right.data()));
+  }
+
+private:
+  RF *                               rf;
+  TREE *                             tree;
+  NODE *                             parent;
+  std::vector<std::pair<double, int>> samples;
+  std::vector<int>                   left, right;
+  size_t                             pos;
+};
+
 static int adjust_optimal_threshold(RF *rf, TREE *tree, NODE *parent,
                                     NODE *left, NODE *right,
                                     double **training_data, int fno,
                                     double *pbest_thresh) {
   double previous_thresh, next_thresh, info_gain, best_info_gain, step, thresh,
       best_thresh;
+  ThresholdSweep sweep(rf, tree, parent, training_data, fno);
 
   best_thresh    = *pbest_thresh;
-  best_info_gain = compute_info_gain(rf, tree, parent, left, right,
-                                     training_data, fno, best_thresh);
+  best_info_gain = sweep.infoGain(best_thresh);
   if (rf->min_step_size > 0)
     step = rf->min_step_size;
   else
     step =
         (rf->feature_max[fno] - rf->feature_min[fno]) / (10 * rf->nsteps - 1);
   for (thresh = best_thresh; thresh <= rf->feature_max[fno]; thresh += step) {
-    info_gain = compute_info_gain(rf, tree, parent, left, right, training_data,
-                                  fno, thresh);
+    info_gain = sweep.infoGain(thresh);
     if (info_gain < 0)
       DiagBreak();
     if (info_gain > best_info_gain) {
@@ -173,8 +237,7 @@ static int adjust_optimal_threshold(RF *rf, TREE *tree, NODE *parent,
   }
   next_thresh = thresh - step;
   for (thresh = best_thresh; thresh >= rf->feature_min[fno]; thresh -= step) {
-    info_gain = compute_info_gain(rf, tree, parent, left, right, training_data,
-                                  fno, thresh);
+    info_gain = sweep.infoGain(thresh);
     if (info_gain > best_info_gain) {
       best_thresh    = thresh;
       best_info_gain = info_gain;
@@ -186,40 +249,71 @@ static int adjust_optimal_threshold(RF *rf, TREE *tree, NODE *parent,
   previous_thresh = thresh + step;
 
   thresh    = (next_thresh + previous_thresh) / 2; // maximize margin
-  info_gain = compute_info_gain(rf, tree, parent, left, right, training_data,
-                                fno, thresh);
-  if (info_gain < best_info_gain) // don't use it
-    compute_info_gain(rf, tree, parent, left, right, training_data, fno,
-                      best_thresh);
-  else
+  info_gain = sweep.infoGain(thresh);
+  if (info_gain >= best_info_gain) // use it
     best_thresh = thresh;
+  // leave the children partitioned at the chosen threshold
+  compute_info_gain(rf, tree, parent, left, right, training_data, fno,
+                    best_thresh);
   *pbest_thresh = best_thresh;
 
   return (NO_ERROR);
 }
 
+/*
+  Scans nsteps evenly spaced thresholds between fmin and fmax. Rather than
+  repartitioning the training set for every threshold, each sample is
+  histogrammed by the first threshold it falls below, and the left/right
+  class counts of consecutive thresholds are running sums of the histogram.
+*/
 static double find_optimal_threshold(RF *rf, TREE *tree, NODE *parent,
-                                     NODE *left, NODE *right,
                                      double **training_data, int ntraining,
                                      int fno, double *pinfo_gain, int nsteps,
                                      double fmin, double fmax) {
   double step, thresh, best_thresh, info_gain, best_info_gain;
+  int    c, k, nthresh, left_total, right_total;
 
   step = (fmax - fmin) / (nsteps - 1);
   if (FZERO(step) || step < rf->min_step_size)
     return (0.0);
 
+  std::vector<double> thresholds;
+  for (thresh = fmin; thresh < fmax; thresh += step)
+    thresholds.push_back(thresh);
+  nthresh = thresholds.size();
+
+  // hist row k counts the samples that go left from thresholds[k] on; the
+  // last row holds those that never do
+  std::vector<int> hist((nthresh + 1) * rf->nclasses, 0);
+  std::vector<int> left_counts(rf->nclasses, 0), right_counts(rf->nclasses, 0);
+  for (int tno = 0; tno < parent->total_counts; tno++) {
+    int const i = parent->training_set[tno];
+    k           = std::upper_bound(thresholds.begin(), thresholds.end(),
+                                   training_data[i][fno]) -
+        thresholds.begin();
+    hist[k * rf->nclasses + rf->training_classes[i]]++;
+    right_counts[rf->training_classes[i]]++;
+  }
+
   best_info_gain = -1e10;
   best_thresh    = 0;
-  for (thresh = fmin; thresh < fmax; thresh += step) {
-    info_gain = compute_info_gain(rf, tree, parent, left, right, training_data,
-                                  fno, thresh);
+  left_total     = 0;
+  right_total    = parent->total_counts;
+  for (k = 0; k < nthresh; k++) {
+    for (c = 0; c < rf->nclasses; c++) {
+      int const n = hist[k * rf->nclasses + c];
+      left_counts[c] += n;
+      right_counts[c] -= n;
+      left_total += n;
+      right_total -= n;
+    }
+    info_gain = info_gain_from_counts(rf, tree, parent, left_counts.data(),
+                                      right_counts.data());
     if (info_gain < 0)
       DiagBreak();
-    if (info_gain > best_info_gain && left->total_counts > 0 &&
-        right->total_counts > 0) {
+    if (info_gain > best_info_gain && left_total > 0 && right_total > 0) {
       best_info_gain = info_gain;
-      best_thresh    = thresh;
+      best_thresh    = thresholds[k];
     }
   }
   *pinfo_gain = best_info_gain;
@@ -251,9 +345,9 @@ static int find_optimal_feature_and_threshold(
     }
     nsteps = rf->nsteps;
     do {
-      thresh = find_optimal_threshold(rf, tree, parent, left, right,
-                                      rf->training_data, rf->ntraining, fno,
-                                      &info_gain, nsteps, fmin, fmax);
+      thresh = find_optimal_threshold(rf, tree, parent, rf->training_data,
+                                      rf->ntraining, fno, &info_gain, nsteps,
+                                      fmin, fmax);
       if (info_gain < 0)
         DiagBreak();
       nsteps *= 5;
@@ -269,8 +363,6 @@ static int find_optimal_feature_and_threshold(
   }
   if (best_f < 0)
     return (0);
-  info_gain = compute_info_gain(rf, tree, parent, left, right, training_data,
-                                best_f, best_thresh);
   adjust_optimal_threshold(rf, tree, parent, left, right, training_data, best_f,
                            &best_thresh);
   parent->thresh  = best_thresh;
@@ -417,9 +509,10 @@ int RFtrain(RANDOM_FOREST *rf, double feature_fraction,
             double training_fraction, int *training_classes,
             double **training_data, int ntraining) {
   int n, ii, nfeatures_per_tree = 0, *feature_permutation,
-             *training_permutation, f, index, start_no, end_no,
-             ntraining_per_tree = 0, total_to_remove = 0;
-  TREE *tree = nullptr;
+             *training_permutation, f, ntraining_per_tree = 0,
+             total_to_remove = 0;
+
+  rfFreeFlat(rf);
 
   if (rf->max_class_ratio > 0) {
     int class_counts[MAX_CLASSES], max_class, max_class_count, min_class,
@@ -525,28 +618,23 @@ int RFtrain(RANDOM_FOREST *rf, double feature_fraction,
   feature_permutation  = compute_permutation(rf->nfeatures, nullptr);
   training_permutation = compute_permutation(ntraining, nullptr);
 
+  // the trees only share read-only training data, and their feature and
+  // training subsets are fixed by the permutations above, so they can be
+  // trained concurrently with the same result
   ROMP_PF_begin
 #ifdef HAVE_OPENMP
-      tree = NULL;
-  start_no = 0; // only 1 tree
-  end_no   = 0; // only 1 tree
-  index    = 0;
-  n        = 0;
-  ii       = 0;
-#pragma omp parallel for if_ROMP(experimental)                                 \
-    firstprivate(tree, start_no, end_no, ii, index)                            \
-        shared(rf, nfeatures_per_tree, Gdiag, training_classes, training_data) \
-            schedule(static, 1)
+#pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
 #endif
   for (n = 0; n < rf->ntrees; n++) // train each tree
   {
     ROMP_PFLB_begin
+    TREE *tree = &rf->trees[n];
+    int   start_no, end_no, ii, index;
 
 #ifdef HAVE_OPENMP
 #pragma omp critical
 #endif
-        printf("training tree %d of %d....\n", n, rf->ntrees);
-    tree = &rf->trees[n];
+    printf("training tree %d of %d....\n", n, rf->ntrees);
 
     // randomize what features this tree will use
     tree->feature_list =
@@ -607,7 +695,7 @@ int RFtrain(RANDOM_FOREST *rf, double feature_fraction,
   }
   ROMP_PF_end
 
-      if (total_to_remove > 0) {
+  if (total_to_remove > 0) {
     for (n = 0; n < ntraining; n++)
       free(training_data[n]);
     free(training_data);
@@ -622,6 +710,7 @@ int RFtrainTree(RANDOM_FOREST *rf, int tno, int *training_classes,
   int   i, f;
   TREE *tree;
 
+  rfFreeFlat(rf);
   rf->training_data    = training_data;
   rf->training_classes = training_classes;
 
@@ -1059,6 +1148,161 @@ int RFclassify(RANDOM_FOREST *rf, double *feature, double *p_pval,
   return (max_class);
 }
 
+/*
+  Flattened forests: the nodes of all trees are copied into one array, with
+  the two children of a node in adjacent slots and the leaf class counts in
+  one nclasses-wide table, so classification walks contiguous memory and
+  never touches the pointer-linked NODEs.
+*/
+static void rfFreeFlat(RANDOM_FOREST *rf) {
+  RF_FLAT *flat = rf->flat;
+  if (flat == nullptr)
+    return;
+  rf->flat = nullptr;
+  free(flat->nodes);
+  free(flat->roots);
+  free(flat->leaf_counts);
+  free(flat);
+}
+
+static int rfCountNodes(NODE *node, int *pnleaves) {
+  if (node->left == nullptr) {
+    (*pnleaves)++;
+    return (1);
+  }
+  return (1 + rfCountNodes(node->left, pnleaves) +
+          rfCountNodes(node->right, pnleaves));
+}
+
+/*!
+  \fn int RFflatten(RANDOM_FOREST *rf)
+  \brief Builds the contiguous copy of the trees used by RFclassifyBatch().
+  Trees that RFclassify() ignores (all training samples in one class) are
+  left out. Training, pruning or changing the classes discards it.
+*/
+int RFflatten(RANDOM_FOREST *rf) {
+  RF_FLAT *flat;
+  int      n, c, nnodes, nleaves, next, leaf;
+  TREE *   tree;
+
+  rfFreeFlat(rf);
+  for (nnodes = nleaves = n = 0; n < rf->ntrees; n++)
+    nnodes += rfCountNodes(&rf->trees[n].root, &nleaves);
+
+  flat        = (RF_FLAT *)calloc(1, sizeof(RF_FLAT));
+  flat->nodes = (RF_FLAT_NODE *)calloc(nnodes, sizeof(RF_FLAT_NODE));
+  flat->roots = (int *)calloc(rf->ntrees, sizeof(int));
+  flat->leaf_counts =
+      (int *)calloc((size_t)nleaves * rf->nclasses, sizeof(int));
+  if (flat->nodes == nullptr || flat->roots == nullptr ||
+      flat->leaf_counts == nullptr)
+    ErrorExit(ERROR_NOMEMORY, "RFflatten: could not allocate %d nodes",
+              nnodes);
+
+  std::vector<std::pair<NODE *, int>> queue;
+  for (next = leaf = n = 0; n < rf->ntrees; n++) {
+    tree = &rf->trees[n];
+    for (c = 0; c < rf->nclasses; c++)
+      if (tree->root.class_counts[c] == tree->root.total_counts)
+        break;
+    if (c < rf->nclasses) // one class has all counts - see RFclassify
+    {
+      flat->roots[n] = -1;
+      continue;
+    }
+
+    // breadth first, so each node's children are allocated as a pair
+    flat->roots[n] = next++;
+    queue.clear();
+    queue.push_back(std::make_pair(&tree->root, flat->roots[n]));
+    for (size_t q = 0; q < queue.size(); q++) {
+      NODE *const         node = queue[q].first;
+      RF_FLAT_NODE *const fn   = &flat->nodes[queue[q].second];
+      if (node->left == nullptr) {
+        fn->feature = -1;
+        fn->child   = leaf;
+        memmove(&flat->leaf_counts[(size_t)leaf * rf->nclasses],
+                node->class_counts, rf->nclasses * sizeof(int));
+        leaf++;
+      } else {
+        fn->feature = node->feature;
+        fn->thresh  = node->thresh;
+        fn->child   = next;
+        queue.push_back(std::make_pair(node->left, next));
+        queue.push_back(std::make_pair(node->right, next + 1));
+        next += 2;
+      }
+    }
+  }
+  flat->nnodes  = next;
+  flat->nleaves = leaf;
+  rf->flat      = flat;
+  return (NO_ERROR);
+}
+
+/*!
+  \fn int RFclassifyBatch(RANDOM_FOREST *rf, double **features, int nsamples,
+                          int *classes, double *pvals)
+  \brief Classifies nsamples feature vectors in parallel. classes[i] and
+  pvals[i] (which may be NULL) get what RFclassify() would return and store
+  in *p_pval for features[i]. rf->pvals is not touched, so this is safe to
+  run while other threads classify, once the forest has been flattened.
+*/
+int RFclassifyBatch(RANDOM_FOREST *rf, double **features, int nsamples,
+                    int *classes, double *pvals) {
+  if (rf->flat == nullptr)
+    RFflatten(rf);
+  RF_FLAT const *const flat = rf->flat;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (int i = 0; i < nsamples; i++) {
+    ROMP_PFLB_begin
+    double const *const feature = features[i];
+    double              class_counts[MAX_CLASSES], total_count, max_count;
+    int                 n, c, max_class = -1;
+
+    memset(class_counts, 0, sizeof(class_counts));
+    for (n = 0; n < rf->ntrees; n++) {
+      int node = flat->roots[n];
+      if (node < 0)
+        continue;
+      while (flat->nodes[node].feature >= 0) {
+        RF_FLAT_NODE const *const fn = &flat->nodes[node];
+        node = fn->child + !(feature[fn->feature] < fn->thresh);
+      }
+      int const *const counts =
+          &flat->leaf_counts[(size_t)flat->nodes[node].child * rf->nclasses];
+      for (c = 0; c < rf->nclasses; c++)
+        class_counts[c] += counts[c];
+    }
+
+    for (total_count = c = 0; c < rf->nclasses; c++)
+      total_count += class_counts[c];
+    if (pvals)
+      pvals[i] = 0;
+    if (FZERO(total_count)) {
+      classes[i] = 0;
+      ROMP_PF_continue;
+    }
+    for (max_count = c = 0; c < rf->nclasses; c++) {
+      if (class_counts[c] > max_count) {
+        max_count = class_counts[c];
+        max_class = c;
+        if (pvals)
+          pvals[i] = (double)class_counts[c] / total_count;
+      }
+    }
+    classes[i] = max_class;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  return (NO_ERROR);
+}
+
 RANDOM_FOREST *RFread(char *fname) {
   FILE *fp;
   RF *  rf;
@@ -1131,6 +1375,7 @@ int RFsetNumberOfClasses(RANDOM_FOREST *rf, int nclasses) {
   int *  old_class_counts;
   TREE * tree;
 
+  rfFreeFlat(rf);
   if (nclasses > rf->nclasses) {
     old_class_names = rf->class_names;
     rf->class_names = (char **)calloc(nclasses, sizeof(rf->class_names[0]));
@@ -1246,6 +1491,7 @@ int RFfree(RANDOM_FOREST **prf) {
 
   *prf = nullptr;
 
+  rfFreeFlat(rf);
   for (t = 0; t < rf->ntrees; t++) {
     tree = &rf->trees[t];
     rfFreeNodes(tree->root.left);
@@ -1284,6 +1530,7 @@ int RFpruneTree(RANDOM_FOREST *rf, int min_training_samples) {
   int   t;
   TREE *tree;
 
+  rfFreeFlat(rf);
   for (t = 0; t < rf->ntrees; t++) {
     tree = &rf->trees[t];
     rfPruneTree(&tree->root, min_training_samples);
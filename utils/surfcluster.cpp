@@ -25,6 +25,7 @@
 #include <cstring>
 #include <math.h>
 
+#include "cclabel.h"
 #include "diag.h"
 #include "matrix.h"
 #include "mri.h"
@@ -55,31 +56,41 @@ SCS *sclustMapSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax,
   float vtx_val, ClusterArea;
   int   nVtxsInCluster;
 
+  static int use_old = -1;
+  if (use_old < 0)
+    use_old = (getenv("FREESURFER_OLD_sclustMapSurfClusters") != nullptr);
+
   /* initialized all cluster numbers to 0 */
   for (vtx = 0; vtx < Surf->nvertices; vtx++)
     Surf->vertices[vtx].undefval = 0; /* overloads this elem of struct */
 
-  /* Go through each vertex looking for one that meets the threshold
-     criteria and has not been previously assigned to a cluster.
-     When found, grow it out. */
-  CurrentClusterNo = 1;
-  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
-    vtx_val     = Surf->vertices[vtx].val;
-    vtx_clustno = Surf->vertices[vtx].undefval;
-    vtx_inrange = clustValueInRange(vtx_val, thmin, thmax, thsign);
-
-    if (vtx_clustno == 0 && vtx_inrange) {
-      sclustGrowSurfCluster(CurrentClusterNo, vtx, Surf, thmin, thmax, thsign);
-      if (minarea > 0) {
-        /* If the cluster does not meet the area criteria, delete it */
-        ClusterArea =
-            sclustSurfaceArea(CurrentClusterNo, Surf, &nVtxsInCluster);
-        if (ClusterArea < minarea) {
-          sclustZeroSurfaceClusterNo(CurrentClusterNo, Surf);
-          continue;
+  if (!use_old) {
+    CurrentClusterNo =
+        sclustLabelSurfClusters(Surf, thmin, thmax, thsign, minarea) + 1;
+  } else {
+    /* Go through each vertex looking for one that meets the threshold
+       criteria and has not been previously assigned to a cluster.
+       When found, grow it out. */
+    CurrentClusterNo = 1;
+    for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+      vtx_val     = Surf->vertices[vtx].val;
+      vtx_clustno = Surf->vertices[vtx].undefval;
+      vtx_inrange = clustValueInRange(vtx_val, thmin, thmax, thsign);
+
+      if (vtx_clustno == 0 && vtx_inrange) {
+        sclustGrowSurfCluster(CurrentClusterNo, vtx, Surf, thmin, thmax,
+                              thsign);
+        if (minarea > 0) {
+          /* If the cluster does not meet the area criteria, delete it */
+          ClusterArea =
+              sclustSurfaceArea(CurrentClusterNo, Surf, &nVtxsInCluster);
+          if (ClusterArea < minarea) {
+            sclustZeroSurfaceClusterNo(CurrentClusterNo, Surf);
+            continue;
+          }
         }
+        CurrentClusterNo++;
       }
-      CurrentClusterNo++;
     }
   }
 
@@ -107,6 +118,75 @@ SCS *sclustMapSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax,
 
   return (scs_sorted);
 }
+/* ------------------------------------------------------------
+   sclustLabelSurfClusters() - assigns all the clusters at once with
+   the union-find labeler in cclabel.cpp. Produces the same undefval
+   cluster numbers as the sclustGrowSurfCluster() loop: clusters are
+   numbered in order of their lowest vertex, and clusters smaller than
+   minarea are dropped without using up a number. Returns the number
+   of clusters. Setting FREESURFER_OLD_sclustMapSurfClusters reverts
+   sclustMapSurfClusters() to the recursive grower.
+   ------------------------------------------------------------ */
+int sclustLabelSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax,
+                            int thsign, float minarea) {
+  int            vtx, nbr, n, c, nClusters, *xadj, *adjncy, *clusterno;
+  unsigned char *mask;
+  float *        vtxarea, *clusterarea;
+  CCLABELS *     ccl;
+
+  xadj    = (int *)calloc(Surf->nvertices + 1, sizeof(int));
+  mask    = (unsigned char *)calloc(Surf->nvertices + 1, 1);
+  vtxarea = (float *)calloc(Surf->nvertices + 1, sizeof(float));
+  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+    xadj[vtx + 1] = xadj[vtx] + Surf->vertices_topology[vtx].vnum;
+    mask[vtx] =
+        clustValueInRange(Surf->vertices[vtx].val, thmin, thmax, thsign);
+    if (!Surf->group_avg_vtxarea_loaded)
+      vtxarea[vtx] = Surf->vertices[vtx].area;
+    else
+      vtxarea[vtx] = Surf->vertices[vtx].group_avg_area;
+  }
+  adjncy = (int *)calloc(xadj[Surf->nvertices] + 1, sizeof(int));
+  for (vtx = 0, n = 0; vtx < Surf->nvertices; vtx++)
+    for (nbr = 0; nbr < Surf->vertices_topology[vtx].vnum; nbr++)
+      adjncy[n++] = Surf->vertices_topology[vtx].v[nbr];
+
+  ccl = CCLlabelGraph(mask, Surf->nvertices, xadj, adjncy, nullptr, vtxarea,
+                      thsign);
+  free(xadj);
+  free(adjncy);
+  free(mask);
+  if (ccl == nullptr) {
+    free(vtxarea);
+    return (0);
+  }
+
+  /* the areas are summed in float and in vertex order, as in
+     sclustSurfaceArea(), so that clusters right at minarea are kept or
+     dropped the same way */
+  clusterarea = (float *)calloc(ccl->ncomponents + 1, sizeof(float));
+  for (vtx = 0; vtx < Surf->nvertices; vtx++)
+    clusterarea[ccl->id[vtx]] += vtxarea[vtx];
+  free(vtxarea);
+  if (Surf->group_avg_surface_area > 0 && !Surf->group_avg_vtxarea_loaded)
+    for (c = 1; c <= ccl->ncomponents; c++)
+      clusterarea[c] *= (Surf->group_avg_surface_area / Surf->total_area);
+
+  clusterno = (int *)calloc(ccl->ncomponents + 1, sizeof(int));
+  nClusters = 0;
+  for (c = 1; c <= ccl->ncomponents; c++) {
+    if (minarea > 0 && clusterarea[c] < minarea)
+      continue;
+    clusterno[c] = ++nClusters;
+  }
+  for (vtx = 0; vtx < Surf->nvertices; vtx++)
+    Surf->vertices[vtx].undefval = clusterno[ccl->id[vtx]];
+
+  free(clusterno);
+  free(clusterarea);
+  CCLfree(&ccl);
+  return (nClusters);
+}
 /* ------------------------------------------------------------
    sclustGrowSurfCluster() - grows a cluster on the surface from
    the SeedVtx. The cluster is a list of vertices that are
@@ -1271,15 +1271,15 @@ MATRIX *LTAtransformAtPoint(LTA *lta, float x, float y, float z, MATRIX *m_L) {
   LT *   lt;
   int    i;
   double w_p[MAX_TRANSFORMS], wtotal, dsq, sigma, dx, dy, dz, w_k_p, wmin;
-  static MATRIX *m_tmp = NULL;
+  MatrixBuffer m_tmp_buffer;
+  MATRIX *     m_tmp;
 
   if (m_L == NULL)
     m_L = MatrixAlloc(4, 4, MATRIX_REAL);
   else
     MatrixClear(m_L);
 
-  if (m_tmp == NULL)
-    m_tmp = MatrixAlloc(4, 4, MATRIX_REAL);
+  m_tmp = MatrixAlloc2(4, 4, MATRIX_REAL, &m_tmp_buffer);
 
   /* first compute normalized weights */
   for (wtotal = 0.0, i = 0; i < lta->num_xforms; i++) {
@@ -1308,6 +1308,7 @@ MATRIX *LTAtransformAtPoint(LTA *lta, float x, float y, float z, MATRIX *m_L) {
       MatrixAdd(m_L, m_tmp, m_L);
     }
   }
+  MatrixFree(&m_tmp);
   return (m_L);
 }
 /*-----------------------------------------------------
@@ -1322,16 +1323,15 @@ MATRIX *LTAinverseTransformAtPoint(LTA *lta, float x, float y, float z,
   LT *   lt;
   int    i;
   double w_p[MAX_TRANSFORMS], wtotal, dsq, sigma, dx, dy, dz, w_k_p, wmin;
-  static MATRIX *m_tmp = NULL;
-  MATRIX *       m_inv;
+  MatrixBuffer m_tmp_buffer;
+  MATRIX *     m_tmp, *m_inv;
 
   if (m_L == NULL)
     m_L = MatrixAlloc(4, 4, MATRIX_REAL);
   else
     MatrixClear(m_L);
 
-  if (m_tmp == NULL)
-    m_tmp = MatrixAlloc(4, 4, MATRIX_REAL);
+  m_tmp = MatrixAlloc2(4, 4, MATRIX_REAL, &m_tmp_buffer);
 
   /* first compute normalized weights */
   for (wtotal = 0.0, i = 0; i < lta->num_xforms; i++) {
@@ -1347,7 +1347,7 @@ MATRIX *LTAinverseTransformAtPoint(LTA *lta, float x, float y, float z,
   }
 
   if (lta->num_xforms == 1) {
-    m_L = MatrixInverse(lta->xforms[0].m_L, NULL);
+    m_L = MatrixInverse(lta->xforms[0].m_L, m_L);
   } else {
     if (DZERO(wtotal)) /* no transforms in range??? */
       MatrixIdentity(4, m_L);
@@ -1369,6 +1369,7 @@ MATRIX *LTAinverseTransformAtPoint(LTA *lta, float x, float y, float z,
       }
     }
   }
+  MatrixFree(&m_tmp);
   return (m_L);
 }
 /*-----------------------------------------------------
@@ -1379,10 +1380,12 @@ MATRIX *LTAinverseTransformAtPoint(LTA *lta, float x, float y, float z,
   Description
   ------------------------------------------------------*/
 VECTOR *LTAtransformPoint(LTA *lta, VECTOR *v_X, VECTOR *v_Y) {
-  static MATRIX *m_L = NULL;
+  MatrixBuffer m_L_buffer;
+  MATRIX *     m_L = MatrixAlloc2(4, 4, MATRIX_REAL, &m_L_buffer);
 
   m_L = LTAtransformAtPoint(lta, V3_X(v_X), V3_Y(v_X), V3_Z(v_X), m_L);
   v_Y = MatrixMultiply(m_L, v_X, v_Y);
+  MatrixFree(&m_L);
   return (v_Y);
 }
 /*-----------------------------------------------------
@@ -1393,10 +1396,12 @@ VECTOR *LTAtransformPoint(LTA *lta, VECTOR *v_X, VECTOR *v_Y) {
   Description
   ------------------------------------------------------*/
 VECTOR *LTAinverseTransformPoint(LTA *lta, VECTOR *v_X, VECTOR *v_Y) {
-  static MATRIX *m_L = NULL;
+  MatrixBuffer m_L_buffer;
+  MATRIX *     m_L = MatrixAlloc2(4, 4, MATRIX_REAL, &m_L_buffer);
 
   m_L = LTAinverseTransformAtPoint(lta, V3_X(v_X), V3_Y(v_X), V3_Z(v_X), m_L);
   v_Y = MatrixMultiply(m_L, v_X, v_Y);
+  MatrixFree(&m_L);
   return (v_Y);
 }
 /*-----------------------------------------------------
@@ -1413,18 +1418,16 @@ double LTAtransformPointAndGetWtotal(LTA *lta, VECTOR *v_X, VECTOR *v_Y) {
   int    i;
   double w_p[MAX_TRANSFORMS], wtotal, dsq, sigma, dx, dy, dz, w_k_p, wmin, x, y,
       z;
-  static MATRIX *m_tmp = NULL, *m_L = NULL;
+  MatrixBuffer m_tmp_buffer, m_L_buffer;
+  MATRIX *     m_tmp, *m_L;
 
-  x = V3_X(v_X);
-  y = V3_Y(v_X);
-  z = V3_Z(v_X);
-  if (m_L == NULL)
-    m_L = MatrixAlloc(4, 4, MATRIX_REAL);
-  else
-    MatrixClear(m_L);
+  x   = V3_X(v_X);
+  y   = V3_Y(v_X);
+  z   = V3_Z(v_X);
+  m_L = MatrixAlloc2(4, 4, MATRIX_REAL, &m_L_buffer);
+  MatrixClear(m_L);
 
-  if (m_tmp == NULL)
-    m_tmp = MatrixAlloc(4, 4, MATRIX_REAL);
+  m_tmp = MatrixAlloc2(4, 4, MATRIX_REAL, &m_tmp_buffer);
 
   /* first compute normalized weights */
   for (wtotal = 0.0, i = 0; i < lta->num_xforms; i++) {
@@ -1455,6 +1458,8 @@ double LTAtransformPointAndGetWtotal(LTA *lta, VECTOR *v_X, VECTOR *v_Y) {
   }
 
   MatrixMultiply(m_L, v_X, v_Y);
+  MatrixFree(&m_tmp);
+  MatrixFree(&m_L);
   return (wtotal);
 }
 /*-----------------------------------------------------*/
@@ -1654,12 +1659,10 @@ static LTA *ltaMNIread(const char *fname) {
   ------------------------------------------------------*/
 int LTAworldToWorld(LTA *lta, float x, float y, float z, float *px, float *py,
                     float *pz) {
-  static VECTOR *v_X, *v_Y = NULL;
+  MatrixBuffer v_X_buffer, v_Y_buffer;
+  VECTOR *     v_X = MatrixAlloc2(4, 1, MATRIX_REAL, &v_X_buffer);
+  VECTOR *     v_Y = MatrixAlloc2(4, 1, MATRIX_REAL, &v_Y_buffer);
 
-  if (v_Y == NULL) {
-    v_X = VectorAlloc(4, MATRIX_REAL);
-    v_Y = VectorAlloc(4, MATRIX_REAL);
-  }
   /* world to voxel */
   v_X->rptr[4][1] = 1.0f;
   V3_X(v_X)       = x;
@@ -1673,6 +1676,8 @@ int LTAworldToWorld(LTA *lta, float x, float y, float z, float *px, float *py,
   *py = V3_Y(v_Y);
   *pz = V3_Z(v_Y);
 
+  MatrixFree(&v_X);
+  MatrixFree(&v_Y);
   return (NO_ERROR);
 }
 /*-----------------------------------------------------
@@ -1686,12 +1691,9 @@ int LTAworldToWorld(LTA *lta, float x, float y, float z, float *px, float *py,
   ------------------------------------------------------*/
 int LTAworldToWorldEx(LTA *lta, float x, float y, float z, float *px, float *py,
                       float *pz) {
-  static VECTOR *v_X, *v_Y = NULL;
-
-  if (v_Y == NULL) {
-    v_X = VectorAlloc(4, MATRIX_REAL);
-    v_Y = VectorAlloc(4, MATRIX_REAL);
-  }
+  MatrixBuffer v_X_buffer, v_Y_buffer;
+  VECTOR *     v_X = MatrixAlloc2(4, 1, MATRIX_REAL, &v_X_buffer);
+  VECTOR *     v_Y = MatrixAlloc2(4, 1, MATRIX_REAL, &v_Y_buffer);
 
   v_X->rptr[4][1] = 1.0f;
   V3_X(v_X)       = x;
@@ -1704,6 +1706,8 @@ int LTAworldToWorldEx(LTA *lta, float x, float y, float z, float *px, float *py,
   *py = V3_Y(v_Y);
   *pz = V3_Z(v_Y);
 
+  MatrixFree(&v_X);
+  MatrixFree(&v_Y);
   return (NO_ERROR);
 }
 /*-----------------------------------------------------
@@ -1715,12 +1719,10 @@ int LTAworldToWorldEx(LTA *lta, float x, float y, float z, float *px, float *py,
   ------------------------------------------------------*/
 int LTAinverseWorldToWorld(LTA *lta, float x, float y, float z, float *px,
                            float *py, float *pz) {
-  static VECTOR *v_X, *v_Y = NULL;
+  MatrixBuffer v_X_buffer, v_Y_buffer;
+  VECTOR *     v_X = MatrixAlloc2(4, 1, MATRIX_REAL, &v_X_buffer);
+  VECTOR *     v_Y = MatrixAlloc2(4, 1, MATRIX_REAL, &v_Y_buffer);
 
-  if (v_Y == NULL) {
-    v_X = VectorAlloc(4, MATRIX_REAL);
-    v_Y = VectorAlloc(4, MATRIX_REAL);
-  }
   /* world to voxel */
   v_X->rptr[4][1] = 1.0f;
   V3_X(v_X)       = 128.0 - x;
@@ -1734,17 +1736,17 @@ int LTAinverseWorldToWorld(LTA *lta, float x, float y, float z, float *px,
   *py = V3_Z(v_Y) - 128.0;
   *pz = -(V3_Y(v_Y) - 128.0);
 
+  MatrixFree(&v_X);
+  MatrixFree(&v_Y);
   return (NO_ERROR);
 }
 
 int LTAinverseWorldToWorldEx(LTA *lta, float x, float y, float z, float *px,
                              float *py, float *pz) {
-  static VECTOR *v_X, *v_Y = NULL;
+  MatrixBuffer v_X_buffer, v_Y_buffer;
+  VECTOR *     v_X = MatrixAlloc2(4, 1, MATRIX_REAL, &v_X_buffer);
+  VECTOR *     v_Y = MatrixAlloc2(4, 1, MATRIX_REAL, &v_Y_buffer);
 
-  if (v_Y == NULL) {
-    v_X = VectorAlloc(4, MATRIX_REAL);
-    v_Y = VectorAlloc(4, MATRIX_REAL);
-  }
   /* world to voxel */
   v_X->rptr[4][1] = 1.0f;
   V3_X(v_X)       = x;
@@ -1758,6 +1760,8 @@ int LTAinverseWorldToWorldEx(LTA *lta, float x, float y, float z, float *px,
   *py = V3_Y(v_Y);
   *pz = V3_Z(v_Y);
 
+  MatrixFree(&v_X);
+  MatrixFree(&v_Y);
   return (NO_ERROR);
 }
 
@@ -2075,6 +2079,233 @@ int TransformFree(TRANSFORM **ptrans) {
   return errCode;
 }
 
+/*-----------------------------------------------------------
+  TransformEvaluatorInit() - fills te for transform. Like the
+  TransformSample*() functions always did, an LTA that is not vox2vox
+  is converted in place, so do this before going parallel.
+  -----------------------------------------------------------*/
+int TransformEvaluatorInit(TRANSFORM_EVALUATOR *te,
+                           const TRANSFORM *    transform) {
+  LTA *   lta;
+  MATRIX *m_L_inv;
+  int     i, r, c;
+
+  memset(te, 0, sizeof(*te));
+  if (transform->type == MORPH_3D_TYPE) {
+    const GCA_MORPH *gcam = (const GCA_MORPH *)transform->xform;
+
+    te->type     = MORPH_3D_TYPE;
+    te->gcam     = gcam;
+    te->mri_xind = gcam->mri_xind;
+    te->mri_yind = gcam->mri_yind;
+    te->mri_zind = gcam->mri_zind;
+    te->spacing  = gcam->spacing;
+    return (NO_ERROR);
+  }
+
+  lta = (LTA *)transform->xform;
+  if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
+    printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
+    lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
+    printf("After conversion:\n");
+    for (i = 0; i < lta->num_xforms; i++) {
+      LINEAR_TRANSFORM *lt = &lta->xforms[i];
+      MatrixAsciiWriteInto(stdout, lt->m_L);
+    }
+  }
+  te->type = LINEAR_VOX_TO_VOX;
+  for (r = 0; r < 3; r++)
+    for (c = 0; c < 4; c++)
+      te->L[r][c] = *MATRIX_RELT(lta->xforms[0].m_L, r + 1, c + 1);
+
+  /* the inverse samplers use the stored inverse, as they always did. An
+     LTA that was built without one gets the inverse of its forward
+     matrix rather than a zero map */
+  if (lta->inv_xforms && lta->inv_xforms[0].m_L) {
+    for (r = 0; r < 3; r++)
+      for (c = 0; c < 4; c++)
+        te->L_inv[r][c] = *MATRIX_RELT(lta->inv_xforms[0].m_L, r + 1, c + 1);
+    return (NO_ERROR);
+  }
+  m_L_inv = MatrixInverse(lta->xforms[0].m_L, NULL);
+  if (!m_L_inv)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM,
+                 "TransformEvaluatorInit: transform is not invertible"));
+  for (r = 0; r < 3; r++)
+    for (c = 0; c < 4; c++)
+      te->L_inv[r][c] = *MATRIX_RELT(m_L_inv, r + 1, c + 1);
+  MatrixFree(&m_L_inv);
+  return (NO_ERROR);
+}
+
+/* L * (x,y,z,1) accumulated in float in the order MatrixMultiply() uses,
+   so the results are bit for bit those of the NR version */
+static void transformEvaluateAffine(const float L[3][4], float x, float y,
+                                    float z, float *px, float *py,
+                                    float *pz) {
+  float v[3];
+  int   r;
+
+  for (r = 0; r < 3; r++) {
+    float val = 0.0f;
+    val += L[r][0] * x;
+    val += L[r][1] * y;
+    val += L[r][2] * z;
+    val += L[r][3] * 1.0f;
+    v[r] = val;
+  }
+  *px = v[0];
+  *py = v[1];
+  *pz = v[2];
+}
+
+/*-----------------------------------------------------------
+  TransformEvaluate() - maps (xv,yv,zv) as the TransformSample*()
+  function selected by which (TE_SAMPLE, ...) does, without touching
+  any shared state.
+  -----------------------------------------------------------*/
+int TransformEvaluate(const TRANSFORM_EVALUATOR *te, int which, float xv,
+                      float yv, float zv, float *px, float *py, float *pz) {
+  const GCA_MORPH *gcam;
+  double           xd, yd, zd;
+  int              xi, yi, zi;
+
+  if (te->type != MORPH_3D_TYPE) {
+    switch (which) {
+    case TE_SAMPLE_INVERSE:
+      transformEvaluateAffine(te->L_inv, (float)(int)xv, (float)(int)yv,
+                              (float)(int)zv, px, py, pz);
+      break;
+    case TE_SAMPLE_INVERSE_FLOAT:
+      transformEvaluateAffine(te->L_inv, xv, yv, zv, px, py, pz);
+      break;
+    default:
+      transformEvaluateAffine(te->L, xv, yv, zv, px, py, pz);
+      if (which == TE_SAMPLE_REAL || which == TE_SAMPLE_REAL2) {
+        if (*px < 0)
+          *px = 0;
+        if (*py < 0)
+          *py = 0;
+        if (*pz < 0)
+          *pz = 0;
+      }
+      break;
+    }
+    return (NO_ERROR);
+  }
+
+  gcam = (const GCA_MORPH *)te->gcam;
+  if (which == TE_SAMPLE_INVERSE) {
+    xi = (int)xv / te->spacing;
+    yi = (int)yv / te->spacing;
+    zi = (int)zv / te->spacing;
+    xi = MAX(0, MIN(gcam->width - 1, xi));
+    yi = MAX(0, MIN(gcam->height - 1, yi));
+    zi = MAX(0, MIN(gcam->depth - 1, zi));
+
+    const GCA_MORPH_NODE *gcamn = &gcam->nodes[xi][yi][zi];
+    *px                         = gcamn->x;
+    *py                         = gcamn->y;
+    *pz                         = gcamn->z;
+    // if marked invalid, then return error
+    return (gcamn->invalid ? ERROR_BADPARM : NO_ERROR);
+  }
+  if (which == TE_SAMPLE_INVERSE_FLOAT) {
+    // Return error if out of bounds instead of closest valid coordinates:
+    // when interpolating, this will prevent things like repeating voxels at
+    // the tip of the nose until reaching the edge of the image.
+    return (GCAMsampleMorph(gcam, xv, yv, zv, px, py, pz));
+  }
+
+  *px = *py = *pz = 0;
+  if (!te->mri_xind)
+    ErrorReturn(
+        ERROR_UNSUPPORTED,
+        (ERROR_UNSUPPORTED, "TransformSample: gcam has not been inverted!"));
+
+  // the following should not happen /////////////////
+  if (xv < 0)
+    xv = 0;
+  if (xv >= te->mri_xind->width)
+    xv = te->mri_xind->width - 1;
+  if (yv < 0)
+    yv = 0;
+  if (yv >= te->mri_yind->height)
+    yv = te->mri_yind->height - 1;
+  if (zv < 0)
+    zv = 0;
+  if (zv >= te->mri_zind->depth)
+    zv = te->mri_zind->depth - 1;
+
+  if (which == TE_SAMPLE_REAL) {
+    xi  = nint(xv);
+    yi  = nint(yv);
+    zi  = nint(zv);
+    *px = MRIgetVoxVal(te->mri_xind, xi, yi, zi, 0) * te->spacing;
+    *py = MRIgetVoxVal(te->mri_yind, xi, yi, zi, 0) * te->spacing;
+    *pz = MRIgetVoxVal(te->mri_zind, xi, yi, zi, 0) * te->spacing;
+    return (NO_ERROR);
+  }
+
+  MRIsampleVolume(te->mri_xind, xv, yv, zv, &xd);
+  MRIsampleVolume(te->mri_yind, xv, yv, zv, &yd);
+  MRIsampleVolume(te->mri_zind, xv, yv, zv, &zd);
+  if (which == TE_SAMPLE) {
+    *px = (float)xd * te->spacing;
+    *py = (float)yd * te->spacing;
+    *pz = (float)zd * te->spacing;
+  } else {
+    *px = (float)(xd * te->spacing);
+    *py = (float)(yd * te->spacing);
+    *pz = (float)(zd * te->spacing);
+  }
+  return (NO_ERROR);
+}
+
+/*-----------------------------------------------------------
+  TransformEvaluateArray() - TransformEvaluate() of npoints (x,y,z)
+  triples in src into dst, which may be the same array. If errors is
+  not NULL it gets the error code of each point. Returns the number of
+  points that failed.
+  -----------------------------------------------------------*/
+int TransformEvaluateArray(const TRANSFORM_EVALUATOR *te, int which,
+                           int npoints, const float *src, float *dst,
+                           int *errors) {
+  int n, err, nerrors = 0;
+
+  if (te->type == MORPH_3D_TYPE && !te->mri_xind &&
+      (which == TE_SAMPLE || which == TE_SAMPLE_REAL ||
+       which == TE_SAMPLE_REAL2)) {
+    for (n = 0; n < 3 * npoints; n++)
+      dst[n] = 0;
+    for (n = 0; errors && n < npoints; n++)
+      errors[n] = ERROR_UNSUPPORTED;
+    ErrorReturn(npoints, (ERROR_UNSUPPORTED,
+                          "TransformEvaluateArray: gcam has not been "
+                          "inverted!"));
+  }
+
+  if (te->type != MORPH_3D_TYPE && which == TE_SAMPLE) {
+    for (n = 0; n < npoints; n++, src += 3, dst += 3)
+      transformEvaluateAffine(te->L, src[0], src[1], src[2], &dst[0], &dst[1],
+                              &dst[2]);
+    if (errors)
+      memset(errors, 0, npoints * sizeof(int));
+    return (0);
+  }
+
+  for (n = 0; n < npoints; n++, src += 3, dst += 3) {
+    err = TransformEvaluate(te, which, src[0], src[1], src[2], &dst[0], &dst[1],
+                            &dst[2]);
+    if (errors)
+      errors[n] = err;
+    if (err != NO_ERROR)
+      nerrors++;
+  }
+  return (nerrors);
+}
+
 /*
   take a voxel in MRI space and find the voxel in the
   gca/gcamorph space to which it maps. Note that the caller
@@ -2084,264 +2315,26 @@ int TransformFree(TRANSFORM **ptrans) {
 // no range check is done here.   user must validate the range
 int TransformSample(TRANSFORM *transform, float xv, float yv, float zv,
                     float *px, float *py, float *pz) {
-  static VECTOR *v_input, *v_canon = NULL;
-  float          xt, yt, zt;
-  LTA *          lta;
-  GCA_MORPH *    gcam;
-  int            errCode = NO_ERROR, xi, yi, zi;
-  double         xd, yd, zd;
-
-  *px = *py = *pz = 0;
-  if (transform->type == MORPH_3D_TYPE) {
-    gcam = (GCA_MORPH *)transform->xform;
+  TRANSFORM_EVALUATOR te;
 
-    if (!gcam->mri_xind)
-      ErrorReturn(
-          ERROR_UNSUPPORTED,
-          (ERROR_UNSUPPORTED, "TransformSample: gcam has not been inverted!"));
-
-    // the following should not happen /////////////////
-    if (xv < 0)
-      xv = 0;
-    if (xv >= gcam->mri_xind->width)
-      xv = gcam->mri_xind->width - 1;
-    if (yv < 0)
-      yv = 0;
-    if (yv >= gcam->mri_yind->height)
-      yv = gcam->mri_yind->height - 1;
-    if (zv < 0)
-      zv = 0;
-    if (zv >= gcam->mri_zind->depth)
-      zv = gcam->mri_zind->depth - 1;
-
-    xi = nint(xv);
-    yi = nint(yv);
-    zi = nint(zv);
-    if (xi < 0)
-      xi = 0;
-    else if (xi >= gcam->mri_xind->width)
-      xi = gcam->mri_xind->width - 1;
-    if (yi < 0)
-      yi = 0;
-    else if (yi >= gcam->mri_yind->height)
-      yi = gcam->mri_yind->height - 1;
-    if (zi < 0)
-      zi = 0;
-    else if (zi >= gcam->mri_zind->depth)
-      zi = gcam->mri_zind->depth - 1;
-
-    xt = nint(MRIgetVoxVal(gcam->mri_xind, xi, yi, zi, 0) * gcam->spacing);
-    yt = nint(MRIgetVoxVal(gcam->mri_yind, xi, yi, zi, 0) * gcam->spacing);
-    zt = nint(MRIgetVoxVal(gcam->mri_zind, xi, yi, zi, 0) * gcam->spacing);
-    MRIsampleVolume(gcam->mri_xind, xv, yv, zv, &xd);
-    MRIsampleVolume(gcam->mri_yind, xv, yv, zv, &yd);
-    MRIsampleVolume(gcam->mri_zind, xv, yv, zv, &zd);
-    xt = (float)xd * gcam->spacing;
-    yt = (float)yd * gcam->spacing;
-    zt = (float)zd * gcam->spacing;
-  } else {
-    lta = (LTA *)transform->xform;
-    if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
-      int i;
-      printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
-      lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
-      printf("After conversion:\n");
-      for (i = 0; i < lta->num_xforms; i++) {
-        LINEAR_TRANSFORM *lt = &lta->xforms[i];
-        MatrixAsciiWriteInto(stdout, lt->m_L);
-      }
-    }
-    if (!v_canon) {
-      v_input                     = VectorAlloc(4, MATRIX_REAL);
-      v_canon                     = VectorAlloc(4, MATRIX_REAL);
-      *MATRIX_RELT(v_input, 4, 1) = 1.0;
-      *MATRIX_RELT(v_canon, 4, 1) = 1.0;
-    }
-    V3_X(v_input) = xv;
-    V3_Y(v_input) = yv;
-    V3_Z(v_input) = zv;
-    MatrixMultiply(lta->xforms[0].m_L, v_input, v_canon);
-    xt = V3_X(v_canon);
-    yt = V3_Y(v_canon);
-    zt = V3_Z(v_canon);
-  }
-  *px = xt;
-  *py = yt;
-  *pz = zt;
-
-  return errCode;
+  TransformEvaluatorInit(&te, transform);
+  return (TransformEvaluate(&te, TE_SAMPLE, xv, yv, zv, px, py, pz));
 }
 int TransformSampleReal(TRANSFORM *transform, float xv, float yv, float zv,
                         float *px, float *py, float *pz) {
-  static VECTOR *v_input, *v_canon = NULL;
-  float          xt, yt, zt;
-  LTA *          lta;
-  GCA_MORPH *    gcam;
-  int            errCode = NO_ERROR, xi, yi, zi;
+  TRANSFORM_EVALUATOR te;
 
-  *px = *py = *pz = 0;
-  if (transform->type == MORPH_3D_TYPE) {
-    gcam = (GCA_MORPH *)transform->xform;
-    if (!gcam->mri_xind)
-      ErrorReturn(
-          ERROR_UNSUPPORTED,
-          (ERROR_UNSUPPORTED, "TransformSample: gcam has not been inverted!"));
-
-    // the following should not happen /////////////////
-    if (xv < 0)
-      xv = 0;
-    if (xv >= gcam->mri_xind->width)
-      xv = gcam->mri_xind->width - 1;
-    if (yv < 0)
-      yv = 0;
-    if (yv >= gcam->mri_yind->height)
-      yv = gcam->mri_yind->height - 1;
-    if (zv < 0)
-      zv = 0;
-    if (zv >= gcam->mri_zind->depth)
-      zv = gcam->mri_zind->depth - 1;
-
-    xi = nint(xv);
-    yi = nint(yv);
-    zi = nint(zv);
-
-    xt = MRIgetVoxVal(gcam->mri_xind, xi, yi, zi, 0) * gcam->spacing;
-    yt = MRIgetVoxVal(gcam->mri_yind, xi, yi, zi, 0) * gcam->spacing;
-    zt = MRIgetVoxVal(gcam->mri_zind, xi, yi, zi, 0) * gcam->spacing;
-  } else {
-    lta = (LTA *)transform->xform;
-    if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
-      int i;
-      printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
-      lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
-      printf("After conversion:\n");
-      for (i = 0; i < lta->num_xforms; i++) {
-        LINEAR_TRANSFORM *lt = &lta->xforms[i];
-        MatrixAsciiWriteInto(stdout, lt->m_L);
-      }
-    }
-    if (!v_canon) {
-      v_input                     = VectorAlloc(4, MATRIX_REAL);
-      v_canon                     = VectorAlloc(4, MATRIX_REAL);
-      *MATRIX_RELT(v_input, 4, 1) = 1.0;
-      *MATRIX_RELT(v_canon, 4, 1) = 1.0;
-    }
-    V3_X(v_input) = xv;
-    V3_Y(v_input) = yv;
-    V3_Z(v_input) = zv;
-    MatrixMultiply(lta->xforms[0].m_L, v_input, v_canon);
-    xt = V3_X(v_canon);
-    yt = V3_Y(v_canon);
-    zt = V3_Z(v_canon);
-
-    if (xt < 0)
-      xt = 0;
-    if (yt < 0)
-      yt = 0;
-    if (zt < 0)
-      zt = 0;
-
-    if (!v_canon) {
-      VectorFree(&v_input);
-      VectorFree(&v_canon);
-    }
-  }
-  *px = xt;
-  *py = yt;
-  *pz = zt;
-
-  return errCode;
+  TransformEvaluatorInit(&te, transform);
+  return (TransformEvaluate(&te, TE_SAMPLE_REAL, xv, yv, zv, px, py, pz));
 }
 
 // with interpolation
 int TransformSampleReal2(TRANSFORM *transform, float xv, float yv, float zv,
                          float *px, float *py, float *pz) {
-  static VECTOR *v_input, *v_canon = NULL;
-  // float           xt, yt, zt ;
-  double     xt, yt, zt;
-  LTA *      lta;
-  GCA_MORPH *gcam;
-  int        errCode = NO_ERROR; //, xi, yi, zi;
+  TRANSFORM_EVALUATOR te;
 
-  *px = *py = *pz = 0;
-  if (transform->type == MORPH_3D_TYPE) {
-    gcam = (GCA_MORPH *)transform->xform;
-    if (!gcam->mri_xind)
-      ErrorReturn(
-          ERROR_UNSUPPORTED,
-          (ERROR_UNSUPPORTED, "TransformSample: gcam has not been inverted!"));
-
-    // the following should not happen /////////////////
-    if (xv < 0)
-      xv = 0;
-    if (xv >= gcam->mri_xind->width)
-      xv = gcam->mri_xind->width - 1;
-    if (yv < 0)
-      yv = 0;
-    if (yv >= gcam->mri_yind->height)
-      yv = gcam->mri_yind->height - 1;
-    if (zv < 0)
-      zv = 0;
-    if (zv >= gcam->mri_zind->depth)
-      zv = gcam->mri_zind->depth - 1;
-
-    /*xi = nint(xv) ;
-    yi = nint(yv) ;
-    zi = nint(zv) ;
-
-    xt = MRIgetVoxVal(gcam->mri_xind, xi, yi, zi, 0)*gcam->spacing ;
-    yt = MRIgetVoxVal(gcam->mri_yind, xi, yi, zi, 0)*gcam->spacing ;
-    zt = MRIgetVoxVal(gcam->mri_zind, xi, yi, zi, 0)*gcam->spacing ;*/
-
-    MRIsampleVolume(gcam->mri_xind, xv, yv, zv, &xt);
-    MRIsampleVolume(gcam->mri_yind, xv, yv, zv, &yt);
-    MRIsampleVolume(gcam->mri_zind, xv, yv, zv, &zt);
-    xt *= gcam->spacing;
-    yt *= gcam->spacing;
-    zt *= gcam->spacing;
-  } else {
-    lta = (LTA *)transform->xform;
-    if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
-      int i;
-      printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
-      lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
-      printf("After conversion:\n");
-      for (i = 0; i < lta->num_xforms; i++) {
-        LINEAR_TRANSFORM *lt = &lta->xforms[i];
-        MatrixAsciiWriteInto(stdout, lt->m_L);
-      }
-    }
-    if (!v_canon) {
-      v_input                     = VectorAlloc(4, MATRIX_REAL);
-      v_canon                     = VectorAlloc(4, MATRIX_REAL);
-      *MATRIX_RELT(v_input, 4, 1) = 1.0;
-      *MATRIX_RELT(v_canon, 4, 1) = 1.0;
-    }
-    V3_X(v_input) = xv;
-    V3_Y(v_input) = yv;
-    V3_Z(v_input) = zv;
-    MatrixMultiply(lta->xforms[0].m_L, v_input, v_canon);
-    xt = V3_X(v_canon);
-    yt = V3_Y(v_canon);
-    zt = V3_Z(v_canon);
-
-    if (xt < 0)
-      xt = 0;
-    if (yt < 0)
-      yt = 0;
-    if (zt < 0)
-      zt = 0;
-
-    if (!v_canon) {
-      VectorFree(&v_input);
-      VectorFree(&v_canon);
-    }
-  }
-  *px = (float)xt;
-  *py = (float)yt;
-  *pz = (float)zt;
-
-  return errCode;
+  TransformEvaluatorInit(&te, transform);
+  return (TransformEvaluate(&te, TE_SAMPLE_REAL2, xv, yv, zv, px, py, pz));
 }
 
 /*
@@ -2350,124 +2343,23 @@ int TransformSampleReal2(TRANSFORM *transform, float xv, float yv, float zv,
 */
 int TransformSampleInverse(TRANSFORM *transform, int xv, int yv, int zv,
                            float *px, float *py, float *pz) {
-  static VECTOR * v_input, *v_canon = NULL;
-  static MATRIX * m_L_inv;
-  float           xt, yt, zt;
-  int             xn, yn, zn;
-  LTA *           lta;
-  GCA_MORPH *     gcam;
-  GCA_MORPH_NODE *gcamn;
-  int             errCode = NO_ERROR;
-
-  if (transform->type == MORPH_3D_TYPE) {
-    gcam = (GCA_MORPH *)transform->xform;
-    xn   = nint(xv / gcam->spacing);
-    yn   = nint(yv / gcam->spacing);
-    zn   = nint(zv / gcam->spacing);
-
-    if (xn >= gcam->width)
-      xn = gcam->width - 1;
-    if (yn >= gcam->height)
-      yn = gcam->height - 1;
-    if (zn >= gcam->depth)
-      zn = gcam->depth - 1;
-    if (xn < 0)
-      xn = 0;
-    if (yn < 0)
-      yn = 0;
-    if (zn < 0)
-      zn = 0;
-
-    gcamn = &gcam->nodes[xn][yn][zn];
-    xt    = gcamn->x;
-    yt    = gcamn->y;
-    zt    = gcamn->z;
-    // if marked invalid, then return error
-    if (gcamn->invalid)
-      errCode = ERROR_BADPARM;
-  } else {
-    lta = (LTA *)transform->xform;
-    if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
-      int i;
-      printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
-      lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
-      printf("After conversion:\n");
-      for (i = 0; i < lta->num_xforms; i++) {
-        LINEAR_TRANSFORM *lt = &lta->xforms[i];
-        MatrixAsciiWriteInto(stdout, lt->m_L);
-      }
-    }
-    if (!v_canon) {
-      v_input                     = VectorAlloc(4, MATRIX_REAL);
-      v_canon                     = VectorAlloc(4, MATRIX_REAL);
-      *MATRIX_RELT(v_input, 4, 1) = 1.0;
-      *MATRIX_RELT(v_canon, 4, 1) = 1.0;
-      m_L_inv                     = MatrixAlloc(4, 4, MATRIX_REAL);
-    }
-
-    V3_X(v_canon) = (float)xv;
-    V3_Y(v_canon) = (float)yv;
-    V3_Z(v_canon) = (float)zv;
-    MatrixMultiply(lta->inv_xforms[0].m_L, v_canon, v_input);
-    xt = V3_X(v_input);
-    yt = V3_Y(v_input);
-    zt = V3_Z(v_input);
-    // here I cannot get access to width, height, depth values
-    // thus I cannot judge the point is good or bad
-    // errCode remains to be valid
-  }
-  *px = xt;
-  *py = yt;
-  *pz = zt;
+  TRANSFORM_EVALUATOR te;
+  int                 errCode;
 
-  return errCode;
+  if ((errCode = TransformEvaluatorInit(&te, transform)) != NO_ERROR)
+    return (errCode);
+  return (TransformEvaluate(&te, TE_SAMPLE_INVERSE, xv, yv, zv, px, py, pz));
 }
 
 int TransformSampleInverseFloat(const TRANSFORM *transform, float xv, float yv,
                                 float zv, float *px, float *py, float *pz) {
-  static VECTOR *v_input, *v_canon = NULL;
-  static MATRIX *m_L_inv;
-  LTA *          lta;
-  int            errCode = NO_ERROR;
+  TRANSFORM_EVALUATOR te;
+  int                 errCode;
 
-  if (transform->type == MORPH_3D_TYPE) {
-    // Return error if out of bounds instead of closest valid coordinates: when
-    // interpolating, this will prevent things like repeating voxels at the tip
-    // of the nose until reaching the edge of the image.
-    return GCAMsampleMorph((GCAM *)transform->xform, xv, yv, zv, px, py, pz);
-  } else {
-    lta = (LTA *)transform->xform;
-    if (lta->type != LINEAR_VOXEL_TO_VOXEL) {
-      int i;
-      printf("Converting to LTA type LINEAR_VOXEL_TO_VOXEL...\n");
-      lta = LTAchangeType(lta, LINEAR_VOXEL_TO_VOXEL);
-      printf("After conversion:\n");
-      for (i = 0; i < lta->num_xforms; i++) {
-        LINEAR_TRANSFORM *lt = &lta->xforms[i];
-        MatrixAsciiWriteInto(stdout, lt->m_L);
-      }
-    }
-    if (!v_canon) {
-      v_input                     = VectorAlloc(4, MATRIX_REAL);
-      v_canon                     = VectorAlloc(4, MATRIX_REAL);
-      *MATRIX_RELT(v_input, 4, 1) = 1.0;
-      *MATRIX_RELT(v_canon, 4, 1) = 1.0;
-      m_L_inv                     = MatrixAlloc(4, 4, MATRIX_REAL);
-    }
-
-    V3_X(v_canon) = (float)xv;
-    V3_Y(v_canon) = (float)yv;
-    V3_Z(v_canon) = (float)zv;
-    MatrixMultiply(lta->inv_xforms[0].m_L, v_canon, v_input);
-    *px = V3_X(v_input);
-    *py = V3_Y(v_input);
-    *pz = V3_Z(v_input);
-    // here I cannot get access to width, height, depth values
-    // thus I cannot judge the point is good or bad
-    // errCode remains to be valid
-  }
-
-  return errCode;
+  if ((errCode = TransformEvaluatorInit(&te, transform)) != NO_ERROR)
+    return (errCode);
+  return (
+      TransformEvaluate(&te, TE_SAMPLE_INVERSE_FLOAT, xv, yv, zv, px, py, pz));
 }
 int TransformSampleInverseVoxel(TRANSFORM *transform, int width, int height,
                                 int depth, int xv, int yv, int zv, int *px,
@@ -0,0 +1,70 @@
+#include "cclabel.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(cclabel_unit, CCLlabelVolume) { // NOLINT
+  // two voxels touching only at a corner, one across a slab boundary
+  int const                  w = 4, h = 3, d = 9;
+  std::vector<unsigned char> mask(w * h * d, 0);
+  std::vector<float>         val(w * h * d, 0);
+  auto idx = [&](int c, int r, int s) { return c + w * (r + h * s); };
+  mask[idx(0, 0, 0)] = 1;
+  mask[idx(1, 1, 1)] = 1;
+  mask[idx(3, 2, 3)] = 1;
+  mask[idx(3, 2, 4)] = 1;
+  mask[idx(3, 1, 4)] = 1;
+  val[idx(3, 2, 3)]  = 2;
+  val[idx(3, 1, 4)]  = -5;
+
+  CCLABELS *ccl =
+      CCLlabelVolume(mask.data(), w, h, d, 6, val.data(), nullptr, 0);
+  ASSERT_TRUE(ccl != nullptr);
+  EXPECT_EQ(ccl->ncomponents, 3);
+  EXPECT_EQ(ccl->id[idx(0, 0, 0)], 1);
+  EXPECT_EQ(ccl->id[idx(1, 1, 1)], 2);
+  EXPECT_EQ(ccl->id[idx(3, 1, 4)], 3);
+  EXPECT_EQ(ccl->id[idx(2, 2, 4)], 0);
+  EXPECT_EQ(ccl->size[3], 3);
+  EXPECT_DOUBLE_EQ(ccl->area[3], 3);
+  EXPECT_FLOAT_EQ(ccl->maxval[3], -5);
+  EXPECT_EQ(ccl->maxelement[3], idx(3, 1, 4));
+  EXPECT_EQ(ccl->first[3], idx(3, 2, 3));
+  CCLfree(&ccl);
+  EXPECT_TRUE(ccl == nullptr);
+
+  ccl = CCLlabelVolume(mask.data(), w, h, d, 26, val.data(), nullptr, 1);
+  ASSERT_TRUE(ccl != nullptr);
+  EXPECT_EQ(ccl->ncomponents, 2);
+  EXPECT_EQ(ccl->id[idx(1, 1, 1)], 1);
+  EXPECT_FLOAT_EQ(ccl->maxval[2], 2);
+  CCLfree(&ccl);
+
+  EXPECT_TRUE(CCLlabelVolume(mask.data(), w, h, d, 8, nullptr, nullptr, 0) ==
+              nullptr);
+}
+
+TEST(cclabel_unit, CCLlabelGraph) { // NOLINT
+  // path 0-1-2 with 2 excluded, and 3-4 listed from one end only
+  std::vector<int>           xadj   = {0, 1, 3, 4, 5, 5};
+  std::vector<int>           adjncy = {1, 0, 2, 1, 4};
+  std::vector<unsigned char> mask   = {1, 1, 0, 1, 1};
+  std::vector<float>         area   = {0.5, 0.25, 1, 2, 4};
+
+  CCLABELS *ccl = CCLlabelGraph(mask.data(), 5, xadj.data(), adjncy.data(),
+                                nullptr, area.data(), 1);
+  ASSERT_TRUE(ccl != nullptr);
+  EXPECT_EQ(ccl->ncomponents, 2);
+  EXPECT_EQ(ccl->id[0], 1);
+  EXPECT_EQ(ccl->id[1], 1);
+  EXPECT_EQ(ccl->id[2], 0);
+  EXPECT_EQ(ccl->id[4], 2);
+  EXPECT_DOUBLE_EQ(ccl->area[1], 0.75);
+  EXPECT_DOUBLE_EQ(ccl->area[2], 6);
+  CCLfree(&ccl);
+}
+
+auto main(int /*argc*/, char ** /*argv*/) -> int {
+
+  testing::InitGoogleTest();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+#include "fft3d.h"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(fft3d_unit, FFT3DgoodSize) { // NOLINT
+  EXPECT_EQ(FFT3DgoodSize(1), 1);
+  EXPECT_EQ(FFT3DgoodSize(7), 8);
+  EXPECT_EQ(FFT3DgoodSize(181), 192);
+  EXPECT_EQ(FFT3DgoodSize(256), 256);
+  EXPECT_EQ(FFT3DgoodSize(257), 270);
+}
+
+TEST(fft3d_unit, FFT3Dforward) { // NOLINT
+  // odd, prime and mixed sizes against a direct DFT
+  int const nx = 12, ny = 7, nz = 37, nxc = nx / 2 + 1;
+  float *   data = FFT3Dalloc(nx, ny, nz);
+  ASSERT_TRUE(data != nullptr);
+  std::vector<double> v(nx * ny * nz);
+  for (int i = 0; i < nx * ny * nz; i++)
+    v[i] = sin(0.37 * i) + (i % 5) * 0.25;
+  for (int z = 0; z < nz; z++)
+    for (int y = 0; y < ny; y++)
+      for (int x = 0; x < nx; x++)
+        data[x + 2 * nxc * (y + ny * z)] = v[x + nx * (y + ny * z)];
+
+  const FFT3D_PLAN *plan = FFT3Dplan(nx, ny, nz);
+  ASSERT_TRUE(plan != nullptr);
+  EXPECT_TRUE(FFT3Dplan(nx, ny, nz) == plan);
+  FFT3Dforward(plan, data);
+
+  int const ks[][3] = {{0, 0, 0}, {1, 2, 3}, {6, 6, 36}, {5, 0, 18}};
+  for (auto const &k : ks) {
+    double re = 0, im = 0;
+    for (int z = 0; z < nz; z++)
+      for (int y = 0; y < ny; y++)
+        for (int x = 0; x < nx; x++) {
+          double a = -2 * M_PI *
+                     ((double)k[0] * x / nx + (double)k[1] * y / ny +
+                      (double)k[2] * z / nz);
+          re += v[x + nx * (y + ny * z)] * cos(a);
+          im += v[x + nx * (y + ny * z)] * sin(a);
+        }
+    float const *c = data + 2 * (k[0] + nxc * (k[1] + ny * k[2]));
+    EXPECT_NEAR(c[0], re, 1e-3);
+    EXPECT_NEAR(c[1], im, 1e-3);
+  }
+
+  FFT3Dbackward(plan, data);
+  for (int z = 0; z < nz; z++)
+    for (int y = 0; y < ny; y++)
+      for (int x = 0; x < nx; x++)
+        EXPECT_NEAR(data[x + 2 * nxc * (y + ny * z)], v[x + nx * (y + ny * z)],
+                    1e-5);
+  FFT3Dfree(&data);
+  EXPECT_TRUE(data == nullptr);
+  FFT3DclearPlans();
+}
+
+TEST(fft3d_unit, FFT3Dbackward) { // NOLINT
+  // odd number of rows and an odd row length
+  int const nx = 15, ny = 3, nz = 1, nxc = nx / 2 + 1;
+  float *   data = FFT3Dalloc(nx, ny, nz);
+  for (int y = 0; y < ny; y++)
+    for (int x = 0; x < nx; x++)
+      data[x + 2 * nxc * y] = (x == 4 && y == 1) ? 1 : 0;
+
+  const FFT3D_PLAN *plan = FFT3Dplan(nx, ny, nz);
+  FFT3Dforward(plan, data);
+  // a delta has unit magnitude at every frequency
+  for (int k = 0; k < nxc * ny; k++)
+    EXPECT_NEAR(hypot(data[2 * k], data[2 * k + 1]), 1, 1e-6);
+  FFT3Dbackward(plan, data);
+  for (int y = 0; y < ny; y++)
+    for (int x = 0; x < nx; x++)
+      EXPECT_NEAR(data[x + 2 * nxc * y], (x == 4 && y == 1) ? 1 : 0, 1e-6);
+  FFT3Dfree(&data);
+}
+
+auto main(int /*argc*/, char ** /*argv*/) -> int {
+
+  testing::InitGoogleTest();
+  return RUN_ALL_TESTS();
+}
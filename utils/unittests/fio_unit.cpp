@@ -2,7 +2,10 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "fio.h"
+#include <cstdio>
 #include <gtest/gtest.h>
+#include <vector>
 
 TEST(fio_unit, MGHopen_file) { // NOLINT
 
@@ -240,6 +243,77 @@ TEST(fio_unit, fio_FileHasCarriageReturn) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(fio_unit, freadFloatArray) { // NOLINT
+  std::vector<float> in = {0.0f, -1.5f, 3.25f, 1e-20f, 12345.678f};
+  FILE *             fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  for (float f : in) {
+    fwriteFloat(f, fp);
+  }
+  rewind(fp);
+  std::vector<float> out(in.size());
+  EXPECT_EQ(freadFloatArray(out.data(), out.size(), fp), in.size());
+  EXPECT_EQ(out, in);
+  fclose(fp);
+}
+TEST(fio_unit, freadIntArray) { // NOLINT
+  std::vector<int> in = {0, 1, -1, 0x12345678, -200000};
+  FILE *           fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  for (int i : in) {
+    fwriteInt(i, fp);
+  }
+  rewind(fp);
+  std::vector<int> out(in.size() + 2, 7);
+  // short read: the values past the end of the file come back as zero
+  EXPECT_EQ(freadIntArray(out.data(), out.size(), fp), in.size());
+  for (size_t k = 0; k < in.size(); k++) {
+    EXPECT_EQ(out[k], in[k]);
+  }
+  EXPECT_EQ(out[in.size()], 0);
+  EXPECT_EQ(out[in.size() + 1], 0);
+  fclose(fp);
+}
+TEST(fio_unit, fread3Array) { // NOLINT
+  std::vector<int> in = {0, 1, 0xabcdef, 0x123456, 0xffffff};
+  FILE *           fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  for (int i : in) {
+    fwrite3(i, fp);
+  }
+  rewind(fp);
+  std::vector<int> out(in.size());
+  EXPECT_EQ(fread3Array(out.data(), out.size(), fp), in.size());
+  EXPECT_EQ(out, in);
+  fclose(fp);
+}
+TEST(fio_unit, fwriteArrays) { // NOLINT
+  // more values than the writers' staging buffer holds
+  std::vector<float> f(40000);
+  std::vector<int>   i(40000);
+  for (size_t k = 0; k < f.size(); k++) {
+    f[k] = 0.25f * k - 17.0f;
+    i[k] = (int)(k * 2654435761u) & 0xffffff;
+  }
+  FILE *fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  EXPECT_EQ(fwriteFloatArray(f.data(), f.size(), fp), f.size());
+  EXPECT_EQ(fwriteIntArray(i.data(), i.size(), fp), i.size());
+  EXPECT_EQ(fwrite3Array(i.data(), i.size(), fp), i.size());
+  rewind(fp);
+  for (size_t k = 0; k < f.size(); k++) {
+    ASSERT_EQ(freadFloat(fp), f[k]);
+  }
+  for (size_t k = 0; k < i.size(); k++) {
+    ASSERT_EQ(freadInt(fp), i[k]);
+  }
+  for (size_t k = 0; k < i.size(); k++) {
+    int v = 0;
+    fread3(&v, fp);
+    ASSERT_EQ(v, i[k]);
+  }
+  fclose(fp);
+}
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
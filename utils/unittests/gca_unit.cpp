@@ -2,6 +2,9 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "error.h"
+#include "gca.h"
+#include <cmath>
 #include <gtest/gtest.h>
 
 TEST(gca_unit, compare_sort_probabilities) { // NOLINT
@@ -156,6 +159,39 @@ TEST(gca_unit, GCAsourceVoxelToPrior) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(gca_unit, GCAsetVoxelMap) { // NOLINT
+
+  GCA *      gca       = GCAalloc(1, 2.0, 4.0, 16, 16, 16, 0);
+  MRI *      mri       = MRIalloc(20, 18, 16, MRI_UCHAR);
+  TRANSFORM *transform = TransformAlloc(LINEAR_VOX_TO_VOX, NULL);
+  int        x, y, z, xp, yp, zp, err, xm, ym, zm, err_map, noutside = 0;
+
+  ASSERT_EQ(GCAsetVoxelMap(gca, mri, transform), NO_ERROR);
+  for (x = 0; x < mri->width; x++)
+    for (y = 0; y < mri->height; y++)
+      for (z = 0; z < mri->depth; z++) {
+        err_map = GCAsourceVoxelToPrior(gca, mri, transform, x, y, z, &xm, &ym,
+                                        &zm);
+        GCA_VOXEL_MAP *map = gca->voxel_map__;
+        gca->voxel_map__   = NULL;
+        err = GCAsourceVoxelToPrior(gca, mri, transform, x, y, z, &xp, &yp,
+                                    &zp);
+        gca->voxel_map__ = map;
+        EXPECT_EQ(err_map, err);
+        EXPECT_EQ(xm, xp);
+        EXPECT_EQ(ym, yp);
+        EXPECT_EQ(zm, zp);
+        noutside += (err != NO_ERROR);
+      }
+  // the inputs are larger than the atlas, so some voxels fall outside it
+  EXPECT_GT(noutside, 0);
+
+  GCAclearVoxelMap(gca);
+  EXPECT_EQ(gca->voxel_map__, nullptr);
+  TransformFree(&transform);
+  MRIfree(&mri);
+  GCAfree(&gca);
+}
 TEST(gca_unit, GCAsourceVoxelToPriorReal) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -552,6 +588,25 @@ TEST(gca_unit, GCAmahDist) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(gca_unit, GCAmahDistMultiChannel) { // NOLINT
+
+  // covariance [[4 1] [1 2]] packed as its upper triangle
+  float means[2] = {100, 50}, covars[3] = {4, 1, 2}, vals[2] = {103, 49};
+  GC1D  gc       = {};
+  gc.means       = means;
+  gc.covars      = covars;
+
+  // inverse is [[2 -1] [-1 4]] / 7, d = (3, -1)
+  EXPECT_NEAR(GCAmahDist(&gc, vals, 2), (2 * 9 + 2 * 3 + 4 * 1) / 7.0, 1e-5);
+  EXPECT_NEAR(covariance_determinant(&gc, 2), 7.0, 1e-5);
+  EXPECT_NEAR(GCAcomputeConditionalLogDensity(&gc, vals, 2, 0),
+              -0.5 * log(7.0) - 0.5 * 4.0, 1e-5);
+
+  // changed covariances are picked up
+  covars[1] = 0;
+  EXPECT_NEAR(GCAmahDist(&gc, vals, 2), 9 / 4.0 + 1 / 2.0, 1e-5);
+  EXPECT_NEAR(covariance_determinant(&gc, 2), 8.0, 1e-5);
+}
 TEST(gca_unit, GCAfreeSamples) { // NOLINT
 
   EXPECT_EQ(1, 0);
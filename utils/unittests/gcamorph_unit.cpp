@@ -2,6 +2,10 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "gcamorph.h"
+#include "mri.h"
+#include <algorithm>
+#include <cmath>
 #include <gtest/gtest.h>
 
 TEST(gcamorph_unit, GCAMdilateUseLikelihood) { // NOLINT
@@ -553,6 +557,190 @@ TEST(gcamorph_unit, GCAMtoMRI) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+// a small morph with a smooth displacement and gradient, and an image for
+// the likelihood term
+static auto make_test_gcam(int n, MRI **pmri) -> GCA_MORPH * {
+  GCA_MORPH *gcam = GCAMalloc(n, n, n);
+  MRI *      mri  = MRIalloc(n, n, n, MRI_FLOAT);
+
+  gcam->ninputs = 1;
+  gcam->exp_k   = 20; // NOLINT
+  for (int x = 0; x < n; x++) {
+    for (int y = 0; y < n; y++) {
+      for (int z = 0; z < n; z++) {
+        GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        gcamn->label          = 2;
+        gcamn->x += 0.1 * sin(0.7 * x + 0.3 * y);  // NOLINT
+        gcamn->y += 0.1 * cos(0.5 * y + 0.2 * z);  // NOLINT
+        gcamn->z += 0.1 * sin(0.4 * z + 0.6 * x);  // NOLINT
+        gcamn->dx = static_cast<float>(cos(0.9 * x + y));  // NOLINT
+        gcamn->dy = static_cast<float>(sin(0.8 * y - z));  // NOLINT
+        gcamn->dz = static_cast<float>(cos(0.3 * z + x));  // NOLINT
+        MRIsetVoxVal(mri, x, y, z, 0,
+                     static_cast<float>(10 * (x + 2 * y + 3 * z))); // NOLINT
+      }
+    }
+  }
+  gcam->nodes[0][1][2].invalid = GCAM_POSITION_INVALID;
+  GCAMcomputeOriginalProperties(gcam);
+  *pmri = mri;
+  return gcam;
+}
+
+TEST(gcamorph_unit, GCAMsoaLoad) { // NOLINT
+  MRI *      mri;
+  GCA_MORPH *gcam = make_test_gcam(6, &mri); // NOLINT
+
+  // the lattice is one contiguous block in x/y/z order
+  EXPECT_EQ(gcam->nodes[0][0] + gcam->depth, gcam->nodes[0][1]);
+  EXPECT_EQ(gcam->nodes[0][0] + gcam->height * gcam->depth, gcam->nodes[1][0]);
+
+  GCA_MORPH_SOA *soa = GCAMgetSoa(gcam);
+  ASSERT_NE(soa, nullptr);
+  EXPECT_EQ(soa->nnodes, 6 * 6 * 6);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(soa->x) % 64, 0); // NOLINT
+  for (int x = 0; x < gcam->width; x++) {
+    for (int y = 0; y < gcam->height; y++) {
+      for (int z = 0; z < gcam->depth; z++) {
+        const GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        size_t                i     = GCAM_SOA_INDEX(soa, x, y, z);
+        EXPECT_EQ(soa->x[i], gcamn->x);
+        EXPECT_EQ(soa->origz[i], gcamn->origz);
+        EXPECT_EQ(soa->dy[i], gcamn->dy);
+        EXPECT_EQ(soa->area1[i], gcamn->area1);
+        EXPECT_EQ(soa->invalid[i], gcamn->invalid);
+      }
+    }
+  }
+  EXPECT_EQ(GCAMgetSoa(gcam), soa); // reused, not reallocated
+
+  GCAMfree(&gcam);
+  MRIfree(&mri);
+}
+
+TEST(gcamorph_unit, gcamComputeSSE_asThoughGradientApplied) { // NOLINT
+  MRI *           mri;
+  GCA_MORPH *     gcam = make_test_gcam(8, &mri); // NOLINT
+  GCA_MORPH_PARMS parms{};
+  const double    dts[] = {0.0, 0.05, 0.2, 0.8, 3.0}; // NOLINT
+  const int       ndt   = sizeof(dts) / sizeof(dts[0]);
+  double          sse[ndt];
+  int             neg[ndt];
+
+  parms.l_log_likelihood = 0.2; // NOLINT
+  parms.l_jacobian       = 1;
+  parms.l_smoothness     = 2;
+  ASSERT_EQ(gcamComputeSSE_asThoughGradientApplied(
+                gcam, GCAMgetSoa(gcam), mri, &parms, ndt, dts, sse, neg),
+            NO_ERROR);
+
+  for (int k = 0; k < ndt; k++) {
+    parms.dt = dts[k];
+    gcamApplyGradient(gcam, &parms);
+    double expected = gcamComputeSSE(gcam, mri, &parms);
+    int    expected_neg = gcam->neg;
+    gcamUndoGradient(gcam);
+    EXPECT_NEAR(sse[k], expected, 1e-5 * fabs(expected)) << "dt " << dts[k];
+    EXPECT_EQ(neg[k], expected_neg) << "dt " << dts[k];
+  }
+
+  // terms it can't evaluate are left to the caller
+  parms.l_area = 1;
+  EXPECT_EQ(gcamComputeSSE_asThoughGradientApplied(
+                gcam, GCAMgetSoa(gcam), mri, &parms, ndt, dts, sse, neg),
+            ERROR_UNSUPPORTED);
+
+  GCAMfree(&gcam);
+  MRIfree(&mri);
+}
+
+TEST(gcamorph_unit, gcamSmoothnessTermSoa) { // NOLINT
+  MRI *      mri;
+  GCA_MORPH *gcam = make_test_gcam(7, &mri); // NOLINT
+  int const  n    = gcam->width;
+
+  // the mean displacement difference to the 26 neighbors, from the nodes
+  gcamClearGradient(gcam);
+  gcamSmoothnessTerm(gcam, mri, 2);
+  for (int x = 0; x < n; x++) {
+    for (int y = 0; y < n; y++) {
+      for (int z = 0; z < n; z++) {
+        const GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        double                d[3] = {0, 0, 0};
+        int                   num  = 0;
+        if (gcamn->invalid == GCAM_POSITION_INVALID) {
+          continue;
+        }
+        for (int xk = -1; xk <= 1; xk++) {
+          for (int yk = -1; yk <= 1; yk++) {
+            for (int zk = -1; zk <= 1; zk++) {
+              const GCA_MORPH_NODE *nbr =
+                  &gcam->nodes[std::min(n - 1, std::max(0, x + xk))]
+                              [std::min(n - 1, std::max(0, y + yk))]
+                              [std::min(n - 1, std::max(0, z + zk))];
+              if ((!xk && !yk && !zk) ||
+                  nbr->invalid == GCAM_POSITION_INVALID) {
+                continue;
+              }
+              d[0] += (nbr->x - nbr->origx) - (gcamn->x - gcamn->origx);
+              d[1] += (nbr->y - nbr->origy) - (gcamn->y - gcamn->origy);
+              d[2] += (nbr->z - nbr->origz) - (gcamn->z - gcamn->origz);
+              num++;
+            }
+          }
+        }
+        EXPECT_EQ(gcamn->dx, static_cast<float>(d[0] * 2 / num));
+        EXPECT_EQ(gcamn->dy, static_cast<float>(d[1] * 2 / num));
+        EXPECT_EQ(gcamn->dz, static_cast<float>(d[2] * 2 / num));
+      }
+    }
+  }
+
+  GCAMfree(&gcam);
+  MRIfree(&mri);
+}
+
+TEST(gcamorph_unit, gcamJacobianTermSoa) { // NOLINT
+  MRI *      mri;
+  GCA_MORPH *gcam = make_test_gcam(7, &mri); // NOLINT
+
+  // squeeze the lattice so the areas differ from the original ones
+  for (int x = 0; x < gcam->width; x++) {
+    for (int y = 0; y < gcam->height; y++) {
+      for (int z = 0; z < gcam->depth; z++) {
+        gcam->nodes[x][y][z].x *= 1 - 0.04 * y; // NOLINT
+      }
+    }
+  }
+  gcamComputeMetricProperties(gcam);
+
+  // with no gradient yet nothing is clamped, so each node gets exactly
+  // what gcamJacobianTermAtNode() computes from the nodes
+  gcamClearGradient(gcam);
+  gcamJacobianTerm(gcam, mri, 1.5, 0.1); // NOLINT
+  int nonzero = 0;
+  for (int x = 0; x < gcam->width; x++) {
+    for (int y = 0; y < gcam->height; y++) {
+      for (int z = 0; z < gcam->depth; z++) {
+        const GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        double                dx, dy, dz;
+        if (gcamn->invalid == GCAM_POSITION_INVALID) {
+          continue;
+        }
+        gcamJacobianTermAtNode(gcam, mri, 1.5, x, y, z, &dx, &dy, &dz);
+        EXPECT_EQ(gcamn->dx, static_cast<float>(dx)) << x << " " << y;
+        EXPECT_EQ(gcamn->dy, static_cast<float>(dy)) << x << " " << y;
+        EXPECT_EQ(gcamn->dz, static_cast<float>(dz)) << x << " " << y;
+        nonzero += dx != 0;
+      }
+    }
+  }
+  EXPECT_GT(nonzero, 0);
+
+  GCAMfree(&gcam);
+  MRIfree(&mri);
+}
+
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
@@ -2,7 +2,69 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "geodesics.h"
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <gtest/gtest.h>
+#include <queue>
+#include <unistd.h>
+#include <vector>
+
+// an icosahedral sphere of radius 100, so 40mm neighborhoods are caps of a
+// few rings rather than the whole surface
+static MRIS *geodesicsIco642() {
+  MRIS *mris = ic642_make_surface(642, 1280);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, 100 * v->x, 100 * v->y, 100 * v->z);
+  }
+  MRISsetNeighborhoodSizeAndDist(mris, 1);
+  MRIScomputeMetricProperties(mris);
+  return mris;
+}
+
+// brute-force shortest paths from vno along the mesh edges
+static std::vector<double> geodesicsEdgePaths(MRIS *mris, int vno) {
+  std::vector<double> dist(mris->nvertices, HUGE_VAL);
+  std::priority_queue<std::pair<double, int>,
+                      std::vector<std::pair<double, int>>,
+                      std::greater<std::pair<double, int>>>
+      queue;
+  dist[vno] = 0;
+  queue.push(std::make_pair(0.0, vno));
+  while (!queue.empty()) {
+    double const d = queue.top().first;
+    int const    u = queue.top().second;
+    queue.pop();
+    if (d > dist[u])
+      continue;
+    VERTEX_TOPOLOGY const *vt = &mris->vertices_topology[u];
+    for (int n = 0; n < vt->vnum; n++) {
+      VERTEX const *a = &mris->vertices[u], *b = &mris->vertices[vt->v[n]];
+      double const  e =
+          sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+               (a->z - b->z) * (a->z - b->z));
+      if (d + e < dist[vt->v[n]]) {
+        dist[vt->v[n]] = d + e;
+        queue.push(std::make_pair(d + e, vt->v[n]));
+      }
+    }
+  }
+  return dist;
+}
+
+// writes bytes over a geodesics file at the given offset
+static void geodesicsPatchFile(const char *fname, long where, const void *buf,
+                               size_t size) {
+  FILE *fp = fopen(fname, "r+b");
+  ASSERT_NE(fp, nullptr);
+  ASSERT_EQ(fseek(fp, where, SEEK_SET), 0);
+  ASSERT_EQ(fwrite(buf, size, 1, fp), 1u);
+  fclose(fp);
+}
 
 TEST(geodesics_unit, computeGeodesics) { // NOLINT
 
@@ -24,6 +86,130 @@ TEST(geodesics_unit, GeoSmooth) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(geodesics_unit, computeGeodesicsCSR) { // NOLINT
+  float const   maxdist = 40;
+  MRIS *        mris    = geodesicsIco642();
+  GeodesicsCSR *csr     = computeGeodesicsCSR(mris, maxdist);
+
+  ASSERT_EQ(csr->nvertices, mris->nvertices);
+  ASSERT_EQ(csr->offset[0], 0);
+  ASSERT_EQ(csr->offset[csr->nvertices], csr->nnbrs);
+  ASSERT_LT(csr->nnbrs, (int64_t)mris->nvertices * (mris->nvertices - 1));
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    // on the sphere the geodesics are the great circle arcs, and no path
+    // is longer than the shortest one along the mesh edges
+    std::vector<double> const edge = geodesicsEdgePaths(mris, vno);
+    std::vector<float>        dist(mris->nvertices, -1);
+    for (int64_t n = csr->offset[vno]; n < csr->offset[vno + 1]; n++) {
+      int const nbr = csr->v[n];
+      ASSERT_TRUE(nbr >= 0 && nbr < mris->nvertices && nbr != vno);
+      EXPECT_LT(dist[nbr], 0) << "duplicate neighbor " << nbr;
+      dist[nbr] = csr->dist[n];
+      EXPECT_LT(dist[nbr], maxdist);
+      EXPECT_LE(dist[nbr], edge[nbr] + 1e-3);
+    }
+    for (int nbr = 0; nbr < mris->nvertices; nbr++) {
+      if (nbr == vno)
+        continue;
+      VERTEX const *a = &mris->vertices[vno], *b = &mris->vertices[nbr];
+      double const  r2 = a->x * a->x + a->y * a->y + a->z * a->z;
+      double const  cosab =
+          (a->x * b->x + a->y * b->y + a->z * b->z) / r2; // antipodes < -1
+      double const arc = sqrt(r2) * acos(std::max(-1.0, std::min(1.0, cosab)));
+      if (dist[nbr] >= 0)
+        EXPECT_NEAR(dist[nbr], arc, 0.01 * arc);
+      else
+        EXPECT_GT(arc, 0.95 * maxdist) << vno << " misses " << nbr;
+    }
+  }
+
+  // the Geodesics wrapper lists the same table
+  Geodesics *geo = computeGeodesics(mris, maxdist);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    int64_t const base = csr->offset[vno];
+    ASSERT_EQ(geo[vno].vnum, csr->offset[vno + 1] - base);
+    for (int n = 0; n < geo[vno].vnum; n++) {
+      EXPECT_EQ(geo[vno].v[n], csr->v[base + n]);
+      EXPECT_EQ(geo[vno].dist[n], csr->dist[base + n]);
+    }
+  }
+  free(geo);
+  geodesicsCSRFree(&csr);
+  EXPECT_EQ(csr, nullptr);
+  MRISfree(&mris);
+}
+TEST(geodesics_unit, geodesicsCSRWriteRead) { // NOLINT
+  MRIS *        mris = geodesicsIco642();
+  GeodesicsCSR *csr  = computeGeodesicsCSR(mris, 40);
+
+  char fname[] = "/tmp/geodesics_unit_XXXXXX";
+  int  fd      = mkstemp(fname);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  GeodesicsCSR *mapped = geodesicsCSRRead(fname);
+  ASSERT_NE(mapped, nullptr);
+  EXPECT_NE(mapped->map, nullptr);
+  ASSERT_EQ(mapped->nvertices, csr->nvertices);
+  ASSERT_EQ(mapped->nnbrs, csr->nnbrs);
+  for (int vno = 0; vno <= csr->nvertices; vno++)
+    ASSERT_EQ(mapped->offset[vno], csr->offset[vno]);
+  for (int64_t n = 0; n < csr->nnbrs; n++) {
+    ASSERT_EQ(mapped->v[n], csr->v[n]);
+    ASSERT_EQ(mapped->dist[n], csr->dist[n]);
+  }
+
+  unlink(fname);
+  geodesicsCSRFree(&mapped);
+  geodesicsCSRFree(&csr);
+  MRISfree(&mris);
+}
+TEST(geodesics_unit, geodesicsCSRReadCorrupt) { // NOLINT
+  MRIS *        mris = geodesicsIco642();
+  GeodesicsCSR *csr  = computeGeodesicsCSR(mris, 20);
+  long const    hdrsize = 48; // magic, byte order, counts and reserved words
+  long const    vbase   = hdrsize + (csr->nvertices + 1) * sizeof(int64_t);
+
+  char fname[] = "/tmp/geodesics_unit_XXXXXX";
+  int  fd      = mkstemp(fname);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  // a vertex number past the end of the surface
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  int const badv = csr->nvertices;
+  geodesicsPatchFile(fname, vbase + 5 * sizeof(int), &badv, sizeof(badv));
+  EXPECT_EQ(geodesicsCSRRead(fname), nullptr);
+
+  // offsets that run backwards
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  int64_t const badoffset = csr->offset[3] + 1;
+  geodesicsPatchFile(fname, hdrsize + 2 * sizeof(int64_t), &badoffset,
+                     sizeof(badoffset));
+  EXPECT_EQ(geodesicsCSRRead(fname), nullptr);
+
+  // a neighbor count that does not match the arrays
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  int64_t const badcount = csr->nnbrs + 1;
+  geodesicsPatchFile(fname, 24, &badcount, sizeof(badcount));
+  EXPECT_EQ(geodesicsCSRRead(fname), nullptr);
+
+  // a truncated file
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  ASSERT_EQ(truncate(fname, vbase), 0);
+  EXPECT_EQ(geodesicsCSRRead(fname), nullptr);
+
+  // and the untouched file still reads back
+  ASSERT_EQ(geodesicsCSRWrite(csr, fname), 0);
+  GeodesicsCSR *mapped = geodesicsCSRRead(fname);
+  ASSERT_NE(mapped, nullptr);
+  EXPECT_EQ(mapped->nnbrs, csr->nnbrs);
+
+  unlink(fname);
+  geodesicsCSRFree(&mapped);
+  geodesicsCSRFree(&csr);
+  MRISfree(&mris);
+}
 TEST(geodesics_unit, GeoCount) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -2,8 +2,103 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "fastmarching.h"
+#include "mri.h"
+#include <cmath>
+#include <cstdlib>
 #include <gtest/gtest.h>
 
+// a 2x3x4 mm voxel grid with a small box of label 1 in it
+static MRI *labelBox() {
+  MRI *mri   = MRIalloc(12, 10, 8, MRI_UCHAR);
+  mri->xsize = 2;
+  mri->ysize = 3;
+  mri->zsize = 4;
+  for (int z = 3; z < 5; z++)
+    for (int y = 4; y < 7; y++)
+      for (int x = 5; x < 8; x++)
+        MRIvox(mri, x, y, z) = 1;
+  return mri;
+}
+
+// brute force distance in mm from voxel (x,y,z) to the nearest voxel
+// whose membership in label 1 differs
+static double bruteDistance(MRI *mri, int x, int y, int z) {
+  int const in   = MRIvox(mri, x, y, z) == 1;
+  double    best = 1e30;
+  for (int z2 = 0; z2 < mri->depth; z2++)
+    for (int y2 = 0; y2 < mri->height; y2++)
+      for (int x2 = 0; x2 < mri->width; x2++) {
+        if ((MRIvox(mri, x2, y2, z2) == 1) == in)
+          continue;
+        double const dx = (x - x2) * mri->xsize;
+        double const dy = (y - y2) * mri->ysize;
+        double const dz = (z - z2) * mri->zsize;
+        best            = std::min(best, sqrt(dx * dx + dy * dy + dz * dz));
+      }
+  return best;
+}
+
+TEST(mri_fastmarching_unit, MRIexactDistanceTransform) { // NOLINT
+  MRI *mri    = labelBox();
+  MRI *signed_ =
+      MRIexactDistanceTransform(mri, nullptr, 1, -1, DTRANS_MODE_SIGNED);
+  MRI *unsigned_ =
+      MRIexactDistanceTransform(mri, nullptr, 1, -1, DTRANS_MODE_UNSIGNED);
+  MRI *outside =
+      MRIexactDistanceTransform(mri, nullptr, 1, -1, DTRANS_MODE_OUTSIDE);
+  MRI *clamped =
+      MRIexactDistanceTransform(mri, nullptr, 1, 5, DTRANS_MODE_SIGNED);
+
+  // voxels next to the boundary are half of the smallest voxel dimension
+  double const half = 0.5 * 2;
+  for (int z = 0; z < mri->depth; z++)
+    for (int y = 0; y < mri->height; y++)
+      for (int x = 0; x < mri->width; x++) {
+        bool const   in = MRIvox(mri, x, y, z) == 1;
+        double const d  = bruteDistance(mri, x, y, z) - half;
+        EXPECT_NEAR(MRIFvox(signed_, x, y, z), in ? -d : d, 1e-4);
+        EXPECT_NEAR(MRIFvox(unsigned_, x, y, z), d, 1e-4);
+        EXPECT_NEAR(MRIFvox(outside, x, y, z), in ? 0 : d, 1e-4);
+        EXPECT_NEAR(MRIFvox(clamped, x, y, z),
+                    in ? -std::min(d, 5.0) : std::min(d, 5.0), 1e-4);
+      }
+
+  MRIfree(&signed_);
+  MRIfree(&unsigned_);
+  MRIfree(&outside);
+  MRIfree(&clamped);
+  MRIfree(&mri);
+}
+
+TEST(mri_fastmarching_unit, MRIextractDistanceMap) { // NOLINT
+  // a planar boundary, where fast marching is exact as well
+  MRI *mri = MRIalloc(16, 6, 5, MRI_FLOAT);
+  for (int z = 0; z < mri->depth; z++)
+    for (int y = 0; y < mri->height; y++)
+      for (int x = 0; x < 7; x++)
+        MRIFvox(mri, x, y, z) = 3;
+
+  unsetenv("FREESURFER_OLD_MRIextractDistanceMap");
+  MRI *exact = MRIextractDistanceMap(mri, nullptr, 3, 6, 3, nullptr);
+  setenv("FREESURFER_OLD_MRIextractDistanceMap", "1", 1);
+  MRI *marched = MRIextractDistanceMap(mri, nullptr, 3, 6, 3, nullptr);
+  unsetenv("FREESURFER_OLD_MRIextractDistanceMap");
+
+  for (int z = 0; z < mri->depth; z++)
+    for (int y = 0; y < mri->height; y++)
+      for (int x = 0; x < mri->width; x++) {
+        float const expected = x < 7 ? -std::min(6.5f - x, 6.0f)
+                                     : std::min(x - 6.5f, 6.0f);
+        EXPECT_NEAR(MRIFvox(exact, x, y, z), expected, 1e-5);
+        EXPECT_NEAR(MRIFvox(marched, x, y, z), expected, 1e-5);
+      }
+
+  MRIfree(&exact);
+  MRIfree(&marched);
+  MRIfree(&mri);
+}
+
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
@@ -2,8 +2,74 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "mri.h"
+#include <cmath>
+#include <cstdlib>
 #include <gtest/gtest.h>
 
+// a two-frame float volume with structure at every scale
+static MRI *makeFilterTestVolume() {
+  MRI *mri = MRIallocSequence(40, 36, 30, MRI_FLOAT, 2);
+  mri->xsize = mri->ysize = mri->zsize = 1;
+  for (int f = 0; f < mri->nframes; f++)
+    for (int z = 0; z < mri->depth; z++)
+      for (int y = 0; y < mri->height; y++)
+        for (int x = 0; x < mri->width; x++)
+          MRIFseq_vox(mri, x, y, z, f) =
+              100 * (x > 12 && y < 20) + 10 * sin(0.7 * x * (f + 1) + y) +
+              ((x * 7 + y * 13 + z * 29) % 17) + z;
+  return (mri);
+}
+
+static void expectSameVolume(MRI *a, MRI *b, double tol) {
+  for (int f = 0; f < a->nframes; f++)
+    for (int z = 0; z < a->depth; z++)
+      for (int y = 0; y < a->height; y++)
+        for (int x = 0; x < a->width; x++)
+          ASSERT_NEAR(MRIFseq_vox(a, x, y, z, f), MRIFseq_vox(b, x, y, z, f),
+                      tol)
+              << "voxel " << x << " " << y << " " << z << " frame " << f;
+}
+
+TEST(mrifilter_unit, MRIconvolveGaussian) { // NOLINT
+  // FWHM 9.4 mm, so the FFT path with edge replication is taken
+  MRI *src = makeFilterTestVolume(), *kernel = MRIgaussian1d(4, 0);
+
+  unsetenv("FREESURFER_OLD_MRIgaussianSmooth");
+  MRI *fft = MRIconvolveGaussian(src, nullptr, kernel);
+  setenv("FREESURFER_OLD_MRIgaussianSmooth", "1", 1);
+  MRI *direct = MRIconvolveGaussian(src, nullptr, kernel);
+  unsetenv("FREESURFER_OLD_MRIgaussianSmooth");
+  expectSameVolume(fft, direct, 1e-3);
+
+  // and in place
+  MRI *inplace = MRIcopy(src, nullptr);
+  MRIconvolveGaussian(inplace, inplace, kernel);
+  expectSameVolume(inplace, direct, 1e-3);
+
+  MRIfree(&inplace);
+  MRIfree(&direct);
+  MRIfree(&fft);
+  MRIfree(&kernel);
+  MRIfree(&src);
+}
+
+TEST(mrifilter_unit, MRIgaussianSmoothNI) { // NOLINT
+  // zero extension and row-sum rescaling, widest FWHM 11.8 mm
+  MRI *src = makeFilterTestVolume();
+
+  unsetenv("FREESURFER_OLD_MRIgaussianSmooth");
+  MRI *fft = MRIgaussianSmoothNI(src, 3.5, 2, 5, nullptr);
+  setenv("FREESURFER_OLD_MRIgaussianSmooth", "1", 1);
+  MRI *direct = MRIgaussianSmoothNI(src, 3.5, 2, 5, nullptr);
+  unsetenv("FREESURFER_OLD_MRIgaussianSmooth");
+  expectSameVolume(fft, direct, 1e-3);
+
+  MRIfree(&direct);
+  MRIfree(&fft);
+  MRIfree(&src);
+}
+
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
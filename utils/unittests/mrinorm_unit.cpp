@@ -2,6 +2,9 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "mri.h"
+#include "mrinorm.h"
+#include <cmath>
 #include <gtest/gtest.h>
 
 TEST(mrinorm_unit, MRIhistoNormalize) { // NOLINT
@@ -76,6 +79,77 @@ TEST(mrinorm_unit, MRIsoapBubble) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(mrinorm_unit, MRIsoapBubbleMultigrid) { // NOLINT
+
+  // control planes at both ends in x: the soap bubble solution between them
+  // is linear in x, in both frames
+  int const width = 17, height = 12, depth = 9;
+  MRI *     mri_src  = MRIallocSequence(width, height, depth, MRI_FLOAT, 2);
+  MRI *     mri_ctrl = MRIalloc(width, height, depth, MRI_UCHAR);
+  for (int z = 0; z < depth; z++)
+    for (int y = 0; y < height; y++) {
+      MRIvox(mri_ctrl, 0, y, z)         = CONTROL_MARKED;
+      MRIvox(mri_ctrl, width - 1, y, z) = CONTROL_MARKED;
+      MRIsetVoxVal(mri_src, 0, y, z, 0, 10);
+      MRIsetVoxVal(mri_src, width - 1, y, z, 0, 90);
+      MRIsetVoxVal(mri_src, 0, y, z, 1, -40);
+      MRIsetVoxVal(mri_src, width - 1, y, z, 1, 40);
+    }
+
+  MRI *mri_dst = MRIsoapBubbleMultigrid(mri_src, mri_ctrl, NULL, 1e-4);
+  ASSERT_NE(mri_dst, nullptr);
+  for (int z = 0; z < depth; z++)
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++) {
+        EXPECT_NEAR(MRIgetVoxVal(mri_dst, x, y, z, 0), 10 + 5.0 * x, 1e-2);
+        EXPECT_NEAR(MRIgetVoxVal(mri_dst, x, y, z, 1), -40 + 5.0 * x, 1e-2);
+      }
+
+  MRIfree(&mri_dst);
+  MRIfree(&mri_ctrl);
+  MRIfree(&mri_src);
+}
+TEST(mrinorm_unit, MRIsoapBubbleMultigridScattered) { // NOLINT
+
+  // a few isolated control points, which fix far more of the coarse grids
+  // than of the fine one: the result must still be the soap bubble fixed
+  // point, every free voxel the mean of its (clamped) 27 neighbors
+  int const width = 23, height = 18, depth = 14;
+  MRI *     mri_src  = MRIalloc(width, height, depth, MRI_FLOAT);
+  MRI *     mri_ctrl = MRIalloc(width, height, depth, MRI_UCHAR);
+  int const ctrl[][4] = {{1, 1, 1, 20},    {21, 3, 2, 140}, {11, 9, 7, 75},
+                         {4, 16, 12, 110}, {18, 15, 0, 35}, {12, 10, 7, 90}};
+  for (auto const &c : ctrl) {
+    MRIvox(mri_ctrl, c[0], c[1], c[2]) = CONTROL_MARKED;
+    MRIsetVoxVal(mri_src, c[0], c[1], c[2], 0, c[3]);
+  }
+
+  MRI *mri_dst = MRIsoapBubbleMultigrid(mri_src, mri_ctrl, NULL, 1e-5);
+  ASSERT_NE(mri_dst, nullptr);
+  for (int z = 0; z < depth; z++)
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++) {
+        float const val = MRIgetVoxVal(mri_dst, x, y, z, 0);
+        if (MRIvox(mri_ctrl, x, y, z) == CONTROL_MARKED) {
+          EXPECT_EQ(val, MRIgetVoxVal(mri_src, x, y, z, 0));
+          continue;
+        }
+        double mean = 0;
+        for (int zk = -1; zk <= 1; zk++)
+          for (int yk = -1; yk <= 1; yk++)
+            for (int xk = -1; xk <= 1; xk++)
+              mean += MRIgetVoxVal(mri_dst, MIN(MAX(x + xk, 0), width - 1),
+                                   MIN(MAX(y + yk, 0), height - 1),
+                                   MIN(MAX(z + zk, 0), depth - 1), 0);
+        EXPECT_NEAR(val, mean / 27, 1e-3);
+        EXPECT_GE(val, 20 - 1e-3);
+        EXPECT_LE(val, 140 + 1e-3);
+      }
+
+  MRIfree(&mri_dst);
+  MRIfree(&mri_ctrl);
+  MRIfree(&mri_src);
+}
 TEST(mrinorm_unit, MRIsoapBubbleExpand) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -2,7 +2,92 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include "mrisurf_compute_dxyz.h"
+#include <cmath>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <vector>
+
+// an ic642 sphere of radius 50 with its original distances taken there,
+// then pushed in and out so that every local term has something to do
+static MRIS *localTermsSurface() {
+  MRIS *mris = ic642_make_surface(642, 1280);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, 50 * v->x, 50 * v->y, 50 * v->z);
+  }
+  MRISsetNeighborhoodSizeAndDist(mris, 2);
+  MRIScomputeMetricProperties(mris);
+  MRISsetOriginalXYZfromXYZ(mris);
+  mrisComputeOriginalVertexDistances(mris);
+  mris->orig_area = mris->total_area;
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v     = &mris->vertices[vno];
+    double const  scale = 1 + 0.05 * sin(7.0 * vno);
+    MRISsetXYZ(mris, vno, scale * v->x, scale * v->y, scale * v->z);
+  }
+  MRIScomputeMetricProperties(mris);
+  MRIScomputeSecondFundamentalForm(mris); // the tangent frames
+  return mris;
+}
+
+static void localTermsWeight(INTEGRATION_PARMS *parms, int term,
+                             double weight) {
+  switch (term) {
+  case MRIS_LOCAL_SPRING:
+    parms->l_spring = weight;
+    break;
+  case MRIS_LOCAL_LAPLACIAN:
+    parms->l_lap = weight;
+    break;
+  case MRIS_LOCAL_NORMAL_SPRING:
+    parms->l_nspring = weight;
+    break;
+  case MRIS_LOCAL_TANGENTIAL_SPRING:
+    parms->l_tspring = weight;
+    break;
+  case MRIS_LOCAL_NONLINEAR_TANGENTIAL_SPRING:
+    parms->l_nltspring = weight;
+    break;
+  case MRIS_LOCAL_NONLINEAR_SPRING:
+    parms->l_nlspring = weight;
+    break;
+  case MRIS_LOCAL_DISTANCE:
+    parms->l_dist = parms->l_nldist = weight;
+    break;
+  case MRIS_LOCAL_SPHERE:
+    parms->l_sphere = weight;
+    break;
+  case MRIS_LOCAL_EXPANSION:
+    parms->l_expand = weight;
+    break;
+  case MRIS_LOCAL_CONVEXITY:
+    parms->l_convex = weight;
+    break;
+  }
+}
+
+static std::vector<float> localTermsGradient(MRIS *mris,
+                                             INTEGRATION_PARMS *parms,
+                                             MRIS_LOCAL_TERM const *terms,
+                                             int nterms, bool separate) {
+  if (separate)
+    setenv("FREESURFER_OLD_mrisComputeLocalTerms", "1", 1);
+  MRISclearGradient(mris);
+  mrisComputeLocalTerms(mris, parms, terms, nterms);
+  unsetenv("FREESURFER_OLD_mrisComputeLocalTerms");
+
+  std::vector<float> gradient;
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    gradient.push_back(v->dx);
+    gradient.push_back(v->dy);
+    gradient.push_back(v->dz);
+  }
+  return gradient;
+}
 
 TEST(mrisurf_compute_dxyz_unit, mrisComputeAngleAreaTerms) { // NOLINT
 
@@ -181,6 +266,46 @@ TEST(mrisurf_compute_dxyz_unit, vertexComputeTangentialSpringTerm) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(mrisurf_compute_dxyz_unit, mrisComputeLocalTerms) { // NOLINT
+  MRIS *mris = localTermsSurface();
+
+  // the distance terms scale differently on a sphere
+  MRIS_Status const statuses[] = {MRIS_SURFACE, MRIS_SPHERE,
+                                  MRIS_PARAMETERIZED_SPHERE};
+  for (MRIS_Status status : statuses) {
+    mris->status = status;
+
+    // each term on its own, then all of them in one sweep
+    for (int term = 0; term <= MRIS_LOCAL_NTERMS; term++) {
+      INTEGRATION_PARMS parms;
+      parms.rmin     = 1;
+      parms.rmax     = 5;
+      parms.min_dist = 10;
+      parms.a        = -1; // the radius of the farthest vertex
+      for (int t = 0; t < MRIS_LOCAL_NTERMS; t++)
+        if (t == term || term == MRIS_LOCAL_NTERMS)
+          localTermsWeight(&parms, t, 0.5);
+
+      MRIS_LOCAL_TERM const  one = (MRIS_LOCAL_TERM)term;
+      MRIS_LOCAL_TERM const *terms =
+          term < MRIS_LOCAL_NTERMS ? &one : nullptr;
+      std::vector<float> const fused =
+          localTermsGradient(mris, &parms, terms, 1, false);
+      std::vector<float> const separate =
+          localTermsGradient(mris, &parms, terms, 1, true);
+
+      double total = 0;
+      for (size_t i = 0; i < fused.size(); i++) {
+        EXPECT_NEAR(fused[i], separate[i], 1e-5 * (1 + fabs(separate[i])))
+            << "status " << status << ", term " << term << ", vertex "
+            << i / 3;
+        total += fabs(separate[i]);
+      }
+      EXPECT_GT(total, 0) << "term " << term << " is zero everywhere";
+    }
+  }
+  MRISfree(&mris);
+}
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
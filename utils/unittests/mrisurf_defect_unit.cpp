@@ -2,7 +2,183 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mri.h"
+#include "mrisurf.h"
+#include "romp_support.h"
+#include <cmath>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// a sphere of radius 50 with ncaps of its caps, around the z, x and y axes
+// in turn, twisted around their axis in the canonical coordinates, so that
+// each cap is one defect to retessellate
+static MRIS *defectTwistedSphere(double cap, int ncaps) {
+  MRIS *mris = ic2562_make_surface(2 * 2562, 4 * 5120);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    double const  r = sqrt(v->x * v->x + v->y * v->y + v->z * v->z);
+    MRISsetXYZ(mris, vno, 50 * v->x / r, 50 * v->y / r, 50 * v->z / r);
+  }
+  MRIScomputeMetricProperties(mris);
+  MRISsaveVertexPositions(mris, ORIGINAL_VERTICES);
+  MRISsaveVertexPositions(mris, TMP_VERTICES);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v    = &mris->vertices[vno];
+    double        p[3] = {v->x, v->y, v->z};
+    for (int c = 0; c < ncaps; c++) {
+      int const    a = (2 + c / 2) % 3, i = (a + 1) % 3, j = (a + 2) % 3;
+      double const t = 0.8 * M_PI, pi = p[i], pj = p[j];
+      if (acos((c % 2 ? -p[a] : p[a]) / 50) < cap) {
+        p[i] = cos(t) * pi - sin(t) * pj;
+        p[j] = sin(t) * pi + cos(t) * pj;
+      }
+    }
+    MRISsetXYZ(mris, vno, p[0], p[1], p[2]);
+  }
+  MRIScomputeMetricProperties(mris);
+  MRISsaveVertexPositions(mris, CANONICAL_VERTICES);
+  MRISrestoreVertexPositions(mris, CANONICAL_VERTICES);
+  return mris;
+}
+
+// a bright ball of the same size on a dark background
+static MRI *defectBall() {
+  MRI *mri = MRIalloc(128, 128, 128, MRI_UCHAR);
+  for (int z = 0; z < 128; z++)
+    for (int y = 0; y < 128; y++)
+      for (int x = 0; x < 128; x++) {
+        double const r = sqrt(SQR(x - 64.) + SQR(y - 64.) + SQR(z - 64.));
+        MRIvox(mri, x, y, z) = r < 50 ? 110 : r < 54 ? 70 : 10;
+      }
+  return mri;
+}
+
+// corrects the twisted sphere with the genetic search on nthreads threads.
+// The correction keeps state from one call to the next, so it runs in a
+// process of its own, as in mris_fix_topology.
+static MRIS *defectCorrect(int nthreads, double cap = 0.5, int ncaps = 1) {
+  static int     ncorrections = 0;
+  char           fname[STRLEN];
+  MRIS *         mris, *mris_corrected;
+  MRI *          mri, *mri_wm;
+  TOPOLOGY_PARMS parms;
+  pid_t          pid;
+  int            status;
+
+  sprintf(fname, "lh.corrected%d", ncorrections++);
+  fflush(stdout);
+  fflush(stderr);
+  if ((pid = fork())) {
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && !WEXITSTATUS(status));
+    return (MRISread(fname));
+  }
+
+  mris   = defectTwistedSphere(cap, ncaps);
+  mri    = defectBall();
+  mri_wm = defectBall();
+
+  memset(&parms, 0, sizeof(parms));
+  parms.max_patches       = 10;
+  parms.max_unchanged     = 3;
+  parms.l_mri             = 1;
+  parms.l_curv            = 1;
+  parms.l_qcurv           = 1;
+  parms.l_unmri           = 1;
+  parms.search_mode       = GENETIC_SEARCH;
+  parms.niters            = -1;
+  parms.volume_resolution = -1;
+  parms.defect_number     = -1;
+  parms.correct_defect    = -1;
+
+  omp_set_num_threads(nthreads);
+  setRandomSeed(1234);
+  mris_corrected = MRIScorrectTopology(mris, mri, mri_wm, 0, &parms, NULL);
+  fflush(stdout);
+  _exit(!mris_corrected || MRISwrite(mris_corrected, fname) != NO_ERROR);
+}
+
+static void defectExpectSame(MRIS *a, MRIS *b) {
+  int nvertices, nfaces, nedges;
+
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(MRIScomputeEulerNumber(a, &nvertices, &nfaces, &nedges), 2);
+  ASSERT_EQ(a->nvertices, b->nvertices);
+  ASSERT_EQ(a->nfaces, b->nfaces);
+  for (int vno = 0; vno < a->nvertices; vno++) {
+    EXPECT_EQ(a->vertices[vno].x, b->vertices[vno].x);
+    EXPECT_EQ(a->vertices[vno].y, b->vertices[vno].y);
+    EXPECT_EQ(a->vertices[vno].z, b->vertices[vno].z);
+  }
+  for (int fno = 0; fno < a->nfaces; fno++)
+    for (int n = 0; n < VERTICES_PER_FACE; n++)
+      EXPECT_EQ(a->faces[fno].v[n], b->faces[fno].v[n]) << "face " << fno;
+}
+
+class mrisurf_defect_unit : public testing::Test {
+protected:
+  void SetUp() override {
+    // the correction writes its diagnostics to the working directory
+    char dir[] = "/tmp/mrisurf_defect_unit_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    ASSERT_EQ(chdir(dir), 0);
+    unsetenv("FREESURFER_OLD_mrisDefectPatchFitness");
+    unsetenv("FREESURFER_OLD_mrisComputeOptimalRetessellation");
+  }
+  void TearDown() override {
+    unsetenv("FREESURFER_OLD_mrisDefectPatchFitness");
+    unsetenv("FREESURFER_OLD_mrisComputeOptimalRetessellation");
+  }
+};
+
+TEST_F(mrisurf_defect_unit, fitnessCache) { // NOLINT
+  // scoring every patch again gives the fitness the cache and the parallel
+  // scoring store
+  setenv("FREESURFER_OLD_mrisDefectPatchFitness", "1", 1);
+  MRIS *uncached = defectCorrect(1);
+  unsetenv("FREESURFER_OLD_mrisDefectPatchFitness");
+  MRIS *cached = defectCorrect(4);
+
+  defectExpectSame(uncached, cached);
+  MRISfree(&uncached);
+  MRISfree(&cached);
+}
+
+TEST_F(mrisurf_defect_unit, fitnessThreads) { // NOLINT
+  MRIS *serial   = defectCorrect(1);
+  MRIS *parallel = defectCorrect(4);
+
+  defectExpectSame(serial, parallel);
+  MRISfree(&serial);
+  MRISfree(&parallel);
+}
+
+TEST_F(mrisurf_defect_unit, searchThreads) { // NOLINT
+  // defects too small to score their patches concurrently, and far enough
+  // apart to be searched concurrently
+  MRIS *serial   = defectCorrect(1, 0.15, 6);
+  MRIS *parallel = defectCorrect(4, 0.15, 6);
+
+  defectExpectSame(serial, parallel);
+  MRISfree(&serial);
+  MRISfree(&parallel);
+}
+
+TEST_F(mrisurf_defect_unit, fitnessCacheOldSearch) { // NOLINT
+  setenv("FREESURFER_OLD_mrisComputeOptimalRetessellation", "1", 1);
+  setenv("FREESURFER_OLD_mrisDefectPatchFitness", "1", 1);
+  MRIS *uncached = defectCorrect(1);
+  unsetenv("FREESURFER_OLD_mrisDefectPatchFitness");
+  MRIS *cached = defectCorrect(1);
+
+  defectExpectSame(uncached, cached);
+  MRISfree(&uncached);
+  MRISfree(&cached);
+}
 
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
@@ -2,7 +2,110 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "fio.h"
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include "romp_support.h"
+#include <cmath>
+#include <cstdio>
 #include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+// a scratch directory for the files the tests write
+static std::string ioScratchDir() {
+  char dir[] = "/tmp/mrisurf_io_unit_XXXXXX";
+  EXPECT_NE(mkdtemp(dir), nullptr);
+  return dir;
+}
+
+TEST(mrisurf_io_unit, MRISreadAnnotationIntoArray) { // NOLINT
+  std::string const fname = ioScratchDir() + "/lh.truncated.annot";
+
+  // a count far past the pairs in the file reads what is there, without
+  // allocating for the count
+  FILE *fp = fopen(fname.c_str(), "wb");
+  ASSERT_NE(fp, nullptr);
+  fwriteInt(0x7fffffff, fp);
+  for (int vno = 0; vno < 5; vno++) {
+    fwriteInt(2 * vno, fp);
+    fwriteInt(100 + vno, fp);
+  }
+  fclose(fp);
+  int *array = nullptr;
+  ASSERT_EQ(MRISreadAnnotationIntoArray(fname.c_str(), 10, &array), NO_ERROR);
+  for (int vno = 0; vno < 10; vno++)
+    EXPECT_EQ(array[vno], vno % 2 ? 0 : 100 + vno / 2) << "vertex " << vno;
+  free(array);
+
+  // more pairs than are read at once, with the later ones winning
+  int const npairs = 200003, size = 1000;
+  fp               = fopen(fname.c_str(), "wb");
+  ASSERT_NE(fp, nullptr);
+  fwriteInt(npairs, fp);
+  for (int n = 0; n < npairs; n++) {
+    fwriteInt(n % size, fp);
+    fwriteInt(n, fp);
+  }
+  fclose(fp);
+  ASSERT_EQ(MRISreadAnnotationIntoArray(fname.c_str(), size, &array),
+            NO_ERROR);
+  for (int vno = 0; vno < size; vno++)
+    EXPECT_EQ(array[vno], npairs - 1 - (npairs - 1 - vno) % size);
+  free(array);
+  unlink(fname.c_str());
+}
+
+TEST(mrisurf_io_unit, MRISreadTriangleFile) { // NOLINT
+  std::string const dir   = ioScratchDir();
+  std::string const fname = dir + "/lh.sphere";
+  MRIS *            mris  = ic2562_make_surface(2562, 5120);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, 100 * v->x, 100 * v->y + 0.25, 100 * v->z);
+    mris->vertices[vno].curv       = sin(vno * 0.37);
+    mris->vertices[vno].annotation = (vno * 7919) & 0xffffff;
+  }
+  ASSERT_EQ(MRISwrite(mris, fname.c_str()), NO_ERROR);
+  ASSERT_EQ(MRISwriteCurvature(mris, (dir + "/lh.thickness").c_str()),
+            NO_ERROR);
+  ASSERT_EQ(MRISwriteAnnotation(mris, (dir + "/lh.test.annot").c_str()),
+            NO_ERROR);
+
+  // the surface is the same however many threads fill it
+  for (int nthreads : {1, 4}) {
+    omp_set_num_threads(nthreads);
+    MRIS *read = MRISread(fname.c_str());
+    ASSERT_NE(read, nullptr);
+    ASSERT_EQ(read->nvertices, mris->nvertices);
+    ASSERT_EQ(read->nfaces, mris->nfaces);
+    for (int vno = 0; vno < mris->nvertices; vno++) {
+      EXPECT_EQ(read->vertices[vno].x, mris->vertices[vno].x);
+      EXPECT_EQ(read->vertices[vno].y, mris->vertices[vno].y);
+      EXPECT_EQ(read->vertices[vno].z, mris->vertices[vno].z);
+      EXPECT_EQ(read->vertices_topology[vno].num,
+                mris->vertices_topology[vno].num);
+    }
+    for (int fno = 0; fno < mris->nfaces; fno++)
+      for (int n = 0; n < VERTICES_PER_FACE; n++)
+        EXPECT_EQ(read->faces[fno].v[n], mris->faces[fno].v[n]);
+
+    ASSERT_EQ(MRISreadNewCurvatureFile(read, (dir + "/lh.thickness").c_str()),
+              NO_ERROR);
+    int *annot = nullptr;
+    ASSERT_EQ(MRISreadAnnotationIntoArray((dir + "/lh.test.annot").c_str(),
+                                          read->nvertices, &annot),
+              NO_ERROR);
+    for (int vno = 0; vno < mris->nvertices; vno++) {
+      EXPECT_EQ(read->vertices[vno].curv, mris->vertices[vno].curv);
+      EXPECT_EQ(annot[vno], mris->vertices[vno].annotation);
+    }
+    free(annot);
+    MRISfree(&read);
+  }
+  omp_set_num_threads(1);
+  MRISfree(&mris);
+}
 
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
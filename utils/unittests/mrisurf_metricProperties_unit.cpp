@@ -2,6 +2,11 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(mrisurf_metricProperties_unit, mrisCheckSurface) { // NOLINT
@@ -217,6 +222,56 @@ TEST(mrisurf_metricProperties_unit,
 
   EXPECT_EQ(1, 0);
 }
+
+TEST(mrisurf_metricProperties_unit,
+     MRIScomputeSecondFundamentalForm) { // NOLINT
+  // an elongated, bumpy ellipsoid: along its sides the tangent-plane
+  // neighborhoods are stretched enough that the normal equations of some
+  // fits are near the ILL_CONDITIONED bound
+  MRIS *mris = ic2562_make_surface(2562, 5120);
+  ASSERT_TRUE(mris != nullptr);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    float const   r = sqrt(v->x * v->x + v->y * v->y + v->z * v->z);
+    float const   x = v->x / r, y = v->y / r, z = v->z / r;
+    float const   bump = 1 + 0.05 * sin(5 * x) * cos(4 * y + 3 * z);
+    MRISsetXYZ(mris, vno, 10 * x * bump, 15 * y * bump, 120 * z * bump);
+  }
+  MRIScomputeMetricProperties(mris);
+
+  int const nvertices = mris->nvertices;
+  std::vector<float> k1(nvertices), k2(nvertices), e1(3 * nvertices);
+  unsetenv("FREESURFER_OLD_MRIScomputeSecondFundamentalForm");
+  ASSERT_EQ(MRIScomputeSecondFundamentalForm(mris), NO_ERROR);
+  for (int vno = 0; vno < nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    k1[vno]         = v->k1;
+    k2[vno]         = v->k2;
+    e1[3 * vno]     = v->e1x;
+    e1[3 * vno + 1] = v->e1y;
+    e1[3 * vno + 2] = v->e1z;
+  }
+  setenv("FREESURFER_OLD_MRIScomputeSecondFundamentalForm", "1", 1);
+  ASSERT_EQ(MRIScomputeSecondFundamentalForm(mris), NO_ERROR);
+  unsetenv("FREESURFER_OLD_MRIScomputeSecondFundamentalForm");
+
+  // the NR fit is in floats, so agree to its precision; the principal
+  // directions may differ in sign
+  for (int vno = 0; vno < nvertices; vno++) {
+    VERTEX const *v   = &mris->vertices[vno];
+    float const   tol = 1e-3 * (fabs(v->k1) + fabs(v->k2)) + 1e-5;
+    EXPECT_NEAR(k1[vno], v->k1, tol) << "vertex " << vno;
+    EXPECT_NEAR(k2[vno], v->k2, tol) << "vertex " << vno;
+    if (fabs(v->k1 - v->k2) > 0.01 * (fabs(v->k1) + fabs(v->k2))) {
+      EXPECT_NEAR(fabs(e1[3 * vno] * v->e1x + e1[3 * vno + 1] * v->e1y +
+                       e1[3 * vno + 2] * v->e1z),
+                  1, 1e-3)
+          << "vertex " << vno;
+    }
+  }
+  MRISfree(&mris);
+}
+
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
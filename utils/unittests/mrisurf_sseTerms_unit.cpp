@@ -2,8 +2,35 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include "mrisurf_sseTerms.h"
+#include <cmath>
+#include <cstdlib>
 #include <gtest/gtest.h>
 
+// an ic642 sphere of radius 50 with its original distances taken there,
+// then pushed in and out so that every energy is nonzero
+static MRIS *localEnergiesSurface() {
+  MRIS *mris = ic642_make_surface(642, 1280);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, 50 * v->x, 50 * v->y, 50 * v->z);
+  }
+  MRISsetNeighborhoodSizeAndDist(mris, 2);
+  MRIScomputeMetricProperties(mris);
+  MRISsetOriginalXYZfromXYZ(mris);
+  mrisComputeOriginalVertexDistances(mris);
+  mris->orig_area = mris->total_area;
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v     = &mris->vertices[vno];
+    double const  scale = 1 + 0.05 * sin(7.0 * vno);
+    MRISsetXYZ(mris, vno, scale * v->x, scale * v->y, scale * v->z);
+  }
+  MRIScomputeMetricProperties(mris);
+  return mris;
+}
+
 TEST(mrisurf_sseTerms_unit, vlst_loglikelihood) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -38,8 +65,38 @@ TEST(mrisurf_sseTerms_unit, MRIScomputeSSE_canDo) { // NOLINT
 }
 
 TEST(mrisurf_sseTerms_unit, MRIScomputeSSE) { // NOLINT
-
-  EXPECT_EQ(1, 0);
+  MRIS *mris = localEnergiesSurface();
+
+  // the energies mrisComputeLocalEnergies sums in one sweep, each on its
+  // own and then all of them, against the separate functions
+  int const nterms = 6;
+  for (int term = 0; term <= nterms; term++) {
+    INTEGRATION_PARMS parms;
+    parms.rmin = 1;
+    parms.rmax = 5;
+    parms.a    = 55;
+    if (term == 0 || term == nterms)
+      parms.l_spring = 0.5;
+    if (term == 1 || term == nterms)
+      parms.l_lap = 0.5;
+    if (term == 2 || term == nterms)
+      parms.l_tspring = 0.5;
+    if (term == 3 || term == nterms)
+      parms.l_nlspring = 0.5;
+    if (term == 4 || term == nterms)
+      parms.l_dist = 0.5;
+    if (term == 5 || term == nterms)
+      parms.l_sphere = 0.5;
+
+    double const fused = MRIScomputeSSE(mris, &parms);
+    setenv("FREESURFER_OLD_mrisComputeLocalEnergies", "1", 1);
+    double const separate = MRIScomputeSSE(mris, &parms);
+    unsetenv("FREESURFER_OLD_mrisComputeLocalEnergies");
+
+    EXPECT_GT(separate, 0) << "term " << term;
+    EXPECT_NEAR(fused, separate, 1e-9 * separate) << "term " << term;
+  }
+  MRISfree(&mris);
 }
 TEST(mrisurf_sseTerms_unit, MRIScomputeSSEExternal) { // NOLINT
 
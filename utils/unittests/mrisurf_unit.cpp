@@ -2,6 +2,11 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include "utils.h"
+#include <cstdlib>
+#include <filesystem>
 #include <gtest/gtest.h>
 
 TEST(mrisurf_unit, MRISctr) { // NOLINT
@@ -560,6 +565,62 @@ TEST(mrisurf_unit, MRISsampleDistances) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+// successive ic642_make_surface() calls alternate the face orientation,
+// so every run samples a clone of the same surface
+static MRIS *sampledIco642(MRIS *ico, int *nbrs, int max_nbhd) {
+  MRIS *mris = MRISclone(ico);
+  MRISsetNeighborhoodSizeAndDist(mris, 2);
+  setRandomSeed(1234);
+  MRISsampleDistances(mris, nbrs, max_nbhd);
+  return mris;
+}
+static void expectSameSampling(MRIS *lhs, MRIS *rhs) {
+  ASSERT_EQ(lhs->nvertices, rhs->nvertices);
+  EXPECT_EQ(lhs->nsize, rhs->nsize);
+  EXPECT_EQ(lhs->avg_nbrs, rhs->avg_nbrs);
+  for (int vno = 0; vno < lhs->nvertices; vno++) {
+    VERTEX_TOPOLOGY const *const lt = &lhs->vertices_topology[vno];
+    VERTEX_TOPOLOGY const *const rt = &rhs->vertices_topology[vno];
+    ASSERT_EQ(lt->vtotal, rt->vtotal);
+    for (int n = 0; n < lt->vtotal; n++) {
+      ASSERT_EQ(lt->v[n], rt->v[n]);
+      ASSERT_EQ(lhs->vertices[vno].dist_orig[n],
+                rhs->vertices[vno].dist_orig[n]);
+    }
+  }
+}
+TEST(mrisurf_unit, MRISsampleDistances_cache) { // NOLINT
+  int nbrs[11] = {0};
+  for (int n = 3; n <= 10; n++) {
+    nbrs[n] = 4;
+  }
+
+  MRIS *ico = ic642_make_surface(642, 1280);
+  unsetenv("FREESURFER_MRIS_NBHD_CACHE");
+  MRIS *     uncached      = sampledIco642(ico, nbrs, 10);
+  long const uncachedCalls = getRandomCalls();
+
+  char dir[] = "/tmp/mris_nbhd_XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  setenv("FREESURFER_MRIS_NBHD_CACHE", dir, 1);
+
+  // the first run fills the cache, the second reads it
+  MRIS *written = sampledIco642(ico, nbrs, 10);
+  EXPECT_EQ(getRandomCalls(), uncachedCalls);
+  EXPECT_FALSE(std::filesystem::is_empty(dir));
+  MRIS *read = sampledIco642(ico, nbrs, 10);
+  EXPECT_EQ(getRandomCalls(), uncachedCalls);
+
+  expectSameSampling(uncached, written);
+  expectSameSampling(uncached, read);
+
+  unsetenv("FREESURFER_MRIS_NBHD_CACHE");
+  std::filesystem::remove_all(dir);
+  MRISfree(&uncached);
+  MRISfree(&written);
+  MRISfree(&read);
+  MRISfree(&ico);
+}
 TEST(mrisurf_unit, MRISsampleAtEachDistance) { // NOLINT
 
   EXPECT_EQ(1, 0);
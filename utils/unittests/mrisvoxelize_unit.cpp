@@ -0,0 +1,67 @@
+#include "icosahedron.h"
+#include "mrisvoxelize.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+TEST(mrisvoxelize_unit, MRISvoxelizeSurfaces) { // NOLINT
+  // an icosahedral sphere of radius 20 in the middle of a 64^3 volume
+  int const   n = 64;
+  float const radius = 20, cap = 3;
+  MRIS *      mris = ic642_make_surface(642, 1280);
+  ASSERT_TRUE(mris != nullptr);
+  VERTEX const *v0 = &mris->vertices[0];
+  float const   scale =
+      radius / sqrt(v0->x * v0->x + v0->y * v0->y + v0->z * v0->z);
+  for (int vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX const *v = &mris->vertices[vno];
+    MRISsetXYZ(mris, vno, scale * v->x, scale * v->y, scale * v->z);
+  }
+  MRI *mri = MRIalloc(n, n, n, MRI_UCHAR);
+
+  MRIS *surfs[2] = {mris, mris};
+  MRI * dist[2] = {nullptr, nullptr}, *interior[2] = {nullptr, nullptr};
+  ASSERT_EQ(MRISvoxelizeSurfaces(surfs, 2, mri, cap, dist, interior),
+            NO_ERROR);
+  ASSERT_TRUE(dist[0] != nullptr && interior[1] != nullptr);
+
+  // the inside is close to the volume of the sphere and agrees with the sign
+  int ninside = 0;
+  for (int z = 0; z < n; z++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++) {
+        float d = MRIFvox(dist[0], x, y, z);
+        ninside += MRIvox(interior[0], x, y, z);
+        if (d != 0) { // a center on the surface may go either way
+          EXPECT_EQ(MRIvox(interior[0], x, y, z), d > 0 ? 1 : 0);
+        }
+        EXPECT_EQ(MRIFvox(dist[1], x, y, z), d);
+        EXPECT_LE(fabs(d), cap);
+      }
+  EXPECT_NEAR(ninside, 4 * M_PI * radius * radius * radius / 3, 1000);
+  EXPECT_EQ(MRIFvox(dist[0], n / 2, n / 2, n / 2), cap);
+  EXPECT_EQ(MRIFvox(dist[0], 0, 0, 0), -cap);
+
+  // the band is the distance to the surface along each axis, whichever
+  // side of the center the sphere lands on
+  for (int k = 18; k <= 22; k++) {
+    float dx = MRIFvox(dist[0], n / 2 + k, n / 2, n / 2) +
+               MRIFvox(dist[0], n / 2 - k, n / 2, n / 2);
+    float dz = MRIFvox(dist[0], n / 2, n / 2, n / 2 + k) +
+               MRIFvox(dist[0], n / 2, n / 2, n / 2 - k);
+    EXPECT_NEAR(dx, 2 * (radius - k), 0.5);
+    EXPECT_NEAR(dz, 2 * (radius - k), 0.5);
+  }
+
+  for (int k = 0; k < 2; k++) {
+    MRIfree(&dist[k]);
+    MRIfree(&interior[k]);
+  }
+  MRIfree(&mri);
+  MRISfree(&mris);
+}
+
+auto main(int /*argc*/, char ** /*argv*/) -> int {
+
+  testing::InitGoogleTest();
+  return RUN_ALL_TESTS();
+}
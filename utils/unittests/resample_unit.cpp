@@ -2,6 +2,9 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "mri.h"
+#include "resample.h"
+#include <cmath>
 #include <gtest/gtest.h>
 
 TEST(resample_unit, interpolation_code) { // NOLINT
@@ -88,6 +91,69 @@ TEST(resample_unit, vol2surf_linear) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(resample_unit, vol2surf_operator) { // NOLINT
+  // a multi-depth operator should give the depth average (or max) of
+  // vol2surf_linear() at each depth, for every frame
+  MRI *vol = MRIallocSequence(12, 11, 10, MRI_FLOAT, 3);
+  for (int f = 0; f < vol->nframes; f++)
+    for (int s = 0; s < vol->depth; s++)
+      for (int r = 0; r < vol->height; r++)
+        for (int c = 0; c < vol->width; c++)
+          MRIFseq_vox(vol, c, r, s, f) = sin(c + 2 * r + 3 * s + f);
+
+  vol->outside_val = 100;
+
+  MRIS *surf = MRISalloc(40, 0);
+  for (int vno = 0; vno < surf->nvertices; vno++) {
+    MRISsetXYZ(surf, vno, 0.37 * vno - 7, 5 - 0.21 * vno, 0.11 * vno - 2);
+    surf->vertices[vno].nx = 0.6;
+    surf->vertices[vno].ny = 0.0;
+    surf->vertices[vno].nz = 0.8;
+  }
+  // within half a voxel of the edges (c = 6 - x, r = 5.5 - z, s = y + 5),
+  // where the rounding modes disagree on what is out of the volume
+  MRISsetXYZ(surf, 0, -5.9, 0, 0);
+  MRISsetXYZ(surf, 1, 0, 0, 5.9);
+  MRISsetXYZ(surf, 2, 0, 4.7, 0);
+  MRISsetXYZ(surf, 3, 0, -5.3, 0);
+
+  int const float2ints[] = {FLT2INT_ROUND, FLT2INT_FLOOR, FLT2INT_TKREG};
+  for (int n = 0; n < 6; n++) {
+    int const          interp = SAMPLE_NEAREST + n / 3;
+    int const          float2int = float2ints[n % 3];
+    VOL2SURF_OPERATOR *op = vol2surf_operator_alloc(
+        vol, NULL, NULL, NULL, NULL, surf, 0, 1, 0.25, interp, float2int, 1);
+    ASSERT_TRUE(op != NULL);
+    EXPECT_EQ(op->ndepths, 5);
+
+    for (int getmax = 0; getmax <= 1; getmax++) {
+      MRI *avg = vol2surf_operator_apply(op, vol, getmax, NULL, NULL);
+      ASSERT_TRUE(avg != NULL);
+      for (int f = 0; f < vol->nframes; f++) {
+        for (int vno = 0; vno < surf->nvertices; vno++) {
+          double expected = 0;
+          for (int d = 0; d < op->ndepths; d++) {
+            MRI *one =
+                vol2surf_linear(vol, NULL, NULL, NULL, NULL, surf,
+                                op->depths[d], interp, float2int, NULL, 1, 1);
+            double val = MRIFseq_vox(one, vno, 0, 0, f);
+            if (!getmax)
+              expected += val / op->ndepths;
+            else if (d == 0 || val > expected)
+              expected = val;
+            MRIfree(&one);
+          }
+          EXPECT_NEAR(MRIFseq_vox(avg, vno, 0, 0, f), expected, 1e-5);
+        }
+      }
+      MRIfree(&avg);
+    }
+    vol2surf_operator_free(&op);
+    EXPECT_TRUE(op == NULL);
+  }
+  MRISfree(&surf);
+  MRIfree(&vol);
+}
 TEST(resample_unit, MRISapplyReg) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -4,6 +4,9 @@
 
 #include <gtest/gtest.h>
 
+#include "error.h"
+#include "rforest.h"
+
 TEST(rforest_unit, RFalloc) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -56,6 +59,42 @@ TEST(rforest_unit, RFpruneTree) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(rforest_unit, RFclassifyBatch) { // NOLINT
+
+  const int ntraining = 400, nfeatures = 3;
+  int       classes[ntraining], batch_classes[ntraining];
+  double    data[ntraining][nfeatures], *training_data[ntraining];
+  double    batch_pvals[ntraining];
+
+  // two noisy, linearly separable classes
+  srand(17);
+  for (int i = 0; i < ntraining; i++) {
+    classes[i] = i % 2;
+    for (int f = 0; f < nfeatures; f++)
+      data[i][f] = (double)rand() / RAND_MAX + (f == 0 ? classes[i] : 0);
+    training_data[i] = data[i];
+  }
+
+  RANDOM_FOREST *rf = RFalloc(8, nfeatures, 2, 10, nullptr, 20);
+  ASSERT_NE(rf, nullptr);
+  ASSERT_EQ(RFtrain(rf, 1.0, 0.5, classes, training_data, ntraining),
+            NO_ERROR);
+  ASSERT_EQ(RFclassifyBatch(rf, training_data, ntraining, batch_classes,
+                            batch_pvals),
+            NO_ERROR);
+
+  int ncorrect = 0;
+  for (int i = 0; i < ntraining; i++) {
+    double pval;
+    int    label = RFclassify(rf, training_data[i], &pval, -1);
+
+    EXPECT_EQ(batch_classes[i], label);
+    EXPECT_DOUBLE_EQ(batch_pvals[i], pval);
+    ncorrect += (label == classes[i]);
+  }
+  EXPECT_GT(ncorrect, ntraining * 9 / 10);
+  RFfree(&rf);
+}
 auto main(int /*argc*/, char ** /*argv*/) -> int {
 
   testing::InitGoogleTest();
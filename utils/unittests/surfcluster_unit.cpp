@@ -2,12 +2,75 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "icosahedron.h"
+#include "mrisurf.h"
+#include "surfcluster.h"
+#include "volcluster.h"
+#include <cmath>
 #include <gtest/gtest.h>
+#include <vector>
+
+// the clusters the recursive grower of sclustMapSurfClusters() finds
+static std::vector<int> sclustGrowAll(MRIS *mris, float thmin, float minarea) {
+  int clusterno = 1, nvtxs;
+  for (int vtx = 0; vtx < mris->nvertices; vtx++)
+    mris->vertices[vtx].undefval = 0;
+  for (int vtx = 0; vtx < mris->nvertices; vtx++) {
+    if (mris->vertices[vtx].undefval ||
+        !clustValueInRange(mris->vertices[vtx].val, thmin, 0, 0))
+      continue;
+    sclustGrowSurfCluster(clusterno, vtx, mris, thmin, 0, 0);
+    if (minarea > 0 && sclustSurfaceArea(clusterno, mris, &nvtxs) < minarea) {
+      sclustZeroSurfaceClusterNo(clusterno, mris);
+      continue;
+    }
+    clusterno++;
+  }
+  std::vector<int> map(mris->nvertices);
+  for (int vtx = 0; vtx < mris->nvertices; vtx++)
+    map[vtx] = mris->vertices[vtx].undefval;
+  return map;
+}
 
 TEST(surfcluster_unit, sclustMapSurfClusters) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(surfcluster_unit, sclustLabelSurfClusters) { // NOLINT
+  MRIS *mris = ic642_make_surface(642, 1280);
+  for (int vtx = 0; vtx < mris->nvertices; vtx++) {
+    VERTEX *v = &mris->vertices[vtx];
+    v->val    = sin(7 * v->x) * cos(5 * v->y) + 0.3 * sin(11 * v->z);
+  }
+  MRIScomputeMetricProperties(mris);
+
+  for (int group = 0; group < 2; group++) {
+    // with the group area scaling, the areas go through one more rounding
+    mris->group_avg_surface_area = group ? 1.3f * mris->total_area : 0;
+
+    std::vector<int> const all = sclustGrowAll(mris, 0.4, 0);
+    int const nclusters = *std::max_element(all.begin(), all.end());
+    ASSERT_GT(nclusters, 2);
+
+    // a cluster whose area is exactly minarea is kept, and one ulp more
+    // drops it, the same way in both labelers
+    for (int c = 1; c <= nclusters; c++) {
+      int         nvtxs;
+      float const area = sclustSurfaceArea(c, mris, &nvtxs);
+      for (float minarea : {area, nextafterf(area, 2 * area)}) {
+        std::vector<int> const grown = sclustGrowAll(mris, 0.4, minarea);
+        int const n = sclustLabelSurfClusters(mris, 0.4, 0, 0, minarea);
+        EXPECT_EQ(n, *std::max_element(grown.begin(), grown.end()));
+        for (int vtx = 0; vtx < mris->nvertices; vtx++)
+          ASSERT_EQ(mris->vertices[vtx].undefval, grown[vtx])
+              << "cluster " << c << " vertex " << vtx;
+        // sclustGrowAll() overwrote the cluster numbers
+        sclustGrowAll(mris, 0.4, 0);
+      }
+    }
+  }
+  MRISfree(&mris);
+}
 TEST(surfcluster_unit, sclustGrowSurfCluster) { // NOLINT
 
   EXPECT_EQ(1, 0);
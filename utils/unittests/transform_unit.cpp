@@ -2,6 +2,11 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "gcamorph.h"
+#include "matrix.h"
+#include "transform.h"
+#include <cmath>
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(transform_unit, mincGetVolInfo) { // NOLINT
@@ -164,6 +169,219 @@ TEST(transform_unit, TransformSampleInverseVoxel) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+
+// each TE_* mode against its TransformSample*() wrapper, and the array
+// form against the scalar form, for the points in pts
+// the forward morph modes computed straight from the inverse volumes, as
+// the baseline TransformSample*() did: the point is clamped into the
+// volume, then the volumes are sampled nearest (TE_SAMPLE_REAL) or
+// trilinearly, and scaled by the spacing
+static void morphSampleReference(GCA_MORPH *gcam, int which, float xv,
+                                 float yv, float zv, float *px, float *py,
+                                 float *pz) {
+  MRI *const mri[3] = {gcam->mri_xind, gcam->mri_yind, gcam->mri_zind};
+  int const  dim[3] = {mri[0]->width, mri[0]->height, mri[0]->depth};
+  double     p[3]   = {xv, yv, zv}, out[3];
+
+  for (int k = 0; k < 3; k++)
+    p[k] = std::min(std::max(p[k], 0.0), dim[k] - 1.0);
+  for (int k = 0; k < 3; k++) {
+    if (which == TE_SAMPLE_REAL) {
+      out[k] = MRIFvox(mri[k], nint(p[0]), nint(p[1]), nint(p[2]));
+    } else {
+      int    i0[3], i1[3];
+      double f[3];
+      for (int d = 0; d < 3; d++) {
+        i0[d] = (int)floor(p[d]);
+        i1[d] = std::min(i0[d] + 1, dim[d] - 1);
+        f[d]  = p[d] - i0[d];
+      }
+      out[k] = 0;
+      for (int c = 0; c < 8; c++) {
+        double w = 1;
+        int    i[3];
+        for (int d = 0; d < 3; d++) {
+          int const hi = (c >> d) & 1;
+          i[d]         = hi ? i1[d] : i0[d];
+          w *= hi ? f[d] : 1 - f[d];
+        }
+        out[k] += w * MRIFvox(mri[k], i[0], i[1], i[2]);
+      }
+    }
+    out[k] *= gcam->spacing;
+  }
+  *px = out[0];
+  *py = out[1];
+  *pz = out[2];
+}
+
+static void expectEvaluatorMatchesWrappers(TRANSFORM *         transform,
+                                           const float *       pts,
+                                           int                 npts,
+                                           TRANSFORM_EVALUATOR *te) {
+  float x, y, z, ex, ey, ez;
+  int   err, eerr;
+
+  std::vector<float> dst(3 * npts);
+  std::vector<int>   errors(npts);
+  for (int which = TE_SAMPLE; which <= TE_SAMPLE_INVERSE_FLOAT; which++) {
+    TransformEvaluateArray(te, which, npts, pts, dst.data(), errors.data());
+    for (int n = 0; n < npts; n++) {
+      const float *p = &pts[3 * n];
+      switch (which) {
+      case TE_SAMPLE:
+        err = TransformSample(transform, p[0], p[1], p[2], &x, &y, &z);
+        break;
+      case TE_SAMPLE_REAL:
+        err = TransformSampleReal(transform, p[0], p[1], p[2], &x, &y, &z);
+        break;
+      case TE_SAMPLE_REAL2:
+        err = TransformSampleReal2(transform, p[0], p[1], p[2], &x, &y, &z);
+        break;
+      case TE_SAMPLE_INVERSE:
+        err = TransformSampleInverse(transform, (int)p[0], (int)p[1],
+                                     (int)p[2], &x, &y, &z);
+        break;
+      default:
+        err = TransformSampleInverseFloat(transform, p[0], p[1], p[2], &x, &y,
+                                          &z);
+        break;
+      }
+      eerr = TransformEvaluate(te, which, p[0], p[1], p[2], &ex, &ey, &ez);
+      EXPECT_EQ(eerr, err) << "mode " << which << " point " << n;
+      EXPECT_EQ(ex, x) << "mode " << which << " point " << n;
+      EXPECT_EQ(ey, y) << "mode " << which << " point " << n;
+      EXPECT_EQ(ez, z) << "mode " << which << " point " << n;
+      EXPECT_EQ(errors[n], eerr) << "mode " << which << " point " << n;
+      if (eerr == NO_ERROR) {
+        EXPECT_EQ(dst[3 * n + 0], ex) << "mode " << which << " point " << n;
+        EXPECT_EQ(dst[3 * n + 1], ey) << "mode " << which << " point " << n;
+        EXPECT_EQ(dst[3 * n + 2], ez) << "mode " << which << " point " << n;
+      }
+    }
+  }
+}
+
+TEST(transform_unit, TransformEvaluate) { // NOLINT
+  float const pts[] = {1.3f, 2.7f,  3.1f, 0.0f, 0.0f, 0.0f, 4.5f, 5.5f,
+                       6.5f, -2.0f, 1.0f, 7.2f, 8.9f, 3.3f, 9.9f, 2.0f,
+                       11.4f, 0.6f};
+  int const   npts  = sizeof(pts) / sizeof(pts[0]) / 3;
+
+  // an affine with rotation, anisotropic scaling and a shift
+  LTA *lta  = LTAalloc(1, NULL);
+  lta->type = LINEAR_VOX_TO_VOX;
+  MATRIX *m = lta->xforms[0].m_L;
+  double  a = 0.3;
+  *MATRIX_RELT(m, 1, 1) = 1.1 * cos(a);
+  *MATRIX_RELT(m, 1, 2) = -sin(a);
+  *MATRIX_RELT(m, 1, 4) = 2.5;
+  *MATRIX_RELT(m, 2, 1) = sin(a);
+  *MATRIX_RELT(m, 2, 2) = 0.9 * cos(a);
+  *MATRIX_RELT(m, 2, 4) = -1.25;
+  *MATRIX_RELT(m, 3, 3) = 1.2;
+  *MATRIX_RELT(m, 3, 4) = 0.75;
+  LTAfillInverse(lta);
+
+  TRANSFORM transform{};
+  transform.type  = LINEAR_VOX_TO_VOX;
+  transform.xform = lta;
+
+  TRANSFORM_EVALUATOR te;
+  ASSERT_EQ(TransformEvaluatorInit(&te, &transform), NO_ERROR);
+  expectEvaluatorMatchesWrappers(&transform, pts, npts, &te);
+
+  // the affine is L * (x,y,z,1), and the inverse maps it back
+  VECTOR *v_in = VectorAlloc(4, MATRIX_REAL), *v_out = NULL;
+  for (int n = 0; n < npts; n++) {
+    float x, y, z, xi, yi, zi;
+    V3_X(v_in)                = pts[3 * n];
+    V3_Y(v_in)                = pts[3 * n + 1];
+    V3_Z(v_in)                = pts[3 * n + 2];
+    *MATRIX_RELT(v_in, 4, 1) = 1;
+    v_out                     = MatrixMultiply(m, v_in, v_out);
+    TransformEvaluate(&te, TE_SAMPLE, pts[3 * n], pts[3 * n + 1],
+                      pts[3 * n + 2], &x, &y, &z);
+    EXPECT_FLOAT_EQ(x, V3_X(v_out));
+    EXPECT_FLOAT_EQ(y, V3_Y(v_out));
+    EXPECT_FLOAT_EQ(z, V3_Z(v_out));
+    // the real modes clamp negative coordinates to 0
+    for (int which : {TE_SAMPLE_REAL, TE_SAMPLE_REAL2}) {
+      float xr, yr, zr;
+      TransformEvaluate(&te, which, pts[3 * n], pts[3 * n + 1],
+                        pts[3 * n + 2], &xr, &yr, &zr);
+      EXPECT_FLOAT_EQ(xr, std::max(V3_X(v_out), 0.0f));
+      EXPECT_FLOAT_EQ(yr, std::max(V3_Y(v_out), 0.0f));
+      EXPECT_FLOAT_EQ(zr, std::max(V3_Z(v_out), 0.0f));
+    }
+    TransformEvaluate(&te, TE_SAMPLE_INVERSE_FLOAT, x, y, z, &xi, &yi, &zi);
+    EXPECT_NEAR(xi, pts[3 * n], 1e-4);
+    EXPECT_NEAR(yi, pts[3 * n + 1], 1e-4);
+    EXPECT_NEAR(zi, pts[3 * n + 2], 1e-4);
+  }
+  VectorFree(&v_in);
+  VectorFree(&v_out);
+
+  // an LTA without a stored inverse gets the inverse of its matrix
+  TRANSFORM_EVALUATOR te_noinv;
+  MatrixFree(&lta->inv_xforms[0].m_L);
+  ASSERT_EQ(TransformEvaluatorInit(&te_noinv, &transform), NO_ERROR);
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 4; c++)
+      EXPECT_NEAR(te_noinv.L_inv[r][c], te.L_inv[r][c], 1e-6);
+  LTAfree(&lta);
+
+  // a small morph with spacing 2, one invalid node and an inverse
+  GCA_MORPH *gcam = GCAMalloc(5, 6, 7);
+  gcam->spacing   = 2;
+  for (int x = 0; x < gcam->width; x++)
+    for (int y = 0; y < gcam->height; y++)
+      for (int z = 0; z < gcam->depth; z++) {
+        GCA_MORPH_NODE *gcamn = &gcam->nodes[x][y][z];
+        gcamn->x              = 2 * x + 0.3 * sin(x + 2 * y);
+        gcamn->y              = 2 * y + 0.2 * cos(y + 3 * z);
+        gcamn->z              = 2 * z - 0.25 * sin(z + x);
+      }
+  gcam->nodes[1][2][3].invalid = GCAM_POSITION_INVALID;
+  gcam->mri_xind               = MRIalloc(10, 12, 14, MRI_FLOAT);
+  gcam->mri_yind               = MRIalloc(10, 12, 14, MRI_FLOAT);
+  gcam->mri_zind               = MRIalloc(10, 12, 14, MRI_FLOAT);
+  for (int x = 0; x < 10; x++)
+    for (int y = 0; y < 12; y++)
+      for (int z = 0; z < 14; z++) {
+        MRIFvox(gcam->mri_xind, x, y, z) = 0.5 * x + 0.01 * y * z;
+        MRIFvox(gcam->mri_yind, x, y, z) = 0.5 * y - 0.02 * x;
+        MRIFvox(gcam->mri_zind, x, y, z) = 0.5 * z + 0.03 * sin(x + y);
+      }
+
+  transform.type  = MORPH_3D_TYPE;
+  transform.xform = gcam;
+  ASSERT_EQ(TransformEvaluatorInit(&te, &transform), NO_ERROR);
+  expectEvaluatorMatchesWrappers(&transform, pts, npts, &te);
+
+  // the wrappers go through the evaluator, so check the forward modes
+  // against the inverse volumes themselves
+  for (int which : {TE_SAMPLE, TE_SAMPLE_REAL, TE_SAMPLE_REAL2})
+    for (int n = 0; n < npts; n++) {
+      float ex, ey, ez, rx, ry, rz;
+      const float *p = &pts[3 * n];
+      ASSERT_EQ(TransformEvaluate(&te, which, p[0], p[1], p[2], &ex, &ey, &ez),
+                NO_ERROR);
+      morphSampleReference(gcam, which, p[0], p[1], p[2], &rx, &ry, &rz);
+      EXPECT_NEAR(ex, rx, 1e-5) << "mode " << which << " point " << n;
+      EXPECT_NEAR(ey, ry, 1e-5) << "mode " << which << " point " << n;
+      EXPECT_NEAR(ez, rz, 1e-5) << "mode " << which << " point " << n;
+    }
+
+  // the invalid node is reported by the truncating inverse
+  float x, y, z;
+  EXPECT_EQ(TransformEvaluate(&te, TE_SAMPLE_INVERSE, 2, 4, 6, &x, &y, &z),
+            ERROR_BADPARM);
+  EXPECT_EQ(TransformEvaluate(&te, TE_SAMPLE_INVERSE, 4, 4, 6, &x, &y, &z),
+            NO_ERROR);
+  EXPECT_FLOAT_EQ(x, gcam->nodes[2][2][3].x);
+  GCAMfree(&gcam);
+}
 TEST(transform_unit, TransformAlloc) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -2,6 +2,8 @@
 // Created by Ahmed Abou-Aliaa on 05.10.20.
 //
 
+#include "mri.h"
+#include "volcluster.h"
 #include <gtest/gtest.h>
 
 TEST(volcluster_unit, clustAllocCluster) { // NOLINT
@@ -52,6 +54,53 @@ TEST(volcluster_unit, clustGrowOneVoxel) { // NOLINT
 
   EXPECT_EQ(1, 0);
 }
+TEST(volcluster_unit, clustGrowAll) { // NOLINT
+  // must find the same clusters, in the same order, as one clustGrow() per
+  // remaining hit of clustInitHitMap()
+  MRI *vol = MRIalloc(9, 8, 11, MRI_FLOAT);
+  for (int s = 0; s < vol->depth; s++)
+    for (int r = 0; r < vol->height; r++)
+      for (int c = 0; c < vol->width; c++)
+        MRIsetVoxVal(vol, c, r, s, 0, sin(1.7 * c + 2.3 * r * s + 0.9 * s));
+
+  for (int allowdiag = 0; allowdiag <= 1; allowdiag++) {
+    int  nhits, *hitcol, *hitrow, *hitslc, nold = 0, nnew;
+    MRI *HitMap = clustInitHitMap(vol, 0, 0.5, 0, 1, &nhits, &hitcol,
+                                  &hitrow, &hitslc, NULL, 0);
+    ASSERT_TRUE(HitMap != NULL && nhits > 0);
+    MRI *HitMap2 = MRIcopy(HitMap, NULL);
+
+    VOLCLUSTER **old = clustAllocClusterList(nhits);
+    for (int n = 0; n < nhits; n++) {
+      if (MRIgetVoxVal(HitMap, hitcol[n], hitrow[n], hitslc[n], 0))
+        continue;
+      old[nold++] =
+          clustGrow(hitcol[n], hitrow[n], hitslc[n], HitMap, allowdiag);
+    }
+    VOLCLUSTER **vclist = clustGrowAll(HitMap2, allowdiag, &nnew);
+    ASSERT_TRUE(vclist != NULL);
+    EXPECT_EQ(nnew, nold);
+    for (int n = 0; n < nold && n < nnew; n++) {
+      EXPECT_EQ(vclist[n]->nmembers, old[n]->nmembers);
+      EXPECT_EQ(vclist[n]->col[0], old[n]->col[0]);
+      EXPECT_EQ(vclist[n]->row[0], old[n]->row[0]);
+      EXPECT_EQ(vclist[n]->slc[0], old[n]->slc[0]);
+    }
+    for (int s = 0; s < vol->depth; s++)
+      for (int r = 0; r < vol->height; r++)
+        for (int c = 0; c < vol->width; c++)
+          EXPECT_EQ(MRIgetVoxVal(HitMap2, c, r, s, 0), 1);
+
+    clustFreeClusterList(&old, nold);
+    clustFreeClusterList(&vclist, nnew);
+    free(hitcol);
+    free(hitrow);
+    free(hitslc);
+    MRIfree(&HitMap);
+    MRIfree(&HitMap2);
+  }
+  MRIfree(&vol);
+}
 TEST(volcluster_unit, clustMaxMember) { // NOLINT
 
   EXPECT_EQ(1, 0);
@@ -18,6 +18,7 @@
 #include <cstring>
 #include <math.h>
 
+#include "cclabel.h"
 #include "diag.h"
 #include "matrix.h"
 #include "mri.h"
@@ -420,6 +421,79 @@ VOLCLUSTER *clustGrow(int col0, int row0, int slc0, MRI *HitMap,
   return (vc);
 }
 
+/*------------------------------------------------------------------------
+  clustGrowAll() - grows every cluster of the unvisited (0) voxels of
+  HitMap at once with the union-find labeler in cclabel.cpp instead of
+  one clustGrow() per seed. Clusters come out in the order the seed
+  loop over the hits of clustInitHitMap() would have found them, with
+  their members in that same column/row/slice order. All members are
+  marked as visited in HitMap. Setting FREESURFER_OLD_clustGrow makes
+  clustUseOldGrow() return 1 so that callers keep the seed loop.
+  ------------------------------------------------------------------------*/
+VOLCLUSTER **clustGrowAll(MRI *HitMap, int AllowDiag, int *nClusters) {
+  int            col, row, slc, n, id, nc, *rank;
+  unsigned char *mask;
+  CCLABELS *     ccl;
+  VOLCLUSTER **  ClusterList, *vc;
+  float          voxsize;
+
+  mask = (unsigned char *)calloc(
+      (size_t)HitMap->width * HitMap->height * HitMap->depth, 1);
+  for (slc = 0; slc < HitMap->depth; slc++)
+    for (row = 0; row < HitMap->height; row++)
+      for (col = 0; col < HitMap->width; col++)
+        mask[col + HitMap->width * (row + HitMap->height * slc)] =
+            (MRIgetVoxVal(HitMap, col, row, slc, 0) == 0);
+
+  ccl = CCLlabelVolume(mask, HitMap->width, HitMap->height, HitMap->depth,
+                       AllowDiag ? 26 : 6, nullptr, nullptr, 1);
+  free(mask);
+  if (ccl == nullptr) {
+    *nClusters = 0;
+    return (nullptr);
+  }
+
+  ClusterList = clustAllocClusterList(ccl->ncomponents);
+  rank        = (int *)calloc(ccl->ncomponents + 1, sizeof(int));
+  voxsize     = HitMap->xsize * HitMap->ysize * HitMap->zsize;
+  nc          = 0;
+  for (col = 0; col < HitMap->width; col++) {
+    for (row = 0; row < HitMap->height; row++) {
+      for (slc = 0; slc < HitMap->depth; slc++) {
+        id = ccl->id[col + HitMap->width * (row + HitMap->height * slc)];
+        if (id == 0)
+          continue;
+        if (rank[id] == 0) {
+          rank[id]            = ++nc;
+          vc                  = clustAllocCluster(ccl->size[id]);
+          vc->nmembers        = 0;
+          vc->voxsize         = voxsize;
+          ClusterList[nc - 1] = vc;
+        }
+        vc         = ClusterList[rank[id] - 1];
+        n          = vc->nmembers++;
+        vc->col[n] = col;
+        vc->row[n] = row;
+        vc->slc[n] = slc;
+        MRIsetVoxVal(HitMap, col, row, slc, 0, 1);
+      }
+    }
+  }
+  free(rank);
+
+  *nClusters = ccl->ncomponents;
+  CCLfree(&ccl);
+  return (ClusterList);
+}
+
+/*-------------------------------------------------------------------*/
+int clustUseOldGrow(void) {
+  static int use_old = -1;
+  if (use_old < 0)
+    use_old = (getenv("FREESURFER_OLD_clustGrow") != nullptr);
+  return (use_old);
+}
+
 /*-------------------------------------------------------------------*/
 int clustMaxMember(VOLCLUSTER *vc, MRI *vol, int frame, int thsign) {
   int   n;
@@ -785,7 +859,7 @@ VOLCLUSTER **clustGetClusters(MRI *vol, int frame, float threshmin,
                               int *nClusters, MATRIX *XFM) {
   int nthhit, nclusters, nhits, *hitcol = nullptr, *hitrow = nullptr,
                                 *hitslc = nullptr;
-  int          col, row, slc, allowdiag = 0, nprunedclusters;
+  int          col, row, slc, allowdiag = 0, nprunedclusters, n;
   MRI *        HitMap;
   VOLCLUSTER **ClusterList, **ClusterList2;
   float        voxsizemm3, distthresh = 0;
@@ -805,37 +879,52 @@ VOLCLUSTER **clustGetClusters(MRI *vol, int frame, float threshmin,
   if (Gdiag_no > 0)
     printf("INFO: Found %d voxels in threhold range\n", nhits);
 
-  /* Allocate an array of clusters equal to the number of hits -- this
-     is the maximum number of clusters possible */
-  ClusterList = clustAllocClusterList(nhits);
-  if (ClusterList == nullptr) {
-    printf("ERROR: could not alloc %d clusters\n", nhits);
-    return (nullptr);
-  }
-
-  nclusters = 0;
-  for (nthhit = 0; nthhit < nhits; nthhit++) {
-    /* Determine whether this hit is still valid. It may
-       not be if it was assigned to the cluster of a
-       previous hit */
-    col = hitcol[nthhit];
-    row = hitrow[nthhit];
-    slc = hitslc[nthhit];
-    if (MRIgetVoxVal(HitMap, col, row, slc, 0))
-      continue;
-
-    /* Grow cluster using this hit as a seed */
-    ClusterList[nclusters] = clustGrow(col, row, slc, HitMap, allowdiag);
-    ClusterList[nclusters]->voxsize = voxsizemm3;
-
-    /* Determine the member with the maximum value */
-    clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
-
-    if (XFM)
-      clustComputeTal(ClusterList[nclusters], XFM);
+  if (!clustUseOldGrow()) {
+    /* Grow all the clusters at once */
+    ClusterList = clustGrowAll(HitMap, allowdiag, &nclusters);
+    if (ClusterList == nullptr) {
+      printf("ERROR: could not alloc %d clusters\n", nclusters);
+      return (nullptr);
+    }
+    for (n = 0; n < nclusters; n++) {
+      ClusterList[n]->voxsize = voxsizemm3;
+      clustMaxMember(ClusterList[n], vol, frame, threshsign);
+      if (XFM)
+        clustComputeTal(ClusterList[n], XFM);
+    }
+  } else {
+    /* Allocate an array of clusters equal to the number of hits -- this
+       is the maximum number of clusters possible */
+    ClusterList = clustAllocClusterList(nhits);
+    if (ClusterList == nullptr) {
+      printf("ERROR: could not alloc %d clusters\n", nhits);
+      return (nullptr);
+    }
 
-    /* increment the number of clusters */
-    nclusters++;
+    nclusters = 0;
+    for (nthhit = 0; nthhit < nhits; nthhit++) {
+      /* Determine whether this hit is still valid. It may
+         not be if it was assigned to the cluster of a
+         previous hit */
+      col = hitcol[nthhit];
+      row = hitrow[nthhit];
+      slc = hitslc[nthhit];
+      if (MRIgetVoxVal(HitMap, col, row, slc, 0))
+        continue;
+
+      /* Grow cluster using this hit as a seed */
+      ClusterList[nclusters] = clustGrow(col, row, slc, HitMap, allowdiag);
+      ClusterList[nclusters]->voxsize = voxsizemm3;
+
+      /* Determine the member with the maximum value */
+      clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
+
+      if (XFM)
+        clustComputeTal(ClusterList[nclusters], XFM);
+
+      /* increment the number of clusters */
+      nclusters++;
+    }
   }
   free(hitcol);
   free(hitrow);
@@ -1630,9 +1719,9 @@ CSD *CSDmerge(CSD *csd1, CSD *csd2) {
   for (nthrep2 = 0; nthrep2 < csd2->nreps; nthrep2++) {
     csd->nClusters[nthrep]            = csd2->nClusters[nthrep2];
     csd->MaxClusterSize[nthrep]       = csd2->MaxClusterSize[nthrep2];
-    csd->MaxClusterSizeVtx[nthrep]    = csd2->MaxClusterSizeVtx[nthrep1];
-    csd->MaxClusterWeightVtx[nthrep]  = csd2->MaxClusterWeightVtx[nthrep1];
-    csd->MaxClusterWeightArea[nthrep] = csd2->MaxClusterWeightArea[nthrep1];
+    csd->MaxClusterSizeVtx[nthrep]    = csd2->MaxClusterSizeVtx[nthrep2];
+    csd->MaxClusterWeightVtx[nthrep]  = csd2->MaxClusterWeightVtx[nthrep2];
+    csd->MaxClusterWeightArea[nthrep] = csd2->MaxClusterWeightArea[nthrep2];
     csd->MaxSig[nthrep]               = csd2->MaxSig[nthrep2];
     csd->MaxStat[nthrep]              = csd2->MaxStat[nthrep2];
     nthrep++;